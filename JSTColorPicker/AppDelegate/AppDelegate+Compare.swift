@@ -63,6 +63,10 @@ extension AppDelegate {
         compareDocuments(sender)
     }
     
+    @IBAction internal func importDifferenceRegionsMenuItemTapped(_ sender: NSMenuItem) {
+        firstRespondingWindowController?.importPixelMatchRegions()
+    }
+    
     func validateFileMenuItem(_ menuItem: NSMenuItem) -> Bool {
         if menuItem.action == #selector(compareDocumentsMenuItemTapped(_:))
         {
@@ -76,6 +80,12 @@ extension AppDelegate {
                 return false
             }
         }
+        else if menuItem.action == #selector(importDifferenceRegionsMenuItemTapped(_:))
+        {
+            let hasAttachedSheet = firstRespondingWindowController?.hasAttachedSheet ?? false
+            guard !hasAttachedSheet else { return false }
+            return firstRespondingWindowController?.canImportPixelMatchRegions ?? false
+        }
         return false
     }
     
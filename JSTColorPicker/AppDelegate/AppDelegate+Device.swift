@@ -80,6 +80,7 @@ extension AppDelegate {
         helperConnectionInvalidatedManually = true
         helperConnection?.invalidate()
         helperConnection = nil
+        helperFrameTransport.close()
     }
     
     internal func applicationBonjourSetup(deactivate: Bool) {
@@ -309,6 +310,92 @@ extension AppDelegate {
         }
     }
     
+    private func promiseProxyTakeRawScreenshot(_ proxy: JSTScreenshotHelperProtocol, byHostName hostName: String) -> Promise<JSTPixelImage> {
+        return Promise<JSTPixelImage> { seal in
+            after(.seconds(60)).done {
+                seal.reject(XPCError.timeout)
+            }
+            guard let udid = hostName.split(separator: ".").compactMap({ String($0) }).last else {
+                seal.reject(XPCError.invalidDeviceHandler(handler: hostName))
+                return
+            }
+            DispatchQueue.global(qos: .userInitiated).async {
+                proxy.takeRawScreenshot(byUDID: udid) { (pixels, attributes, error) in
+                    if let error = error {
+                        seal.reject(error)
+                    } else if let pixels = pixels, let attributes = attributes {
+                        if let pixelImage = AppDelegate.pixelImage(withRawScreenshot: pixels, attributes: attributes) {
+                            seal.fulfill(pixelImage)
+                        } else {
+                            seal.reject(XPCError.malformedResponse)
+                        }
+                    } else {
+                        seal.reject(XPCError.malformedResponse)
+                    }
+                }
+            }
+        }
+    }
+    
+    private func promiseProxyTakeSharedScreenshot(_ proxy: JSTScreenshotHelperProtocol, byHostName hostName: String) -> Promise<JSTPixelImage> {
+        return Promise<JSTPixelImage> { seal in
+            after(.seconds(60)).done {
+                seal.reject(XPCError.timeout)
+            }
+            guard let udid = hostName.split(separator: ".").compactMap({ String($0) }).last else {
+                seal.reject(XPCError.invalidDeviceHandler(handler: hostName))
+                return
+            }
+            DispatchQueue.global(qos: .userInitiated).async { [unowned self] in
+                self.helperFrameTransport.takeSharedScreenshot(proxy, byUDID: udid) { result in
+                    switch result {
+                        case .success(let sharedFrame):
+                            // documents live long, do not keep the helper from writing into the slot
+                            if JSTPixelImageMakeUnique(sharedFrame.pixelImage.internalPointer) != 0 {
+                                seal.fulfill(sharedFrame.pixelImage)
+                            } else {
+                                seal.reject(XPCError.malformedResponse)
+                            }
+                        case .failure(let error):
+                            seal.reject(error)
+                    }
+                }
+            }
+        }
+    }
+    
+    private static func pixelImage(withRawScreenshot pixels: Data, attributes attributesData: Data) -> JSTPixelImage? {
+        guard let attributes = try? PropertyListSerialization.propertyList(from: attributesData, options: [], format: nil) as? [String: Any],
+              let width = attributes[kJSTRawScreenshotWidthKey] as? UInt,
+              let height = attributes[kJSTRawScreenshotHeightKey] as? UInt,
+              let bytesPerRow = attributes[kJSTRawScreenshotBytesPerRowKey] as? UInt
+        else {
+            return nil
+        }
+        let orientation = attributes[kJSTRawScreenshotOrientationKey] as? UInt8 ?? 0
+        
+        var colorSpace: CGColorSpace?
+        if let iccData = attributes[kJSTRawScreenshotColorSpaceICCKey] as? Data {
+            colorSpace = CGColorSpace(iccData: iccData as CFData)
+        } else if let colorSpaceName = attributes[kJSTRawScreenshotColorSpaceNameKey] as? String {
+            colorSpace = CGColorSpace(name: colorSpaceName as CFString)
+        }
+        
+        return JSTPixelImage(
+            pixelData: pixels,
+            width: width,
+            height: height,
+            bytesPerRow: bytesPerRow,
+            orientation: orientation,
+            colorSpace: colorSpace ?? CGColorSpace(name: CGColorSpace.sRGB)!
+        )
+    }
+    
+    private enum CapturedScreenshot {
+        case encoded(Data)
+        case decoded(JSTPixelImage)
+    }
+    
     typealias SocketAddress = (address: String, port: Int)
     
     private func promiseResolveBonjourDevice(byHostName hostName: String) -> Promise<BonjourDevice> {
@@ -394,20 +481,25 @@ extension AppDelegate {
         }
     }
     
-    private func promiseSaveScreenshot(_ data: Data, to path: String) -> Promise<URL> {
+    private func screenshotURL(in path: String, at date: Date) throws -> URL {
         let picturesDirectoryURL = URL(fileURLWithPath: NSString(string: path).standardizingPath)
+        var isDirectory: ObjCBool = false
+        if !FileManager.default.fileExists(atPath: picturesDirectoryURL.path, isDirectory: &isDirectory) {
+            try FileManager.default.createDirectory(at: picturesDirectoryURL, withIntermediateDirectories: true, attributes: nil)
+        }
+        var picturesURL = picturesDirectoryURL
+        picturesURL.appendPathComponent("screenshot_\(AppDelegate.screenshotDateFormatter.string(from: date))")
+        picturesURL.appendPathExtension("png")
+        return picturesURL
+    }
+    
+    private func promiseSaveScreenshot(_ data: Data, to path: String) -> Promise<URL> {
         return Promise<URL> { seal in
             after(.seconds(5)).done {
                 seal.reject(XPCError.timeout)
             }
             do {
-                var isDirectory: ObjCBool = false
-                if !FileManager.default.fileExists(atPath: picturesDirectoryURL.path, isDirectory: &isDirectory) {
-                    try FileManager.default.createDirectory(at: picturesDirectoryURL, withIntermediateDirectories: true, attributes: nil)
-                }
-                var picturesURL = picturesDirectoryURL
-                picturesURL.appendPathComponent("screenshot_\(AppDelegate.screenshotDateFormatter.string(from: Date.init()))")
-                picturesURL.appendPathExtension("png")
+                let picturesURL = try self.screenshotURL(in: path, at: Date())
                 try data.write(to: picturesURL)
                 seal.fulfill(picturesURL)
             } catch {
@@ -416,6 +508,22 @@ extension AppDelegate {
         }
     }
     
+    private func promiseOpenCapturedDocument(_ pixelImage: JSTPixelImage, suggestedIn path: String) -> Promise<Void> {
+        return Promise<Void> { seal in
+            do {
+                let capturedAt = Date()
+                let image = PixelImage(pixelImage: pixelImage, suggestedURL: try self.screenshotURL(in: path, at: capturedAt))
+                let document = Screenshot(capturedImage: image, at: capturedAt)
+                ScreenshotController.shared.addDocument(document)
+                document.makeWindowControllers()
+                document.showWindows()
+                seal.fulfill_()
+            } catch {
+                seal.reject(error)
+            }
+        }
+    }
+    
     private func promiseOpenDocument(at url: URL) -> Promise<Void> {
         return Promise<Void> { seal in
             after(.seconds(5)).done {
@@ -468,7 +576,7 @@ extension AppDelegate {
         loadingAlert.accessoryView = loadingIndicator
         
         var partialDeviceDict: [String: String]?
-        var dataPromise: Promise<Data>
+        var dataPromise: Promise<CapturedScreenshot>
         if selectedIdentifier.hasPrefix(PairedDevice.uniquePrefix) {
             dataPromise = promiseXPCProxy()
                 .then { [unowned self] (proxy) -> Promise<(JSTScreenshotHelperProtocol, Data)> in
@@ -482,11 +590,22 @@ extension AppDelegate {
                 .then { [unowned self] (proxy, data) -> Promise<(JSTScreenshotHelperProtocol, [String: String])> in
                     return self.promiseXPCParseResponse(data).map { (proxy, $0) }
                 }
-                .then { [unowned self] (proxy, deviceDict) -> Promise<Data> in
+                .then { [unowned self] (proxy, deviceDict) -> Promise<CapturedScreenshot> in
                     partialDeviceDict = deviceDict
                     loadingAlert.messageText = NSLocalizedString("Wait for device", comment: "takeScreenshot(_:)")
                     loadingAlert.informativeText = String(format: NSLocalizedString("Download screenshot from device “%@”…", comment: "takeScreenshot(_:)"), deviceDict["name"]!)
-                    return self.promiseProxyTakeScreenshot(proxy, byHostName: deviceDict["udid"]!)
+                    let capturesRawScreenshot: Bool = UserDefaults.standard[.captureRawScreenshots]
+                    if capturesRawScreenshot {
+                        let udid = deviceDict["udid"]!
+                        return self.promiseProxyTakeSharedScreenshot(proxy, byHostName: udid)
+                            .recover { [unowned self] error -> Promise<JSTPixelImage> in
+                                // the frame was overwritten before we got to it, take it the slow way
+                                guard error is FrameTransport.Error else { throw error }
+                                return self.promiseProxyTakeRawScreenshot(proxy, byHostName: udid)
+                            }
+                            .map { CapturedScreenshot.decoded($0) }
+                    }
+                    return self.promiseProxyTakeScreenshot(proxy, byHostName: deviceDict["udid"]!).map { CapturedScreenshot.encoded($0) }
                 }
         }
         else if selectedIdentifier.hasPrefix(BonjourDevice.uniquePrefix) {
@@ -501,21 +620,28 @@ extension AppDelegate {
                 loadingAlert.messageText = NSLocalizedString("Wait for device", comment: "takeScreenshot(_:)")
                 loadingAlert.informativeText = String(format: NSLocalizedString("Download screenshot from device “%@”…", comment: "takeScreenshot(_:)"), device.name.isEmpty ? device.hostName : device.name)
                 return self.promiseResolveSocketAddress(ofDevice: device)
-            }.then { [unowned self] (sockAddr: SocketAddress) -> Promise<Data> in
-                return self.promiseDownloadScreenshot(fromSocketAddress: sockAddr)
+            }.then { [unowned self] (sockAddr: SocketAddress) -> Promise<CapturedScreenshot> in
+                return self.promiseDownloadScreenshot(fromSocketAddress: sockAddr).map { CapturedScreenshot.encoded($0) }
             }
         }
         else {
-            dataPromise = Promise<Data> { seal in
+            dataPromise = Promise<CapturedScreenshot> { seal in
                 seal.reject(XPCError.invalidDeviceHandler(handler: selectedIdentifier))
             }
         }
         
-        dataPromise.then { [unowned self] data -> Promise<URL> in
-            return self.promiseSaveScreenshot(data, to: picturesDirectoryPath)
-        }.then { [unowned self] url -> Promise<Void> in
-            windowController.showSheet(nil, completionHandler: nil)
-            return self.promiseOpenDocument(at: url)
+        dataPromise.then { [unowned self] captured -> Promise<Void> in
+            switch captured {
+            case .encoded(let data):
+                return self.promiseSaveScreenshot(data, to: picturesDirectoryPath).then { [unowned self] url -> Promise<Void> in
+                    windowController.showSheet(nil, completionHandler: nil)
+                    return self.promiseOpenDocument(at: url)
+                }
+            case .decoded(let pixelImage):
+                // not written until the document is saved
+                windowController.showSheet(nil, completionHandler: nil)
+                return self.promiseOpenCapturedDocument(pixelImage, suggestedIn: picturesDirectoryPath)
+            }
         }.catch(policy: .allErrors, { [unowned self] err in
             if self.applicationCheckScreenshotHelper().exists {
                 DispatchQueue.main.async {
@@ -555,6 +681,60 @@ extension AppDelegate {
     @IBAction internal func devicesTakeScreenshotMenuItemTapped(_ sender: NSMenuItem) {
         takeScreenshot(sender)
     }
+
+
+    // MARK: - Device Action: Continuous Capture
+
+    @objc func startContinuousCapture(_ sender: Any?) {
+        guard let picturesDirectoryPath: String = UserDefaults.standard[.screenshotSavingPath]
+        else {
+            return
+        }
+
+        // raw frames only come through the helper
+        guard let selectedIdentifier = selectedDeviceUniqueIdentifier,
+              selectedIdentifier.hasPrefix(PairedDevice.uniquePrefix)
+        else {
+            let alert = NSAlert()
+            alert.messageText = NSLocalizedString("No device selected", comment: "startContinuousCapture(_:)")
+            alert.informativeText = NSLocalizedString("Select a paired iOS or Android device from “Devices” menu.", comment: "startContinuousCapture(_:)")
+            alert.addButton(withTitle: NSLocalizedString("OK", comment: "startContinuousCapture(_:)"))
+            alert.alertStyle = .informational
+            alert.runModal()
+            return
+        }
+
+        let frameRate: Double = UserDefaults.standard[.continuousCaptureFrameRate]
+        let frameCount: Int = UserDefaults.standard[.continuousCaptureFrameCount]
+
+        promiseXPCProxy()
+            .then { [unowned self] (proxy) -> Promise<(JSTScreenshotHelperProtocol, Data)> in
+                return self.promiseProxyLookupDevice(proxy, byHostName: selectedIdentifier).map { (proxy, $0) }
+            }
+            .then { [unowned self] (proxy, data) -> Promise<(JSTScreenshotHelperProtocol, [String: String])> in
+                return self.promiseXPCParseResponse(data).map { (proxy, $0) }
+            }
+            .done { [unowned self] (proxy, deviceDict) in
+                let stream = CaptureStream(proxy: proxy, frameTransport: self.helperFrameTransport, deviceUDID: deviceDict["udid"]!, frameRate: frameRate, frameCount: frameCount)
+                let windowController = CaptureWindowController.shared
+                windowController.window?.title = deviceDict["name"] ?? selectedIdentifier
+                windowController.openFrameHandler = { [unowned self] pixelImage in
+                    self.promiseOpenCapturedDocument(pixelImage, suggestedIn: picturesDirectoryPath)
+                        .catch { err in
+                            NSAlert(error: err).runModal()
+                        }
+                }
+                windowController.attach(stream)
+                windowController.showWindow(sender)
+            }
+            .catch { err in
+                NSAlert(error: err).runModal()
+            }
+    }
+
+    @IBAction internal func devicesContinuousCaptureMenuItemTapped(_ sender: NSMenuItem) {
+        startContinuousCapture(sender)
+    }
     
     
     // MARK: - Device Action: Select
@@ -755,6 +935,7 @@ extension AppDelegate {
     
     func validateDeviceMenuItem(_ menuItem: NSMenuItem) -> Bool {
         if menuItem.action == #selector(devicesTakeScreenshotMenuItemTapped(_:))
+            || menuItem.action == #selector(devicesContinuousCaptureMenuItemTapped(_:))
             || menuItem.action == #selector(notifyDiscoverDevices(_:))
             || menuItem.action == #selector(enableNetworkDiscoveryMenuItemTapped(_:))
         {
@@ -15,6 +15,7 @@ extension AppDelegate {
     
     internal func prepareDefaults() {
         isNetworkDiscoveryEnabled = UserDefaults.standard[.enableNetworkDiscovery]
+        applicationPixelCacheSetup(enabled: UserDefaults.standard[.enablePixelCache])
     }
     
     internal func applyDefaults(_ defaults: UserDefaults, _ defaultKey: UserDefaults.Key, _ defaultValue: Any) {
@@ -25,6 +26,21 @@ extension AppDelegate {
                 applicationBonjourSetup(deactivate: true)
             }
         }
+        else if defaultKey == .enablePixelCache, let toValue = defaultValue as? Bool {
+            applicationPixelCacheSetup(enabled: toValue)
+        }
+    }
+    
+    private func applicationPixelCacheSetup(enabled: Bool) {
+        guard enabled else {
+            PixelImage.cache = nil
+            return
+        }
+        guard PixelImage.cache == nil else { return }
+        PixelImage.cache = PixelImage.Cache(
+            directoryURL: AppDelegate.cachesDirectoryURL.appendingPathComponent("PixelCache"),
+            maximumSize: UserDefaults.standard[.maximumPixelCacheSize]
+        )
     }
     
     
@@ -34,6 +34,11 @@ class AppDelegate: NSObject, NSApplicationDelegate {
         .urls(for: .applicationSupportDirectory, in: .userDomainMask).first!
         .appendingPathComponent(Bundle.main.bundleIdentifier!)
 
+    /// application's cache directory in user's `Caches/`
+    static let cachesDirectoryURL: URL = FileManager.default
+        .urls(for: .cachesDirectory, in: .userDomainMask).first!
+        .appendingPathComponent(Bundle.main.bundleIdentifier!)
+
     
     // MARK: - Structs
     
@@ -104,10 +109,11 @@ class AppDelegate: NSObject, NSApplicationDelegate {
     
     var tabService                              : TabService?
     var helperConnection                        : NSXPCConnection?
+    lazy var helperFrameTransport               = FrameTransport()
     var helperBonjourBrowser                    : BonjourBrowser?
     var helperBonjourDevices                    : Set<BonjourDevice> = Set<BonjourDevice>()
     lazy var helperURLSession                   = URLSession(configuration: .ephemeral)
-    private let observableKeys                  : [UserDefaults.Key] = [.enableNetworkDiscovery]
+    private let observableKeys                  : [UserDefaults.Key] = [.enableNetworkDiscovery, .enablePixelCache]
     private var observables                     : [Observable]?
     internal var isNetworkDiscoveryEnabled      : Bool = false
     internal var modalState                     : ModalState = .idle
@@ -520,7 +526,7 @@ extension AppDelegate: NSMenuItemValidation, NSMenuDelegate {
         }
         else if let matchInput = preparedPixelMatchInput {
             let truncatedNames = matchInput.images
-                .map({ $0.imageSource.url.lastPathComponent.truncated(limit: 20, position: .middle) })
+                .map({ $0.url.lastPathComponent.truncated(limit: 20, position: .middle) })
             compareDocumentsMenuItem.title = String(format: NSLocalizedString("Compare “%@” and “%@”", comment: "updateMenuItems"), truncatedNames.first!, truncatedNames.last!)
         }
         else {
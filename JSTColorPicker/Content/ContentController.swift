@@ -642,7 +642,7 @@ extension ContentController: ContentActionResponder {
     }
     
     @discardableResult
-    private func importContentItems(_ items: [ContentItem]) throws -> [ContentItem] {
+    func importContentItems(_ items: [ContentItem]) throws -> [ContentItem] {
         
         guard let content = documentContent,
             let image = documentImage    else { throw Content.Error.notLoaded }
@@ -1052,6 +1052,14 @@ extension ContentController: NSMenuItemValidation, NSMenuDelegate {
             
         }
             
+        else if menuItem.action == #selector(findMatches(_:))
+        {  // contents available / multiple targets / at least one color or area
+            
+            guard documentState.isLoaded, let selectedItems = selectedContentItems else { return false }
+            return !selectedItems.isEmpty
+            
+        }
+            
         else if menuItem.action == #selector(paste(_:))
         {  // contents available / paste manager
             guard documentState.isWritable else { return false }
@@ -1590,6 +1598,73 @@ extension ContentController: NSMenuItemValidation, NSMenuDelegate {
         }
     }
     
+    @IBAction private func findMatches(_ sender: NSMenuItem) {
+        guard let image = documentImage,
+              let selectedItems = selectedContentItems
+        else { return }
+        
+        // colors are searched like find_color, the first one being the anchor and the first area limiting where it is searched,
+        // an area alone is searched like find_image
+        let selectedColors = selectedItems.compactMap({ $0 as? PixelColor })
+        let selectedArea = selectedItems.first(where: { $0 is PixelArea }) as? PixelArea
+        let alert: NSAlert?
+        if !selectedColors.isEmpty {
+            alert = findColorMatchesAlert(in: image, colors: selectedColors, area: selectedArea)
+        } else if let selectedArea = selectedArea {
+            alert = findImageMatchesAlert(in: image, area: selectedArea)
+        } else {
+            alert = nil
+        }
+        guard let alert = alert else {
+            NSSound.beep()
+            return
+        }
+        alert.beginSheetModal(for: view.window!)
+    }
+    
+    private func findColorMatchesAlert(in image: PixelImage, colors: [PixelColor], area: PixelArea?) -> NSAlert? {
+        guard let result = image.findColor(colors, in: area?.rect, maximumMatchCount: 5) else { return nil }
+        
+        let alert = NSAlert()
+        if result.isUnique {
+            alert.messageText = NSLocalizedString("Unique Match", comment: "findMatches(_:)")
+            alert.informativeText = String(format: NSLocalizedString("The selected colors only match at %@.", comment: "findMatches(_:)"), result.matches[0].description)
+            alert.alertStyle = .informational
+        }
+        else if result.matchCount == 0 {
+            alert.messageText = NSLocalizedString("No Match", comment: "findMatches(_:)")
+            alert.informativeText = NSLocalizedString("The selected colors do not match anywhere in the selected area.", comment: "findMatches(_:)")
+            alert.alertStyle = .warning
+        }
+        else {
+            alert.messageText = NSLocalizedString("Ambiguous Match", comment: "findMatches(_:)")
+            alert.informativeText = String(format: NSLocalizedString("The selected colors match at %ld positions, a script searching for them may find another one first: %@.", comment: "findMatches(_:)"), result.matchCount, result.matches.map({ $0.description }).joined(separator: ", "))
+            alert.alertStyle = .warning
+        }
+        alert.informativeText += "\n\n" + String(format: NSLocalizedString("%ld pixels scanned, %ld of them matching the anchor, %ld other points compared.", comment: "findMatches(_:)"), result.scannedCount, result.candidateCount, result.comparisonCount)
+        return alert
+    }
+    
+    private func findImageMatchesAlert(in image: PixelImage, area: PixelArea) -> NSAlert? {
+        guard let result = image.findImage(of: area.rect, similarity: area.similarity, maximumMatchCount: 5) else { return nil }
+        
+        let alert = NSAlert()
+        if result.matchCount <= 1 {
+            // the area always matches itself
+            alert.messageText = NSLocalizedString("Unique Match", comment: "findMatches(_:)")
+            alert.informativeText = String(format: NSLocalizedString("The selected area only matches at %@.", comment: "findMatches(_:)"), area.rect.description)
+            alert.alertStyle = .informational
+        }
+        else {
+            let matchDescriptions = zip(result.matches, result.similarities).map({ String(format: "%@ (%.2f%%)", $0.0.description, $0.1 * 100.0) })
+            alert.messageText = NSLocalizedString("Ambiguous Match", comment: "findMatches(_:)")
+            alert.informativeText = String(format: NSLocalizedString("The selected area matches at %ld places, a script searching for it may find another one first: %@.", comment: "findMatches(_:)"), result.matchCount, matchDescriptions.joined(separator: ", "))
+            alert.alertStyle = .warning
+        }
+        alert.informativeText += "\n\n" + String(format: NSLocalizedString("%ld positions searched, %ld of them compared at full resolution.", comment: "findMatches(_:)"), result.positionCount, result.comparisonCount)
+        return alert
+    }
+    
     @IBAction private func removeTag(_ sender: NSMenuItem) {
         guard let parent = sender.menu else { return }
         guard let selectedItems = selectedContentItems,
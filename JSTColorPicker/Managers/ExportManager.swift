@@ -49,6 +49,8 @@ final class ExportManager {
     }
     
     @objc dynamic weak var screenshot: Screenshot!
+
+    let templateResultCache = TemplateResultCache()
     
     required init(screenshot: Screenshot) {
         self.screenshot = screenshot
@@ -110,7 +112,7 @@ extension ExportManager {
             throw Template.Error
                 .unsatisfiedPlatformVersion(version: template.platformVersion)
         }
-        return try template.generate(image, items, forAction: action)
+        return try template.generate(image, items, forAction: action, cache: templateResultCache)
     }
 
     // convenience
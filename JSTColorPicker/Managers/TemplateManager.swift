@@ -8,6 +8,7 @@
 
 import Foundation
 import OSLog
+import LuaSwift
 
 @objc final class TemplateManager: NSObject {
     
@@ -64,6 +65,11 @@ import OSLog
         return url
     }()
 
+    // beside the templates directory rather than in it, which is enumerated for templates
+    static var templateBytecodeCache = BytecodeCache(
+        directoryURL: AppDelegate.supportDirectoryURL.appendingPathComponent("TemplateBytecode")
+    )
+
     static var exampleTemplateURLs: [URL] = {
         return [
             Bundle.main.url(forResource: "ExampleTemplates", withExtension: "bundle")!,
@@ -178,11 +184,13 @@ import OSLog
             object: self
         )
 
+        let templateURLs = enumerator
+            .compactMap({ $0 as? URL })
+            .filter({ $0.isRegularFile && $0.pathExtension == "lua" })
+
         // purpose: filter the greatest version of each template
         var newTemplates = Dictionary(
-            grouping: enumerator
-                .compactMap({ $0 as? URL })
-                .filter({ $0.isRegularFile && $0.pathExtension == "lua" })
+            grouping: templateURLs
                 .compactMap({ (url) -> Template? in
                     do {
                         return try Template(templateURL: url, templateManager: self)
@@ -197,6 +205,8 @@ import OSLog
         )
         .compactMap({ $0.1.first })
 
+        TemplateManager.templateBytecodeCache.removeEntries(keeping: templateURLs)
+
         newTemplates = newTemplates
             .sorted(by: { $0.name.compare($1.name) == .orderedAscending })
 
@@ -10,33 +10,119 @@ import Foundation
 import LuaSwift
 
 extension Content: LuaSwift.Value {
+
+    /// Pushes the items as they are, see `Content.TemplateItems`.
     func push(_ vm: VirtualMachine) {
-        let t = vm.createTable(withSequence: items)
-        t["colors"] = vm.createTable(withSequence: lazyColors)
-        t["areas"] = vm.createTable(withSequence: lazyAreas)
-        t["get_data"] = vm.createFunction([], requiredArgumentCount: 0) { (_) -> SwiftReturnValue in
-            if let data = try? NSKeyedArchiver.archivedData(withRootObject: self, requiringSecureCoding: true) {
-                return .value(data)
-            }
-            return .error(Screenshot.Error.invalidContent.failureReason!)
-        }
-        t.push(vm)
+        TemplateItems(self).push(vm)
     }
 
-    func kind() -> Kind { return .table }
+    func kind() -> Kind { return .userdata }
 
-    private static let typeKeys: [String] = ["colors", "areas", "get_data"]
-    private static let typeName: String = "\(String(describing: Content.self)) (Table Keys [\(typeKeys.joined(separator: ","))])"
+    private static let typeName: String = "\(String(describing: Content.self)) (Userdata)"
     class func arg(_ vm: VirtualMachine, value: Value) -> String? {
-        if value.kind() != .table { return typeName }
-        if let result = Table.arg(vm, value: value) { return result }
-        let t = value as! Table
-        if !(t["colors"] is Table) ||
-            !(t["areas"] is Table) ||
-            !(t["get_data"] is Function)
-        {
-            return typeName
-        }
+        if value.kind() != .userdata { return typeName }
+        if TemplateItems.owner(of: value, in: vm) == nil { return typeName }
         return nil
     }
 }
+
+extension Content {
+
+    /// The items of a content as given to a template, a userdata whose fields are read on demand, see JSTLuaContent.h.
+    /// Only numeric fields are copied when pushed, and colors are converted from `colorSpace` to `targetColorSpace` when read.
+    final class TemplateItems: NSObject, LuaSwift.Value {
+
+        let items            : [ContentItem]     // colors and areas, in the order of the content
+        let colorSpace       : NSColorSpace?
+        let targetColorSpace : NSColorSpace?
+
+        init(_ content: Content, convertingColorsFrom colorSpace: NSColorSpace? = nil, to targetColorSpace: NSColorSpace? = nil) {
+            self.items = content.items.filter({ $0 is PixelColor || $0 is PixelArea })
+            self.colorSpace = colorSpace
+            self.targetColorSpace = targetColorSpace
+            super.init()
+        }
+
+        /// The content as seen by the template, with its colors converted, for `get_data`.
+        private var convertedContent: Content {
+            guard let colorSpace = colorSpace, let targetColorSpace = targetColorSpace else {
+                return Content(items: items)
+            }
+            return Content(items: items.map({ item -> ContentItem in
+                if let color = item as? PixelColor {
+                    return color.copyEquivalentColor(fromColorSpace: colorSpace, toColorSpace: targetColorSpace)
+                }
+                return item
+            }))
+        }
+
+        func push(_ vm: VirtualMachine) {
+            if JSTLuaContentRegister(vm.state) {
+                TemplateItems.registerMethods(vm)
+            }
+
+            var fields = [JST_LUA_CONTENT_ITEM]()
+            fields.reserveCapacity(items.count)
+            for item in items {
+                var itemFields = JST_LUA_CONTENT_ITEM()
+                itemFields.identifier = Int64(item.id)
+                itemFields.similarity = item.similarity
+                if let color = item as? PixelColor {
+                    itemFields.type = .color
+                    itemFields.x = Int32(color.coordinate.x)
+                    itemFields.y = Int32(color.coordinate.y)
+                    itemFields.color = color.rgbaValue
+                }
+                else if let area = item as? PixelArea {
+                    itemFields.type = .area
+                    itemFields.x = Int32(area.rect.x)
+                    itemFields.y = Int32(area.rect.y)
+                    itemFields.width = Int32(area.rect.width)
+                    itemFields.height = Int32(area.rect.height)
+                }
+                fields.append(itemFields)
+            }
+
+            JSTLuaContentPush(vm.state, fields, fields.count, self, colorSpace, targetColorSpace)
+        }
+
+        /// Functions written in Swift, added once per state; they are given the items first.
+        private static func registerMethods(_ vm: VirtualMachine) {
+
+            vm.createFunction([Content.arg], requiredArgumentCount: 1) {
+                [unowned vm] (args) -> SwiftReturnValue in
+
+                let templateItems = TemplateItems.owner(of: args.userdata, in: vm)!
+                if let data = try? NSKeyedArchiver.archivedData(withRootObject: templateItems.convertedContent, requiringSecureCoding: true) {
+                    return .value(data)
+                }
+                return .error(Screenshot.Error.invalidContent.failureReason!)
+            }.push(vm)
+            JSTLuaContentSetMethod(vm.state, "get_data")
+
+            vm.createFunction([Content.arg, Int64.arg], requiredArgumentCount: 2) {
+                [unowned vm] (args) -> SwiftReturnValue in
+
+                let templateItems = TemplateItems.owner(of: args.userdata, in: vm)!
+                let item = templateItems.items[Int(args.integer) - 1]
+                return .values([
+                    item.firstTag ?? "",
+                    vm.createTable(withSequence: item.tags.elements),
+                    vm.createTable(withDictionary: item.userInfoDict ?? [:], { $0 as String }, { $0 as String }),
+                ])
+            }.push(vm)
+            JSTLuaContentSetFieldResolver(vm.state)
+        }
+
+        fileprivate static func owner(of value: Value, in vm: VirtualMachine) -> TemplateItems? {
+            value.push(vm)
+            return JSTLuaContentPopOwner(vm.state) as? TemplateItems
+        }
+
+        func kind() -> Kind { return .userdata }
+
+        static func arg(_ vm: VirtualMachine, value: Value) -> String? {
+            return Content.arg(vm, value: value)
+        }
+    }
+}
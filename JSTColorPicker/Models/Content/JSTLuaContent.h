@@ -0,0 +1,62 @@
+//
+//  JSTLuaContent.h
+//  JSTColorPicker
+//
+//  Created by Darwin on 10/17/26.
+//  Copyright © 2026 JST. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <AppKit/AppKit.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct lua_State lua_State;
+
+/*
+ * The items passed to templates: a userdata holding a copy of the numeric
+ * fields of every item, which reads like a sequence of items with `#items`,
+ * `items[i]`, `ipairs(items)` and `pairs(items)`, and has `colors`, `areas`
+ * and `get_data()` as before.
+ *
+ * Each item is a userdata of its own, created the first time it is read and
+ * kept for the next reads, so that fields added by templates stay with it.
+ * Its numeric fields are read from the copy, colors being converted to the
+ * color space of the template only when read, and `name`, `tags` and
+ * `userInfo` are asked to the application the first time one of them is
+ * read. `pairs(item)` reads every field, so that an item may be copied into
+ * a table.
+ */
+
+typedef NS_ENUM(int, JSTLuaContentItemType) {
+    JSTLuaContentItemTypeColor = 0,
+    JSTLuaContentItemTypeArea,
+};
+
+typedef struct JST_LUA_CONTENT_ITEM {
+    JSTLuaContentItemType type;
+    long long identifier;
+    double similarity;
+    int x;
+    int y;
+    int width;          /* areas only */
+    int height;
+    uint32_t color;     /* colors only, the rgbaValue of the color as picked */
+} JST_LUA_CONTENT_ITEM;
+
+/// Creates the metatables of the state if needed, returns YES if they have just been created and need the methods of the application.
+FOUNDATION_EXTERN BOOL JSTLuaContentRegister(lua_State *L);
+
+/// Pops a function and adds it as a method of the items, it is called with the items first.
+FOUNDATION_EXTERN void JSTLuaContentSetMethod(lua_State *L, const char *name);
+
+/// Pops a function called with the items and the index of an item, from 1, which returns its name, tags and userInfo.
+FOUNDATION_EXTERN void JSTLuaContentSetFieldResolver(lua_State *L);
+
+/// Pushes new items, copying the fields of count items; colors are converted from colorSpace to targetColorSpace unless either is nil. The owner is retained with them and returned by JSTLuaContentPopOwner.
+FOUNDATION_EXTERN void JSTLuaContentPush(lua_State *L, const JST_LUA_CONTENT_ITEM *items, NSInteger count, id owner, NSColorSpace * _Nullable colorSpace, NSColorSpace * _Nullable targetColorSpace);
+
+/// Pops a value and returns the owner of the items, or nil if the value is not the items.
+FOUNDATION_EXTERN id _Nullable JSTLuaContentPopOwner(lua_State *L);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,544 @@
+//
+//  JSTLuaContent.m
+//  JSTColorPicker
+//
+//  Created by Darwin on 10/17/26.
+//  Copyright © 2026 JST. All rights reserved.
+//
+
+#import "JSTLuaContent.h"
+#import "JSTPixelColor.h"
+#import <LuaC/LuaC.h>
+
+
+static const char *JSTLuaContentTypeName = "Content";
+static const char *JSTLuaContentItemTypeName = "ContentItem";
+
+/* user values of the items */
+enum {
+    JSTLuaContentItemsValue = 1,        /* items by index, created on first read */
+    JSTLuaContentFieldsValue,           /* colors and areas, created on first read, and fields added by templates */
+    JSTLuaContentBoundMethodsValue,     /* methods bound to these items, created on first use */
+    JSTLuaContentValueCount = JSTLuaContentBoundMethodsValue,
+};
+
+/* user values of an item */
+enum {
+    JSTLuaContentItemContentValue = 1,  /* the items it belongs to */
+    JSTLuaContentItemFieldsValue,       /* fields read once or added by templates */
+    JSTLuaContentItemValueCount = JSTLuaContentItemFieldsValue,
+};
+
+typedef struct JST_LUA_CONTENT {
+    void *owner;                /* retained */
+    void *colorSpace;           /* NSColorSpace, retained, NULL unless colors are converted */
+    void *targetColorSpace;     /* NSColorSpace, retained */
+    lua_Integer count;
+    JST_LUA_CONTENT_ITEM items[];
+} JST_LUA_CONTENT;
+
+typedef struct JST_LUA_CONTENT_ITEM_PROXY {
+    lua_Integer index;          /* from 1 */
+    BOOL isResolved;            /* name, tags and userInfo were asked for */
+} JST_LUA_CONTENT_ITEM_PROXY;
+
+typedef enum JSTLuaContentField {
+    JSTLuaContentFieldID = 0,
+    JSTLuaContentFieldType,
+    JSTLuaContentFieldName,
+    JSTLuaContentFieldTags,
+    JSTLuaContentFieldSimilarity,
+    JSTLuaContentFieldX,
+    JSTLuaContentFieldY,
+    JSTLuaContentFieldColor,
+    JSTLuaContentFieldMinX,
+    JSTLuaContentFieldMinY,
+    JSTLuaContentFieldMaxX,
+    JSTLuaContentFieldMaxY,
+    JSTLuaContentFieldWidth,
+    JSTLuaContentFieldHeight,
+    JSTLuaContentFieldUserInfo,
+} JSTLuaContentField;
+
+static const char *const JSTLuaContentFieldNames[] = {
+    "id", "type", "name", "tags", "similarity", "x", "y", "color",
+    "minX", "minY", "maxX", "maxY", "width", "height", "userInfo",
+};
+
+/* fields of each type of item, as PixelColor and PixelArea pushed them */
+static const JSTLuaContentField JSTLuaContentColorFields[] = {
+    JSTLuaContentFieldID, JSTLuaContentFieldType, JSTLuaContentFieldName, JSTLuaContentFieldTags,
+    JSTLuaContentFieldSimilarity, JSTLuaContentFieldX, JSTLuaContentFieldY, JSTLuaContentFieldColor,
+    JSTLuaContentFieldUserInfo,
+};
+
+static const JSTLuaContentField JSTLuaContentAreaFields[] = {
+    JSTLuaContentFieldID, JSTLuaContentFieldType, JSTLuaContentFieldName, JSTLuaContentFieldTags,
+    JSTLuaContentFieldSimilarity, JSTLuaContentFieldX, JSTLuaContentFieldY,
+    JSTLuaContentFieldMinX, JSTLuaContentFieldMinY, JSTLuaContentFieldMaxX, JSTLuaContentFieldMaxY,
+    JSTLuaContentFieldWidth, JSTLuaContentFieldHeight, JSTLuaContentFieldUserInfo,
+};
+
+
+#pragma mark - Items
+
+static JST_LUA_CONTENT *JSTLuaContentCheck(lua_State *L, int index)
+{
+    return luaL_checkudata(L, index, JSTLuaContentTypeName);
+}
+
+/* pushes the item at index, from 1, of the items at content */
+static void JSTLuaContentPushItem(lua_State *L, int content, lua_Integer index)
+{
+    content = lua_absindex(L, content);
+    lua_getiuservalue(L, content, JSTLuaContentItemsValue);
+    if (lua_rawgeti(L, -1, index) == LUA_TNIL) {
+        lua_pop(L, 1);
+        JST_LUA_CONTENT_ITEM_PROXY *proxy = lua_newuserdatauv(L, sizeof(JST_LUA_CONTENT_ITEM_PROXY), JSTLuaContentItemValueCount);
+        proxy->index = index;
+        proxy->isResolved = NO;
+        luaL_setmetatable(L, JSTLuaContentItemTypeName);
+        lua_pushvalue(L, content);
+        lua_setiuservalue(L, -2, JSTLuaContentItemContentValue);
+        lua_newtable(L);
+        lua_setiuservalue(L, -2, JSTLuaContentItemFieldsValue);
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, -3, index);
+    }
+    lua_remove(L, -2);
+}
+
+/* pushes a sequence of the items of type, such as `items.colors` */
+static void JSTLuaContentPushItemsOfType(lua_State *L, int content, JSTLuaContentItemType type)
+{
+    content = lua_absindex(L, content);
+    const JST_LUA_CONTENT *items = lua_touserdata(L, content);
+    lua_newtable(L);
+    lua_Integer count = 0;
+    for (lua_Integer i = 0; i < items->count; i++) {
+        if (items->items[i].type == type) {
+            JSTLuaContentPushItem(L, content, i + 1);
+            lua_rawseti(L, -2, ++count);
+        }
+    }
+}
+
+/* same conversion as -[PixelColor copyEquivalentColorInImage:ofColorSpace:] */
+static uint32_t JSTLuaContentConvertColor(const JST_LUA_CONTENT *items, uint32_t rgbaValue)
+{
+    @autoreleasepool {
+        JST_COLOR color;
+        color.theColor = rgbaValue;
+        JSTPixelColor *pixelColor = [JSTPixelColor colorWithRed:color.red green:color.green blue:color.blue alpha:color.alpha];
+        NSColor *systemColor = [[pixelColor toSystemColorWithColorSpace:(__bridge NSColorSpace *)items->colorSpace]
+                                colorUsingColorSpace:(__bridge NSColorSpace *)items->targetColorSpace];
+        return systemColor ? [JSTPixelColor colorWithSystemColor:systemColor].rgbaValue : rgbaValue;
+    }
+}
+
+
+#pragma mark - Item Metamethods
+
+/* asks the application for name, tags and userInfo, which are set unless
+ * the template has set them already; the fields of the item are at fields */
+static void JSTLuaContentItemResolve(lua_State *L, int item, int fields)
+{
+    JST_LUA_CONTENT_ITEM_PROXY *proxy = lua_touserdata(L, item);
+    if (proxy->isResolved) {
+        return;
+    }
+    luaL_getmetatable(L, JSTLuaContentTypeName);
+    if (lua_getfield(L, -1, "resolver") == LUA_TNIL) {
+        lua_pop(L, 2);
+        return;
+    }
+    lua_getiuservalue(L, item, JSTLuaContentItemContentValue);
+    lua_pushinteger(L, proxy->index);
+    lua_call(L, 2, 3);
+    proxy->isResolved = YES;
+    const char *names[] = { "name", "tags", "userInfo" };
+    for (int i = 2; i >= 0; i--) {
+        if (lua_getfield(L, fields, names[i]) == LUA_TNIL) {
+            lua_pop(L, 1);
+            lua_setfield(L, fields, names[i]);
+        } else {
+            lua_pop(L, 2);
+        }
+    }
+    lua_pop(L, 1);
+}
+
+/* pushes a field of the item at item, whose fields are at fields */
+static void JSTLuaContentItemPushField(lua_State *L, int item, int fields, JSTLuaContentField field)
+{
+    const JST_LUA_CONTENT_ITEM_PROXY *proxy = lua_touserdata(L, item);
+    lua_getiuservalue(L, item, JSTLuaContentItemContentValue);
+    const JST_LUA_CONTENT *items = lua_touserdata(L, -1);
+    lua_pop(L, 1);  /* still referenced by the item */
+    const JST_LUA_CONTENT_ITEM *fieldsOfItem = &items->items[proxy->index - 1];
+    switch (field) {
+        case JSTLuaContentFieldID:
+            lua_pushinteger(L, fieldsOfItem->identifier);
+            break;
+        case JSTLuaContentFieldType:
+            lua_pushstring(L, fieldsOfItem->type == JSTLuaContentItemTypeColor ? "PixelColor" : "PixelArea");
+            break;
+        case JSTLuaContentFieldSimilarity:
+            lua_pushnumber(L, fieldsOfItem->similarity);
+            break;
+        case JSTLuaContentFieldX:
+        case JSTLuaContentFieldMinX:
+            lua_pushinteger(L, fieldsOfItem->x);
+            break;
+        case JSTLuaContentFieldY:
+        case JSTLuaContentFieldMinY:
+            lua_pushinteger(L, fieldsOfItem->y);
+            break;
+        case JSTLuaContentFieldMaxX:
+            lua_pushinteger(L, (lua_Integer)fieldsOfItem->x + fieldsOfItem->width);
+            break;
+        case JSTLuaContentFieldMaxY:
+            lua_pushinteger(L, (lua_Integer)fieldsOfItem->y + fieldsOfItem->height);
+            break;
+        case JSTLuaContentFieldWidth:
+            lua_pushinteger(L, fieldsOfItem->width);
+            break;
+        case JSTLuaContentFieldHeight:
+            lua_pushinteger(L, fieldsOfItem->height);
+            break;
+        case JSTLuaContentFieldColor:
+            if (items->colorSpace && items->targetColorSpace) {
+                /* converted once, then read from the fields */
+                lua_pushinteger(L, JSTLuaContentConvertColor(items, fieldsOfItem->color));
+                lua_pushvalue(L, -1);
+                lua_setfield(L, fields, JSTLuaContentFieldNames[field]);
+            } else {
+                lua_pushinteger(L, fieldsOfItem->color);
+            }
+            break;
+        case JSTLuaContentFieldName:
+        case JSTLuaContentFieldTags:
+        case JSTLuaContentFieldUserInfo:
+            JSTLuaContentItemResolve(L, item, fields);
+            lua_getfield(L, fields, JSTLuaContentFieldNames[field]);
+            break;
+    }
+}
+
+/* upvalues: the fields of colors and the fields of areas, by name */
+static int JSTLuaContentItemIndex(lua_State *L)
+{
+    luaL_checkudata(L, 1, JSTLuaContentItemTypeName);
+    lua_settop(L, 2);
+
+    lua_getiuservalue(L, 1, JSTLuaContentItemFieldsValue);  /* 3 */
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, 3) != LUA_TNIL || lua_type(L, 2) != LUA_TSTRING) {
+        return 1;
+    }
+
+    lua_getiuservalue(L, 1, JSTLuaContentItemContentValue);  /* 5 */
+    const JST_LUA_CONTENT_ITEM_PROXY *proxy = lua_touserdata(L, 1);
+    const JST_LUA_CONTENT *items = lua_touserdata(L, 5);
+    JSTLuaContentItemType type = items->items[proxy->index - 1].type;
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, lua_upvalueindex(type == JSTLuaContentItemTypeColor ? 1 : 2)) == LUA_TNIL) {
+        return 1;
+    }
+    JSTLuaContentItemPushField(L, 1, 3, (JSTLuaContentField)lua_tointeger(L, -1));
+    return 1;
+}
+
+static int JSTLuaContentItemNewIndex(lua_State *L)
+{
+    luaL_checkudata(L, 1, JSTLuaContentItemTypeName);
+    lua_settop(L, 3);
+    lua_getiuservalue(L, 1, JSTLuaContentItemFieldsValue);
+    lua_insert(L, 2);
+    lua_rawset(L, 2);
+    return 0;
+}
+
+static int JSTLuaContentNextField(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_settop(L, 2);
+    if (lua_next(L, 1)) {
+        return 2;
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
+/* reads every field first, so that an item may be copied into a table */
+static int JSTLuaContentItemPairs(lua_State *L)
+{
+    luaL_checkudata(L, 1, JSTLuaContentItemTypeName);
+    lua_settop(L, 1);
+    lua_getiuservalue(L, 1, JSTLuaContentItemFieldsValue);  /* 2 */
+    lua_getiuservalue(L, 1, JSTLuaContentItemContentValue);
+    const JST_LUA_CONTENT_ITEM_PROXY *proxy = lua_touserdata(L, 1);
+    const JST_LUA_CONTENT *items = lua_touserdata(L, -1);
+    BOOL isColor = items->items[proxy->index - 1].type == JSTLuaContentItemTypeColor;
+    lua_pop(L, 1);
+
+    const JSTLuaContentField *fields = isColor ? JSTLuaContentColorFields : JSTLuaContentAreaFields;
+    size_t count = isColor ? sizeof(JSTLuaContentColorFields) / sizeof(JSTLuaContentColorFields[0])
+                           : sizeof(JSTLuaContentAreaFields) / sizeof(JSTLuaContentAreaFields[0]);
+    for (size_t i = 0; i < count; i++) {
+        if (lua_getfield(L, 2, JSTLuaContentFieldNames[fields[i]]) == LUA_TNIL) {
+            JSTLuaContentItemPushField(L, 1, 2, fields[i]);
+            lua_setfield(L, 2, JSTLuaContentFieldNames[fields[i]]);
+        }
+        lua_pop(L, 1);
+    }
+
+    lua_pushcfunction(L, JSTLuaContentNextField);
+    lua_insert(L, 2);
+    lua_pushnil(L);
+    return 3;
+}
+
+static int JSTLuaContentItemToString(lua_State *L)
+{
+    const JST_LUA_CONTENT_ITEM_PROXY *proxy = luaL_checkudata(L, 1, JSTLuaContentItemTypeName);
+    lua_getiuservalue(L, 1, JSTLuaContentItemContentValue);
+    const JST_LUA_CONTENT *items = lua_touserdata(L, -1);
+    const JST_LUA_CONTENT_ITEM *fieldsOfItem = &items->items[proxy->index - 1];
+    lua_pushfstring(L, "%s: %p {id:%I}", fieldsOfItem->type == JSTLuaContentItemTypeColor ? "PixelColor" : "PixelArea",
+                    lua_topointer(L, 1), (LUAI_UACINT)fieldsOfItem->identifier);
+    return 1;
+}
+
+
+#pragma mark - Metamethods
+
+/* upvalues: the method and the items; `items:method(...)` passes the items
+ * already, `items.method(...)` does not */
+static int JSTLuaContentCallBoundMethod(lua_State *L)
+{
+    if (lua_gettop(L) == 0 || !lua_rawequal(L, 1, lua_upvalueindex(2))) {
+        lua_pushvalue(L, lua_upvalueindex(2));
+        lua_insert(L, 1);
+    }
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 1);
+    lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+    return lua_gettop(L);
+}
+
+static int JSTLuaContentIndex(lua_State *L)
+{
+    const JST_LUA_CONTENT *items = JSTLuaContentCheck(L, 1);
+    lua_settop(L, 2);
+
+    int isInteger = 0;
+    lua_Integer index = lua_type(L, 2) == LUA_TNUMBER ? lua_tointegerx(L, 2, &isInteger) : 0;
+    if (isInteger) {
+        if (index >= 1 && index <= items->count) {
+            JSTLuaContentPushItem(L, 1, index);
+        } else {
+            lua_pushnil(L);
+        }
+        return 1;
+    }
+
+    lua_getiuservalue(L, 1, JSTLuaContentFieldsValue);  /* 3 */
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, 3) != LUA_TNIL || lua_type(L, 2) != LUA_TSTRING) {
+        return 1;
+    }
+
+    const char *key = lua_tostring(L, 2);
+    if (strcmp(key, "colors") == 0 || strcmp(key, "areas") == 0) {
+        JSTLuaContentPushItemsOfType(L, 1, key[0] == 'c' ? JSTLuaContentItemTypeColor : JSTLuaContentItemTypeArea);
+        lua_pushvalue(L, 2);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, 3);
+        return 1;
+    }
+
+    lua_getiuservalue(L, 1, JSTLuaContentBoundMethodsValue);  /* 5 */
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, 5) != LUA_TNIL) {
+        return 1;
+    }
+
+    luaL_getmetafield(L, 1, "methods");  /* 7 */
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, 7) == LUA_TNIL) {
+        return 1;
+    }
+    lua_pushvalue(L, 1);
+    lua_pushcclosure(L, JSTLuaContentCallBoundMethod, 2);
+    lua_pushvalue(L, 2);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, 5);
+    return 1;
+}
+
+/* items themselves are read only */
+static int JSTLuaContentNewIndex(lua_State *L)
+{
+    JSTLuaContentCheck(L, 1);
+    lua_settop(L, 3);
+    luaL_argcheck(L, lua_type(L, 2) != LUA_TNUMBER, 2, "items are read only");
+    lua_getiuservalue(L, 1, JSTLuaContentFieldsValue);
+    lua_insert(L, 2);
+    lua_rawset(L, 2);
+    return 0;
+}
+
+static int JSTLuaContentLength(lua_State *L)
+{
+    lua_pushinteger(L, JSTLuaContentCheck(L, 1)->count);
+    return 1;
+}
+
+static int JSTLuaContentNextItem(lua_State *L)
+{
+    const JST_LUA_CONTENT *items = JSTLuaContentCheck(L, 1);
+    lua_Integer index = luaL_optinteger(L, 2, 0) + 1;
+    if (index > items->count) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushinteger(L, index);
+    JSTLuaContentPushItem(L, 1, index);
+    return 2;
+}
+
+/* iterates the items only, like ipairs */
+static int JSTLuaContentPairs(lua_State *L)
+{
+    JSTLuaContentCheck(L, 1);
+    lua_pushcfunction(L, JSTLuaContentNextItem);
+    lua_pushvalue(L, 1);
+    lua_pushinteger(L, 0);
+    return 3;
+}
+
+static int JSTLuaContentToString(lua_State *L)
+{
+    const JST_LUA_CONTENT *items = JSTLuaContentCheck(L, 1);
+    lua_pushfstring(L, "%s: %p {count:%I}", JSTLuaContentTypeName, lua_topointer(L, 1), (LUAI_UACINT)items->count);
+    return 1;
+}
+
+static int JSTLuaContentGC(lua_State *L)
+{
+    JST_LUA_CONTENT *items = JSTLuaContentCheck(L, 1);
+    if (items->owner) {
+        CFBridgingRelease(items->owner);
+        items->owner = NULL;
+    }
+    if (items->colorSpace) {
+        CFBridgingRelease(items->colorSpace);
+        items->colorSpace = NULL;
+    }
+    if (items->targetColorSpace) {
+        CFBridgingRelease(items->targetColorSpace);
+        items->targetColorSpace = NULL;
+    }
+    return 0;
+}
+
+
+#pragma mark - Registration
+
+BOOL JSTLuaContentRegister(lua_State *L)
+{
+    if (!luaL_newmetatable(L, JSTLuaContentTypeName)) {
+        lua_pop(L, 1);
+        return NO;
+    }
+    lua_newtable(L);
+    lua_setfield(L, -2, "methods");
+    lua_pushcfunction(L, JSTLuaContentIndex);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, JSTLuaContentNewIndex);
+    lua_setfield(L, -2, "__newindex");
+    lua_pushcfunction(L, JSTLuaContentLength);
+    lua_setfield(L, -2, "__len");
+    lua_pushcfunction(L, JSTLuaContentPairs);
+    lua_setfield(L, -2, "__pairs");
+    lua_pushcfunction(L, JSTLuaContentToString);
+    lua_setfield(L, -2, "__tostring");
+    lua_pushcfunction(L, JSTLuaContentGC);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, JSTLuaContentItemTypeName);
+    const JSTLuaContentField *fieldsOfTypes[] = { JSTLuaContentColorFields, JSTLuaContentAreaFields };
+    const size_t countsOfTypes[] = {
+        sizeof(JSTLuaContentColorFields) / sizeof(JSTLuaContentColorFields[0]),
+        sizeof(JSTLuaContentAreaFields) / sizeof(JSTLuaContentAreaFields[0]),
+    };
+    for (int type = 0; type < 2; type++) {
+        lua_createtable(L, 0, (int)countsOfTypes[type]);
+        for (size_t i = 0; i < countsOfTypes[type]; i++) {
+            lua_pushinteger(L, fieldsOfTypes[type][i]);
+            lua_setfield(L, -2, JSTLuaContentFieldNames[fieldsOfTypes[type][i]]);
+        }
+    }
+    lua_pushcclosure(L, JSTLuaContentItemIndex, 2);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, JSTLuaContentItemNewIndex);
+    lua_setfield(L, -2, "__newindex");
+    lua_pushcfunction(L, JSTLuaContentItemPairs);
+    lua_setfield(L, -2, "__pairs");
+    lua_pushcfunction(L, JSTLuaContentItemToString);
+    lua_setfield(L, -2, "__tostring");
+    lua_pop(L, 1);
+    return YES;
+}
+
+void JSTLuaContentSetMethod(lua_State *L, const char *name)
+{
+    luaL_getmetatable(L, JSTLuaContentTypeName);
+    lua_getfield(L, -1, "methods");
+    lua_rotate(L, -3, -1);
+    lua_setfield(L, -2, name);
+    lua_pop(L, 2);
+}
+
+void JSTLuaContentSetFieldResolver(lua_State *L)
+{
+    luaL_getmetatable(L, JSTLuaContentTypeName);
+    lua_rotate(L, -2, 1);
+    lua_setfield(L, -2, "resolver");
+    lua_pop(L, 1);
+}
+
+void JSTLuaContentPush(lua_State *L, const JST_LUA_CONTENT_ITEM *items, NSInteger count, id owner, NSColorSpace *colorSpace, NSColorSpace *targetColorSpace)
+{
+    JSTLuaContentRegister(L);
+    JST_LUA_CONTENT *content = lua_newuserdatauv(L, sizeof(JST_LUA_CONTENT) + sizeof(JST_LUA_CONTENT_ITEM) * (size_t)count, JSTLuaContentValueCount);
+    content->owner = NULL;
+    content->colorSpace = NULL;
+    content->targetColorSpace = NULL;
+    content->count = count;
+    if (count > 0) {
+        memcpy(content->items, items, sizeof(JST_LUA_CONTENT_ITEM) * (size_t)count);
+    }
+    luaL_setmetatable(L, JSTLuaContentTypeName);
+    lua_createtable(L, 0, 0);
+    lua_setiuservalue(L, -2, JSTLuaContentItemsValue);
+    lua_newtable(L);
+    lua_setiuservalue(L, -2, JSTLuaContentFieldsValue);
+    lua_newtable(L);
+    lua_setiuservalue(L, -2, JSTLuaContentBoundMethodsValue);
+    content->owner = (void *)CFBridgingRetain(owner);
+    if (colorSpace && targetColorSpace) {
+        content->colorSpace = (void *)CFBridgingRetain(colorSpace);
+        content->targetColorSpace = (void *)CFBridgingRetain(targetColorSpace);
+    }
+}
+
+id JSTLuaContentPopOwner(lua_State *L)
+{
+    JST_LUA_CONTENT *content = luaL_testudata(L, -1, JSTLuaContentTypeName);
+    id owner = content && content->owner ? (__bridge id)content->owner : nil;
+    lua_pop(L, 1);
+    return owner;
+}
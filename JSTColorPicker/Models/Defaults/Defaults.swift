@@ -62,6 +62,9 @@ extension UserDefaults.Key {
     static let makeSoundsAfterDoubleClickCopy       : UserDefaults.Key     = "defaults:makeSoundsAfterDoubleClickCopy"         // Bool
     
     static let screenshotSavingPath                 : UserDefaults.Key     = "defaults:screenshotSavingPath"                   // String
+    static let captureRawScreenshots                : UserDefaults.Key     = "defaults:captureRawScreenshots"                  // Bool
+    static let continuousCaptureFrameRate           : UserDefaults.Key     = "defaults:continuousCaptureFrameRate"             // Double
+    static let continuousCaptureFrameCount          : UserDefaults.Key     = "defaults:continuousCaptureFrameCount"            // Int
     
     static let pixelMatchThreshold                  : UserDefaults.Key     = "defaults:pixelMatchThreshold"                    // Double
     static let pixelMatchIncludeAA                  : UserDefaults.Key     = "defaults:pixelMatchIncludeAA"                    // Bool
@@ -73,6 +76,8 @@ extension UserDefaults.Key {
     
     static let enableGPUAcceleration                : UserDefaults.Key     = "defaults:enableGPUAcceleration"                  // Bool
     static let enableSyntaxHighlighting             : UserDefaults.Key     = "defaults:enableSyntaxHighlighting"               // Bool
+    static let enablePixelCache                     : UserDefaults.Key     = "defaults:enablePixelCache"                       // Bool
+    static let maximumPixelCacheSize                : UserDefaults.Key     = "defaults:maximumPixelCacheSize"                  // Int
     static let checkUpdatesAutomatically            : UserDefaults.Key     = "SUEnableAutomaticChecks"                         // Bool
     
     static let initialSimilarity                    : UserDefaults.Key     = "defaults:initialSimilarity"                      // Double
@@ -0,0 +1,52 @@
+//
+//  JSTLuaPixelImage.h
+//  JSTColorPicker
+//
+//  Created by Darwin on 10/17/26.
+//  Copyright © 2026 JST. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "JSTPixelImage.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct lua_State lua_State;
+
+/*
+ * An image passed to templates: a userdata whose methods read the pixels
+ * directly, sharing one metatable per Lua state. Its fields are kept in a
+ * table of its own, so templates may still add fields to it, and its methods
+ * may be called with either `image.get_color(x, y)` or `image:get_color(x, y)`.
+ *
+ * Built in methods:
+ *   get_color(x, y)         the ARGB value of a pixel
+ *   get_colors(points)      the ARGB values of many pixels, each point being {x, y} or {x = x, y = y}
+ *   get_row(y)              the ARGB values of a row
+ *   find_color(points[, region[, limit]])
+ *                           multi-point color search, see JSTPixelFind.h; each point is
+ *                           {x, y, color[, similarity[, offset]]} or a color item, similarity
+ *                           being a fraction, the region is an area item or {x1, y1, x2, y2};
+ *                           returns the anchors of the matches, {x = x, y = y}, and their count
+ *   find_image(template[, region[, similarity[, limit]]])
+ *                           sub-image search, see JSTPixelFindImage.h; the template is an image
+ *                           or an area of this one, whose similarity is used by default;
+ *                           returns the matches, {x = x, y = y, similarity = similarity}, and their count
+ */
+
+/// Creates the metatable of the state if needed, returns YES if it has just been created and needs the methods of the application.
+FOUNDATION_EXTERN BOOL JSTLuaPixelImageRegister(lua_State *L);
+
+/// Pops a function and adds it as a method, it is called with the image first.
+FOUNDATION_EXTERN void JSTLuaPixelImageSetMethod(lua_State *L, const char *name);
+
+/// Pushes a new image, the owner is retained with it and returned by JSTLuaPixelImagePopOwner.
+FOUNDATION_EXTERN void JSTLuaPixelImagePush(lua_State *L, JSTPixelImage *pixelImage, id owner);
+
+/// Pops a value and sets it as a field of the image at index.
+FOUNDATION_EXTERN void JSTLuaPixelImageSetField(lua_State *L, int index, const char *name);
+
+/// Pops a value and returns the owner of the image, or nil if the value is not an image.
+FOUNDATION_EXTERN id _Nullable JSTLuaPixelImagePopOwner(lua_State *L);
+
+NS_ASSUME_NONNULL_END
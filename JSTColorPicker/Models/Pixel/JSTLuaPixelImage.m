@@ -0,0 +1,503 @@
+//
+//  JSTLuaPixelImage.m
+//  JSTColorPicker
+//
+//  Created by Darwin on 10/17/26.
+//  Copyright © 2026 JST. All rights reserved.
+//
+
+#import "JSTLuaPixelImage.h"
+#import "JSTPixelCore.h"
+#import "JSTPixelFind.h"
+#import "JSTPixelFindImage.h"
+#import <LuaC/LuaC.h>
+
+
+static const char *JSTLuaPixelImageTypeName = "PixelImage";
+
+/* user values of the userdata */
+enum {
+    JSTLuaPixelImageFieldsValue = 1,
+    JSTLuaPixelImageBoundMethodsValue,  /* methods bound to this image, created on first use */
+    JSTLuaPixelImageValueCount = JSTLuaPixelImageBoundMethodsValue,
+};
+
+typedef struct JST_LUA_PIXEL_IMAGE {
+    void *pixelImage;  /* JSTPixelImage, retained */
+    void *owner;       /* retained */
+} JST_LUA_PIXEL_IMAGE;
+
+static JST_IMAGE *JSTLuaPixelImageCheck(lua_State *L, int index)
+{
+    JST_LUA_PIXEL_IMAGE *image = luaL_checkudata(L, index, JSTLuaPixelImageTypeName);
+    return ((__bridge JSTPixelImage *)image->pixelImage).internalPointer;
+}
+
+/* Errors are pushed by a function of their own, so that no object is left
+ * behind when lua_error jumps out of the caller. */
+static void JSTLuaPixelImagePushRangeError(lua_State *L, const JST_IMAGE *pixelImage, NSString *item)
+{
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
+    NSString *reason = [NSString stringWithFormat:NSLocalizedString(@"The requested item %@ is out of the document range %@.", @"Content.Error"), item, [NSString stringWithFormat:@"{w:%d,h:%d}", width, height]];
+    lua_pushstring(L, reason.UTF8String);
+}
+
+static int JSTLuaPixelImageCheckCoordinate(lua_State *L, int arg)
+{
+    lua_Integer value = luaL_checkinteger(L, arg);
+    luaL_argcheck(L, value >= INT32_MIN && value <= INT32_MAX, arg, "coordinate out of range");
+    return (int)value;
+}
+
+
+#pragma mark - Methods
+
+static int JSTLuaPixelImageGetColor(lua_State *L)
+{
+    JST_IMAGE *pixelImage = JSTLuaPixelImageCheck(L, 1);
+    JST_POS point;
+    point.x = JSTLuaPixelImageCheckCoordinate(L, 2);
+    point.y = JSTLuaPixelImageCheckCoordinate(L, 3);
+    if (JSTGetColorsInPixelImage(pixelImage, &point, 1) >= 0) {
+        JSTLuaPixelImagePushRangeError(L, pixelImage, [NSString stringWithFormat:@"(%d,%d)", point.x, point.y]);
+        return lua_error(L);
+    }
+    lua_pushinteger(L, point.color.theColor);
+    return 1;
+}
+
+/* Pushes the field of the table on top, or its item at position if the
+ * field is nil, so that both {x, y} and {x = x, y = y} are accepted. */
+static int JSTLuaPixelImageGetPointField(lua_State *L, const char *name, lua_Integer position)
+{
+    if (lua_getfield(L, -1, name) != LUA_TNIL) {
+        return lua_type(L, -1);
+    }
+    lua_pop(L, 1);
+    return lua_geti(L, -1, position);
+}
+
+/* Reads the sequence of points at arg into a new buffer owned by Lua, so
+ * that an error does not leak it, and leaves it on the stack. Colors are
+ * read too with {x, y, color, similarity, offset} or the same fields, as
+ * content items have them, similarity being a fraction and 1 by default. */
+static JST_POS *JSTLuaPixelImageCheckPoints(lua_State *L, int arg, const char *method, BOOL withColors, int *countOfPoints)
+{
+    luaL_checktype(L, arg, LUA_TTABLE);
+    lua_Integer count = luaL_len(L, arg);
+    luaL_argcheck(L, count >= 0 && count <= INT_MAX / (lua_Integer)sizeof(JST_POS), arg, "too many points");
+
+    JST_POS *points = lua_newuserdatauv(L, (size_t)count * sizeof(JST_POS), 0);
+    memset(points, 0, (size_t)count * sizeof(JST_POS));
+    for (lua_Integer i = 0; i < count; i++) {
+        lua_geti(L, arg, i + 1);
+        luaL_argexpected(L, lua_istable(L, -1), arg, "table of points");
+
+        int isX, isY;
+        JSTLuaPixelImageGetPointField(L, "x", 1);
+        lua_Integer x = lua_tointegerx(L, -1, &isX);
+        lua_pop(L, 1);
+        JSTLuaPixelImageGetPointField(L, "y", 2);
+        lua_Integer y = lua_tointegerx(L, -1, &isY);
+        lua_pop(L, 1);
+        if (!isX || !isY || x < INT32_MIN || x > INT32_MAX || y < INT32_MIN || y > INT32_MAX) {
+            luaL_error(L, "bad point #%d to '%s' (integer coordinates expected)", (int)(i + 1), method);
+        }
+        points[i].x = (int32_t)x;
+        points[i].y = (int32_t)y;
+
+        if (withColors) {
+            int isColor, isOffset = 1;
+            JSTLuaPixelImageGetPointField(L, "color", 3);
+            lua_Integer color = lua_tointegerx(L, -1, &isColor);
+            lua_pop(L, 1);
+            lua_Number similarity = 1.0;
+            if (JSTLuaPixelImageGetPointField(L, "similarity", 4) != LUA_TNIL) {
+                similarity = lua_tonumber(L, -1);
+            }
+            lua_pop(L, 1);
+            lua_Integer offset = 0;
+            if (JSTLuaPixelImageGetPointField(L, "offset", 5) != LUA_TNIL) {
+                offset = lua_tointegerx(L, -1, &isOffset);
+            }
+            lua_pop(L, 1);
+            if (!isColor || !isOffset) {
+                luaL_error(L, "bad point #%d to '%s' (integer colors expected)", (int)(i + 1), method);
+            }
+            points[i].color.theColor = (uint32_t)color;
+            points[i].similarity = (int8_t)lround(fmin(fmax(similarity, 0.0), 1.0) * 100.0);
+            points[i].color_offset.theColor = (uint32_t)offset;
+        }
+        lua_pop(L, 1);
+    }
+
+    *countOfPoints = (int)count;
+    return points;
+}
+
+static int JSTLuaPixelImageGetColors(lua_State *L)
+{
+    JST_IMAGE *pixelImage = JSTLuaPixelImageCheck(L, 1);
+    int count;
+    JST_POS *points = JSTLuaPixelImageCheckPoints(L, 2, "get_colors", NO, &count);
+
+    int outside = JSTGetColorsInPixelImage(pixelImage, points, count);
+    if (outside >= 0) {
+        JSTLuaPixelImagePushRangeError(L, pixelImage, [NSString stringWithFormat:@"(%d,%d)", points[outside].x, points[outside].y]);
+        return lua_error(L);
+    }
+
+    lua_createtable(L, count, 0);
+    for (int i = 0; i < count; i++) {
+        lua_pushinteger(L, points[i].color.theColor);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+static int JSTLuaPixelImageGetRow(lua_State *L)
+{
+    JST_IMAGE *pixelImage = JSTLuaPixelImageCheck(L, 1);
+    int y = JSTLuaPixelImageCheckCoordinate(L, 2);
+
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
+    JST_COLOR *row = lua_newuserdatauv(L, (size_t)width * sizeof(JST_COLOR), 0);
+    if (!JSTGetRowInPixelImage(pixelImage, y, row)) {
+        JSTLuaPixelImagePushRangeError(L, pixelImage, [NSString stringWithFormat:@"(0,%d)", y]);
+        return lua_error(L);
+    }
+
+    lua_createtable(L, width, 0);
+    for (int x = 0; x < width; x++) {
+        lua_pushinteger(L, row[x].theColor);
+        lua_rawseti(L, -2, x + 1);
+    }
+    return 1;
+}
+
+/* Fields of an area item, {minX, minY, maxX, maxY}, or {x1, y1, x2, y2}. */
+static void JSTLuaPixelImageCheckRegion(lua_State *L, int arg, int region[4])
+{
+    static const char *names[4] = { "minX", "minY", "maxX", "maxY" };
+    luaL_checktype(L, arg, LUA_TTABLE);
+    lua_pushvalue(L, arg);
+    for (int i = 0; i < 4; i++) {
+        int isInteger;
+        JSTLuaPixelImageGetPointField(L, names[i], i + 1);
+        lua_Integer value = lua_tointegerx(L, -1, &isInteger);
+        luaL_argcheck(L, isInteger && value >= INT32_MIN && value <= INT32_MAX, arg, "integer bounds expected");
+        region[i] = (int)value;
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+}
+
+/* find_color(points[, region[, limit]]): the anchors of every match of the
+ * points within region, the first point being the anchor, and the number of
+ * matches, which may exceed limit. */
+static int JSTLuaPixelImageFindColor(lua_State *L)
+{
+    JST_IMAGE *pixelImage = JSTLuaPixelImageCheck(L, 1);
+    int region[4] = { 0, 0, INT_MAX, INT_MAX };
+    if (!lua_isnoneornil(L, 3)) {
+        JSTLuaPixelImageCheckRegion(L, 3, region);
+    }
+    lua_Integer limit = luaL_optinteger(L, 4, -1);
+    luaL_argcheck(L, limit <= INT_MAX, 4, "limit out of range");
+    lua_settop(L, 2);
+
+    int count;
+    JST_POS *points = JSTLuaPixelImageCheckPoints(L, 2, "find_color", YES, &count);
+    luaL_argcheck(L, count > 0, 2, "no point");
+
+    /* most searches find a few matches, search again in the rare case
+     * that there were more than guessed */
+    long long capacity = limit >= 0 ? limit : 256;
+    long long matchCount = -1;
+    JST_FIND_COLOR_MATCH *matches = NULL;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        matches = lua_newuserdatauv(L, (size_t)capacity * sizeof(JST_FIND_COLOR_MATCH), 0);
+        matchCount = JSTFindColorInPixelImage(pixelImage, points, count, region[0], region[1], region[2], region[3], matches, capacity, NULL, JST_FIND_COLOR_KERNEL_AUTOMATIC);
+        if (matchCount <= capacity || limit >= 0) {
+            break;
+        }
+        capacity = matchCount;
+    }
+    if (matchCount < 0) {
+        return luaL_error(L, "not enough memory");
+    }
+
+    int resultCount = (int)(matchCount < capacity ? matchCount : capacity);
+    lua_createtable(L, resultCount, 0);
+    for (int i = 0; i < resultCount; i++) {
+        lua_createtable(L, 0, 2);
+        lua_pushinteger(L, matches[i].x);
+        lua_setfield(L, -2, "x");
+        lua_pushinteger(L, matches[i].y);
+        lua_setfield(L, -2, "y");
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_pushinteger(L, matchCount);
+    return 2;
+}
+
+/* find_image(template[, region[, similarity[, limit]]]): the top left
+ * corners of the matches of template within region, and the number of
+ * matches, which may exceed limit. The template is an image, or an area of
+ * this one whose similarity is used unless one is given. */
+static int JSTLuaPixelImageFindImage(lua_State *L)
+{
+    JST_IMAGE *pixelImage = JSTLuaPixelImageCheck(L, 1);
+    JST_LUA_PIXEL_IMAGE *templateImage = luaL_testudata(L, 2, JSTLuaPixelImageTypeName);
+    int templateRegion[4];
+    JST_FIND_IMAGE_OPTIONS options;
+    JSTFindImageOptionsInit(&options);
+    if (!templateImage) {
+        luaL_argexpected(L, lua_istable(L, 2), 2, "PixelImage or area");
+        JSTLuaPixelImageCheckRegion(L, 2, templateRegion);
+        if (lua_getfield(L, 2, "similarity") == LUA_TNUMBER) {
+            options.similarity = lua_tonumber(L, -1);
+        }
+        lua_pop(L, 1);
+    }
+    int region[4] = { 0, 0, INT_MAX, INT_MAX };
+    if (!lua_isnoneornil(L, 3)) {
+        JSTLuaPixelImageCheckRegion(L, 3, region);
+    }
+    options.similarity = luaL_optnumber(L, 4, options.similarity);
+    lua_Integer limit = luaL_optinteger(L, 5, -1);
+    luaL_argcheck(L, limit <= INT_MAX, 5, "limit out of range");
+
+    int width, height, templateWidth, templateHeight;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
+    if (templateImage) {
+        JSTGetOrientedSizeOfPixelImage(((__bridge JSTPixelImage *)templateImage->pixelImage).internalPointer, &templateWidth, &templateHeight);
+    } else {
+        if (templateRegion[0] < 0 || templateRegion[1] < 0 || templateRegion[2] > width || templateRegion[3] > height) {
+            JSTLuaPixelImagePushRangeError(L, pixelImage, [NSString stringWithFormat:@"{x:%d,y:%d,w:%d,h:%d}", templateRegion[0], templateRegion[1], templateRegion[2] - templateRegion[0], templateRegion[3] - templateRegion[1]]);
+            return lua_error(L);
+        }
+        templateWidth = templateRegion[2] - templateRegion[0];
+        templateHeight = templateRegion[3] - templateRegion[1];
+    }
+    luaL_argcheck(L, templateWidth > 0 && templateHeight > 0, 2, "empty image");
+
+    /* Matches do not overlap, so there is at most one of them per cell of
+     * template size and the buffer is allocated before the area is copied
+     * out, which must not be left behind by an error. */
+    long long positionWidth = (long long)MIN(region[2], width) - MAX(region[0], 0) - templateWidth + 1;
+    long long positionHeight = (long long)MIN(region[3], height) - MAX(region[1], 0) - templateHeight + 1;
+    long long capacity = positionWidth > 0 && positionHeight > 0 ? (positionWidth / templateWidth + 1) * (positionHeight / templateHeight + 1) : 0;
+    if (limit >= 0 && limit < capacity) {
+        capacity = limit;
+    }
+    JST_FIND_IMAGE_MATCH *matches = lua_newuserdatauv(L, (size_t)capacity * sizeof(JST_FIND_IMAGE_MATCH), 0);
+
+    long long matchCount;
+    if (templateImage) {
+        matchCount = JSTFindImageInPixelImage(pixelImage, ((__bridge JSTPixelImage *)templateImage->pixelImage).internalPointer, region[0], region[1], region[2], region[3], &options, matches, capacity, NULL, JST_FIND_IMAGE_KERNEL_AUTOMATIC);
+    } else {
+        JST_IMAGE *croppedImage = JSTCreatePixelImageByCroppingPixelImage(pixelImage, templateRegion[0], templateRegion[1], templateWidth, templateHeight);
+        matchCount = croppedImage ? JSTFindImageInPixelImage(pixelImage, croppedImage, region[0], region[1], region[2], region[3], &options, matches, capacity, NULL, JST_FIND_IMAGE_KERNEL_AUTOMATIC) : -1;
+        if (croppedImage) {
+            JSTFreePixelImage(croppedImage);
+        }
+    }
+    if (matchCount < 0) {
+        return luaL_error(L, "not enough memory");
+    }
+
+    int resultCount = (int)(matchCount < capacity ? matchCount : capacity);
+    lua_createtable(L, resultCount, 0);
+    for (int i = 0; i < resultCount; i++) {
+        lua_createtable(L, 0, 3);
+        lua_pushinteger(L, matches[i].x);
+        lua_setfield(L, -2, "x");
+        lua_pushinteger(L, matches[i].y);
+        lua_setfield(L, -2, "y");
+        lua_pushnumber(L, matches[i].similarity);
+        lua_setfield(L, -2, "similarity");
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_pushinteger(L, matchCount);
+    return 2;
+}
+
+static const luaL_Reg JSTLuaPixelImageMethods[] = {
+    {"get_color", JSTLuaPixelImageGetColor},
+    {"get_colors", JSTLuaPixelImageGetColors},
+    {"get_row", JSTLuaPixelImageGetRow},
+    {"find_color", JSTLuaPixelImageFindColor},
+    {"find_image", JSTLuaPixelImageFindImage},
+    {NULL, NULL},
+};
+
+
+#pragma mark - Metamethods
+
+/* upvalues: the method and the image; `image:method(...)` passes the image
+ * already, `image.method(...)` does not */
+static int JSTLuaPixelImageCallBoundMethod(lua_State *L)
+{
+    if (lua_gettop(L) == 0 || !lua_rawequal(L, 1, lua_upvalueindex(2))) {
+        lua_pushvalue(L, lua_upvalueindex(2));
+        lua_insert(L, 1);
+    }
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 1);
+    lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+    return lua_gettop(L);
+}
+
+static int JSTLuaPixelImageIndex(lua_State *L)
+{
+    luaL_checkudata(L, 1, JSTLuaPixelImageTypeName);
+    lua_settop(L, 2);
+
+    lua_getiuservalue(L, 1, JSTLuaPixelImageFieldsValue);  /* 3 */
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, 3) != LUA_TNIL) {
+        return 1;
+    }
+
+    lua_getiuservalue(L, 1, JSTLuaPixelImageBoundMethodsValue);  /* 5 */
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, 5) != LUA_TNIL) {
+        return 1;
+    }
+
+    luaL_getmetafield(L, 1, "methods");  /* 7 */
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, 7) == LUA_TNIL) {
+        return 1;
+    }
+    lua_pushvalue(L, 1);
+    lua_pushcclosure(L, JSTLuaPixelImageCallBoundMethod, 2);
+    lua_pushvalue(L, 2);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, 5);
+    return 1;
+}
+
+static int JSTLuaPixelImageNewIndex(lua_State *L)
+{
+    luaL_checkudata(L, 1, JSTLuaPixelImageTypeName);
+    lua_settop(L, 3);
+    lua_getiuservalue(L, 1, JSTLuaPixelImageFieldsValue);
+    lua_insert(L, 2);
+    lua_rawset(L, 2);
+    return 0;
+}
+
+static int JSTLuaPixelImageNextField(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_settop(L, 2);
+    if (lua_next(L, 1)) {
+        return 2;
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
+/* iterates the fields only, so that an image may be copied into a table */
+static int JSTLuaPixelImagePairs(lua_State *L)
+{
+    luaL_checkudata(L, 1, JSTLuaPixelImageTypeName);
+    lua_pushcfunction(L, JSTLuaPixelImageNextField);
+    lua_getiuservalue(L, 1, JSTLuaPixelImageFieldsValue);
+    lua_pushnil(L);
+    return 3;
+}
+
+static int JSTLuaPixelImageToString(lua_State *L)
+{
+    JST_IMAGE *pixelImage = JSTLuaPixelImageCheck(L, 1);
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
+    lua_pushfstring(L, "%s: %p {w:%d,h:%d}", JSTLuaPixelImageTypeName, lua_topointer(L, 1), width, height);
+    return 1;
+}
+
+static int JSTLuaPixelImageGC(lua_State *L)
+{
+    JST_LUA_PIXEL_IMAGE *image = luaL_checkudata(L, 1, JSTLuaPixelImageTypeName);
+    if (image->pixelImage) {
+        CFBridgingRelease(image->pixelImage);
+        image->pixelImage = NULL;
+    }
+    if (image->owner) {
+        CFBridgingRelease(image->owner);
+        image->owner = NULL;
+    }
+    return 0;
+}
+
+
+#pragma mark - Registration
+
+BOOL JSTLuaPixelImageRegister(lua_State *L)
+{
+    if (!luaL_newmetatable(L, JSTLuaPixelImageTypeName)) {
+        lua_pop(L, 1);
+        return NO;
+    }
+    luaL_newlib(L, JSTLuaPixelImageMethods);
+    lua_setfield(L, -2, "methods");
+    lua_pushcfunction(L, JSTLuaPixelImageIndex);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, JSTLuaPixelImageNewIndex);
+    lua_setfield(L, -2, "__newindex");
+    lua_pushcfunction(L, JSTLuaPixelImagePairs);
+    lua_setfield(L, -2, "__pairs");
+    lua_pushcfunction(L, JSTLuaPixelImageToString);
+    lua_setfield(L, -2, "__tostring");
+    lua_pushcfunction(L, JSTLuaPixelImageGC);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+    return YES;
+}
+
+void JSTLuaPixelImageSetMethod(lua_State *L, const char *name)
+{
+    luaL_getmetatable(L, JSTLuaPixelImageTypeName);
+    lua_getfield(L, -1, "methods");
+    lua_rotate(L, -3, -1);
+    lua_setfield(L, -2, name);
+    lua_pop(L, 2);
+}
+
+void JSTLuaPixelImagePush(lua_State *L, JSTPixelImage *pixelImage, id owner)
+{
+    JSTLuaPixelImageRegister(L);
+    JST_LUA_PIXEL_IMAGE *image = lua_newuserdatauv(L, sizeof(JST_LUA_PIXEL_IMAGE), JSTLuaPixelImageValueCount);
+    image->pixelImage = NULL;
+    image->owner = NULL;
+    luaL_setmetatable(L, JSTLuaPixelImageTypeName);
+    lua_newtable(L);
+    lua_setiuservalue(L, -2, JSTLuaPixelImageFieldsValue);
+    lua_newtable(L);
+    lua_setiuservalue(L, -2, JSTLuaPixelImageBoundMethodsValue);
+    image->pixelImage = (void *)CFBridgingRetain(pixelImage);
+    image->owner = (void *)CFBridgingRetain(owner);
+}
+
+void JSTLuaPixelImageSetField(lua_State *L, int index, const char *name)
+{
+    index = lua_absindex(L, index);
+    luaL_checkudata(L, index, JSTLuaPixelImageTypeName);
+    lua_getiuservalue(L, index, JSTLuaPixelImageFieldsValue);
+    lua_rotate(L, -2, 1);
+    lua_setfield(L, -2, name);
+    lua_pop(L, 1);
+}
+
+id JSTLuaPixelImagePopOwner(lua_State *L)
+{
+    JST_LUA_PIXEL_IMAGE *image = luaL_testudata(L, -1, JSTLuaPixelImageTypeName);
+    id owner = image && image->owner ? (__bridge id)image->owner : nil;
+    lua_pop(L, 1);
+    return owner;
+}
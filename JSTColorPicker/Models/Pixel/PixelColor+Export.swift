@@ -8,10 +8,14 @@
 
 extension PixelColor {
     public func copyEquivalentColor(inImage image: PixelImage, ofColorSpace colorSpace: NSColorSpace) -> PixelColor {
+        return copyEquivalentColor(fromColorSpace: image.colorSpace, toColorSpace: colorSpace)
+    }
+    
+    public func copyEquivalentColor(fromColorSpace colorSpaceFrom: NSColorSpace, toColorSpace colorSpaceTo: NSColorSpace) -> PixelColor {
         let item = PixelColor(
             id: id,
             coordinate: coordinate,
-            color: JSTPixelColor(systemColor: toNSColor(from: image.colorSpace, to: colorSpace))
+            color: JSTPixelColor(systemColor: toNSColor(from: colorSpaceFrom, to: colorSpaceTo))
         )
         item.tags = tags
         item.similarity = similarity
@@ -0,0 +1,55 @@
+//
+//  PixelImage+FindColor.swift
+//  JSTColorPicker
+//
+//  Created by Darwin on 10/17/26.
+//  Copyright © 2026 JST. All rights reserved.
+//
+
+import Foundation
+
+extension PixelImage {
+
+    struct FindColorResult {
+        let matches: [PixelCoordinate]   // the first ones, in row order
+        let matchCount: Int
+        let scannedCount: Int
+        let candidateCount: Int
+        let comparisonCount: Int
+
+        var isUnique: Bool { matchCount == 1 }
+    }
+
+    /// Searches the image the way find_color does on the device, see JSTPixelFind.h.
+    /// The first color is the anchor, which is only searched within rect.
+    func findColor(_ colors: [PixelColor], in rect: PixelRect? = nil, maximumMatchCount: Int = 16) -> FindColorResult? {
+        guard !colors.isEmpty else { return nil }
+        let points = colors.map { color -> JST_POS in
+            var point = JST_POS()
+            point.x = Int32(color.coordinate.x)
+            point.y = Int32(color.coordinate.y)
+            point.color = JST_COLOR(theColor: color.rgbaValue)
+            point.similarity = Int8((min(max(color.similarity, 0), 1) * 100).rounded())
+            return point
+        }
+        let region = rect ?? bounds
+        var matches = [JST_FIND_COLOR_MATCH](repeating: JST_FIND_COLOR_MATCH(), count: max(maximumMatchCount, 0))
+        var statistics = JST_FIND_COLOR_STATISTICS()
+        let matchCount = JSTFindColorInPixelImage(
+            pixelImageRepresentation.internalPointer,
+            points, Int32(points.count),
+            Int32(region.minX), Int32(region.minY), Int32(region.maxX), Int32(region.maxY),
+            &matches, Int64(matches.count), &statistics,
+            JST_FIND_COLOR_KERNEL_AUTOMATIC
+        )
+        guard matchCount >= 0 else { return nil }
+        return FindColorResult(
+            matches: matches.prefix(Int(min(matchCount, Int64(matches.count)))).map({ PixelCoordinate(x: Int($0.x), y: Int($0.y)) }),
+            matchCount: Int(matchCount),
+            scannedCount: Int(statistics.scannedCount),
+            candidateCount: Int(statistics.candidateCount),
+            comparisonCount: Int(statistics.comparisonCount)
+        )
+    }
+
+}
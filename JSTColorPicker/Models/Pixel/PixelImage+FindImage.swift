@@ -0,0 +1,57 @@
+//
+//  PixelImage+FindImage.swift
+//  JSTColorPicker
+//
+//  Created by Darwin on 10/17/26.
+//  Copyright © 2026 JST. All rights reserved.
+//
+
+import Foundation
+
+extension PixelImage {
+
+    struct FindImageResult {
+        let matches: [PixelRect]         // the first ones, in row order
+        let similarities: [Double]
+        let matchCount: Int
+        let positionCount: Int
+        let comparisonCount: Int         // positions compared at full resolution
+
+        var isUnique: Bool { matchCount == 1 }
+    }
+
+    /// Searches the image for the pixels of area the way find_image does on the device, see JSTPixelFindImage.h.
+    /// Overlapping matches are reduced to the most similar one, so the area itself counts once.
+    func findImage(of area: PixelRect, similarity: Double, in rect: PixelRect? = nil, maximumMatchCount: Int = 16) -> FindImageResult? {
+        guard bounds.contains(area), area.width > 0, area.height > 0,
+              let templateImage = JSTCreatePixelImageByCroppingPixelImage(
+                pixelImageRepresentation.internalPointer,
+                Int32(area.minX), Int32(area.minY), Int32(area.width), Int32(area.height)
+              )
+        else { return nil }
+        defer { JSTFreePixelImage(templateImage) }
+
+        var options = JST_FIND_IMAGE_OPTIONS()
+        JSTFindImageOptionsInit(&options)
+        options.similarity = similarity
+        let region = rect ?? bounds
+        var matches = [JST_FIND_IMAGE_MATCH](repeating: JST_FIND_IMAGE_MATCH(), count: max(maximumMatchCount, 0))
+        var statistics = JST_FIND_IMAGE_STATISTICS()
+        let matchCount = JSTFindImageInPixelImage(
+            pixelImageRepresentation.internalPointer, templateImage,
+            Int32(region.minX), Int32(region.minY), Int32(region.maxX), Int32(region.maxY),
+            &options, &matches, Int64(matches.count), &statistics,
+            JST_FIND_IMAGE_KERNEL_AUTOMATIC
+        )
+        guard matchCount >= 0 else { return nil }
+        let writtenMatches = matches.prefix(Int(min(matchCount, Int64(matches.count))))
+        return FindImageResult(
+            matches: writtenMatches.map({ PixelRect(x: Int($0.x), y: Int($0.y), width: area.width, height: area.height) }),
+            similarities: writtenMatches.map({ $0.similarity }),
+            matchCount: Int(matchCount),
+            positionCount: Int(statistics.positionCount),
+            comparisonCount: Int(statistics.candidateCounts.0)
+        )
+    }
+
+}
@@ -49,9 +49,51 @@ final class PixelImage {
     }
     
     public fileprivate(set) var cgImage: CGImage
-    public fileprivate(set) var imageSource: Source
+    public fileprivate(set) var url: URL
     public fileprivate(set) var pixelImageRepresentation: JSTPixelImage
-    public func rename(to url: URL) { imageSource.url = url }
+    
+    /// Decoded pixels of previously opened images, set up by the application if enabled.
+    public static var cache: Cache?
+    public func rename(to url: URL) {
+        sourceLock.lock()
+        defer { sourceLock.unlock() }
+        self.url = url
+        isWritten = true
+    }
+    
+    private var encodedSource: CGImageSource?
+    private var isWritten: Bool
+    private let sourceLock = MutexLock()
+    
+    /// Whether the encoded image is at hand, images captured from devices are not encoded until they are written or asked for their source.
+    public var isEncoded: Bool {
+        sourceLock.lock()
+        defer { sourceLock.unlock() }
+        return encodedSource != nil || isWritten
+    }
+    
+    public var imageSource: Source {
+        sourceLock.lock()
+        defer { sourceLock.unlock() }
+        if let cgSource = encodedSource {
+            return Source(url: url, cgSource: cgSource)
+        }
+        let imageSourceOptions = [kCGImageSourceShouldCache: true] as CFDictionary
+        if isWritten, let cgSource = CGImageSourceCreateWithURL(url as CFURL, imageSourceOptions) {
+            encodedSource = cgSource
+        } else {
+            encodedSource = CGImageSourceCreateWithData(pixelImageRepresentation.pngRepresentation() as CFData, imageSourceOptions)
+        }
+        return Source(url: url, cgSource: encodedSource!)
+    }
+    
+    /// Image of decoded pixels which has no file yet, such as a raw screenshot.
+    public init(pixelImage: JSTPixelImage, suggestedURL url: URL) {
+        self.cgImage                   = pixelImage.copyCGImage()
+        self.url                       = url
+        self.pixelImageRepresentation  = pixelImage
+        self.isWritten                 = false
+    }
     
     public init(contentsOf url: URL) throws {
         guard let dataProvider = CGDataProvider(filename: url.path) else {
@@ -62,6 +104,19 @@ final class PixelImage {
             throw PixelImage.Error.loadSourceFailed(url)
         }
         
+        var contentHash: UInt64? = nil
+        if let cache = PixelImage.cache, let data = dataProvider.data {
+            contentHash = JSTPixelCacheHashBytes(CFDataGetBytePtr(data), CFDataGetLength(data))
+            if let contentHash = contentHash, let cachedImage = cache.pixelImage(forContentHash: contentHash) {
+                self.cgImage                   = cachedImage.copyCGImage()
+                self.url                       = url
+                self.pixelImageRepresentation  = cachedImage
+                self.encodedSource             = cgimgSource
+                self.isWritten                 = true
+                return
+            }
+        }
+        
         var imageLoader: CGImage? = nil
         if let cgimg = CGImage(pngDataProviderSource: dataProvider, decode: nil, shouldInterpolate: false, intent: .defaultIntent) {
             imageLoader = cgimg
@@ -78,8 +133,14 @@ final class PixelImage {
         }
         
         self.cgImage                   = cgimg
-        self.imageSource               = Source(url: url, cgSource: cgimgSource)
+        self.url                       = url
         self.pixelImageRepresentation  = JSTPixelImage(cgImage: cgimg)
+        self.encodedSource             = cgimgSource
+        self.isWritten                 = true
+        
+        if let cache = PixelImage.cache, let contentHash = contentHash {
+            cache.store(pixelImageRepresentation, forContentHash: contentHash)
+        }
     }
     
     public var size: PixelSize { PixelSize(pixelImageRepresentation.size) }
@@ -124,6 +185,10 @@ final class PixelImage {
     }
     
     public func downsample(to pointSize: CGSize, scale: CGFloat) -> NSImage {
+        guard isEncoded else {
+            // not worth encoding the image, drawing scales it down
+            return NSImage(cgImage: cgImage, size: pointSize)
+        }
         let maxDimensionInPixels = max(pointSize.width, pointSize.height) * scale
         let downsampleOptions =  [
             // kCGImageSourceCreateThumbnailFromImageAlways: true,
@@ -141,51 +206,56 @@ final class PixelImage {
 #if WITH_LUASWIFT
 extension PixelImage: LuaSwift.Value {
     
+    /// Pushes a userdata whose pixel methods are native, see JSTLuaPixelImage.h.
     func push(_ vm: VirtualMachine)
     {
-        let t = vm.createTable()
-        let imageURL = imageSource.url
-        
-        t["type"] = String(describing: PixelImage.self)
-        
-        t["path"] = imageURL.path
-        t["folder"] = imageURL.deletingLastPathComponent().lastPathComponent
-        t["filename"] = imageURL.lastPathComponent
-        t["extension"] = imageURL.pathExtension.lowercased()
-        
-        t["width"] = size.width
-        t["height"] = size.height
-        t["size"] = size
+        if JSTLuaPixelImageRegister(vm.state) {
+            PixelImage.registerMethods(vm)
+        }
         
-        t["get_color"] = vm.createFunction([Int64.arg, Int64.arg], requiredArgumentCount: 2) {
-            (args) -> SwiftReturnValue in
+        let imageURL = url
+        let fields: [(String, Value)] = [
+            ("type", String(describing: PixelImage.self)),
             
-            let (x, y) = (args.integer, args.integer)
-            let coordinate = PixelCoordinate(x: Int(x), y: Int(y))
-            if let color = self.rawColor(at: coordinate)?.rgbaValue {
-                return .value(color)
-            }
-            else {
-                return .error(Content.Error.itemOutOfRange(item: coordinate, range: self.size).failureReason!)
-            }
+            ("path", imageURL.path),
+            ("folder", imageURL.deletingLastPathComponent().lastPathComponent),
+            ("filename", imageURL.lastPathComponent),
+            ("extension", imageURL.pathExtension.lowercased()),
+            
+            ("width", size.width),
+            ("height", size.height),
+            ("size", size),
+        ]
+        
+        JSTLuaPixelImagePush(vm.state, pixelImageRepresentation, self)
+        for (name, value) in fields {
+            value.push(vm)
+            JSTLuaPixelImageSetField(vm.state, -2, name)
         }
+    }
+    
+    /// Methods written in Swift, added once per state; they are given the image first.
+    private static func registerMethods(_ vm: VirtualMachine) {
         
-        t["get_image"] = vm.createFunction([Int64.arg, Int64.arg, Int64.arg, Int64.arg], requiredArgumentCount: 4) {
-            (args) -> SwiftReturnValue in
+        vm.createFunction([PixelImage.arg, Int64.arg, Int64.arg, Int64.arg, Int64.arg], requiredArgumentCount: 5) {
+            [unowned vm] (args) -> SwiftReturnValue in
             
+            let image = PixelImage.owner(of: args.userdata, in: vm)!
             let (x, y, w, h) = (args.integer, args.integer, args.integer, args.integer)
             let area = PixelArea(rect: PixelRect(x: Int(x), y: Int(y), width: Int(w), height: Int(h)))
-            if let data = self.pngRepresentation(of: area) {
+            if let data = image.pngRepresentation(of: area) {
                 return .value(data)
             }
             else {
-                return .error(Content.Error.itemOutOfRange(item: area, range: self.size).failureReason!)
+                return .error(Content.Error.itemOutOfRange(item: area, range: image.size).failureReason!)
             }
-        }
+        }.push(vm)
+        JSTLuaPixelImageSetMethod(vm.state, "get_image")
         
-        t["get_data"] = vm.createFunction([Bool.arg], requiredArgumentCount: 0) {
-            (args) -> SwiftReturnValue in
+        vm.createFunction([PixelImage.arg, Bool.arg], requiredArgumentCount: 1) {
+            [unowned vm] (args) -> SwiftReturnValue in
             
+            let image = PixelImage.owner(of: args.userdata, in: vm)!
             var withMetadata = false
             if args.count == 1 {
                 withMetadata = args.boolean
@@ -193,7 +263,7 @@ extension PixelImage: LuaSwift.Value {
             
             if withMetadata {
                 if let screenshots = ScreenshotController.shared.documents as? [Screenshot] {
-                    if let screenshot = screenshots.filter({ $0.image === self }).first,
+                    if let screenshot = screenshots.filter({ $0.image === image }).first,
                        let documentType = screenshot.fileType,
                        let screenshotData = try? screenshot.data(ofType: documentType)
                     {
@@ -202,40 +272,122 @@ extension PixelImage: LuaSwift.Value {
                 }
                 return .error(Content.Error.notLoaded.failureReason!)
             } else {
-                return .value(self.pngRepresentation())
+                return .value(image.pngRepresentation())
             }
-        }
-        
-        t.push(vm)
+        }.push(vm)
+        JSTLuaPixelImageSetMethod(vm.state, "get_data")
+    }
+    
+    private static func owner(of value: Value, in vm: VirtualMachine) -> PixelImage? {
+        value.push(vm)
+        return JSTLuaPixelImagePopOwner(vm.state) as? PixelImage
     }
     
-    func kind() -> Kind { return .table }
+    func kind() -> Kind { return .userdata }
     
-    private static let typeKeys: [String] = [
-        "type", "path", "folder",
-        "filename", "extension",
-        "width", "height",
-        "get_color", "get_image"
-    ]
-    private static let typeName: String = "\(String(describing: PixelImage.self)) (Table Keys [\(typeKeys.joined(separator: ","))])"
+    private static let typeName: String = "\(String(describing: PixelImage.self)) (Userdata)"
     class func arg(_ vm: VirtualMachine, value: Value) -> String? {
-        if value.kind() != .table { return typeName }
-        if let result = Table.arg(vm, value: value) { return result }
-        let t = value as! Table
-        if  !(t["type"] is String)              ||
-                !(t["path"] is String)          ||
-                !(t["folder"] is String)        ||
-                !(t["filename"] is String)      ||
-                !(t["extension"] is String)     ||
-                !(t["width"] is Number)         ||
-                !(t["height"] is Number)        ||
-                !(t["get_color"] is Function)   ||
-                !(t["get_image"] is Function)
-        {
-            return typeName
-        }
+        if value.kind() != .userdata { return typeName }
+        if owner(of: value, in: vm) == nil { return typeName }
         return nil
     }
     
 }
 #endif
+
+extension PixelImage {
+    
+    /// Keeps the decoded pixels of opened images in page aligned files named after the hash of the encoded ones, so that reopening an image maps its pixels instead of decoding it.
+    final class Cache {
+        
+        static let pathExtension = "jstpixel"
+        static let temporaryFileLifetime: TimeInterval = 60  // longer than any write
+        
+        let directoryURL: URL
+        let maximumSize: Int
+        private let ioQueue = DispatchQueue(label: "PixelImage.Cache.Queue", qos: .utility)
+        
+        init(directoryURL: URL, maximumSize: Int) {
+            self.directoryURL = directoryURL
+            self.maximumSize = maximumSize
+        }
+        
+        func fileURL(forContentHash contentHash: UInt64) -> URL {
+            return directoryURL
+                .appendingPathComponent(String(format: "%016llx", contentHash))
+                .appendingPathExtension(Cache.pathExtension)
+        }
+        
+        func pixelImage(forContentHash contentHash: UInt64) -> JSTPixelImage? {
+            let fileURL = self.fileURL(forContentHash: contentHash)
+            guard let pixelImage = JSTPixelImage(pixelCacheAtPath: fileURL.path, contentHash: contentHash) else {
+                return nil
+            }
+            ioQueue.async {
+                // recently used files are the last ones to be pruned
+                try? FileManager.default.setAttributes([.modificationDate: Date()], ofItemAtPath: fileURL.path)
+            }
+            return pixelImage
+        }
+        
+        func store(_ pixelImage: JSTPixelImage, forContentHash contentHash: UInt64) {
+            // copies share their pixels, writes to the original image will not race with us
+            let snapshot = pixelImage.copy() as! JSTPixelImage
+            let fileURL = self.fileURL(forContentHash: contentHash)
+            ioQueue.async { [weak self] in
+                guard let self = self else { return }
+                do {
+                    try FileManager.default.createDirectory(at: self.directoryURL, withIntermediateDirectories: true, attributes: nil)
+                } catch {
+                    debugPrint(error)
+                    return
+                }
+                guard snapshot.writePixelCache(toPath: fileURL.path, contentHash: contentHash) else {
+                    debugPrint("\(#function) cannot write \(fileURL.path)")
+                    return
+                }
+                self.prune()
+            }
+        }
+        
+        private func prune() {
+            let resourceKeys: [URLResourceKey] = [.contentModificationDateKey, .totalFileAllocatedSizeKey]
+            guard let fileURLs = try? FileManager.default.contentsOfDirectory(
+                at: directoryURL,
+                includingPropertiesForKeys: resourceKeys,
+                options: [.skipsHiddenFiles]
+            ) else {
+                return
+            }
+            
+            // temporaries of writes which never finished, "<hash>.jstpixel.XXXXXX" after a crash
+            let staleDate = Date(timeIntervalSinceNow: -Cache.temporaryFileLifetime)
+            for fileURL in fileURLs where fileURL.deletingPathExtension().pathExtension == Cache.pathExtension {
+                guard let values = try? fileURL.resourceValues(forKeys: Set(resourceKeys)),
+                      (values.contentModificationDate ?? .distantPast) < staleDate
+                else {
+                    continue
+                }
+                try? FileManager.default.removeItem(at: fileURL)
+            }
+            
+            let cachedFiles = fileURLs
+                .filter({ $0.pathExtension == Cache.pathExtension })
+                .compactMap({ fileURL -> (url: URL, date: Date, size: Int)? in
+                    guard let values = try? fileURL.resourceValues(forKeys: Set(resourceKeys)) else { return nil }
+                    return (fileURL, values.contentModificationDate ?? .distantPast, values.totalFileAllocatedSize ?? 0)
+                })
+                .sorted(by: { $0.date > $1.date })
+            
+            var totalSize = 0
+            for cachedFile in cachedFiles {
+                totalSize += cachedFile.size
+                if totalSize > maximumSize {
+                    try? FileManager.default.removeItem(at: cachedFile.url)
+                }
+            }
+        }
+        
+    }
+    
+}
@@ -122,6 +122,39 @@ final class Screenshot: NSDocument {
     
     // MARK: - Read & Write
     
+    private static let exifDateFormatter: DateFormatter = {
+        let formatter = DateFormatter()
+        formatter.dateFormat = "yyyy:MM:dd HH:mm:ss"
+        return formatter
+    }()
+    
+    /// Untitled document of a screenshot which has just been captured, encoded when it is saved for the first time.
+    convenience init(capturedImage image: PixelImage, at date: Date) {
+        self.init()
+        self.image = image
+        self.content = Content()
+        self.metadata = [
+            (kCGImagePropertyExifDictionary as String): [
+                (kCGImagePropertyExifDateTimeOriginal as String): Screenshot.exifDateFormatter.string(from: date)
+            ]
+        ]
+        self.fileType = "public.png"
+        self.displayName = image.url.deletingPathExtension().lastPathComponent
+        self.isCaptured = true
+        updateChangeCount(.changeDone)
+    }
+    
+    /// Created by a capture rather than read, its first save is as free as writing the screenshot file used to be.
+    private(set) var isCaptured: Bool = false
+    
+    override func prepareSavePanel(_ savePanel: NSSavePanel) -> Bool {
+        if fileURL == nil, let image = image {
+            savePanel.directoryURL = image.url.deletingLastPathComponent()
+            savePanel.nameFieldStringValue = image.url.lastPathComponent
+        }
+        return super.prepareSavePanel(savePanel)
+    }
+    
     override func read(from url: URL, ofType typeName: String) throws {
         let image = try PixelImage.init(contentsOf: url)
         self.image = image
@@ -184,23 +217,41 @@ final class Screenshot: NSDocument {
             //.autosaveAsOperation,
             //.autosaveElsewhereOperation,
         ]
-        if restrictedOperation.contains(saveOperation) {
+        if restrictedOperation.contains(saveOperation) && !(isCaptured && fileURL == nil) {
             try testExportCondition()
         }
         try super.writeSafely(to: url, ofType: typeName, for: saveOperation)
     }
     
     override func data(ofType typeName: String) throws -> Data {
-        guard let source = image?.imageSource else {
+        guard let image = image else {
             throw Error.invalidImageSource
         }
         
-        guard let uti = CGImageSourceGetType(source.cgSource), Screenshot.writableTypes.contains(uti as String) else {
-            throw Error.invalidImageType
+        // captured images are encoded here, from their pixels
+        let source = image.isEncoded ? image.imageSource : nil
+        
+        let uti: CFString
+        if let source = source {
+            guard let sourceType = CGImageSourceGetType(source.cgSource), Screenshot.writableTypes.contains(sourceType as String) else {
+                throw Error.invalidImageType
+            }
+            uti = sourceType
+        } else {
+            guard Screenshot.writableTypes.contains(typeName) else {
+                throw Error.invalidImageType
+            }
+            uti = typeName as CFString
         }
         
-        guard let metadata = CGImageSourceCopyPropertiesAtIndex(source.cgSource, 0, nil) as? [AnyHashable: Any] else {
-            throw Error.invalidImageProperties
+        let metadata: [AnyHashable: Any]
+        if let source = source {
+            guard let sourceMetadata = CGImageSourceCopyPropertiesAtIndex(source.cgSource, 0, nil) as? [AnyHashable: Any] else {
+                throw Error.invalidImageProperties
+            }
+            metadata = sourceMetadata
+        } else {
+            metadata = self.metadata ?? [:]
         }
         
         guard let content = content else {
@@ -224,7 +275,11 @@ final class Screenshot: NSDocument {
         // now it is allowed to unblock main thread from freezing
         unblockUserInteraction()
         
-        CGImageDestinationAddImageFromSource(destination, source.cgSource, 0, (metadataAsMutable as CFDictionary?))
+        if let source = source {
+            CGImageDestinationAddImageFromSource(destination, source.cgSource, 0, (metadataAsMutable as CFDictionary?))
+        } else {
+            CGImageDestinationAddImage(destination, image.cgImage, (metadataAsMutable as CFDictionary?))
+        }
         CGImageDestinationFinalize(destination)
         
         return destData as Data
@@ -277,7 +332,7 @@ final class Screenshot: NSDocument {
                 let currentWindow = tabService.firstRespondingWindow,
                 let currentWindowController = currentWindow.windowController as? WindowController
             {
-                if let document = currentWindowController.document as? Screenshot, let _ = document.fileURL {
+                if let document = currentWindowController.document as? Screenshot, document.fileURL != nil || document.isCaptured {
                     // load in new tab
                     let newWindowController = WindowController.newEmptyWindow()
                     try newWindowController.load(self)
@@ -367,10 +422,12 @@ final class Screenshot: NSDocument {
         }
         self.isExtractingContentItems = true
         
+        // the template stops at its next check, see TemplateScheduler
+        let cancellationToken = TemplateScheduler.CancellationToken()
+        
         let loadingAlert = NSAlert()
         loadingAlert.addButton(withTitle: NSLocalizedString("Cancel", comment: "copy(_:)"))
         loadingAlert.alertStyle = .informational
-        loadingAlert.buttons.first?.isHidden = true
         let loadingIndicator = NSProgressIndicator(frame: CGRect(x: 0, y: 0, width: 24.0, height: 24.0))
         loadingIndicator.style = .spinning
         loadingIndicator.sizeToFit()
@@ -378,30 +435,37 @@ final class Screenshot: NSDocument {
         loadingAlert.accessoryView = loadingIndicator
         loadingAlert.messageText = NSLocalizedString("Extract Snippets", comment: "copy(_:)")
         loadingAlert.informativeText = String(format: NSLocalizedString("Extract code snippets from template “%@”…", comment: "copy(_:)"), template.name)
-        loadingAlert.beginSheetModal(for: window) { _ in }
+        loadingAlert.beginSheetModal(for: window) { resp in
+            if resp == .alertFirstButtonReturn {
+                cancellationToken.cancel()
+            }
+        }
         
         DispatchQueue.global(qos: .userInitiated).async { [unowned self] in
-            do {
-                defer {
-                    DispatchQueue.main.async { [weak self] in
-                        loadingAlert.window.orderOut(self)
-                        window.endSheet(loadingAlert.window)
-                        self?.isExtractingContentItems = false
-                        completion?(true)
+            // the sheet is dismissed before completion, which only succeeds once the task has returned
+            func endSession(succeeded: Bool, error: Swift.Error? = nil) {
+                DispatchQueue.main.async { [weak self] in
+                    loadingAlert.window.orderOut(self)
+                    window.endSheet(loadingAlert.window)
+                    if let error = error {
+                        self?.presentError(error)
                     }
+                    self?.isExtractingContentItems = false
+                    completion?(succeeded)
                 }
-                
+            }
+            
+            do {
                 let startTime = CFAbsoluteTimeGetCurrent()
-                try task(template)
+                try cancellationToken.perform { try task(template) }
                 let timeElapsed = CFAbsoluteTimeGetCurrent() - startTime
                 
                 Swift.debugPrint("\(#function) elapsed: \(timeElapsed) s.")
+                endSession(succeeded: true)
+            } catch Template.Error.cancelled {
+                endSession(succeeded: false)
             } catch {
-                DispatchQueue.main.async { [weak self] in
-                    self?.presentError(error)
-                    self?.isExtractingContentItems = false
-                    completion?(false)
-                }
+                endSession(succeeded: false, error: error)
             }
         }
     }
@@ -25,8 +25,11 @@ final class Template {
         case invalidResultArgumentCount(type: String, count: Int, expectedCount: Int)
         case invalidResultArgumentType(type: String, index: Int, argType: String, expectedType: String)
         
-        case resourceBusy
         case invalidField(field: String)
+
+        case cancelled
+        case instructionLimitExceeded(limit: Int64)
+        case timeLimitExceeded(limit: TimeInterval)
         
         var errorCode: Int {
             switch self {
@@ -51,10 +54,15 @@ final class Template {
                 case .invalidResultArgumentType(_, _, _, _):
                     return 510
                     
-                case .resourceBusy:
-                    return 511
                 case .invalidField(_):
                     return 512
+
+                case .cancelled:
+                    return 513
+                case .instructionLimitExceeded(_):
+                    return 514
+                case .timeLimitExceeded(_):
+                    return 515
             }
         }
         
@@ -85,10 +93,15 @@ final class Template {
                     return String(format: NSLocalizedString(
                         "Unexpected argument #%ld type for result type “%@”, expected “%@”, got “%@”.", comment: "Template.Error"), index, type, expectedType, argType)
                     
-                case .resourceBusy:
-                    return NSLocalizedString("Resource busy.", comment: "Template.Error")
                 case let .invalidField(field):
                     return String(format: NSLocalizedString("Invalid field “%@”.", comment: "Template.Error"), field)
+
+                case .cancelled:
+                    return NSLocalizedString("Cancelled.", comment: "Template.Error")
+                case let .instructionLimitExceeded(limit):
+                    return String(format: NSLocalizedString("Instruction limit exceeded: template ran more than %lld instructions.", comment: "Template.Error"), limit)
+                case let .timeLimitExceeded(limit):
+                    return String(format: NSLocalizedString("Time limit exceeded: template ran more than %.1f seconds.", comment: "Template.Error"), limit)
             }
         }
     }
@@ -141,21 +154,64 @@ final class Template {
     private(set) var userExtension        : String?
     private(set) var allowedExtensions    : [String]
     private(set) var colorSpace           : InspectorFormat = .original
+    private(set) var instructionLimit     : Int64?          // of every generate call
+    private(set) var timeLimit            : TimeInterval?
 
     private(set) var isAsync              : Bool
     private(set) var isEnabled            : Bool
     private(set) var isPreviewable        : Bool
     private(set) var saveInPlace          : Bool
 
-    private(set) var items                : LuaSwift.Table?
-    private      var generator            : LuaSwift.Function
-    private      var mutexLock            = NSLock()
     private      var contentModification  : Date?
-
-    private      let vm                   : VirtualMachine
     weak         var manager              : TemplateManager?
+
+    // MARK: - Instances
+
+    /// A state of its own, with the template evaluated once, which runs one generate call at a time.
+    private final class Instance {
+        let items     : LuaSwift.Table?
+        let generator : LuaSwift.Function
+        let vm        : VirtualMachine      // released after the values it holds
+
+        init(vm: VirtualMachine, items: LuaSwift.Table?, generator: LuaSwift.Function) {
+            self.items = items
+            self.generator = generator
+            self.vm = vm
+        }
+    }
+
+    struct PoolStatistics {
+        var instanceCount         : Int = 0
+        var acquireCount          : Int = 0
+        var waitCount             : Int = 0     // acquisitions which found every instance busy
+        var totalWaitTime         : TimeInterval = 0
+        var maximumWaitTime       : TimeInterval = 0
+    }
+
+    static let maximumInstanceCount       = max(min(ProcessInfo.processInfo.activeProcessorCount, 4), 1)
+    /// Previews hold their instance while they wait for a slot of the scheduler and while they run,
+    /// one instance is kept for interactive actions unless there is only one.
+    static let maximumPreviewInstanceCount = max(maximumInstanceCount - 1, 1)
+
+    private      let instanceCondition    = NSCondition()
+    private      var idleInstances        : [Instance]          // guarded by instanceCondition
+    private      var instanceCount        : Int                 // guarded by instanceCondition
+    private      var previewInstanceCount = 0                   // guarded by instanceCondition
+    private      var interactiveWaitCount = 0                   // guarded by instanceCondition
+    private      var _poolStatistics      = PoolStatistics()    // guarded by instanceCondition
+
+    var poolStatistics: PoolStatistics {
+        instanceCondition.lock()
+        defer { instanceCondition.unlock() }
+        var statistics = _poolStatistics
+        statistics.instanceCount = instanceCount
+        return statistics
+    }
     
     static let currentPlatformVersion     = Bundle.main.object(forInfoDictionaryKey: "CFBundleShortVersionString") as! String
+
+    /// Previews run in the background with nobody to cancel them, they stop after this unless the template sets its own limit.
+    static let defaultPreviewTimeLimit    : TimeInterval = 5
     
     init(templateURL url: URL, templateManager manager: TemplateManager?) throws {
         self.url = url
@@ -163,17 +219,8 @@ final class Template {
 
         self.contentModification = url.contentModification
         
-        let vm = VirtualMachine(openLibs: true)
-        
-        if let bundleVersion = Bundle.main.bundleVersion {
-            vm.globals["platformVersion"] = bundleVersion
-        }
-        
-        vm.globals["applicationSupportDirectory"] = AppDelegate.supportDirectoryURL.path
-        vm.globals["self"] = url.path
-        
-        self.vm = vm
-        switch self.vm.eval(url, args: []) {
+        let vm = Template.makeVirtualMachine(url)
+        switch vm.eval(url, cache: TemplateManager.templateBytecodeCache, args: []) {
         case let .values(vals):
             guard let tab = vals.first as? Table else { throw Error.missingRootEntry }
             let stringDict = tab.asDictionary({ $0 as String }, { $0 as String })
@@ -205,6 +252,16 @@ final class Template {
                 }
             }
 
+            if let instructionLimit = tab["instructionLimit"] as? Number {
+                guard instructionLimit.isInteger, instructionLimit.toInteger() > 0 else { throw Error.invalidField(field: "instructionLimit") }
+                self.instructionLimit = instructionLimit.toInteger()
+            }
+
+            if let timeLimit = tab["timeLimit"] as? Number {
+                guard timeLimit.toDouble() > 0 else { throw Error.invalidField(field: "timeLimit") }
+                self.timeLimit = timeLimit.toDouble()
+            }
+
             if let async = boolDict["async"] {
                 self.isAsync = async
             } else {
@@ -229,26 +286,130 @@ final class Template {
                 self.saveInPlace = false
             }
 
-            self.items = tab["items"] as? LuaSwift.Table
-            
-            guard let generator = tab["generator"] as? LuaSwift.Function else { throw Error.missingRequiredField(field: "generator") }
-            
-            self.generator = generator
+            let instance = try Template.instance(vm, withRootEntry: tab)
+            self.idleInstances = [instance]
+            self.instanceCount = 1
+        case let .error(e):
+            throw Error.luaError(reason: e)
+        }
+    }
+
+    private static func makeVirtualMachine(_ url: URL) -> VirtualMachine {
+        let vm = VirtualMachine(openLibs: true)
+        
+        if let bundleVersion = Bundle.main.bundleVersion {
+            vm.globals["platformVersion"] = bundleVersion
+        }
+        
+        vm.globals["applicationSupportDirectory"] = AppDelegate.supportDirectoryURL.path
+        vm.globals["self"] = url.path
+        return vm
+    }
+
+    private static func instance(_ vm: VirtualMachine, withRootEntry tab: Table) throws -> Instance {
+        guard let generator = tab["generator"] as? LuaSwift.Function else { throw Error.missingRequiredField(field: "generator") }
+        return Instance(vm: vm, items: tab["items"] as? LuaSwift.Table, generator: generator)
+    }
+
+    private func makeInstance() throws -> Instance {
+        let vm = Template.makeVirtualMachine(url)
+        switch vm.eval(url, cache: TemplateManager.templateBytecodeCache, args: []) {
+        case let .values(vals):
+            guard let tab = vals.first as? Table else { throw Error.missingRootEntry }
+            return try Template.instance(vm, withRootEntry: tab)
         case let .error(e):
             throw Error.luaError(reason: e)
         }
     }
 
+    /// Takes an idle instance, loads one more while there are fewer than the maximum, or waits for one.
+    /// Interactive actions are served before previews, which may not take the instance kept for them.
+    private func acquireInstance(priority: TemplateScheduler.Priority) throws -> Instance {
+        let beginTime = DispatchTime.now().uptimeNanoseconds
+        var didWait = false
+        var instance: Instance?
+
+        instanceCondition.lock()
+        if priority == .interactive {
+            interactiveWaitCount += 1
+        }
+        while instance == nil {
+            if priority == .background &&
+                (interactiveWaitCount > 0 || previewInstanceCount >= Template.maximumPreviewInstanceCount)
+            {
+                didWait = true
+                instanceCondition.wait()
+            } else if let idleInstance = idleInstances.popLast() {
+                instance = idleInstance
+                if priority == .background {
+                    previewInstanceCount += 1
+                }
+            } else if instanceCount < Template.maximumInstanceCount {
+                instanceCount += 1
+                if priority == .background {
+                    previewInstanceCount += 1   // counted while it loads, so that no other preview takes the kept one
+                }
+                instanceCondition.unlock()
+                do {
+                    instance = try makeInstance()
+                } catch {
+                    instanceCondition.lock()
+                    instanceCount -= 1
+                    if priority == .interactive {
+                        interactiveWaitCount -= 1
+                    } else {
+                        previewInstanceCount -= 1
+                    }
+                    instanceCondition.broadcast()
+                    instanceCondition.unlock()
+                    throw error
+                }
+                instanceCondition.lock()
+            } else {
+                didWait = true
+                instanceCondition.wait()
+            }
+        }
+
+        if priority == .interactive {
+            interactiveWaitCount -= 1
+            instanceCondition.broadcast()   // previews held back by this one may go on
+        }
+        _poolStatistics.acquireCount += 1
+        if didWait {
+            let waitTime = TimeInterval(DispatchTime.now().uptimeNanoseconds - beginTime) / TimeInterval(NSEC_PER_SEC)
+            _poolStatistics.waitCount += 1
+            _poolStatistics.totalWaitTime += waitTime
+            _poolStatistics.maximumWaitTime = max(_poolStatistics.maximumWaitTime, waitTime)
+        }
+        instanceCondition.unlock()
+        return instance!
+    }
+
+    private func releaseInstance(_ instance: Instance, priority: TemplateScheduler.Priority) {
+        instanceCondition.lock()
+        idleInstances.append(instance)
+        if priority == .background {
+            previewInstanceCount -= 1
+        }
+        instanceCondition.broadcast()   // waiters of either priority, interactive ones first
+        instanceCondition.unlock()
+    }
+
+    private func withInstance<T>(priority: TemplateScheduler.Priority, _ body: (Instance) throws -> T) throws -> T {
+        let instance = try acquireInstance(priority: priority)
+        defer { releaseInstance(instance, priority: priority) }
+        return try body(instance)
+    }
+
     deinit {
         debugPrint("\(String(describing: Self.self)):\(#function)")
     }
     
-    func generate(_ image: PixelImage, _ items: [ContentItem], forAction action: GenerateAction) throws -> GenerateResult
+    /// Results of previews are taken from the cache while nothing given to the template has changed.
+    /// Async templates and interactive actions always run.
+    func generate(_ image: PixelImage, _ items: [ContentItem], forAction action: GenerateAction, cache: TemplateResultCache? = nil) throws -> GenerateResult
     {
-        guard mutexLock.try() else {
-            throw Error.resourceBusy
-        }
-        
         var targetColorSpace: NSColorSpace?
         switch colorSpace {
         case .original:
@@ -261,23 +422,61 @@ final class Template {
             targetColorSpace = .adobeRGB1998
         }
         
-        var convertedItems = [ContentItem]()
-        for item in items {
-            if let targetColorSpace = targetColorSpace,
-               let color = item as? PixelColor
-            {
-                convertedItems.append(color.copyEquivalentColor(inImage: image, ofColorSpace: targetColorSpace))
-            }
-            else
-            {
-                convertedItems.append(item.copy() as! ContentItem)
-            }
-        }
-        
-        let execContent = Content(items: convertedItems)
-        let results = generator.call([ image, execContent, action ])
+        // items are read by the template on demand, colors being converted only when read
+        let templateItems = Content.TemplateItems(
+            Content(items: items),
+            convertingColorsFrom: targetColorSpace != nil ? image.colorSpace : nil,
+            to: targetColorSpace
+        )
         
-        mutexLock.unlock()
+        guard let cache = cache,
+              !isAsync && !action.isInteractive,
+              let contentDigest = TemplateResultCache.contentDigest(of: items)
+        else {
+            return try generate(image, templateItems, forAction: action)
+        }
+
+        let key = TemplateResultCache.Key(
+            templateUUID: uuid,
+            templateVersion: version,
+            templateModification: contentModification,
+            contentDigest: contentDigest,
+            imageIdentifier: ObjectIdentifier(image),
+            imagePath: image.url.path,
+            action: action
+        )
+        if let cachedResult = cache.result(forKey: key, image: image) {
+            return try cachedResult.get()
+        }
+        let result = Result { try generate(image, templateItems, forAction: action) }
+        switch result {
+        case .failure(Error.cancelled), .failure(Error.timeLimitExceeded(_)):
+            break  // may well succeed next time
+        default:
+            cache.setResult(result, forKey: key, image: image)
+        }
+        return try result.get()
+    }
+
+    private func budget(forAction action: GenerateAction) -> Coroutine.Budget {
+        return Coroutine.Budget(
+            instructionLimit: instructionLimit ?? 0,
+            timeLimit: timeLimit ?? (action.isInteractive ? 0 : Template.defaultPreviewTimeLimit),
+            timeSlice: action.isInteractive ? 0 : TemplateScheduler.timeSlice  // previews give way to interactive actions
+        )
+    }
+
+    private func generate(_ image: PixelImage, _ templateItems: Content.TemplateItems, forAction action: GenerateAction) throws -> GenerateResult
+    {
+        let priority: TemplateScheduler.Priority = action.isInteractive ? .interactive : .background
+        let results = try withInstance(priority: priority) {
+            try TemplateScheduler.shared.call(
+                $0.generator,
+                [ image, templateItems, action ],
+                priority: priority,
+                budget: budget(forAction: action)
+            )
+        }
         
         switch results {
         case let .values(vals):
@@ -467,6 +666,10 @@ extension Template {
     }
     
     func parseItems() throws -> [TemplateItem]? {
+        return try withInstance(priority: .interactive) { try parseItems($0.items) }
+    }
+
+    private func parseItems(_ items: LuaSwift.Table?) throws -> [TemplateItem]? {
         
         guard let items = items else { return nil }
         
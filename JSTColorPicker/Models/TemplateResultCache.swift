@@ -0,0 +1,110 @@
+//
+//  TemplateResultCache.swift
+//  JSTColorPicker
+//
+//  Created by Darwin on 10/17/26.
+//  Copyright © 2026 JST. All rights reserved.
+//
+
+import Foundation
+import CryptoKit
+
+/// Results of templates, so that a template is only run again once something it is given has changed:
+/// the template itself, the items after their color space conversion, the image or the action.
+final class TemplateResultCache {
+
+    struct Key: Hashable {
+        let templateUUID          : UUID
+        let templateVersion       : String
+        let templateModification  : Date?
+        let contentDigest         : Data      // SHA-256 of the encoded items
+        let imageIdentifier       : ObjectIdentifier
+        let imagePath             : String
+        let action                : Template.GenerateAction
+    }
+
+    struct Statistics {
+        var hitCount              : Int = 0
+        var missCount             : Int = 0
+    }
+
+    private struct Entry {
+        weak var image            : PixelImage?   // an identifier may be reused once its image is gone
+        let result                : Result<Template.GenerateResult, Swift.Error>
+    }
+
+    let capacity                  : Int
+    private let lock              = MutexLock()
+    private var entries           = [Key: Entry]()      // guarded by lock
+    private var recentKeys        = [Key]()             // guarded by lock, the least recently used first
+    private var statistics        = [UUID: Statistics]()  // guarded by lock
+
+    init(capacity: Int = 64) {
+        self.capacity = max(capacity, 1)
+    }
+
+    static func contentDigest(of items: [ContentItem]) -> Data? {
+        guard let encodedItems = try? PropertyListEncoder().encode(items) else { return nil }
+        return Data(SHA256.hash(data: encodedItems))
+    }
+
+    func result(forKey key: Key, image: PixelImage) -> Result<Template.GenerateResult, Swift.Error>? {
+        lock.lock()
+        defer { lock.unlock() }
+        guard let entry = entries[key], entry.image === image else {
+            statistics[key.templateUUID, default: Statistics()].missCount += 1
+            return nil
+        }
+        if let index = recentKeys.firstIndex(of: key) {
+            recentKeys.remove(at: index)
+        }
+        recentKeys.append(key)
+        statistics[key.templateUUID, default: Statistics()].hitCount += 1
+        return entry.result
+    }
+
+    func setResult(_ result: Result<Template.GenerateResult, Swift.Error>, forKey key: Key, image: PixelImage) {
+        lock.lock()
+        defer { lock.unlock() }
+        if entries.updateValue(Entry(image: image, result: result), forKey: key) != nil,
+           let index = recentKeys.firstIndex(of: key)
+        {
+            recentKeys.remove(at: index)
+        }
+        recentKeys.append(key)
+        while recentKeys.count > capacity {
+            entries.removeValue(forKey: recentKeys.removeFirst())
+        }
+    }
+
+    /// Forgets the results of a template, its next run enters Lua again.
+    func removeResults(ofTemplateUUID uuid: UUID) {
+        lock.lock()
+        defer { lock.unlock() }
+        recentKeys.removeAll(where: { $0.templateUUID == uuid })
+        entries = entries.filter({ $0.key.templateUUID != uuid })
+    }
+
+    func removeAllResults() {
+        lock.lock()
+        defer { lock.unlock() }
+        recentKeys.removeAll()
+        entries.removeAll()
+    }
+
+    func statistics(ofTemplateUUID uuid: UUID) -> Statistics {
+        lock.lock()
+        defer { lock.unlock() }
+        return statistics[uuid] ?? Statistics()
+    }
+
+    var totalStatistics: Statistics {
+        lock.lock()
+        defer { lock.unlock() }
+        return statistics.values.reduce(into: Statistics()) {
+            $0.hitCount += $1.hitCount
+            $0.missCount += $1.missCount
+        }
+    }
+
+}
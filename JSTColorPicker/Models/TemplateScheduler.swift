@@ -0,0 +1,184 @@
+//
+//  TemplateScheduler.swift
+//  JSTColorPicker
+//
+//  Created by Darwin on 10/17/26.
+//  Copyright © 2026 JST. All rights reserved.
+//
+
+import Foundation
+import LuaSwift
+
+/// Runs the generators of templates, each in a coroutine under the budget of its template, see `LuaSwift.Coroutine`.
+/// Interactive actions run at once, while previews wait for one of `slotCount` slots, first come first served,
+/// and give it back at the end of every time slice while interactive actions take more than every slot.
+final class TemplateScheduler {
+
+    enum Priority {
+        case background
+        case interactive
+    }
+
+    /// Cancels the calls made on the threads it is current for, see `perform(_:)`.
+    final class CancellationToken {
+
+        private static let threadDictionaryKey = "TemplateScheduler.CancellationToken"
+
+        private let lock                  = MutexLock()
+        private var _isCancelled          = false                       // guarded by lock
+        private var coroutines            = [ObjectIdentifier: Coroutine]()  // guarded by lock
+
+        var isCancelled: Bool {
+            lock.lock()
+            defer { lock.unlock() }
+            return _isCancelled
+        }
+
+        /// May be called from any thread, calls which are running stop at their next check.
+        func cancel() {
+            lock.lock()
+            _isCancelled = true
+            // coroutines are only released by the calls, on their own threads
+            coroutines.values.forEach({ $0.cancel() })
+            lock.unlock()
+            TemplateScheduler.shared.wakeWaitingCalls()
+        }
+
+        /// Makes the token current for the calls made by body on this thread.
+        func perform<T>(_ body: () throws -> T) rethrows -> T {
+            let threadDictionary = Foundation.Thread.current.threadDictionary
+            let previousToken = threadDictionary[CancellationToken.threadDictionaryKey]
+            threadDictionary[CancellationToken.threadDictionaryKey] = self
+            defer { threadDictionary[CancellationToken.threadDictionaryKey] = previousToken }
+            return try body()
+        }
+
+        static var current: CancellationToken? {
+            Foundation.Thread.current.threadDictionary[threadDictionaryKey] as? CancellationToken
+        }
+
+        fileprivate func add(_ coroutine: Coroutine) {
+            lock.lock()
+            coroutines[ObjectIdentifier(coroutine)] = coroutine
+            if _isCancelled {
+                coroutine.cancel()
+            }
+            lock.unlock()
+        }
+
+        fileprivate func remove(_ coroutine: Coroutine) {
+            lock.lock()
+            coroutines.removeValue(forKey: ObjectIdentifier(coroutine))
+            lock.unlock()
+        }
+    }
+
+    static let shared                     = TemplateScheduler(slotCount: Template.maximumInstanceCount)
+    static let timeSlice                  : TimeInterval = 0.01
+
+    let slotCount                         : Int
+    private let condition                 = NSCondition()
+    private var runningCount              = 0           // guarded by condition
+    private var waitingTickets            = [UInt64]()  // guarded by condition, previews in the order they get their slots
+    private var nextTicket                : UInt64 = 0  // guarded by condition
+
+    init(slotCount: Int) {
+        self.slotCount = max(slotCount, 1)
+    }
+
+    /// Calls the function in a coroutine, on this thread, cancelled with the current token if any.
+    /// The virtual machine of the function must not run anything else meanwhile.
+    func call(
+        _ function: LuaSwift.Function,
+        _ args: [Value],
+        priority: Priority,
+        budget: Coroutine.Budget
+    ) throws -> FunctionResults
+    {
+        let coroutine = Coroutine(function, args, budget: budget)
+        let cancellationToken = CancellationToken.current
+        cancellationToken?.add(coroutine)
+        defer { cancellationToken?.remove(coroutine) }
+
+        try beginRunning(coroutine, priority: priority, isResuming: false)
+        var isRunning = true
+        defer {
+            if isRunning {
+                endRunning()
+            }
+        }
+
+        while true {
+            switch coroutine.resume() {
+            case let .values(vals):
+                return .values(vals)
+            case let .error(e):
+                return .error(e)
+            case .suspended:
+                if priority == .background && shouldGiveBackSlot {
+                    endRunning()
+                    isRunning = false
+                    try beginRunning(coroutine, priority: priority, isResuming: true)
+                    isRunning = true
+                }
+            case .cancelled:
+                throw Template.Error.cancelled
+            case .instructionLimitExceeded:
+                throw Template.Error.instructionLimitExceeded(limit: budget.instructionLimit)
+            case .timeLimitExceeded:
+                throw Template.Error.timeLimitExceeded(limit: budget.timeLimit)
+            }
+        }
+    }
+
+    /// Takes a slot, at once for interactive calls, or waits for a slot and for the previews which came first.
+    private func beginRunning(_ coroutine: Coroutine, priority: Priority, isResuming: Bool) throws {
+        condition.lock()
+        defer { condition.unlock() }
+
+        guard priority == .background else {
+            runningCount += 1
+            return
+        }
+
+        let ticket = nextTicket
+        nextTicket += 1
+        if isResuming {
+            waitingTickets.insert(ticket, at: 0)    // before the previews which have not started yet
+        } else {
+            waitingTickets.append(ticket)
+        }
+
+        while waitingTickets.first != ticket || runningCount >= slotCount {
+            if coroutine.isCancelled {
+                waitingTickets.removeAll(where: { $0 == ticket })
+                condition.broadcast()
+                throw Template.Error.cancelled
+            }
+            condition.wait()
+        }
+
+        waitingTickets.removeFirst()
+        runningCount += 1
+        condition.broadcast()   // the next one may fit in another slot
+    }
+
+    private func endRunning() {
+        condition.lock()
+        runningCount -= 1
+        condition.broadcast()
+        condition.unlock()
+    }
+
+    private var shouldGiveBackSlot: Bool {
+        condition.lock()
+        defer { condition.unlock() }
+        return runningCount > slotCount
+    }
+
+    fileprivate func wakeWaitingCalls() {
+        condition.lock()
+        condition.broadcast()
+        condition.unlock()
+    }
+}
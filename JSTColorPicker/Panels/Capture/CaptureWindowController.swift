@@ -0,0 +1,235 @@
+//
+//  CaptureWindowController.swift
+//  JSTColorPicker
+//
+//  Created by Darwin on 10/17/26.
+//  Copyright © 2026 JST. All rights reserved.
+//
+
+import Cocoa
+
+/// Shows the frames of a capture stream, the slider scrubs through the ones still in the ring.
+/// Frames are shown straight from the ring, nothing is decoded while scrubbing.
+final class CaptureWindowController: NSWindowController {
+
+    static var sharedLoaded = false
+    static let shared: CaptureWindowController = {
+        sharedLoaded = true
+        return CaptureWindowController()
+    }()
+
+    var isVisible: Bool { window?.isVisible ?? false }
+
+    /// Called with a copy of the displayed frame, which does not hold its slot in the ring.
+    var openFrameHandler: ((JSTPixelImage) -> Void)?
+
+    private(set) var stream: CaptureStream?
+    private var frames = [CaptureStream.Frame]()
+    private var displayedFrame: CaptureStream.Frame?
+    private var displayedImage: JSTPixelImage?  // keeps the displayed slot from being written
+    private var followsLatestFrame = true
+
+    private let imageView = NSImageView()
+    private let slider = NSSlider()
+    private let statusLabel = NSTextField(labelWithString: "")
+    private let toggleButton = NSButton()
+    private let openButton = NSButton()
+
+    private var streamObservations = [NSObjectProtocol]()
+
+    private init() {
+        let window = NSPanel(
+            contentRect: CGRect(x: 0, y: 0, width: 360, height: 560),
+            styleMask: [.titled, .closable, .resizable, .utilityWindow],
+            backing: .buffered,
+            defer: true
+        )
+        window.title = NSLocalizedString("Continuous Capture", comment: "CaptureWindowController")
+        window.isReleasedWhenClosed = false
+        window.hidesOnDeactivate = false
+        window.minSize = CGSize(width: 280, height: 320)
+        super.init(window: window)
+        window.delegate = self
+        setupViews(in: window)
+        window.center()
+    }
+
+    required init?(coder: NSCoder) {
+        fatalError("init(coder:) has not been implemented")
+    }
+
+    private func setupViews(in window: NSWindow) {
+        imageView.imageScaling = .scaleProportionallyUpOrDown
+        imageView.imageFrameStyle = .none
+
+        slider.minValue = 0
+        slider.maxValue = 0
+        slider.isContinuous = true
+        slider.target = self
+        slider.action = #selector(sliderValueChanged(_:))
+
+        statusLabel.font = NSFont.monospacedDigitSystemFont(ofSize: NSFont.smallSystemFontSize, weight: .regular)
+        statusLabel.textColor = .secondaryLabelColor
+        statusLabel.lineBreakMode = .byTruncatingTail
+
+        toggleButton.bezelStyle = .rounded
+        toggleButton.target = self
+        toggleButton.action = #selector(toggleButtonTapped(_:))
+
+        openButton.bezelStyle = .rounded
+        openButton.title = NSLocalizedString("Open Frame", comment: "CaptureWindowController")
+        openButton.target = self
+        openButton.action = #selector(openButtonTapped(_:))
+
+        let buttonStack = NSStackView(views: [statusLabel, toggleButton, openButton])
+        buttonStack.orientation = .horizontal
+        statusLabel.setContentCompressionResistancePriority(.defaultLow, for: .horizontal)
+
+        let stack = NSStackView(views: [imageView, slider, buttonStack])
+        stack.orientation = .vertical
+        stack.alignment = .width
+        stack.edgeInsets = NSEdgeInsets(top: 12, left: 12, bottom: 12, right: 12)
+        imageView.setContentHuggingPriority(.defaultLow, for: .vertical)
+        imageView.setContentCompressionResistancePriority(.defaultLow, for: .vertical)
+
+        window.contentView = stack
+        reloadControls()
+    }
+
+
+    // MARK: - Stream
+
+    func attach(_ stream: CaptureStream) {
+        detach()
+        self.stream = stream
+        followsLatestFrame = true
+        streamObservations = [
+            NotificationCenter.default.addObserver(forName: CaptureStream.frameDidArriveNotification, object: stream, queue: .main) { [weak self] _ in
+                self?.reloadFrames()
+            },
+            NotificationCenter.default.addObserver(forName: CaptureStream.streamDidFailNotification, object: stream, queue: .main) { [weak self] noti in
+                guard let self = self else { return }
+                self.reloadControls()
+                if let error = noti.userInfo?[CaptureStream.errorUserInfoKey] as? Error, let window = self.window {
+                    NSAlert(error: error).beginSheetModal(for: window, completionHandler: nil)
+                }
+            },
+        ]
+        stream.start()
+        reloadFrames()
+    }
+
+    func detach() {
+        stream?.stop()
+        streamObservations.forEach { NotificationCenter.default.removeObserver($0) }
+        streamObservations.removeAll()
+        stream = nil
+        frames.removeAll()
+        displayedFrame = nil
+        displayedImage = nil
+        imageView.image = nil
+        reloadControls()
+    }
+
+    private func reloadFrames() {
+        guard let stream = stream else { return }
+        frames = stream.frames
+        slider.maxValue = Double(max(frames.count - 1, 0))
+        slider.numberOfTickMarks = frames.count > 1 ? frames.count : 0
+        slider.allowsTickMarkValuesOnly = true
+        if followsLatestFrame || displayedFrame.map({ frame in !frames.contains(where: { $0.sequence == frame.sequence }) }) ?? true {
+            // the displayed frame is the latest, or it has been overwritten
+            slider.doubleValue = slider.maxValue
+        }
+        displayFrame(at: Int(slider.doubleValue))
+    }
+
+    private func displayFrame(at index: Int) {
+        guard let stream = stream, frames.indices.contains(index) else {
+            reloadControls()
+            return
+        }
+        let frame = frames[index]
+        if frame.sequence != displayedFrame?.sequence {
+            if let pixelImage = stream.pixelImage(of: frame) {
+                displayedFrame = frame
+                displayedImage = pixelImage
+                imageView.image = pixelImage.toSystemImage()
+            }
+        }
+        reloadControls()
+    }
+
+    private func reloadControls() {
+        let isRunning = stream?.isRunning ?? false
+        toggleButton.title = isRunning
+            ? NSLocalizedString("Stop", comment: "CaptureWindowController")
+            : NSLocalizedString("Start", comment: "CaptureWindowController")
+        toggleButton.isEnabled = stream != nil
+        openButton.isEnabled = displayedFrame != nil
+        slider.isEnabled = frames.count > 1
+
+        guard let stream = stream else {
+            statusLabel.stringValue = ""
+            statusLabel.toolTip = nil
+            return
+        }
+        let statistics = stream.statistics
+        statusLabel.toolTip = statistics.helper.map {
+            String(
+                format: NSLocalizedString("Helper: %.1f fps, %.0f ms waiting, %.0f ms capturing", comment: "CaptureWindowController"),
+                $0.framesPerSecond, $0.averageWait, $0.averageDuration
+            )
+        }
+        if let displayedFrame = displayedFrame, let latestFrame = frames.last {
+            let age = Double(latestFrame.timestamp - min(displayedFrame.timestamp, latestFrame.timestamp)) / Double(NSEC_PER_SEC)
+            statusLabel.stringValue = String(
+                format: NSLocalizedString("#%llu, -%.2f s, %llu dropped", comment: "CaptureWindowController"),
+                displayedFrame.sequence, age, statistics.droppedCount
+            )
+        } else {
+            statusLabel.stringValue = String(
+                format: NSLocalizedString("Waiting for frames, %llu dropped", comment: "CaptureWindowController"),
+                statistics.droppedCount
+            )
+        }
+    }
+
+
+    // MARK: - Actions
+
+    @objc private func sliderValueChanged(_ sender: NSSlider) {
+        followsLatestFrame = Int(sender.doubleValue) >= frames.count - 1
+        displayFrame(at: Int(sender.doubleValue))
+    }
+
+    @objc private func toggleButtonTapped(_ sender: NSButton) {
+        guard let stream = stream else { return }
+        if stream.isRunning {
+            stream.stop()
+        } else {
+            followsLatestFrame = true
+            stream.start()
+        }
+        reloadControls()
+    }
+
+    @objc private func openButtonTapped(_ sender: NSButton) {
+        guard let stream = stream,
+              let displayedFrame = displayedFrame,
+              let pixelImage = stream.detachedPixelImage(of: displayedFrame)
+        else {
+            return
+        }
+        openFrameHandler?(pixelImage)
+    }
+
+}
+
+extension CaptureWindowController: NSWindowDelegate {
+
+    func windowWillClose(_ notification: Notification) {
+        detach()
+    }
+
+}
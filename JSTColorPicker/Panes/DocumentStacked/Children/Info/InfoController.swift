@@ -34,11 +34,15 @@ final class InfoController: StackedPaneController {
     override func load(_ screenshot: Screenshot) throws {
         try super.load(screenshot)
         if style == .primary {
-            self.imageSource = screenshot.image?.imageSource
+            // captures have no file to describe until they are saved
+            self.imageSource = screenshot.fileURL != nil ? screenshot.image?.imageSource : nil
 
             documentObservations = [
                 observe(\.screenshot?.fileURL, options: [.new]) { (target, change) in
                     if let newURL = change.newValue, let url = newURL {
+                        if target.imageSource == nil {
+                            target.imageSource = target.screenshot?.image?.imageSource
+                        }
                         target.updateInformationPane(alternativeURL: url)
                     } else {
                         target.updateInformationPane()
@@ -74,9 +78,14 @@ final class InfoController: StackedPaneController {
             }
             nextButton.isHidden = true
         } else {
-            let errorString = style == .primary
-                ? NSLocalizedString("Open or drop an image here.", comment: "reloadPane()")
-                : nextHint()
+            let errorString: String
+            if style == .primary {
+                errorString = screenshot?.image != nil
+                    ? NSLocalizedString("Save the screenshot to show its information.", comment: "reloadPane()")
+                    : NSLocalizedString("Open or drop an image here.", comment: "reloadPane()")
+            } else {
+                errorString = nextHint()
+            }
             errorLabel.attributedStringValue = errorString.markdownAttributed
             infoView.isHidden = true
             errorLabel.isHidden = false
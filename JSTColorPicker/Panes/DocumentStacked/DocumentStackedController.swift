@@ -81,7 +81,8 @@ extension DocumentStackedController: PixelMatchResponder {
     }
 
     private var isInComparisonMode: Bool {
-        return primaryInfoController?.imageSource != nil && secondaryInfoController?.imageSource != nil
+        // the primary source is missing while a captured screenshot is not saved
+        return (primaryInfoController?.imageSource != nil || screenshot?.image != nil) && secondaryInfoController?.imageSource != nil
     }
     
 }
@@ -968,6 +968,7 @@ extension TemplatePreviewController {
 
     @IBAction private func regenerate(_ sender: NSMenuItem) {
         guard let template = try? promiseCheckSelectedTemplate().wait() else { return }
+        documentExport?.templateResultCache.removeResults(ofTemplateUUID: template.uuid)
         partialProcessPreviewContextForTemplates([template], force: true)
     }
 
@@ -1344,6 +1345,25 @@ by \(template.author ?? "Unknown")
 ------
 \(template.userDescription ?? "")
 """
+                    if let statistics = documentExport?.templateResultCache.statistics(ofTemplateUUID: template.uuid),
+                       statistics.hitCount + statistics.missCount > 0
+                    {
+                        cell.toolTip! += "\n------\n" + String(
+                            format: NSLocalizedString("Cached previews: %ld hits, %ld misses", comment: "TemplatePreviewController"),
+                            statistics.hitCount,
+                            statistics.missCount
+                        )
+                    }
+                    let poolStatistics = template.poolStatistics
+                    if poolStatistics.acquireCount > 0 {
+                        cell.toolTip! += "\n------\n" + String(
+                            format: NSLocalizedString("Instances: %ld, %ld of %ld runs waited, %.0f ms at most", comment: "TemplatePreviewController"),
+                            poolStatistics.instanceCount,
+                            poolStatistics.waitCount,
+                            poolStatistics.acquireCount,
+                            poolStatistics.maximumWaitTime * 1000
+                        )
+                    }
                 } else {
                     cell.toolTip = Template.Error
                         .unsatisfiedPlatformVersion(version: template.platformVersion).failureReason
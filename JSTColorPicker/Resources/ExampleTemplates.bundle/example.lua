@@ -1,15 +1,22 @@
 local generator = function (image, items)
     --[=[
-    --    `image` is a lua table which represents the opened image document in current window:
+    --    `image` is a lua userdata which represents the opened image document in current window,
+    --    its fields may be copied into a table with `pairs(image)`:
     --        `image.path`
     --        `image.filename`
     --        `image.width`: image width in pixels
     --        `image.height`: image height in pixels
     --        `image.get_color(x, y)`: returns **argb** 32-bit integer value of color
+    --        `image.get_colors(points)`: returns a sequence of colors, each point being `{x, y}` or `{x = x, y = y}`
+    --        `image.get_row(y)`: returns a sequence of colors of the row
+    --        `image.find_color(points[, region[, limit]])`: searches the image like `screen.find_color`, returns the anchors of the matches and their count
+    --        `image.find_image(area_or_image[, region[, similarity[, limit]]])`: searches the image like `screen.find_image`, returns the top left corners of the matches, with their similarity, and their count
     --        `image.get_image(x, y, w, h)`: returns png data representation
     ]=]
     --[=[
-    --    `items` is a lua sequence of *colors* and *areas*:
+    --    `items` is a lua userdata which reads like a sequence of *colors* and *areas*, with `#items`, `items[i]` and `ipairs(items)`,
+    --    `items.colors` and `items.areas` are sequences of either, and `items.get_data()` returns the archived items;
+    --    fields of an item are read on demand, and may be copied into a table with `pairs(item)`:
     --    *color* item:
     --        `color.id`
     --        `color.name`
@@ -43,14 +50,21 @@ local generator = function (image, items)
             return tostring(o)
         end
     end
-    --
-    local function chunk(text, size)
-        local s = {}
-        for i = 1, #text, size do
-            s[#s + 1] = text:sub(i, i + size - 1)
-        end
-        return s
-    end
+    --[=[
+    --    `require("bytes")` encodes the binary data of `image.get_image` in one call:
+    --        `bytes.hex_escape(data[, columns])`: "\x89\x50..." string literal, broken into lines of `columns` bytes
+    --        `bytes.base64(data[, columns])`: base64 with padding, broken into lines of `columns` characters
+    --        `bytes.array(data[, style[, columns]])`: "c" `{ 0x89, ... }` or "swift" `[ 0x89, ... ]` array literal, 12 bytes per row by default
+    --        `bytes.runs(data[, width])`: run-length summary of units of `width` bytes, such as `ffffffff*120 ff000000`, and the number of runs
+    ]=]
+    local bytes = require("bytes")
+    --[=[
+    --    The generator runs in a coroutine of its own, and stops once it exceeds the `instructionLimit` or the `timeLimit` of
+    --    the template, or once the user cancels it; previews of templates without a `timeLimit` stop after 5 seconds.
+    --    Previews are paused every few milliseconds while copy and export actions run, and `coroutine.yield()` pauses
+    --    the generator where it is safe to, between two long steps for instance. Native calls, such as cURL requests,
+    --    are never interrupted: the generator stops once they return.
+    ]=]
     if #items == 1 then
         local processed = false
         local str = "x, y = screen.find_image("
@@ -58,9 +72,7 @@ local generator = function (image, items)
         str = str .. "[[\n"
         for _, a in ipairs(items) do
             if a.width ~= nil then
-                str = str .. table.concat(chunk(image.get_image(a.minX, a.minY, a.width, a.height):gsub(".", function (c)
-                    return string.format("\\x%02x", string.byte(c))
-                end), 64), "\n")
+                str = str .. bytes.hex_escape(image.get_image(a.minX, a.minY, a.width, a.height), 16)
                 extraEndings = ", " .. string.format("%6.2f", a.similarity * 100.0) .. ", " .. tostring(a.minX) .. ", " .. tostring(a.minY) .. ", " .. tostring(a.maxX) .. ", " .. tostring(a.maxY)
                 processed = true
             end
@@ -97,4 +109,6 @@ return {
     generator = generator,                          -- required, the content generator
     enabled = true,                                 -- optional, default is true
     previewable = false,                            -- optional, default is false
+    timeLimit = 10,                                 -- optional, seconds each call may run, default is no limit
+    -- instructionLimit = 100000000,               -- optional, Lua instructions each call may run, default is no limit
 }
@@ -34,7 +34,11 @@ local _saveInPlace = true
 
 local generator = function (image, items, action)
     local newObjects = {}
-    for k, v in ipairs(items) do
+    for k, item in ipairs(items) do
+        local v = {}
+        for field, value in pairs(item) do
+            v[field] = value
+        end
         if v.userInfo ~= nil then
             v['userInfoXML'] = '\n        ' .. xml2lua.toXml(v.userInfo, 'userInfo'):sub(1, -2):gsub("[\n]", "\n        ")
         else
@@ -47,11 +51,15 @@ local generator = function (image, items, action)
             newObjects[k] = v
         end
     end
-    image['objects'] = newObjects
-    image['database'] = 'Unknown'
-    image['depth'] = 3
-    image['segmented'] = 0
-    local outputContent = lupa.expand(template, image)
+    local document = {}
+    for k, v in pairs(image) do
+        document[k] = v
+    end
+    document['objects'] = newObjects
+    document['database'] = 'Unknown'
+    document['depth'] = 3
+    document['segmented'] = 0
+    local outputContent = lupa.expand(template, document)
     if _saveInPlace then
         -- HTTP Post
         if action == "doubleCopy" then
@@ -65,19 +73,17 @@ local generator = function (image, items, action)
                 :perform()
                 :close()
         elseif action == "export" then
-            image['get_color'] = nil
-            image['get_image'] = nil
-            image['_LUPAFILENAME'] = nil
-            image['_LUPAPOSITION'] = nil
-            image['_LUPASOURCE'] = nil
+            document['_LUPAFILENAME'] = nil
+            document['_LUPAPOSITION'] = nil
+            document['_LUPASOURCE'] = nil
             
-            outputPath = image['path'] .. '.json'
+            outputPath = document['path'] .. '.json'
             outputFile = assert(io.open(outputPath, "w"))
-            outputFile:write(json.encode(image))
+            outputFile:write(json.encode(document))
             outputFile:close()
             
             local outputPath, outputFile
-            outputPath = image['path'] .. '.xml'
+            outputPath = document['path'] .. '.xml'
             outputFile = assert(io.open(outputPath, "w"))
             outputFile:write(outputContent)
             outputFile:close()
@@ -1,15 +1,23 @@
 local generator = function (image, items)
     local str = "x, y = screen.find_color("
     local extraEndings = ""
+    local colors, area = {}, nil
     str = str .. "{\n"
     for _, a in ipairs(items) do
         if a.color ~= nil then
+            colors[#colors + 1] = a
             str = str .. "  { " .. string.format("%4d", a.x) .. ", " .. string.format("%4d", a.y) .. ", " .. string.format("0x%06x", a.color & 0xffffff) .. ", " .. string.format("%6.2f", a.similarity * 100.0) .. " },  -- " .. tostring(a.id) .. "\n"
         elseif #extraEndings == 0 then
+            area = a
             extraEndings = ", " .. string.format("%6.2f", a.similarity * 100.0) .. ", " .. tostring(a.minX) .. ", " .. tostring(a.minY) .. ", " .. tostring(a.maxX) .. ", " .. tostring(a.maxY)
         end
     end
     str = str .. "}" .. extraEndings .. ")"
+    if #colors > 0 and image.find_color ~= nil then
+        -- warn about colors that would match at more than one position
+        local _, count = image:find_color(colors, area, 1)
+        str = str .. "  -- " .. tostring(count) .. (count == 1 and " match" or " matches")
+    end
     return str
 end
 
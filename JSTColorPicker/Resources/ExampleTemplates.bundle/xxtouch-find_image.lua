@@ -1,20 +1,27 @@
+local bytes = require("bytes")
+
 local generator = function (image, items)
     local processed = false
+    local area = nil
     local str = "x1, y1, x2, y2, sim = screen.find_image("
     local extraEndings = ""
     str = str .. "\""
     for _, a in ipairs(items) do
         if a.width ~= nil then
-            str = str .. image.get_image(a.minX, a.minY, a.width, a.height):gsub(".", function (c)
-                return string.format("\\x%02x", string.byte(c))
-            end)
+            str = str .. bytes.hex_escape(image.get_image(a.minX, a.minY, a.width, a.height))
             extraEndings = ", " .. string.format("%6.2f", a.similarity * 100.0)
             processed = true
+            area = a
             break
         end
     end
     str = str .. "\"" .. extraEndings .. ")"
     if processed then
+        if image.find_image ~= nil then
+            -- warn about areas which would match at more than one place
+            local _, count = image:find_image(area, nil, nil, 1)
+            str = str .. "  -- " .. tostring(count) .. (count == 1 and " match" or " matches")
+        end
         return str
     end
     error("未选中有效图像区域")
@@ -0,0 +1,234 @@
+//
+//  CaptureStream.swift
+//  JSTColorPicker
+//
+//  Created by Darwin on 10/17/26.
+//  Copyright © 2026 JST. All rights reserved.
+//
+
+import Cocoa
+
+/// Pulls shared screenshots from the helper at a fixed rate into a ring of preallocated frames.
+/// A tick which finds the previous request still in flight is dropped, not queued.
+final class CaptureStream {
+
+    struct Frame {
+        let sequence: UInt64
+        let timestamp: UInt64  // uptime in nanoseconds
+    }
+
+    /// The device as measured by the helper, see `JSTScreenshotHelperProtocol.captureStatistics(byUDID:withReply:)`.
+    struct HelperStatistics {
+        let framesPerSecond: Double
+        let averageWait: Double      // milliseconds waiting for the transport
+        let averageDuration: Double  // milliseconds capturing
+    }
+
+    struct Statistics {
+        let pushedCount: UInt64
+        let droppedCount: UInt64
+        let frameCount: Int
+        let helper: HelperStatistics?
+    }
+
+    static let frameDidArriveNotification = Notification.Name("CaptureStream.frameDidArriveNotification")
+    static let streamDidFailNotification = Notification.Name("CaptureStream.streamDidFailNotification")
+    static let errorUserInfoKey = "error"
+
+    let deviceUDID: String
+    let frameRate: Double
+    let frameCount: Int
+
+    private let proxy: JSTScreenshotHelperProtocol
+    private let frameTransport: FrameTransport
+    private let captureQueue = DispatchQueue(label: "com.jst.JSTColorPicker.CaptureStream", qos: .userInitiated)
+    private var timer: DispatchSourceTimer?
+
+    // guarded by captureQueue
+    private var isRequesting = false
+    private var skippedCount: UInt64 = 0
+    private var helperStatistics: HelperStatistics?
+    private var helperStatisticsTime: UInt64 = 0
+
+    private let ringLock = ReadWriteLock()
+    private var ring: OpaquePointer?
+    private(set) var colorSpace = CGColorSpace(name: CGColorSpace.sRGB)!
+
+    init(proxy: JSTScreenshotHelperProtocol, frameTransport: FrameTransport, deviceUDID: String, frameRate: Double, frameCount: Int) {
+        self.proxy = proxy
+        self.frameTransport = frameTransport
+        self.deviceUDID = deviceUDID
+        self.frameRate = max(0.1, frameRate)
+        self.frameCount = max(1, frameCount)
+    }
+
+    deinit {
+        timer?.cancel()
+        JSTPixelRingFree(ring)
+    }
+
+    // start and stop on the main thread
+    var isRunning: Bool { timer != nil }
+
+    func start() {
+        guard timer == nil else { return }
+        let timer = DispatchSource.makeTimerSource(queue: captureQueue)
+        timer.schedule(deadline: .now(), repeating: 1.0 / frameRate, leeway: .milliseconds(5))
+        timer.setEventHandler { [weak self] in
+            self?.captureNextFrame()
+        }
+        timer.resume()
+        self.timer = timer
+    }
+
+    func stop() {
+        timer?.cancel()
+        timer = nil
+    }
+
+
+    // MARK: - Capturing
+
+    private func captureNextFrame() {
+        guard !isRequesting else {
+            skippedCount += 1
+            return
+        }
+        isRequesting = true
+        refreshHelperStatistics()
+        frameTransport.takeSharedScreenshot(proxy, byUDID: deviceUDID) { [weak self] result in
+            guard let self = self else { return }
+            self.captureQueue.async {
+                self.isRequesting = false
+            }
+            switch result {
+                case .success(let sharedFrame):
+                    // the shared slot is given back to the helper as soon as it is copied into the ring
+                    guard self.pushFrame(sharedFrame.pixelImage, at: sharedFrame.timestamp) else {
+                        return
+                    }
+                    DispatchQueue.main.async {
+                        NotificationCenter.default.post(name: CaptureStream.frameDidArriveNotification, object: self)
+                    }
+                case .failure(FrameTransport.Error.frameOverwritten):
+                    self.captureQueue.async {
+                        self.skippedCount += 1
+                    }
+                case .failure(let error):
+                    DispatchQueue.main.async {
+                        self.stop()
+                        NotificationCenter.default.post(name: CaptureStream.streamDidFailNotification, object: self, userInfo: [CaptureStream.errorUserInfoKey: error])
+                    }
+            }
+        }
+    }
+
+    /// About once a second while the stream runs.
+    private func refreshHelperStatistics() {
+        let now = DispatchTime.now().uptimeNanoseconds
+        guard now - helperStatisticsTime >= NSEC_PER_SEC else { return }
+        helperStatisticsTime = now
+        proxy.captureStatistics(byUDID: deviceUDID) { [weak self] (data, _) in
+            guard let self = self,
+                  let data = data,
+                  let dict = try? PropertyListSerialization.propertyList(from: data, options: [], format: nil) as? [String: NSNumber]
+            else {
+                return
+            }
+            let statistics = HelperStatistics(
+                framesPerSecond: dict["framesPerSecond"]?.doubleValue ?? 0,
+                averageWait: dict["averageWait"]?.doubleValue ?? 0,
+                averageDuration: dict["averageDuration"]?.doubleValue ?? 0
+            )
+            self.captureQueue.async {
+                self.helperStatistics = statistics
+            }
+        }
+    }
+
+    private func pushFrame(_ pixelImage: JSTPixelImage, at timestamp: UInt64) -> Bool {
+        let width = pixelImage.internalPointer.pointee.width
+        let height = pixelImage.internalPointer.pointee.height
+        guard width > 0, height > 0 else {
+            return false
+        }
+
+        // the ring copes with concurrent pushes and reads, the lock only guards replacing it
+        ringLock.readLock()
+        let status = pushFrame(pixelImage, at: timestamp, into: ring)
+        ringLock.unlock()
+        guard status == JST_PIXEL_RING_STATUS_SIZE_MISMATCH else {
+            return status == JST_PIXEL_RING_STATUS_PUSHED
+        }
+
+        // the device rotated or switched display modes, frames of the old size are gone
+        ringLock.writeLock()
+        defer { ringLock.unlock() }
+        JSTPixelRingFree(ring)
+        ring = JSTPixelRingCreate(Int32(frameCount), width, height)
+        guard ring != nil else { return false }
+        colorSpace = pixelImage.colorSpace
+        return pushFrame(pixelImage, at: timestamp, into: ring) == JST_PIXEL_RING_STATUS_PUSHED
+    }
+
+    private func pushFrame(_ pixelImage: JSTPixelImage, at timestamp: UInt64, into ring: OpaquePointer?) -> JST_PIXEL_RING_STATUS {
+        guard let ring = ring else { return JST_PIXEL_RING_STATUS_SIZE_MISMATCH }
+        // the image leases its slot of the transport, it must outlive the copy
+        return withExtendedLifetime(pixelImage) {
+            let image = pixelImage.internalPointer.pointee
+            return JSTPixelRingPush(ring, image.pixels, image.width, image.height, Int(image.alignedWidth) * MemoryLayout<JST_COLOR>.stride, image.orientation, timestamp)
+        }
+    }
+
+
+    // MARK: - Scrubbing
+
+    /// Frames in the ring, oldest first.
+    var frames: [Frame] {
+        ringLock.readLock()
+        defer { ringLock.unlock() }
+        guard let ring = ring else { return [] }
+        var infos = [JST_PIXEL_RING_FRAME_INFO](repeating: JST_PIXEL_RING_FRAME_INFO(), count: frameCount)
+        let count = Int(JSTPixelRingGetFrames(ring, &infos, Int32(infos.count)))
+        return infos.prefix(min(count, infos.count)).map { Frame(sequence: $0.sequence, timestamp: $0.timestamp) }
+    }
+
+    /// Shares the pixels of the frame, which is not overwritten while the image is alive.
+    /// Returns nil if the frame has already been overwritten.
+    func pixelImage(of frame: Frame) -> JSTPixelImage? {
+        ringLock.readLock()
+        defer { ringLock.unlock() }
+        guard let ring = ring, let image = JSTPixelRingCopyFrame(ring, frame.sequence, nil) else {
+            return nil
+        }
+        return JSTPixelImage(internalPointer: image, colorSpace: colorSpace)
+    }
+
+    /// Same as pixelImage(of:), but copies the pixels so that the slot is written again.
+    /// Use it for images which outlive the stream, such as documents.
+    func detachedPixelImage(of frame: Frame) -> JSTPixelImage? {
+        guard let pixelImage = pixelImage(of: frame),
+              JSTPixelImageMakeUnique(pixelImage.internalPointer) != 0
+        else {
+            return nil
+        }
+        return pixelImage
+    }
+
+    var statistics: Statistics {
+        let (skippedCount, helperStatistics) = captureQueue.sync { (self.skippedCount, self.helperStatistics) }
+        ringLock.readLock()
+        defer { ringLock.unlock() }
+        var ringStatistics = JST_PIXEL_RING_STATISTICS()
+        if let ring = ring {
+            JSTPixelRingGetStatistics(ring, &ringStatistics)
+        }
+        return Statistics(
+            pushedCount: ringStatistics.pushedCount,
+            droppedCount: ringStatistics.droppedCount + skippedCount,
+            frameCount: Int(ringStatistics.frameCount),
+            helper: helperStatistics
+        )
+    }
+
+}
@@ -0,0 +1,150 @@
+//
+//  FrameTransport.swift
+//  JSTColorPicker
+//
+//  Created by Darwin on 10/17/26.
+//  Copyright © 2026 JST. All rights reserved.
+//
+
+import Cocoa
+
+/// Maps the frame transport of the helper, so that screenshots come over XPC as a few attributes
+/// and are read straight from the shared memory.
+/// The mapping is opened again whenever the helper starts writing into another transport.
+final class FrameTransport {
+
+    enum Error: CustomNSError, LocalizedError {
+        case frameOverwritten
+
+        var errorCode: Int {
+            switch self {
+                case .frameOverwritten:
+                    return 801
+            }
+        }
+
+        var failureReason: String? {
+            switch self {
+                case .frameOverwritten:
+                    return NSLocalizedString("The frame has been overwritten before it could be read.", comment: "FrameTransport.Error")
+            }
+        }
+    }
+
+    struct SharedFrame {
+        let pixelImage: JSTPixelImage
+        let timestamp: UInt64  // uptime in nanoseconds, when the helper wrote the frame
+    }
+
+    private let transportQueue = DispatchQueue(label: "com.jst.JSTColorPicker.FrameTransport")
+    private var transport: OpaquePointer?  // guarded by transportQueue
+
+    deinit {
+        JSTPixelTransportFree(transport)
+    }
+
+    /// Unmaps the transport, images taken from it stay valid.
+    func close() {
+        transportQueue.sync {
+            JSTPixelTransportFree(transport)
+            transport = nil
+        }
+    }
+
+    /// The pixels of the image are shared with the helper, which does not write into them while the image is alive.
+    /// Use JSTPixelImageMakeUnique for images which are kept around, such as documents.
+    func takeSharedScreenshot(_ proxy: JSTScreenshotHelperProtocol, byUDID udid: String, completionHandler: @escaping (Result<SharedFrame, Swift.Error>) -> Void) {
+        proxy.takeSharedScreenshot(byUDID: udid) { [weak self] (attributesData, error) in
+            guard let self = self else { return }
+            if let error = error {
+                completionHandler(.failure(error))
+                return
+            }
+            guard let attributesData = attributesData,
+                  let attributes = try? PropertyListSerialization.propertyList(from: attributesData, options: [], format: nil) as? [String: Any],
+                  let frame = FrameTransport.frame(withAttributes: attributes)
+            else {
+                completionHandler(.failure(AppDelegate.XPCError.malformedResponse))
+                return
+            }
+            let colorSpace = FrameTransport.colorSpace(withAttributes: attributes)
+
+            if let sharedFrame = self.sharedFrame(frame, colorSpace: colorSpace) {
+                completionHandler(.success(sharedFrame))
+                return
+            }
+
+            // first frame, or the helper has replaced its transport
+            proxy.openFrameTransport { (fileHandle, error) in
+                if let error = error {
+                    completionHandler(.failure(error))
+                    return
+                }
+                guard let fileHandle = fileHandle,
+                      let transport = JSTPixelTransportOpen(fileHandle.fileDescriptor)
+                else {
+                    completionHandler(.failure(AppDelegate.XPCError.malformedResponse))
+                    return
+                }
+                self.transportQueue.sync {
+                    JSTPixelTransportFree(self.transport)
+                    self.transport = transport
+                }
+                if let sharedFrame = self.sharedFrame(frame, colorSpace: colorSpace) {
+                    completionHandler(.success(sharedFrame))
+                } else {
+                    completionHandler(.failure(Error.frameOverwritten))
+                }
+            }
+        }
+    }
+
+    private func sharedFrame(_ frame: JST_PIXEL_TRANSPORT_FRAME, colorSpace: CGColorSpace) -> SharedFrame? {
+        var frame = frame
+        return transportQueue.sync {
+            guard let transport = transport,
+                  JSTPixelTransportGetIdentifier(transport) == frame.identifier,
+                  let image = JSTPixelTransportCreatePixelImage(transport, &frame)
+            else {
+                return nil
+            }
+            return SharedFrame(pixelImage: JSTPixelImage(internalPointer: image, colorSpace: colorSpace), timestamp: frame.timestamp)
+        }
+    }
+
+    private static func frame(withAttributes attributes: [String: Any]) -> JST_PIXEL_TRANSPORT_FRAME? {
+        guard let identifier = attributes[kJSTSharedScreenshotTransportKey] as? UInt64,
+              let sequence = attributes[kJSTSharedScreenshotSequenceKey] as? UInt64,
+              let timestamp = attributes[kJSTSharedScreenshotTimestampKey] as? UInt64,
+              let slot = attributes[kJSTSharedScreenshotSlotKey] as? Int32,
+              let width = attributes[kJSTRawScreenshotWidthKey] as? Int32,
+              let height = attributes[kJSTRawScreenshotHeightKey] as? Int32
+        else {
+            return nil
+        }
+        let orientation = attributes[kJSTRawScreenshotOrientationKey] as? Int32 ?? 0
+        return JST_PIXEL_TRANSPORT_FRAME(
+            identifier: identifier,
+            sequence: sequence,
+            timestamp: timestamp,
+            slot: slot,
+            width: width,
+            height: height,
+            orientation: orientation
+        )
+    }
+
+    static func colorSpace(withAttributes attributes: [String: Any]) -> CGColorSpace {
+        if let iccData = attributes[kJSTRawScreenshotColorSpaceICCKey] as? Data,
+           let iccColorSpace = CGColorSpace(iccData: iccData as CFData)
+        {
+            return iccColorSpace
+        } else if let colorSpaceName = attributes[kJSTRawScreenshotColorSpaceNameKey] as? String,
+                  let namedColorSpace = CGColorSpace(name: colorSpaceName as CFString)
+        {
+            return namedColorSpace
+        }
+        return CGColorSpace(name: CGColorSpace.sRGB)!
+    }
+
+}
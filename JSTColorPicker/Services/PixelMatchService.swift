@@ -45,10 +45,38 @@ final class PixelMatchService {
         
     }
     
+    struct Region: Codable {
+        let x: Int
+        let y: Int
+        let width: Int
+        let height: Int
+        let pixelCount: Int
+        let centroidX: Double  // mean coordinates of the different pixels
+        let centroidY: Double
+        
+        init(_ region: JST_PIXEL_MATCH_REGION) {
+            x = Int(region.x)
+            y = Int(region.y)
+            width = Int(region.width)
+            height = Int(region.height)
+            pixelCount = Int(region.pixelCount)
+            centroidX = region.centroidX
+            centroidY = region.centroidY
+        }
+    }
+    
+    struct Result {
+        let differenceImage: JSTPixelImage?  // nil if only counting
+        let diffCount: Int                   // lower bound if the budget is exceeded
+        let totalCount: Int
+        let isBudgetExceeded: Bool
+        let regions: [Region]                // empty unless extracting regions
+    }
+    
     public private(set) var isProcessing: Bool = false
     
 #if WITH_COCOA
-    public func performConcurrentPixelMatch(_ img1: JSTPixelImage, _ img2: JSTPixelImage) throws -> JSTPixelImage {
+    public func performConcurrentPixelMatch(_ img1: JSTPixelImage, _ img2: JSTPixelImage) throws -> Result {
         var options = MatchOptions()
         options.threshold = UserDefaults.standard[.pixelMatchThreshold]
         options.includeAA = UserDefaults.standard[.pixelMatchIncludeAA]
@@ -60,11 +88,22 @@ final class PixelMatchService {
             options.diffColor = (UInt8(diffColor.redComponent * 255.0), UInt8(diffColor.greenComponent * 255.0), UInt8(diffColor.blueComponent * 255.0))
         }
         options.diffMask = UserDefaults.standard[.pixelMatchDiffMask]
+        options.extractRegions = true
         return try performConcurrentPixelMatch(img1, img2, options: options)
     }
 #endif
     
-    public func performConcurrentPixelMatch(_ img1: JSTPixelImage, _ img2: JSTPixelImage, options: MatchOptions) throws -> JSTPixelImage {
+    public func performConcurrentPixelMatch(_ img1: JSTPixelImage, _ img2: JSTPixelImage, options: MatchOptions) throws -> Result {
+        var options = options
+        options.countOnly = false
+        let result = try performConcurrentPixelComparison(img1, img2, options: options)
+        guard result.diffCount > 0, result.differenceImage != nil else {
+            throw PixelMatchService.Error.noDifferenceDetected
+        }
+        return result
+    }
+    
+    public func performConcurrentPixelComparison(_ img1: JSTPixelImage, _ img2: JSTPixelImage, options: MatchOptions) throws -> Result {
         guard !isProcessing else { throw PixelMatchService.Error.taskConflict }
         isProcessing = true
         
@@ -82,107 +121,72 @@ final class PixelMatchService {
 
         // MARK: - Concurrent Perform
 
-        var threadCount: Int = 32
-        let upperBound = min(Int(ceil(sqrt(Double(totalRows)))), max(options.maximumThreadCount, 1))
-        for tCount in stride(from: upperBound, to: 1, by: -1) {
-            if totalRows % tCount == 0 {
-                threadCount = tCount
-                break
-            }
+        // workers read both images in place and write their tiles into the same output,
+        // neighbours of the anti-aliasing detection are read across tile boundaries,
+        // rotated captures are compared as oriented, so the output has the oriented size
+        let img = options.countOnly ? nil : JSTCreatePixelImage(Int32(totalColumns), Int32(totalRows))!
+        var matchOptions = options.pixelMatchOptions
+        guard let job = JSTPixelMatchJobCreate(img1.internalPointer, img2.internalPointer, img, &matchOptions, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, 0) else {
+            JSTFreePixelImage(img)
+            isProcessing = false
+            throw PixelMatchService.Error.sizeDoesNotMatch(size1: img1.size, size2: img2.size)
         }
-        if options.verbose {
-            print("thread count: \(threadCount)", to: &outputStream)
+        defer { JSTPixelMatchJobFree(job) }
+        if options.extractRegions {
+            _ = JSTPixelMatchJobSetCollectsRegions(job, 1)
         }
 
-        let partialRows = totalRows / threadCount
-        , partialCount = totalColumns * partialRows
-
-        var diffCount: Int = 0
-        var threadOutputs: [Int: [JST_COLOR]] = [:]
-        let threadQueue = DispatchQueue(label: "SyncQueue")
+        // tiles are taken on demand, so the worker count does not need to divide the height
+        let threadCount = max(min(options.maximumThreadCount, Int(JSTPixelMatchJobGetTileCount(job)), ProcessInfo.processInfo.activeProcessorCount), 1)
+        if options.verbose {
+            print("thread count: \(threadCount), tile count: \(JSTPixelMatchJobGetTileCount(job))", to: &outputStream)
+            print("kernel: \(String(cString: JSTPixelMatchKernelGetName(JST_PIXEL_MATCH_KERNEL_AUTOMATIC)))", to: &outputStream)
+        }
 
-        DispatchQueue.concurrentPerform(iterations: threadCount) { (idx) in
-            
-            let processCount = options.includeAA || threadCount == 1 ? partialCount : (idx == 0 || idx == threadCount - 1 ? partialCount + totalColumns * 2 : partialCount + totalColumns * 4)
-            let processRows  = options.includeAA || threadCount == 1 ? partialRows  : (idx == 0 || idx == threadCount - 1 ? partialRows  + 2                : partialRows  + 4)
-            let rowOffset    = options.includeAA || idx == 0         ? 0            : totalColumns * 2
-            
-            let beginOffset  = idx * partialCount - rowOffset
-            let endOffset    = beginOffset + processCount
-            if options.verbose {
-                if options.includeAA {
-                    threadQueue.sync {
-                        print("thread#\(idx): process[\(beginOffset)..<\(endOffset)](\(processCount))", to: &outputStream)
-                    }
-                }
-                else {
-                    let validBegin   = beginOffset + rowOffset
-                    let validEnd     = validBegin  + partialCount
-                    threadQueue.sync {
-                        print("thread#\(idx): process[\(beginOffset)..<\(endOffset)](\(processCount))->valid[\(validBegin)..<\(validEnd)](\(partialCount))", to: &outputStream)
-                    }
-                }
-            }
-            
-            var threadOutputs0 = [JST_COLOR](
-                repeating: JST_COLOR(theColor: 0),
-                count: processCount
-            )
-            var a32 = Array(UnsafeBufferPointer(
-                start: img1.internalPointer.pointee.pixels + beginOffset,
-                count: processCount
-            ))
-            var b32 = Array(UnsafeBufferPointer(
-                start: img2.internalPointer.pointee.pixels + beginOffset,
-                count: processCount
-            ))
-            
-            let diffCount0 = try! PixelMatch(
-                a32: &a32,
-                b32: &b32,
-                output: &threadOutputs0,
-                width: totalColumns,
-                height: processRows,
-                options: options
-            )
-            
-            threadQueue.sync {
-                threadOutputs[idx] = Array(threadOutputs0[rowOffset..<rowOffset + partialCount])
-                diffCount += diffCount0
-            }
-            
+        DispatchQueue.concurrentPerform(iterations: threadCount) { _ in
+            JSTPixelMatchJobPerform(job)
         }
+        let diffCount = Int(JSTPixelMatchJobGetDiffCount(job))
+        let isBudgetExceeded = JSTPixelMatchJobIsBudgetExceeded(job) != 0
         
-        var outputs: [JST_COLOR] = []
-        for idx in 0..<threadCount {
-            outputs += threadOutputs[idx]!
+        var regions: [Region] = []
+        if options.extractRegions {
+            var regionCount: Int32 = 0
+            if let regionsPointer = JSTPixelMatchJobGetRegions(job, &regionCount) {
+                regions = UnsafeBufferPointer(start: regionsPointer, count: Int(regionCount)).map({ Region($0) })
+            }
         }
-        let outputsPointer = UnsafeMutableBufferPointer<JST_COLOR>.allocate(capacity: totalCount)
-        _ = outputsPointer.initialize(from: outputs)
         
 
         // MARK: - Output Differences
 
         let timeElapsed = CFAbsoluteTimeGetCurrent() - startTime
         print(String(format: "time elapsed: %.3fs", timeElapsed), to: &outputStream)
-        print(String(format: "approximate count: \(diffCount), difference: %.3f%%", Double(diffCount) / Double(totalCount) * 100.0), to: &outputStream)
-        guard diffCount > 0 else {
-            isProcessing = false
-            throw PixelMatchService.Error.noDifferenceDetected
+        if isBudgetExceeded {
+            print("count: more than \(options.diffBudget ?? 0), stopped early", to: &outputStream)
+        } else {
+            print(String(format: "count: \(diffCount), difference: %.3f%%", Double(diffCount) / Double(totalCount) * 100.0), to: &outputStream)
+        }
+        if options.extractRegions {
+            print("regions: \(regions.count)", to: &outputStream)
         }
         
-        let img = UnsafeMutablePointer<JST_IMAGE>.allocate(capacity: 1)
-        img.pointee.orientation = 0
-        img.pointee.isDestroyed = 0
-        img.pointee.width = Int32(totalColumns)
-        img.pointee.alignedWidth = Int32(totalColumns)
-        img.pointee.height = Int32(totalRows)
-        img.pointee.pixels = outputsPointer.baseAddress
         isProcessing = false
         
-        let colorSpace = CGColorSpaceCreateDeviceRGB()
-        let pixelImg = JSTPixelImage(internalPointer: img, colorSpace: colorSpace)
-        return pixelImg
+        var pixelImg: JSTPixelImage?
+        if let img = img {
+            let colorSpace = CGColorSpaceCreateDeviceRGB()
+            pixelImg = JSTPixelImage(internalPointer: img, colorSpace: colorSpace)
+        }
+        return Result(differenceImage: pixelImg, diffCount: diffCount, totalCount: totalCount, isBudgetExceeded: isBudgetExceeded, regions: regions)
     }
     
 }
+
+#if WITH_COCOA
+extension PixelMatchService.Region {
+    var pixelArea: PixelArea {
+        return PixelArea(rect: PixelRect(x: x, y: y, width: width, height: height))
+    }
+}
+#endif
@@ -611,6 +611,16 @@ extension SplitController: PixelMatchResponder {
         childPixelMatchResponders.forEach({ $0.endPixelMatchComparison() })
     }
     
+    @discardableResult
+    func importContentItems(_ items: [ContentItem]) -> [ContentItem] {
+        do {
+            return try contentController.importContentItems(items)
+        } catch {
+            presentError(error)
+        }
+        return []
+    }
+    
 }
 
 
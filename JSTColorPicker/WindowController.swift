@@ -81,6 +81,7 @@ class WindowController: NSWindowController {
     private  var lastStoredMagnification        : CGFloat?
     private  var _windowSubtitle                : String?
     private  var isInComparisonMode             : Bool = false
+    private  var pixelMatchRegions              : [PixelMatchService.Region] = []
     
     lazy     var pixelMatchService              : PixelMatchService = {
         return PixelMatchService()
@@ -350,8 +351,10 @@ class WindowController: NSWindowController {
         queue.async { [weak self] in
             guard let self = self else { return }
             do {
-                let maskImage = try self.pixelMatchService.performConcurrentPixelMatch(currentPixelImage.pixelImageRepresentation, image.pixelImageRepresentation)
+                let result = try self.pixelMatchService.performConcurrentPixelMatch(currentPixelImage.pixelImageRepresentation, image.pixelImageRepresentation)
+                let maskImage = result.differenceImage!
                 DispatchQueue.main.sync { [weak self] in
+                    self?.pixelMatchRegions = result.regions
                     self?.splitController.beginPixelMatchComparison(to: image, with: maskImage) { [weak self] (shouldExit) in
                         if shouldExit {
                             self?.endPixelMatchComparison()
@@ -379,9 +382,19 @@ class WindowController: NSWindowController {
             splitController.endPixelMatchComparison()
             showSheet(nil, completionHandler: nil)
             isInComparisonMode = false
+            pixelMatchRegions.removeAll()
         }
     }
     
+    var canImportPixelMatchRegions: Bool {
+        return shouldEndPixelMatchComparison && !pixelMatchRegions.isEmpty
+    }
+    
+    func importPixelMatchRegions() {
+        guard canImportPixelMatchRegions else { return }
+        splitController.importContentItems(pixelMatchRegions.map({ $0.pixelArea }))
+    }
+    
     
     // MARK: - Options
     
@@ -11,6 +11,13 @@
 
 #import "JSTPixelColor.h"
 #import "JSTPixelImage.h"
+#import "JSTLuaContent.h"
+#import "JSTLuaPixelImage.h"
+#import "JSTPixelFind.h"
+#import "JSTPixelFindImage.h"
+#import "JSTPixelMatch.h"
+#import "JSTPixelRing.h"
+#import "JSTPixelTransport.h"
 #import "JSTScreenshotHelperProtocol.h"
 #import "OpenCVWrapper.h"
 #import "SPUStandardUpdaterController.h"
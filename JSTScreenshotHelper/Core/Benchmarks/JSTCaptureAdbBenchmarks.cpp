@@ -0,0 +1,88 @@
+#include "JSTBenchmark.h"
+#include "JSTCaptureAdb.h"
+#include "JSTCapturePNG.h"
+
+#include <thread>
+#include <vector>
+
+
+/* A common Android phone, 1080x2400 */
+static const int kBenchmarkWidth = 1080;
+static const int kBenchmarkHeight = 2400;
+
+/* RGBA_8888 frame with a dataspace, as screencap writes it since Android 8. */
+static std::vector<uint8_t> JSTBenchmarkMakeFrame(const JST_IMAGE *image)
+{
+    std::vector<uint8_t> frame(16 + (size_t)kBenchmarkWidth * kBenchmarkHeight * 4);
+    const uint32_t header[4] = { (uint32_t)kBenchmarkWidth, (uint32_t)kBenchmarkHeight, 1, 142671872 };
+    for (int i = 0; i < 16; ++i) {
+        frame[(size_t)i] = (uint8_t)(header[i / 4] >> (8 * (i % 4)));
+    }
+    uint8_t *samples = frame.data() + 16;
+    for (size_t i = 0; i < (size_t)kBenchmarkWidth * kBenchmarkHeight; ++i, samples += 4) {
+        JST_COLOR color = image->pixels[i];
+        samples[0] = color.red;
+        samples[1] = color.green;
+        samples[2] = color.blue;
+        samples[3] = color.alpha;
+    }
+    return frame;
+}
+
+/* Flat bars and cards with a little noise where text would be, so that
+ * deflate sees what it sees in a real screenshot rather than noise. */
+static void JSTBenchmarkFillScreenshot(JST_IMAGE *image)
+{
+    JSTBenchmarkFillPixelImage(image, 7);
+    for (int y = 0; y < image->height; ++y) {
+        JST_COLOR *row = image->pixels + (size_t)y * image->alignedWidth;
+        bool isCard = (y / 160) % 2 == 1;
+        for (int x = 0; x < image->width; ++x) {
+            bool isText = isCard && (y % 160) > 40 && (y % 160) < 70 && x > 48 && x < 700;
+            if (!isText) {
+                row[x].theColor = isCard ? 0xFFFFFFFFu : 0xFF000000u | (uint32_t)(0xF0 - y / 40) << 16 | 0xF0F0u;
+            }
+        }
+    }
+}
+
+int main() {
+    int iterations = JSTBenchmarkIterations(10);
+    size_t pixelsCount = (size_t)kBenchmarkWidth * kBenchmarkHeight;
+    int threadCount = (int)std::max(std::thread::hardware_concurrency(), 1u);
+    JST_IMAGE *image = JSTCreatePixelImage(kBenchmarkWidth, kBenchmarkHeight);
+    JSTBenchmarkFillScreenshot(image);
+    std::vector<uint8_t> frame = JSTBenchmarkMakeFrame(image);
+
+    JSTBenchmark("JSTCaptureAdbConvertFrame/RGBA", pixelsCount, iterations, [&] {
+        JST_BOOL converted = JSTCaptureAdbConvertFrame(frame.data(), frame.size(), image->pixels, image->alignedWidth, 1);
+        JSTBenchmarkKeep(converted);
+    });
+
+    JSTBenchmark("JSTCaptureAdbConvertFrame/RGBA all threads", pixelsCount, iterations, [&] {
+        JST_BOOL converted = JSTCaptureAdbConvertFrame(frame.data(), frame.size(), image->pixels, image->alignedWidth, threadCount);
+        JSTBenchmarkKeep(converted);
+    });
+
+    /* What `screencap -p` does on the device, done on the host instead */
+    std::vector<int> threadCounts = { 1 };
+    if (threadCount > 1) {
+        threadCounts.push_back(threadCount);
+    }
+    for (int level : { 1, -1 }) {
+        for (int threads : threadCounts) {
+            char name[64];
+            snprintf(name, sizeof(name), "JSTCapturePNGEncode/level %d, %d thread%s", level, threads, threads > 1 ? "s" : "");
+            size_t length = 0;
+            JSTBenchmark(name, pixelsCount, iterations, [&] {
+                uint8_t *data = NULL;
+                JSTCapturePNGEncode(image, threads, level, &data, &length);
+                free(data);
+            });
+            printf("%-48s %10.1f KB\n", "", (double)length / 1024.0);
+        }
+    }
+
+    JSTFreePixelImage(image);
+    return 0;
+}
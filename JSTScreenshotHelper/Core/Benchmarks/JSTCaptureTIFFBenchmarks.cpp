@@ -0,0 +1,129 @@
+#include "JSTBenchmark.h"
+#include "JSTCaptureTIFF.h"
+
+#include <vector>
+
+
+/* A modern iPhone screenshot, 2796x1290 in landscape */
+static const int kBenchmarkWidth = 1290;
+static const int kBenchmarkHeight = 2796;
+
+static void JSTBenchmarkPut16(uint8_t *p, uint32_t value) { p[0] = (uint8_t)value; p[1] = (uint8_t)(value >> 8); }
+static void JSTBenchmarkPut32(uint8_t *p, uint32_t value) { JSTBenchmarkPut16(p, value & 0xFFFF); JSTBenchmarkPut16(p + 2, value >> 16); }
+
+/* Uncompressed little endian TIFF of noise, in one strip per 8 rows like
+ * screenshotr sends them. */
+static std::vector<uint8_t> JSTBenchmarkMakeTIFF(int samplesPerPixel, int extraSamples)
+{
+    const uint32_t rowsPerStrip = 8;
+    const uint32_t stripCount = (kBenchmarkHeight + rowsPerStrip - 1) / rowsPerStrip;
+    const size_t rowLength = (size_t)kBenchmarkWidth * samplesPerPixel;
+
+    std::vector<uint8_t> file(8 + rowLength * kBenchmarkHeight);
+    memcpy(file.data(), "II*\0", 4);
+    uint32_t state = 0x9E3779B9u;
+    for (size_t i = 8; i < file.size(); ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        file[i] = (uint8_t)state;
+    }
+
+    size_t offsetsOffset = file.size();
+    file.resize(file.size() + stripCount * 8);
+    for (uint32_t strip = 0; strip < stripCount; ++strip) {
+        uint32_t rowCount = std::min(rowsPerStrip, kBenchmarkHeight - strip * rowsPerStrip);
+        JSTBenchmarkPut32(&file[offsetsOffset + strip * 4], (uint32_t)(8 + rowLength * strip * rowsPerStrip));
+        JSTBenchmarkPut32(&file[offsetsOffset + stripCount * 4 + strip * 4], (uint32_t)(rowLength * rowCount));
+    }
+
+    const uint32_t entries[][4] = {
+        { 256, 3, 1, (uint32_t)kBenchmarkWidth },
+        { 257, 3, 1, (uint32_t)kBenchmarkHeight },
+        { 258, 3, 1, 8 },
+        { 259, 3, 1, 1 },
+        { 262, 3, 1, 2 },
+        { 273, 4, stripCount, (uint32_t)offsetsOffset },
+        { 277, 3, 1, (uint32_t)samplesPerPixel },
+        { 278, 3, 1, rowsPerStrip },
+        { 279, 4, stripCount, (uint32_t)(offsetsOffset + stripCount * 4) },
+        { 338, 3, 1, (uint32_t)extraSamples },
+    };
+    size_t entryCount = samplesPerPixel == 4 ? 10 : 9;
+    size_t directoryOffset = file.size();
+    file.resize(file.size() + 2 + entryCount * 12 + 4);
+    JSTBenchmarkPut32(&file[4], (uint32_t)directoryOffset);
+    JSTBenchmarkPut16(&file[directoryOffset], (uint32_t)entryCount);
+    for (size_t i = 0; i < entryCount; ++i) {
+        uint8_t *entry = &file[directoryOffset + 2 + i * 12];
+        JSTBenchmarkPut16(entry, entries[i][0]);
+        JSTBenchmarkPut16(entry + 2, entries[i][1]);
+        JSTBenchmarkPut32(entry + 4, entries[i][2]);
+        JSTBenchmarkPut32(entry + 8, entries[i][3]);
+    }
+    return file;
+}
+
+/* What a straightforward decoder does: every sample through the byte order
+ * aware reader, every pixel through JSTSetColorInPixelImageSafe. */
+static void JSTBenchmarkNaiveDecode(const std::vector<uint8_t> &file, JST_IMAGE *image, int samplesPerPixel)
+{
+    auto read32 = [&](size_t offset) {
+        return (uint32_t)file[offset] | (uint32_t)file[offset + 1] << 8 | (uint32_t)file[offset + 2] << 16 | (uint32_t)file[offset + 3] << 24;
+    };
+    const uint32_t rowsPerStrip = 8;
+    size_t directoryOffset = read32(4);
+    size_t offsetsOffset = read32(directoryOffset + 2 + 5 * 12 + 8);
+    for (int y = 0; y < kBenchmarkHeight; ++y) {
+        size_t stripOffset = read32(offsetsOffset + (size_t)(y / rowsPerStrip) * 4);
+        size_t rowOffset = stripOffset + (size_t)(y % rowsPerStrip) * kBenchmarkWidth * samplesPerPixel;
+        for (int x = 0; x < kBenchmarkWidth; ++x) {
+            const uint8_t *samples = &file[rowOffset + (size_t)x * samplesPerPixel];
+            JST_COLOR color;
+            color.red = samples[0];
+            color.green = samples[1];
+            color.blue = samples[2];
+            color.alpha = samplesPerPixel == 4 ? samples[3] : 0xFF;
+            JSTSetColorInPixelImageSafe(image, x, y, &color);
+        }
+    }
+}
+
+int main() {
+    int iterations = JSTBenchmarkIterations(10);
+    size_t pixelsCount = (size_t)kBenchmarkWidth * kBenchmarkHeight;
+    JST_IMAGE *image = JSTCreatePixelImage(kBenchmarkWidth, kBenchmarkHeight);
+
+    std::vector<uint8_t> rgb = JSTBenchmarkMakeTIFF(3, 0);
+    std::vector<uint8_t> rgba = JSTBenchmarkMakeTIFF(4, 1);
+    std::vector<uint8_t> unassociated = JSTBenchmarkMakeTIFF(4, 2);
+
+    JSTBenchmark("naive decode/RGB", pixelsCount, iterations, [&] {
+        JSTBenchmarkNaiveDecode(rgb, image, 3);
+        JSTBenchmarkKeep(image->pixels[0]);
+    });
+
+    JSTBenchmark("JSTCaptureTIFFDecode/RGB", pixelsCount, iterations, [&] {
+        JST_BOOL decoded = JSTCaptureTIFFDecode(rgb.data(), rgb.size(), image->pixels, image->alignedWidth);
+        JSTBenchmarkKeep(decoded);
+    });
+
+    JSTBenchmark("JSTCaptureTIFFDecode/RGBA premultiplied", pixelsCount, iterations, [&] {
+        JST_BOOL decoded = JSTCaptureTIFFDecode(rgba.data(), rgba.size(), image->pixels, image->alignedWidth);
+        JSTBenchmarkKeep(decoded);
+    });
+
+    JSTBenchmark("JSTCaptureTIFFDecode/RGBA unassociated", pixelsCount, iterations, [&] {
+        JST_BOOL decoded = JSTCaptureTIFFDecode(unassociated.data(), unassociated.size(), image->pixels, image->alignedWidth);
+        JSTBenchmarkKeep(decoded);
+    });
+
+    /* The floor, a plain copy of the frame */
+    JSTBenchmark("memcpy", pixelsCount, iterations, [&] {
+        memcpy(image->pixels, rgba.data() + 8, pixelsCount * sizeof(JST_COLOR));
+        JSTBenchmarkKeep(image->pixels[0]);
+    });
+
+    JSTFreePixelImage(image);
+    return 0;
+}
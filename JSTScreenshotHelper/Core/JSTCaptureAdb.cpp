@@ -0,0 +1,662 @@
+#include "JSTCaptureAdb.h"
+#include "JSTPixelCore.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+/* MARK: - Frames */
+
+enum {
+    kAdbDataspaceSRGB = 142671872,       /* HAL_DATASPACE_SRGB */
+    kAdbDataspaceDisplayP3 = 143261696,  /* HAL_DATASPACE_DISPLAY_P3 */
+};
+
+/* Framebuffers are a few thousand pixels wide, anything larger is corrupt. */
+static const int kAdbMaximumDimension = 1 << 15;
+
+static inline uint32_t JSTCaptureAdbRead32(const uint8_t *p)
+{
+    return (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0];
+}
+
+static int JSTCaptureAdbBytesPerPixel(uint32_t format)
+{
+    switch (format) {
+    case JST_CAPTURE_ADB_FORMAT_RGBA_8888:
+    case JST_CAPTURE_ADB_FORMAT_RGBX_8888:
+    case JST_CAPTURE_ADB_FORMAT_BGRA_8888:
+        return 4;
+    case JST_CAPTURE_ADB_FORMAT_RGB_888:
+        return 3;
+    case JST_CAPTURE_ADB_FORMAT_RGB_565:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+/* Size of the pixels announced by the first 12 bytes of a frame, 0 if the
+ * header is invalid. */
+static size_t JSTCaptureAdbPixelsLength(const uint8_t *header, int *width, int *height, int *bytesPerPixel)
+{
+    uint32_t w = JSTCaptureAdbRead32(header);
+    uint32_t h = JSTCaptureAdbRead32(header + 4);
+    int bpp = JSTCaptureAdbBytesPerPixel(JSTCaptureAdbRead32(header + 8));
+    if (w == 0 || h == 0 || w > kAdbMaximumDimension || h > kAdbMaximumDimension || bpp == 0) {
+        return 0;
+    }
+    *width = (int)w;
+    *height = (int)h;
+    *bytesPerPixel = bpp;
+    return (size_t)w * h * (size_t)bpp;
+}
+
+JST_BOOL JSTCaptureAdbReadFrameInfo(const void *data, size_t length, JST_CAPTURE_ADB_FRAME_INFO *info)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    if (length < 12) {
+        return false;
+    }
+
+    JST_CAPTURE_ADB_FRAME_INFO frameInfo = JST_CAPTURE_ADB_FRAME_INFO();
+    size_t pixelsLength = JSTCaptureAdbPixelsLength(bytes, &frameInfo.width, &frameInfo.height, &frameInfo.bytesPerPixel);
+    if (pixelsLength == 0) {
+        return false;
+    }
+    frameInfo.format = (JST_CAPTURE_ADB_FORMAT)JSTCaptureAdbRead32(bytes + 8);
+    if (length == 12 + pixelsLength) {
+        frameInfo.headerLength = 12;
+    } else if (length == 16 + pixelsLength) {
+        frameInfo.headerLength = 16;
+        frameInfo.dataspace = JSTCaptureAdbRead32(bytes + 12);
+    } else {
+        return false;
+    }
+
+    switch (frameInfo.dataspace) {
+    case kAdbDataspaceSRGB:
+        frameInfo.colorSpace = JST_CAPTURE_ADB_COLOR_SPACE_SRGB;
+        break;
+    case kAdbDataspaceDisplayP3:
+        frameInfo.colorSpace = JST_CAPTURE_ADB_COLOR_SPACE_DISPLAY_P3;
+        break;
+    default:
+        frameInfo.colorSpace = JST_CAPTURE_ADB_COLOR_SPACE_UNKNOWN;
+        break;
+    }
+    *info = frameInfo;
+    return true;
+}
+
+/* SurfaceFlinger composes premultiplied buffers, which screencap writes as
+ * they are, so alpha is never applied here. */
+
+static void JSTCaptureAdbConvertRGBARow(const uint8_t *samples, JST_COLOR *pixels, int width)
+{
+    for (int x = 0; x < width; ++x, samples += 4) {
+        pixels[x].theColor = (uint32_t)samples[3] << 24 | (uint32_t)samples[0] << 16 | (uint32_t)samples[1] << 8 | samples[2];
+    }
+}
+
+static void JSTCaptureAdbConvertRGBXRow(const uint8_t *samples, JST_COLOR *pixels, int width)
+{
+    for (int x = 0; x < width; ++x, samples += 4) {
+        pixels[x].theColor = 0xFF000000u | (uint32_t)samples[0] << 16 | (uint32_t)samples[1] << 8 | samples[2];
+    }
+}
+
+static void JSTCaptureAdbConvertRGBRow(const uint8_t *samples, JST_COLOR *pixels, int width)
+{
+    for (int x = 0; x < width; ++x, samples += 3) {
+        pixels[x].theColor = 0xFF000000u | (uint32_t)samples[0] << 16 | (uint32_t)samples[1] << 8 | samples[2];
+    }
+}
+
+static void JSTCaptureAdbConvertRGB565Row(const uint8_t *samples, JST_COLOR *pixels, int width)
+{
+    for (int x = 0; x < width; ++x, samples += 2) {
+        uint32_t value = (uint32_t)samples[1] << 8 | samples[0];
+        uint32_t red = value >> 11, green = (value >> 5) & 0x3F, blue = value & 0x1F;
+        pixels[x].theColor = 0xFF000000u
+            | ((red << 3) | (red >> 2)) << 16
+            | ((green << 2) | (green >> 4)) << 8
+            | ((blue << 3) | (blue >> 2));
+    }
+}
+
+static void JSTCaptureAdbConvertBGRARow(const uint8_t *samples, JST_COLOR *pixels, int width)
+{
+    for (int x = 0; x < width; ++x, samples += 4) {
+        pixels[x].theColor = JSTCaptureAdbRead32(samples);
+    }
+}
+
+namespace {
+
+struct AdbConversion {
+    void (*convertRow)(const uint8_t *, JST_COLOR *, int);
+    const uint8_t *samples;
+    size_t rowLength;
+    JST_COLOR *pixels;
+    int alignedWidth;
+    int width;
+};
+
+}
+
+static void JSTCaptureAdbConvertRows(const AdbConversion *conversion, int y1, int y2)
+{
+    for (int y = y1; y < y2; ++y) {
+        conversion->convertRow(conversion->samples + conversion->rowLength * (size_t)y, conversion->pixels + (size_t)conversion->alignedWidth * (size_t)y, conversion->width);
+    }
+}
+
+JST_BOOL JSTCaptureAdbConvertFrame(const void *data, size_t length, JST_COLOR *pixels, int alignedWidth, int threadCount)
+{
+    JST_CAPTURE_ADB_FRAME_INFO info;
+    if (!JSTCaptureAdbReadFrameInfo(data, length, &info) || alignedWidth < info.width) {
+        return false;
+    }
+
+    AdbConversion conversion;
+    switch (info.format) {
+    case JST_CAPTURE_ADB_FORMAT_RGBA_8888:
+        conversion.convertRow = JSTCaptureAdbConvertRGBARow;
+        break;
+    case JST_CAPTURE_ADB_FORMAT_RGBX_8888:
+        conversion.convertRow = JSTCaptureAdbConvertRGBXRow;
+        break;
+    case JST_CAPTURE_ADB_FORMAT_RGB_888:
+        conversion.convertRow = JSTCaptureAdbConvertRGBRow;
+        break;
+    case JST_CAPTURE_ADB_FORMAT_RGB_565:
+        conversion.convertRow = JSTCaptureAdbConvertRGB565Row;
+        break;
+    case JST_CAPTURE_ADB_FORMAT_BGRA_8888:
+        conversion.convertRow = JSTCaptureAdbConvertBGRARow;
+        break;
+    default:
+        return false;
+    }
+    conversion.samples = (const uint8_t *)data + info.headerLength;
+    conversion.rowLength = (size_t)info.width * (size_t)info.bytesPerPixel;
+    conversion.pixels = pixels;
+    conversion.alignedWidth = alignedWidth;
+    conversion.width = info.width;
+
+    /* contiguous bands of rows, the calling thread takes the first one */
+    threadCount = std::min(std::max(threadCount, 1), info.height);
+    int bandHeight = (info.height + threadCount - 1) / threadCount;
+    std::vector<std::thread> threads;
+    for (int y1 = bandHeight; y1 < info.height; y1 += bandHeight) {
+        try {
+            threads.emplace_back(JSTCaptureAdbConvertRows, &conversion, y1, std::min(y1 + bandHeight, info.height));
+        } catch (...) {
+            /* the calling thread converts what is left */
+            JSTCaptureAdbConvertRows(&conversion, y1, info.height);
+            break;
+        }
+    }
+    JSTCaptureAdbConvertRows(&conversion, 0, std::min(bandHeight, info.height));
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    return true;
+}
+
+
+/* MARK: - Connection */
+
+#ifdef MSG_NOSIGNAL
+#define JST_ADB_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define JST_ADB_SEND_FLAGS 0
+#endif
+
+namespace {
+
+class AdbConnection {
+public:
+    AdbConnection() : fd(-1), timeout(0) {}
+    ~AdbConnection() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    AdbConnection(const AdbConnection &) = delete;
+    AdbConnection &operator=(const AdbConnection &) = delete;
+
+    bool open(const char *host, int port, int timeoutMilliseconds, std::string *error);
+    bool writeAll(const void *data, size_t length);
+
+    /* Returns the number of bytes read, 0 at the end of the stream, -1 on
+     * errors and timeouts. */
+    ssize_t readSome(void *data, size_t length);
+    bool readAll(void *data, size_t length);
+
+private:
+    bool wait(short events);
+
+    int fd;
+    int timeout;
+};
+
+}
+
+bool AdbConnection::open(const char *host, int port, int timeoutMilliseconds, std::string *error)
+{
+    timeout = timeoutMilliseconds > 0 ? timeoutMilliseconds : -1;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *addresses = NULL;
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    int result = getaddrinfo(host, service, &hints, &addresses);
+    if (result != 0) {
+        *error = std::string("cannot resolve ") + host + ": " + gai_strerror(result);
+        return false;
+    }
+
+    int lastError = ECONNREFUSED;
+    for (struct addrinfo *address = addresses; address; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) {
+            lastError = errno;
+            continue;
+        }
+#ifdef SO_NOSIGPIPE
+        int noSignal = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSignal, sizeof(noSignal));
+#endif
+        /* non-blocking for good, so that every operation honours the timeout */
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+        if (errno == EINPROGRESS && wait(POLLOUT)) {
+            int socketError = 0;
+            socklen_t socketErrorLength = sizeof(socketError);
+            if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &socketError, &socketErrorLength) == 0 && socketError == 0) {
+                break;
+            }
+            lastError = socketError;
+        } else {
+            lastError = errno == EINPROGRESS ? ETIMEDOUT : errno;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addresses);
+
+    if (fd < 0) {
+        *error = std::string("cannot connect to ") + host + ":" + service + ": " + strerror(lastError);
+        return false;
+    }
+    return true;
+}
+
+bool AdbConnection::wait(short events)
+{
+    struct pollfd descriptor;
+    descriptor.fd = fd;
+    descriptor.events = events;
+    descriptor.revents = 0;
+    int result;
+    do {
+        result = poll(&descriptor, 1, timeout);
+    } while (result < 0 && errno == EINTR);
+    return result > 0;
+}
+
+bool AdbConnection::writeAll(const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    while (length > 0) {
+        ssize_t written = send(fd, bytes, length, JST_ADB_SEND_FLAGS);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait(POLLOUT)) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+ssize_t AdbConnection::readSome(void *data, size_t length)
+{
+    for (;;) {
+        ssize_t result = recv(fd, data, length, 0);
+        if (result >= 0) {
+            return result;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait(POLLIN)) {
+            continue;
+        }
+        return -1;
+    }
+}
+
+bool AdbConnection::readAll(void *data, size_t length)
+{
+    uint8_t *bytes = (uint8_t *)data;
+    while (length > 0) {
+        ssize_t result = readSome(bytes, length);
+        if (result <= 0) {
+            return false;
+        }
+        bytes += result;
+        length -= (size_t)result;
+    }
+    return true;
+}
+
+
+/* MARK: - Host Protocol */
+
+/* Sends a request, a 4 digit hex length followed by the payload, and reads
+ * the OKAY or FAIL status of the server. */
+static JST_CAPTURE_ADB_STATUS JSTCaptureAdbRequest(AdbConnection &connection, const std::string &request, std::string *error)
+{
+    char length[5];
+    snprintf(length, sizeof(length), "%04zx", request.size());
+    if (request.size() > 0xFFFF || !connection.writeAll(length, 4) || !connection.writeAll(request.data(), request.size())) {
+        *error = "cannot send " + request;
+        return JST_CAPTURE_ADB_STATUS_PROTOCOL_ERROR;
+    }
+
+    char status[4];
+    if (!connection.readAll(status, sizeof(status))) {
+        *error = "no reply to " + request;
+        return JST_CAPTURE_ADB_STATUS_PROTOCOL_ERROR;
+    }
+    if (memcmp(status, "OKAY", 4) == 0) {
+        return JST_CAPTURE_ADB_STATUS_OK;
+    }
+    if (memcmp(status, "FAIL", 4) != 0) {
+        *error = "unexpected reply to " + request;
+        return JST_CAPTURE_ADB_STATUS_PROTOCOL_ERROR;
+    }
+
+    char messageLength[5] = {0};
+    unsigned long count = 0;
+    if (!connection.readAll(messageLength, 4) || sscanf(messageLength, "%4lx", &count) != 1) {
+        *error = "truncated failure of " + request;
+        return JST_CAPTURE_ADB_STATUS_PROTOCOL_ERROR;
+    }
+    std::string message(count, '\0');
+    if (!connection.readAll(&message[0], count)) {
+        *error = "truncated failure of " + request;
+        return JST_CAPTURE_ADB_STATUS_PROTOCOL_ERROR;
+    }
+    *error = message;
+    return JST_CAPTURE_ADB_STATUS_REFUSED;
+}
+
+/* Reads the output of screencap until the device closes the stream. The
+ * header announces the size of the pixels, so the buffer is allocated once. */
+static JST_CAPTURE_ADB_STATUS JSTCaptureAdbReadFrame(AdbConnection &connection, std::vector<uint8_t> &frame, std::string *error)
+{
+    uint8_t header[12];
+    if (!connection.readAll(header, sizeof(header))) {
+        *error = "screencap produced no frame";
+        return JST_CAPTURE_ADB_STATUS_BAD_FRAME;
+    }
+    int width, height, bytesPerPixel;
+    size_t pixelsLength = JSTCaptureAdbPixelsLength(header, &width, &height, &bytesPerPixel);
+    if (pixelsLength == 0) {
+        *error = "screencap produced an unsupported frame";
+        return JST_CAPTURE_ADB_STATUS_BAD_FRAME;
+    }
+
+    size_t capacity = 16 + pixelsLength;
+    try {
+        frame.resize(capacity);
+    } catch (const std::bad_alloc &) {
+        return JST_CAPTURE_ADB_STATUS_OUT_OF_MEMORY;
+    }
+    memcpy(frame.data(), header, sizeof(header));
+    size_t length = sizeof(header);
+    for (;;) {
+        if (length == capacity) {
+            /* anything after the largest possible frame is garbage */
+            uint8_t extra;
+            ssize_t result = connection.readSome(&extra, 1);
+            if (result != 0) {
+                *error = result < 0 ? "lost the connection during the capture" : "screencap produced a longer frame";
+                return result < 0 ? JST_CAPTURE_ADB_STATUS_PROTOCOL_ERROR : JST_CAPTURE_ADB_STATUS_BAD_FRAME;
+            }
+            break;
+        }
+        ssize_t result = connection.readSome(frame.data() + length, capacity - length);
+        if (result < 0) {
+            *error = "lost the connection during the capture";
+            return JST_CAPTURE_ADB_STATUS_PROTOCOL_ERROR;
+        }
+        if (result == 0) {
+            break;
+        }
+        length += (size_t)result;
+    }
+    frame.resize(length);
+    return JST_CAPTURE_ADB_STATUS_OK;
+}
+
+
+/* MARK: - Capture */
+
+void JSTCaptureAdbOptionsInit(JST_CAPTURE_ADB_OPTIONS *options)
+{
+    options->host = "127.0.0.1";
+    options->port = 5037;
+    options->timeout = 10 * 1000;
+    options->threadCount = 1;
+}
+
+/* Selects the device and starts a service on it, its output follows. */
+static JST_CAPTURE_ADB_STATUS JSTCaptureAdbOpenService(AdbConnection &connection, const JST_CAPTURE_ADB_OPTIONS *options, const char *serial, const char *service, std::string *error)
+{
+    if (!connection.open(options->host, options->port, options->timeout, error)) {
+        return JST_CAPTURE_ADB_STATUS_CONNECTION_FAILED;
+    }
+    std::string transport = serial && *serial ? std::string("host:transport:") + serial : std::string("host:transport-any");
+    JST_CAPTURE_ADB_STATUS status = JSTCaptureAdbRequest(connection, transport, error);
+    if (status == JST_CAPTURE_ADB_STATUS_OK) {
+        status = JSTCaptureAdbRequest(connection, service, error);
+    }
+    return status;
+}
+
+static JST_CAPTURE_ADB_STATUS JSTCaptureAdbPerformScreencap(const JST_CAPTURE_ADB_OPTIONS *options, const char *serial, JST_IMAGE **pixelImage, JST_CAPTURE_ADB_FRAME_INFO *info, std::string *error)
+{
+    /* exec: has no pty, so the bytes are not mangled by line discipline */
+    AdbConnection connection;
+    JST_CAPTURE_ADB_STATUS status = JSTCaptureAdbOpenService(connection, options, serial, "exec:screencap", error);
+    if (status != JST_CAPTURE_ADB_STATUS_OK) {
+        return status;
+    }
+
+    std::vector<uint8_t> frame;
+    status = JSTCaptureAdbReadFrame(connection, frame, error);
+    if (status != JST_CAPTURE_ADB_STATUS_OK) {
+        return status;
+    }
+    JST_CAPTURE_ADB_FRAME_INFO frameInfo;
+    if (!JSTCaptureAdbReadFrameInfo(frame.data(), frame.size(), &frameInfo)) {
+        *error = "screencap produced a truncated frame";
+        return JST_CAPTURE_ADB_STATUS_BAD_FRAME;
+    }
+
+    JST_IMAGE *newPixelImage = JSTCreatePixelImage(frameInfo.width, frameInfo.height);
+    if (!newPixelImage) {
+        return JST_CAPTURE_ADB_STATUS_OUT_OF_MEMORY;
+    }
+    JSTCaptureAdbConvertFrame(frame.data(), frame.size(), newPixelImage->pixels, newPixelImage->alignedWidth, options->threadCount);
+    *pixelImage = newPixelImage;
+    if (info) {
+        *info = frameInfo;
+    }
+    return JST_CAPTURE_ADB_STATUS_OK;
+}
+
+JST_CAPTURE_ADB_STATUS JSTCaptureAdbScreencap(const JST_CAPTURE_ADB_OPTIONS *options, const char *serial, JST_IMAGE **pixelImage, JST_CAPTURE_ADB_FRAME_INFO *info, char *message, size_t messageLength)
+{
+    JST_CAPTURE_ADB_OPTIONS defaultOptions;
+    if (!options) {
+        JSTCaptureAdbOptionsInit(&defaultOptions);
+        options = &defaultOptions;
+    }
+
+    std::string error;
+    JST_CAPTURE_ADB_STATUS status;
+    try {
+        status = JSTCaptureAdbPerformScreencap(options, serial, pixelImage, info, &error);
+    } catch (const std::bad_alloc &) {
+        status = JST_CAPTURE_ADB_STATUS_OUT_OF_MEMORY;
+    }
+    if (status == JST_CAPTURE_ADB_STATUS_OUT_OF_MEMORY && error.empty()) {
+        error = "not enough memory for the frame";
+    }
+    if (message && messageLength > 0) {
+        snprintf(message, messageLength, "%s", status == JST_CAPTURE_ADB_STATUS_OK ? "" : error.c_str());
+    }
+    return status;
+}
+
+
+/* MARK: - Properties */
+
+/* A listing is a few dozen kilobytes, anything much larger is not one. */
+static const size_t kAdbMaximumListingLength = 1 << 20;
+
+static JST_CAPTURE_ADB_STATUS JSTCaptureAdbReadListing(AdbConnection &connection, std::string &listing, std::string *error)
+{
+    char buffer[4096];
+    for (;;) {
+        ssize_t result = connection.readSome(buffer, sizeof(buffer));
+        if (result < 0) {
+            *error = "lost the connection during getprop";
+            return JST_CAPTURE_ADB_STATUS_PROTOCOL_ERROR;
+        }
+        if (result == 0) {
+            return JST_CAPTURE_ADB_STATUS_OK;
+        }
+        if (listing.size() + (size_t)result > kAdbMaximumListingLength) {
+            *error = "getprop produced too long a listing";
+            return JST_CAPTURE_ADB_STATUS_PROTOCOL_ERROR;
+        }
+        listing.append(buffer, (size_t)result);
+    }
+}
+
+/* Lines read "[name]: [value]", ending with \r\n through a pty. Values
+ * spanning several lines are not looked for. */
+static bool JSTCaptureAdbFindProperty(const std::string &listing, const char *name, std::string *value)
+{
+    std::string prefix = std::string("[") + name + "]: [";
+    for (size_t position = listing.find(prefix); position != std::string::npos; position = listing.find(prefix, position + 1)) {
+        if (position > 0 && listing[position - 1] != '\n') {
+            continue;
+        }
+        size_t start = position + prefix.size();
+        size_t end = listing.find('\n', start);
+        if (end == std::string::npos) {
+            end = listing.size();
+        }
+        while (end > start && listing[end - 1] == '\r') {
+            --end;
+        }
+        if (end == start || listing[end - 1] != ']') {
+            return false;
+        }
+        value->assign(listing, start, end - 1 - start);
+        return true;
+    }
+    return false;
+}
+
+static JST_CAPTURE_ADB_STATUS JSTCaptureAdbPerformGetProperties(const JST_CAPTURE_ADB_OPTIONS *options, const char *serial, const char *const *names, int count, char **values, std::string *error)
+{
+    /* shell: rather than exec:, getprop is older than exec: on the device */
+    AdbConnection connection;
+    JST_CAPTURE_ADB_STATUS status = JSTCaptureAdbOpenService(connection, options, serial, "shell:getprop", error);
+    if (status != JST_CAPTURE_ADB_STATUS_OK) {
+        return status;
+    }
+    std::string listing;
+    status = JSTCaptureAdbReadListing(connection, listing, error);
+    if (status != JST_CAPTURE_ADB_STATUS_OK) {
+        return status;
+    }
+
+    std::string value;
+    for (int i = 0; i < count; ++i) {
+        if (!JSTCaptureAdbFindProperty(listing, names[i], &value)) {
+            continue;
+        }
+        values[i] = strdup(value.c_str());
+        if (!values[i]) {
+            return JST_CAPTURE_ADB_STATUS_OUT_OF_MEMORY;
+        }
+    }
+    return JST_CAPTURE_ADB_STATUS_OK;
+}
+
+JST_CAPTURE_ADB_STATUS JSTCaptureAdbGetProperties(const JST_CAPTURE_ADB_OPTIONS *options, const char *serial, const char *const *names, int count, char **values, char *message, size_t messageLength)
+{
+    JST_CAPTURE_ADB_OPTIONS defaultOptions;
+    if (!options) {
+        JSTCaptureAdbOptionsInit(&defaultOptions);
+        options = &defaultOptions;
+    }
+    for (int i = 0; i < count; ++i) {
+        values[i] = NULL;
+    }
+
+    std::string error;
+    JST_CAPTURE_ADB_STATUS status;
+    try {
+        status = JSTCaptureAdbPerformGetProperties(options, serial, names, count, values, &error);
+    } catch (const std::bad_alloc &) {
+        status = JST_CAPTURE_ADB_STATUS_OUT_OF_MEMORY;
+    }
+    if (status != JST_CAPTURE_ADB_STATUS_OK) {
+        for (int i = 0; i < count; ++i) {
+            free(values[i]);
+            values[i] = NULL;
+        }
+    }
+    if (status == JST_CAPTURE_ADB_STATUS_OUT_OF_MEMORY && error.empty()) {
+        error = "not enough memory for the properties";
+    }
+    if (message && messageLength > 0) {
+        snprintf(message, messageLength, "%s", status == JST_CAPTURE_ADB_STATUS_OK ? "" : error.c_str());
+    }
+    return status;
+}
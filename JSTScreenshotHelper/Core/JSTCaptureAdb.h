@@ -0,0 +1,100 @@
+#ifndef JSTCaptureAdb_h
+#define JSTCaptureAdb_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "JST_BOOL.h"
+#include "JST_COLOR.h"
+#include "JST_IMAGE.h"
+
+#ifdef __cplusplus
+#define JST_EXTERN extern "C"
+#else
+#define JST_EXTERN extern
+#endif
+
+/* Android framebuffer capture through the adb server.
+ *
+ * The host protocol is spoken directly to the server: the device is selected
+ * with host:transport and `screencap` runs as an exec: service, so its raw
+ * output streams over one socket into a JST_IMAGE. Nothing is encoded on the
+ * device, written to its storage or pulled, and no adb process is spawned. */
+
+/* MARK: - Frames */
+
+/* PixelFormat of the framebuffer, as written by screencap. */
+typedef enum JST_CAPTURE_ADB_FORMAT {
+    JST_CAPTURE_ADB_FORMAT_RGBA_8888 = 1,
+    JST_CAPTURE_ADB_FORMAT_RGBX_8888 = 2,
+    JST_CAPTURE_ADB_FORMAT_RGB_888 = 3,
+    JST_CAPTURE_ADB_FORMAT_RGB_565 = 4,
+    JST_CAPTURE_ADB_FORMAT_BGRA_8888 = 5,
+} JST_CAPTURE_ADB_FORMAT;
+
+typedef enum JST_CAPTURE_ADB_COLOR_SPACE {
+    JST_CAPTURE_ADB_COLOR_SPACE_UNKNOWN = 0,
+    JST_CAPTURE_ADB_COLOR_SPACE_SRGB,
+    JST_CAPTURE_ADB_COLOR_SPACE_DISPLAY_P3,
+} JST_CAPTURE_ADB_COLOR_SPACE;
+
+typedef struct JST_CAPTURE_ADB_FRAME_INFO {
+    int width;
+    int height;
+    JST_CAPTURE_ADB_FORMAT format;
+    int bytesPerPixel;
+    int headerLength;                        /* 12, or 16 with a dataspace since Android 8 */
+    uint32_t dataspace;                      /* 0 if absent */
+    JST_CAPTURE_ADB_COLOR_SPACE colorSpace;
+} JST_CAPTURE_ADB_FRAME_INFO;
+
+/* Parses the header of a complete screencap frame. Whether the header has a
+ * dataspace is only told apart by the length of the pixels that follow, so
+ * length must cover the whole frame. Returns false if the frame is malformed
+ * or its format is not supported. */
+JST_EXTERN JST_BOOL JSTCaptureAdbReadFrameInfo(const void *data, size_t length, JST_CAPTURE_ADB_FRAME_INFO *info);
+
+/* Converts the pixels of a frame into pixels, rows alignedWidth colors apart,
+ * splitting the rows across threadCount threads. Returns false if the frame
+ * is malformed or alignedWidth < info.width. */
+JST_EXTERN JST_BOOL JSTCaptureAdbConvertFrame(const void *data, size_t length, JST_COLOR *pixels, int alignedWidth, int threadCount);
+
+
+/* MARK: - Server */
+
+typedef enum JST_CAPTURE_ADB_STATUS {
+    JST_CAPTURE_ADB_STATUS_OK = 0,
+    JST_CAPTURE_ADB_STATUS_CONNECTION_FAILED,  /* no server is listening, it may be started and retried */
+    JST_CAPTURE_ADB_STATUS_REFUSED,            /* the server replied FAIL, see the message */
+    JST_CAPTURE_ADB_STATUS_PROTOCOL_ERROR,     /* unexpected reply, timeout or lost connection */
+    JST_CAPTURE_ADB_STATUS_BAD_FRAME,          /* the output of screencap is not a frame */
+    JST_CAPTURE_ADB_STATUS_OUT_OF_MEMORY,
+} JST_CAPTURE_ADB_STATUS;
+
+typedef struct JST_CAPTURE_ADB_OPTIONS {
+    const char *host;  /* of the adb server, numeric or name */
+    int port;
+    int timeout;       /* of every read and write in ms, 0 to wait forever */
+    int threadCount;   /* for the conversion */
+} JST_CAPTURE_ADB_OPTIONS;
+
+/* 127.0.0.1:5037, a 10 s timeout and one thread. */
+JST_EXTERN void JSTCaptureAdbOptionsInit(JST_CAPTURE_ADB_OPTIONS *options);
+
+/* Captures the framebuffer of the device with the given serial, or of the
+ * only device if serial is NULL. On success *pixelImage is a new packed
+ * image, freed with JSTFreePixelImage, and info describes the frame if not
+ * NULL. On failure a message is written into message if not NULL. */
+JST_EXTERN JST_CAPTURE_ADB_STATUS JSTCaptureAdbScreencap(const JST_CAPTURE_ADB_OPTIONS *options, const char *serial, JST_IMAGE **pixelImage, JST_CAPTURE_ADB_FRAME_INFO *info, char *message, size_t messageLength);
+
+
+/* MARK: - Properties */
+
+/* Reads count system properties of the device at once: `getprop` runs a
+ * single time and the names are picked out of its listing, in place of one
+ * `adb shell getprop <name>` process per property. On success values[i] is
+ * a copy of the value of names[i], freed with free(), or NULL if the device
+ * does not have it. On failure every value is NULL and a message is written
+ * into message if not NULL. */
+JST_EXTERN JST_CAPTURE_ADB_STATUS JSTCaptureAdbGetProperties(const JST_CAPTURE_ADB_OPTIONS *options, const char *serial, const char *const *names, int count, char **values, char *message, size_t messageLength);
+
+#endif /* JSTCaptureAdb_h */
@@ -0,0 +1,328 @@
+#include "JSTCapturePNG.h"
+#include "JSTPixelCore.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+
+/* MARK: - Rows */
+
+namespace {
+
+struct PNGEncoding {
+    const JST_COLOR *pixels;  /* upright */
+    int alignedWidth;
+    int width;
+    int height;
+    int channelCount;         /* 3 if opaque, otherwise 4 */
+    size_t rowLength;         /* without the filter byte */
+    int compressionLevel;
+};
+
+struct PNGBand {
+    int y1;
+    int y2;
+    bool isLast;
+    std::vector<uint8_t> stream;  /* raw deflate */
+    uLong adler;
+    uLong inputLength;
+    bool isEncoded;
+};
+
+}
+
+/* Unpremultiplies a row into RGB or RGBA samples. */
+static void JSTCapturePNGUnpackRow(const PNGEncoding *encoding, int y, uint8_t *samples)
+{
+    const JST_COLOR *row = encoding->pixels + (size_t)encoding->alignedWidth * (size_t)y;
+    if (encoding->channelCount == 3) {
+        for (int x = 0; x < encoding->width; ++x, samples += 3) {
+            samples[0] = row[x].red;
+            samples[1] = row[x].green;
+            samples[2] = row[x].blue;
+        }
+        return;
+    }
+    for (int x = 0; x < encoding->width; ++x, samples += 4) {
+        uint32_t alpha = row[x].alpha;
+        if (alpha == 0xFF || alpha == 0) {
+            samples[0] = alpha ? row[x].red : 0;
+            samples[1] = alpha ? row[x].green : 0;
+            samples[2] = alpha ? row[x].blue : 0;
+        } else {
+            samples[0] = (uint8_t)std::min((row[x].red * 255u + alpha / 2) / alpha, 255u);
+            samples[1] = (uint8_t)std::min((row[x].green * 255u + alpha / 2) / alpha, 255u);
+            samples[2] = (uint8_t)std::min((row[x].blue * 255u + alpha / 2) / alpha, 255u);
+        }
+        samples[3] = (uint8_t)alpha;
+    }
+}
+
+static inline uint8_t JSTCapturePNGPaeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return (uint8_t)a;
+    }
+    return (uint8_t)(pb <= pc ? b : c);
+}
+
+/* Writes the filter byte and the filtered row into filtered, picking the
+ * filter with the smallest sum of signed differences as libpng does. */
+static void JSTCapturePNGFilterRow(const uint8_t *row, const uint8_t *previousRow, size_t length, int bpp, uint8_t *candidates, uint8_t *filtered)
+{
+    uint8_t *sub = candidates, *up = candidates + length, *paeth = candidates + 2 * length;
+    unsigned long noneSum = 0, subSum = 0, upSum = 0, paethSum = 0;
+    for (size_t i = 0; i < length; ++i) {
+        int a = i >= (size_t)bpp ? row[i - bpp] : 0;
+        int b = previousRow[i];
+        int c = i >= (size_t)bpp ? previousRow[i - bpp] : 0;
+        sub[i] = (uint8_t)(row[i] - a);
+        up[i] = (uint8_t)(row[i] - b);
+        paeth[i] = (uint8_t)(row[i] - JSTCapturePNGPaeth(a, b, c));
+        noneSum += (unsigned long)abs((int8_t)row[i]);
+        subSum += (unsigned long)abs((int8_t)sub[i]);
+        upSum += (unsigned long)abs((int8_t)up[i]);
+        paethSum += (unsigned long)abs((int8_t)paeth[i]);
+    }
+
+    uint8_t filter = 0;
+    const uint8_t *best = row;
+    unsigned long bestSum = noneSum;
+    if (subSum < bestSum) {
+        filter = 1, best = sub, bestSum = subSum;
+    }
+    if (upSum < bestSum) {
+        filter = 2, best = up, bestSum = upSum;
+    }
+    if (paethSum < bestSum) {
+        filter = 4, best = paeth;
+    }
+    filtered[0] = filter;
+    memcpy(filtered + 1, best, length);
+}
+
+
+/* MARK: - Bands */
+
+static bool JSTCapturePNGDeflate(z_stream *stream, std::vector<uint8_t> &output, int flush)
+{
+    for (;;) {
+        if (stream->avail_out == 0) {
+            size_t used = output.size();
+            output.resize(used + std::max(used / 2, (size_t)64 * 1024));
+            stream->next_out = output.data() + used;
+            stream->avail_out = (uInt)(output.size() - used);
+        }
+        int result = deflate(stream, flush);
+        if (result == Z_STREAM_END) {
+            return true;
+        }
+        if (result != Z_OK && result != Z_BUF_ERROR) {
+            return false;
+        }
+        /* room left means the input is consumed, or the flush is complete */
+        if (stream->avail_out > 0) {
+            return flush != Z_FINISH;
+        }
+    }
+}
+
+static void JSTCapturePNGEncodeBand(const PNGEncoding *encoding, PNGBand *band)
+{
+    band->isEncoded = false;
+    band->adler = adler32(0, Z_NULL, 0);
+    band->inputLength = 0;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, encoding->compressionLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return;
+    }
+    try {
+        size_t length = encoding->rowLength;
+        std::vector<uint8_t> previousRow(length, 0), row(length), candidates(3 * length), filtered(length + 1);
+        if (band->y1 > 0) {
+            JSTCapturePNGUnpackRow(encoding, band->y1 - 1, previousRow.data());
+        }
+        band->stream.resize(deflateBound(&stream, (uLong)((length + 1) * (size_t)(band->y2 - band->y1))) + 16);
+        stream.next_out = band->stream.data();
+        stream.avail_out = (uInt)band->stream.size();
+
+        bool isEncoded = true;
+        for (int y = band->y1; y < band->y2 && isEncoded; ++y) {
+            JSTCapturePNGUnpackRow(encoding, y, row.data());
+            JSTCapturePNGFilterRow(row.data(), previousRow.data(), length, encoding->channelCount, candidates.data(), filtered.data());
+            row.swap(previousRow);
+
+            band->adler = adler32(band->adler, filtered.data(), (uInt)filtered.size());
+            band->inputLength += (uLong)filtered.size();
+            stream.next_in = filtered.data();
+            stream.avail_in = (uInt)filtered.size();
+            isEncoded = JSTCapturePNGDeflate(&stream, band->stream, Z_NO_FLUSH);
+        }
+        /* a sync flush ends on a byte boundary without a final block */
+        if (isEncoded && JSTCapturePNGDeflate(&stream, band->stream, band->isLast ? Z_FINISH : Z_SYNC_FLUSH)) {
+            band->stream.resize(band->stream.size() - stream.avail_out);
+            band->isEncoded = true;
+        }
+    } catch (const std::bad_alloc &) {
+        band->stream.clear();
+    }
+    deflateEnd(&stream);
+}
+
+
+/* MARK: - Chunks */
+
+static void JSTCapturePNGWrite32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+static uint8_t *JSTCapturePNGWriteChunk(uint8_t *p, const char *type, const uint8_t *data, size_t length)
+{
+    JSTCapturePNGWrite32(p, (uint32_t)length);
+    memcpy(p + 4, type, 4);
+    if (length > 0) {
+        memcpy(p + 8, data, length);
+    }
+    uLong crc = crc32(0, p + 4, (uInt)(length + 4));
+    JSTCapturePNGWrite32(p + 8 + length, (uint32_t)crc);
+    return p + 12 + length;
+}
+
+/* Large enough for decoders to stream, small enough to be cheap to resend. */
+static const size_t kPNGMaximumChunkLength = 1 << 20;
+
+
+/* MARK: - Encoding */
+
+static bool JSTCapturePNGIsOpaque(const PNGEncoding *encoding)
+{
+    for (int y = 0; y < encoding->height; ++y) {
+        const JST_COLOR *row = encoding->pixels + (size_t)encoding->alignedWidth * (size_t)y;
+        uint32_t alpha = 0xFF000000u;
+        for (int x = 0; x < encoding->width; ++x) {
+            alpha &= row[x].theColor;
+        }
+        if (alpha != 0xFF000000u) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool JSTCapturePNGPerformEncode(const JST_IMAGE *pixelImage, int threadCount, int compressionLevel, uint8_t **data, size_t *length)
+{
+    PNGEncoding encoding;
+    std::vector<JST_COLOR> orientedPixels;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &encoding.width, &encoding.height);
+    if (encoding.width <= 0 || encoding.height <= 0) {
+        return false;
+    }
+    if (pixelImage->orientation == 0) {
+        encoding.pixels = pixelImage->pixels;
+        encoding.alignedWidth = pixelImage->alignedWidth;
+    } else {
+        orientedPixels.resize((size_t)encoding.width * (size_t)encoding.height);
+        JSTCopyOrientedPixelsOfPixelImage(pixelImage, orientedPixels.data());
+        encoding.pixels = orientedPixels.data();
+        encoding.alignedWidth = encoding.width;
+    }
+    encoding.channelCount = JSTCapturePNGIsOpaque(&encoding) ? 3 : 4;
+    encoding.rowLength = (size_t)encoding.width * (size_t)encoding.channelCount;
+    encoding.compressionLevel = compressionLevel < 0 ? Z_DEFAULT_COMPRESSION : std::min(compressionLevel, 9);
+
+    int bandCount = std::min(std::max(threadCount, 1), encoding.height);
+    int bandHeight = (encoding.height + bandCount - 1) / bandCount;
+    bandCount = (encoding.height + bandHeight - 1) / bandHeight;
+    std::vector<PNGBand> bands((size_t)bandCount);
+    for (int i = 0; i < bandCount; ++i) {
+        bands[(size_t)i].y1 = i * bandHeight;
+        bands[(size_t)i].y2 = std::min((i + 1) * bandHeight, encoding.height);
+        bands[(size_t)i].isLast = i == bandCount - 1;
+    }
+
+    std::vector<std::thread> threads;
+    int i = 1;
+    for (; i < bandCount; ++i) {
+        try {
+            threads.emplace_back(JSTCapturePNGEncodeBand, &encoding, &bands[(size_t)i]);
+        } catch (...) {
+            break;
+        }
+    }
+    JSTCapturePNGEncodeBand(&encoding, &bands[0]);
+    for (; i < bandCount; ++i) {
+        /* fewer workers, the calling thread encodes the bands left */
+        JSTCapturePNGEncodeBand(&encoding, &bands[(size_t)i]);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    /* one zlib stream: header, the raw bands, the combined checksum */
+    static const uint8_t headers[4][2] = {{0x78, 0x01}, {0x78, 0x5E}, {0x78, 0x9C}, {0x78, 0xDA}};
+    int level = encoding.compressionLevel == Z_DEFAULT_COMPRESSION ? 6 : encoding.compressionLevel;
+    const uint8_t *header = headers[level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3];
+    std::vector<uint8_t> stream(header, header + 2);
+    uLong adler = adler32(0, Z_NULL, 0);
+    for (PNGBand &band : bands) {
+        if (!band.isEncoded) {
+            return false;
+        }
+        stream.insert(stream.end(), band.stream.begin(), band.stream.end());
+        adler = adler32_combine(adler, band.adler, (z_off_t)band.inputLength);
+        std::vector<uint8_t>().swap(band.stream);
+    }
+    uint8_t checksum[4];
+    JSTCapturePNGWrite32(checksum, (uint32_t)adler);
+    stream.insert(stream.end(), checksum, checksum + 4);
+
+    uint8_t imageHeader[13];
+    JSTCapturePNGWrite32(imageHeader, (uint32_t)encoding.width);
+    JSTCapturePNGWrite32(imageHeader + 4, (uint32_t)encoding.height);
+    imageHeader[8] = 8;                                    /* bit depth */
+    imageHeader[9] = encoding.channelCount == 3 ? 2 : 6;  /* truecolor, with alpha */
+    imageHeader[10] = 0;                                   /* deflate */
+    imageHeader[11] = 0;                                   /* adaptive filtering */
+    imageHeader[12] = 0;                                   /* not interlaced */
+
+    size_t chunkCount = (stream.size() + kPNGMaximumChunkLength - 1) / kPNGMaximumChunkLength;
+    size_t fileLength = 8 + (12 + sizeof(imageHeader)) + 12 * chunkCount + stream.size() + 12;
+    uint8_t *file = (uint8_t *)malloc(fileLength);
+    if (!file) {
+        return false;
+    }
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    memcpy(file, signature, sizeof(signature));
+    uint8_t *p = JSTCapturePNGWriteChunk(file + 8, "IHDR", imageHeader, sizeof(imageHeader));
+    for (size_t offset = 0; offset < stream.size(); offset += kPNGMaximumChunkLength) {
+        p = JSTCapturePNGWriteChunk(p, "IDAT", stream.data() + offset, std::min(kPNGMaximumChunkLength, stream.size() - offset));
+    }
+    JSTCapturePNGWriteChunk(p, "IEND", NULL, 0);
+
+    *data = file;
+    *length = fileLength;
+    return true;
+}
+
+JST_BOOL JSTCapturePNGEncode(const JST_IMAGE *pixelImage, int threadCount, int compressionLevel, uint8_t **data, size_t *length)
+{
+    try {
+        return JSTCapturePNGPerformEncode(pixelImage, threadCount, compressionLevel, data, length);
+    } catch (const std::bad_alloc &) {
+        return false;
+    }
+}
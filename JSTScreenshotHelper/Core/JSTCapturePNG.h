@@ -0,0 +1,30 @@
+#ifndef JSTCapturePNG_h
+#define JSTCapturePNG_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "JST_BOOL.h"
+#include "JST_IMAGE.h"
+
+#ifdef __cplusplus
+#define JST_EXTERN extern "C"
+#else
+#define JST_EXTERN extern
+#endif
+
+/* PNG encoder for captured frames.
+ *
+ * The rows are split into bands which are filtered and deflated on their
+ * own threads. Every band but the last ends on a flush to a byte boundary
+ * and none refers to the data of another, so the raw streams are simply
+ * concatenated behind one zlib header and their checksums combined, the
+ * way pigz does it. Alpha is unpremultiplied and dropped from opaque
+ * images, which screenshots nearly always are. */
+
+/* The upright image, after its orientation has been applied, is encoded on
+ * threadCount threads at a zlib compressionLevel (-1 for the default).
+ * On success *data is allocated with malloc and must be freed by the caller.
+ * Returns false if the image is empty or the allocation fails. */
+JST_EXTERN JST_BOOL JSTCapturePNGEncode(const JST_IMAGE *pixelImage, int threadCount, int compressionLevel, uint8_t **data, size_t *length);
+
+#endif /* JSTCapturePNG_h */
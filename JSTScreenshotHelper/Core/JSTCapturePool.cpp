@@ -0,0 +1,280 @@
+#include "JSTCapturePool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+
+/* MARK: - Options */
+
+void JSTCapturePoolOptionsInit(JST_CAPTURE_POOL_OPTIONS *options)
+{
+    options->healthCheckInterval = 5ull * 1000 * 1000 * 1000;
+    options->idleTimeout = 5ull * 60 * 1000 * 1000 * 1000;
+    options->reconnectAttempts = 1;
+    options->latencySampleCount = 256;
+}
+
+
+/* MARK: - Pool */
+
+struct JSTCaptureDevice {
+    std::mutex mutex;  /* held during captures, serializes them */
+    void *session;
+    uint64_t lastUsed;
+    bool hasLostSession;
+
+    std::mutex statisticsMutex;  /* held briefly, so statistics can be read during captures */
+    JST_CAPTURE_STATISTICS statistics;
+    std::vector<double> latencies;  /* ring of the latest samples, in ms */
+    size_t nextLatency;
+};
+
+struct JST_CAPTURE_POOL {
+    JST_CAPTURE_TRANSPORT transport;
+    JST_CAPTURE_POOL_OPTIONS options;
+
+    std::mutex mutex;  /* guards the map only, never held during a capture */
+    std::map<std::string, std::unique_ptr<JSTCaptureDevice>> devices;
+};
+
+static uint64_t JSTCapturePoolNow(const JST_CAPTURE_POOL *pool)
+{
+    if (pool->transport.now) {
+        return pool->transport.now(pool->transport.context);
+    }
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+JST_CAPTURE_POOL *JSTCapturePoolCreate(const JST_CAPTURE_TRANSPORT *transport, const JST_CAPTURE_POOL_OPTIONS *options)
+{
+    JST_CAPTURE_POOL *pool = new (std::nothrow) JST_CAPTURE_POOL;
+    if (!pool) {
+        return NULL;
+    }
+    pool->transport = *transport;
+    if (options) {
+        pool->options = *options;
+    } else {
+        JSTCapturePoolOptionsInit(&pool->options);
+    }
+    pool->options.reconnectAttempts = std::max(pool->options.reconnectAttempts, 0);
+    pool->options.latencySampleCount = std::max(pool->options.latencySampleCount, 1);
+    return pool;
+}
+
+static void JSTCaptureDeviceCloseSession(JST_CAPTURE_POOL *pool, JSTCaptureDevice *device)
+{
+    if (device->session) {
+        pool->transport.closeSession(pool->transport.context, device->session);
+        device->session = NULL;
+    }
+}
+
+void JSTCapturePoolFree(JST_CAPTURE_POOL *pool)
+{
+    if (!pool) {
+        return;
+    }
+    for (auto &entry : pool->devices) {
+        JSTCaptureDeviceCloseSession(pool, entry.second.get());
+    }
+    delete pool;
+}
+
+static JSTCaptureDevice *JSTCapturePoolGetDevice(JST_CAPTURE_POOL *pool, const char *udid, bool createsDevice)
+{
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    auto it = pool->devices.find(udid);
+    if (it != pool->devices.end()) {
+        return it->second.get();
+    }
+    if (!createsDevice) {
+        return NULL;
+    }
+
+    /* devices are never removed, so the pointer outlives the lock */
+    try {
+        std::unique_ptr<JSTCaptureDevice> device(new JSTCaptureDevice);
+        device->session = NULL;
+        device->lastUsed = 0;
+        device->hasLostSession = false;
+        device->statistics = JST_CAPTURE_STATISTICS();
+        device->latencies.reserve((size_t)pool->options.latencySampleCount);
+        device->nextLatency = 0;
+        return pool->devices.emplace(udid, std::move(device)).first->second.get();
+    } catch (const std::bad_alloc &) {
+        return NULL;
+    }
+}
+
+static void JSTCaptureDeviceAddLatency(JST_CAPTURE_POOL *pool, JSTCaptureDevice *device, double latency)
+{
+    if (device->latencies.size() < (size_t)pool->options.latencySampleCount) {
+        device->latencies.push_back(latency);
+    } else {
+        device->latencies[device->nextLatency] = latency;
+        device->nextLatency = (device->nextLatency + 1) % device->latencies.size();
+    }
+}
+
+JST_CAPTURE_STATUS JSTCapturePoolCapture(JST_CAPTURE_POOL *pool, const char *udid, void *request)
+{
+    JSTCaptureDevice *device = JSTCapturePoolGetDevice(pool, udid, true);
+    if (!device) {
+        return JST_CAPTURE_STATUS_FAILED;
+    }
+    if (pool->options.idleTimeout > 0) {
+        JSTCapturePoolCloseIdleSessions(pool);
+    }
+
+    std::lock_guard<std::mutex> lock(device->mutex);
+    uint64_t startTime = JSTCapturePoolNow(pool);
+    int reconnectAttempts = pool->options.reconnectAttempts;
+    JST_CAPTURE_STATUS status;
+    for (;;) {
+        if (!device->session) {
+            status = pool->transport.openSession(pool->transport.context, udid, &device->session);
+            if (status != JST_CAPTURE_STATUS_OK) {
+                device->session = NULL;
+                break;
+            }
+            std::lock_guard<std::mutex> statisticsLock(device->statisticsMutex);
+            device->statistics.sessionOpenCount += 1;
+            if (device->hasLostSession) {
+                device->statistics.reconnectCount += 1;
+                device->hasLostSession = false;
+            }
+        } else if (pool->transport.checkSession && JSTCapturePoolNow(pool) - device->lastUsed >= pool->options.healthCheckInterval) {
+            {
+                std::lock_guard<std::mutex> statisticsLock(device->statisticsMutex);
+                device->statistics.healthCheckCount += 1;
+            }
+            if (pool->transport.checkSession(pool->transport.context, device->session) != JST_CAPTURE_STATUS_OK) {
+                /* reopening a stale session is not a retry of the capture */
+                JSTCaptureDeviceCloseSession(pool, device);
+                device->hasLostSession = true;
+                continue;
+            }
+        }
+
+        status = pool->transport.capture(pool->transport.context, device->session, request);
+        if (status == JST_CAPTURE_STATUS_OK) {
+            break;
+        }
+        /* the session is not trusted after any failure, but only a lost
+         * connection makes reopening it a reconnect */
+        JSTCaptureDeviceCloseSession(pool, device);
+        if (status != JST_CAPTURE_STATUS_DISCONNECTED) {
+            break;
+        }
+        device->hasLostSession = true;
+        if (reconnectAttempts-- <= 0) {
+            break;
+        }
+    }
+
+    uint64_t endTime = JSTCapturePoolNow(pool);
+    std::lock_guard<std::mutex> statisticsLock(device->statisticsMutex);
+    if (status == JST_CAPTURE_STATUS_OK) {
+        device->lastUsed = endTime;
+        device->statistics.captureCount += 1;
+        JSTCaptureDeviceAddLatency(pool, device, (double)(endTime - startTime) / 1e6);
+    } else {
+        device->statistics.failureCount += 1;
+    }
+    return status;
+}
+
+void JSTCapturePoolCloseSession(JST_CAPTURE_POOL *pool, const char *udid)
+{
+    JSTCaptureDevice *device = JSTCapturePoolGetDevice(pool, udid, false);
+    if (!device) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(device->mutex);
+    JSTCaptureDeviceCloseSession(pool, device);
+}
+
+int JSTCapturePoolCloseIdleSessions(JST_CAPTURE_POOL *pool)
+{
+    if (pool->options.idleTimeout == 0) {
+        return 0;
+    }
+
+    std::vector<JSTCaptureDevice *> devices;
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        for (auto &entry : pool->devices) {
+            devices.push_back(entry.second.get());
+        }
+    }
+
+    int closedCount = 0;
+    uint64_t now = JSTCapturePoolNow(pool);
+    for (JSTCaptureDevice *device : devices) {
+        std::unique_lock<std::mutex> lock(device->mutex, std::try_to_lock);
+        if (!lock.owns_lock() || !device->session) {
+            continue;
+        }
+        if (now - device->lastUsed > pool->options.idleTimeout) {
+            JSTCaptureDeviceCloseSession(pool, device);
+            closedCount += 1;
+        }
+    }
+    return closedCount;
+}
+
+
+/* MARK: - Statistics */
+
+/* Nearest-rank percentile of sorted latencies. */
+static double JSTCapturePercentile(const std::vector<double> &latencies, double percentile)
+{
+    size_t rank = (size_t)std::ceil(percentile * (double)latencies.size());
+    return latencies[std::min(std::max(rank, (size_t)1), latencies.size()) - 1];
+}
+
+JST_BOOL JSTCapturePoolGetStatistics(JST_CAPTURE_POOL *pool, const char *udid, JST_CAPTURE_STATISTICS *statistics)
+{
+    std::vector<JSTCaptureDevice *> devices;
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        for (auto &entry : pool->devices) {
+            if (!udid || entry.first == udid) {
+                devices.push_back(entry.second.get());
+            }
+        }
+    }
+    *statistics = JST_CAPTURE_STATISTICS();
+    if (udid && devices.empty()) {
+        return false;
+    }
+
+    std::vector<double> latencies;
+    for (JSTCaptureDevice *device : devices) {
+        std::lock_guard<std::mutex> lock(device->statisticsMutex);
+        statistics->captureCount += device->statistics.captureCount;
+        statistics->failureCount += device->statistics.failureCount;
+        statistics->sessionOpenCount += device->statistics.sessionOpenCount;
+        statistics->reconnectCount += device->statistics.reconnectCount;
+        statistics->healthCheckCount += device->statistics.healthCheckCount;
+        latencies.insert(latencies.end(), device->latencies.begin(), device->latencies.end());
+    }
+
+    statistics->sampleCount = (int)latencies.size();
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        statistics->p50 = JSTCapturePercentile(latencies, 0.50);
+        statistics->p90 = JSTCapturePercentile(latencies, 0.90);
+        statistics->p99 = JSTCapturePercentile(latencies, 0.99);
+        statistics->max = latencies.back();
+    }
+    return true;
+}
@@ -0,0 +1,100 @@
+#ifndef JSTCapturePool_h
+#define JSTCapturePool_h
+
+#include <stdint.h>
+#include "JST_BOOL.h"
+
+#ifdef __cplusplus
+#define JST_EXTERN extern "C"
+#else
+#define JST_EXTERN extern
+#endif
+
+/* Sessions to capture devices, kept alive between captures.
+ *
+ * Connecting to a device (the lockdown handshake, starting its services and
+ * their handshakes) costs as much as the capture itself. The pool opens one
+ * session per UDID on the first capture and reuses it: sessions idle for a
+ * while are checked before being used, and sessions whose connection was
+ * lost (device unplugged, locked or asleep) are reopened transparently.
+ *
+ * The pool does not know about any device protocol: a transport opens,
+ * checks, uses and closes its sessions, so that the pool can be driven by
+ * libimobiledevice in the helper and by a fake device in the tests.
+ * Captures of a device are serialized, different devices are captured in
+ * parallel. */
+
+typedef enum JST_CAPTURE_STATUS {
+    JST_CAPTURE_STATUS_OK = 0,
+    JST_CAPTURE_STATUS_DISCONNECTED,   /* connection lost or device unreachable, worth reconnecting */
+    JST_CAPTURE_STATUS_NEEDS_PAIRING,  /* lockdown refused the handshake */
+    JST_CAPTURE_STATUS_NEEDS_MOUNT,    /* the capture service is missing until a disk image is mounted */
+    JST_CAPTURE_STATUS_FAILED,         /* anything else, not retried */
+} JST_CAPTURE_STATUS;
+
+typedef struct JST_CAPTURE_TRANSPORT {
+    void *context;
+
+    /* Connects to the device and starts the services a capture needs. */
+    JST_CAPTURE_STATUS (*openSession)(void *context, const char *udid, void **session);
+
+    /* Cheap round trip proving that an idle session still works. May be
+     * NULL, then a failed capture is the only sign of a lost connection. */
+    JST_CAPTURE_STATUS (*checkSession)(void *context, void *session);
+
+    /* Takes a capture into the request, which the pool passes through. */
+    JST_CAPTURE_STATUS (*capture)(void *context, void *session, void *request);
+
+    void (*closeSession)(void *context, void *session);
+
+    /* Monotonic time in nanoseconds, may be NULL for the system clock. */
+    uint64_t (*now)(void *context);
+} JST_CAPTURE_TRANSPORT;
+
+typedef struct JST_CAPTURE_POOL_OPTIONS {
+    uint64_t healthCheckInterval;  /* sessions idle for longer are checked before a capture, in ns */
+    uint64_t idleTimeout;          /* sessions idle for longer are closed, in ns; 0 keeps them */
+    int reconnectAttempts;         /* reopened sessions per capture after a lost connection */
+    int latencySampleCount;        /* latest latencies kept per device for the percentiles */
+} JST_CAPTURE_POOL_OPTIONS;
+
+typedef struct JST_CAPTURE_STATISTICS {
+    long long captureCount;        /* successful captures */
+    long long failureCount;
+    long long sessionOpenCount;    /* sessions opened, the first ones included */
+    long long reconnectCount;      /* sessions reopened after a lost connection */
+    long long healthCheckCount;
+    int sampleCount;               /* latencies the percentiles are computed from */
+    double p50;                    /* capture latencies in milliseconds, connecting included */
+    double p90;
+    double p99;
+    double max;
+} JST_CAPTURE_STATISTICS;
+
+typedef struct JST_CAPTURE_POOL JST_CAPTURE_POOL;
+
+JST_EXTERN void JSTCapturePoolOptionsInit(JST_CAPTURE_POOL_OPTIONS *options);
+
+/* The transport is copied. Returns NULL if the allocation fails. */
+JST_EXTERN JST_CAPTURE_POOL *JSTCapturePoolCreate(const JST_CAPTURE_TRANSPORT *transport, const JST_CAPTURE_POOL_OPTIONS *options);
+
+/* Closes every session, no capture may still be running. */
+JST_EXTERN void JSTCapturePoolFree(JST_CAPTURE_POOL *pool);
+
+/* Captures with the session of the device, opening it first if needed.
+ * Blocks while another capture of the same device is running. */
+JST_EXTERN JST_CAPTURE_STATUS JSTCapturePoolCapture(JST_CAPTURE_POOL *pool, const char *udid, void *request);
+
+/* Closes the session of a device which went away, waiting for its capture
+ * to finish if one is running. */
+JST_EXTERN void JSTCapturePoolCloseSession(JST_CAPTURE_POOL *pool, const char *udid);
+
+/* Closes sessions idle for longer than the idle timeout, skipping devices
+ * being captured. Returns the number of closed sessions. */
+JST_EXTERN int JSTCapturePoolCloseIdleSessions(JST_CAPTURE_POOL *pool);
+
+/* Statistics of one device, or of all of them if udid is NULL.
+ * Returns false for a device which was never captured. */
+JST_EXTERN JST_BOOL JSTCapturePoolGetStatistics(JST_CAPTURE_POOL *pool, const char *udid, JST_CAPTURE_STATISTICS *statistics);
+
+#endif /* JSTCapturePool_h */
@@ -0,0 +1,355 @@
+#include "JSTCaptureScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+
+/* MARK: - Options */
+
+void JSTCaptureSchedulerOptionsInit(JST_CAPTURE_SCHEDULER_OPTIONS *options)
+{
+    /* usbmuxd moves every USB frame through one daemon, the network is
+     * slower per device, and the adb server copies each frame once more */
+    options->laneLimits[JST_CAPTURE_LANE_USB] = 4;
+    options->laneLimits[JST_CAPTURE_LANE_NETWORK] = 2;
+    options->laneLimits[JST_CAPTURE_LANE_ADB] = 4;
+    options->throughputWindow = 10ull * 1000 * 1000 * 1000;
+    options->now = NULL;
+    options->context = NULL;
+}
+
+
+/* MARK: - Scheduler */
+
+namespace {
+
+/* Captures are admitted in the order they were submitted, so that a device
+ * asking often cannot starve the others of its lane. */
+struct CaptureLane {
+    std::deque<JST_CAPTURE *> waitingCaptures;
+    int limit;
+    int runningCount;
+    int peakRunningCount;
+    long long captureCount;
+};
+
+struct CaptureSample {
+    uint64_t time;
+    uint64_t byteCount;
+};
+
+struct CaptureDevice {
+    JST_CAPTURE_THROUGHPUT totals;
+    uint64_t firstTime;
+    uint64_t waitTime;
+    uint64_t duration;
+    std::deque<CaptureSample> samples;  /* successful captures within the window */
+};
+
+}
+
+struct JST_CAPTURE_SCHEDULER {
+    JST_CAPTURE_SCHEDULER_OPTIONS options;
+
+    std::mutex mutex;  /* never held while a capture starts or runs */
+    CaptureLane lanes[JST_CAPTURE_LANE_COUNT];
+    std::map<std::string, CaptureDevice> devices;
+};
+
+struct JST_CAPTURE {
+    JST_CAPTURE_SCHEDULER *scheduler;
+    JST_CAPTURE_LANE lane;
+    std::string udid;
+    JST_CAPTURE_START start;
+    void *context;
+    uint64_t askTime;
+    uint64_t startTime;
+};
+
+static uint64_t JSTCaptureSchedulerNow(const JST_CAPTURE_SCHEDULER *scheduler)
+{
+    if (scheduler->options.now) {
+        return scheduler->options.now(scheduler->options.context);
+    }
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+JST_CAPTURE_SCHEDULER *JSTCaptureSchedulerCreate(const JST_CAPTURE_SCHEDULER_OPTIONS *options)
+{
+    JST_CAPTURE_SCHEDULER *scheduler = new (std::nothrow) JST_CAPTURE_SCHEDULER;
+    if (!scheduler) {
+        return NULL;
+    }
+    if (options) {
+        scheduler->options = *options;
+    } else {
+        JSTCaptureSchedulerOptionsInit(&scheduler->options);
+    }
+    scheduler->options.throughputWindow = std::max(scheduler->options.throughputWindow, (uint64_t)1);
+    for (int i = 0; i < JST_CAPTURE_LANE_COUNT; ++i) {
+        CaptureLane &lane = scheduler->lanes[i];
+        lane.limit = std::max(scheduler->options.laneLimits[i], 1);
+        lane.runningCount = 0;
+        lane.peakRunningCount = 0;
+        lane.captureCount = 0;
+    }
+    return scheduler;
+}
+
+void JSTCaptureSchedulerFree(JST_CAPTURE_SCHEDULER *scheduler)
+{
+    delete scheduler;
+}
+
+static void JSTCaptureDeviceTrimSamples(const JST_CAPTURE_SCHEDULER *scheduler, CaptureDevice &device, uint64_t now)
+{
+    while (!device.samples.empty() && now - device.samples.front().time > scheduler->options.throughputWindow) {
+        device.samples.pop_front();
+    }
+}
+
+static void JSTCaptureSchedulerRecord(JST_CAPTURE_SCHEDULER *scheduler, const char *udid, bool succeeded, uint64_t byteCount, uint64_t askTime, uint64_t startTime, uint64_t endTime)
+{
+    CaptureDevice *device;
+    try {
+        auto inserted = scheduler->devices.emplace(udid, CaptureDevice());
+        device = &inserted.first->second;
+        if (inserted.second) {
+            device->totals = JST_CAPTURE_THROUGHPUT();
+            device->firstTime = askTime;
+            device->waitTime = 0;
+            device->duration = 0;
+        }
+        if (succeeded) {
+            device->samples.push_back(CaptureSample{endTime, byteCount});
+        }
+    } catch (const std::bad_alloc &) {
+        return;  /* the capture itself went fine, only its record is lost */
+    }
+
+    device->waitTime += startTime - askTime;
+    device->duration += endTime - startTime;
+    if (succeeded) {
+        device->totals.captureCount += 1;
+        device->totals.byteCount += (long long)byteCount;
+    } else {
+        device->totals.failureCount += 1;
+    }
+    JSTCaptureDeviceTrimSamples(scheduler, *device, endTime);
+}
+
+/* Admits the captures which fit under the limit of their lane, the caller
+ * holds the lock and starts them once it lets it go. */
+static void JSTCaptureLaneAdmit(JST_CAPTURE_SCHEDULER *scheduler, CaptureLane &captureLane, std::vector<JST_CAPTURE *> &admittedCaptures)
+{
+    while (!captureLane.waitingCaptures.empty() && captureLane.runningCount < captureLane.limit) {
+        JST_CAPTURE *capture = captureLane.waitingCaptures.front();
+        captureLane.waitingCaptures.pop_front();
+        captureLane.runningCount += 1;
+        captureLane.peakRunningCount = std::max(captureLane.peakRunningCount, captureLane.runningCount);
+        capture->startTime = JSTCaptureSchedulerNow(scheduler);
+        admittedCaptures.push_back(capture);
+    }
+}
+
+/* Captures started on this thread, a capture finished by its own start
+ * leaves the next ones to the loop below it instead of nesting them. */
+static thread_local std::deque<JST_CAPTURE *> *JSTCaptureStartingCaptures = nullptr;
+
+static void JSTCaptureSchedulerStart(const std::vector<JST_CAPTURE *> &admittedCaptures)
+{
+    if (JSTCaptureStartingCaptures) {
+        JSTCaptureStartingCaptures->insert(JSTCaptureStartingCaptures->end(), admittedCaptures.begin(), admittedCaptures.end());
+        return;
+    }
+    std::deque<JST_CAPTURE *> startingCaptures(admittedCaptures.begin(), admittedCaptures.end());
+    JSTCaptureStartingCaptures = &startingCaptures;
+    while (!startingCaptures.empty()) {
+        JST_CAPTURE *capture = startingCaptures.front();
+        startingCaptures.pop_front();
+        capture->start(capture, capture->context);
+    }
+    JSTCaptureStartingCaptures = nullptr;
+}
+
+JST_BOOL JSTCaptureSchedulerSubmit(JST_CAPTURE_SCHEDULER *scheduler, JST_CAPTURE_LANE lane, const char *udid, JST_CAPTURE_START start, void *context)
+{
+    if (!scheduler || lane < 0 || lane >= JST_CAPTURE_LANE_COUNT || !udid || !start) {
+        return false;
+    }
+    JST_CAPTURE *capture = new (std::nothrow) JST_CAPTURE;
+    if (!capture) {
+        return false;
+    }
+    try {
+        capture->udid = udid;
+    } catch (const std::bad_alloc &) {
+        delete capture;
+        return false;
+    }
+    capture->scheduler = scheduler;
+    capture->lane = lane;
+    capture->start = start;
+    capture->context = context;
+    capture->askTime = JSTCaptureSchedulerNow(scheduler);
+    capture->startTime = capture->askTime;
+
+    std::vector<JST_CAPTURE *> admittedCaptures;
+    {
+        std::lock_guard<std::mutex> lock(scheduler->mutex);
+        CaptureLane &captureLane = scheduler->lanes[lane];
+        try {
+            captureLane.waitingCaptures.push_back(capture);
+            admittedCaptures.reserve((size_t)captureLane.limit);
+        } catch (const std::bad_alloc &) {
+            if (!captureLane.waitingCaptures.empty() && captureLane.waitingCaptures.back() == capture) {
+                captureLane.waitingCaptures.pop_back();
+            }
+            delete capture;
+            return false;
+        }
+        JSTCaptureLaneAdmit(scheduler, captureLane, admittedCaptures);
+    }
+    JSTCaptureSchedulerStart(admittedCaptures);
+    return true;
+}
+
+void JSTCaptureSchedulerFinish(JST_CAPTURE *capture, JST_BOOL succeeded, uint64_t byteCount)
+{
+    JST_CAPTURE_SCHEDULER *scheduler = capture->scheduler;
+    uint64_t endTime = JSTCaptureSchedulerNow(scheduler);
+
+    std::vector<JST_CAPTURE *> admittedCaptures;
+    {
+        std::lock_guard<std::mutex> lock(scheduler->mutex);
+        CaptureLane &captureLane = scheduler->lanes[capture->lane];
+        captureLane.runningCount -= 1;
+        captureLane.captureCount += 1;
+        JSTCaptureSchedulerRecord(scheduler, capture->udid.c_str(), succeeded, byteCount, capture->askTime, capture->startTime, endTime);
+        try {
+            admittedCaptures.reserve((size_t)captureLane.limit);
+        } catch (const std::bad_alloc &) {}
+        JSTCaptureLaneAdmit(scheduler, captureLane, admittedCaptures);
+    }
+    delete capture;
+    JSTCaptureSchedulerStart(admittedCaptures);
+}
+
+namespace {
+
+/* Hands a capture admitted on another thread over to the one waiting in
+ * JSTCaptureSchedulerRun. */
+struct CaptureWaiter {
+    std::mutex mutex;
+    std::condition_variable condition;
+    JST_CAPTURE *capture = nullptr;
+};
+
+}
+
+static void JSTCaptureWaiterStart(JST_CAPTURE *capture, void *context)
+{
+    CaptureWaiter *waiter = (CaptureWaiter *)context;
+    std::lock_guard<std::mutex> lock(waiter->mutex);
+    waiter->capture = capture;
+    waiter->condition.notify_one();
+}
+
+JST_BOOL JSTCaptureSchedulerRun(JST_CAPTURE_SCHEDULER *scheduler, JST_CAPTURE_LANE lane, const char *udid, JST_CAPTURE_JOB job, void *context)
+{
+    if (!job) {
+        return false;
+    }
+    CaptureWaiter waiter;
+    if (!JSTCaptureSchedulerSubmit(scheduler, lane, udid, JSTCaptureWaiterStart, &waiter)) {
+        return false;
+    }
+    JST_CAPTURE *capture;
+    {
+        std::unique_lock<std::mutex> lock(waiter.mutex);
+        waiter.condition.wait(lock, [&waiter] { return waiter.capture != nullptr; });
+        capture = waiter.capture;
+    }
+
+    uint64_t byteCount = 0;
+    bool succeeded = job(context, &byteCount);
+    JSTCaptureSchedulerFinish(capture, succeeded, byteCount);
+    return succeeded;
+}
+
+void JSTCaptureSchedulerRemoveDevice(JST_CAPTURE_SCHEDULER *scheduler, const char *udid)
+{
+    std::lock_guard<std::mutex> lock(scheduler->mutex);
+    scheduler->devices.erase(udid);
+}
+
+
+/* MARK: - Statistics */
+
+JST_BOOL JSTCaptureSchedulerGetThroughput(JST_CAPTURE_SCHEDULER *scheduler, const char *udid, JST_CAPTURE_THROUGHPUT *throughput)
+{
+    *throughput = JST_CAPTURE_THROUGHPUT();
+    uint64_t now = JSTCaptureSchedulerNow(scheduler);
+    uint64_t window = scheduler->options.throughputWindow;
+
+    std::lock_guard<std::mutex> lock(scheduler->mutex);
+    bool hasDevice = false;
+    uint64_t waitTime = 0, duration = 0;
+    for (auto &entry : scheduler->devices) {
+        if (udid && entry.first != udid) {
+            continue;
+        }
+        hasDevice = true;
+        CaptureDevice &device = entry.second;
+        JSTCaptureDeviceTrimSamples(scheduler, device, now);
+        throughput->captureCount += device.totals.captureCount;
+        throughput->failureCount += device.totals.failureCount;
+        throughput->byteCount += device.totals.byteCount;
+        waitTime += device.waitTime;
+        duration += device.duration;
+
+        /* a device seen for less than a window is measured since then,
+         * rates of several devices add up */
+        uint64_t span = std::min(window, now - device.firstTime);
+        if (span > 0) {
+            uint64_t byteCount = 0;
+            for (const CaptureSample &sample : device.samples) {
+                byteCount += sample.byteCount;
+            }
+            throughput->framesPerSecond += (double)device.samples.size() * 1e9 / (double)span;
+            throughput->bytesPerSecond += (double)byteCount * 1e9 / (double)span;
+        }
+    }
+    if (udid && !hasDevice) {
+        return false;
+    }
+
+    long long count = throughput->captureCount + throughput->failureCount;
+    if (count > 0) {
+        throughput->averageWait = (double)waitTime / 1e6 / (double)count;
+        throughput->averageDuration = (double)duration / 1e6 / (double)count;
+    }
+    return true;
+}
+
+JST_BOOL JSTCaptureSchedulerGetLaneStatistics(JST_CAPTURE_SCHEDULER *scheduler, JST_CAPTURE_LANE lane, JST_CAPTURE_LANE_STATISTICS *statistics)
+{
+    if (lane < 0 || lane >= JST_CAPTURE_LANE_COUNT) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(scheduler->mutex);
+    const CaptureLane &captureLane = scheduler->lanes[lane];
+    statistics->limit = captureLane.limit;
+    statistics->runningCount = captureLane.runningCount;
+    statistics->waitingCount = (int)captureLane.waitingCaptures.size();
+    statistics->peakRunningCount = captureLane.peakRunningCount;
+    statistics->captureCount = captureLane.captureCount;
+    return true;
+}
@@ -0,0 +1,111 @@
+#ifndef JSTCaptureScheduler_h
+#define JSTCaptureScheduler_h
+
+#include <stdint.h>
+#include "JST_BOOL.h"
+
+#ifdef __cplusplus
+#define JST_EXTERN extern "C"
+#else
+#define JST_EXTERN extern
+#endif
+
+/* Captures of many devices at once, a few at a time per transport.
+ *
+ * Devices are reached through a handful of shared transports: usbmuxd for
+ * the USB bus, the network, and the adb server for every Android device.
+ * Each of them saturates well before a rack of devices does, so captures
+ * are admitted per lane up to its limit, in the order they were asked for,
+ * and different lanes never wait for each other.
+ *
+ * The scheduler owns no thread and no caller has to wait for its turn:
+ * JSTCaptureSchedulerSubmit queues a capture, which is started by a
+ * callback once its lane admits it, and gives the lane back with
+ * JSTCaptureSchedulerFinish. JSTCaptureSchedulerRun does the same on the
+ * calling thread, for callers which capture synchronously anyway.
+ * It also keeps the throughput of every device. */
+
+typedef enum JST_CAPTURE_LANE {
+    JST_CAPTURE_LANE_USB = 0,
+    JST_CAPTURE_LANE_NETWORK,
+    JST_CAPTURE_LANE_ADB,
+    JST_CAPTURE_LANE_COUNT,
+} JST_CAPTURE_LANE;
+
+typedef struct JST_CAPTURE_SCHEDULER_OPTIONS {
+    int laneLimits[JST_CAPTURE_LANE_COUNT];  /* captures running at once per lane, at least 1 */
+    uint64_t throughputWindow;               /* rates are measured over the latest window, in ns */
+
+    /* Monotonic time in nanoseconds, may be NULL for the system clock. */
+    uint64_t (*now)(void *context);
+    void *context;
+} JST_CAPTURE_SCHEDULER_OPTIONS;
+
+/* Takes one capture, returns false if it failed. byteCount is what the
+ * capture produced, for the throughput, and starts at 0. */
+typedef JST_BOOL (*JST_CAPTURE_JOB)(void *context, uint64_t *byteCount);
+
+/* One capture, from its admission to JSTCaptureSchedulerFinish. */
+typedef struct JST_CAPTURE JST_CAPTURE;
+
+/* Starts a capture admitted by its lane. It is called on the thread which
+ * submitted it, or on the one which finished the capture before it, so it
+ * should hand long work over to a queue of its own. */
+typedef void (*JST_CAPTURE_START)(JST_CAPTURE *capture, void *context);
+
+typedef struct JST_CAPTURE_THROUGHPUT {
+    long long captureCount;   /* successful captures */
+    long long failureCount;
+    long long byteCount;      /* of successful captures */
+    double framesPerSecond;   /* successful captures over the window */
+    double bytesPerSecond;
+    double averageWait;       /* time spent waiting for the lane, in milliseconds */
+    double averageDuration;   /* time spent capturing, in milliseconds */
+} JST_CAPTURE_THROUGHPUT;
+
+typedef struct JST_CAPTURE_LANE_STATISTICS {
+    int limit;
+    int runningCount;
+    int waitingCount;
+    int peakRunningCount;     /* never above the limit */
+    long long captureCount;   /* finished, failures included */
+} JST_CAPTURE_LANE_STATISTICS;
+
+typedef struct JST_CAPTURE_SCHEDULER JST_CAPTURE_SCHEDULER;
+
+/* 4 USB, 2 network and 4 adb captures at once, a 10 s window. */
+JST_EXTERN void JSTCaptureSchedulerOptionsInit(JST_CAPTURE_SCHEDULER_OPTIONS *options);
+
+/* The options are copied. Returns NULL if the allocation fails. */
+JST_EXTERN JST_CAPTURE_SCHEDULER *JSTCaptureSchedulerCreate(const JST_CAPTURE_SCHEDULER_OPTIONS *options);
+
+/* No capture may still be running or waiting. */
+JST_EXTERN void JSTCaptureSchedulerFree(JST_CAPTURE_SCHEDULER *scheduler);
+
+/* Queues a capture of the device and returns at once. The capture is
+ * started once the lane admits it, possibly before this returns, and must
+ * be finished exactly once. Returns false without starting anything if the
+ * arguments are invalid. */
+JST_EXTERN JST_BOOL JSTCaptureSchedulerSubmit(JST_CAPTURE_SCHEDULER *scheduler, JST_CAPTURE_LANE lane, const char *udid, JST_CAPTURE_START start, void *context);
+
+/* Gives the lane of a started capture back and records it for the device,
+ * from any thread, then starts the captures which now fit. Frees capture. */
+JST_EXTERN void JSTCaptureSchedulerFinish(JST_CAPTURE *capture, JST_BOOL succeeded, uint64_t byteCount);
+
+/* Waits until the lane admits one more capture, runs the job on the calling
+ * thread and records it for the device. Returns what the job returned, or
+ * false without running it if the arguments are invalid. Must not be called
+ * from a start callback. */
+JST_EXTERN JST_BOOL JSTCaptureSchedulerRun(JST_CAPTURE_SCHEDULER *scheduler, JST_CAPTURE_LANE lane, const char *udid, JST_CAPTURE_JOB job, void *context);
+
+/* Throughput of one device, or of all of them if udid is NULL.
+ * Returns false for a device which was never captured. */
+JST_EXTERN JST_BOOL JSTCaptureSchedulerGetThroughput(JST_CAPTURE_SCHEDULER *scheduler, const char *udid, JST_CAPTURE_THROUGHPUT *throughput);
+
+/* Returns false if the lane is invalid. */
+JST_EXTERN JST_BOOL JSTCaptureSchedulerGetLaneStatistics(JST_CAPTURE_SCHEDULER *scheduler, JST_CAPTURE_LANE lane, JST_CAPTURE_LANE_STATISTICS *statistics);
+
+/* Forgets the throughput of a device which went away. */
+JST_EXTERN void JSTCaptureSchedulerRemoveDevice(JST_CAPTURE_SCHEDULER *scheduler, const char *udid);
+
+#endif /* JSTCaptureScheduler_h */
@@ -0,0 +1,393 @@
+#include "JSTCaptureTIFF.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <vector>
+
+
+/* MARK: - Directory */
+
+enum {
+    kTIFFTagImageWidth = 256,
+    kTIFFTagImageLength = 257,
+    kTIFFTagBitsPerSample = 258,
+    kTIFFTagCompression = 259,
+    kTIFFTagPhotometricInterpretation = 262,
+    kTIFFTagStripOffsets = 273,
+    kTIFFTagOrientation = 274,
+    kTIFFTagSamplesPerPixel = 277,
+    kTIFFTagRowsPerStrip = 278,
+    kTIFFTagStripByteCounts = 279,
+    kTIFFTagPlanarConfiguration = 284,
+    kTIFFTagExtraSamples = 338,
+    kTIFFTagICCProfile = 34675,
+};
+
+enum {
+    kTIFFTypeByte = 1,
+    kTIFFTypeShort = 3,
+    kTIFFTypeLong = 4,
+    kTIFFTypeUndefined = 7,
+};
+
+enum {
+    kTIFFCompressionNone = 1,
+    kTIFFCompressionPackBits = 32773,
+};
+
+/* Screenshots are a few thousand pixels wide, anything larger is corrupt. */
+static const int kTIFFMaximumDimension = 1 << 15;
+
+namespace {
+
+struct TIFFReader {
+    const uint8_t *bytes;
+    size_t length;
+    bool isBigEndian;
+
+    bool read16(size_t offset, uint32_t *value) const {
+        if (offset > length || length - offset < 2) {
+            return false;
+        }
+        const uint8_t *p = bytes + offset;
+        *value = isBigEndian ? ((uint32_t)p[0] << 8 | p[1]) : ((uint32_t)p[1] << 8 | p[0]);
+        return true;
+    }
+
+    bool read32(size_t offset, uint32_t *value) const {
+        if (offset > length || length - offset < 4) {
+            return false;
+        }
+        const uint8_t *p = bytes + offset;
+        *value = isBigEndian
+            ? ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3])
+            : ((uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0]);
+        return true;
+    }
+};
+
+struct TIFFEntry {
+    uint32_t type;
+    uint32_t count;
+    size_t valueOffset;  /* of the values, inline or not */
+    bool isPresent;
+};
+
+struct TIFFDirectory {
+    JST_CAPTURE_TIFF_INFO info;
+    uint32_t compression;
+    uint32_t rowsPerStrip;
+    TIFFEntry stripOffsets;
+    TIFFEntry stripByteCounts;
+};
+
+}  // namespace
+
+static size_t JSTCaptureTIFFTypeSize(uint32_t type)
+{
+    switch (type) {
+        case kTIFFTypeByte:
+        case kTIFFTypeUndefined:
+            return 1;
+        case kTIFFTypeShort:
+            return 2;
+        case kTIFFTypeLong:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static bool JSTCaptureTIFFReadEntryValue(const TIFFReader &reader, const TIFFEntry &entry, uint32_t index, uint32_t *value)
+{
+    if (index >= entry.count) {
+        return false;
+    }
+    switch (entry.type) {
+        case kTIFFTypeByte:
+        case kTIFFTypeUndefined:
+            if (entry.valueOffset + index >= reader.length) {
+                return false;
+            }
+            *value = reader.bytes[entry.valueOffset + index];
+            return true;
+        case kTIFFTypeShort:
+            return reader.read16(entry.valueOffset + (size_t)index * 2, value);
+        case kTIFFTypeLong:
+            return reader.read32(entry.valueOffset + (size_t)index * 4, value);
+        default:
+            return false;
+    }
+}
+
+static bool JSTCaptureTIFFReadDirectory(const void *data, size_t length, TIFFReader *reader, TIFFDirectory *directory)
+{
+    if (!JSTCaptureTIFFIsTIFF(data, length)) {
+        return false;
+    }
+    reader->bytes = (const uint8_t *)data;
+    reader->length = length;
+    reader->isBigEndian = reader->bytes[0] == 'M';
+
+    uint32_t directoryOffset, entryCount;
+    if (!reader->read32(4, &directoryOffset) || !reader->read16(directoryOffset, &entryCount)) {
+        return false;
+    }
+
+    TIFFEntry entries[13] = {};
+    const uint32_t tags[13] = {
+        kTIFFTagImageWidth, kTIFFTagImageLength, kTIFFTagBitsPerSample, kTIFFTagCompression,
+        kTIFFTagPhotometricInterpretation, kTIFFTagStripOffsets, kTIFFTagOrientation,
+        kTIFFTagSamplesPerPixel, kTIFFTagRowsPerStrip, kTIFFTagStripByteCounts,
+        kTIFFTagPlanarConfiguration, kTIFFTagExtraSamples, kTIFFTagICCProfile,
+    };
+    for (uint32_t i = 0; i < entryCount; ++i) {
+        size_t entryOffset = (size_t)directoryOffset + 2 + (size_t)i * 12;
+        uint32_t tag, type, count, value;
+        if (!reader->read16(entryOffset, &tag) || !reader->read16(entryOffset + 2, &type) ||
+            !reader->read32(entryOffset + 4, &count) || !reader->read32(entryOffset + 8, &value))
+        {
+            return false;
+        }
+        for (int t = 0; t < 13; ++t) {
+            if (tags[t] != tag) {
+                continue;
+            }
+            size_t typeSize = JSTCaptureTIFFTypeSize(type);
+            if (typeSize == 0 || count == 0) {
+                return false;
+            }
+            TIFFEntry &entry = entries[t];
+            entry.type = type;
+            entry.count = count;
+            entry.valueOffset = typeSize * count <= 4 ? entryOffset + 8 : value;
+            if (entry.valueOffset > length || typeSize * count > length - entry.valueOffset) {
+                return false;
+            }
+            entry.isPresent = true;
+        }
+    }
+
+    /* single valued tags, with their default */
+    uint32_t values[13] = { 0, 0, 1, kTIFFCompressionNone, 0, 0, 1, 1, 0xFFFFFFFFu, 0, 1, 0, 0 };
+    for (int t = 0; t < 13; ++t) {
+        if (entries[t].isPresent && !JSTCaptureTIFFReadEntryValue(*reader, entries[t], 0, &values[t])) {
+            return false;
+        }
+    }
+
+    JST_CAPTURE_TIFF_INFO &info = directory->info;
+    memset(&info, 0, sizeof(info));
+    if (values[0] == 0 || values[1] == 0 || values[0] > kTIFFMaximumDimension || values[1] > kTIFFMaximumDimension) {
+        return false;
+    }
+    info.width = (int)values[0];
+    info.height = (int)values[1];
+    info.samplesPerPixel = (int)values[7];
+    if (info.samplesPerPixel != 3 && info.samplesPerPixel != 4) {
+        return false;
+    }
+    for (uint32_t i = 0; i < (entries[2].isPresent ? entries[2].count : 0); ++i) {
+        uint32_t bitsPerSample;
+        if (!JSTCaptureTIFFReadEntryValue(*reader, entries[2], i, &bitsPerSample) || bitsPerSample != 8) {
+            return false;
+        }
+    }
+    if (values[2] != 8 || values[4] != 2 || values[10] != 1) {
+        return false;  /* 8-bit, RGB, chunky */
+    }
+    if (info.samplesPerPixel == 4) {
+        /* 0 is unspecified data, which we treat as padding */
+        info.hasAlpha = values[11] == 1 || values[11] == 2;
+        info.isAlphaPremultiplied = values[11] == 1;
+    }
+    info.orientation = values[6] >= 1 && values[6] <= 8 ? (int)values[6] : 1;
+    if (entries[12].isPresent) {
+        info.iccProfile = reader->bytes + entries[12].valueOffset;
+        info.iccProfileLength = (size_t)entries[12].count * JSTCaptureTIFFTypeSize(entries[12].type);
+    }
+
+    directory->compression = values[3];
+    if (directory->compression != kTIFFCompressionNone && directory->compression != kTIFFCompressionPackBits) {
+        return false;
+    }
+    directory->rowsPerStrip = values[8] == 0 || values[8] > (uint32_t)info.height ? (uint32_t)info.height : values[8];
+    uint32_t stripCount = ((uint32_t)info.height + directory->rowsPerStrip - 1) / directory->rowsPerStrip;
+    directory->stripOffsets = entries[5];
+    directory->stripByteCounts = entries[9];
+    if (!directory->stripOffsets.isPresent || directory->stripOffsets.count != stripCount) {
+        return false;
+    }
+    if (directory->stripByteCounts.isPresent) {
+        if (directory->stripByteCounts.count != stripCount) {
+            return false;
+        }
+    } else if (directory->compression != kTIFFCompressionNone) {
+        return false;  /* compressed strips cannot be delimited without their sizes */
+    }
+    return true;
+}
+
+
+/* MARK: - Rows */
+
+static void JSTCaptureTIFFConvertRGBRow(const uint8_t *samples, JST_COLOR *pixels, int width)
+{
+    for (int x = 0; x < width; ++x, samples += 3) {
+        pixels[x].theColor = 0xFF000000u | (uint32_t)samples[0] << 16 | (uint32_t)samples[1] << 8 | samples[2];
+    }
+}
+
+static void JSTCaptureTIFFConvertPremultipliedRGBARow(const uint8_t *samples, JST_COLOR *pixels, int width)
+{
+    for (int x = 0; x < width; ++x, samples += 4) {
+        pixels[x].theColor = (uint32_t)samples[3] << 24 | (uint32_t)samples[0] << 16 | (uint32_t)samples[1] << 8 | samples[2];
+    }
+}
+
+static inline uint32_t JSTCaptureTIFFPremultiply(uint32_t component, uint32_t alpha)
+{
+    /* exact rounding of component * alpha / 255 */
+    uint32_t product = component * alpha + 128;
+    return (product + (product >> 8)) >> 8;
+}
+
+static void JSTCaptureTIFFConvertUnassociatedRGBARow(const uint8_t *samples, JST_COLOR *pixels, int width)
+{
+    for (int x = 0; x < width; ++x, samples += 4) {
+        uint32_t alpha = samples[3];
+        if (alpha == 0xFF) {
+            pixels[x].theColor = 0xFF000000u | (uint32_t)samples[0] << 16 | (uint32_t)samples[1] << 8 | samples[2];
+            continue;
+        }
+        pixels[x].theColor = alpha << 24
+            | JSTCaptureTIFFPremultiply(samples[0], alpha) << 16
+            | JSTCaptureTIFFPremultiply(samples[1], alpha) << 8
+            | JSTCaptureTIFFPremultiply(samples[2], alpha);
+    }
+}
+
+static void JSTCaptureTIFFConvertPaddedRGBRow(const uint8_t *samples, JST_COLOR *pixels, int width)
+{
+    for (int x = 0; x < width; ++x, samples += 4) {
+        pixels[x].theColor = 0xFF000000u | (uint32_t)samples[0] << 16 | (uint32_t)samples[1] << 8 | samples[2];
+    }
+}
+
+/* Unpacks PackBits runs until length bytes are written. Returns false if
+ * the source runs out first. */
+static bool JSTCaptureTIFFUnpackBits(const uint8_t *source, size_t sourceLength, uint8_t *destination, size_t length)
+{
+    size_t i = 0, o = 0;
+    while (o < length) {
+        if (i >= sourceLength) {
+            return false;
+        }
+        int8_t header = (int8_t)source[i++];
+        if (header >= 0) {
+            size_t count = (size_t)header + 1;
+            if (count > sourceLength - i || count > length - o) {
+                return false;
+            }
+            memcpy(destination + o, source + i, count);
+            i += count;
+            o += count;
+        } else if (header != -128) {
+            size_t count = (size_t)(1 - header);
+            if (i >= sourceLength || count > length - o) {
+                return false;
+            }
+            memset(destination + o, source[i++], count);
+            o += count;
+        }
+    }
+    return true;
+}
+
+
+/* MARK: - Decoding */
+
+JST_BOOL JSTCaptureTIFFIsTIFF(const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    return length >= 8 && (memcmp(bytes, "II*\0", 4) == 0 || memcmp(bytes, "MM\0*", 4) == 0);
+}
+
+JST_BOOL JSTCaptureTIFFReadInfo(const void *data, size_t length, JST_CAPTURE_TIFF_INFO *info)
+{
+    TIFFReader reader;
+    TIFFDirectory directory;
+    if (!JSTCaptureTIFFReadDirectory(data, length, &reader, &directory)) {
+        return false;
+    }
+    *info = directory.info;
+    return true;
+}
+
+JST_BOOL JSTCaptureTIFFDecode(const void *data, size_t length, JST_COLOR *pixels, int alignedWidth)
+{
+    TIFFReader reader;
+    TIFFDirectory directory;
+    if (!JSTCaptureTIFFReadDirectory(data, length, &reader, &directory)) {
+        return false;
+    }
+    const JST_CAPTURE_TIFF_INFO &info = directory.info;
+    if (alignedWidth < info.width) {
+        return false;
+    }
+
+    void (*convertRow)(const uint8_t *, JST_COLOR *, int);
+    if (info.samplesPerPixel == 3) {
+        convertRow = JSTCaptureTIFFConvertRGBRow;
+    } else if (!info.hasAlpha) {
+        convertRow = JSTCaptureTIFFConvertPaddedRGBRow;
+    } else if (info.isAlphaPremultiplied) {
+        convertRow = JSTCaptureTIFFConvertPremultipliedRGBARow;
+    } else {
+        convertRow = JSTCaptureTIFFConvertUnassociatedRGBARow;
+    }
+
+    size_t rowLength = (size_t)info.width * (size_t)info.samplesPerPixel;
+    std::vector<uint8_t> unpackedStrip;
+    for (uint32_t strip = 0; strip < directory.stripOffsets.count; ++strip) {
+        int y1 = (int)(strip * directory.rowsPerStrip);
+        int rowCount = std::min((int)directory.rowsPerStrip, info.height - y1);
+        size_t stripLength = rowLength * (size_t)rowCount;
+
+        uint32_t stripOffset, stripByteCount;
+        if (!JSTCaptureTIFFReadEntryValue(reader, directory.stripOffsets, strip, &stripOffset)) {
+            return false;
+        }
+        if (directory.stripByteCounts.isPresent) {
+            if (!JSTCaptureTIFFReadEntryValue(reader, directory.stripByteCounts, strip, &stripByteCount)) {
+                return false;
+            }
+        } else {
+            stripByteCount = (uint32_t)std::min(stripLength, (size_t)UINT32_MAX);
+        }
+        if (stripOffset > length || stripByteCount > length - stripOffset) {
+            return false;
+        }
+
+        const uint8_t *samples = reader.bytes + stripOffset;
+        if (directory.compression == kTIFFCompressionPackBits) {
+            try {
+                unpackedStrip.resize(stripLength);
+            } catch (const std::bad_alloc &) {
+                return false;
+            }
+            if (!JSTCaptureTIFFUnpackBits(samples, stripByteCount, unpackedStrip.data(), stripLength)) {
+                return false;
+            }
+            samples = unpackedStrip.data();
+        } else if (stripByteCount < stripLength) {
+            return false;
+        }
+
+        for (int row = 0; row < rowCount; ++row) {
+            convertRow(samples + rowLength * (size_t)row, pixels + (size_t)(y1 + row) * (size_t)alignedWidth, info.width);
+        }
+    }
+    return true;
+}
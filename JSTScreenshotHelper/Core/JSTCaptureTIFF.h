@@ -0,0 +1,46 @@
+#ifndef JSTCaptureTIFF_h
+#define JSTCaptureTIFF_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "JST_BOOL.h"
+#include "JST_COLOR.h"
+
+#ifdef __cplusplus
+#define JST_EXTERN extern "C"
+#else
+#define JST_EXTERN extern
+#endif
+
+/* Decoder for the TIFF screenshots of screenshotr.
+ *
+ * Only the subset the service produces is supported: one image of 8-bit
+ * RGB or RGBA samples, chunky, stored in uncompressed or PackBits strips,
+ * in either byte order. Pixels are written as JST_COLOR (BGRA, alpha
+ * premultiplied), the layout of JST_IMAGE and of the bitmaps drawn by
+ * JSTPixelImage, so that a frame never goes through ImageIO. */
+
+typedef struct JST_CAPTURE_TIFF_INFO {
+    int width;
+    int height;
+    int samplesPerPixel;            /* 3 or 4 */
+    JST_BOOL hasAlpha;
+    JST_BOOL isAlphaPremultiplied;  /* associated alpha, ExtraSamples = 1 */
+    int orientation;                /* Orientation tag, 1 (top left) if absent */
+    const uint8_t *iccProfile;      /* points into the data, NULL if absent */
+    size_t iccProfileLength;
+} JST_CAPTURE_TIFF_INFO;
+
+/* Whether data starts like a TIFF file, in either byte order. */
+JST_EXTERN JST_BOOL JSTCaptureTIFFIsTIFF(const void *data, size_t length);
+
+/* Parses the first image directory. Returns false if the file is malformed
+ * or outside of the supported subset. */
+JST_EXTERN JST_BOOL JSTCaptureTIFFReadInfo(const void *data, size_t length, JST_CAPTURE_TIFF_INFO *info);
+
+/* Decodes every strip into pixels, rows alignedWidth colors apart, with
+ * alignedWidth >= info.width. Returns false if a strip is truncated, in
+ * which case pixels are partially written. */
+JST_EXTERN JST_BOOL JSTCaptureTIFFDecode(const void *data, size_t length, JST_COLOR *pixels, int alignedWidth);
+
+#endif /* JSTCaptureTIFF_h */
@@ -0,0 +1,599 @@
+#include "JSTCaptureAdb.h"
+#include "JSTPixelCore.h"
+#include "JSTTest.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* MARK: - Frames */
+
+/* Writes the output of screencap for a test pattern. */
+struct JSTTestAdbFrame {
+    int width = 7;
+    int height = 5;
+    int format = JST_CAPTURE_ADB_FORMAT_RGBA_8888;
+    int headerLength = 16;
+    uint32_t dataspace = 142671872;  /* sRGB */
+
+    /* premultiplied, with opaque, transparent and in between pixels */
+    JST_COLOR color(int x, int y) const {
+        JST_COLOR color;
+        uint32_t alpha = (x + y) % 3 == 0 ? 0xFF : (x + y) % 3 == 1 ? 0x00 : 0x80;
+        uint32_t red = (uint32_t)(x * 37 + y * 11) & 0xFF, green = (uint32_t)(x * 5 + y * 91) & 0xFF, blue = (uint32_t)(x * 71 + y * 3) & 0xFF;
+        if (format != JST_CAPTURE_ADB_FORMAT_RGBA_8888 && format != JST_CAPTURE_ADB_FORMAT_BGRA_8888) {
+            alpha = 0xFF;
+        }
+        if (format == JST_CAPTURE_ADB_FORMAT_RGB_565) {
+            red = (red & 0xF8) | (red >> 5);
+            green = (green & 0xFC) | (green >> 6);
+            blue = (blue & 0xF8) | (blue >> 5);
+        }
+        red = red * alpha / 255, green = green * alpha / 255, blue = blue * alpha / 255;
+        color.theColor = alpha << 24 | red << 16 | green << 8 | blue;
+        return color;
+    }
+
+    std::vector<uint8_t> encode() const {
+        std::vector<uint8_t> frame;
+        auto put32 = [&frame](uint32_t value) {
+            for (int i = 0; i < 4; ++i) {
+                frame.push_back((uint8_t)(value >> (8 * i)));
+            }
+        };
+        put32((uint32_t)width);
+        put32((uint32_t)height);
+        put32((uint32_t)format);
+        if (headerLength == 16) {
+            put32(dataspace);
+        }
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                JST_COLOR c = color(x, y);
+                switch (format) {
+                case JST_CAPTURE_ADB_FORMAT_RGBA_8888:
+                    frame.insert(frame.end(), {c.red, c.green, c.blue, c.alpha});
+                    break;
+                case JST_CAPTURE_ADB_FORMAT_RGBX_8888:
+                    /* the padding byte is not alpha */
+                    frame.insert(frame.end(), {c.red, c.green, c.blue, (uint8_t)(x * 13)});
+                    break;
+                case JST_CAPTURE_ADB_FORMAT_RGB_888:
+                    frame.insert(frame.end(), {c.red, c.green, c.blue});
+                    break;
+                case JST_CAPTURE_ADB_FORMAT_RGB_565: {
+                    uint32_t value = (uint32_t)(c.red >> 3) << 11 | (uint32_t)(c.green >> 2) << 5 | (uint32_t)(c.blue >> 3);
+                    frame.insert(frame.end(), {(uint8_t)value, (uint8_t)(value >> 8)});
+                    break;
+                }
+                case JST_CAPTURE_ADB_FORMAT_BGRA_8888:
+                    frame.insert(frame.end(), {c.blue, c.green, c.red, c.alpha});
+                    break;
+                }
+            }
+        }
+        return frame;
+    }
+};
+
+static const int JSTTestAdbFormats[] = {
+    JST_CAPTURE_ADB_FORMAT_RGBA_8888,
+    JST_CAPTURE_ADB_FORMAT_RGBX_8888,
+    JST_CAPTURE_ADB_FORMAT_RGB_888,
+    JST_CAPTURE_ADB_FORMAT_RGB_565,
+    JST_CAPTURE_ADB_FORMAT_BGRA_8888,
+};
+
+static void JSTTestExpectFramePixels(const JSTTestAdbFrame &spec, const JST_COLOR *pixels, int alignedWidth)
+{
+    int mismatches = 0;
+    for (int y = 0; y < spec.height; ++y) {
+        for (int x = 0; x < spec.width; ++x) {
+            if (pixels[(size_t)y * alignedWidth + x].theColor != spec.color(x, y).theColor) {
+                ++mismatches;
+            }
+        }
+    }
+    JST_EXPECT_EQ(mismatches, 0);
+}
+
+
+/* MARK: - Fake Server */
+
+/* Speaks the host side of the adb server protocol on an ephemeral port of
+ * the loopback interface, for one device which runs screencap and getprop. */
+struct JSTTestAdbServer {
+    std::string serial = "emulator-5554";
+    std::vector<uint8_t> frame;
+    size_t chunkLength = 7;     /* small writes, so that reads see partial frames */
+    size_t truncatedLength = 0;  /* stops the frame early if not 0 */
+    std::string execFailure;     /* replies FAIL to exec: if not empty */
+    bool isSilent = false;       /* accepts, then never replies */
+    std::string listing;         /* output of getprop */
+
+    int port = 0;
+    std::mutex mutex;
+    std::vector<std::string> requests;
+
+    JSTTestAdbServer() {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addressLength = sizeof(address);
+        if (bind(listener, (struct sockaddr *)&address, sizeof(address)) == 0 && listen(listener, 4) == 0 &&
+            getsockname(listener, (struct sockaddr *)&address, &addressLength) == 0) {
+            port = ntohs(address.sin_port);
+        }
+    }
+
+    ~JSTTestAdbServer() {
+        isStopped = true;
+        if (thread.joinable()) {
+            thread.join();
+        }
+        close(listener);
+    }
+
+    void start() {
+        thread = std::thread([this] { serve(); });
+    }
+
+private:
+    int listener;
+    std::atomic<bool> isStopped{false};
+    std::thread thread;
+
+    static bool readAll(int fd, void *data, size_t length) {
+        uint8_t *bytes = (uint8_t *)data;
+        while (length > 0) {
+            ssize_t result = read(fd, bytes, length);
+            if (result <= 0) {
+                return false;
+            }
+            bytes += result;
+            length -= (size_t)result;
+        }
+        return true;
+    }
+
+    static void writeAll(int fd, const void *data, size_t length) {
+        const uint8_t *bytes = (const uint8_t *)data;
+        while (length > 0) {
+            ssize_t result = send(fd, bytes, length, MSG_NOSIGNAL);
+            if (result <= 0) {
+                return;
+            }
+            bytes += result;
+            length -= (size_t)result;
+        }
+    }
+
+    bool readRequest(int fd, std::string *request) {
+        char length[5] = {0};
+        unsigned int count = 0;
+        if (!readAll(fd, length, 4) || sscanf(length, "%4x", &count) != 1) {
+            return false;
+        }
+        request->assign(count, '\0');
+        if (!readAll(fd, &(*request)[0], count)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(*request);
+        return true;
+    }
+
+    static void fail(int fd, const std::string &message) {
+        char length[5];
+        snprintf(length, sizeof(length), "%04zx", message.size());
+        writeAll(fd, "FAIL", 4);
+        writeAll(fd, length, 4);
+        writeAll(fd, message.data(), message.size());
+    }
+
+    void handle(int fd) {
+        if (isSilent) {
+            while (!isStopped) {
+                usleep(10 * 1000);
+            }
+            return;
+        }
+        std::string request;
+        if (!readRequest(fd, &request)) {
+            return;
+        }
+        if (request != "host:transport-any" && request != "host:transport:" + serial) {
+            fail(fd, "device '" + request.substr(request.rfind(':') + 1) + "' not found");
+            return;
+        }
+        writeAll(fd, "OKAY", 4);
+        if (!readRequest(fd, &request)) {
+            return;
+        }
+        if (request == "shell:getprop") {
+            writeAll(fd, "OKAY", 4);
+            for (size_t offset = 0; offset < listing.size(); offset += chunkLength) {
+                writeAll(fd, listing.data() + offset, std::min(chunkLength, listing.size() - offset));
+            }
+            return;
+        }
+        if (request != "exec:screencap" || !execFailure.empty()) {
+            fail(fd, execFailure.empty() ? "unknown service" : execFailure);
+            return;
+        }
+        writeAll(fd, "OKAY", 4);
+        size_t length = truncatedLength ? truncatedLength : frame.size();
+        for (size_t offset = 0; offset < length; offset += chunkLength) {
+            writeAll(fd, frame.data() + offset, std::min(chunkLength, length - offset));
+        }
+    }
+
+    void serve() {
+        while (!isStopped) {
+            struct pollfd descriptor = {listener, POLLIN, 0};
+            if (poll(&descriptor, 1, 10) <= 0) {
+                continue;
+            }
+            int fd = accept(listener, NULL, NULL);
+            if (fd < 0) {
+                continue;
+            }
+            handle(fd);
+            close(fd);
+        }
+    }
+};
+
+static JST_CAPTURE_ADB_OPTIONS JSTTestAdbOptions(const JSTTestAdbServer &server)
+{
+    JST_CAPTURE_ADB_OPTIONS options;
+    JSTCaptureAdbOptionsInit(&options);
+    options.port = server.port;
+    options.timeout = 2000;
+    return options;
+}
+
+
+/* MARK: - Frame Tests */
+
+JST_TEST(ReadsBothHeaderVersions)
+{
+    JSTTestAdbFrame spec;
+    spec.dataspace = 143261696;  /* Display P3 */
+    std::vector<uint8_t> frame = spec.encode();
+    JST_CAPTURE_ADB_FRAME_INFO info;
+    JST_ASSERT(JSTCaptureAdbReadFrameInfo(frame.data(), frame.size(), &info));
+    JST_EXPECT_EQ(info.width, 7);
+    JST_EXPECT_EQ(info.height, 5);
+    JST_EXPECT_EQ(info.format, JST_CAPTURE_ADB_FORMAT_RGBA_8888);
+    JST_EXPECT_EQ(info.bytesPerPixel, 4);
+    JST_EXPECT_EQ(info.headerLength, 16);
+    JST_EXPECT_EQ(info.dataspace, 143261696u);
+    JST_EXPECT_EQ(info.colorSpace, JST_CAPTURE_ADB_COLOR_SPACE_DISPLAY_P3);
+
+    /* before Android 8 there is no dataspace */
+    spec.headerLength = 12;
+    spec.format = JST_CAPTURE_ADB_FORMAT_RGB_565;
+    frame = spec.encode();
+    JST_ASSERT(JSTCaptureAdbReadFrameInfo(frame.data(), frame.size(), &info));
+    JST_EXPECT_EQ(info.headerLength, 12);
+    JST_EXPECT_EQ(info.bytesPerPixel, 2);
+    JST_EXPECT_EQ(info.dataspace, 0u);
+    JST_EXPECT_EQ(info.colorSpace, JST_CAPTURE_ADB_COLOR_SPACE_UNKNOWN);
+}
+
+JST_TEST(RejectsMalformedFrames)
+{
+    JSTTestAdbFrame spec;
+    std::vector<uint8_t> frame = spec.encode();
+    JST_CAPTURE_ADB_FRAME_INFO info;
+    JST_EXPECT(!JSTCaptureAdbReadFrameInfo(frame.data(), 11, &info));
+    JST_EXPECT(!JSTCaptureAdbReadFrameInfo(frame.data(), frame.size() - 1, &info));
+    frame.push_back(0);
+    JST_EXPECT(!JSTCaptureAdbReadFrameInfo(frame.data(), frame.size(), &info));
+
+    /* unknown format, empty and oversized frames */
+    for (uint32_t field : {8u, 0u, 4u}) {
+        frame = spec.encode();
+        frame[field] = field == 8 ? 7 : 0;
+        if (field == 4) {
+            frame[6] = 1;
+        }
+        JST_EXPECT(!JSTCaptureAdbReadFrameInfo(frame.data(), frame.size(), &info));
+    }
+
+    /* a buffer narrower than the frame */
+    frame = spec.encode();
+    std::vector<JST_COLOR> pixels(64);
+    JST_EXPECT(!JSTCaptureAdbConvertFrame(frame.data(), frame.size(), pixels.data(), 6, 1));
+}
+
+JST_TEST(ConvertsEveryFormat)
+{
+    for (int format : JSTTestAdbFormats) {
+        JSTTestAdbFrame spec;
+        spec.format = format;
+        std::vector<uint8_t> frame = spec.encode();
+
+        /* padded rows, the padding is left alone */
+        int alignedWidth = spec.width + 3;
+        std::vector<JST_COLOR> pixels((size_t)alignedWidth * spec.height);
+        for (JST_COLOR &pixel : pixels) {
+            pixel.theColor = 0x12345678;
+        }
+        JST_ASSERT(JSTCaptureAdbConvertFrame(frame.data(), frame.size(), pixels.data(), alignedWidth, 1));
+        JSTTestExpectFramePixels(spec, pixels.data(), alignedWidth);
+        JST_EXPECT_EQ(pixels[(size_t)spec.width].theColor, 0x12345678u);
+    }
+}
+
+JST_TEST(ExpandsRGB565)
+{
+    JSTTestAdbFrame spec;
+    spec.format = JST_CAPTURE_ADB_FORMAT_RGB_565;
+    spec.width = 4;
+    spec.height = 1;
+    std::vector<uint8_t> frame = spec.encode();
+    const uint16_t values[] = {0xF800, 0x07E0, 0x001F, 0x8410};
+    for (int i = 0; i < 4; ++i) {
+        frame[16 + 2 * i] = (uint8_t)values[i];
+        frame[16 + 2 * i + 1] = (uint8_t)(values[i] >> 8);
+    }
+    JST_COLOR pixels[4];
+    JST_ASSERT(JSTCaptureAdbConvertFrame(frame.data(), frame.size(), pixels, 4, 1));
+    JST_EXPECT_EQ(pixels[0].theColor, 0xFFFF0000u);
+    JST_EXPECT_EQ(pixels[1].theColor, 0xFF00FF00u);
+    JST_EXPECT_EQ(pixels[2].theColor, 0xFF0000FFu);
+    JST_EXPECT_EQ(pixels[3].theColor, 0xFF848284u);
+}
+
+JST_TEST(ConvertsInParallel)
+{
+    JSTTestAdbFrame spec;
+    spec.width = 61;
+    spec.height = 37;
+    std::vector<uint8_t> frame = spec.encode();
+    for (int threadCount : {2, 3, 8, 64}) {
+        std::vector<JST_COLOR> pixels((size_t)spec.width * spec.height);
+        JST_ASSERT(JSTCaptureAdbConvertFrame(frame.data(), frame.size(), pixels.data(), spec.width, threadCount));
+        JSTTestExpectFramePixels(spec, pixels.data(), spec.width);
+    }
+}
+
+
+/* MARK: - Server Tests */
+
+JST_TEST(StreamsScreencapIntoImage)
+{
+    for (int format : JSTTestAdbFormats) {
+        for (int headerLength : {12, 16}) {
+            JSTTestAdbServer server;
+            JST_ASSERT(server.port > 0);
+            JSTTestAdbFrame spec;
+            spec.width = 33;
+            spec.height = 21;
+            spec.format = format;
+            spec.headerLength = headerLength;
+            server.frame = spec.encode();
+            server.start();
+
+            JST_CAPTURE_ADB_OPTIONS options = JSTTestAdbOptions(server);
+            options.threadCount = 3;
+            JST_IMAGE *image = NULL;
+            JST_CAPTURE_ADB_FRAME_INFO info;
+            char message[128];
+            JST_CAPTURE_ADB_STATUS status = JSTCaptureAdbScreencap(&options, "emulator-5554", &image, &info, message, sizeof(message));
+            JST_ASSERT(status == JST_CAPTURE_ADB_STATUS_OK);
+            JST_EXPECT_EQ(message[0], '\0');
+            JST_EXPECT_EQ(image->width, spec.width);
+            JST_EXPECT_EQ(image->height, spec.height);
+            JST_EXPECT_EQ(image->orientation, 0);
+            JST_EXPECT_EQ(info.format, format);
+            JST_EXPECT_EQ(info.headerLength, headerLength);
+            JSTTestExpectFramePixels(spec, image->pixels, image->alignedWidth);
+            JSTFreePixelImage(image);
+
+            std::lock_guard<std::mutex> lock(server.mutex);
+            JST_ASSERT(server.requests.size() == 2);
+            JST_EXPECT(server.requests[0] == "host:transport:emulator-5554");
+            JST_EXPECT(server.requests[1] == "exec:screencap");
+        }
+    }
+}
+
+JST_TEST(StreamsLargeFramesInOneRead)
+{
+    JSTTestAdbServer server;
+    JSTTestAdbFrame spec;
+    spec.width = 1080;
+    spec.height = 2400;
+    server.frame = spec.encode();
+    server.chunkLength = 1 << 16;
+    server.start();
+
+    JST_CAPTURE_ADB_OPTIONS options = JSTTestAdbOptions(server);
+    options.threadCount = 4;
+    JST_IMAGE *image = NULL;
+    JST_ASSERT(JSTCaptureAdbScreencap(&options, "emulator-5554", &image, NULL, NULL, 0) == JST_CAPTURE_ADB_STATUS_OK);
+    JSTTestExpectFramePixels(spec, image->pixels, image->alignedWidth);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(SelectsAnyDeviceWithoutSerial)
+{
+    JSTTestAdbServer server;
+    server.frame = JSTTestAdbFrame().encode();
+    server.start();
+
+    JST_CAPTURE_ADB_OPTIONS options = JSTTestAdbOptions(server);
+    JST_IMAGE *image = NULL;
+    JST_ASSERT(JSTCaptureAdbScreencap(&options, NULL, &image, NULL, NULL, 0) == JST_CAPTURE_ADB_STATUS_OK);
+    JSTFreePixelImage(image);
+
+    std::lock_guard<std::mutex> lock(server.mutex);
+    JST_ASSERT(!server.requests.empty());
+    JST_EXPECT(server.requests[0] == "host:transport-any");
+}
+
+JST_TEST(ReportsServerFailures)
+{
+    JSTTestAdbServer server;
+    server.frame = JSTTestAdbFrame().encode();
+    server.start();
+    JST_CAPTURE_ADB_OPTIONS options = JSTTestAdbOptions(server);
+
+    JST_IMAGE *image = NULL;
+    char message[128];
+    JST_EXPECT(JSTCaptureAdbScreencap(&options, "R58M123", &image, NULL, message, sizeof(message)) == JST_CAPTURE_ADB_STATUS_REFUSED);
+    JST_EXPECT(strcmp(message, "device 'R58M123' not found") == 0);
+    JST_EXPECT(image == NULL);
+
+    /* messages are cut to the buffer */
+    char shortMessage[7];
+    JST_EXPECT(JSTCaptureAdbScreencap(&options, "R58M123", &image, NULL, shortMessage, sizeof(shortMessage)) == JST_CAPTURE_ADB_STATUS_REFUSED);
+    JST_EXPECT(strcmp(shortMessage, "device") == 0);
+}
+
+JST_TEST(ReportsExecFailures)
+{
+    JSTTestAdbServer server;
+    server.execFailure = "closed";
+    server.start();
+    JST_CAPTURE_ADB_OPTIONS options = JSTTestAdbOptions(server);
+
+    JST_IMAGE *image = NULL;
+    char message[128];
+    JST_EXPECT(JSTCaptureAdbScreencap(&options, "emulator-5554", &image, NULL, message, sizeof(message)) == JST_CAPTURE_ADB_STATUS_REFUSED);
+    JST_EXPECT(strcmp(message, "closed") == 0);
+}
+
+JST_TEST(RejectsTruncatedAndForeignOutput)
+{
+    JSTTestAdbFrame spec;
+    {
+        JSTTestAdbServer server;
+        server.frame = spec.encode();
+        server.truncatedLength = server.frame.size() - 5;
+        server.start();
+        JST_CAPTURE_ADB_OPTIONS options = JSTTestAdbOptions(server);
+        JST_IMAGE *image = NULL;
+        JST_EXPECT(JSTCaptureAdbScreencap(&options, "emulator-5554", &image, NULL, NULL, 0) == JST_CAPTURE_ADB_STATUS_BAD_FRAME);
+    }
+    {
+        /* what an old shell prints instead of a frame */
+        JSTTestAdbServer server;
+        const char text[] = "/system/bin/sh: screencap: not found\n";
+        server.frame.assign(text, text + sizeof(text) - 1);
+        server.start();
+        JST_CAPTURE_ADB_OPTIONS options = JSTTestAdbOptions(server);
+        JST_IMAGE *image = NULL;
+        char message[128];
+        JST_EXPECT(JSTCaptureAdbScreencap(&options, "emulator-5554", &image, NULL, message, sizeof(message)) == JST_CAPTURE_ADB_STATUS_BAD_FRAME);
+        JST_EXPECT(message[0] != '\0');
+    }
+    {
+        /* more bytes than the header announces */
+        JSTTestAdbServer server;
+        server.frame = spec.encode();
+        server.frame.insert(server.frame.end(), 9, 0);
+        server.start();
+        JST_CAPTURE_ADB_OPTIONS options = JSTTestAdbOptions(server);
+        JST_IMAGE *image = NULL;
+        JST_EXPECT(JSTCaptureAdbScreencap(&options, "emulator-5554", &image, NULL, NULL, 0) == JST_CAPTURE_ADB_STATUS_BAD_FRAME);
+    }
+}
+
+JST_TEST(ReportsMissingServer)
+{
+    int port;
+    {
+        /* a port nobody listens on any more */
+        JSTTestAdbServer server;
+        port = server.port;
+    }
+    JST_CAPTURE_ADB_OPTIONS options;
+    JSTCaptureAdbOptionsInit(&options);
+    options.port = port;
+    JST_IMAGE *image = NULL;
+    char message[128];
+    JST_EXPECT(JSTCaptureAdbScreencap(&options, "emulator-5554", &image, NULL, message, sizeof(message)) == JST_CAPTURE_ADB_STATUS_CONNECTION_FAILED);
+    JST_EXPECT(strstr(message, "cannot connect") != NULL);
+}
+
+JST_TEST(TimesOutOnSilentServer)
+{
+    JSTTestAdbServer server;
+    server.isSilent = true;
+    server.start();
+    JST_CAPTURE_ADB_OPTIONS options = JSTTestAdbOptions(server);
+    options.timeout = 100;
+    JST_IMAGE *image = NULL;
+    JST_EXPECT(JSTCaptureAdbScreencap(&options, "emulator-5554", &image, NULL, NULL, 0) == JST_CAPTURE_ADB_STATUS_PROTOCOL_ERROR);
+}
+
+
+/* MARK: - Property Tests */
+
+static const char JSTTestAdbListing[] =
+    "[dalvik.vm.heapsize]: [512m]\r\n"
+    "[persist.sys.locale]: [zh-Hans-CN]\r\n"
+    "[ro.build.version.release]: [13]\r\n"
+    "[ro.product.model]: [Pixel 7 [GVU6C]]\r\n"
+    "[ro.product.model.suffix]: [Pro]\r\n"
+    "[ro.serialno]: []\r\n";
+
+JST_TEST(ReadsPropertiesInOneRequest)
+{
+    JSTTestAdbServer server;
+    server.listing = JSTTestAdbListing;
+    server.start();
+    JST_CAPTURE_ADB_OPTIONS options = JSTTestAdbOptions(server);
+
+    const char *names[] = {"ro.product.model", "ro.build.version.release", "ro.serialno", "ro.product.brand", "product.model"};
+    char *values[5];
+    char message[128];
+    JST_ASSERT(JSTCaptureAdbGetProperties(&options, "emulator-5554", names, 5, values, message, sizeof(message)) == JST_CAPTURE_ADB_STATUS_OK);
+    JST_EXPECT_EQ(message[0], '\0');
+    JST_ASSERT(values[0] && values[1] && values[2]);
+    JST_EXPECT(strcmp(values[0], "Pixel 7 [GVU6C]") == 0);
+    JST_EXPECT(strcmp(values[1], "13") == 0);
+    JST_EXPECT(strcmp(values[2], "") == 0);
+    JST_EXPECT(values[3] == NULL);
+    JST_EXPECT(values[4] == NULL);  /* names are matched whole */
+    for (char *value : values) {
+        free(value);
+    }
+
+    std::lock_guard<std::mutex> lock(server.mutex);
+    JST_ASSERT(server.requests.size() == 2);
+    JST_EXPECT(server.requests[0] == "host:transport:emulator-5554");
+    JST_EXPECT(server.requests[1] == "shell:getprop");
+}
+
+JST_TEST(ReportsPropertyFailures)
+{
+    JSTTestAdbServer server;
+    server.listing = JSTTestAdbListing;
+    server.start();
+    JST_CAPTURE_ADB_OPTIONS options = JSTTestAdbOptions(server);
+
+    const char *names[] = {"ro.product.model"};
+    char *values[1];
+    char message[128];
+    JST_EXPECT(JSTCaptureAdbGetProperties(&options, "R58M123", names, 1, values, message, sizeof(message)) == JST_CAPTURE_ADB_STATUS_REFUSED);
+    JST_EXPECT(strcmp(message, "device 'R58M123' not found") == 0);
+    JST_EXPECT(values[0] == NULL);
+}
+
+JST_TEST_MAIN()
@@ -0,0 +1,260 @@
+#include "JSTCapturePNG.h"
+#include "JSTPixelCore.h"
+#include "JSTTest.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+/* MARK: - Decoder */
+
+/* Reads back what the encoder writes, checking every CRC and, through
+ * inflate, the adler32 of the combined stream. */
+struct JSTTestPNG {
+    int width = 0;
+    int height = 0;
+    int colorType = 0;
+    int idatCount = 0;
+    std::vector<uint8_t> samples;  /* unfiltered, 3 or 4 per pixel */
+
+    int channelCount() const {
+        return colorType == 2 ? 3 : 4;
+    }
+};
+
+static uint32_t JSTTestRead32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static bool JSTTestDecodePNG(const uint8_t *data, size_t length, JSTTestPNG *png)
+{
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    if (length < 8 || memcmp(data, signature, 8) != 0) {
+        return false;
+    }
+    std::vector<uint8_t> stream;
+    size_t offset = 8;
+    bool hasEnd = false;
+    while (offset + 12 <= length && !hasEnd) {
+        uint32_t chunkLength = JSTTestRead32(data + offset);
+        if (chunkLength > length - offset - 12) {
+            return false;
+        }
+        const uint8_t *type = data + offset + 4;
+        const uint8_t *chunk = type + 4;
+        if ((uint32_t)crc32(0, type, chunkLength + 4) != JSTTestRead32(chunk + chunkLength)) {
+            return false;
+        }
+        if (memcmp(type, "IHDR", 4) == 0) {
+            png->width = (int)JSTTestRead32(chunk);
+            png->height = (int)JSTTestRead32(chunk + 4);
+            png->colorType = chunk[9];
+            if (chunk[8] != 8 || chunk[12] != 0) {
+                return false;
+            }
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            stream.insert(stream.end(), chunk, chunk + chunkLength);
+            png->idatCount += 1;
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            hasEnd = true;
+        }
+        offset += 12 + chunkLength;
+    }
+    if (!hasEnd || offset != length) {
+        return false;
+    }
+
+    size_t rowLength = (size_t)png->width * (size_t)png->channelCount();
+    std::vector<uint8_t> filtered((rowLength + 1) * (size_t)png->height);
+    uLongf filteredLength = (uLongf)filtered.size();
+    if (uncompress(filtered.data(), &filteredLength, stream.data(), (uLong)stream.size()) != Z_OK || filteredLength != filtered.size()) {
+        return false;
+    }
+
+    int bpp = png->channelCount();
+    png->samples.assign(rowLength * (size_t)png->height, 0);
+    for (int y = 0; y < png->height; ++y) {
+        const uint8_t *source = filtered.data() + (rowLength + 1) * (size_t)y;
+        uint8_t *row = png->samples.data() + rowLength * (size_t)y;
+        const uint8_t *previousRow = y > 0 ? row - rowLength : NULL;
+        for (size_t i = 0; i < rowLength; ++i) {
+            int a = i >= (size_t)bpp ? row[i - bpp] : 0;
+            int b = previousRow ? previousRow[i] : 0;
+            int c = previousRow && i >= (size_t)bpp ? previousRow[i - bpp] : 0;
+            int predictor;
+            switch (source[0]) {
+            case 0: predictor = 0; break;
+            case 1: predictor = a; break;
+            case 2: predictor = b; break;
+            case 3: predictor = (a + b) / 2; break;
+            case 4: {
+                int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+                predictor = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+                break;
+            }
+            default:
+                return false;
+            }
+            row[i] = (uint8_t)(source[1 + i] + predictor);
+        }
+    }
+    return true;
+}
+
+static bool JSTTestEncodeAndDecode(const JST_IMAGE *image, int threadCount, int compressionLevel, JSTTestPNG *png)
+{
+    uint8_t *data = NULL;
+    size_t length = 0;
+    if (!JSTCapturePNGEncode(image, threadCount, compressionLevel, &data, &length)) {
+        return false;
+    }
+    bool isDecoded = JSTTestDecodePNG(data, length, png);
+    free(data);
+    return isDecoded;
+}
+
+
+/* MARK: - Images */
+
+/* Flat areas, gradients and noise, so that every filter gets picked. */
+static JST_IMAGE *JSTTestCreateImage(int width, int height, bool isOpaque)
+{
+    JST_IMAGE *image = JSTCreatePixelImage(width, height);
+    uint32_t seed = 12345;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            seed = seed * 1103515245u + 12345u;
+            uint32_t red = x < width / 3 ? 0x20 : x < 2 * width / 3 ? (uint32_t)(x + y) & 0xFF : (seed >> 8) & 0xFF;
+            uint32_t green = (uint32_t)(y * 3) & 0xFF, blue = (seed >> 16) & 0xFF;
+            uint32_t alpha = isOpaque ? 0xFF : (x + y) % 3 == 0 ? 0xFF : (x + y) % 3 == 1 ? 0x00 : 0x80;
+            JST_COLOR color;
+            color.theColor = alpha << 24 | (red * alpha / 255) << 16 | (green * alpha / 255) << 8 | (blue * alpha / 255);
+            JSTSetColorInPixelImageSafe(image, x, y, &color);
+        }
+    }
+    return image;
+}
+
+static int JSTTestCountMismatches(const JST_COLOR *pixels, int width, int height, const JSTTestPNG &png)
+{
+    int mismatches = 0, bpp = png.channelCount();
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            JST_COLOR color = pixels[(size_t)y * width + x];
+            const uint8_t *sample = png.samples.data() + ((size_t)y * width + x) * bpp;
+            uint32_t alpha = bpp == 4 ? sample[3] : 0xFF;
+            /* premultiplying the unpremultiplied samples gives the pixel back */
+            uint32_t red = (sample[0] * alpha + 127) / 255, green = (sample[1] * alpha + 127) / 255, blue = (sample[2] * alpha + 127) / 255;
+            if (alpha != color.alpha || red != color.red || green != color.green || blue != color.blue) {
+                ++mismatches;
+            }
+        }
+    }
+    return mismatches;
+}
+
+
+/* MARK: - Tests */
+
+JST_TEST(EncodesOpaqueImagesAsRGB)
+{
+    JST_IMAGE *image = JSTTestCreateImage(57, 23, true);
+    for (int threadCount : {1, 2, 3, 23, 64}) {
+        JSTTestPNG png;
+        JST_ASSERT(JSTTestEncodeAndDecode(image, threadCount, -1, &png));
+        JST_EXPECT_EQ(png.width, 57);
+        JST_EXPECT_EQ(png.height, 23);
+        JST_EXPECT_EQ(png.colorType, 2);
+        JST_EXPECT_EQ(JSTTestCountMismatches(image->pixels, 57, 23, png), 0);
+    }
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(UnpremultipliesTranslucentImages)
+{
+    JST_IMAGE *image = JSTTestCreateImage(31, 17, false);
+    for (int threadCount : {1, 4}) {
+        JSTTestPNG png;
+        JST_ASSERT(JSTTestEncodeAndDecode(image, threadCount, -1, &png));
+        JST_EXPECT_EQ(png.colorType, 6);
+        JST_EXPECT_EQ(JSTTestCountMismatches(image->pixels, 31, 17, png), 0);
+
+        /* transparent pixels carry no color */
+        JST_EXPECT_EQ(png.samples[4 * 1 + 0], 0);
+        JST_EXPECT_EQ(png.samples[4 * 1 + 3], 0);
+    }
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(EncodesEveryCompressionLevel)
+{
+    JST_IMAGE *image = JSTTestCreateImage(40, 30, true);
+    for (int level : {0, 1, 4, 6, 9}) {
+        JSTTestPNG png;
+        JST_ASSERT(JSTTestEncodeAndDecode(image, 3, level, &png));
+        JST_EXPECT_EQ(JSTTestCountMismatches(image->pixels, 40, 30, png), 0);
+    }
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(EncodesUprightImage)
+{
+    JST_IMAGE *image = JSTTestCreateImage(13, 9, true);
+    image->orientation = 1;
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(image, &width, &height);
+    std::vector<JST_COLOR> upright((size_t)width * height);
+    JSTCopyOrientedPixelsOfPixelImage(image, upright.data());
+
+    JSTTestPNG png;
+    JST_ASSERT(JSTTestEncodeAndDecode(image, 2, -1, &png));
+    JST_EXPECT_EQ(png.width, 9);
+    JST_EXPECT_EQ(png.height, 13);
+    JST_EXPECT_EQ(JSTTestCountMismatches(upright.data(), width, height, png), 0);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(EncodesPaddedImages)
+{
+    JST_IMAGE *source = JSTTestCreateImage(20, 10, true);
+    JST_IMAGE *image = JSTCreatePixelImageByCroppingPixelImage(source, 3, 2, 11, 7);
+    JST_ASSERT(image);
+    JST_IMAGE *packed = JSTCopyPixelImage(image);
+    std::vector<JST_COLOR> pixels((size_t)packed->width * packed->height);
+    JSTCopyOrientedPixelsOfPixelImage(packed, pixels.data());
+
+    JSTTestPNG png;
+    JST_ASSERT(JSTTestEncodeAndDecode(image, 2, -1, &png));
+    JST_EXPECT_EQ(png.width, 11);
+    JST_EXPECT_EQ(JSTTestCountMismatches(pixels.data(), 11, 7, png), 0);
+    JSTFreePixelImage(packed);
+    JSTFreePixelImage(image);
+    JSTFreePixelImage(source);
+}
+
+JST_TEST(SplitsLargeStreamsIntoChunks)
+{
+    /* stored blocks, so that the stream spans several IDAT chunks */
+    JST_IMAGE *image = JSTTestCreateImage(720, 640, false);
+    JSTTestPNG png;
+    JST_ASSERT(JSTTestEncodeAndDecode(image, 4, 0, &png));
+    JST_EXPECT(png.idatCount > 1);
+    JST_EXPECT_EQ(JSTTestCountMismatches(image->pixels, 720, 640, png), 0);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(RejectsEmptyImages)
+{
+    JST_IMAGE *image = JSTCreatePixelImage(0, 4);
+    uint8_t *data = NULL;
+    size_t length = 0;
+    JST_EXPECT(!JSTCapturePNGEncode(image, 1, -1, &data, &length));
+    JST_EXPECT(data == NULL);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST_MAIN()
@@ -0,0 +1,466 @@
+#include "JSTCapturePool.h"
+#include "JSTTest.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/* A stand-in for usbmuxd and lockdown: devices can be plugged, unplugged,
+ * locked or lack the developer disk image, and every connection drops when
+ * its device is unplugged, as with a real USB link. */
+struct JSTFakeDevice {
+    bool isPlugged = true;
+    bool isPaired = true;
+    bool hasDiskImage = true;
+    int connectionGeneration = 0;  /* bumped on unplug, stale sessions stop working */
+    int handshakeCount = 0;
+    int captureCount = 0;
+    int checkCount = 0;
+    int failingCaptureCount = 0;  /* captures which fail for another reason than the connection */
+    uint64_t captureCost = 1000 * 1000;  /* ns the fake clock advances per capture */
+};
+
+struct JSTFakeSession {
+    std::string udid;
+    int connectionGeneration;
+};
+
+struct JSTFakeHub {
+    std::mutex mutex;
+    std::map<std::string, JSTFakeDevice> devices;
+    std::atomic<uint64_t> clock{ 0 };
+    std::atomic<int> openSessionCount{ 0 };
+    std::atomic<int> concurrentCaptures{ 0 };
+    std::atomic<int> maximumConcurrentCaptures{ 0 };
+    int captureSleep = 0;  /* ms of real time per capture, to overlap threads */
+
+    void unplug(const std::string &udid) {
+        std::lock_guard<std::mutex> lock(mutex);
+        devices[udid].isPlugged = false;
+        devices[udid].connectionGeneration += 1;
+    }
+
+    void plug(const std::string &udid) {
+        std::lock_guard<std::mutex> lock(mutex);
+        devices[udid].isPlugged = true;
+    }
+};
+
+static JST_CAPTURE_STATUS JSTFakeOpenSession(void *context, const char *udid, void **session)
+{
+    JSTFakeHub *hub = (JSTFakeHub *)context;
+    std::lock_guard<std::mutex> lock(hub->mutex);
+    auto it = hub->devices.find(udid);
+    if (it == hub->devices.end() || !it->second.isPlugged) {
+        return JST_CAPTURE_STATUS_DISCONNECTED;
+    }
+    JSTFakeDevice &device = it->second;
+    if (!device.isPaired) {
+        return JST_CAPTURE_STATUS_NEEDS_PAIRING;
+    }
+    device.handshakeCount += 1;
+    if (!device.hasDiskImage) {
+        return JST_CAPTURE_STATUS_NEEDS_MOUNT;
+    }
+    *session = new JSTFakeSession{ udid, device.connectionGeneration };
+    hub->openSessionCount += 1;
+    return JST_CAPTURE_STATUS_OK;
+}
+
+static JST_CAPTURE_STATUS JSTFakeCheckSession(void *context, void *session)
+{
+    JSTFakeHub *hub = (JSTFakeHub *)context;
+    JSTFakeSession *fakeSession = (JSTFakeSession *)session;
+    std::lock_guard<std::mutex> lock(hub->mutex);
+    JSTFakeDevice &device = hub->devices[fakeSession->udid];
+    device.checkCount += 1;
+    if (!device.isPlugged || device.connectionGeneration != fakeSession->connectionGeneration) {
+        return JST_CAPTURE_STATUS_DISCONNECTED;
+    }
+    return JST_CAPTURE_STATUS_OK;
+}
+
+static JST_CAPTURE_STATUS JSTFakeCapture(void *context, void *session, void *request)
+{
+    JSTFakeHub *hub = (JSTFakeHub *)context;
+    JSTFakeSession *fakeSession = (JSTFakeSession *)session;
+    uint64_t captureCost;
+    {
+        std::lock_guard<std::mutex> lock(hub->mutex);
+        JSTFakeDevice &device = hub->devices[fakeSession->udid];
+        if (!device.isPlugged || device.connectionGeneration != fakeSession->connectionGeneration) {
+            return JST_CAPTURE_STATUS_DISCONNECTED;
+        }
+        if (device.failingCaptureCount > 0) {
+            device.failingCaptureCount -= 1;
+            return JST_CAPTURE_STATUS_FAILED;
+        }
+        device.captureCount += 1;
+        captureCost = device.captureCost;
+    }
+
+    int concurrentCaptures = ++hub->concurrentCaptures;
+    int maximum = hub->maximumConcurrentCaptures;
+    while (concurrentCaptures > maximum && !hub->maximumConcurrentCaptures.compare_exchange_weak(maximum, concurrentCaptures)) {
+    }
+    if (hub->captureSleep > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(hub->captureSleep));
+    }
+    hub->concurrentCaptures -= 1;
+
+    hub->clock += captureCost;
+    if (request) {
+        *(std::string *)request = fakeSession->udid;
+    }
+    return JST_CAPTURE_STATUS_OK;
+}
+
+static void JSTFakeCloseSession(void *context, void *session)
+{
+    JSTFakeHub *hub = (JSTFakeHub *)context;
+    hub->openSessionCount -= 1;
+    delete (JSTFakeSession *)session;
+}
+
+static uint64_t JSTFakeNow(void *context)
+{
+    return ((JSTFakeHub *)context)->clock;
+}
+
+static JST_CAPTURE_TRANSPORT JSTFakeTransport(JSTFakeHub *hub)
+{
+    JST_CAPTURE_TRANSPORT transport;
+    transport.context = hub;
+    transport.openSession = JSTFakeOpenSession;
+    transport.checkSession = JSTFakeCheckSession;
+    transport.capture = JSTFakeCapture;
+    transport.closeSession = JSTFakeCloseSession;
+    transport.now = JSTFakeNow;
+    return transport;
+}
+
+static const uint64_t JSTSecond = 1000ull * 1000 * 1000;
+
+
+/* MARK: - Sessions */
+
+JST_TEST(testSessionIsReusedBetweenCaptures)
+{
+    JSTFakeHub hub;
+    hub.devices["A"];
+    JST_CAPTURE_TRANSPORT transport = JSTFakeTransport(&hub);
+    JST_CAPTURE_POOL *pool = JSTCapturePoolCreate(&transport, NULL);
+    JST_ASSERT(pool != NULL);
+
+    for (int i = 0; i < 10; ++i) {
+        std::string capturedUDID;
+        JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", &capturedUDID), JST_CAPTURE_STATUS_OK);
+        JST_EXPECT(capturedUDID == "A");
+    }
+    JST_EXPECT_EQ(hub.devices["A"].handshakeCount, 1);
+    JST_EXPECT_EQ(hub.devices["A"].captureCount, 10);
+    JST_EXPECT_EQ(hub.devices["A"].checkCount, 0);
+    JST_EXPECT_EQ(hub.openSessionCount.load(), 1);
+
+    JST_CAPTURE_STATISTICS statistics;
+    JST_ASSERT(JSTCapturePoolGetStatistics(pool, "A", &statistics));
+    JST_EXPECT_EQ(statistics.captureCount, 10);
+    JST_EXPECT_EQ(statistics.sessionOpenCount, 1);
+    JST_EXPECT_EQ(statistics.reconnectCount, 0);
+
+    JSTCapturePoolFree(pool);
+    JST_EXPECT_EQ(hub.openSessionCount.load(), 0);
+}
+
+JST_TEST(testIdleSessionIsCheckedBeforeUse)
+{
+    JSTFakeHub hub;
+    hub.devices["A"];
+    JST_CAPTURE_TRANSPORT transport = JSTFakeTransport(&hub);
+    JST_CAPTURE_POOL_OPTIONS options;
+    JSTCapturePoolOptionsInit(&options);
+    options.healthCheckInterval = 2 * JSTSecond;
+    options.idleTimeout = 0;
+    JST_CAPTURE_POOL *pool = JSTCapturePoolCreate(&transport, &options);
+
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    JST_EXPECT_EQ(hub.devices["A"].checkCount, 0);
+
+    hub.clock += 3 * JSTSecond;
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    JST_EXPECT_EQ(hub.devices["A"].checkCount, 1);
+    JST_EXPECT_EQ(hub.devices["A"].handshakeCount, 1);
+
+    JSTCapturePoolFree(pool);
+}
+
+JST_TEST(testReconnectsAfterReplug)
+{
+    JSTFakeHub hub;
+    hub.devices["A"];
+    JST_CAPTURE_TRANSPORT transport = JSTFakeTransport(&hub);
+    JST_CAPTURE_POOL *pool = JSTCapturePoolCreate(&transport, NULL);
+
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    hub.unplug("A");
+    hub.plug("A");
+
+    /* the stale session fails, the pool reopens it within the same capture */
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    JST_EXPECT_EQ(hub.devices["A"].handshakeCount, 2);
+    JST_EXPECT_EQ(hub.openSessionCount.load(), 1);
+
+    /* a stale idle session is caught by the health check instead */
+    hub.unplug("A");
+    hub.plug("A");
+    hub.clock += 10 * JSTSecond;
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    JST_EXPECT_EQ(hub.devices["A"].handshakeCount, 3);
+    JST_EXPECT_EQ(hub.devices["A"].checkCount, 1);
+
+    JST_CAPTURE_STATISTICS statistics;
+    JST_ASSERT(JSTCapturePoolGetStatistics(pool, "A", &statistics));
+    JST_EXPECT_EQ(statistics.captureCount, 3);
+    JST_EXPECT_EQ(statistics.failureCount, 0);
+    JST_EXPECT_EQ(statistics.sessionOpenCount, 3);
+    JST_EXPECT_EQ(statistics.reconnectCount, 2);
+
+    JSTCapturePoolFree(pool);
+}
+
+JST_TEST(testFailsWhileUnplugged)
+{
+    JSTFakeHub hub;
+    hub.devices["A"];
+    JST_CAPTURE_TRANSPORT transport = JSTFakeTransport(&hub);
+    JST_CAPTURE_POOL *pool = JSTCapturePoolCreate(&transport, NULL);
+
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    hub.unplug("A");
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_DISCONNECTED);
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_DISCONNECTED);
+    JST_EXPECT_EQ(hub.openSessionCount.load(), 0);
+
+    hub.plug("A");
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+
+    JST_CAPTURE_STATISTICS statistics;
+    JST_ASSERT(JSTCapturePoolGetStatistics(pool, "A", &statistics));
+    JST_EXPECT_EQ(statistics.captureCount, 2);
+    JST_EXPECT_EQ(statistics.failureCount, 2);
+    JST_EXPECT_EQ(statistics.reconnectCount, 1);
+    JST_EXPECT_EQ(statistics.sampleCount, 2);
+
+    JSTCapturePoolFree(pool);
+}
+
+JST_TEST(testFailuresAreNotReconnects)
+{
+    JSTFakeHub hub;
+    hub.devices["A"];
+    JST_CAPTURE_TRANSPORT transport = JSTFakeTransport(&hub);
+    JST_CAPTURE_POOL_OPTIONS options;
+    JSTCapturePoolOptionsInit(&options);
+    options.reconnectAttempts = 5;
+    JST_CAPTURE_POOL *pool = JSTCapturePoolCreate(&transport, &options);
+
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    hub.devices["A"].failingCaptureCount = 2;
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_FAILED);
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_FAILED);
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+
+    /* the failed sessions are replaced all the same */
+    JST_CAPTURE_STATISTICS statistics;
+    JST_ASSERT(JSTCapturePoolGetStatistics(pool, "A", &statistics));
+    JST_EXPECT_EQ(statistics.captureCount, 2);
+    JST_EXPECT_EQ(statistics.failureCount, 2);
+    JST_EXPECT_EQ(statistics.sessionOpenCount, 3);
+    JST_EXPECT_EQ(statistics.reconnectCount, 0);
+
+    /* a lost connection still counts once reopened */
+    hub.unplug("A");
+    hub.plug("A");
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    JST_ASSERT(JSTCapturePoolGetStatistics(pool, "A", &statistics));
+    JST_EXPECT_EQ(statistics.reconnectCount, 1);
+
+    JSTCapturePoolFree(pool);
+}
+
+JST_TEST(testPairingAndMountAreNotRetried)
+{
+    JSTFakeHub hub;
+    hub.devices["locked"].isPaired = false;
+    hub.devices["unmounted"].hasDiskImage = false;
+    JST_CAPTURE_TRANSPORT transport = JSTFakeTransport(&hub);
+    JST_CAPTURE_POOL_OPTIONS options;
+    JSTCapturePoolOptionsInit(&options);
+    options.reconnectAttempts = 5;
+    JST_CAPTURE_POOL *pool = JSTCapturePoolCreate(&transport, &options);
+
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "locked", NULL), JST_CAPTURE_STATUS_NEEDS_PAIRING);
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "unmounted", NULL), JST_CAPTURE_STATUS_NEEDS_MOUNT);
+    JST_EXPECT_EQ(hub.devices["unmounted"].handshakeCount, 1);
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "missing", NULL), JST_CAPTURE_STATUS_DISCONNECTED);
+
+    /* once paired, the next capture goes through */
+    hub.devices["locked"].isPaired = true;
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "locked", NULL), JST_CAPTURE_STATUS_OK);
+    JST_EXPECT_EQ(hub.openSessionCount.load(), 1);
+
+    JSTCapturePoolFree(pool);
+}
+
+JST_TEST(testIdleSessionsAreClosed)
+{
+    JSTFakeHub hub;
+    hub.devices["A"];
+    hub.devices["B"];
+    JST_CAPTURE_TRANSPORT transport = JSTFakeTransport(&hub);
+    JST_CAPTURE_POOL_OPTIONS options;
+    JSTCapturePoolOptionsInit(&options);
+    options.idleTimeout = 60 * JSTSecond;
+    JST_CAPTURE_POOL *pool = JSTCapturePoolCreate(&transport, &options);
+
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    hub.clock += 30 * JSTSecond;
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "B", NULL), JST_CAPTURE_STATUS_OK);
+    JST_EXPECT_EQ(JSTCapturePoolCloseIdleSessions(pool), 0);
+    JST_EXPECT_EQ(hub.openSessionCount.load(), 2);
+
+    hub.clock += 40 * JSTSecond;
+    JST_EXPECT_EQ(JSTCapturePoolCloseIdleSessions(pool), 1);
+    JST_EXPECT_EQ(hub.openSessionCount.load(), 1);
+
+    /* a closed session is reopened without counting as a reconnect */
+    JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    JST_CAPTURE_STATISTICS statistics;
+    JST_ASSERT(JSTCapturePoolGetStatistics(pool, "A", &statistics));
+    JST_EXPECT_EQ(statistics.sessionOpenCount, 2);
+    JST_EXPECT_EQ(statistics.reconnectCount, 0);
+
+    JSTCapturePoolCloseSession(pool, "B");
+    JST_EXPECT_EQ(hub.openSessionCount.load(), 1);
+
+    JSTCapturePoolFree(pool);
+}
+
+
+/* MARK: - Statistics */
+
+JST_TEST(testLatencyPercentiles)
+{
+    JSTFakeHub hub;
+    hub.devices["A"];
+    JST_CAPTURE_TRANSPORT transport = JSTFakeTransport(&hub);
+    JST_CAPTURE_POOL_OPTIONS options;
+    JSTCapturePoolOptionsInit(&options);
+    options.latencySampleCount = 100;
+    JST_CAPTURE_POOL *pool = JSTCapturePoolCreate(&transport, &options);
+
+    /* 1 to 100 ms, then 50 more captures of 1000 ms push out the oldest half */
+    for (int i = 1; i <= 100; ++i) {
+        hub.devices["A"].captureCost = (uint64_t)i * 1000 * 1000;
+        JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    }
+    JST_CAPTURE_STATISTICS statistics;
+    JST_ASSERT(JSTCapturePoolGetStatistics(pool, "A", &statistics));
+    JST_EXPECT_EQ(statistics.sampleCount, 100);
+    JST_EXPECT_EQ(statistics.p50, 50);
+    JST_EXPECT_EQ(statistics.p90, 90);
+    JST_EXPECT_EQ(statistics.p99, 99);
+    JST_EXPECT_EQ(statistics.max, 100);
+
+    hub.devices["A"].captureCost = 1000ull * 1000 * 1000;
+    for (int i = 0; i < 50; ++i) {
+        JST_EXPECT_EQ(JSTCapturePoolCapture(pool, "A", NULL), JST_CAPTURE_STATUS_OK);
+    }
+    JST_ASSERT(JSTCapturePoolGetStatistics(pool, "A", &statistics));
+    JST_EXPECT_EQ(statistics.sampleCount, 100);
+    JST_EXPECT_EQ(statistics.captureCount, 150);
+    JST_EXPECT_EQ(statistics.p50, 100);
+    JST_EXPECT_EQ(statistics.p90, 1000);
+    JST_EXPECT_EQ(statistics.max, 1000);
+
+    JSTCapturePoolFree(pool);
+}
+
+JST_TEST(testStatisticsOfAllDevices)
+{
+    JSTFakeHub hub;
+    hub.devices["A"].captureCost = 10 * 1000 * 1000;
+    hub.devices["B"].captureCost = 30 * 1000 * 1000;
+    JST_CAPTURE_TRANSPORT transport = JSTFakeTransport(&hub);
+    JST_CAPTURE_POOL *pool = JSTCapturePoolCreate(&transport, NULL);
+
+    JST_CAPTURE_STATISTICS statistics;
+    JST_EXPECT(!JSTCapturePoolGetStatistics(pool, "A", &statistics));
+    JST_EXPECT(JSTCapturePoolGetStatistics(pool, NULL, &statistics));
+    JST_EXPECT_EQ(statistics.sampleCount, 0);
+
+    JSTCapturePoolCapture(pool, "A", NULL);
+    JSTCapturePoolCapture(pool, "B", NULL);
+    JSTCapturePoolCapture(pool, "B", NULL);
+    JST_ASSERT(JSTCapturePoolGetStatistics(pool, NULL, &statistics));
+    JST_EXPECT_EQ(statistics.captureCount, 3);
+    JST_EXPECT_EQ(statistics.sessionOpenCount, 2);
+    JST_EXPECT_EQ(statistics.p50, 30);
+    JST_EXPECT_EQ(statistics.max, 30);
+
+    JSTCapturePoolFree(pool);
+}
+
+
+/* MARK: - Concurrency */
+
+JST_TEST(testDevicesAreCapturedInParallel)
+{
+    JSTFakeHub hub;
+    hub.captureSleep = 20;
+    const char *udids[] = { "A", "B", "C", "D" };
+    for (const char *udid : udids) {
+        hub.devices[udid];
+    }
+    JST_CAPTURE_TRANSPORT transport = JSTFakeTransport(&hub);
+    JST_CAPTURE_POOL *pool = JSTCapturePoolCreate(&transport, NULL);
+
+    /* two threads per device: captures of a device are serialized, the
+     * devices themselves overlap */
+    std::vector<std::thread> threads;
+    std::atomic<int> failureCount{ 0 };
+    for (int t = 0; t < 8; ++t) {
+        const char *udid = udids[t % 4];
+        threads.emplace_back([&, udid]() {
+            for (int i = 0; i < 5; ++i) {
+                std::string capturedUDID;
+                if (JSTCapturePoolCapture(pool, udid, &capturedUDID) != JST_CAPTURE_STATUS_OK || capturedUDID != udid) {
+                    failureCount += 1;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    JST_EXPECT_EQ(failureCount.load(), 0);
+    JST_EXPECT(hub.maximumConcurrentCaptures.load() > 1);
+    JST_EXPECT(hub.maximumConcurrentCaptures.load() <= 4);
+    for (const char *udid : udids) {
+        JST_EXPECT_EQ(hub.devices[udid].handshakeCount, 1);
+        JST_EXPECT_EQ(hub.devices[udid].captureCount, 10);
+    }
+
+    JST_CAPTURE_STATISTICS statistics;
+    JST_ASSERT(JSTCapturePoolGetStatistics(pool, NULL, &statistics));
+    JST_EXPECT_EQ(statistics.captureCount, 40);
+
+    JSTCapturePoolFree(pool);
+}
+
+JST_TEST_MAIN()
@@ -0,0 +1,420 @@
+#include "JSTCaptureScheduler.h"
+#include "JSTTest.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Stands in for the capture of a device: it may take a while, fail, or
+ * hold its lane until the test lets it go. */
+struct JSTFakeCapture {
+    std::atomic<int> runningCount{ 0 };
+    std::atomic<int> maximumRunningCount{ 0 };
+    std::atomic<bool> isHeld{ false };
+    std::atomic<uint64_t> clock{ 0 };  /* ns, when the fake clock is used */
+    uint64_t duration = 0;             /* added to the fake clock by each capture */
+    int sleep = 0;                     /* ms, on the real clock */
+    uint64_t byteCount = 0;
+    bool fails = false;
+
+    std::mutex mutex;
+    std::vector<int> order;  /* tags of the captures, in the order they ran */
+};
+
+struct JSTFakeJob {
+    JSTFakeCapture *capture;
+    int tag;
+};
+
+static JST_BOOL JSTFakeRunJob(void *context, uint64_t *byteCount)
+{
+    JSTFakeJob *job = (JSTFakeJob *)context;
+    JSTFakeCapture *capture = job->capture;
+    int runningCount = ++capture->runningCount;
+    int maximum = capture->maximumRunningCount.load();
+    while (runningCount > maximum && !capture->maximumRunningCount.compare_exchange_weak(maximum, runningCount)) {}
+    {
+        std::lock_guard<std::mutex> lock(capture->mutex);
+        capture->order.push_back(job->tag);
+    }
+
+    while (capture->isHeld) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (capture->sleep > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(capture->sleep));
+    }
+    capture->clock += capture->duration;
+    *byteCount = capture->byteCount;
+    --capture->runningCount;
+    return !capture->fails;
+}
+
+static uint64_t JSTFakeNow(void *context)
+{
+    return ((JSTFakeCapture *)context)->clock;
+}
+
+static const uint64_t JSTMillisecond = 1000ull * 1000;
+static const uint64_t JSTSecond = 1000ull * JSTMillisecond;
+
+static JST_CAPTURE_LANE_STATISTICS JSTLaneStatistics(JST_CAPTURE_SCHEDULER *scheduler, JST_CAPTURE_LANE lane)
+{
+    JST_CAPTURE_LANE_STATISTICS statistics;
+    JSTCaptureSchedulerGetLaneStatistics(scheduler, lane, &statistics);
+    return statistics;
+}
+
+static void JSTWaitUntil(const std::function<bool()> &condition)
+{
+    for (int i = 0; i < 5000 && !condition(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+
+/* MARK: - Lanes */
+
+JST_TEST(testLaneLimitIsNeverExceeded)
+{
+    JST_CAPTURE_SCHEDULER_OPTIONS options;
+    JSTCaptureSchedulerOptionsInit(&options);
+    options.laneLimits[JST_CAPTURE_LANE_ADB] = 3;
+    JST_CAPTURE_SCHEDULER *scheduler = JSTCaptureSchedulerCreate(&options);
+    JST_ASSERT(scheduler != NULL);
+
+    /* twelve devices asking at once */
+    JSTFakeCapture capture;
+    capture.sleep = 5;
+    std::vector<std::thread> threads;
+    std::atomic<int> failureCount{ 0 };
+    for (int t = 0; t < 12; ++t) {
+        threads.emplace_back([&, t]() {
+            std::string udid = "emulator-" + std::to_string(5554 + 2 * t);
+            for (int i = 0; i < 4; ++i) {
+                JSTFakeJob job = { &capture, t };
+                if (!JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_ADB, udid.c_str(), JSTFakeRunJob, &job)) {
+                    failureCount += 1;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    JST_EXPECT_EQ(failureCount.load(), 0);
+    JST_EXPECT(capture.maximumRunningCount.load() > 1);
+    JST_EXPECT(capture.maximumRunningCount.load() <= 3);
+    JST_CAPTURE_LANE_STATISTICS statistics = JSTLaneStatistics(scheduler, JST_CAPTURE_LANE_ADB);
+    JST_EXPECT_EQ(statistics.limit, 3);
+    JST_EXPECT_EQ(statistics.runningCount, 0);
+    JST_EXPECT_EQ(statistics.waitingCount, 0);
+    JST_EXPECT_EQ(statistics.peakRunningCount, capture.maximumRunningCount.load());
+    JST_EXPECT_EQ(statistics.captureCount, 48);
+    JST_EXPECT_EQ(JSTLaneStatistics(scheduler, JST_CAPTURE_LANE_USB).captureCount, 0);
+
+    JSTCaptureSchedulerFree(scheduler);
+}
+
+JST_TEST(testLanesDoNotWaitForEachOther)
+{
+    JST_CAPTURE_SCHEDULER_OPTIONS options;
+    JSTCaptureSchedulerOptionsInit(&options);
+    options.laneLimits[JST_CAPTURE_LANE_USB] = 1;
+    JST_CAPTURE_SCHEDULER *scheduler = JSTCaptureSchedulerCreate(&options);
+
+    /* a stuck USB capture fills its lane */
+    JSTFakeCapture stuckCapture;
+    stuckCapture.isHeld = true;
+    JSTFakeJob stuckJob = { &stuckCapture, 0 };
+    std::thread stuckThread([&]() {
+        JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_USB, "A", JSTFakeRunJob, &stuckJob);
+    });
+    JSTWaitUntil([&]() { return stuckCapture.runningCount.load() == 1; });
+
+    /* the network and adb lanes go on */
+    JSTFakeCapture capture;
+    JSTFakeJob job = { &capture, 1 };
+    JST_EXPECT(JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_NETWORK, "B", JSTFakeRunJob, &job));
+    JST_EXPECT(JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_ADB, "C", JSTFakeRunJob, &job));
+
+    /* another USB device waits */
+    std::atomic<bool> isDone{ false };
+    std::thread waitingThread([&]() {
+        JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_USB, "D", JSTFakeRunJob, &job);
+        isDone = true;
+    });
+    JSTWaitUntil([&]() { return JSTLaneStatistics(scheduler, JST_CAPTURE_LANE_USB).waitingCount == 1; });
+    JST_EXPECT(!isDone);
+    JST_EXPECT_EQ(JSTLaneStatistics(scheduler, JST_CAPTURE_LANE_USB).runningCount, 1);
+
+    stuckCapture.isHeld = false;
+    stuckThread.join();
+    waitingThread.join();
+    JST_EXPECT(isDone);
+    JST_EXPECT_EQ(capture.order.size(), (size_t)3);
+    JST_EXPECT_EQ(JSTLaneStatistics(scheduler, JST_CAPTURE_LANE_USB).peakRunningCount, 1);
+
+    JSTCaptureSchedulerFree(scheduler);
+}
+
+JST_TEST(testLaneAdmitsInOrder)
+{
+    JST_CAPTURE_SCHEDULER_OPTIONS options;
+    JSTCaptureSchedulerOptionsInit(&options);
+    options.laneLimits[JST_CAPTURE_LANE_NETWORK] = 1;
+    JST_CAPTURE_SCHEDULER *scheduler = JSTCaptureSchedulerCreate(&options);
+
+    JSTFakeCapture capture;
+    capture.isHeld = true;
+    std::vector<JSTFakeJob> jobs;
+    for (int tag = 0; tag < 6; ++tag) {
+        jobs.push_back(JSTFakeJob{ &capture, tag });
+    }
+
+    /* each thread queues up only once the previous one waits */
+    std::vector<std::thread> threads;
+    for (int tag = 0; tag < 6; ++tag) {
+        threads.emplace_back([&, tag]() {
+            JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_NETWORK, tag % 2 ? "A" : "B", JSTFakeRunJob, &jobs[tag]);
+        });
+        JSTWaitUntil([&]() {
+            JST_CAPTURE_LANE_STATISTICS statistics = JSTLaneStatistics(scheduler, JST_CAPTURE_LANE_NETWORK);
+            return statistics.runningCount + statistics.waitingCount == tag + 1;
+        });
+    }
+    capture.isHeld = false;
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    JST_ASSERT(capture.order.size() == 6);
+    for (int tag = 0; tag < 6; ++tag) {
+        JST_EXPECT_EQ(capture.order[(size_t)tag], tag);
+    }
+    JST_EXPECT_EQ(capture.maximumRunningCount.load(), 1);
+
+    JSTCaptureSchedulerFree(scheduler);
+}
+
+JST_TEST(testInvalidArgumentsRunNothing)
+{
+    JST_CAPTURE_SCHEDULER *scheduler = JSTCaptureSchedulerCreate(NULL);
+    JSTFakeCapture capture;
+    JSTFakeJob job = { &capture, 0 };
+    JST_EXPECT(!JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_COUNT, "A", JSTFakeRunJob, &job));
+    JST_EXPECT(!JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_USB, NULL, JSTFakeRunJob, &job));
+    JST_EXPECT(!JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_USB, "A", NULL, &job));
+    JST_EXPECT(capture.order.empty());
+
+    JST_CAPTURE_LANE_STATISTICS statistics;
+    JST_EXPECT(!JSTCaptureSchedulerGetLaneStatistics(scheduler, JST_CAPTURE_LANE_COUNT, &statistics));
+    JST_ASSERT(JSTCaptureSchedulerGetLaneStatistics(scheduler, JST_CAPTURE_LANE_USB, &statistics));
+    JST_EXPECT_EQ(statistics.limit, 4);
+    JST_EXPECT_EQ(JSTLaneStatistics(scheduler, JST_CAPTURE_LANE_NETWORK).limit, 2);
+    JST_EXPECT_EQ(JSTLaneStatistics(scheduler, JST_CAPTURE_LANE_ADB).limit, 4);
+
+    JSTCaptureSchedulerFree(scheduler);
+}
+
+
+/* MARK: - Submissions */
+
+/* Keeps the captures started by the scheduler, which the test finishes. */
+struct JSTStartedCaptures {
+    std::vector<JST_CAPTURE *> captures;
+    std::vector<int> order;
+    bool finishesAtOnce = false;
+};
+
+struct JSTSubmission {
+    JSTStartedCaptures *started;
+    int tag;
+};
+
+static void JSTStartSubmission(JST_CAPTURE *capture, void *context)
+{
+    JSTSubmission *submission = (JSTSubmission *)context;
+    submission->started->order.push_back(submission->tag);
+    if (submission->started->finishesAtOnce) {
+        JSTCaptureSchedulerFinish(capture, true, 10);
+        return;
+    }
+    submission->started->captures.push_back(capture);
+}
+
+JST_TEST(testSubmissionsStartWhenTheLaneFrees)
+{
+    JST_CAPTURE_SCHEDULER_OPTIONS options;
+    JSTCaptureSchedulerOptionsInit(&options);
+    options.laneLimits[JST_CAPTURE_LANE_USB] = 2;
+    JST_CAPTURE_SCHEDULER *scheduler = JSTCaptureSchedulerCreate(&options);
+
+    /* every submission returns at once, two of them are started */
+    JSTStartedCaptures started;
+    std::vector<JSTSubmission> submissions;
+    for (int tag = 0; tag < 5; ++tag) {
+        submissions.push_back(JSTSubmission{ &started, tag });
+    }
+    for (JSTSubmission &submission : submissions) {
+        JST_EXPECT(JSTCaptureSchedulerSubmit(scheduler, JST_CAPTURE_LANE_USB, "A", JSTStartSubmission, &submission));
+    }
+    JST_ASSERT(started.captures.size() == 2);
+    JST_EXPECT_EQ(JSTLaneStatistics(scheduler, JST_CAPTURE_LANE_USB).runningCount, 2);
+    JST_EXPECT_EQ(JSTLaneStatistics(scheduler, JST_CAPTURE_LANE_USB).waitingCount, 3);
+
+    /* each finish starts the next one, in order */
+    JSTCaptureSchedulerFinish(started.captures[1], true, 100);
+    JST_ASSERT(started.captures.size() == 3);
+    JSTCaptureSchedulerFinish(started.captures[0], false, 0);
+    JSTCaptureSchedulerFinish(started.captures[2], true, 100);
+    JST_ASSERT(started.captures.size() == 5);
+    JSTCaptureSchedulerFinish(started.captures[3], true, 100);
+    JSTCaptureSchedulerFinish(started.captures[4], true, 100);
+
+    JST_ASSERT(started.order.size() == 5);
+    for (int tag = 0; tag < 5; ++tag) {
+        JST_EXPECT_EQ(started.order[(size_t)tag], tag);
+    }
+    JST_CAPTURE_LANE_STATISTICS statistics = JSTLaneStatistics(scheduler, JST_CAPTURE_LANE_USB);
+    JST_EXPECT_EQ(statistics.runningCount, 0);
+    JST_EXPECT_EQ(statistics.waitingCount, 0);
+    JST_EXPECT_EQ(statistics.peakRunningCount, 2);
+    JST_EXPECT_EQ(statistics.captureCount, 5);
+    JST_CAPTURE_THROUGHPUT throughput;
+    JST_ASSERT(JSTCaptureSchedulerGetThroughput(scheduler, "A", &throughput));
+    JST_EXPECT_EQ(throughput.captureCount, 4);
+    JST_EXPECT_EQ(throughput.failureCount, 1);
+    JST_EXPECT_EQ(throughput.byteCount, 400);
+
+    JST_EXPECT(!JSTCaptureSchedulerSubmit(scheduler, JST_CAPTURE_LANE_USB, "A", NULL, &submissions[0]));
+    JSTCaptureSchedulerFree(scheduler);
+}
+
+JST_TEST(testCapturesFinishedByTheirStartDoNotNest)
+{
+    JST_CAPTURE_SCHEDULER_OPTIONS options;
+    JSTCaptureSchedulerOptionsInit(&options);
+    options.laneLimits[JST_CAPTURE_LANE_ADB] = 1;
+    JST_CAPTURE_SCHEDULER *scheduler = JSTCaptureSchedulerCreate(&options);
+
+    /* a long queue behind a held capture, each of which then finishes as
+     * soon as it starts, would otherwise start the next one on the stack */
+    JSTStartedCaptures started;
+    std::vector<JSTSubmission> submissions;
+    for (int tag = 0; tag < 100000; ++tag) {
+        submissions.push_back(JSTSubmission{ &started, tag });
+    }
+    for (JSTSubmission &submission : submissions) {
+        JST_EXPECT(JSTCaptureSchedulerSubmit(scheduler, JST_CAPTURE_LANE_ADB, "emulator-5554", JSTStartSubmission, &submission));
+    }
+    JST_ASSERT(started.captures.size() == 1);
+    started.finishesAtOnce = true;
+    JSTCaptureSchedulerFinish(started.captures[0], true, 10);
+
+    JST_EXPECT_EQ(started.order.size(), (size_t)100000);
+    JST_CAPTURE_LANE_STATISTICS statistics = JSTLaneStatistics(scheduler, JST_CAPTURE_LANE_ADB);
+    JST_EXPECT_EQ(statistics.runningCount, 0);
+    JST_EXPECT_EQ(statistics.waitingCount, 0);
+    JST_EXPECT_EQ(statistics.captureCount, 100000);
+
+    JSTCaptureSchedulerFree(scheduler);
+}
+
+
+/* MARK: - Throughput */
+
+JST_TEST(testThroughputOfEachDevice)
+{
+    JSTFakeCapture capture;
+    capture.clock = JSTSecond;
+    capture.duration = 200 * JSTMillisecond;
+    capture.byteCount = 1000;
+
+    JST_CAPTURE_SCHEDULER_OPTIONS options;
+    JSTCaptureSchedulerOptionsInit(&options);
+    options.now = JSTFakeNow;
+    options.context = &capture;
+    JST_CAPTURE_SCHEDULER *scheduler = JSTCaptureSchedulerCreate(&options);
+
+    /* one capture a second for five seconds */
+    JSTFakeJob job = { &capture, 0 };
+    for (int i = 0; i < 5; ++i) {
+        JST_EXPECT(JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_USB, "A", JSTFakeRunJob, &job));
+        capture.clock += 800 * JSTMillisecond;
+    }
+    capture.fails = true;
+    JST_EXPECT(!JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_ADB, "B", JSTFakeRunJob, &job));
+    capture.clock += 800 * JSTMillisecond;
+
+    JST_CAPTURE_THROUGHPUT throughput;
+    JST_ASSERT(JSTCaptureSchedulerGetThroughput(scheduler, "A", &throughput));
+    JST_EXPECT_EQ(throughput.captureCount, 5);
+    JST_EXPECT_EQ(throughput.failureCount, 0);
+    JST_EXPECT_EQ(throughput.byteCount, 5000);
+    JST_EXPECT(throughput.framesPerSecond > 0.83 && throughput.framesPerSecond < 0.84);  /* 5 in 6 s */
+    JST_EXPECT(throughput.bytesPerSecond > 833 && throughput.bytesPerSecond < 834);
+    JST_EXPECT(throughput.averageWait == 0);
+    JST_EXPECT(throughput.averageDuration > 199.9 && throughput.averageDuration < 200.1);
+
+    /* failures count, but do not add to the rates */
+    JST_ASSERT(JSTCaptureSchedulerGetThroughput(scheduler, "B", &throughput));
+    JST_EXPECT_EQ(throughput.captureCount, 0);
+    JST_EXPECT_EQ(throughput.failureCount, 1);
+    JST_EXPECT(throughput.framesPerSecond == 0);
+
+    JST_ASSERT(JSTCaptureSchedulerGetThroughput(scheduler, NULL, &throughput));
+    JST_EXPECT_EQ(throughput.captureCount, 5);
+    JST_EXPECT_EQ(throughput.failureCount, 1);
+    JST_EXPECT(throughput.framesPerSecond > 0.83 && throughput.framesPerSecond < 0.84);
+
+    /* captures older than the window no longer count towards the rates */
+    capture.clock += 20 * JSTSecond;
+    JST_ASSERT(JSTCaptureSchedulerGetThroughput(scheduler, "A", &throughput));
+    JST_EXPECT_EQ(throughput.captureCount, 5);
+    JST_EXPECT(throughput.framesPerSecond == 0);
+    JST_EXPECT(throughput.bytesPerSecond == 0);
+
+    JST_EXPECT(!JSTCaptureSchedulerGetThroughput(scheduler, "C", &throughput));
+    JSTCaptureSchedulerRemoveDevice(scheduler, "A");
+    JST_EXPECT(!JSTCaptureSchedulerGetThroughput(scheduler, "A", &throughput));
+    JST_ASSERT(JSTCaptureSchedulerGetThroughput(scheduler, NULL, &throughput));
+    JST_EXPECT_EQ(throughput.captureCount, 0);
+
+    JSTCaptureSchedulerFree(scheduler);
+}
+
+JST_TEST(testWaitingIsMeasured)
+{
+    JST_CAPTURE_SCHEDULER_OPTIONS options;
+    JSTCaptureSchedulerOptionsInit(&options);
+    options.laneLimits[JST_CAPTURE_LANE_USB] = 1;
+    JST_CAPTURE_SCHEDULER *scheduler = JSTCaptureSchedulerCreate(&options);
+
+    JSTFakeCapture capture;
+    capture.sleep = 30;
+    JSTFakeJob job = { &capture, 0 };
+    std::thread thread([&]() {
+        JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_USB, "A", JSTFakeRunJob, &job);
+    });
+    JSTWaitUntil([&]() { return capture.runningCount.load() == 1; });
+    JST_EXPECT(JSTCaptureSchedulerRun(scheduler, JST_CAPTURE_LANE_USB, "B", JSTFakeRunJob, &job));
+    thread.join();
+
+    /* B waited for most of the capture of A */
+    JST_CAPTURE_THROUGHPUT throughput;
+    JST_ASSERT(JSTCaptureSchedulerGetThroughput(scheduler, "B", &throughput));
+    JST_EXPECT(throughput.averageWait > 10);
+    JST_EXPECT(throughput.averageDuration >= 29);
+    JST_ASSERT(JSTCaptureSchedulerGetThroughput(scheduler, "A", &throughput));
+    JST_EXPECT(throughput.averageWait < 10);
+
+    JSTCaptureSchedulerFree(scheduler);
+}
+
+JST_TEST_MAIN()
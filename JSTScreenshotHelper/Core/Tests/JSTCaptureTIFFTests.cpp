@@ -0,0 +1,378 @@
+#include "JSTCaptureTIFF.h"
+#include "JSTTest.h"
+
+#include <cstring>
+#include <vector>
+
+/* Writes the TIFF files screenshotr would send, with the knobs the decoder
+ * has to cope with. */
+struct JSTTestTIFF {
+    bool isBigEndian = true;
+    int width = 7;
+    int height = 5;
+    int samplesPerPixel = 3;
+    int extraSamples = -1;   /* ExtraSamples value, -1 to leave the tag out */
+    int rowsPerStrip = 2;
+    int compression = 1;
+    int orientation = 0;     /* 0 to leave the tag out */
+    std::vector<uint8_t> iccProfile;
+
+    uint8_t sample(int x, int y, int c) const {
+        if (c == 3) {
+            /* opaque, transparent and in between */
+            return (uint8_t)((x + y) % 3 == 0 ? 0xFF : (x + y) % 3 == 1 ? 0x00 : 0x80);
+        }
+        /* flat runs for PackBits, then noise */
+        if (x < width / 2) {
+            return (uint8_t)(y * 40 + c);
+        }
+        return (uint8_t)((x * 37 + y * 91 + c * 53) & 0xFF);
+    }
+};
+
+static void JSTTestPut16(std::vector<uint8_t> &bytes, size_t offset, uint32_t value, bool isBigEndian)
+{
+    bytes[offset + (isBigEndian ? 0 : 1)] = (uint8_t)(value >> 8);
+    bytes[offset + (isBigEndian ? 1 : 0)] = (uint8_t)value;
+}
+
+static void JSTTestPut32(std::vector<uint8_t> &bytes, size_t offset, uint32_t value, bool isBigEndian)
+{
+    for (int i = 0; i < 4; ++i) {
+        bytes[offset + (isBigEndian ? i : 3 - i)] = (uint8_t)(value >> (24 - 8 * i));
+    }
+}
+
+static std::vector<uint8_t> JSTTestPackBits(const uint8_t *bytes, size_t length)
+{
+    std::vector<uint8_t> packed;
+    size_t i = 0;
+    while (i < length) {
+        size_t run = 1;
+        while (i + run < length && run < 128 && bytes[i + run] == bytes[i]) {
+            ++run;
+        }
+        if (run >= 3) {
+            packed.push_back((uint8_t)(int8_t)(1 - (int)run));
+            packed.push_back(bytes[i]);
+            i += run;
+            continue;
+        }
+        size_t literal = 0;
+        while (i + literal < length && literal < 128) {
+            if (i + literal + 2 < length && bytes[i + literal] == bytes[i + literal + 1] && bytes[i + literal] == bytes[i + literal + 2]) {
+                break;
+            }
+            ++literal;
+        }
+        packed.push_back((uint8_t)(literal - 1));
+        packed.insert(packed.end(), bytes + i, bytes + i + literal);
+        i += literal;
+    }
+    return packed;
+}
+
+static std::vector<uint8_t> JSTTestEncodeTIFF(const JSTTestTIFF &spec)
+{
+    bool be = spec.isBigEndian;
+    std::vector<uint8_t> file(8);
+    memcpy(file.data(), be ? "MM\0*" : "II*\0", 4);
+
+    std::vector<uint32_t> stripOffsets, stripByteCounts;
+    for (int y1 = 0; y1 < spec.height; y1 += spec.rowsPerStrip) {
+        std::vector<uint8_t> strip;
+        for (int y = y1; y < std::min(y1 + spec.rowsPerStrip, spec.height); ++y) {
+            for (int x = 0; x < spec.width; ++x) {
+                for (int c = 0; c < spec.samplesPerPixel; ++c) {
+                    strip.push_back(spec.sample(x, y, c));
+                }
+            }
+        }
+        if (spec.compression == 32773) {
+            strip = JSTTestPackBits(strip.data(), strip.size());
+        }
+        stripOffsets.push_back((uint32_t)file.size());
+        stripByteCounts.push_back((uint32_t)strip.size());
+        file.insert(file.end(), strip.begin(), strip.end());
+    }
+
+    /* out of line values, then the directory */
+    auto appendArray = [&](const std::vector<uint32_t> &values, int typeSize) -> uint32_t {
+        uint32_t offset = (uint32_t)file.size();
+        file.resize(file.size() + values.size() * typeSize);
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (typeSize == 2) {
+                JSTTestPut16(file, offset + i * 2, values[i], be);
+            } else {
+                JSTTestPut32(file, offset + i * 4, values[i], be);
+            }
+        }
+        return offset;
+    };
+    struct Entry { uint32_t tag, type, count, value; bool isInline; };
+    std::vector<Entry> entries;
+    auto addShort = [&](uint32_t tag, uint32_t value) { entries.push_back({ tag, 3, 1, value, true }); };
+    auto addLongs = [&](uint32_t tag, const std::vector<uint32_t> &values) {
+        if (values.size() == 1) {
+            entries.push_back({ tag, 4, 1, values[0], true });
+        } else {
+            entries.push_back({ tag, 4, (uint32_t)values.size(), appendArray(values, 4), false });
+        }
+    };
+
+    addShort(256, (uint32_t)spec.width);
+    addShort(257, (uint32_t)spec.height);
+    std::vector<uint32_t> bitsPerSample((size_t)spec.samplesPerPixel, 8);
+    entries.push_back({ 258, 3, (uint32_t)bitsPerSample.size(), appendArray(bitsPerSample, 2), false });
+    addShort(259, (uint32_t)spec.compression);
+    addShort(262, 2);
+    addLongs(273, stripOffsets);
+    if (spec.orientation) {
+        addShort(274, (uint32_t)spec.orientation);
+    }
+    addShort(277, (uint32_t)spec.samplesPerPixel);
+    addShort(278, (uint32_t)spec.rowsPerStrip);
+    addLongs(279, stripByteCounts);
+    addShort(284, 1);
+    if (spec.extraSamples >= 0) {
+        addShort(338, (uint32_t)spec.extraSamples);
+    }
+    if (!spec.iccProfile.empty()) {
+        uint32_t offset = (uint32_t)file.size();
+        file.insert(file.end(), spec.iccProfile.begin(), spec.iccProfile.end());
+        entries.push_back({ 34675, 7, (uint32_t)spec.iccProfile.size(), offset, false });
+    }
+
+    if (file.size() % 2) {
+        file.push_back(0);
+    }
+    uint32_t directoryOffset = (uint32_t)file.size();
+    file.resize(file.size() + 2 + entries.size() * 12 + 4);
+    JSTTestPut32(file, 4, directoryOffset, be);
+    JSTTestPut16(file, directoryOffset, (uint32_t)entries.size(), be);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        size_t offset = directoryOffset + 2 + i * 12;
+        const Entry &entry = entries[i];
+        JSTTestPut16(file, offset, entry.tag, be);
+        JSTTestPut16(file, offset + 2, entry.type, be);
+        JSTTestPut32(file, offset + 4, entry.count, be);
+        if (entry.isInline && entry.type == 3) {
+            JSTTestPut16(file, offset + 8, entry.value, be);
+        } else {
+            JSTTestPut32(file, offset + 8, entry.value, be);
+        }
+    }
+    return file;
+}
+
+static uint32_t JSTTestExpectedColor(const JSTTestTIFF &spec, int x, int y)
+{
+    uint32_t r = spec.sample(x, y, 0), g = spec.sample(x, y, 1), b = spec.sample(x, y, 2);
+    uint32_t a = 0xFF;
+    if (spec.samplesPerPixel == 4 && (spec.extraSamples == 1 || spec.extraSamples == 2)) {
+        a = spec.sample(x, y, 3);
+        if (spec.extraSamples == 2) {
+            r = (r * a + 127) / 255;
+            g = (g * a + 127) / 255;
+            b = (b * a + 127) / 255;
+        }
+    }
+    return a << 24 | r << 16 | g << 8 | b;
+}
+
+static bool JSTTestDecodesExactly(const JSTTestTIFF &spec, int padding)
+{
+    std::vector<uint8_t> file = JSTTestEncodeTIFF(spec);
+    int alignedWidth = spec.width + padding;
+    std::vector<JST_COLOR> pixels((size_t)alignedWidth * spec.height);
+    for (JST_COLOR &pixel : pixels) {
+        pixel.theColor = 0xDEADBEEF;
+    }
+    if (!JSTCaptureTIFFDecode(file.data(), file.size(), pixels.data(), alignedWidth)) {
+        fprintf(stderr, "cannot decode %dx%d, %d samples\n", spec.width, spec.height, spec.samplesPerPixel);
+        return false;
+    }
+    for (int y = 0; y < spec.height; ++y) {
+        for (int x = 0; x < alignedWidth; ++x) {
+            uint32_t expected = x < spec.width ? JSTTestExpectedColor(spec, x, y) : 0xDEADBEEF;
+            uint32_t actual = pixels[(size_t)y * alignedWidth + x].theColor;
+            if (actual != expected) {
+                fprintf(stderr, "pixel (%d, %d): %08x instead of %08x\n", x, y, actual, expected);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+/* MARK: - Info */
+
+JST_TEST(testReadsInfo)
+{
+    JSTTestTIFF spec;
+    spec.width = 1179;
+    spec.height = 2556;
+    spec.samplesPerPixel = 4;
+    spec.extraSamples = 1;
+    spec.rowsPerStrip = 16;
+    spec.orientation = 6;
+    spec.iccProfile = { 'a', 'p', 'p', 'l', 'e', 'i', 'c', 'c' };
+    std::vector<uint8_t> file = JSTTestEncodeTIFF(spec);
+
+    JST_EXPECT(JSTCaptureTIFFIsTIFF(file.data(), file.size()));
+    JST_CAPTURE_TIFF_INFO info;
+    JST_ASSERT(JSTCaptureTIFFReadInfo(file.data(), file.size(), &info));
+    JST_EXPECT_EQ(info.width, 1179);
+    JST_EXPECT_EQ(info.height, 2556);
+    JST_EXPECT_EQ(info.samplesPerPixel, 4);
+    JST_EXPECT(info.hasAlpha);
+    JST_EXPECT(info.isAlphaPremultiplied);
+    JST_EXPECT_EQ(info.orientation, 6);
+    JST_ASSERT(info.iccProfile != NULL);
+    JST_EXPECT_EQ(info.iccProfileLength, 8);
+    JST_EXPECT(memcmp(info.iccProfile, "appleicc", 8) == 0);
+
+    spec.iccProfile.clear();
+    spec.orientation = 0;
+    spec.samplesPerPixel = 3;
+    spec.extraSamples = -1;
+    file = JSTTestEncodeTIFF(spec);
+    JST_ASSERT(JSTCaptureTIFFReadInfo(file.data(), file.size(), &info));
+    JST_EXPECT(!info.hasAlpha);
+    JST_EXPECT_EQ(info.orientation, 1);
+    JST_EXPECT(info.iccProfile == NULL);
+}
+
+JST_TEST(testRejectsOtherFiles)
+{
+    const uint8_t png[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n', 0, 0 };
+    JST_CAPTURE_TIFF_INFO info;
+    JST_EXPECT(!JSTCaptureTIFFIsTIFF(png, sizeof(png)));
+    JST_EXPECT(!JSTCaptureTIFFReadInfo(png, sizeof(png), &info));
+
+    std::vector<uint8_t> file = JSTTestEncodeTIFF(JSTTestTIFF());
+    JST_EXPECT(!JSTCaptureTIFFReadInfo(file.data(), 7, &info));
+
+    /* LZW */
+    JSTTestTIFF lzw;
+    lzw.compression = 5;
+    file = JSTTestEncodeTIFF(lzw);
+    JST_EXPECT(!JSTCaptureTIFFReadInfo(file.data(), file.size(), &info));
+
+    /* directory pointing past the end */
+    file = JSTTestEncodeTIFF(JSTTestTIFF());
+    JSTTestPut32(file, 4, (uint32_t)file.size() + 16, true);
+    JST_EXPECT(!JSTCaptureTIFFReadInfo(file.data(), file.size(), &info));
+}
+
+
+/* MARK: - Decoding */
+
+JST_TEST(testDecodesRGB)
+{
+    for (int isBigEndian = 0; isBigEndian <= 1; ++isBigEndian) {
+        for (int rowsPerStrip : { 1, 2, 3, 5, 8 }) {
+            JSTTestTIFF spec;
+            spec.isBigEndian = isBigEndian;
+            spec.rowsPerStrip = rowsPerStrip;
+            JST_EXPECT(JSTTestDecodesExactly(spec, 0));
+            JST_EXPECT(JSTTestDecodesExactly(spec, 3));
+        }
+    }
+}
+
+JST_TEST(testDecodesRGBA)
+{
+    for (int extraSamples : { -1, 0, 1, 2 }) {
+        JSTTestTIFF spec;
+        spec.samplesPerPixel = 4;
+        spec.extraSamples = extraSamples;
+        spec.isBigEndian = extraSamples % 2 == 0;
+        JST_EXPECT(JSTTestDecodesExactly(spec, 1));
+    }
+}
+
+JST_TEST(testPremultipliesExactly)
+{
+    /* every component and alpha pair against the reference rounding */
+    JSTTestTIFF spec;
+    spec.width = 256;
+    spec.height = 256;
+    spec.samplesPerPixel = 4;
+    spec.extraSamples = 2;
+    spec.rowsPerStrip = 64;
+    std::vector<uint8_t> file = JSTTestEncodeTIFF(spec);
+    JST_CAPTURE_TIFF_INFO info;
+    JST_ASSERT(JSTCaptureTIFFReadInfo(file.data(), file.size(), &info));
+
+    /* overwrite the samples with (x, x, x, y) */
+    size_t offset = 8;
+    for (int y = 0; y < 256; ++y) {
+        for (int x = 0; x < 256; ++x, offset += 4) {
+            file[offset] = file[offset + 1] = file[offset + 2] = (uint8_t)x;
+            file[offset + 3] = (uint8_t)y;
+        }
+    }
+    std::vector<JST_COLOR> pixels(256 * 256);
+    JST_ASSERT(JSTCaptureTIFFDecode(file.data(), file.size(), pixels.data(), 256));
+    int mismatchCount = 0;
+    for (int y = 0; y < 256; ++y) {
+        for (int x = 0; x < 256; ++x) {
+            const JST_COLOR &pixel = pixels[(size_t)y * 256 + x];
+            int expected = (x * y + 127) / 255;
+            if (pixel.red != expected || pixel.green != expected || pixel.blue != expected || pixel.alpha != y) {
+                ++mismatchCount;
+            }
+        }
+    }
+    JST_EXPECT_EQ(mismatchCount, 0);
+}
+
+JST_TEST(testDecodesPackBits)
+{
+    for (int samplesPerPixel : { 3, 4 }) {
+        JSTTestTIFF spec;
+        spec.width = 300;  /* longer than a PackBits run */
+        spec.height = 9;
+        spec.samplesPerPixel = samplesPerPixel;
+        spec.extraSamples = samplesPerPixel == 4 ? 2 : -1;
+        spec.rowsPerStrip = 4;
+        spec.compression = 32773;
+        JST_EXPECT(JSTTestDecodesExactly(spec, 0));
+    }
+}
+
+JST_TEST(testRejectsTruncatedStrips)
+{
+    for (int compression : { 1, 32773 }) {
+        JSTTestTIFF spec;
+        spec.compression = compression;
+        std::vector<uint8_t> file = JSTTestEncodeTIFF(spec);
+        std::vector<JST_COLOR> pixels((size_t)spec.width * spec.height);
+        JST_EXPECT(JSTCaptureTIFFDecode(file.data(), file.size(), pixels.data(), spec.width));
+
+        /* the last strip claims a byte less than it needs */
+        JST_CAPTURE_TIFF_INFO info;
+        JST_ASSERT(JSTCaptureTIFFReadInfo(file.data(), file.size(), &info));
+        size_t directoryOffset = (size_t)file[4] << 24 | (size_t)file[5] << 16 | (size_t)file[6] << 8 | file[7];
+        size_t entryCount = (size_t)file[directoryOffset] << 8 | file[directoryOffset + 1];
+        for (size_t i = 0; i < entryCount; ++i) {
+            size_t entry = directoryOffset + 2 + i * 12;
+            if (file[entry] == 0x01 && file[entry + 1] == 0x17) {  /* StripByteCounts */
+                size_t arrayOffset = (size_t)file[entry + 8] << 24 | (size_t)file[entry + 9] << 16 | (size_t)file[entry + 10] << 8 | file[entry + 11];
+                size_t last = arrayOffset + 4 * 2;
+                uint32_t count = (uint32_t)file[last] << 24 | (uint32_t)file[last + 1] << 16 | (uint32_t)file[last + 2] << 8 | file[last + 3];
+                JSTTestPut32(file, last, count - 1, true);
+            }
+        }
+        JST_EXPECT(!JSTCaptureTIFFDecode(file.data(), file.size(), pixels.data(), spec.width));
+    }
+
+    /* a buffer narrower than the image */
+    std::vector<uint8_t> file = JSTTestEncodeTIFF(JSTTestTIFF());
+    std::vector<JST_COLOR> pixels(64);
+    JST_EXPECT(!JSTCaptureTIFFDecode(file.data(), file.size(), pixels.data(), 6));
+}
+
+JST_TEST_MAIN()
@@ -6,6 +6,7 @@
 //  Copyright © 2021 JST. All rights reserved.
 //
 
+#import <CoreGraphics/CoreGraphics.h>
 #import "JSTScreenshotHelperProtocol.h"
 
 NS_ASSUME_NONNULL_BEGIN
@@ -30,6 +31,10 @@ NS_DESIGNATED_INITIALIZER;
 - (void)setType:(JSTDeviceType)type;
 - (void)takeScreenshotWithCompletionHandler:(JSTScreenshotHandler)completion;
 
+// Pixels and attributes as described by kJSTRawScreenshot*Key, the default implementation decodes the result of takeScreenshotWithCompletionHandler:.
+- (void)takeRawScreenshotWithCompletionHandler:(JSTRawScreenshotHandler)completion;
++ (nullable NSData *)rawScreenshotWithCGImage:(CGImageRef)image orientation:(uint8_t)orientation attributes:(NSDictionary <NSString *, id> * _Nullable * _Nonnull)attributes;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -7,6 +7,7 @@
 //
 
 #import "JSTDevice.h"
+#import <ImageIO/ImageIO.h>
 
 @implementation JSTDevice
 
@@ -54,4 +55,66 @@
     NSAssert(NO, @"Not implemented");
 }
 
+- (void)takeRawScreenshotWithCompletionHandler:(JSTRawScreenshotHandler)completion {
+    [self takeScreenshotWithCompletionHandler:^(NSData * _Nullable imageData, NSError * _Nullable error) {
+        if (!imageData) {
+            completion(nil, nil, error);
+            return;
+        }
+        CGImageSourceRef imgSrc = CGImageSourceCreateWithData((__bridge CFDataRef)imageData, NULL);
+        CGImageRef image = imgSrc ? CGImageSourceCreateImageAtIndex(imgSrc, 0, NULL) : NULL;
+        if (imgSrc) { CFRelease(imgSrc); }
+        if (!image) {
+            completion(nil, nil, [NSError errorWithDomain:kJSTScreenshotError code:0 userInfo:@{ NSLocalizedDescriptionKey: NSLocalizedString(@"Could not create image from the screenshot.", @"kJSTScreenshotError") }]);
+            return;
+        }
+        NSDictionary <NSString *, id> *attributes = nil;
+        NSData *pixels = [JSTDevice rawScreenshotWithCGImage:image orientation:0 attributes:&attributes];
+        CGImageRelease(image);
+        completion(pixels, attributes, nil);
+    }];
+}
+
++ (nullable NSData *)rawScreenshotWithCGImage:(CGImageRef)image orientation:(uint8_t)orientation attributes:(NSDictionary <NSString *, id> * _Nullable * _Nonnull)attributes {
+    size_t width = CGImageGetWidth(image);
+    size_t height = CGImageGetHeight(image);
+    size_t bytesPerRow = width * 4;
+    NSMutableData *pixels = [NSMutableData dataWithLength:bytesPerRow * height];
+    if (!pixels) {
+        return nil;
+    }
+    
+    CGColorSpaceRef colorSpace = CGImageGetColorSpace(image);
+    if (!colorSpace || CGColorSpaceGetModel(colorSpace) != kCGColorSpaceModelRGB) {
+        colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    } else {
+        CGColorSpaceRetain(colorSpace);
+    }
+    CGContextRef context = CGBitmapContextCreate(pixels.mutableBytes, width, height, 8, bytesPerRow, colorSpace, kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
+    if (!context) {
+        CGColorSpaceRelease(colorSpace);
+        return nil;
+    }
+    CGContextSetBlendMode(context, kCGBlendModeCopy);
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), image);
+    CGContextRelease(context);
+    
+    NSMutableDictionary <NSString *, id> *mutableAttributes = [NSMutableDictionary dictionaryWithDictionary:@{
+        kJSTRawScreenshotWidthKey: @(width),
+        kJSTRawScreenshotHeightKey: @(height),
+        kJSTRawScreenshotBytesPerRowKey: @(bytesPerRow),
+        kJSTRawScreenshotOrientationKey: @(orientation),
+    }];
+    CFDataRef iccData = CGColorSpaceCopyICCData(colorSpace);
+    if (iccData) {
+        mutableAttributes[kJSTRawScreenshotColorSpaceICCKey] = (__bridge_transfer NSData *)iccData;
+    } else if (CGColorSpaceGetName(colorSpace)) {
+        mutableAttributes[kJSTRawScreenshotColorSpaceNameKey] = (__bridge NSString *)CGColorSpaceGetName(colorSpace);
+    }
+    CGColorSpaceRelease(colorSpace);
+    
+    *attributes = [mutableAttributes copy];
+    return pixels;
+}
+
 @end
@@ -5,3 +5,6 @@
 #import "JSTScreenshotHelperProtocol.h"
 #import "JSTPairedDevice.h"
 #import "AppleDevice.h"
+#import "JSTPixelCore.h"
+#import "JSTCaptureAdb.h"
+#import "JSTCapturePNG.h"
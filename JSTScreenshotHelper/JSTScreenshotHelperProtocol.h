@@ -28,8 +28,26 @@ static JSTDeviceType const JSTDeviceTypeNetwork = @"network";
 static JSTDeviceType const JSTDeviceTypeBonjour = @"bonjour";
 
 typedef void (^JSTScreenshotHandler)(NSData * _Nullable, NSError * _Nullable);
+typedef void (^JSTRawScreenshotHandler)(NSData * _Nullable, NSDictionary <NSString *, id> * _Nullable, NSError * _Nullable);
 static const NSErrorDomain kJSTScreenshotError = @"com.jst.error.screenshot";
 
+/* Attributes of a raw screenshot, whose pixels are 8-bit BGRA with alpha
+ * premultiplied first in host byte order, the layout of JST_COLOR. */
+static NSString * const kJSTRawScreenshotWidthKey = @"width";                    // NSNumber
+static NSString * const kJSTRawScreenshotHeightKey = @"height";                  // NSNumber
+static NSString * const kJSTRawScreenshotBytesPerRowKey = @"bytesPerRow";        // NSNumber
+static NSString * const kJSTRawScreenshotOrientationKey = @"orientation";        // NSNumber, JST_ORIENTATION
+static NSString * const kJSTRawScreenshotColorSpaceICCKey = @"colorSpaceICC";    // NSData, optional
+static NSString * const kJSTRawScreenshotColorSpaceNameKey = @"colorSpaceName";  // NSString, optional, sRGB if both are missing
+
+/* Attributes of a shared screenshot, in addition to the raw ones: where its
+ * pixels are in the frame transport of the connection (JSTPixelTransport.h),
+ * packed rows, bytesPerRow is width * 4. */
+static NSString * const kJSTSharedScreenshotTransportKey = @"transport";        // NSNumber, identifier of the transport
+static NSString * const kJSTSharedScreenshotSequenceKey = @"sequence";          // NSNumber
+static NSString * const kJSTSharedScreenshotSlotKey = @"slot";                  // NSNumber
+static NSString * const kJSTSharedScreenshotTimestampKey = @"timestamp";        // NSNumber, CLOCK_UPTIME_RAW nanoseconds when the frame was written
+
 
 NS_INLINE NSString *RealHomeDirectory(void) {
     struct passwd *pw = getpwuid(getuid());
@@ -70,6 +88,10 @@ NS_INLINE NSString *GetJSTColorPickerDeviceSupportPath(void) {
 - (void)discoveredDevicesWithReply:(void (^)(NSData * _Nullable, NSError * _Nullable))reply;
 - (void)lookupDeviceByUDID:(NSString *)udid withReply:(void (^)(NSData * _Nullable, NSError * _Nullable))reply;
 - (void)takeScreenshotByUDID:(NSString *)udid withReply:(void (^)(NSData * _Nullable, NSError * _Nullable))reply;
+- (void)takeRawScreenshotByUDID:(NSString *)udid withReply:(void (^)(NSData * _Nullable pixels, NSData * _Nullable attributes, NSError * _Nullable))reply;
+- (void)takeSharedScreenshotByUDID:(NSString *)udid withReply:(void (^)(NSData * _Nullable attributes, NSError * _Nullable))reply;
+- (void)openFrameTransportWithReply:(void (^)(NSFileHandle * _Nullable, NSError * _Nullable))reply;
+- (void)captureStatisticsByUDID:(nullable NSString *)udid withReply:(void (^)(NSData * _Nullable, NSError * _Nullable))reply;
 - (void)tellConsoleToStartStreamingWithReply:(void (^)(NSData * _Nullable, NSError * _Nullable))reply;
 
 @end
@@ -15,24 +15,92 @@ final class AdbHelper: NSObject {
     static let adb = Bundle.main.url(forAuxiliaryExecutable: "adb")!
     private static let namespace = "AdbHelper"
     
+    private static let modelProperty = "ro.product.model"
+    private static let versionProperty = "ro.build.version.release"
+    private static let deviceProperties = [modelProperty, versionProperty]
+
+    // properties do not change while a device stays connected
+    private static let propertyLock = NSLock()
+    private static var cachedProperties = [String: [String: String]]()
+
     static func fetchDeviceName(_ deviceId: String) -> String {
-        let command = "\(adb.path) -s '\(deviceId)' shell getprop ro.product.model"
-        return AuxiliaryExecute.local.bash(command: command, timeout: 3).stdout.trimmingCharacters(in: .whitespacesAndNewlines)
+        return fetchDeviceProperties(deviceId)[modelProperty] ?? ""
     }
     
     static func fetchDeviceVersion(_ deviceId: String) -> String {
-        let command = "\(adb.path) -s '\(deviceId)' shell getprop ro.build.version.release"
-        return AuxiliaryExecute.local.bash(command: command, timeout: 3).stdout.trimmingCharacters(in: .whitespacesAndNewlines)
+        return fetchDeviceProperties(deviceId)[versionProperty] ?? ""
+    }
+
+    /// Reads every property a device is described with in one round trip through the adb server, once per device.
+    static func fetchDeviceProperties(_ deviceId: String) -> [String: String] {
+        propertyLock.lock()
+        let cached = cachedProperties[deviceId]
+        propertyLock.unlock()
+        if let cached = cached {
+            return cached
+        }
+
+        var result = readDeviceProperties(deviceId)
+        if result.status == JST_CAPTURE_ADB_STATUS_CONNECTION_FAILED {
+            _ = AuxiliaryExecute.local.bash(command: "\(adb.path) start-server", timeout: 10)
+            result = readDeviceProperties(deviceId)
+        }
+        guard let properties = result.properties else {
+            // device is still authorizing or offline, asked again on the next discovery
+            return [:]
+        }
+        propertyLock.lock()
+        cachedProperties[deviceId] = properties
+        propertyLock.unlock()
+        return properties
+    }
+
+    private static func readDeviceProperties(_ deviceId: String) -> (properties: [String: String]?, status: JST_CAPTURE_ADB_STATUS) {
+        let names = deviceProperties.map { strdup($0) }
+        defer { names.forEach { free($0) } }
+        var values = [UnsafeMutablePointer<CChar>?](repeating: nil, count: names.count)
+        var options = JST_CAPTURE_ADB_OPTIONS()
+        JSTCaptureAdbOptionsInit(&options)
+        options.timeout = 3 * 1000
+        let status = names.map { UnsafePointer($0) }.withUnsafeBufferPointer { nameBuffer in
+            deviceId.withCString { JSTCaptureAdbGetProperties(&options, $0, nameBuffer.baseAddress, Int32(names.count), &values, nil, 0) }
+        }
+        guard status == JST_CAPTURE_ADB_STATUS_OK else {
+            return (nil, status)
+        }
+        var properties = [String: String]()
+        for (name, value) in zip(deviceProperties, values) {
+            if let value = value {
+                properties[name] = String(cString: value).trimmingCharacters(in: .whitespacesAndNewlines)
+                free(value)
+            }
+        }
+        return (properties, status)
+    }
+
+    private static func forgetDeviceProperties(exceptFor deviceIds: Set<String>) {
+        propertyLock.lock()
+        cachedProperties = cachedProperties.filter { deviceIds.contains($0.key) }
+        propertyLock.unlock()
     }
 
     @objc
     static func getDevices() -> [AndroidDevice] {
         let command = "\(adb.path) devices -l | awk 'NR>1 {print $1}'"
         let devicesResult = AuxiliaryExecute.local.bash(command: command, timeout: 3).stdout.trimmingCharacters(in: .whitespacesAndNewlines)
-        return devicesResult
+        let deviceIds = devicesResult
             .components(separatedBy: .newlines)
             .filter { !$0.isEmpty }
-            .compactMap { AndroidDevice(udid: $0, type: JSTDeviceTypeUSB) }
+        forgetDeviceProperties(exceptFor: Set(deviceIds))
+
+        // devices seen for the first time are asked for their properties, all of them at once
+        var devices = [AndroidDevice?](repeating: nil, count: deviceIds.count)
+        devices.withUnsafeMutableBufferPointer { buffer in
+            DispatchQueue.concurrentPerform(iterations: deviceIds.count) { index in
+                buffer[index] = AndroidDevice(udid: deviceIds[index], type: JSTDeviceTypeUSB)
+            }
+        }
+        return devices.compactMap { $0 }
     }
 
     static func promiseCreateDirectoryForScreenCapture(_ deviceId: String) -> Promise<URL> {
@@ -112,6 +180,74 @@ final class AdbHelper: NSObject {
             }
         }
     }
+
+    // MARK: - Streaming Capture
+
+    /// A frame streamed from `screencap`, its pixels are released with it.
+    final class ScreenFrame {
+        let image: UnsafeMutablePointer<JST_IMAGE>
+        let info: JST_CAPTURE_ADB_FRAME_INFO
+
+        init(image: UnsafeMutablePointer<JST_IMAGE>, info: JST_CAPTURE_ADB_FRAME_INFO) {
+            self.image = image
+            self.info = info
+        }
+
+        deinit {
+            JSTFreePixelImage(image)
+        }
+    }
+
+    private static let captureQueue = DispatchQueue(label: "\(namespace).capture", qos: .userInitiated, attributes: .concurrent)
+    private static let captureThreadCount = Int32(max(ProcessInfo.processInfo.activeProcessorCount, 1))
+
+    private static func streamScreenCapture(_ deviceId: String) -> (frame: ScreenFrame?, status: JST_CAPTURE_ADB_STATUS, reason: String) {
+        var options = JST_CAPTURE_ADB_OPTIONS()
+        JSTCaptureAdbOptionsInit(&options)
+        options.threadCount = captureThreadCount
+        var image: UnsafeMutablePointer<JST_IMAGE>?
+        var info = JST_CAPTURE_ADB_FRAME_INFO()
+        let messageLength = 256
+        var message = [CChar](repeating: 0, count: messageLength)
+        let status = deviceId.withCString { JSTCaptureAdbScreencap(&options, $0, &image, &info, &message, messageLength) }
+        guard status == JST_CAPTURE_ADB_STATUS_OK, let image = image else {
+            return (nil, status, String(cString: message))
+        }
+        return (ScreenFrame(image: image, info: info), status, "")
+    }
+
+    /// Streams the raw output of `screencap` through the adb server, nothing is encoded on the device, written to its storage or pulled.
+    /// The server is started once if it is not running yet.
+    static func promiseStreamScreenCapture(_ deviceId: String) -> Promise<ScreenFrame> {
+        return Promise<ScreenFrame> { seal in
+            captureQueue.async {
+                var result = streamScreenCapture(deviceId)
+                if result.status == JST_CAPTURE_ADB_STATUS_CONNECTION_FAILED {
+                    _ = AuxiliaryExecute.local.bash(command: "\(adb.path) start-server", timeout: 10)
+                    result = streamScreenCapture(deviceId)
+                }
+                if let frame = result.frame {
+                    seal.fulfill(frame)
+                } else {
+                    seal.reject(CommandError.screencapFailed(reason: result.reason))
+                }
+            }
+        }
+    }
+
+    /// Encodes a streamed frame on every core, in place of `screencap -p` on the device.
+    static func promiseEncodePNG(_ frame: ScreenFrame) -> Promise<Data> {
+        return Promise<Data> { seal in
+            captureQueue.async {
+                var bytes: UnsafeMutablePointer<UInt8>?
+                var length = 0
+                guard JSTCapturePNGEncode(frame.image, captureThreadCount, -1, &bytes, &length) != 0, let bytes = bytes else {
+                    seal.reject(CommandError.screencapFailed(reason: "PNG encoding failed"))
+                    return
+                }
+                seal.fulfill(Data(bytesNoCopy: bytes, count: length, deallocator: .free))
+            }
+        }
+    }
     
 }
-
@@ -6,6 +6,7 @@
 //  Copyright © 2021 JST. All rights reserved.
 //
 
+import CoreGraphics
 import Foundation
 import PromiseKit
 
@@ -39,14 +40,51 @@ final class AndroidDevice: JSTDevice, JSTPairedDevice {
 
     override func takeScreenshot(completionHandler completion: @escaping JSTScreenshotHandler) {
         let deviceId = self.base
-        AdbHelper.promiseCreateDirectoryForScreenCapture(deviceId)
-            .then { AdbHelper.promiseScreenCapture(deviceId, to: $0) }
-            .then { AdbHelper.promisePullRemoteFile(deviceId, from: $0) }
-            .then { AdbHelper.promiseReadLocalFile($0) }
+        AdbHelper.promiseStreamScreenCapture(deviceId)
+            .then { AdbHelper.promiseEncodePNG($0) }
+            .recover { _ in AndroidDevice.promiseScreenCaptureThroughStorage(deviceId) }
             .then { data -> Promise<Void> in
                 completion(data, nil)
                 return Promise<Void>()
             }
             .catch { completion(nil, $0) }
     }
+
+    override func takeRawScreenshot(completionHandler completion: @escaping JSTRawScreenshotHandler) {
+        AdbHelper.promiseStreamScreenCapture(self.base)
+            .then { frame -> Promise<Void> in
+                let (pixels, attributes) = AndroidDevice.rawScreenshot(with: frame)
+                completion(pixels, attributes, nil)
+                return Promise<Void>()
+            }
+            .catch { _ in
+                // Devices without exec: or a raw screencap, decoded from the PNG instead
+                super.takeRawScreenshot(completionHandler: completion)
+            }
+    }
+
+    private static func rawScreenshot(with frame: AdbHelper.ScreenFrame) -> (Data, [String: Any]) {
+        let image = frame.image
+        let bytesPerRow = Int(image.pointee.alignedWidth) * MemoryLayout<JST_COLOR>.stride
+        let pixels = Data(
+            bytesNoCopy: UnsafeMutableRawPointer(image.pointee.pixels),
+            count: bytesPerRow * Int(image.pointee.height),
+            deallocator: .custom({ _, _ in withExtendedLifetime(frame) { } })
+        )
+        let colorSpaceName = frame.info.colorSpace == JST_CAPTURE_ADB_COLOR_SPACE_DISPLAY_P3 ? CGColorSpace.displayP3 : CGColorSpace.sRGB
+        return (pixels, [
+            kJSTRawScreenshotWidthKey: Int(image.pointee.width),
+            kJSTRawScreenshotHeightKey: Int(image.pointee.height),
+            kJSTRawScreenshotBytesPerRowKey: bytesPerRow,
+            kJSTRawScreenshotOrientationKey: Int(image.pointee.orientation),
+            kJSTRawScreenshotColorSpaceNameKey: colorSpaceName as String,
+        ])
+    }
+
+    private static func promiseScreenCaptureThroughStorage(_ deviceId: String) -> Promise<Data> {
+        return AdbHelper.promiseCreateDirectoryForScreenCapture(deviceId)
+            .then { AdbHelper.promiseScreenCapture(deviceId, to: $0) }
+            .then { AdbHelper.promisePullRemoteFile(deviceId, from: $0) }
+            .then { AdbHelper.promiseReadLocalFile($0) }
+    }
 }
@@ -13,6 +13,9 @@ NS_ASSUME_NONNULL_BEGIN
 @interface AppleDevice : JSTDevice <JSTPairedDevice>
 @property (nonatomic, copy) NSString *productType;  // alias of self.model
 @property (nonatomic, copy) NSString *productVersion;  // alias of self.version
+
+// Capture counters and latency percentiles (in ms) of one device, or of all devices if udid is nil.
++ (nullable NSDictionary <NSString *, NSNumber *> *)captureStatisticsByUDID:(nullable NSString *)udid;
 @end
 
 NS_ASSUME_NONNULL_END
@@ -9,6 +9,8 @@
 #import "JSTScreenshotHelperProtocol.h"
 #import "AppleDevice.h"
 #import "JSTPixelImage.h"
+#import "JSTCapturePool.h"
+#import "JSTCaptureTIFF.h"
 #import <libimobiledevice/libimobiledevice.h>
 #import <libimobiledevice/lockdown.h>
 #import <libimobiledevice/screenshotr.h>
@@ -20,6 +22,151 @@
 #import "JSTScreenshotHelper-Swift.h"
 #endif
 
+
+#pragma mark - Capture Sessions
+
+/* A session keeps the screenshotr (and springboard) clients of a device
+ * alive between captures, the lockdown handshake and the service handshakes
+ * are only paid again after the connection is lost. */
+typedef struct JSTAppleCaptureSession {
+    idevice_t device;
+    screenshotr_client_t shotr;
+    sbservices_client_t sbs;  /* optional, for the interface orientation */
+} JSTAppleCaptureSession;
+
+typedef struct JSTAppleCaptureRequest {
+    sbservices_interface_orientation_t orientation;
+    char *imageData;  /* freed by the caller */
+    uint64_t imageSize;
+    int errorCode;
+} JSTAppleCaptureRequest;
+
+static void JSTAppleCaptureCloseSession(void *context, void *session) {
+    JSTAppleCaptureSession *captureSession = (JSTAppleCaptureSession *)session;
+    if (captureSession->sbs) { sbservices_client_free(captureSession->sbs); }
+    if (captureSession->shotr) { screenshotr_client_free(captureSession->shotr); }
+    if (captureSession->device) { idevice_free(captureSession->device); }
+    free(captureSession);
+}
+
+static JST_CAPTURE_STATUS JSTAppleCaptureOpenSession(void *context, const char *udid, void **session) {
+    JSTAppleCaptureSession *captureSession = calloc(1, sizeof(JSTAppleCaptureSession));
+    if (!captureSession) {
+        return JST_CAPTURE_STATUS_FAILED;
+    }
+    if (idevice_new_with_options(&captureSession->device, udid, IDEVICE_LOOKUP_USBMUX | IDEVICE_LOOKUP_NETWORK) != IDEVICE_E_SUCCESS) {
+        JSTAppleCaptureCloseSession(context, captureSession);
+        return JST_CAPTURE_STATUS_DISCONNECTED;
+    }
+
+    lockdownd_client_t lckd = NULL;
+    lockdownd_error_t ldret = lockdownd_client_new_with_handshake(captureSession->device, &lckd, "JSTColorPicker");
+    if (ldret != LOCKDOWN_E_SUCCESS) {
+        JSTAppleCaptureCloseSession(context, captureSession);
+        return ldret == LOCKDOWN_E_MUX_ERROR ? JST_CAPTURE_STATUS_DISCONNECTED : JST_CAPTURE_STATUS_NEEDS_PAIRING;
+    }
+
+    lockdownd_service_descriptor_t sbsService = NULL;
+    if (lockdownd_start_service(lckd, SBSERVICES_SERVICE_NAME, &sbsService) != LOCKDOWN_E_SUCCESS || !(sbsService && sbsService->port > 0)) {
+        if (sbsService) { lockdownd_service_descriptor_free(sbsService); sbsService = NULL; }
+    }
+    lockdownd_service_descriptor_t shotrService = NULL;
+    if (lockdownd_start_service(lckd, SCREENSHOTR_SERVICE_NAME, &shotrService) != LOCKDOWN_E_SUCCESS || !(shotrService && shotrService->port > 0)) {
+        if (shotrService) { lockdownd_service_descriptor_free(shotrService); }
+        if (sbsService) { lockdownd_service_descriptor_free(sbsService); }
+        lockdownd_goodbye(lckd);
+        lockdownd_client_free(lckd);
+        JSTAppleCaptureCloseSession(context, captureSession);
+        return JST_CAPTURE_STATUS_NEEDS_MOUNT;
+    }
+    lockdownd_goodbye(lckd);
+    lockdownd_client_free(lckd);
+
+    if (sbsService) {
+        if (sbservices_client_new(captureSession->device, sbsService, &captureSession->sbs) != SBSERVICES_E_SUCCESS) {
+            captureSession->sbs = NULL;
+        }
+        lockdownd_service_descriptor_free(sbsService);
+    }
+    screenshotr_error_t scret = screenshotr_client_new(captureSession->device, shotrService, &captureSession->shotr);
+    lockdownd_service_descriptor_free(shotrService);
+    if (scret != SCREENSHOTR_E_SUCCESS) {
+        captureSession->shotr = NULL;
+        JSTAppleCaptureCloseSession(context, captureSession);
+        return JST_CAPTURE_STATUS_FAILED;
+    }
+
+    *session = captureSession;
+    return JST_CAPTURE_STATUS_OK;
+}
+
+static JST_CAPTURE_STATUS JSTAppleCaptureCheckSession(void *context, void *session) {
+    JSTAppleCaptureSession *captureSession = (JSTAppleCaptureSession *)session;
+    if (!captureSession->sbs) {
+        return JST_CAPTURE_STATUS_OK;  // nothing cheap to ask, the capture will tell
+    }
+    sbservices_interface_orientation_t orientation = SBSERVICES_INTERFACE_ORIENTATION_UNKNOWN;
+    if (sbservices_get_interface_orientation(captureSession->sbs, &orientation) != SBSERVICES_E_SUCCESS) {
+        return JST_CAPTURE_STATUS_DISCONNECTED;
+    }
+    return JST_CAPTURE_STATUS_OK;
+}
+
+static JST_CAPTURE_STATUS JSTAppleCaptureTakeScreenshot(void *context, void *session, void *request) {
+    JSTAppleCaptureSession *captureSession = (JSTAppleCaptureSession *)session;
+    JSTAppleCaptureRequest *captureRequest = (JSTAppleCaptureRequest *)request;
+
+    captureRequest->orientation = SBSERVICES_INTERFACE_ORIENTATION_UNKNOWN;
+    if (captureSession->sbs) {
+        if (sbservices_get_interface_orientation(captureSession->sbs, &captureRequest->orientation) != SBSERVICES_E_SUCCESS) {
+            captureRequest->orientation = SBSERVICES_INTERFACE_ORIENTATION_UNKNOWN;
+        }
+    }
+
+    char *cIMGData = NULL;
+    uint64_t cIMGSize = 0;
+    screenshotr_error_t scret = screenshotr_take_screenshot(captureSession->shotr, &cIMGData, &cIMGSize);
+    captureRequest->errorCode = scret;
+    if (scret != SCREENSHOTR_E_SUCCESS || cIMGData == NULL) {
+        if (cIMGData) { free(cIMGData); }
+        return JST_CAPTURE_STATUS_DISCONNECTED;
+    }
+    captureRequest->imageData = cIMGData;
+    captureRequest->imageSize = cIMGSize;
+    return JST_CAPTURE_STATUS_OK;
+}
+
+static JST_ORIENTATION JSTAppleCaptureOrientation(sbservices_interface_orientation_t orientation) {
+    switch (orientation) {
+        case SBSERVICES_INTERFACE_ORIENTATION_LANDSCAPE_RIGHT:
+            return 1;
+        case SBSERVICES_INTERFACE_ORIENTATION_LANDSCAPE_LEFT:
+            return 2;
+        case SBSERVICES_INTERFACE_ORIENTATION_PORTRAIT_UPSIDE_DOWN:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+static JST_CAPTURE_POOL *JSTAppleCapturePool(void) {
+    static JST_CAPTURE_POOL *pool = NULL;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        JST_CAPTURE_TRANSPORT transport = {
+            .context = NULL,
+            .openSession = JSTAppleCaptureOpenSession,
+            .checkSession = JSTAppleCaptureCheckSession,
+            .capture = JSTAppleCaptureTakeScreenshot,
+            .closeSession = JSTAppleCaptureCloseSession,
+            .now = NULL,
+        };
+        pool = JSTCapturePoolCreate(&transport, NULL);
+        assert(pool);
+    });
+    return pool;
+}
+
 @implementation AppleDevice {
     idevice_t cDevice;
     char *cUDID;
@@ -112,6 +259,7 @@
 }
 
 - (void)dealloc {
+    if (cUDID) { JSTCapturePoolCloseSession(JSTAppleCapturePool(), cUDID); }
     if (cDevice) { idevice_free(cDevice); cDevice = NULL; }
     if (cUDID) { free(cUDID); cUDID = NULL; }
 #ifdef DEBUG
@@ -119,129 +267,56 @@
 #endif
 }
 
-- (void)takeScreenshotWithCompletionHandler:(JSTScreenshotHandler)completion {
-    BOOL sbsRequired = NO;
++ (nullable NSDictionary <NSString *, NSNumber *> *)captureStatisticsByUDID:(nullable NSString *)udid {
+    JST_CAPTURE_STATISTICS statistics;
+    if (!JSTCapturePoolGetStatistics(JSTAppleCapturePool(), udid.UTF8String, &statistics)) {
+        return nil;
+    }
+    return @{
+        @"captureCount": @(statistics.captureCount),
+        @"failureCount": @(statistics.failureCount),
+        @"sessionOpenCount": @(statistics.sessionOpenCount),
+        @"reconnectCount": @(statistics.reconnectCount),
+        @"healthCheckCount": @(statistics.healthCheckCount),
+        @"sampleCount": @(statistics.sampleCount),
+        @"p50": @(statistics.p50),
+        @"p90": @(statistics.p90),
+        @"p99": @(statistics.p99),
+        @"max": @(statistics.max),
+    };
+}
 
-    idevice_t device = self->cDevice;
-    lockdownd_client_t lckd = NULL;
-    lockdownd_error_t ldret = LOCKDOWN_E_UNKNOWN_ERROR;
-    screenshotr_client_t shotr = NULL;
-    lockdownd_service_descriptor_t shotrService = NULL;
-    sbservices_client_t sbs = NULL;
-    lockdownd_service_descriptor_t sbsService = NULL;
-    sbservices_error_t sbret = SBSERVICES_E_UNKNOWN_ERROR;
-    screenshotr_error_t scret = SCREENSHOTR_E_UNKNOWN_ERROR;
-    
-    if (LOCKDOWN_E_SUCCESS != (ldret = lockdownd_client_new_with_handshake(device, &lckd, NULL))) {
+// Returns NO after passing the failure to completion, pairing or mounting first if needed.
+- (BOOL)captureRequest:(JSTAppleCaptureRequest *)request completionHandler:(JSTScreenshotHandler)completion {
+    JST_CAPTURE_STATUS status = JSTCapturePoolCapture(JSTAppleCapturePool(), cUDID, request);
+    if (status == JST_CAPTURE_STATUS_NEEDS_PAIRING) {
         [self pair:completion];
-        return;
+        return NO;
     }
-    if (LOCKDOWN_E_SUCCESS != (ldret = lockdownd_start_service(lckd, SBSERVICES_SERVICE_NAME, &sbsService)) || !(sbsService && sbsService->port > 0)) {
-        if (sbsRequired && lckd) {
-            lockdownd_goodbye(lckd);
-            lockdownd_client_free(lckd);
-            lckd = NULL;
-        }
-        if (sbsRequired) {
-            [self mount:completion];
-            return;
-        }
-    }
-    if (LOCKDOWN_E_SUCCESS != (ldret = lockdownd_start_service(lckd, SCREENSHOTR_SERVICE_NAME, &shotrService)) || !(shotrService && shotrService->port > 0)) {
-        if (lckd) {
-            lockdownd_goodbye(lckd);
-            lockdownd_client_free(lckd);
-            lckd = NULL;
-        }
+    if (status == JST_CAPTURE_STATUS_NEEDS_MOUNT) {
         [self mount:completion];
-        return;
+        return NO;
     }
-
-    if (lckd) {
-        lockdownd_goodbye(lckd);
-        lockdownd_client_free(lckd);
-        lckd = NULL;
-    }
-    
-    if (SBSERVICES_E_SUCCESS != (sbret = sbservices_client_new(device, sbsService, &sbs))) {
-        if (sbsService) {
-            lockdownd_service_descriptor_free(sbsService);
-            sbsService = NULL;
-        }
-        if (sbsRequired && shotrService) {
-            lockdownd_service_descriptor_free(shotrService);
-            shotrService = NULL;
-        }
-        if (sbsRequired) {
-            completion(nil, [NSError errorWithDomain:kJSTScreenshotError code:sbret userInfo:@{ NSLocalizedDescriptionKey: [NSString stringWithFormat:NSLocalizedString(@"Could not connect to “%@”.", @"kJSTScreenshotError"), @SBSERVICES_SERVICE_NAME] }]);
-            return;
-        }
+    if (status == JST_CAPTURE_STATUS_FAILED) {
+        completion(nil, [NSError errorWithDomain:kJSTScreenshotError code:request->errorCode userInfo:@{ NSLocalizedDescriptionKey: [NSString stringWithFormat:NSLocalizedString(@"Could not connect to “%@”.", @"kJSTScreenshotError"), @SCREENSHOTR_SERVICE_NAME] }]);
+        return NO;
     }
-    if (SCREENSHOTR_E_SUCCESS != (scret = screenshotr_client_new(device, shotrService, &shotr))) {
-        if (sbs) {
-            sbservices_client_free(sbs);
-            sbs = NULL;
-        }
-        if (sbsService) {
-            lockdownd_service_descriptor_free(sbsService);
-            sbsService = NULL;
-        }
-        if (shotrService) {
-            lockdownd_service_descriptor_free(shotrService);
-            shotrService = NULL;
-        }
-        completion(nil, [NSError errorWithDomain:kJSTScreenshotError code:scret userInfo:@{ NSLocalizedDescriptionKey: [NSString stringWithFormat:NSLocalizedString(@"Could not connect to “%@”.", @"kJSTScreenshotError"), @SCREENSHOTR_SERVICE_NAME] }]);
-        return;
+    if (status != JST_CAPTURE_STATUS_OK) {
+        completion(nil, [NSError errorWithDomain:kJSTScreenshotError code:request->errorCode userInfo:@{ NSLocalizedDescriptionKey: NSLocalizedString(@"Could not get the screenshot.", @"kJSTScreenshotError") }]);
+        return NO;
     }
-    
-    sbservices_interface_orientation_t orientation = SBSERVICES_INTERFACE_ORIENTATION_UNKNOWN;
-    if (sbs) {
-        if (SBSERVICES_E_SUCCESS != (sbret = sbservices_get_interface_orientation(sbs, &orientation)) && orientation != SBSERVICES_INTERFACE_ORIENTATION_UNKNOWN) {
-            if (sbs) {
-                sbservices_client_free(sbs);
-                sbs = NULL;
-            }
-            if (sbsRequired && shotr) {
-                screenshotr_client_free(shotr);
-                shotr = NULL;
-            }
-            if (sbsService) {
-                lockdownd_service_descriptor_free(sbsService);
-                sbsService = NULL;
-            }
-            if (sbsRequired && shotrService) {
-                lockdownd_service_descriptor_free(shotrService);
-                shotrService = NULL;
-            }
-            if (sbsRequired) {
-                completion(nil, [NSError errorWithDomain:kJSTScreenshotError code:sbret userInfo:@{ NSLocalizedDescriptionKey: NSLocalizedString(@"Could not get the interface orientation.", @"kJSTScreenshotError") }]);
-                return;
-            }
-        }
-    }
-    
-    char *cIMGData = NULL;
-    uint64_t cIMGSize = 0;
-    if (SCREENSHOTR_E_SUCCESS != (scret = screenshotr_take_screenshot(shotr, &cIMGData, &cIMGSize)) || cIMGData == NULL) {
-        if (sbs) {
-            sbservices_client_free(sbs);
-            sbs = NULL;
-        }
-        if (shotr) {
-            screenshotr_client_free(shotr);
-            shotr = NULL;
-        }
-        if (sbsService) {
-            lockdownd_service_descriptor_free(sbsService);
-            sbsService = NULL;
-        }
-        if (shotrService) {
-            lockdownd_service_descriptor_free(shotrService);
-            shotrService = NULL;
-        }
-        completion(nil, [NSError errorWithDomain:kJSTScreenshotError code:scret userInfo:@{ NSLocalizedDescriptionKey: NSLocalizedString(@"Could not get the screenshot.", @"kJSTScreenshotError") }]);
+    return YES;
+}
+
+- (void)takeScreenshotWithCompletionHandler:(JSTScreenshotHandler)completion {
+    JSTAppleCaptureRequest request = { SBSERVICES_INTERFACE_ORIENTATION_UNKNOWN, NULL, 0, SCREENSHOTR_E_UNKNOWN_ERROR };
+    if (![self captureRequest:&request completionHandler:completion]) {
         return;
     }
+
+    char *cIMGData = request.imageData;
+    uint64_t cIMGSize = request.imageSize;
+    screenshotr_error_t scret = SCREENSHOTR_E_SUCCESS;
     
     BOOL isPNGData = NO;
     BOOL isTIFFData = NO;
@@ -249,22 +324,6 @@
     else if (memcmp(cIMGData, "MM\x00*", MIN(4, cIMGSize)) == 0) { isTIFFData = YES; }
     else {
         free(cIMGData);
-        if (sbs) {
-            sbservices_client_free(sbs);
-            sbs = NULL;
-        }
-        if (shotr) {
-            screenshotr_client_free(shotr);
-            shotr = NULL;
-        }
-        if (sbsService) {
-            lockdownd_service_descriptor_free(sbsService);
-            sbsService = NULL;
-        }
-        if (shotrService) {
-            lockdownd_service_descriptor_free(shotrService);
-            shotrService = NULL;
-        }
         completion(nil, [NSError errorWithDomain:kJSTScreenshotError code:scret userInfo:@{ NSLocalizedDescriptionKey: NSLocalizedString(@"Could not get the PNG/TIFF representation of screenshot.", @"kJSTScreenshotError") }]);
         return;
     }
@@ -289,58 +348,72 @@
     }
     
     if (!image) {
-        if (sbs) {
-            sbservices_client_free(sbs);
-            sbs = NULL;
-        }
-        if (shotr) {
-            screenshotr_client_free(shotr);
-            shotr = NULL;
-        }
-        if (sbsService) {
-            lockdownd_service_descriptor_free(sbsService);
-            sbsService = NULL;
-        }
-        if (shotrService) {
-            lockdownd_service_descriptor_free(shotrService);
-            shotrService = NULL;
-        }
         completion(nil, [NSError errorWithDomain:kJSTScreenshotError code:scret userInfo:@{ NSLocalizedDescriptionKey: NSLocalizedString(@"Could not create image from the screenshot.", @"kJSTScreenshotError") }]);
         return;
     }
     
     JSTPixelImage *pixelImage = [[JSTPixelImage alloc] initWithCGImage:image];
-    if (orientation == SBSERVICES_INTERFACE_ORIENTATION_PORTRAIT) {
-        [pixelImage setOrientation:0];
-    }
-    else if (orientation == SBSERVICES_INTERFACE_ORIENTATION_LANDSCAPE_RIGHT) {
-        [pixelImage setOrientation:1];
-    }
-    else if (orientation == SBSERVICES_INTERFACE_ORIENTATION_LANDSCAPE_LEFT) {
-        [pixelImage setOrientation:2];
-    }
-    else if (orientation == SBSERVICES_INTERFACE_ORIENTATION_PORTRAIT_UPSIDE_DOWN) {
-        [pixelImage setOrientation:3];
-    }
+    [pixelImage setOrientation:JSTAppleCaptureOrientation(request.orientation)];
     completion([pixelImage pngRepresentation], nil);
     if (image) { CGImageRelease(image); }
-    
-    if (sbs) {
-        sbservices_client_free(sbs);
-        sbs = NULL;
+}
+
+- (void)takeRawScreenshotWithCompletionHandler:(JSTRawScreenshotHandler)completion {
+    JSTAppleCaptureRequest request = { SBSERVICES_INTERFACE_ORIENTATION_UNKNOWN, NULL, 0, SCREENSHOTR_E_UNKNOWN_ERROR };
+    BOOL captured = [self captureRequest:&request completionHandler:^(NSData * _Nullable imageData, NSError * _Nullable error) {
+        completion(nil, nil, error);
+    }];
+    if (!captured) {
+        return;
     }
-    if (shotr) {
-        screenshotr_client_free(shotr);
-        shotr = NULL;
+    
+    JST_ORIENTATION orientation = JSTAppleCaptureOrientation(request.orientation);
+    const void *cIMGData = request.imageData;
+    size_t cIMGSize = (size_t)request.imageSize;
+    
+    /* screenshotr sends uncompressed TIFF, its strips are converted to JST_COLOR in place of ImageIO and of the PNG round trip */
+    JST_CAPTURE_TIFF_INFO info;
+    if (JSTCaptureTIFFIsTIFF(cIMGData, cIMGSize) && JSTCaptureTIFFReadInfo(cIMGData, cIMGSize, &info)) {
+        size_t bytesPerRow = (size_t)info.width * sizeof(JST_COLOR);
+        NSMutableData *pixels = [NSMutableData dataWithLength:bytesPerRow * (size_t)info.height];
+        if (pixels && JSTCaptureTIFFDecode(cIMGData, cIMGSize, (JST_COLOR *)pixels.mutableBytes, info.width)) {
+            NSMutableDictionary <NSString *, id> *attributes = [NSMutableDictionary dictionaryWithDictionary:@{
+                kJSTRawScreenshotWidthKey: @(info.width),
+                kJSTRawScreenshotHeightKey: @(info.height),
+                kJSTRawScreenshotBytesPerRowKey: @(bytesPerRow),
+                kJSTRawScreenshotOrientationKey: @(orientation),
+            }];
+            if (info.iccProfile) {
+                attributes[kJSTRawScreenshotColorSpaceICCKey] = [NSData dataWithBytes:info.iccProfile length:info.iccProfileLength];
+            } else {
+                attributes[kJSTRawScreenshotColorSpaceNameKey] = (__bridge NSString *)kCGColorSpaceSRGB;
+            }
+            free(request.imageData);
+            completion(pixels, attributes, nil);
+            return;
+        }
     }
-    if (sbsService) {
-        lockdownd_service_descriptor_free(sbsService);
-        sbsService = NULL;
+    
+    /* PNG of older devices, or a TIFF outside of what the decoder supports */
+    CFDataRef imageData = CFDataCreateWithBytesNoCopy(kCFAllocatorDefault, (const UInt8 *)request.imageData, (CFIndex)cIMGSize, kCFAllocatorMalloc);
+    CFDictionaryRef sourceOpts = (__bridge CFDictionaryRef)@{ (id)kCGImageSourceShouldCache: (id)kCFBooleanFalse };
+    CGImageSourceRef imgSrc = CGImageSourceCreateWithData(imageData, sourceOpts);
+    CFRelease(imageData);
+    CGImageRef image = imgSrc ? CGImageSourceCreateImageAtIndex(imgSrc, 0, sourceOpts) : NULL;
+    if (imgSrc) { CFRelease(imgSrc); }
+    if (!image) {
+        completion(nil, nil, [NSError errorWithDomain:kJSTScreenshotError code:SCREENSHOTR_E_SUCCESS userInfo:@{ NSLocalizedDescriptionKey: NSLocalizedString(@"Could not create image from the screenshot.", @"kJSTScreenshotError") }]);
+        return;
     }
-    if (shotrService) {
-        lockdownd_service_descriptor_free(shotrService);
-        shotrService = NULL;
+    
+    NSDictionary <NSString *, id> *attributes = nil;
+    NSData *pixels = [JSTDevice rawScreenshotWithCGImage:image orientation:orientation attributes:&attributes];
+    CGImageRelease(image);
+    if (!pixels) {
+        completion(nil, nil, [NSError errorWithDomain:kJSTScreenshotError code:SCREENSHOTR_E_SUCCESS userInfo:@{ NSLocalizedDescriptionKey: NSLocalizedString(@"Could not create image from the screenshot.", @"kJSTScreenshotError") }]);
+        return;
     }
+    completion(pixels, attributes, nil);
 }
 
 @end
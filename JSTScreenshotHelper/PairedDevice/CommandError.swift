@@ -15,6 +15,7 @@ enum CommandError: CustomNSError, LocalizedError {
     case retryMountSucceed
     case mountFailed
     case missingMountResources
+    case screencapFailed(reason: String)
     
     var errorCode: Int {
         switch self {
@@ -30,6 +31,8 @@ enum CommandError: CustomNSError, LocalizedError {
             return 705
         case .missingMountResources:
             return 707
+        case .screencapFailed:
+            return 709
         }
     }
     
@@ -37,6 +40,8 @@ enum CommandError: CustomNSError, LocalizedError {
         switch self {
         case let .nonZeroExitCode(code, reason):
             return String(format: NSLocalizedString("Command exited with non-zero status code: “%ld”, error reason: %@.", comment: "CommandError"), code, reason)
+        case let .screencapFailed(reason):
+            return String(format: NSLocalizedString("Could not capture the screen through the adb server, error reason: %@.", comment: "CommandError"), reason)
         default:
             return nil
         }
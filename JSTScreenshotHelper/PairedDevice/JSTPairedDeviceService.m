@@ -9,12 +9,61 @@
 #import "JSTPairedDeviceService.h"
 #import "JSTPairedDevice.h"
 #import "JSTPairedDeviceStore.h"
+#import "AppleDevice.h"
+#import "JSTPixelTransport.h"
+#import "JSTCaptureScheduler.h"
 #import <Carbon/Carbon.h>
+#import <stdatomic.h>
+
+#ifdef APP_STORE
+#import "JSTColorPickerHelper-Swift.h"
+#else
+#import "JSTScreenshotHelper-Swift.h"
+#endif
+
+/* Frames in flight to the application, it copies a frame out of its slot
+ * or lets go of it soon after the reply. */
+static const int kJSTFrameTransportSlotCount = 4;
+
+/* A capture which never finishes gives its lane back after this long. */
+static const int64_t kJSTCaptureTimeout = 120ull * NSEC_PER_SEC;
+
+typedef void (^JSTCaptureFinishHandler)(BOOL succeeded, uint64_t byteCount);
+typedef void (^JSTCaptureBlock)(JSTCaptureFinishHandler finish);
+
+static JST_CAPTURE_SCHEDULER *JSTPairedDeviceCaptureScheduler(void) {
+    static JST_CAPTURE_SCHEDULER *scheduler = NULL;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        scheduler = JSTCaptureSchedulerCreate(NULL);
+    });
+    return scheduler;
+}
+
+/* Called once the lane of the device admits the capture, the block is
+ * retained until then. Finishes the capture once, whichever of the device
+ * or the timeout comes first. */
+static void JSTPairedDeviceStartCapture(JST_CAPTURE *capture, void *context) {
+    JSTCaptureBlock block = (__bridge_transfer JSTCaptureBlock)context;
+    __block atomic_flag isFinished = ATOMIC_FLAG_INIT;
+    JSTCaptureFinishHandler finish = ^(BOOL succeeded, uint64_t byteCount) {
+        if (!atomic_flag_test_and_set(&isFinished)) {
+            JSTCaptureSchedulerFinish(capture, succeeded, byteCount);
+        }
+    };
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, kJSTCaptureTimeout), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        finish(NO, 0);
+    });
+    block(finish);
+}
 
 
 @interface JSTPairedDeviceService () <JSTPairedDeviceDelegate, NSNetServiceBrowserDelegate>
 @property (nonatomic, assign) BOOL isNetworkDiscoveryEnabled;
 @property (nonatomic, strong) dispatch_source_t discoveryTimerSource;
+@property (nonatomic, strong) dispatch_queue_t frameTransportQueue;
+@property (nonatomic, assign) JST_PIXEL_TRANSPORT *frameTransport;  // guarded by frameTransportQueue
+@property (nonatomic, strong) dispatch_queue_t captureQueue;
 @end
 
 
@@ -71,16 +120,169 @@
         return;
     }
     __weak typeof(self) weakSelf = self;
-    [targetDevice takeScreenshotWithCompletionHandler:^(NSData * _Nullable imageData, NSError * _Nullable error) {
-        reply(imageData, error);
-        if (error) {
-            [weakSelf disconnectDevice:targetDevice];
-            [weakSelf didReceiveiDeviceEvent:nil];
-        }
+    [self scheduleCaptureOfDevice:targetDevice usingBlock:^(JSTCaptureFinishHandler finish) {
+        [targetDevice takeScreenshotWithCompletionHandler:^(NSData * _Nullable imageData, NSError * _Nullable error) {
+            finish(!error, imageData.length);
+            reply(imageData, error);
+            if (error) {
+                [weakSelf disconnectDevice:targetDevice];
+                [weakSelf didReceiveiDeviceEvent:nil];
+            }
+        }];
+    }];
+}
+
+- (void)takeRawScreenshotByUDID:(NSString *)udid withReply:(void (^)(NSData * _Nullable, NSData * _Nullable, NSError * _Nullable))reply {
+    JSTDevice <JSTPairedDevice> *targetDevice = self.deviceService.cachedDevices[udid];
+    if (!targetDevice) {
+        reply(nil, nil, [NSError errorWithDomain:kJSTScreenshotError code:404 userInfo:@{ NSLocalizedDescriptionKey: [NSString stringWithFormat:NSLocalizedString(@"Device “%@” is not reachable.", @"kJSTScreenshotError"), udid] }]);
+        return;
+    }
+    __weak typeof(self) weakSelf = self;
+    [self scheduleCaptureOfDevice:targetDevice usingBlock:^(JSTCaptureFinishHandler finish) {
+        [targetDevice takeRawScreenshotWithCompletionHandler:^(NSData * _Nullable pixels, NSDictionary <NSString *, id> * _Nullable attributes, NSError * _Nullable error) {
+            finish(!error, pixels.length);
+            reply(pixels, attributes ? [NSPropertyListSerialization dataWithPropertyList:attributes format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil] : nil, error);
+            if (error) {
+                [weakSelf disconnectDevice:targetDevice];
+                [weakSelf didReceiveiDeviceEvent:nil];
+            }
+        }];
     }];
 }
 
+- (void)takeSharedScreenshotByUDID:(NSString *)udid withReply:(void (^)(NSData * _Nullable, NSError * _Nullable))reply {
+    JSTDevice <JSTPairedDevice> *targetDevice = self.deviceService.cachedDevices[udid];
+    if (!targetDevice) {
+        reply(nil, [NSError errorWithDomain:kJSTScreenshotError code:404 userInfo:@{ NSLocalizedDescriptionKey: [NSString stringWithFormat:NSLocalizedString(@"Device “%@” is not reachable.", @"kJSTScreenshotError"), udid] }]);
+        return;
+    }
+    __weak typeof(self) weakSelf = self;
+    [self scheduleCaptureOfDevice:targetDevice usingBlock:^(JSTCaptureFinishHandler finish) {
+        [targetDevice takeRawScreenshotWithCompletionHandler:^(NSData * _Nullable pixels, NSDictionary <NSString *, id> * _Nullable attributes, NSError * _Nullable error) {
+            if (error || !pixels || !attributes) {
+                finish(NO, 0);
+                reply(nil, error);
+                [weakSelf disconnectDevice:targetDevice];
+                [weakSelf didReceiveiDeviceEvent:nil];
+                return;
+            }
+            finish(YES, pixels.length);
+            NSDictionary <NSString *, id> *sharedAttributes = [weakSelf shareRawScreenshot:pixels attributes:attributes];
+            if (!sharedAttributes) {
+                reply(nil, [NSError errorWithDomain:kJSTScreenshotError code:507 userInfo:@{ NSLocalizedDescriptionKey: NSLocalizedString(@"Could not share the screenshot with the application.", @"kJSTScreenshotError") }]);
+                return;
+            }
+            reply([NSPropertyListSerialization dataWithPropertyList:sharedAttributes format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil], nil);
+        }];
+    }];
+}
+
+// Captures start on the capture queue once their transport admits them, a few at a time per transport, so that a rack of devices is captured at once without any thread waiting for its turn.
+- (void)scheduleCaptureOfDevice:(JSTDevice <JSTPairedDevice> *)device usingBlock:(JSTCaptureBlock)block {
+    JST_CAPTURE_LANE lane = JST_CAPTURE_LANE_USB;
+    if ([device isKindOfClass:[AndroidDevice class]]) {
+        lane = JST_CAPTURE_LANE_ADB;
+    } else if ([device.type isEqualToString:JSTDeviceTypeNetwork]) {
+        lane = JST_CAPTURE_LANE_NETWORK;
+    }
+    dispatch_queue_t captureQueue = self.captureQueue;
+    JSTCaptureBlock startBlock = ^(JSTCaptureFinishHandler finish) {
+        // the scheduler starts it on the thread which freed the lane
+        dispatch_async(captureQueue, ^{
+            block(finish);
+        });
+    };
+    void *context = (__bridge_retained void *)startBlock;
+    if (!JSTPairedDeviceCaptureScheduler() || !JSTCaptureSchedulerSubmit(JSTPairedDeviceCaptureScheduler(), lane, device.udid.UTF8String, JSTPairedDeviceStartCapture, context)) {
+        CFRelease(context);
+        startBlock(^(BOOL succeeded, uint64_t byteCount) {});
+    }
+}
+
+- (nullable NSDictionary <NSString *, id> *)shareRawScreenshot:(NSData *)pixels attributes:(NSDictionary <NSString *, id> *)attributes {
+    int width = [attributes[kJSTRawScreenshotWidthKey] intValue];
+    int height = [attributes[kJSTRawScreenshotHeightKey] intValue];
+    size_t bytesPerRow = [attributes[kJSTRawScreenshotBytesPerRowKey] unsignedLongValue];
+    JST_ORIENTATION orientation = [attributes[kJSTRawScreenshotOrientationKey] unsignedCharValue];
+    if (width <= 0 || height <= 0 || pixels.length < bytesPerRow * (size_t)height) {
+        return nil;
+    }
+    
+    uint64_t timestamp = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+    __block JST_PIXEL_TRANSPORT_FRAME frame;
+    __block JST_PIXEL_TRANSPORT_STATUS status = JST_PIXEL_TRANSPORT_STATUS_TOO_LARGE;
+    dispatch_sync(self.frameTransportQueue, ^{
+        if (self->_frameTransport) {
+            status = JSTPixelTransportWriteFrame(self->_frameTransport, pixels.bytes, width, height, bytesPerRow, orientation, timestamp, &frame);
+        }
+        if (status != JST_PIXEL_TRANSPORT_STATUS_WRITTEN) {
+            // frames of another size, or every slot is still held by the application, whose images keep the old transport alive
+            JSTPixelTransportFree(self->_frameTransport);
+            self->_frameTransport = JSTPixelTransportCreate(kJSTFrameTransportSlotCount, (size_t)width * (size_t)height * sizeof(JST_COLOR));
+            if (self->_frameTransport) {
+                status = JSTPixelTransportWriteFrame(self->_frameTransport, pixels.bytes, width, height, bytesPerRow, orientation, timestamp, &frame);
+            }
+        }
+    });
+    if (status != JST_PIXEL_TRANSPORT_STATUS_WRITTEN) {
+        return nil;
+    }
+    
+    NSMutableDictionary <NSString *, id> *sharedAttributes = [attributes mutableCopy];
+    sharedAttributes[kJSTRawScreenshotBytesPerRowKey] = @((size_t)frame.width * sizeof(JST_COLOR));
+    sharedAttributes[kJSTSharedScreenshotTransportKey] = @(frame.identifier);
+    sharedAttributes[kJSTSharedScreenshotSequenceKey] = @(frame.sequence);
+    sharedAttributes[kJSTSharedScreenshotSlotKey] = @(frame.slot);
+    sharedAttributes[kJSTSharedScreenshotTimestampKey] = @(frame.timestamp);
+    return sharedAttributes;
+}
+
+- (void)openFrameTransportWithReply:(void (^)(NSFileHandle * _Nullable, NSError * _Nullable))reply {
+    __block int fd = -1;
+    dispatch_sync(self.frameTransportQueue, ^{
+        if (self->_frameTransport) {
+            fd = dup(JSTPixelTransportGetFileDescriptor(self->_frameTransport));
+        }
+    });
+    if (fd < 0) {
+        reply(nil, [NSError errorWithDomain:kJSTScreenshotError code:404 userInfo:@{ NSLocalizedDescriptionKey: NSLocalizedString(@"No screenshot has been shared yet.", @"kJSTScreenshotError") }]);
+        return;
+    }
+    reply([[NSFileHandle alloc] initWithFileDescriptor:fd closeOnDealloc:YES], nil);
+}
+
+- (void)captureStatisticsByUDID:(nullable NSString *)udid withReply:(void (^)(NSData * _Nullable, NSError * _Nullable))reply {
+    NSMutableDictionary <NSString *, NSNumber *> *statistics = [NSMutableDictionary dictionary];
+    JST_CAPTURE_THROUGHPUT throughput;
+    BOOL hasThroughput = JSTPairedDeviceCaptureScheduler() && JSTCaptureSchedulerGetThroughput(JSTPairedDeviceCaptureScheduler(), udid.UTF8String, &throughput);
+    if (hasThroughput) {
+        [statistics addEntriesFromDictionary:@{
+            @"captureCount": @(throughput.captureCount),
+            @"failureCount": @(throughput.failureCount),
+            @"byteCount": @(throughput.byteCount),
+            @"framesPerSecond": @(throughput.framesPerSecond),
+            @"bytesPerSecond": @(throughput.bytesPerSecond),
+            @"averageWait": @(throughput.averageWait),
+            @"averageDuration": @(throughput.averageDuration),
+        }];
+    }
+    NSDictionary <NSString *, NSNumber *> *sessionStatistics = [AppleDevice captureStatisticsByUDID:udid];
+    if (sessionStatistics) {
+        // counted by the session pool, Android devices only have the throughput
+        [statistics addEntriesFromDictionary:sessionStatistics];
+    }
+    if (!hasThroughput && !sessionStatistics) {
+        reply(nil, [NSError errorWithDomain:kJSTScreenshotError code:404 userInfo:@{ NSLocalizedDescriptionKey: [NSString stringWithFormat:NSLocalizedString(@"Device “%@” is not reachable.", @"kJSTScreenshotError"), udid] }]);
+        return;
+    }
+    reply([NSPropertyListSerialization dataWithPropertyList:statistics format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil], nil);
+}
+
 - (void)disconnectDevice:(JSTDevice <JSTPairedDevice> *)device {
+    if (JSTPairedDeviceCaptureScheduler()) {
+        JSTCaptureSchedulerRemoveDevice(JSTPairedDeviceCaptureScheduler(), device.udid.UTF8String);
+    }
     [self.deviceService disconnectDevice:device];
 }
 
@@ -93,6 +295,8 @@
     if (self) {
         _deviceService = [[JSTPairedDeviceStore alloc] init];
         _deviceService.delegate = self;
+        _frameTransportQueue = dispatch_queue_create("com.jst.JSTScreenshotHelper.FrameTransport", DISPATCH_QUEUE_SERIAL);
+        _captureQueue = dispatch_queue_create("com.jst.JSTScreenshotHelper.Capture", DISPATCH_QUEUE_CONCURRENT);
         [self didReceiveiDeviceEvent:nil];
 
         dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
@@ -113,6 +317,7 @@
         dispatch_source_cancel(self.discoveryTimerSource);
         _discoveryTimerSource = nil;
     }
+    JSTPixelTransportFree(_frameTransport);
 }
 
 - (void)didReceiveiDeviceEvent:(nullable JSTPairedDeviceStore *)service {
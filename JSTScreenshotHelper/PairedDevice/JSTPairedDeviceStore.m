@@ -45,6 +45,7 @@ static void handle_idevice_event(const idevice_event_t *event, void *user_data)
     [self.activeDevices removeAllObjects];
 
     // Load Apple devices
+    NSMutableDictionary <NSString *, JSTDeviceType> *newDeviceTypes = [NSMutableDictionary dictionary];
     do {
         if (includingNetworkDevices) {
             idevice_info_t *cDevices;
@@ -69,15 +70,11 @@ static void handle_idevice_event(const idevice_event_t *event, void *user_data)
                     }
                 }
                 else {
-                    NSString *deviceType = nil;
                     if (cDevices[i]->conn_type == CONNECTION_USBMUXD) {
-                        deviceType = JSTDeviceTypeUSB;
+                        newDeviceTypes[udid] = JSTDeviceTypeUSB;
                     } else {
-                        deviceType = JSTDeviceTypeNetwork;
+                        newDeviceTypes[udid] = JSTDeviceTypeNetwork;
                     }
-                    JSTDevice <JSTPairedDevice> *device = [[AppleDevice alloc] initWithUDID:udid Type:deviceType];
-                    self.cachedDevices[udid] = device;
-                    self.activeDevices[udid] = device;
                 }
             }
 
@@ -102,9 +99,7 @@ static void handle_idevice_event(const idevice_event_t *event, void *user_data)
                     }
                 }
                 else {
-                    JSTDevice <JSTPairedDevice> *device = [[AppleDevice alloc] initWithUDID:udid Type:JSTDeviceTypeUSB];
-                    self.cachedDevices[udid] = device;
-                    self.activeDevices[udid] = device;
+                    newDeviceTypes[udid] = JSTDeviceTypeUSB;
                 }
             }
 
@@ -112,6 +107,30 @@ static void handle_idevice_event(const idevice_event_t *event, void *user_data)
         }
     } while (NO);
 
+    // Connect new Apple devices at once, each of them takes a lockdown handshake
+    do {
+        NSArray <NSString *> *newUDIDs = newDeviceTypes.allKeys;
+        NSMutableArray <id> *newDevices = [NSMutableArray arrayWithCapacity:newUDIDs.count];
+        for (NSUInteger i = 0; i < newUDIDs.count; i++) {
+            [newDevices addObject:[NSNull null]];
+        }
+        NSLock *newDevicesLock = [[NSLock alloc] init];
+        dispatch_apply(newUDIDs.count, DISPATCH_APPLY_AUTO, ^(size_t i) {
+            JSTDevice <JSTPairedDevice> *device = [[AppleDevice alloc] initWithUDID:newUDIDs[i] Type:newDeviceTypes[newUDIDs[i]]];
+            if (device) {
+                [newDevicesLock lock];
+                newDevices[i] = device;
+                [newDevicesLock unlock];
+            }
+        });
+        for (NSUInteger i = 0; i < newUDIDs.count; i++) {
+            if (newDevices[i] != [NSNull null]) {
+                self.cachedDevices[newUDIDs[i]] = newDevices[i];
+                self.activeDevices[newUDIDs[i]] = newDevices[i];
+            }
+        }
+    } while (NO);
+
     // Load Android devices
     do {
         NSArray <JSTDevice <JSTPairedDevice> *> *androidDevices = [AdbHelper getDevices];
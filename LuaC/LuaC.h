@@ -7,7 +7,10 @@
 //
 
 extern int SDegutisLuaRegistryIndex;
+extern const char *SDegutisLuaRelease;
 
 #import "lua.h"
 #import "lualib.h"
 #import "lauxlib.h"
+#import "lbyteslib.h"
+#import "lsched.h"
@@ -1,3 +1,4 @@
 #import "LuaC.h"
 
 int SDegutisLuaRegistryIndex = LUA_REGISTRYINDEX;
+const char *SDegutisLuaRelease = LUA_RELEASE;
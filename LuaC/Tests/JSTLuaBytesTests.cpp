@@ -0,0 +1,119 @@
+#include "lua.hpp"
+extern "C" {
+#include "lbyteslib.h"
+}
+#include "JSTTest.h"
+
+#include <string>
+
+/* Calls bytes.<expression>, returns its first result, or the error
+ * message prefixed with "error: ". */
+static std::string JSTBytes(lua_State *L, const std::string &expression)
+{
+    std::string chunk = "local bytes = require('bytes') return bytes." + expression;
+    std::string result;
+    if (luaL_loadstring(L, chunk.c_str()) != LUA_OK || lua_pcall(L, 0, 1, 0) != LUA_OK) {
+        result = std::string("error: ") + lua_tostring(L, -1);
+    } else {
+        size_t length;
+        const char *s = lua_tolstring(L, -1, &length);
+        result.assign(s, length);
+    }
+    lua_settop(L, 0);
+    return result;
+}
+
+static lua_State *JSTNewState()
+{
+    lua_State *L = luaL_newstate();
+    luaL_openlibs(L);
+    luaL_requiref(L, LUA_BYTESLIBNAME, luaopen_bytes, 0);
+    lua_pop(L, 1);
+    return L;
+}
+
+static bool JSTHasError(const std::string &result, const char *message)
+{
+    return result.rfind("error: ", 0) == 0 && result.find(message) != std::string::npos;
+}
+
+
+/* MARK: - hex_escape */
+
+JST_TEST(testHexEscapeBreaksLines)
+{
+    lua_State *L = JSTNewState();
+    JST_EXPECT(JSTBytes(L, "hex_escape('')") == "");
+    JST_EXPECT(JSTBytes(L, "hex_escape('', 2)") == "");
+    JST_EXPECT(JSTBytes(L, "hex_escape('\\0\\255')") == "\\x00\\xff");
+    /* no newline after the last full line, nor before the first */
+    JST_EXPECT(JSTBytes(L, "hex_escape('abcd', 2)") == "\\x61\\x62\n\\x63\\x64");
+    JST_EXPECT(JSTBytes(L, "hex_escape('abc', 2)") == "\\x61\\x62\n\\x63");
+    JST_EXPECT(JSTBytes(L, "hex_escape('ab', 5)") == "\\x61\\x62");
+    JST_EXPECT(JSTBytes(L, "hex_escape('abc', 1)") == "\\x61\n\\x62\n\\x63");
+    JST_EXPECT(JSTHasError(JSTBytes(L, "hex_escape('a', -1)"), "out of range"));
+    lua_close(L);
+}
+
+
+/* MARK: - base64 */
+
+JST_TEST(testBase64PadsAndBreaksLines)
+{
+    lua_State *L = JSTNewState();
+    JST_EXPECT(JSTBytes(L, "base64('')") == "");
+    JST_EXPECT(JSTBytes(L, "base64('', 4)") == "");
+    JST_EXPECT(JSTBytes(L, "base64('f')") == "Zg==");
+    JST_EXPECT(JSTBytes(L, "base64('fo')") == "Zm8=");
+    JST_EXPECT(JSTBytes(L, "base64('foo')") == "Zm9v");
+    JST_EXPECT(JSTBytes(L, "base64('foobar')") == "Zm9vYmFy");
+    JST_EXPECT(JSTBytes(L, "base64('\\255\\254\\253')") == "//79");
+    JST_EXPECT(JSTBytes(L, "base64('foobar', 4)") == "Zm9v\nYmFy");
+    JST_EXPECT(JSTBytes(L, "base64('foobar', 8)") == "Zm9vYmFy");
+    JST_EXPECT(JSTBytes(L, "base64('foobarb', 8)") == "Zm9vYmFy\nYg==");
+    JST_EXPECT(JSTHasError(JSTBytes(L, "base64('foo', 6)"), "not a multiple of 4"));
+    JST_EXPECT(JSTHasError(JSTBytes(L, "base64('foo', -4)"), "out of range"));
+    lua_close(L);
+}
+
+
+/* MARK: - array */
+
+JST_TEST(testArrayRows)
+{
+    lua_State *L = JSTNewState();
+    JST_EXPECT(JSTBytes(L, "array('')") == "{}");
+    JST_EXPECT(JSTBytes(L, "array('', 'swift')") == "[]");
+    JST_EXPECT(JSTBytes(L, "array('\\1\\2\\3', 'c', 2)") == "{\n    0x01, 0x02,\n    0x03,\n}");
+    JST_EXPECT(JSTBytes(L, "array('\\1\\2', 'swift', 2)") == "[\n    0x01, 0x02,\n]");
+    JST_EXPECT(JSTBytes(L, "array('\\1\\2', 'swift', 1)") == "[\n    0x01,\n    0x02,\n]");
+    JST_EXPECT(JSTHasError(JSTBytes(L, "array('a', 'c', 0)"), "out of range"));
+    JST_EXPECT(JSTHasError(JSTBytes(L, "array('a', 'pascal')"), "invalid option"));
+    lua_close(L);
+}
+
+
+/* MARK: - runs */
+
+JST_TEST(testRunsOfUnits)
+{
+    lua_State *L = JSTNewState();
+    JST_EXPECT(JSTBytes(L, "runs('')") == "");
+    JST_EXPECT(JSTBytes(L, "runs('', 4)") == "");
+    JST_EXPECT(JSTBytes(L, "runs('a')") == "61");
+    JST_EXPECT(JSTBytes(L, "runs('aab')") == "61*2 62");
+    JST_EXPECT(JSTBytes(L, "runs('abab', 2)") == "6162*2");
+    JST_EXPECT(JSTBytes(L, "runs(string.rep('\\255', 4 * 120) .. '\\0\\0\\0\\255', 4)") == "ffffffff*120 000000ff");
+    /* a run count of many digits fits in the space of its units */
+    JST_EXPECT(JSTBytes(L, "runs(string.rep('x', 1000000))") == "78*1000000");
+    JST_EXPECT(JSTHasError(JSTBytes(L, "runs('abc', 2)"), "length is not a multiple of the width"));
+    JST_EXPECT(JSTHasError(JSTBytes(L, "runs('a', 0)"), "out of range"));
+    JST_EXPECT(JSTHasError(JSTBytes(L, "runs('a', 65)"), "out of range"));
+
+    /* the number of runs comes second */
+    JST_ASSERT(luaL_dostring(L, "return select(2, require('bytes').runs('aabbc'))") == LUA_OK);
+    JST_EXPECT_EQ(lua_tointeger(L, -1), 3);
+    lua_close(L);
+}
+
+JST_TEST_MAIN()
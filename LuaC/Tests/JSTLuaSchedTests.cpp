@@ -0,0 +1,185 @@
+#include "lua.hpp"
+extern "C" {
+#include "lsched.h"
+}
+#include "JSTTest.h"
+
+#include <cstring>
+#include <string>
+
+/* Runs a chunk as a task, resuming it until it is done, and cancels it once
+ * it has been suspended cancelAfter times if that is not 0. Leaves the
+ * stack of L as it found it. */
+struct JSTTaskRun {
+    int status = -1;
+    int suspensionCount = 0;
+    long long instructions = 0;
+    std::string message;     /* or the first result */
+};
+
+static JSTTaskRun JSTRunTask(lua_State *L, const char *chunk, lsched_Budget budget, int cancelAfter = 0)
+{
+    JSTTaskRun run;
+    int base = lua_gettop(L);
+    if (luaL_loadstring(L, chunk) != LUA_OK) {
+        run.message = lua_tostring(L, -1);
+        lua_settop(L, base);
+        return run;
+    }
+    lsched_Task *task = lsched_newtask(L, 0, &budget);
+    int nresults = 0;
+    while ((run.status = lsched_resume(task, &nresults)) == LSCHED_YIELD) {
+        if (++run.suspensionCount == cancelAfter) {
+            lsched_cancel(task);
+        }
+    }
+    if (lua_gettop(L) > base && lua_isstring(L, base + 1)) {
+        run.message = lua_tostring(L, base + 1);
+    }
+    run.instructions = lsched_instructions(task);
+    lua_settop(L, base);
+    lsched_freetask(task);
+    return run;
+}
+
+static lua_State *JSTNewState()
+{
+    lua_State *L = luaL_newstate();
+    luaL_openlibs(L);
+    return L;
+}
+
+static const lsched_Budget JSTNoBudget = { 0, 0, 0 };
+static const lsched_Budget JSTInstructionBudget = { 100000, 0, 0 };
+
+
+/* MARK: - Results */
+
+JST_TEST(testTaskReturnsItsResults)
+{
+    lua_State *L = JSTNewState();
+    JSTTaskRun run = JSTRunTask(L, "coroutine.yield() return 'done', 2", JSTNoBudget);
+    JST_EXPECT_EQ(run.status, LSCHED_OK);
+    JST_EXPECT_EQ(run.suspensionCount, 1);
+    JST_EXPECT(run.message == "done");
+
+    run = JSTRunTask(L, "error('boom')", JSTNoBudget);
+    JST_EXPECT_EQ(run.status, LSCHED_ERRRUN);
+    JST_EXPECT(run.message.find("boom") != std::string::npos);
+    JST_EXPECT(run.message.find("stack traceback") != std::string::npos);
+    JST_EXPECT_EQ(lua_gettop(L), 0);
+    lua_close(L);
+}
+
+
+/* MARK: - Stopping */
+
+JST_TEST(testStopGetsPastPcall)
+{
+    lua_State *L = JSTNewState();
+    const char *chunk = "while true do pcall(function() while true do end end) end";
+    JSTTaskRun run = JSTRunTask(L, chunk, JSTInstructionBudget);
+    JST_EXPECT_EQ(run.status, LSCHED_INSTRLIMIT);
+    JST_EXPECT(run.message == "instruction limit exceeded");
+    JST_EXPECT(run.instructions <= JSTInstructionBudget.instructions + 2 * LSCHED_HOOKCOUNT);
+
+    /* error handlers of xpcall run under the stopped task as well */
+    run = JSTRunTask(L, "while true do xpcall(function() while true do end end, function(e) return e end) end", JSTInstructionBudget);
+    JST_EXPECT_EQ(run.status, LSCHED_INSTRLIMIT);
+
+    lsched_Budget timeBudget = { 0, 0.05, 0 };
+    run = JSTRunTask(L, chunk, timeBudget);
+    JST_EXPECT_EQ(run.status, LSCHED_TIMELIMIT);
+    JST_EXPECT(run.message == "time limit exceeded");
+    lua_close(L);
+}
+
+JST_TEST(testStopRepeatsInNestedCoroutines)
+{
+    lua_State *L = JSTNewState();
+    /* the inner coroutines cannot suspend the task, they fail instead and
+     * keep failing until the task gets back to its own coroutine */
+    JSTTaskRun run = JSTRunTask(L,
+        "while true do\n"
+        "  local co = coroutine.create(function()\n"
+        "    while true do pcall(coroutine.wrap(function() while true do end end)) end\n"
+        "  end)\n"
+        "  coroutine.resume(co)\n"
+        "end",
+        JSTInstructionBudget);
+    JST_EXPECT_EQ(run.status, LSCHED_INSTRLIMIT);
+    JST_EXPECT(run.instructions <= JSTInstructionBudget.instructions + 4 * LSCHED_HOOKCOUNT);
+    lua_close(L);
+}
+
+JST_TEST(testStopRepeatsInCCalls)
+{
+    lua_State *L = JSTNewState();
+    /* callbacks of gsub and sort cannot yield across their C function */
+    JSTTaskRun run = JSTRunTask(L,
+        "local s = string.rep('a', 1000)\n"
+        "while true do pcall(string.gsub, s, '.', function() while true do end end) end",
+        JSTInstructionBudget);
+    JST_EXPECT_EQ(run.status, LSCHED_INSTRLIMIT);
+
+    run = JSTRunTask(L,
+        "local t = {}\n"
+        "for i = 1, 100 do t[i] = 100 - i end\n"
+        "while true do pcall(table.sort, t, function(a, b) while true do end end) end",
+        JSTInstructionBudget);
+    JST_EXPECT_EQ(run.status, LSCHED_INSTRLIMIT);
+    JST_EXPECT(run.instructions <= JSTInstructionBudget.instructions + 4 * LSCHED_HOOKCOUNT);
+    lua_close(L);
+}
+
+
+/* MARK: - Cancelling */
+
+JST_TEST(testCancelledWhileSuspended)
+{
+    lua_State *L = JSTNewState();
+    /* suspended at the end of every time slice */
+    lsched_Budget sliced = { 0, 0, 0.001 };
+    JSTTaskRun run = JSTRunTask(L, "while true do end", sliced, 3);
+    JST_EXPECT_EQ(run.status, LSCHED_CANCELLED);
+    JST_EXPECT_EQ(run.suspensionCount, 3);
+    JST_EXPECT(run.message == "cancelled");
+
+    /* suspended by the function itself, it does not run again */
+    run = JSTRunTask(L, "coroutine.yield() ran = true", JSTNoBudget, 1);
+    JST_EXPECT_EQ(run.status, LSCHED_CANCELLED);
+    JST_EXPECT_EQ(lua_getglobal(L, "ran"), LUA_TNIL);
+    lua_pop(L, 1);
+
+    /* and stays stopped */
+    JST_ASSERT(luaL_loadstring(L, "coroutine.yield()") == LUA_OK);
+    lsched_Task *task = lsched_newtask(L, 0, &JSTNoBudget);
+    int nresults;
+    JST_EXPECT_EQ(lsched_resume(task, &nresults), LSCHED_YIELD);
+    lsched_cancel(task);
+    JST_EXPECT(lsched_iscancelled(task));
+    JST_EXPECT_EQ(lsched_resume(task, &nresults), LSCHED_CANCELLED);
+    lua_pop(L, 1);
+    JST_EXPECT_EQ(lsched_resume(task, &nresults), LSCHED_CANCELLED);
+    lua_pop(L, 1);
+    lsched_freetask(task);
+    JST_EXPECT_EQ(lua_gettop(L), 0);
+    lua_close(L);
+}
+
+JST_TEST(testFreeingClosesPendingVariables)
+{
+    lua_State *L = JSTNewState();
+    JST_ASSERT(luaL_loadstring(L,
+        "local v <close> = setmetatable({}, { __close = function() closed = true end })\n"
+        "while true do end") == LUA_OK);
+    lsched_Budget sliced = { 0, 0, 0.001 };
+    lsched_Task *task = lsched_newtask(L, 0, &sliced);
+    int nresults;
+    JST_EXPECT_EQ(lsched_resume(task, &nresults), LSCHED_YIELD);
+    lsched_freetask(task);
+    JST_EXPECT_EQ(lua_getglobal(L, "closed"), LUA_TBOOLEAN);
+    lua_close(L);
+}
+
+JST_TEST_MAIN()
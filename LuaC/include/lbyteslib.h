@@ -0,0 +1,19 @@
+/*
+** $Id: lbyteslib.h $
+** Byte string encoders for templates
+** See Copyright Notice in lua.h
+*/
+
+
+#ifndef lbyteslib_h
+#define lbyteslib_h
+
+#include "lua.h"
+
+
+/* preloaded by LuaSwift, templates get it with require("bytes") */
+#define LUA_BYTESLIBNAME	"bytes"
+LUAMOD_API int (luaopen_bytes) (lua_State *L);
+
+
+#endif
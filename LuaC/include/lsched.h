@@ -0,0 +1,69 @@
+/*
+** $Id: lsched.h $
+** Budgeted and cancellable calls, run in coroutines
+** See Copyright Notice in lua.h
+*/
+
+
+#ifndef lsched_h
+#define lsched_h
+
+#include "lua.h"
+
+
+/*
+** A task runs a function in a coroutine of its own, under a count hook
+** which stops it once its budget is spent or once it is cancelled, and
+** which suspends it at the end of every time slice. The caller resumes it
+** until it is done, and may do something else between two resumes.
+*/
+
+/* statuses of lsched_resume */
+#define LSCHED_OK		0	/* returned, results pushed */
+#define LSCHED_YIELD		1	/* suspended, resume it again */
+#define LSCHED_ERRRUN		2	/* raised an error, message pushed */
+#define LSCHED_CANCELLED	3	/* message pushed for the others */
+#define LSCHED_INSTRLIMIT	4
+#define LSCHED_TIMELIMIT	5
+
+/* instructions between two checks of the hook */
+#define LSCHED_HOOKCOUNT	1000
+
+
+typedef struct lsched_Budget {
+  long long instructions;  /* virtual machine instructions, 0 for no limit */
+  double seconds;  /* time spent in lsched_resume, 0 for no limit */
+  double timeslice;  /* seconds between two suspensions, 0 for none */
+} lsched_Budget;
+
+typedef struct lsched_Task lsched_Task;
+
+
+/*
+** Pops a function and its nargs arguments off L and returns a task calling
+** them.
+*/
+LUA_API lsched_Task *(lsched_newtask) (lua_State *L, int nargs,
+                                       const lsched_Budget *budget);
+
+/*
+** Runs the task until it returns, fails or is suspended, either at the
+** end of its time slice or by a coroutine.yield() of the function itself.
+** Pushes its results onto L and sets *nresults on LSCHED_OK, nothing on
+** LSCHED_YIELD, and an error message otherwise, with a traceback on
+** LSCHED_ERRRUN.
+*/
+LUA_API int (lsched_resume) (lsched_Task *t, int *nresults);
+
+/* Asks the task to stop, from any thread; it fails at its next check. */
+LUA_API void (lsched_cancel) (lsched_Task *t);
+
+LUA_API int (lsched_iscancelled) (lsched_Task *t);
+LUA_API long long (lsched_instructions) (lsched_Task *t);
+LUA_API double (lsched_seconds) (lsched_Task *t);
+
+/* Closes the coroutine of the task, whatever its status, and frees it. */
+LUA_API void (lsched_freetask) (lsched_Task *t);
+
+
+#endif
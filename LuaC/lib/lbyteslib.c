@@ -0,0 +1,261 @@
+/*
+** $Id: lbyteslib.c $
+** Byte string encoders for templates
+** See Copyright Notice in lua.h
+*/
+
+#define lbyteslib_c
+#define LUA_LIB
+
+#include "lprefix.h"
+
+
+#include <limits.h>
+#include <string.h>
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lbyteslib.h"
+
+
+/*
+** Templates turn the data of whole areas into source code, which took one
+** Lua call and one string per byte with gsub. Every encoder here computes
+** the length of its result first, then writes it in a single pass into one
+** buffer of that size.
+*/
+
+
+/*
+** Largest result, as in lstrlib.c: both a size_t and a lua_Integer.
+*/
+#define MAX_SIZE \
+	(sizeof(size_t) < sizeof(lua_Integer) ? (~(size_t)0) \
+	                                      : (size_t)(LUA_MAXINTEGER))
+
+
+static const char hexdigits[] = "0123456789abcdef";
+
+static const char base64digits[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+/*
+** Length of l units of unitsize bytes plus extra, or an error if the
+** result would be too large.
+*/
+static size_t resultsize (lua_State *L, size_t l, size_t unitsize,
+                          size_t extra) {
+  if (l > (MAX_SIZE - extra) / unitsize)
+    luaL_error(L, "resulting string too large");
+  return l * unitsize + extra;
+}
+
+
+/* columns of an optional argument, 0 for a single line */
+static size_t checkcolumns (lua_State *L, int arg, lua_Integer def) {
+  lua_Integer columns = luaL_optinteger(L, arg, def);
+  luaL_argcheck(L, columns >= 0, arg, "out of range");
+  return (size_t)columns;
+}
+
+
+/*
+** hex_escape(s [, columns]): "\x89\x50..." as in a Lua or C string
+** literal, with a newline after every columns bytes if columns is given.
+*/
+static int bytes_hexescape (lua_State *L) {
+  size_t l;
+  const unsigned char *s = (const unsigned char *)luaL_checklstring(L, 1, &l);
+  size_t columns = checkcolumns(L, 2, 0);
+  size_t breaks = (columns > 0 && l > 0) ? (l - 1) / columns : 0;
+  size_t sz = resultsize(L, l, 4, breaks);
+  luaL_Buffer b;
+  char *p = luaL_buffinitsize(L, &b, sz);
+  size_t i, column = 0;
+  for (i = 0; i < l; i++) {
+    if (column == columns && i > 0) {  /* never true without columns */
+      *p++ = '\n';
+      column = 0;
+    }
+    p[0] = '\\';
+    p[1] = 'x';
+    p[2] = hexdigits[s[i] >> 4];
+    p[3] = hexdigits[s[i] & 0xF];
+    p += 4;
+    column++;
+  }
+  luaL_pushresultsize(&b, sz);
+  return 1;
+}
+
+
+/*
+** base64(s [, columns]): standard base64 with padding, with a newline
+** after every columns characters if columns is given, a multiple of 4.
+*/
+static int bytes_base64 (lua_State *L) {
+  size_t l;
+  const unsigned char *s = (const unsigned char *)luaL_checklstring(L, 1, &l);
+  size_t columns = checkcolumns(L, 2, 0);
+  size_t groups = l / 3 + (l % 3 != 0);
+  size_t groupsperline = columns / 4;
+  size_t breaks, sz, i, column = 0;
+  luaL_Buffer b;
+  char *p;
+  luaL_argcheck(L, columns % 4 == 0, 2, "not a multiple of 4");
+  breaks = (groupsperline > 0 && groups > 0) ? (groups - 1) / groupsperline : 0;
+  sz = resultsize(L, groups, 4, breaks);
+  p = luaL_buffinitsize(L, &b, sz);
+  for (i = 0; i < groups; i++, s += 3) {
+    unsigned long v;
+    size_t n = (i + 1 < groups || l % 3 == 0) ? 3 : l % 3;
+    if (column == groupsperline && i > 0) {
+      *p++ = '\n';
+      column = 0;
+    }
+    v = (unsigned long)s[0] << 16;
+    if (n > 1) v |= (unsigned long)s[1] << 8;
+    if (n > 2) v |= s[2];
+    p[0] = base64digits[(v >> 18) & 0x3F];
+    p[1] = base64digits[(v >> 12) & 0x3F];
+    p[2] = (n > 1) ? base64digits[(v >> 6) & 0x3F] : '=';
+    p[3] = (n > 2) ? base64digits[v & 0x3F] : '=';
+    p += 4;
+    column++;
+  }
+  luaL_pushresultsize(&b, sz);
+  return 1;
+}
+
+
+/*
+** array(s [, style [, columns]]): the bytes as an array literal of style
+** "c", {...}, or "swift", [...], with columns bytes on each indented row
+** and a comma after every byte, which both languages accept:
+**
+**   {
+**       0x89, 0x50, 0x4e, 0x47,
+**   }
+*/
+#define ARRAY_INDENT	"    "
+
+static int bytes_array (lua_State *L) {
+  static const char *const styles[] = {"c", "swift", NULL};
+  static const char opening[] = "{[";
+  static const char closing[] = "}]";
+  size_t l;
+  const unsigned char *s = (const unsigned char *)luaL_checklstring(L, 1, &l);
+  int style = luaL_checkoption(L, 2, "c", styles);
+  size_t columns = checkcolumns(L, 3, 12);
+  size_t rows, sz, i, column = 0;
+  luaL_Buffer b;
+  char *p;
+  luaL_argcheck(L, columns > 0, 3, "out of range");
+  rows = l / columns + (l % columns != 0);
+  /* both brackets, a newline after the opening one unless empty, an
+     indent for every row and "0xNN," for every byte, followed by a space
+     or the newline ending its row */
+  resultsize(L, l, 6 + sizeof(ARRAY_INDENT) - 1, 3);  /* rows <= l */
+  sz = 2 + (l > 0) + rows * (sizeof(ARRAY_INDENT) - 1) + l * 6;
+  p = luaL_buffinitsize(L, &b, sz);
+  *p++ = opening[style];
+  if (l > 0) *p++ = '\n';
+  for (i = 0; i < l; i++) {
+    if (column == 0) {
+      memcpy(p, ARRAY_INDENT, sizeof(ARRAY_INDENT) - 1);
+      p += sizeof(ARRAY_INDENT) - 1;
+    }
+    p[0] = '0';
+    p[1] = 'x';
+    p[2] = hexdigits[s[i] >> 4];
+    p[3] = hexdigits[s[i] & 0xF];
+    p[4] = ',';
+    p += 5;
+    if (++column == columns || i + 1 == l) {
+      *p++ = '\n';
+      column = 0;
+    }
+    else
+      *p++ = ' ';
+  }
+  *p = closing[style];
+  luaL_pushresultsize(&b, sz);
+  return 1;
+}
+
+
+/*
+** runs(s [, width]): run-length summary of s taken as units of width bytes,
+** such as 4 for pixels, written in hex and separated by spaces, with a
+** "*count" suffix for units repeated more than once:
+**
+**   ffffffff*120 ff000000 ffffffff*3
+**
+** Returns the summary and the number of runs.
+*/
+#define RUNS_MAXWIDTH	64
+
+static int bytes_runs (lua_State *L) {
+  size_t l;
+  const unsigned char *s = (const unsigned char *)luaL_checklstring(L, 1, &l);
+  lua_Integer width = luaL_optinteger(L, 2, 1);
+  size_t units, sz, i = 0;
+  lua_Integer runcount = 0;
+  luaL_Buffer b;
+  char *p, *start;
+  luaL_argcheck(L, 1 <= width && width <= RUNS_MAXWIDTH, 2, "out of range");
+  luaL_argcheck(L, l % (size_t)width == 0, 1,
+                "length is not a multiple of the width");
+  units = l / (size_t)width;
+  /* a run of a single unit takes its digits and a space, which is the
+     most any run takes per unit */
+  sz = resultsize(L, units, 2 * (size_t)width + 1, 0);
+  start = p = luaL_buffinitsize(L, &b, sz);
+  while (i < units) {
+    const unsigned char *unit = s + i * (size_t)width;
+    size_t count = 1, k;
+    while (i + count < units &&
+           memcmp(unit, unit + count * (size_t)width, (size_t)width) == 0)
+      count++;
+    i += count;
+    for (k = 0; k < (size_t)width; k++) {
+      p[0] = hexdigits[unit[k] >> 4];
+      p[1] = hexdigits[unit[k] & 0xF];
+      p += 2;
+    }
+    if (count > 1) {
+      char digits[3 * sizeof(size_t)];
+      size_t n = 0;
+      *p++ = '*';
+      do {
+        digits[n++] = (char)('0' + count % 10);
+        count /= 10;
+      } while (count > 0);
+      while (n > 0)
+        *p++ = digits[--n];
+    }
+    *p++ = ' ';
+    runcount++;
+  }
+  luaL_pushresultsize(&b, (p > start) ? (size_t)(p - start) - 1 : 0);
+  lua_pushinteger(L, runcount);
+  return 2;
+}
+
+
+static const luaL_Reg bytes_funcs[] = {
+  {"hex_escape", bytes_hexescape},
+  {"base64", bytes_base64},
+  {"array", bytes_array},
+  {"runs", bytes_runs},
+  {NULL, NULL}
+};
+
+
+LUAMOD_API int luaopen_bytes (lua_State *L) {
+  luaL_newlib(L, bytes_funcs);
+  return 1;
+}
+
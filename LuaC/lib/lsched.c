@@ -0,0 +1,238 @@
+/*
+** $Id: lsched.c $
+** Budgeted and cancellable calls, run in coroutines
+** See Copyright Notice in lua.h
+*/
+
+#define lsched_c
+#define LUA_LIB
+
+#include "lprefix.h"
+
+
+#include <stdatomic.h>
+#include <time.h>
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lsched.h"
+
+
+struct lsched_Task {
+  lua_State *L;  /* state the task was created in */
+  lua_State *co;  /* coroutine running the function */
+  int ref;  /* anchors the task and its coroutine in the registry */
+  int nargs;  /* arguments of the first resume, -1 once resumed */
+  int status;  /* LSCHED_OK until the hook stops the task */
+  atomic_int cancelled;
+  lsched_Budget budget;
+  long long instructions;
+  double seconds;  /* spent in previous resumes */
+  double resumetime;  /* when the current resume began */
+  double slicetime;  /* when the current time slice began */
+};
+
+
+static const char *const statusmessages[] = {
+  NULL, NULL, NULL,
+  "cancelled",
+  "instruction limit exceeded",
+  "time limit exceeded"
+};
+
+
+/*
+** Key of the task being resumed in the registry of its state, which the
+** hook looks for: the coroutines created by the function inherit the hook
+** and may outlive the task.
+*/
+static const char TASKKEY = 'k';
+
+
+static double now (void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+
+static void settask (lua_State *L, lsched_Task *t) {
+  if (t != NULL)
+    lua_pushlightuserdata(L, t);
+  else
+    lua_pushnil(L);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &TASKKEY);
+}
+
+
+static lsched_Task *gettask (lua_State *L) {
+  lsched_Task *t;
+  lua_rawgetp(L, LUA_REGISTRYINDEX, &TASKKEY);
+  t = (lsched_Task *)lua_touserdata(L, -1);
+  lua_pop(L, 1);
+  return t;
+}
+
+
+static int checkbudget (lsched_Task *t, double time) {
+  if (atomic_load_explicit(&t->cancelled, memory_order_relaxed))
+    return LSCHED_CANCELLED;
+  if (t->budget.instructions > 0 && t->instructions > t->budget.instructions)
+    return LSCHED_INSTRLIMIT;
+  if (t->budget.seconds > 0 &&
+      t->seconds + (time - t->resumetime) > t->budget.seconds)
+    return LSCHED_TIMELIMIT;
+  return LSCHED_OK;
+}
+
+
+/*
+** Once the task has to stop, suspends it for good, which a pcall of the
+** function cannot catch. In a coroutine of the function or under a C call,
+** where it cannot be suspended, raises an error instead, again at every
+** instruction until the task gets back to where it can be: a loop calling
+** back into Lua from a C function could otherwise spend every check but
+** the first in the callback.
+** Otherwise suspends the task at the end of its time slice.
+*/
+static void hookf (lua_State *L, lua_Debug *ar) {
+  lsched_Task *t = gettask(L);
+  int yieldable;
+  double time;
+  (void)ar;
+  if (t == NULL)  /* a coroutine left by an earlier task */
+    return;
+  time = now();
+  yieldable = (L == t->co && lua_isyieldable(L));
+  if (t->status == LSCHED_OK) {
+    t->instructions += LSCHED_HOOKCOUNT;
+    t->status = checkbudget(t, time);
+    if (t->status != LSCHED_OK)  /* coroutines created from now on inherit it */
+      lua_sethook(t->co, hookf, LUA_MASKCOUNT, 1);
+  }
+  if (t->status != LSCHED_OK) {
+    if (L != t->co)
+      lua_sethook(L, hookf, LUA_MASKCOUNT, 1);
+    if (yieldable)
+      lua_yield(L, 0);
+    else
+      luaL_error(L, "%s", statusmessages[t->status]);
+  }
+  else if (yieldable && t->budget.timeslice > 0 &&
+           time - t->slicetime >= t->budget.timeslice)
+    lua_yield(L, 0);
+}
+
+
+LUA_API lsched_Task *lsched_newtask (lua_State *L, int nargs,
+                                     const lsched_Budget *budget) {
+  lsched_Task *t;
+  lua_State *co;
+  luaL_checkstack(L, 2, NULL);
+  t = (lsched_Task *)lua_newuserdatauv(L, sizeof(lsched_Task), 1);
+  co = lua_newthread(L);
+  lua_setiuservalue(L, -2, 1);  /* the userdata keeps the coroutine */
+  t->L = L;
+  t->co = co;
+  t->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  t->nargs = nargs;
+  t->status = LSCHED_OK;
+  atomic_init(&t->cancelled, 0);
+  t->budget = *budget;
+  t->instructions = 0;
+  t->seconds = 0;
+  t->resumetime = t->slicetime = 0;
+  lua_xmove(L, co, nargs + 1);  /* function and arguments */
+  lua_sethook(co, hookf, LUA_MASKCOUNT, LSCHED_HOOKCOUNT);
+  return t;
+}
+
+
+/* pushes the error message of the dead coroutine onto L, with its traceback */
+static void pusherror (lsched_Task *t) {
+  const char *msg = lua_tostring(t->co, -1);
+  if (msg == NULL) {  /* error object is not a string? */
+    if (luaL_callmeta(t->co, -1, "__tostring") &&
+        lua_type(t->co, -1) == LUA_TSTRING)
+      msg = lua_tostring(t->co, -1);
+    else
+      msg = lua_pushfstring(t->co, "(error object is a %s value)",
+                               luaL_typename(t->co, -1));
+  }
+  luaL_traceback(t->L, t->co, msg, 0);
+}
+
+
+LUA_API int lsched_resume (lsched_Task *t, int *nresults) {
+  int nres = 0, status;
+  int nargs = t->nargs;
+  *nresults = 0;
+  t->resumetime = t->slicetime = now();
+  if (t->status == LSCHED_OK)  /* cancelled while suspended? */
+    t->status = checkbudget(t, t->resumetime);
+  if (t->status != LSCHED_OK) {
+    lua_pushstring(t->L, statusmessages[t->status]);
+    return t->status;
+  }
+  if (nargs < 0 && lua_status(t->co) != LUA_YIELD) {  /* not suspended? */
+    lua_pushliteral(t->L, "cannot resume a task which is not suspended");
+    return LSCHED_ERRRUN;
+  }
+  t->nargs = -1;
+  settask(t->L, t);
+  status = lua_resume(t->co, t->L, (nargs > 0) ? nargs : 0, &nres);
+  settask(t->L, NULL);
+  t->seconds += now() - t->resumetime;
+  if (t->status != LSCHED_OK) {  /* stopped, even if the function went on */
+    lua_pushstring(t->L, statusmessages[t->status]);
+    return t->status;
+  }
+  switch (status) {
+    case LUA_OK: {
+      luaL_checkstack(t->L, nres, "too many results");
+      lua_xmove(t->co, t->L, nres);
+      *nresults = nres;
+      return LSCHED_OK;
+    }
+    case LUA_YIELD: {
+      lua_pop(t->co, nres);  /* values yielded by the function are ignored */
+      return LSCHED_YIELD;
+    }
+    default: {
+      pusherror(t);
+      lua_settop(t->co, 0);
+      return LSCHED_ERRRUN;
+    }
+  }
+}
+
+
+LUA_API void lsched_cancel (lsched_Task *t) {
+  atomic_store_explicit(&t->cancelled, 1, memory_order_relaxed);
+}
+
+
+LUA_API int lsched_iscancelled (lsched_Task *t) {
+  return atomic_load_explicit(&t->cancelled, memory_order_relaxed);
+}
+
+
+LUA_API long long lsched_instructions (lsched_Task *t) {
+  return t->instructions;
+}
+
+
+LUA_API double lsched_seconds (lsched_Task *t) {
+  return t->seconds;
+}
+
+
+LUA_API void lsched_freetask (lsched_Task *t) {
+  /* without the hook, which would suspend the closing of the pending
+     to-be-closed variables of a suspended coroutine */
+  lua_sethook(t->co, NULL, 0, 0);
+  lua_resetthread(t->co);
+  luaL_unref(t->L, LUA_REGISTRYINDEX, t->ref);  /* the GC frees both */
+}
+
@@ -0,0 +1,69 @@
+public let LuaRelease = String(cString: SDegutisLuaRelease)
+
+/// Compiled chunks of Lua source files, kept in a directory so that a source file is only parsed again once it changes.
+/// Every entry starts with a line holding the path, modification date and size of its source and the Lua release,
+/// followed by the bytecode dumped with its debug information, so that errors still point into the source.
+open class BytecodeCache {
+
+    public let directoryURL: URL
+
+    public init(directoryURL: URL) {
+        self.directoryURL = directoryURL
+    }
+
+    internal func key(for sourceURL: URL) -> String? {
+        guard let attributes = try? FileManager.default.attributesOfItem(atPath: sourceURL.path),
+              let modificationDate = attributes[.modificationDate] as? Date,
+              let size = attributes[.size] as? NSNumber
+        else {
+            return nil
+        }
+        // the size catches rewrites within the resolution of the modification date
+        return "\(sourceURL.path)\t\(modificationDate.timeIntervalSinceReferenceDate)\t\(size.uint64Value)\t\(LuaRelease)"
+    }
+
+    internal func entryURL(for sourceURL: URL) -> URL {
+        // FNV-1a, stable across launches unlike hashValue
+        var hash: UInt64 = 0xcbf29ce484222325
+        for byte in sourceURL.path.utf8 {
+            hash = (hash ^ UInt64(byte)) &* 0x100000001b3
+        }
+        return directoryURL.appendingPathComponent(String(format: "%016llx.luac", hash))
+    }
+
+    internal func bytecode(for sourceURL: URL, key: String) -> Data? {
+        guard let entry = try? Data(contentsOf: entryURL(for: sourceURL), options: .mappedIfSafe),
+              let newline = entry.firstIndex(of: 0x0A),
+              entry[entry.startIndex..<newline].elementsEqual(key.utf8)
+        else {
+            return nil
+        }
+        return entry[(newline + 1)...]
+    }
+
+    internal func store(_ bytecode: Data, for sourceURL: URL, key: String) {
+        if !FileManager.default.fileExists(atPath: directoryURL.path) {
+            try? FileManager.default.createDirectory(at: directoryURL, withIntermediateDirectories: true, attributes: nil)
+        }
+        var entry = Data(key.utf8)
+        entry.append(0x0A)
+        entry.append(bytecode)
+        try? entry.write(to: entryURL(for: sourceURL), options: .atomic)
+    }
+
+    /// Removes the entries of source files other than these, such as deleted ones.
+    open func removeEntries(keeping sourceURLs: [URL]) {
+        let keptNames = Set(sourceURLs.map({ entryURL(for: $0).lastPathComponent }))
+        guard let entryURLs = try? FileManager.default.contentsOfDirectory(
+            at: directoryURL,
+            includingPropertiesForKeys: nil,
+            options: [.skipsHiddenFiles]
+        ) else {
+            return
+        }
+        for entryURL in entryURLs where entryURL.pathExtension == "luac" && !keptNames.contains(entryURL.lastPathComponent) {
+            try? FileManager.default.removeItem(at: entryURL)
+        }
+    }
+
+}
@@ -0,0 +1,94 @@
+public enum CoroutineResults {
+    case values([Value])
+    case suspended
+    case error(String)
+    case cancelled
+    case instructionLimitExceeded
+    case timeLimitExceeded
+}
+
+/// A call of a function in a coroutine of its own, which stops once its budget is spent or once it is cancelled, see lsched.h.
+open class Coroutine {
+
+    public struct Budget {
+        public var instructionLimit: Int64      // 0 for no limit
+        public var timeLimit: TimeInterval      // time spent running, 0 for no limit
+        public var timeSlice: TimeInterval      // time between two suspensions, 0 for none
+
+        public init(instructionLimit: Int64 = 0, timeLimit: TimeInterval = 0, timeSlice: TimeInterval = 0) {
+            self.instructionLimit = instructionLimit
+            self.timeLimit = timeLimit
+            self.timeSlice = timeSlice
+        }
+    }
+
+    public let budget: Budget
+    private unowned let vm: VirtualMachine
+    private let task: OpaquePointer
+
+    public init(_ function: Function, _ args: [Value], budget: Budget) {
+        self.vm = function.vm
+        self.budget = budget
+
+        function.push(vm)
+        for arg in args {
+            arg.push(vm)
+        }
+
+        var taskBudget = lsched_Budget(
+            instructions: budget.instructionLimit,
+            seconds: budget.timeLimit,
+            timeslice: budget.timeSlice
+        )
+        task = lsched_newtask(vm.vm, Int32(args.count), &taskBudget)
+    }
+
+    deinit {
+        lsched_freetask(task)
+    }
+
+    /// Runs the function until it returns, fails or is suspended, at the end of its time slice or by a `coroutine.yield()` of its own.
+    /// Must not be called from two threads at once, nor while the virtual machine runs anything else.
+    open func resume() -> CoroutineResults {
+        let originalStackTop = vm.stackSize()
+
+        var numReturnValues: Int32 = 0
+        let result = lsched_resume(task, &numReturnValues)
+
+        switch result {
+        case LSCHED_OK:
+            var values = [Value]()
+            for _ in 0..<Int(numReturnValues) {
+                let v = vm.popValue(originalStackTop + 1)!
+                values.append(v)
+            }
+            return .values(values)
+        case LSCHED_YIELD:
+            return .suspended
+        case LSCHED_CANCELLED:
+            vm.pop()
+            return .cancelled
+        case LSCHED_INSTRLIMIT:
+            vm.pop()
+            return .instructionLimitExceeded
+        case LSCHED_TIMELIMIT:
+            vm.pop()
+            return .timeLimitExceeded
+        default:
+            let err = vm.popError()
+            return .error(err)
+        }
+    }
+
+    /// Stops the function at its next check, which may be called from any thread.
+    open func cancel() {
+        lsched_cancel(task)
+    }
+
+    open var isCancelled: Bool { lsched_iscancelled(task) != 0 }
+
+    open var instructionCount: Int64 { lsched_instructions(task) }
+
+    open var runningTime: TimeInterval { lsched_seconds(task) }
+
+}
@@ -45,9 +45,15 @@ open class VirtualMachine {
     internal let vm = luaL_newstate()
 
     open var errorHandler: ErrorHandler? = { print("error: \($0)") }
+
+    /// The underlying `lua_State`, for values pushed by native code.
+    open var state: OpaquePointer { vm }
     
     public init(openLibs: Bool = true) {
-        if openLibs { luaL_openlibs(vm) }
+        if openLibs {
+            luaL_openlibs(vm)
+            preloadModules([LUA_BYTESLIBNAME: luaopen_bytes])
+        }
     }
     
     deinit {
@@ -58,13 +64,26 @@ open class VirtualMachine {
         lua_getglobal(vm, "package")
         lua_getfield(vm, -1, "preload");
 
-        var module = modules.pointee
+        var module = modules
 
-        while let name = module.name, let function = module.func {
+        while let name = module.pointee.name, let function = module.pointee.func {
             lua_pushcclosure(vm, function, 0)
             lua_setfield(vm, -2, name)
 
-            module = modules.advanced(by: 1).pointee
+            module = module.advanced(by: 1)
+        }
+
+        lua_settop(vm, -(2)-1)
+    }
+
+    /// Makes native modules available to `require` without loading them yet.
+    public func preloadModules(_ modules: [String: lua_CFunction]) {
+        lua_getglobal(vm, "package")
+        lua_getfield(vm, -1, "preload");
+
+        for (name, function) in modules {
+            lua_pushcclosure(vm, function, 0)
+            lua_setfield(vm, -2, name)
         }
 
         lua_settop(vm, -(2)-1)
@@ -135,6 +154,38 @@ open class VirtualMachine {
         }
     }
 
+    /// Loads the bytecode of an unchanged source file from the cache, or compiles it and stores its bytecode.
+    open func createFunction(_ body: URL, cache: BytecodeCache) -> MaybeFunction {
+        guard let key = cache.key(for: body) else {
+            return createFunction(body)
+        }
+
+        let chunkName = "@" + body.path
+        if let bytecode = cache.bytecode(for: body, key: key) {
+            let status = bytecode.withUnsafeBytes {
+                luaL_loadbufferx(vm, $0.baseAddress?.assumingMemoryBound(to: CChar.self), $0.count, chunkName, "b")
+            }
+            if status == LUA_OK {
+                return .value(popValue(-1) as! Function)
+            }
+            pop()  // dumped by another build of Lua, compile it again
+        }
+
+        guard luaL_loadfilex(vm, body.path, nil) == LUA_OK else {
+            return .error(popError())
+        }
+        let bytecode = NSMutableData()
+        let status = lua_dump(vm, { (_, p, size, userData) -> Int32 in
+            guard let p = p, let userData = userData else { return 0 }
+            Unmanaged<NSMutableData>.fromOpaque(userData).takeUnretainedValue().append(p, length: size)
+            return 0
+        }, Unmanaged.passUnretained(bytecode).toOpaque(), 0)
+        if status == 0 {
+            cache.store(bytecode as Data, for: body, key: key)
+        }
+        return .value(popValue(-1) as! Function)
+    }
+
     open func createFunction(_ body: String) -> MaybeFunction {
         if luaL_loadstring(vm, (body as NSString).utf8String) == LUA_OK {
             return .value(popValue(-1) as! Function)
@@ -205,6 +256,12 @@ open class VirtualMachine {
         return eval(function: fn, args: args)
     }
 
+    open func eval(_ url: URL, cache: BytecodeCache, args: [Value] = []) -> EvalResults {
+        let fn = createFunction(url, cache: cache)
+
+        return eval(function: fn, args: args)
+    }
+
     open func eval(_ str: String, args: [Value] = []) -> EvalResults {
         let fn = createFunction(str)
 
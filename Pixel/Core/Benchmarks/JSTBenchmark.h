@@ -0,0 +1,64 @@
+#ifndef JSTBenchmark_h
+#define JSTBenchmark_h
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "JSTPixelCore.h"
+
+/* Minimal benchmark harness. Runs the body a few times to warm up, then
+ * reports the best time per iteration and the pixel throughput. */
+
+template <typename Body>
+inline double JSTBenchmark(const char *name, size_t pixelsPerIteration, int iterations, Body body) {
+    using Clock = std::chrono::steady_clock;
+    for (int i = 0; i < 2; ++i) {
+        body();
+    }
+    double best = 1e30;
+    for (int i = 0; i < iterations; ++i) {
+        Clock::time_point begin = Clock::now();
+        body();
+        double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+        best = std::min(best, elapsed);
+    }
+    double megapixelsPerSecond = best > 0 ? (double)pixelsPerIteration / (best * 1000.0) : 0;
+    printf("%-48s %10.3f ms %10.1f MP/s\n", name, best, megapixelsPerSecond);
+    return best;
+}
+
+/* Prevents the compiler from optimising away benchmark results: the
+ * pointer itself is volatile, so that the store is never elided. */
+inline const void *volatile JSTBenchmarkSink = nullptr;
+
+template <typename T>
+inline void JSTBenchmarkKeep(const T &value) {
+    JSTBenchmarkSink = &value;
+}
+
+/* Fills an image with deterministic noise, so that kernels cannot take
+ * shortcuts on uniform input. */
+inline void JSTBenchmarkFillPixelImage(JST_IMAGE *pixelImage, uint32_t seed) {
+    uint32_t state = seed ? seed : 0x9E3779B9u;
+    for (int y = 0; y < pixelImage->height; ++y) {
+        JST_COLOR *row = pixelImage->pixels + (size_t)y * pixelImage->alignedWidth;
+        for (int x = 0; x < pixelImage->alignedWidth; ++x) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            row[x].theColor = state | 0xFF000000u;
+        }
+    }
+}
+
+/* Iteration count can be overridden with JST_BENCHMARK_ITERATIONS. */
+inline int JSTBenchmarkIterations(int fallback) {
+    const char *value = getenv("JST_BENCHMARK_ITERATIONS");
+    int iterations = value ? atoi(value) : 0;
+    return iterations > 0 ? iterations : fallback;
+}
+
+#endif /* JSTBenchmark_h */
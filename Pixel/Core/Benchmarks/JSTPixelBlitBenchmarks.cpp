@@ -0,0 +1,68 @@
+#include "JSTBenchmark.h"
+#include "JSTPixelBlit.h"
+
+#include <vector>
+
+
+/* The loop JSTCreateCGImageWithPixelImage used before the blit kernels,
+ * which re-evaluates the orientation switch for every pixel. */
+static void JSTCopyOrientedPixelsPerPixel(const JST_IMAGE *pixelImage, JST_COLOR *buffer) {
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
+    size_t bigCountOffset = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int sx = x, sy = y;
+            SHIFT_XY_BY_ORIEN(sx, sy, pixelImage->width, pixelImage->height, pixelImage->orientation);
+            buffer[bigCountOffset++] = pixelImage->pixels[(size_t)sy * pixelImage->alignedWidth + sx];
+        }
+    }
+}
+
+int main() {
+    int iterations = JSTBenchmarkIterations(10);
+
+    /* 2796x1290 landscape capture, stored in portrait. The padded variant
+     * mimics an IOSurface with 64 byte aligned rows. */
+    const int width = 1290, height = 2796;
+    const int alignedWidths[] = { width, 1296 };
+    const JST_BLIT_KERNEL kernels[] = {
+        JST_BLIT_KERNEL_SCALAR,
+        JST_BLIT_KERNEL_SSE2,
+        JST_BLIT_KERNEL_AVX2,
+        JST_BLIT_KERNEL_NEON,
+    };
+    size_t pixelsCount = (size_t)width * height;
+    std::vector<JST_COLOR> buffer(pixelsCount);
+
+    for (int alignedWidth : alignedWidths) {
+        JST_COLOR *pixels = (JST_COLOR *)calloc((size_t)alignedWidth * height, sizeof(JST_COLOR));
+        JST_IMAGE *image = JSTCreatePixelImageWithPixels(pixels, width, alignedWidth, height, true);
+        JSTBenchmarkFillPixelImage(image, 7);
+
+        for (JST_ORIENTATION orientation = 0; orientation < 4; ++orientation) {
+            image->orientation = orientation;
+            char name[96];
+            snprintf(name, sizeof(name), "per-pixel loop/aligned %d/orientation %d", alignedWidth, orientation);
+            JSTBenchmark(name, pixelsCount, iterations, [&] {
+                JSTCopyOrientedPixelsPerPixel(image, buffer.data());
+                JSTBenchmarkKeep(buffer[0]);
+            });
+
+            int orientedWidth, orientedHeight;
+            JSTGetOrientedSizeOfPixelImage(image, &orientedWidth, &orientedHeight);
+            for (JST_BLIT_KERNEL kernel : kernels) {
+                if (!JSTBlitKernelIsSupported(kernel)) {
+                    continue;
+                }
+                snprintf(name, sizeof(name), "%s/aligned %d/orientation %d", JSTBlitKernelGetName(kernel), alignedWidth, orientation);
+                JSTBenchmark(name, pixelsCount, iterations, [&] {
+                    JSTBlitOrientedPixelsOfPixelImage(image, buffer.data(), orientedWidth, kernel);
+                    JSTBenchmarkKeep(buffer[0]);
+                });
+            }
+        }
+        JSTFreePixelImage(image);
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "JSTBenchmark.h"
+#include "JSTPixelCache.h"
+
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+
+/* A modern iPhone screenshot, 2796x1290 in landscape */
+static const int kBenchmarkWidth = 1290;
+static const int kBenchmarkHeight = 2796;
+
+/* Size of a typical PNG encoded screenshot, for the content hash */
+static const size_t kBenchmarkEncodedLength = 5 * 1024 * 1024;
+
+int main() {
+    int iterations = JSTBenchmarkIterations(10);
+    size_t pixelsCount = (size_t)kBenchmarkWidth * kBenchmarkHeight;
+
+    JST_IMAGE *image = JSTCreatePixelImage(kBenchmarkWidth, kBenchmarkHeight);
+    JSTBenchmarkFillPixelImage(image, 1);
+
+    const char *directory = getenv("TMPDIR");
+    std::string path = std::string(directory && *directory ? directory : "/tmp") + "/JSTPixelCacheBenchmarks.jstpixel";
+
+    std::vector<uint8_t> encoded(kBenchmarkEncodedLength);
+    memcpy(encoded.data(), image->pixels, encoded.size());
+    JSTBenchmark("JSTPixelCacheHashBytes/5MB", encoded.size() / sizeof(JST_COLOR), iterations, [&] {
+        uint64_t hash = JSTPixelCacheHashBytes(encoded.data(), encoded.size());
+        JSTBenchmarkKeep(hash);
+    });
+
+    JSTBenchmark("JSTPixelCacheWriteFile", pixelsCount, iterations, [&] {
+        JST_BOOL written = JSTPixelCacheWriteFile(path.c_str(), image, 1, NULL, 0);
+        JSTBenchmarkKeep(written);
+    });
+
+    JSTBenchmark("JSTPixelCacheCreatePixelImageWithFile", pixelsCount, iterations, [&] {
+        JST_IMAGE *mapped = JSTPixelCacheCreatePixelImageWithFile(path.c_str(), 1, NULL, NULL);
+        JSTBenchmarkKeep(mapped->pixels);
+        JSTFreePixelImage(mapped);
+    });
+
+    /* Mapping plus touching every pixel once, the worst case of a reopen */
+    JSTBenchmark("JSTPixelCacheCreatePixelImageWithFile+Read", pixelsCount, iterations, [&] {
+        JST_IMAGE *mapped = JSTPixelCacheCreatePixelImageWithFile(path.c_str(), 1, NULL, NULL);
+        uint32_t checksum = 0;
+        for (size_t i = 0; i < pixelsCount; ++i) {
+            checksum += mapped->pixels[i].theColor;
+        }
+        JSTBenchmarkKeep(checksum);
+        JSTFreePixelImage(mapped);
+    });
+
+    JSTBenchmark("JSTCopyPixelImage", pixelsCount, iterations, [&] {
+        JST_IMAGE *copied = JSTCopyPixelImage(image);
+        JSTBenchmarkKeep(copied->pixels[0]);
+        JSTFreePixelImage(copied);
+    });
+
+    unlink(path.c_str());
+    JSTFreePixelImage(image);
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "JSTBenchmark.h"
+#include "JSTPixelStorage.h"
+
+#include <vector>
+
+
+/* A modern iPhone screenshot, 2796x1290 in landscape */
+static const int kBenchmarkWidth = 1290;
+static const int kBenchmarkHeight = 2796;
+
+int main() {
+    int iterations = JSTBenchmarkIterations(10);
+    size_t pixelsCount = (size_t)kBenchmarkWidth * kBenchmarkHeight;
+
+    JST_IMAGE *image = JSTCreatePixelImage(kBenchmarkWidth, kBenchmarkHeight);
+    JSTBenchmarkFillPixelImage(image, 1);
+    std::vector<JST_COLOR> buffer(pixelsCount);
+
+    for (JST_ORIENTATION orientation = 0; orientation < 4; ++orientation) {
+        char name[64];
+        snprintf(name, sizeof(name), "JSTCopyOrientedPixelsOfPixelImage/%d", orientation);
+        image->orientation = orientation;
+        JSTBenchmark(name, pixelsCount, iterations, [&] {
+            JSTCopyOrientedPixelsOfPixelImage(image, buffer.data());
+            JSTBenchmarkKeep(buffer[0]);
+        });
+    }
+    image->orientation = 0;
+
+    JSTBenchmark("JSTCopyPixelImage", pixelsCount, iterations, [&] {
+        JST_IMAGE *copied = JSTCopyPixelImage(image);
+        JSTBenchmarkKeep(copied->pixels[0]);
+        JSTFreePixelImage(copied);
+    });
+
+    JSTBenchmark("JSTCreatePixelImageSharingPixelImage", pixelsCount, iterations, [&] {
+        JST_IMAGE *shared = JSTCreatePixelImageSharingPixelImage(image);
+        JSTBenchmarkKeep(shared->pixels[0]);
+        JSTFreePixelImage(shared);
+    });
+
+    JSTBenchmark("JSTCreatePixelImageByCroppingPixelImage", pixelsCount / 4, iterations, [&] {
+        JST_IMAGE *cropped = JSTCreatePixelImageByCroppingPixelImage(image, kBenchmarkWidth / 4, kBenchmarkHeight / 4, kBenchmarkWidth / 2, kBenchmarkHeight / 2);
+        JSTBenchmarkKeep(cropped->pixels[0]);
+        JSTFreePixelImage(cropped);
+    });
+
+    JSTBenchmark("JSTCreatePixelImageViewByCroppingPixelImage", pixelsCount / 4, iterations, [&] {
+        JST_IMAGE *cropped = JSTCreatePixelImageViewByCroppingPixelImage(image, kBenchmarkWidth / 4, kBenchmarkHeight / 4, kBenchmarkWidth / 2, kBenchmarkHeight / 2);
+        JSTBenchmarkKeep(cropped->pixels[0]);
+        JSTFreePixelImage(cropped);
+    });
+
+    /* Crop followed by the export path, which is where a view is packed */
+    std::vector<JST_COLOR> croppedBuffer(pixelsCount / 4);
+    JSTBenchmark("JSTCreatePixelImageByCroppingPixelImage+Export", pixelsCount / 4, iterations, [&] {
+        JST_IMAGE *cropped = JSTCreatePixelImageByCroppingPixelImage(image, kBenchmarkWidth / 4, kBenchmarkHeight / 4, kBenchmarkWidth / 2, kBenchmarkHeight / 2);
+        JSTCopyOrientedPixelsOfPixelImage(cropped, croppedBuffer.data());
+        JSTBenchmarkKeep(croppedBuffer[0]);
+        JSTFreePixelImage(cropped);
+    });
+
+    JSTBenchmark("JSTCreatePixelImageViewByCroppingPixelImage+Export", pixelsCount / 4, iterations, [&] {
+        JST_IMAGE *cropped = JSTCreatePixelImageViewByCroppingPixelImage(image, kBenchmarkWidth / 4, kBenchmarkHeight / 4, kBenchmarkWidth / 2, kBenchmarkHeight / 2);
+        JSTCopyOrientedPixelsOfPixelImage(cropped, croppedBuffer.data());
+        JSTBenchmarkKeep(croppedBuffer[0]);
+        JSTFreePixelImage(cropped);
+    });
+
+    JSTBenchmark("JSTGetColorInPixelImageSafe", pixelsCount, iterations, [&] {
+        uint32_t checksum = 0;
+        JST_COLOR color;
+        for (int y = 0; y < kBenchmarkHeight; ++y) {
+            for (int x = 0; x < kBenchmarkWidth; ++x) {
+                JSTGetColorInPixelImageSafe(image, x, y, &color);
+                checksum += color.theColor;
+            }
+        }
+        JSTBenchmarkKeep(checksum);
+    });
+
+    JSTFreePixelImage(image);
+    return 0;
+}
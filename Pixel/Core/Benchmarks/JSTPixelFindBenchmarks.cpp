@@ -0,0 +1,99 @@
+#include "JSTBenchmark.h"
+#include "JSTPixelFind.h"
+
+#include <vector>
+
+
+/* What a find_color script did before there was an engine to check it: every
+ * point read through the safe getter at every anchor position. */
+static long long JSTFindColorPerPixel(const JST_IMAGE *pixelImage, const std::vector<JST_POS> &points) {
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
+    long long matchCount = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            bool isMatch = true;
+            for (const JST_POS &point : points) {
+                int px = x + point.x - points[0].x, py = y + point.y - points[0].y;
+                if (px < 0 || py < 0 || px >= width || py >= height) {
+                    isMatch = false;
+                    break;
+                }
+                JST_COLOR color;
+                JSTGetColorInPixelImageSafe(pixelImage, px, py, &color);
+                if (!JSTFindColorMatchesPoint(color, &point)) {
+                    isMatch = false;
+                    break;
+                }
+            }
+            matchCount += isMatch ? 1 : 0;
+        }
+    }
+    return matchCount;
+}
+
+int main() {
+    int iterations = JSTBenchmarkIterations(10);
+
+    const int width = 1290, height = 2796;
+    const JST_FIND_COLOR_KERNEL kernels[] = {
+        JST_FIND_COLOR_KERNEL_SCALAR,
+        JST_FIND_COLOR_KERNEL_SSE2,
+        JST_FIND_COLOR_KERNEL_AVX2,
+        JST_FIND_COLOR_KERNEL_NEON,
+    };
+    size_t pixelsCount = (size_t)width * height;
+
+    /* Smooth gradients, where a loose anchor matches in wide bands and the
+     * other points have to reject most candidates. */
+    JST_IMAGE *image = JSTCreatePixelImage(width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            JST_COLOR &color = image->pixels[(size_t)y * width + x];
+            color.red = (uint8_t)(x * 255 / width);
+            color.green = (uint8_t)(y * 255 / height);
+            color.blue = (uint8_t)((x / 16) & 0xFF);
+            color.alpha = 0xFF;
+        }
+    }
+
+    auto point = [image](int x, int y, int similarity) {
+        JST_POS pos = {};
+        pos.x = x;
+        pos.y = y;
+        JSTGetColorInPixelImageSafe(image, x, y, &pos.color);
+        pos.similarity = (int8_t)similarity;
+        return pos;
+    };
+    struct Search {
+        const char *name;
+        std::vector<JST_POS> points;
+    };
+    const Search searches[] = {
+        { "exact anchor", { point(640, 1400, 100), point(700, 1420, 100), point(600, 1500, 100) } },
+        { "loose anchor", { point(640, 1400, 90), point(700, 1420, 100), point(600, 1500, 100) } },
+    };
+
+    std::vector<JST_FIND_COLOR_MATCH> matches(1024);
+    for (const Search &search : searches) {
+        char name[96];
+        snprintf(name, sizeof(name), "per-pixel loop/%s", search.name);
+        JSTBenchmark(name, pixelsCount, iterations, [&] {
+            JSTBenchmarkKeep(JSTFindColorPerPixel(image, search.points));
+        });
+
+        for (JST_FIND_COLOR_KERNEL kernel : kernels) {
+            if (!JSTFindColorKernelIsSupported(kernel)) {
+                continue;
+            }
+            snprintf(name, sizeof(name), "%s/%s", JSTFindColorKernelGetName(kernel), search.name);
+            JSTBenchmark(name, pixelsCount, iterations, [&] {
+                long long count = JSTFindColorInPixelImage(image, search.points.data(), (int)search.points.size(), 0, 0, width, height, matches.data(), (long long)matches.size(), NULL, kernel);
+                JSTBenchmarkKeep(count);
+            });
+        }
+    }
+
+    JSTFreePixelImage(image);
+    return 0;
+}
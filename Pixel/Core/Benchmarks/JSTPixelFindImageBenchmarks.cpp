@@ -0,0 +1,107 @@
+#include "JSTBenchmark.h"
+#include "JSTPixelFindImage.h"
+
+#include <vector>
+
+
+/* Every position compared in full, without pyramids nor early rejection. */
+static long long JSTFindImageBruteForce(const JST_IMAGE *image, const JST_IMAGE *templateImage, int x1, int y1, int x2, int y2, double similarity) {
+    const int width = templateImage->width, height = templateImage->height;
+    const long long maxDifference = JSTFindImageGetMaximumDifference(width, height, similarity);
+    long long matchCount = 0;
+    for (int y = y1; y + height <= y2; ++y) {
+        for (int x = x1; x + width <= x2; ++x) {
+            long long sum = 0;
+            for (int j = 0; j < height; ++j) {
+                const JST_COLOR *a = image->pixels + (size_t)(y + j) * image->alignedWidth + x;
+                const JST_COLOR *b = templateImage->pixels + (size_t)j * templateImage->alignedWidth;
+                for (int i = 0; i < width; ++i) {
+                    int red = a[i].red - b[i].red, green = a[i].green - b[i].green, blue = a[i].blue - b[i].blue;
+                    sum += red * red + green * green + blue * blue;
+                }
+            }
+            matchCount += sum <= maxDifference ? 1 : 0;
+        }
+    }
+    return matchCount;
+}
+
+int main() {
+    int iterations = JSTBenchmarkIterations(5);
+
+    const int width = 1290, height = 2796;
+    const JST_FIND_IMAGE_KERNEL kernels[] = {
+        JST_FIND_IMAGE_KERNEL_SCALAR,
+        JST_FIND_IMAGE_KERNEL_SSE2,
+        JST_FIND_IMAGE_KERNEL_AVX2,
+        JST_FIND_IMAGE_KERNEL_NEON,
+    };
+
+    /* Gradients under light noise, like the flat backgrounds of a
+     * screenshot, with a button-sized template cropped out of them. */
+    JST_IMAGE *image = JSTCreatePixelImage(width, height);
+    JSTBenchmarkFillPixelImage(image, 0x2545F491u);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            JST_COLOR &color = image->pixels[(size_t)y * width + x];
+            color.red = (uint8_t)(x * 255 / width + (color.red & 3));
+            color.green = (uint8_t)(y * 255 / height + (color.green & 3));
+            color.blue = (uint8_t)(((x / 40) * 37 + (y / 40) * 91) & 0xFF);
+        }
+    }
+    JST_IMAGE *templateImage = JSTCreatePixelImageByCroppingPixelImage(image, 500, 1200, 48, 48);
+
+    struct Search {
+        const char *name;
+        int x1, y1, x2, y2;
+    };
+    const Search searches[] = {
+        { "400x400 region", 400, 1100, 800, 1500 },
+        { "whole image", 0, 0, width, height },
+    };
+
+    std::vector<JST_FIND_IMAGE_MATCH> matches(16);
+    for (const Search &search : searches) {
+        size_t positionsCount = (size_t)(search.x2 - search.x1 - 47) * (search.y2 - search.y1 - 47);
+        char name[96];
+        /* far too slow over the whole image */
+        if (positionsCount < 1000000) {
+            snprintf(name, sizeof(name), "brute force/%s", search.name);
+            JSTBenchmark(name, positionsCount, iterations, [&] {
+                /* volatile, since the loops have no side effect at all */
+                volatile long long count = JSTFindImageBruteForce(image, templateImage, search.x1, search.y1, search.x2, search.y2, 0.95);
+                (void)count;
+            });
+        }
+
+        for (JST_FIND_IMAGE_KERNEL kernel : kernels) {
+            if (!JSTFindImageKernelIsSupported(kernel)) {
+                continue;
+            }
+            const struct {
+                const char *name;
+                int levelCount;
+                int threadCount;
+            } configurations[] = {
+                { "no pyramid", 0, 1 },
+                { "pyramid", -1, 1 },
+                { "pyramid, threads", -1, 0 },
+            };
+            for (const auto &configuration : configurations) {
+                JST_FIND_IMAGE_OPTIONS options;
+                JSTFindImageOptionsInit(&options);
+                options.levelCount = configuration.levelCount;
+                options.threadCount = configuration.threadCount;
+                snprintf(name, sizeof(name), "%s/%s/%s", JSTFindImageKernelGetName(kernel), configuration.name, search.name);
+                JSTBenchmark(name, positionsCount, iterations, [&] {
+                    long long count = JSTFindImageInPixelImage(image, templateImage, search.x1, search.y1, search.x2, search.y2, &options, matches.data(), (long long)matches.size(), NULL, kernel);
+                    JSTBenchmarkKeep(count);
+                });
+            }
+        }
+    }
+
+    JSTFreePixelImage(templateImage);
+    JSTFreePixelImage(image);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "JSTBenchmark.h"
+#include "JSTPixelMatch.h"
+
+#include <thread>
+#include <vector>
+
+
+/* Two captures of the same screen: the second one has light noise, and
+ * optionally a band of changed content, which is what PixelMatchService sees
+ * when comparing consecutive screenshots. Changed pixels all go through the
+ * anti-aliasing detection, so the band measures that path rather than the
+ * kernels. */
+static void JSTBenchmarkFillSecondPixelImage(const JST_IMAGE *first, JST_IMAGE *second, int bandHeight) {
+    uint32_t state = 0x2545F491u;
+    for (int y = 0; y < first->height; ++y) {
+        const JST_COLOR *src = first->pixels + (size_t)y * first->alignedWidth;
+        JST_COLOR *dst = second->pixels + (size_t)y * second->alignedWidth;
+        for (int x = 0; x < first->width; ++x) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            dst[x] = src[x];
+            if (y > first->height / 3 && y < first->height / 3 + bandHeight) {
+                dst[x].theColor = state | 0xFF000000u;
+            } else if ((state & 0xFF) < 8) {
+                dst[x].green ^= 0x03;
+            }
+        }
+    }
+}
+
+int main() {
+    int iterations = JSTBenchmarkIterations(5);
+
+    const int width = 1290, height = 2796;
+    const JST_PIXEL_MATCH_KERNEL kernels[] = {
+        JST_PIXEL_MATCH_KERNEL_SCALAR,
+        JST_PIXEL_MATCH_KERNEL_SSE2,
+        JST_PIXEL_MATCH_KERNEL_AVX2,
+        JST_PIXEL_MATCH_KERNEL_NEON,
+    };
+    size_t pixelsCount = (size_t)width * height;
+
+    JST_IMAGE *image1 = JSTCreatePixelImage(width, height);
+    JST_IMAGE *image2 = JSTCreatePixelImage(width, height);
+    JST_IMAGE *output = JSTCreatePixelImage(width, height);
+
+    /* smooth content is more representative than noise, where almost every
+     * pixel of the changed band would need the anti-aliasing check */
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            JST_COLOR &color = image1->pixels[(size_t)y * width + x];
+            color.red = (uint8_t)(x * 255 / width);
+            color.green = (uint8_t)(y * 255 / height);
+            color.blue = (uint8_t)((x ^ y) & 0xFF);
+            color.alpha = 0xFF;
+        }
+    }
+
+    const int bandHeights[] = { 0, 24 };
+    const double thresholds[] = { 0.1, 0.0 };
+    const JST_BOOL diffMasks[] = { false, true };
+    for (int bandHeight : bandHeights) {
+        JSTBenchmarkFillSecondPixelImage(image1, image2, bandHeight);
+        for (double threshold : thresholds) {
+            for (JST_BOOL diffMask : diffMasks) {
+                JST_PIXEL_MATCH_OPTIONS options;
+                JSTPixelMatchOptionsInit(&options);
+                options.threshold = threshold;
+                options.diffMask = diffMask;
+
+                char name[96];
+                for (JST_PIXEL_MATCH_KERNEL kernel : kernels) {
+                    if (!JSTPixelMatchKernelIsSupported(kernel)) {
+                        continue;
+                    }
+                    snprintf(name, sizeof(name), "%s/band %d/threshold %.1f/diff mask %d", JSTPixelMatchKernelGetName(kernel), bandHeight, threshold, diffMask);
+                    JSTBenchmark(name, pixelsCount, iterations, [&] {
+                        long long diff = JSTPixelMatchPixelImages(image1, image2, output, 0, height, &options, kernel);
+                        JSTBenchmarkKeep(diff);
+                    });
+                }
+
+                /* tiles stolen by as many workers as there are cores */
+                int threadCount = (int)std::max(std::thread::hardware_concurrency(), 1u);
+                snprintf(name, sizeof(name), "job %d threads/band %d/threshold %.1f/diff mask %d", threadCount, bandHeight, threshold, diffMask);
+                JSTBenchmark(name, pixelsCount, iterations, [&] {
+                    JST_PIXEL_MATCH_JOB *job = JSTPixelMatchJobCreate(image1, image2, output, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, 0);
+                    JSTPixelMatchJobPerformConcurrently(job, threadCount);
+                    long long diff = JSTPixelMatchJobGetDiffCount(job);
+                    JSTBenchmarkKeep(diff);
+                    JSTPixelMatchJobFree(job);
+                });
+            }
+        }
+    }
+
+    JSTFreePixelImage(image1);
+    JSTFreePixelImage(image2);
+    JSTFreePixelImage(output);
+    return 0;
+}
@@ -0,0 +1,155 @@
+#ifndef JSTPixelBlit_Private_h
+#define JSTPixelBlit_Private_h
+
+#include "JSTPixelBlit.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__SSE2__)
+#define JST_BLIT_HAS_SSE2 1
+#if defined(__GNUC__) || defined(__clang__)
+#define JST_BLIT_HAS_AVX2 1
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define JST_BLIT_HAS_NEON 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define JST_BLIT_INLINE inline __attribute__((always_inline))
+#else
+#define JST_BLIT_INLINE inline
+#endif
+
+
+/* Edge length of a cache tile, in pixels. A 64x64 tile of source rows plus
+ * the matching destination rows fits comfortably into L1. Must be a multiple
+ * of every block size. */
+static const int kBlitTileSize = 64;
+
+/* Each block type transposes an N x N square: row i is read from
+ * src + i * srcStep, and column k of the source is written to
+ * dst + k * dstStep. Negative steps walk upwards, which is how the 90 and
+ * 270 degree rotations are expressed with a single transpose. It also
+ * reverses N consecutive pixels, which is all the 180 degree rotation needs.
+ *
+ * The drivers below are templates over the block type, so that every kernel
+ * gets its own fully inlined copy of the loops. Kernels which need extra
+ * instruction sets live in their own translation unit, which includes this
+ * header after switching the compiler to that instruction set. */
+
+
+/* MARK: - Drivers */
+
+/* Orientation 1 reads dst(x, y) from src(W - 1 - y, x),
+ * orientation 2 reads dst(x, y) from src(y, H - 1 - x). */
+template <typename Block>
+static JST_BLIT_INLINE void JSTBlitRotateTiled(const JST_IMAGE *pixelImage, JST_COLOR *dst, ptrdiff_t dstStride)
+{
+    const int N = Block::N;
+    const int W = pixelImage->width;
+    const int H = pixelImage->height;
+    const ptrdiff_t srcStride = pixelImage->alignedWidth;
+    const JST_COLOR *src = pixelImage->pixels;
+    const bool isLeft = pixelImage->orientation == 1;
+
+    /* Oriented size */
+    const int dstWidth = H;
+    const int dstHeight = W;
+
+    for (int ty = 0; ty < dstHeight; ty += kBlitTileSize) {
+        const int yEnd = std::min(ty + kBlitTileSize, dstHeight);
+        for (int tx = 0; tx < dstWidth; tx += kBlitTileSize) {
+            const int xEnd = std::min(tx + kBlitTileSize, dstWidth);
+            for (int y0 = ty; y0 < yEnd; y0 += N) {
+                for (int x0 = tx; x0 < xEnd; x0 += N) {
+                    if (y0 + N <= yEnd && x0 + N <= xEnd) {
+                        if (isLeft) {
+                            Block::transpose(src + x0 * srcStride + (W - y0 - N), srcStride,
+                                             dst + (y0 + N - 1) * dstStride + x0, -dstStride);
+                        } else {
+                            Block::transpose(src + (H - x0 - 1) * srcStride + y0, -srcStride,
+                                             dst + y0 * dstStride + x0, dstStride);
+                        }
+                        continue;
+                    }
+
+                    /* Partial block on the right or bottom edge */
+                    const int yLast = std::min(y0 + N, yEnd);
+                    const int xLast = std::min(x0 + N, xEnd);
+                    for (int y = y0; y < yLast; ++y) {
+                        for (int x = x0; x < xLast; ++x) {
+                            dst[y * dstStride + x] = isLeft
+                                ? src[x * srcStride + (W - 1 - y)]
+                                : src[(H - 1 - x) * srcStride + y];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* Orientation 3 reads dst(x, y) from src(W - 1 - x, H - 1 - y). */
+template <typename Block>
+static JST_BLIT_INLINE void JSTBlitReverse(const JST_IMAGE *pixelImage, JST_COLOR *dst, ptrdiff_t dstStride)
+{
+    const int N = Block::N;
+    const int W = pixelImage->width;
+    const int H = pixelImage->height;
+    for (int y = 0; y < H; ++y) {
+        const JST_COLOR *srcRow = pixelImage->pixels + (ptrdiff_t)(H - 1 - y) * pixelImage->alignedWidth;
+        JST_COLOR *dstRow = dst + y * dstStride;
+        int x = 0;
+        for (; x + N <= W; x += N) {
+            Block::reverse(srcRow + (W - x - N), dstRow + x);
+        }
+        for (; x < W; ++x) {
+            dstRow[x] = srcRow[W - 1 - x];
+        }
+    }
+}
+
+static inline void JSTBlitCopyRows(const JST_IMAGE *pixelImage, JST_COLOR *dst, ptrdiff_t dstStride)
+{
+    const size_t rowLength = (size_t)pixelImage->width * sizeof(JST_COLOR);
+    if (dstStride == pixelImage->alignedWidth) {
+        memcpy(dst, pixelImage->pixels, rowLength + (size_t)(pixelImage->height - 1) * dstStride * sizeof(JST_COLOR));
+        return;
+    }
+    const JST_COLOR *srcRow = pixelImage->pixels;
+    for (int y = 0; y < pixelImage->height; ++y) {
+        memcpy(dst, srcRow, rowLength);
+        srcRow += pixelImage->alignedWidth;
+        dst += dstStride;
+    }
+}
+
+template <typename Block>
+static JST_BLIT_INLINE void JSTBlitOriented(const JST_IMAGE *pixelImage, JST_COLOR *dst, ptrdiff_t dstStride)
+{
+    switch (pixelImage->orientation) {
+    case 1:
+    case 2:
+        JSTBlitRotateTiled<Block>(pixelImage, dst, dstStride);
+        break;
+    case 3:
+        JSTBlitReverse<Block>(pixelImage, dst, dstStride);
+        break;
+    default:
+        JSTBlitCopyRows(pixelImage, dst, dstStride);
+        break;
+    }
+}
+
+
+/* MARK: - Kernels */
+
+#if JST_BLIT_HAS_AVX2
+void JSTBlitOrientedAVX2(const JST_IMAGE *pixelImage, JST_COLOR *dst, ptrdiff_t dstStride);
+#endif
+
+#endif /* JSTPixelBlit_Private_h */
@@ -0,0 +1,206 @@
+#include "JSTPixelBlit+Private.h"
+
+#if JST_BLIT_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if JST_BLIT_HAS_NEON
+#include <arm_neon.h>
+#endif
+
+
+/* MARK: - Blocks */
+
+struct JSTBlitBlockScalar {
+    static const int N = 4;
+
+    static JST_BLIT_INLINE void transpose(const JST_COLOR *src, ptrdiff_t srcStep, JST_COLOR *dst, ptrdiff_t dstStep) {
+        for (int k = 0; k < N; ++k) {
+            for (int i = 0; i < N; ++i) {
+                dst[k * dstStep + i] = src[i * srcStep + k];
+            }
+        }
+    }
+
+    static JST_BLIT_INLINE void reverse(const JST_COLOR *src, JST_COLOR *dst) {
+        for (int i = 0; i < N; ++i) {
+            dst[i] = src[N - 1 - i];
+        }
+    }
+};
+
+#if JST_BLIT_HAS_SSE2
+struct JSTBlitBlockSSE2 {
+    static const int N = 4;
+
+    static JST_BLIT_INLINE void transpose(const JST_COLOR *src, ptrdiff_t srcStep, JST_COLOR *dst, ptrdiff_t dstStep) {
+        __m128i r0 = _mm_loadu_si128((const __m128i *)(src));
+        __m128i r1 = _mm_loadu_si128((const __m128i *)(src + srcStep));
+        __m128i r2 = _mm_loadu_si128((const __m128i *)(src + srcStep * 2));
+        __m128i r3 = _mm_loadu_si128((const __m128i *)(src + srcStep * 3));
+
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+        __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+        __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+        _mm_storeu_si128((__m128i *)(dst), _mm_unpacklo_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *)(dst + dstStep), _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *)(dst + dstStep * 2), _mm_unpacklo_epi64(t2, t3));
+        _mm_storeu_si128((__m128i *)(dst + dstStep * 3), _mm_unpackhi_epi64(t2, t3));
+    }
+
+    static JST_BLIT_INLINE void reverse(const JST_COLOR *src, JST_COLOR *dst) {
+        __m128i r = _mm_loadu_si128((const __m128i *)src);
+        _mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi32(r, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+};
+#endif
+
+#if JST_BLIT_HAS_NEON
+struct JSTBlitBlockNEON {
+    static const int N = 4;
+
+    static JST_BLIT_INLINE void transpose(const JST_COLOR *src, ptrdiff_t srcStep, JST_COLOR *dst, ptrdiff_t dstStep) {
+        uint32x4_t r0 = vld1q_u32((const uint32_t *)(src));
+        uint32x4_t r1 = vld1q_u32((const uint32_t *)(src + srcStep));
+        uint32x4_t r2 = vld1q_u32((const uint32_t *)(src + srcStep * 2));
+        uint32x4_t r3 = vld1q_u32((const uint32_t *)(src + srcStep * 3));
+
+        uint32x4x2_t t0 = vtrnq_u32(r0, r1);
+        uint32x4x2_t t1 = vtrnq_u32(r2, r3);
+
+        vst1q_u32((uint32_t *)(dst), vcombine_u32(vget_low_u32(t0.val[0]), vget_low_u32(t1.val[0])));
+        vst1q_u32((uint32_t *)(dst + dstStep), vcombine_u32(vget_low_u32(t0.val[1]), vget_low_u32(t1.val[1])));
+        vst1q_u32((uint32_t *)(dst + dstStep * 2), vcombine_u32(vget_high_u32(t0.val[0]), vget_high_u32(t1.val[0])));
+        vst1q_u32((uint32_t *)(dst + dstStep * 3), vcombine_u32(vget_high_u32(t0.val[1]), vget_high_u32(t1.val[1])));
+    }
+
+    static JST_BLIT_INLINE void reverse(const JST_COLOR *src, JST_COLOR *dst) {
+        uint32x4_t r = vrev64q_u32(vld1q_u32((const uint32_t *)src));
+        vst1q_u32((uint32_t *)dst, vextq_u32(r, r, 2));
+    }
+};
+#endif
+
+
+/* MARK: - Kernels */
+
+static void JSTBlitOrientedScalar(const JST_IMAGE *pixelImage, JST_COLOR *dst, ptrdiff_t dstStride)
+{
+    JSTBlitOriented<JSTBlitBlockScalar>(pixelImage, dst, dstStride);
+}
+
+#if JST_BLIT_HAS_SSE2
+static void JSTBlitOrientedSSE2(const JST_IMAGE *pixelImage, JST_COLOR *dst, ptrdiff_t dstStride)
+{
+    JSTBlitOriented<JSTBlitBlockSSE2>(pixelImage, dst, dstStride);
+}
+#endif
+
+#if JST_BLIT_HAS_NEON
+static void JSTBlitOrientedNEON(const JST_IMAGE *pixelImage, JST_COLOR *dst, ptrdiff_t dstStride)
+{
+    JSTBlitOriented<JSTBlitBlockNEON>(pixelImage, dst, dstStride);
+}
+#endif
+
+
+/* MARK: - Dispatch */
+
+static JST_BLIT_KERNEL JSTBlitKernelResolve(JST_BLIT_KERNEL kernel)
+{
+    if (kernel != JST_BLIT_KERNEL_AUTOMATIC) {
+        return kernel;
+    }
+#if JST_BLIT_HAS_NEON
+    return JST_BLIT_KERNEL_NEON;
+#else
+    static const JST_BLIT_KERNEL bestKernel = JSTBlitKernelIsSupported(JST_BLIT_KERNEL_AVX2)
+        ? JST_BLIT_KERNEL_AVX2
+        : (JSTBlitKernelIsSupported(JST_BLIT_KERNEL_SSE2) ? JST_BLIT_KERNEL_SSE2 : JST_BLIT_KERNEL_SCALAR);
+    return bestKernel;
+#endif
+}
+
+JST_BOOL JSTBlitKernelIsSupported(JST_BLIT_KERNEL kernel)
+{
+    switch (kernel) {
+    case JST_BLIT_KERNEL_AUTOMATIC:
+    case JST_BLIT_KERNEL_SCALAR:
+        return true;
+    case JST_BLIT_KERNEL_SSE2:
+#if JST_BLIT_HAS_SSE2
+        return true;
+#else
+        return false;
+#endif
+    case JST_BLIT_KERNEL_AVX2:
+#if JST_BLIT_HAS_AVX2
+        return __builtin_cpu_supports("avx2") ? true : false;
+#else
+        return false;
+#endif
+    case JST_BLIT_KERNEL_NEON:
+#if JST_BLIT_HAS_NEON
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char *JSTBlitKernelGetName(JST_BLIT_KERNEL kernel)
+{
+    switch (JSTBlitKernelResolve(kernel)) {
+    case JST_BLIT_KERNEL_SCALAR:
+        return "scalar";
+    case JST_BLIT_KERNEL_SSE2:
+        return "sse2";
+    case JST_BLIT_KERNEL_AVX2:
+        return "avx2";
+    case JST_BLIT_KERNEL_NEON:
+        return "neon";
+    default:
+        return "unknown";
+    }
+}
+
+JST_BOOL JSTBlitOrientedPixelsOfPixelImage(const JST_IMAGE *pixelImage, JST_COLOR *buffer, int bufferAlignedWidth, JST_BLIT_KERNEL kernel)
+{
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
+    if (bufferAlignedWidth < width) {
+        return false;
+    }
+    if (width == 0 || height == 0) {
+        return true;
+    }
+
+    kernel = JSTBlitKernelResolve(kernel);
+    if (!JSTBlitKernelIsSupported(kernel)) {
+        return false;
+    }
+
+    switch (kernel) {
+#if JST_BLIT_HAS_SSE2
+    case JST_BLIT_KERNEL_SSE2:
+        JSTBlitOrientedSSE2(pixelImage, buffer, bufferAlignedWidth);
+        return true;
+#endif
+#if JST_BLIT_HAS_AVX2
+    case JST_BLIT_KERNEL_AVX2:
+        JSTBlitOrientedAVX2(pixelImage, buffer, bufferAlignedWidth);
+        return true;
+#endif
+#if JST_BLIT_HAS_NEON
+    case JST_BLIT_KERNEL_NEON:
+        JSTBlitOrientedNEON(pixelImage, buffer, bufferAlignedWidth);
+        return true;
+#endif
+    default:
+        JSTBlitOrientedScalar(pixelImage, buffer, bufferAlignedWidth);
+        return true;
+    }
+}
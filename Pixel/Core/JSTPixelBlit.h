@@ -0,0 +1,30 @@
+#ifndef JSTPixelBlit_h
+#define JSTPixelBlit_h
+
+#include "JSTPixelCore.h"
+
+/* Orientation blit: writes the upright pixels of an image into a packed or
+ * padded destination buffer. Rotations are done with cache-blocked transpose
+ * kernels, padded images without rotation are copied row by row. */
+
+typedef enum JST_BLIT_KERNEL {
+    JST_BLIT_KERNEL_AUTOMATIC = 0,
+    JST_BLIT_KERNEL_SCALAR,
+    JST_BLIT_KERNEL_SSE2,
+    JST_BLIT_KERNEL_AVX2,
+    JST_BLIT_KERNEL_NEON,
+} JST_BLIT_KERNEL;
+
+/* Whether the kernel can run on this machine. Automatic and scalar kernels
+ * are always supported. */
+JST_EXTERN JST_BOOL JSTBlitKernelIsSupported(JST_BLIT_KERNEL kernel);
+
+/* Name of the kernel the automatic selection resolves to. */
+JST_EXTERN const char *JSTBlitKernelGetName(JST_BLIT_KERNEL kernel);
+
+/* Writes the oriented pixels of the image into buffer, whose rows are
+ * bufferAlignedWidth colors apart (at least the oriented width).
+ * Returns false if the kernel is not supported on this machine. */
+JST_EXTERN JST_BOOL JSTBlitOrientedPixelsOfPixelImage(const JST_IMAGE *pixelImage, JST_COLOR *buffer, int bufferAlignedWidth, JST_BLIT_KERNEL kernel);
+
+#endif /* JSTPixelBlit_h */
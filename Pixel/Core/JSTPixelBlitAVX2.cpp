@@ -0,0 +1,80 @@
+#include "JSTPixelBlit.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+
+#include <immintrin.h>
+
+/* Everything below, including the driver templates from the private header,
+ * is compiled for AVX2. It is only called after a runtime CPU check. */
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "JSTPixelBlit+Private.h"
+
+struct JSTBlitBlockAVX2 {
+    static const int N = 8;
+
+    static JST_BLIT_INLINE void transpose(const JST_COLOR *src, ptrdiff_t srcStep, JST_COLOR *dst, ptrdiff_t dstStep) {
+        __m256i r0 = _mm256_loadu_si256((const __m256i *)(src));
+        __m256i r1 = _mm256_loadu_si256((const __m256i *)(src + srcStep));
+        __m256i r2 = _mm256_loadu_si256((const __m256i *)(src + srcStep * 2));
+        __m256i r3 = _mm256_loadu_si256((const __m256i *)(src + srcStep * 3));
+        __m256i r4 = _mm256_loadu_si256((const __m256i *)(src + srcStep * 4));
+        __m256i r5 = _mm256_loadu_si256((const __m256i *)(src + srcStep * 5));
+        __m256i r6 = _mm256_loadu_si256((const __m256i *)(src + srcStep * 6));
+        __m256i r7 = _mm256_loadu_si256((const __m256i *)(src + srcStep * 7));
+
+        __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+        __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+        __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+        __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+        __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+        __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+        __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+        __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+        __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+        __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+        __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+        __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+        __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+        __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+        __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+        __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+        _mm256_storeu_si256((__m256i *)(dst), _mm256_permute2x128_si256(u0, u4, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + dstStep), _mm256_permute2x128_si256(u1, u5, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + dstStep * 2), _mm256_permute2x128_si256(u2, u6, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + dstStep * 3), _mm256_permute2x128_si256(u3, u7, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + dstStep * 4), _mm256_permute2x128_si256(u0, u4, 0x31));
+        _mm256_storeu_si256((__m256i *)(dst + dstStep * 5), _mm256_permute2x128_si256(u1, u5, 0x31));
+        _mm256_storeu_si256((__m256i *)(dst + dstStep * 6), _mm256_permute2x128_si256(u2, u6, 0x31));
+        _mm256_storeu_si256((__m256i *)(dst + dstStep * 7), _mm256_permute2x128_si256(u3, u7, 0x31));
+    }
+
+    static JST_BLIT_INLINE void reverse(const JST_COLOR *src, JST_COLOR *dst) {
+        __m256i r = _mm256_loadu_si256((const __m256i *)src);
+        _mm256_storeu_si256((__m256i *)dst, _mm256_permutevar8x32_epi32(r, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)));
+    }
+};
+
+void JSTBlitOrientedAVX2(const JST_IMAGE *pixelImage, JST_COLOR *dst, ptrdiff_t dstStride)
+{
+    JSTBlitOriented<JSTBlitBlockAVX2>(pixelImage, dst, dstStride);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif /* __SSE2__ */
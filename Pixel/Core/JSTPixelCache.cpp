@@ -0,0 +1,272 @@
+#include "JSTPixelCache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* MARK: - Hash */
+
+static const uint64_t kHashPrime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t kHashPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t kHashPrime3 = 0x165667B19E3779F9ULL;
+static const uint64_t kHashPrime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t kHashPrime5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t JSTHashRotate(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t JSTHashRead64(const uint8_t *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t JSTHashRead32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t JSTHashRound(uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * kHashPrime2;
+    accumulator = JSTHashRotate(accumulator, 31);
+    return accumulator * kHashPrime1;
+}
+
+static inline uint64_t JSTHashMergeRound(uint64_t accumulator, uint64_t value)
+{
+    accumulator ^= JSTHashRound(0, value);
+    return accumulator * kHashPrime1 + kHashPrime4;
+}
+
+uint64_t JSTPixelCacheHashBytes(const void *bytes, size_t length)
+{
+    /* Little endian XXH64, every host we build for is little endian */
+    const uint8_t *p = (const uint8_t *)bytes;
+    const uint8_t *end = p + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        uint64_t v1 = kHashPrime1 + kHashPrime2;
+        uint64_t v2 = kHashPrime2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - kHashPrime1;
+        const uint8_t *limit = end - 32;
+        do {
+            v1 = JSTHashRound(v1, JSTHashRead64(p));
+            v2 = JSTHashRound(v2, JSTHashRead64(p + 8));
+            v3 = JSTHashRound(v3, JSTHashRead64(p + 16));
+            v4 = JSTHashRound(v4, JSTHashRead64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        hash = JSTHashRotate(v1, 1) + JSTHashRotate(v2, 7) + JSTHashRotate(v3, 12) + JSTHashRotate(v4, 18);
+        hash = JSTHashMergeRound(hash, v1);
+        hash = JSTHashMergeRound(hash, v2);
+        hash = JSTHashMergeRound(hash, v3);
+        hash = JSTHashMergeRound(hash, v4);
+    } else {
+        hash = kHashPrime5;
+    }
+
+    hash += (uint64_t)length;
+    while (p + 8 <= end) {
+        hash ^= JSTHashRound(0, JSTHashRead64(p));
+        hash = JSTHashRotate(hash, 27) * kHashPrime1 + kHashPrime4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        hash ^= (uint64_t)JSTHashRead32(p) * kHashPrime1;
+        hash = JSTHashRotate(hash, 23) * kHashPrime2 + kHashPrime3;
+        p += 4;
+    }
+    while (p < end) {
+        hash ^= (uint64_t)(*p) * kHashPrime5;
+        hash = JSTHashRotate(hash, 11) * kHashPrime1;
+        ++p;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kHashPrime2;
+    hash ^= hash >> 29;
+    hash *= kHashPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+
+/* MARK: - Write */
+
+static uint64_t JSTPixelCacheAlign(uint64_t offset)
+{
+    return (offset + JST_PIXEL_CACHE_ALIGNMENT - 1) / JST_PIXEL_CACHE_ALIGNMENT * JST_PIXEL_CACHE_ALIGNMENT;
+}
+
+static bool JSTPixelCacheWriteAll(int fd, const void *bytes, size_t length)
+{
+    const uint8_t *p = (const uint8_t *)bytes;
+    while (length > 0) {
+        ssize_t written = write(fd, p, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+JST_BOOL JSTPixelCacheWriteFile(const char *path, const JST_IMAGE *pixelImage, uint64_t contentHash, const void *colorSpaceData, size_t colorSpaceLength)
+{
+    if (!colorSpaceData) {
+        colorSpaceLength = 0;
+    }
+
+    JST_PIXEL_CACHE_HEADER header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, JST_PIXEL_CACHE_MAGIC, sizeof(JST_PIXEL_CACHE_MAGIC));
+    header.version = JST_PIXEL_CACHE_VERSION;
+    header.byteOrder = JST_PIXEL_CACHE_BYTE_ORDER;
+    header.contentHash = contentHash;
+    header.width = pixelImage->width;
+    header.height = pixelImage->height;
+    header.orientation = pixelImage->orientation;
+    header.colorSpaceOffset = colorSpaceLength > 0 ? sizeof(header) : 0;
+    header.colorSpaceLength = colorSpaceLength;
+    header.pixelsOffset = JSTPixelCacheAlign(sizeof(header) + colorSpaceLength);
+    header.pixelsLength = (uint64_t)pixelImage->width * (uint64_t)pixelImage->height * sizeof(JST_COLOR);
+
+    std::string temporaryPath = std::string(path) + ".XXXXXX";
+    int fd = mkstemp(&temporaryPath[0]);
+    if (fd < 0) {
+        return false;
+    }
+
+    bool succeed = JSTPixelCacheWriteAll(fd, &header, sizeof(header));
+    if (succeed && colorSpaceLength > 0) {
+        succeed = JSTPixelCacheWriteAll(fd, colorSpaceData, colorSpaceLength);
+    }
+    if (succeed) {
+        succeed = lseek(fd, (off_t)header.pixelsOffset, SEEK_SET) == (off_t)header.pixelsOffset;
+    }
+
+    /* Rows of the image may be padded, the cache is always packed */
+    size_t rowLength = (size_t)pixelImage->width * sizeof(JST_COLOR);
+    for (int y = 0; succeed && rowLength > 0 && y < pixelImage->height; ++y) {
+        succeed = JSTPixelCacheWriteAll(fd, pixelImage->pixels + (size_t)y * pixelImage->alignedWidth, rowLength);
+    }
+    if (succeed) {
+        succeed = ftruncate(fd, (off_t)(header.pixelsOffset + header.pixelsLength)) == 0;
+    }
+
+    succeed = close(fd) == 0 && succeed;
+    if (succeed) {
+        succeed = rename(temporaryPath.c_str(), path) == 0;
+    }
+    if (!succeed) {
+        unlink(temporaryPath.c_str());
+    }
+    return succeed;
+}
+
+
+/* MARK: - Read */
+
+static void JSTPixelCacheUnmap(void *bytes, size_t length, void *context)
+{
+    (void)context;
+    munmap(bytes, length);
+}
+
+static bool JSTPixelCacheValidateHeader(const JST_PIXEL_CACHE_HEADER *header, uint64_t fileLength, uint64_t contentHash)
+{
+    if (memcmp(header->magic, JST_PIXEL_CACHE_MAGIC, sizeof(JST_PIXEL_CACHE_MAGIC)) != 0 ||
+        header->version != JST_PIXEL_CACHE_VERSION ||
+        header->byteOrder != JST_PIXEL_CACHE_BYTE_ORDER ||
+        header->contentHash != contentHash)
+    {
+        return false;
+    }
+    if (header->width < 0 || header->height < 0 || header->orientation < 0 || header->orientation > 3) {
+        return false;
+    }
+    if (header->pixelsLength != (uint64_t)header->width * (uint64_t)header->height * sizeof(JST_COLOR) ||
+        header->pixelsOffset % JST_PIXEL_CACHE_ALIGNMENT != 0 ||
+        header->pixelsOffset > fileLength ||
+        header->pixelsLength > fileLength - header->pixelsOffset)
+    {
+        return false;
+    }
+    if (header->colorSpaceLength > 0 &&
+        (header->colorSpaceOffset < sizeof(JST_PIXEL_CACHE_HEADER) ||
+         header->colorSpaceOffset > header->pixelsOffset ||
+         header->colorSpaceLength > header->pixelsOffset - header->colorSpaceOffset))
+    {
+        return false;
+    }
+    return true;
+}
+
+JST_IMAGE *JSTPixelCacheCreatePixelImageWithFile(const char *path, uint64_t contentHash, const void **colorSpaceData, size_t *colorSpaceLength)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t)sizeof(JST_PIXEL_CACHE_HEADER)) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t fileLength = (size_t)fileStat.st_size;
+    void *mapping = mmap(NULL, fileLength, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+
+    const JST_PIXEL_CACHE_HEADER *header = (const JST_PIXEL_CACHE_HEADER *)mapping;
+    if (!JSTPixelCacheValidateHeader(header, fileLength, contentHash)) {
+        munmap(mapping, fileLength);
+        return NULL;
+    }
+
+    JST_PIXEL_STORAGE *storage = JSTPixelStorageCreateReadOnly(mapping, fileLength, JSTPixelCacheUnmap, NULL);
+    if (!storage) {
+        munmap(mapping, fileLength);
+        return NULL;
+    }
+
+    JST_COLOR *pixels = (JST_COLOR *)((uint8_t *)mapping + header->pixelsOffset);
+    JST_IMAGE *newPixelImage = JSTCreatePixelImageWithPixels(pixels, header->width, header->width, header->height, false);
+    if (!newPixelImage) {
+        JSTPixelStorageRelease(storage);
+        return NULL;
+    }
+    newPixelImage->storage = storage;
+    newPixelImage->orientation = (JST_ORIENTATION)header->orientation;
+
+    if (colorSpaceData && colorSpaceLength) {
+        *colorSpaceData = header->colorSpaceLength > 0 ? (const uint8_t *)mapping + header->colorSpaceOffset : NULL;
+        *colorSpaceLength = (size_t)header->colorSpaceLength;
+    }
+    return newPixelImage;
+}
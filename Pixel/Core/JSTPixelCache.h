@@ -0,0 +1,58 @@
+#ifndef JSTPixelCache_h
+#define JSTPixelCache_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "JSTPixelStorage.h"
+
+/* On-disk cache of decoded pixels, so that reopening a screenshot maps its
+ * pixels instead of decoding it again.
+ *
+ * A cache file starts with a JST_PIXEL_CACHE_HEADER in host byte order,
+ * followed by an optional color space blob (an ICC profile on Apple
+ * platforms, opaque to the core) and the packed BGRA pixels at a page
+ * aligned offset. Files are keyed by the hash of the encoded image they
+ * were decoded from, a file whose version, byte order, hash or layout does
+ * not match is rejected and should simply be rewritten. */
+
+#define JST_PIXEL_CACHE_MAGIC "JSTPXCH"
+#define JST_PIXEL_CACHE_VERSION 1
+#define JST_PIXEL_CACHE_BYTE_ORDER 0x01020304u
+
+/* Pixels start at a multiple of the largest page size we run on (16K on
+ * Apple silicon), so that they can be mapped on their own. */
+#define JST_PIXEL_CACHE_ALIGNMENT 16384
+
+typedef struct JST_PIXEL_CACHE_HEADER {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t contentHash;
+    int32_t width;
+    int32_t height;
+    int32_t orientation;
+    uint32_t reserved;
+    uint64_t colorSpaceOffset;
+    uint64_t colorSpaceLength;
+    uint64_t pixelsOffset;
+    uint64_t pixelsLength;
+} JST_PIXEL_CACHE_HEADER;
+
+/* XXH64 of the bytes with seed 0, used as the content hash. */
+JST_EXTERN uint64_t JSTPixelCacheHashBytes(const void *bytes, size_t length);
+
+/* Writes the oriented-as-stored pixels of the image, packed, and the color
+ * space blob into a temporary file beside path, then renames it over path
+ * so that readers never see a partial file.
+ * Returns false on any I/O error. */
+JST_EXTERN JST_BOOL JSTPixelCacheWriteFile(const char *path, const JST_IMAGE *pixelImage, uint64_t contentHash, const void *colorSpaceData, size_t colorSpaceLength);
+
+/* Maps the cache file read-only and returns an image whose storage is the
+ * mapping, it is unmapped when the last image sharing it is freed. Writes
+ * copy the pixels first, the file is never modified.
+ * If colorSpaceData is not NULL, it receives a pointer into the mapping,
+ * valid as long as the image, or NULL if there is no blob.
+ * Returns NULL if the file is missing, invalid, or of another content. */
+JST_EXTERN JST_IMAGE *JSTPixelCacheCreatePixelImageWithFile(const char *path, uint64_t contentHash, const void **colorSpaceData, size_t *colorSpaceLength);
+
+#endif /* JSTPixelCache_h */
@@ -0,0 +1,237 @@
+#include "JSTPixelCore.h"
+#include "JSTPixelBlit.h"
+#include "JSTPixelStorage+Private.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+
+/* MARK: - Lifecycle */
+
+JST_IMAGE *JSTCreatePixelImage(int width, int height)
+{
+    if (width < 0 || height < 0) {
+        return NULL;
+    }
+
+    /* New pixel image is not aligned, empty images still own a valid buffer */
+    size_t pixelsCount = std::max((size_t)width * (size_t)height, (size_t)1);
+    JST_COLOR *pixels = (JST_COLOR *)calloc(pixelsCount, sizeof(JST_COLOR));
+    if (!pixels) {
+        return NULL;
+    }
+
+    JST_IMAGE *newPixelImage = JSTCreatePixelImageWithPixels(pixels, width, width, height, true);
+    if (!newPixelImage) {
+        free(pixels);
+        return NULL;
+    }
+
+    /* Attached up front, so that sharing a new image never has to mutate it */
+    newPixelImage->storage = JSTPixelStorageCreate(pixels, pixelsCount * sizeof(JST_COLOR), NULL, NULL);
+    if (!newPixelImage->storage) {
+        JSTFreePixelImage(newPixelImage);
+        return NULL;
+    }
+    return newPixelImage;
+}
+
+JST_IMAGE *JSTCreatePixelImageWithPixels(JST_COLOR *pixels, int width, int alignedWidth, int height, JST_BOOL freeWhenDone)
+{
+    if (!pixels || width < 0 || height < 0 || alignedWidth < width) {
+        return NULL;
+    }
+
+    JST_IMAGE *newPixelImage = (JST_IMAGE *)calloc(1, sizeof(JST_IMAGE));
+    if (!newPixelImage) {
+        return NULL;
+    }
+    newPixelImage->width = width;
+    newPixelImage->alignedWidth = alignedWidth;
+    newPixelImage->height = height;
+    newPixelImage->pixels = pixels;
+
+    /* Borrowed buffers are marked as destroyed so that they are never freed by us */
+    newPixelImage->isDestroyed = freeWhenDone ? false : true;
+    return newPixelImage;
+}
+
+JST_IMAGE *JSTCreatePixelImageWithPixelImageInRect(const JST_IMAGE *pixelImage, JST_ORIENTATION orientation, int x1, int y1, int x2, int y2)
+{
+    x1 = std::max(x1, 0);
+    y1 = std::max(y1, 0);
+    x2 = std::min(x2, pixelImage->width);
+    y2 = std::min(y2, pixelImage->height);
+
+    int newWidth = std::max(x2 - x1, 0);
+    int newHeight = std::max(y2 - y1, 0);
+    JST_IMAGE *newPixelImage = JSTCreatePixelImage(newWidth, newHeight);
+    if (!newPixelImage) {
+        return NULL;
+    }
+
+    GET_ROTATE_ROTATE3(pixelImage->orientation, orientation, newPixelImage->orientation);
+    if (newWidth == 0 || newHeight == 0) {
+        return newPixelImage;
+    }
+
+    const JST_COLOR *srcRow = pixelImage->pixels + (size_t)y1 * pixelImage->alignedWidth + x1;
+    JST_COLOR *dstRow = newPixelImage->pixels;
+    for (int y = 0; y < newHeight; ++y) {
+        memcpy(dstRow, srcRow, (size_t)newWidth * sizeof(JST_COLOR));
+        srcRow += pixelImage->alignedWidth;
+        dstRow += newWidth;
+    }
+    JSTPixelStorageRecordCopiedBytes((size_t)newWidth * (size_t)newHeight * sizeof(JST_COLOR));
+    return newPixelImage;
+}
+
+JST_IMAGE *JSTCreatePixelImageByCroppingPixelImage(const JST_IMAGE *pixelImage, int x, int y, int width, int height)
+{
+    int x1 = x;
+    int y1 = y;
+    int x2 = x + width;
+    int y2 = y + height;
+    SHIFT_RECT_BY_ORIEN(x1, y1, x2, y2, pixelImage->width, pixelImage->height, pixelImage->orientation);
+    return JSTCreatePixelImageWithPixelImageInRect(pixelImage, 0, x1, y1, x2, y2);
+}
+
+JST_IMAGE *JSTCopyPixelImage(const JST_IMAGE *pixelImage)
+{
+    /* Padded views end before the last row of their parent does */
+    if (pixelImage->storage && pixelImage->alignedWidth != pixelImage->width) {
+        return JSTCreatePixelImageWithPixelImageInRect(pixelImage, 0, 0, 0, pixelImage->width, pixelImage->height);
+    }
+
+    /* Copied pixel image has the same alignment with the original ones */
+    size_t pixelsSize = (size_t)pixelImage->alignedWidth * (size_t)pixelImage->height * sizeof(JST_COLOR);
+    JST_COLOR *pixels = (JST_COLOR *)malloc(pixelsSize);
+    if (!pixels) {
+        return NULL;
+    }
+    memcpy(pixels, pixelImage->pixels, pixelsSize);
+    JSTPixelStorageRecordCopiedBytes(pixelsSize);
+
+    JST_IMAGE *newPixelImage = JSTCreatePixelImageWithPixels(pixels, pixelImage->width, pixelImage->alignedWidth, pixelImage->height, true);
+    if (!newPixelImage) {
+        free(pixels);
+        return NULL;
+    }
+    newPixelImage->storage = JSTPixelStorageCreate(pixels, pixelsSize, NULL, NULL);
+    if (!newPixelImage->storage) {
+        JSTFreePixelImage(newPixelImage);
+        return NULL;
+    }
+    newPixelImage->orientation = pixelImage->orientation;
+    return newPixelImage;
+}
+
+void JSTFreePixelImage(JST_IMAGE *pixelImage)
+{
+    if (!pixelImage) {
+        return;
+    }
+    if (pixelImage->storage) {
+        JSTPixelStorageRelease(pixelImage->storage);
+        pixelImage->storage = NULL;
+    } else if (!pixelImage->isDestroyed) {
+        free(pixelImage->pixels);
+    }
+    pixelImage->isDestroyed = true;
+    free(pixelImage);
+}
+
+
+/* MARK: - Pixels */
+
+void JSTGetColorInPixelImageSafe(const JST_IMAGE *pixelImage, int x, int y, JST_COLOR *colorOfPoint)
+{
+    SHIFT_XY_BY_ORIEN(x, y, pixelImage->width, pixelImage->height, pixelImage->orientation);
+    if (x < 0 || y < 0 ||
+        x >= pixelImage->width ||
+        y >= pixelImage->height)
+    {
+        colorOfPoint->theColor = 0;
+        return;
+    }
+    colorOfPoint->theColor = pixelImage->pixels[(size_t)y * pixelImage->alignedWidth + x].theColor;
+}
+
+void JSTSetColorInPixelImageSafe(JST_IMAGE *pixelImage, int x, int y, const JST_COLOR *colorOfPoint)
+{
+    SHIFT_XY_BY_ORIEN(x, y, pixelImage->width, pixelImage->height, pixelImage->orientation);
+    if (x < 0 || y < 0 ||
+        x >= pixelImage->width ||
+        y >= pixelImage->height)
+    {
+        return;
+    }
+    if (!JSTPixelImageMakeUnique(pixelImage)) {
+        return;
+    }
+    pixelImage->pixels[(size_t)y * pixelImage->alignedWidth + x].theColor = colorOfPoint->theColor;
+}
+
+int JSTGetColorsInPixelImage(const JST_IMAGE *pixelImage, JST_POS *points, int count)
+{
+    int firstOutside = -1;
+    for (int i = 0; i < count; ++i) {
+        int x = points[i].x, y = points[i].y;
+        SHIFT_XY_BY_ORIEN(x, y, pixelImage->width, pixelImage->height, pixelImage->orientation);
+        if (x < 0 || y < 0 ||
+            x >= pixelImage->width ||
+            y >= pixelImage->height)
+        {
+            points[i].color.theColor = 0;
+            if (firstOutside < 0) {
+                firstOutside = i;
+            }
+            continue;
+        }
+        points[i].color.theColor = pixelImage->pixels[(size_t)y * pixelImage->alignedWidth + x].theColor;
+    }
+    return firstOutside;
+}
+
+JST_BOOL JSTGetRowInPixelImage(const JST_IMAGE *pixelImage, int y, JST_COLOR *row)
+{
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
+    if (y < 0 || y >= height) {
+        return false;
+    }
+    if (pixelImage->orientation == 0) {
+        memcpy(row, pixelImage->pixels + (size_t)y * pixelImage->alignedWidth, (size_t)width * sizeof(JST_COLOR));
+        return true;
+    }
+    /* a column of the buffer, or a row read backwards */
+    for (int x = 0; x < width; ++x) {
+        int sx = x, sy = y;
+        SHIFT_XY_BY_ORIEN(sx, sy, pixelImage->width, pixelImage->height, pixelImage->orientation);
+        row[x].theColor = pixelImage->pixels[(size_t)sy * pixelImage->alignedWidth + sx].theColor;
+    }
+    return true;
+}
+
+void JSTGetOrientedSizeOfPixelImage(const JST_IMAGE *pixelImage, int *width, int *height)
+{
+    switch (pixelImage->orientation) {
+    case 1:
+    case 2:
+        *width = pixelImage->height;
+        *height = pixelImage->width;
+        break;
+    default:
+        *width = pixelImage->width;
+        *height = pixelImage->height;
+        break;
+    }
+}
+
+void JSTCopyOrientedPixelsOfPixelImage(const JST_IMAGE *pixelImage, JST_COLOR *buffer)
+{
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
+    JSTBlitOrientedPixelsOfPixelImage(pixelImage, buffer, width, JST_BLIT_KERNEL_AUTOMATIC);
+}
@@ -0,0 +1,221 @@
+#ifndef JSTPixelCore_h
+#define JSTPixelCore_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "JST_BOOL.h"
+#include "JST_COLOR.h"
+#include "JST_IMAGE.h"
+#include "JST_ORIENTATION.h"
+#include "JST_POS.h"
+
+/* Portable pixel core shared by JSTPixelImage, the command line tools and
+ * the Linux test suite. Nothing in here may depend on CoreGraphics or any
+ * other Apple framework. */
+
+#ifdef __cplusplus
+#define JST_EXTERN extern "C"
+#else
+#define JST_EXTERN extern
+#endif
+
+/* MARK: - Orientation */
+
+#define SHIFT_XY_BY_ORIEN_NOM1(X, Y, W, H, O) \
+    { \
+        switch (O) { \
+            int Z; \
+        case 0: \
+            break; \
+        case 1: \
+            (Z) = (X); \
+            (X) = (W) -(Y); \
+            (Y) = (Z); \
+            break; \
+        case 2: \
+            (Z) = (Y); \
+            (Y) = (H) -(X); \
+            (X) = (Z); \
+            break; \
+        case 3: \
+            (X) = (W) -(X); \
+            (Y) = (H) -(Y); \
+            break; \
+        } \
+    }
+
+#define SHIFT_XY_BY_ORIEN(X, Y, W, H, O) SHIFT_XY_BY_ORIEN_NOM1((X), (Y), ((W)-1), ((H)-1), (O))
+
+#define UNSHIFT_XY_BY_ORIEN_NOM1(X, Y, W, H, O) \
+    { \
+        switch (O) { \
+            int Z; \
+        case 0: \
+            break; \
+        case 1: \
+            (Z) = (Y); \
+            (Y) = (W) -(X); \
+            (X) = (Z); \
+            break; \
+        case 2: \
+            (Z) = (X); \
+            (X) = (H) -(Y); \
+            (Y) = (Z); \
+            break; \
+        case 3: \
+            (X) = (W) -(X); \
+            (Y) = (H) -(Y); \
+            break; \
+        } \
+    }
+
+#define UNSHIFT_XY_BY_ORIEN(X, Y, W, H, O) UNSHIFT_XY_BY_ORIEN_NOM1((X), (Y), ((W)-1), ((H)-1), (O))
+
+#define SHIFT_RECT_BY_ORIEN_NOM1(X1, Y1, X2, Y2, W, H, O) \
+    { \
+        int Z; \
+        SHIFT_XY_BY_ORIEN_NOM1((X1), (Y1), (W), (H), (O)); \
+        SHIFT_XY_BY_ORIEN_NOM1((X2), (Y2), (W), (H), (O)); \
+        if ((X1) > (X2)) { \
+            (Z) = (X1); \
+            (X1) = (X2); \
+            (X2) = (Z); \
+        } \
+        if ((Y1) > (Y2)) { \
+            (Z) = (Y1); \
+            (Y1) = (Y2); \
+            (Y2) = (Z); \
+        } \
+    }
+
+#define SHIFT_RECT_BY_ORIEN(X1, Y1, X2, Y2, W, H, O) SHIFT_RECT_BY_ORIEN_NOM1((X1), (Y1), (X2), (Y2), (W - 1), (H - 1), (O))
+
+#define UNSHIFT_RECT_BY_ORIEN_NOM1(X1, Y1, X2, Y2, W, H, O) \
+    { \
+        int Z; \
+        UNSHIFT_XY_BY_ORIEN_NOM1((X1), (Y1), (W), (H), (O)); \
+        UNSHIFT_XY_BY_ORIEN_NOM1((X2), (Y2), (W), (H), (O)); \
+        if ((X1) > (X2)) { \
+            (Z) = (X1); \
+            (X1) = (X2); \
+            (X2) = (Z); \
+        } \
+        if ((Y1) > (Y2)) { \
+            (Z) = (Y1); \
+            (Y1) = (Y2); \
+            (Y2) = (Z); \
+        } \
+    }
+
+#define UNSHIFT_RECT_BY_ORIEN(X1, Y1, X2, Y2, W, H, O) UNSHIFT_RECT_BY_ORIEN_NOM1((X1), (Y1), (X2), (Y2), (W - 1), (H - 1), (O))
+
+#define GET_ROTATE_ROTATE(OO, FO, OUTO) \
+    { \
+        switch (FO) { \
+        case 1: \
+            switch (OO) { \
+            case 0: \
+                (OUTO) = 1; \
+                break; \
+            case 1: \
+                (OUTO) = 3; \
+                break; \
+            case 2: \
+                (OUTO) = 0; \
+                break; \
+            case 3: \
+                (OUTO) = 2; \
+                break; \
+            } \
+            break; \
+        case 2: \
+            switch (OO) { \
+            case 0: \
+                (OUTO) = 2; \
+                break; \
+            case 1: \
+                (OUTO) = 0; \
+                break; \
+            case 2: \
+                (OUTO) = 3; \
+                break; \
+            case 3: \
+                (OUTO) = 1; \
+                break; \
+            } \
+            break; \
+        case 3: \
+            switch (OO) { \
+            case 0: \
+                (OUTO) = 3; \
+                break; \
+            case 1: \
+                (OUTO) = 2; \
+                break; \
+            case 2: \
+                (OUTO) = 1; \
+                break; \
+            case 3: \
+                (OUTO) = 0; \
+                break; \
+            } \
+            break; \
+        case 0: \
+            (OUTO) = OO; \
+        } \
+    }
+
+#define GET_ROTATE_ROTATE2(OO, FO) GET_ROTATE_ROTATE((OO), (FO), (OO))
+
+#define GET_ROTATE_ROTATE3 GET_ROTATE_ROTATE
+
+/* MARK: - Lifecycle */
+
+/* Creates a packed (alignedWidth == width) image with zeroed pixels, empty
+ * images are allowed.
+ * Returns NULL if the size is invalid or the allocation fails. */
+JST_EXTERN JST_IMAGE *JSTCreatePixelImage(int width, int height);
+
+/* Wraps an existing pixel buffer. If freeWhenDone is false, the buffer is
+ * borrowed and JSTFreePixelImage only releases the JST_IMAGE itself. */
+JST_EXTERN JST_IMAGE *JSTCreatePixelImageWithPixels(JST_COLOR *pixels, int width, int alignedWidth, int height, JST_BOOL freeWhenDone);
+
+/* Copies the pixels in [x1, x2) x [y1, y2) of the unrotated buffer into a
+ * new packed image, then rotates its orientation by the given one. */
+JST_EXTERN JST_IMAGE *JSTCreatePixelImageWithPixelImageInRect(const JST_IMAGE *pixelImage, JST_ORIENTATION orientation, int x1, int y1, int x2, int y2);
+
+/* Crops an oriented rect, as seen by the user, out of the image. */
+JST_EXTERN JST_IMAGE *JSTCreatePixelImageByCroppingPixelImage(const JST_IMAGE *pixelImage, int x, int y, int width, int height);
+
+/* Deep copy which keeps the alignment of the original image, padded views
+ * are copied into a packed image. */
+JST_EXTERN JST_IMAGE *JSTCopyPixelImage(const JST_IMAGE *pixelImage);
+
+/* Releases the storage of the image if it has one, otherwise frees the
+ * pixels unless they are borrowed. */
+JST_EXTERN void JSTFreePixelImage(JST_IMAGE *pixelImage);
+
+/* MARK: - Pixels */
+
+JST_EXTERN void JSTGetColorInPixelImageSafe(const JST_IMAGE *pixelImage, int x, int y, JST_COLOR *colorOfPoint);
+
+/* Shared pixels are copied before the first write, see JSTPixelStorage.h. */
+JST_EXTERN void JSTSetColorInPixelImageSafe(JST_IMAGE *pixelImage, int x, int y, const JST_COLOR *colorOfPoint);
+
+/* Reads the color of each point, as seen by the user, into its color and
+ * clears the color of points out of the image. Returns the index of the
+ * first point out of the image, or -1 if all of them are inside. */
+JST_EXTERN int JSTGetColorsInPixelImage(const JST_IMAGE *pixelImage, JST_POS *points, int count);
+
+/* Copies the row y, as seen by the user, into row which must hold the
+ * oriented width. Returns false if the row is out of the image. */
+JST_EXTERN JST_BOOL JSTGetRowInPixelImage(const JST_IMAGE *pixelImage, int y, JST_COLOR *row);
+
+/* Size of the image after its orientation has been applied. */
+JST_EXTERN void JSTGetOrientedSizeOfPixelImage(const JST_IMAGE *pixelImage, int *width, int *height);
+
+/* Writes the upright, packed pixels of the image into buffer, which must
+ * hold at least width * height colors of the oriented size. */
+JST_EXTERN void JSTCopyOrientedPixelsOfPixelImage(const JST_IMAGE *pixelImage, JST_COLOR *buffer);
+
+#endif /* JSTPixelCore_h */
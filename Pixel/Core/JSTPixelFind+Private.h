@@ -0,0 +1,134 @@
+#ifndef JSTPixelFind_Private_h
+#define JSTPixelFind_Private_h
+
+#include "JSTPixelFind.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__)
+#define JST_FIND_COLOR_HAS_SSE2 1
+#if defined(__GNUC__) || defined(__clang__)
+#define JST_FIND_COLOR_HAS_AVX2 1
+#endif
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define JST_FIND_COLOR_HAS_NEON 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define JST_FIND_COLOR_INLINE inline __attribute__((always_inline))
+#else
+#define JST_FIND_COLOR_INLINE inline
+#endif
+
+
+/* A point relative to the anchor, with its tolerance packed like a color:
+ * one byte per channel, alpha being 0xFF so that it never rejects. */
+struct JSTFindColorPoint {
+    ptrdiff_t offset;  /* dy * stride + dx */
+    uint32_t color;
+    uint32_t tolerance;
+};
+
+struct JSTFindColorContext {
+    const JST_COLOR *pixels;  /* oriented */
+    ptrdiff_t stride;
+
+    /* anchors to scan, every other point of such an anchor is in the image */
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+
+    uint32_t anchorColor;
+    uint32_t anchorTolerance;
+    std::vector<JSTFindColorPoint> points;  /* the anchor excluded */
+
+    JST_FIND_COLOR_MATCH *matches;
+    long long maxMatches;
+};
+
+static JST_FIND_COLOR_INLINE bool JSTFindColorMatchesPacked(uint32_t pixel, uint32_t color, uint32_t tolerance)
+{
+    for (int shift = 0; shift < 24; shift += 8) {
+        int difference = (int)((pixel >> shift) & 0xFF) - (int)((color >> shift) & 0xFF);
+        if (difference < 0) {
+            difference = -difference;
+        }
+        if (difference > (int)((tolerance >> shift) & 0xFF)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/* MARK: - Driver */
+
+/* A kernel provides, for N adjacent pixels:
+ *
+ *   static uint32_t anchorMask(const JST_COLOR *pixels, uint32_t color, uint32_t tolerance);
+ *       bit i set if pixel i matches the anchor
+ *
+ * Candidates are then checked one by one against the other points. */
+template <typename Kernel>
+static inline long long JSTFindColorRows(const JSTFindColorContext &ctx, JST_FIND_COLOR_STATISTICS *statistics)
+{
+    const int N = Kernel::N;
+    const JSTFindColorPoint *points = ctx.points.data();
+    const size_t pointCount = ctx.points.size();
+    long long candidateCount = 0, comparisonCount = 0, matchCount = 0;
+
+    auto check = [&](const JST_COLOR *anchor, int x, int y) {
+        ++candidateCount;
+        for (size_t i = 0; i < pointCount; ++i) {
+            ++comparisonCount;
+            if (!JSTFindColorMatchesPacked(anchor[points[i].offset].theColor, points[i].color, points[i].tolerance)) {
+                return;
+            }
+        }
+        if (matchCount < ctx.maxMatches) {
+            ctx.matches[matchCount].x = x;
+            ctx.matches[matchCount].y = y;
+        }
+        ++matchCount;
+    };
+
+    for (int y = ctx.y1; y < ctx.y2; ++y) {
+        const JST_COLOR *row = ctx.pixels + y * ctx.stride;
+        int x = ctx.x1;
+        for (; x + N <= ctx.x2; x += N) {
+            uint32_t mask = Kernel::anchorMask(row + x, ctx.anchorColor, ctx.anchorTolerance);
+            while (mask) {
+                int lane = __builtin_ctz(mask);
+                mask &= mask - 1;
+                check(row + x + lane, x + lane, y);
+            }
+        }
+        for (; x < ctx.x2; ++x) {
+            if (JSTFindColorMatchesPacked(row[x].theColor, ctx.anchorColor, ctx.anchorTolerance)) {
+                check(row + x, x, y);
+            }
+        }
+    }
+
+    if (statistics) {
+        statistics->scannedCount = (long long)(ctx.x2 - ctx.x1) * (ctx.y2 - ctx.y1);
+        statistics->candidateCount = candidateCount;
+        statistics->comparisonCount = comparisonCount;
+        statistics->matchCount = matchCount;
+    }
+    return matchCount;
+}
+
+
+/* MARK: - Kernels */
+
+#if JST_FIND_COLOR_HAS_AVX2
+long long JSTFindColorRowsAVX2(const JSTFindColorContext &ctx, JST_FIND_COLOR_STATISTICS *statistics);
+#endif
+
+#endif /* JSTPixelFind_Private_h */
@@ -0,0 +1,228 @@
+#include "JSTPixelFind+Private.h"
+
+#include <algorithm>
+#include <new>
+
+#if JST_FIND_COLOR_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if JST_FIND_COLOR_HAS_NEON
+#include <arm_neon.h>
+#endif
+
+
+/* MARK: - Kernels */
+
+struct JSTFindColorScalar {
+    static const int N = 4;
+
+    static JST_FIND_COLOR_INLINE uint32_t anchorMask(const JST_COLOR *pixels, uint32_t color, uint32_t tolerance) {
+        uint32_t mask = 0;
+        for (int i = 0; i < N; ++i) {
+            if (JSTFindColorMatchesPacked(pixels[i].theColor, color, tolerance)) {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+    }
+};
+
+#if JST_FIND_COLOR_HAS_SSE2
+struct JSTFindColorSSE2 {
+    static const int N = 4;
+
+    static JST_FIND_COLOR_INLINE uint32_t anchorMask(const JST_COLOR *pixels, uint32_t color, uint32_t tolerance) {
+        __m128i p = _mm_loadu_si128((const __m128i *)pixels);
+        __m128i c = _mm_set1_epi32((int)color);
+        __m128i difference = _mm_or_si128(_mm_subs_epu8(p, c), _mm_subs_epu8(c, p));
+        __m128i excess = _mm_subs_epu8(difference, _mm_set1_epi32((int)tolerance));
+        __m128i matches = _mm_cmpeq_epi32(excess, _mm_setzero_si128());
+        return (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(matches));
+    }
+};
+#endif
+
+#if JST_FIND_COLOR_HAS_NEON
+struct JSTFindColorNEON {
+    static const int N = 4;
+
+    static JST_FIND_COLOR_INLINE uint32_t anchorMask(const JST_COLOR *pixels, uint32_t color, uint32_t tolerance) {
+        static const uint32_t lanes[4] = { 1, 2, 4, 8 };
+        uint8x16_t p = vld1q_u8((const uint8_t *)pixels);
+        uint8x16_t difference = vabdq_u8(p, vreinterpretq_u8_u32(vdupq_n_u32(color)));
+        uint8x16_t excess = vqsubq_u8(difference, vreinterpretq_u8_u32(vdupq_n_u32(tolerance)));
+        uint32x4_t matches = vceqq_u32(vreinterpretq_u32_u8(excess), vdupq_n_u32(0));
+        return vaddvq_u32(vandq_u32(matches, vld1q_u32(lanes)));
+    }
+};
+#endif
+
+
+/* MARK: - Dispatch */
+
+static JST_FIND_COLOR_KERNEL JSTFindColorKernelResolve(JST_FIND_COLOR_KERNEL kernel)
+{
+    if (kernel != JST_FIND_COLOR_KERNEL_AUTOMATIC) {
+        return kernel;
+    }
+#if JST_FIND_COLOR_HAS_NEON
+    return JST_FIND_COLOR_KERNEL_NEON;
+#else
+    static const JST_FIND_COLOR_KERNEL bestKernel = JSTFindColorKernelIsSupported(JST_FIND_COLOR_KERNEL_AVX2)
+        ? JST_FIND_COLOR_KERNEL_AVX2
+        : (JSTFindColorKernelIsSupported(JST_FIND_COLOR_KERNEL_SSE2) ? JST_FIND_COLOR_KERNEL_SSE2 : JST_FIND_COLOR_KERNEL_SCALAR);
+    return bestKernel;
+#endif
+}
+
+JST_BOOL JSTFindColorKernelIsSupported(JST_FIND_COLOR_KERNEL kernel)
+{
+    switch (kernel) {
+    case JST_FIND_COLOR_KERNEL_AUTOMATIC:
+    case JST_FIND_COLOR_KERNEL_SCALAR:
+        return true;
+    case JST_FIND_COLOR_KERNEL_SSE2:
+#if JST_FIND_COLOR_HAS_SSE2
+        return true;
+#else
+        return false;
+#endif
+    case JST_FIND_COLOR_KERNEL_AVX2:
+#if JST_FIND_COLOR_HAS_AVX2
+        return __builtin_cpu_supports("avx2") ? true : false;
+#else
+        return false;
+#endif
+    case JST_FIND_COLOR_KERNEL_NEON:
+#if JST_FIND_COLOR_HAS_NEON
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char *JSTFindColorKernelGetName(JST_FIND_COLOR_KERNEL kernel)
+{
+    switch (JSTFindColorKernelResolve(kernel)) {
+    case JST_FIND_COLOR_KERNEL_SCALAR:
+        return "scalar";
+    case JST_FIND_COLOR_KERNEL_SSE2:
+        return "sse2";
+    case JST_FIND_COLOR_KERNEL_AVX2:
+        return "avx2";
+    case JST_FIND_COLOR_KERNEL_NEON:
+        return "neon";
+    default:
+        return "unknown";
+    }
+}
+
+
+/* MARK: - Search */
+
+static uint32_t JSTFindColorPackTolerance(const JST_POS *point)
+{
+    int similarity = std::min(std::max((int)point->similarity, 0), 100);
+    int slack = (100 - similarity) * 255 / 100;
+    uint32_t tolerance = 0xFF000000u;
+    for (int shift = 0; shift < 24; shift += 8) {
+        int channel = std::min((int)((point->color_offset.theColor >> shift) & 0xFF) + slack, 255);
+        tolerance |= (uint32_t)channel << shift;
+    }
+    return tolerance;
+}
+
+JST_BOOL JSTFindColorMatchesPoint(JST_COLOR color, const JST_POS *point)
+{
+    return JSTFindColorMatchesPacked(color.theColor, point->color.theColor, JSTFindColorPackTolerance(point));
+}
+
+long long JSTFindColorInPixelImage(const JST_IMAGE *pixelImage, const JST_POS *points, int count, int x1, int y1, int x2, int y2, JST_FIND_COLOR_MATCH *matches, long long maxMatches, JST_FIND_COLOR_STATISTICS *statistics, JST_FIND_COLOR_KERNEL kernel)
+{
+    if (count < 1) {
+        return -1;
+    }
+    kernel = JSTFindColorKernelResolve(kernel);
+    if (!JSTFindColorKernelIsSupported(kernel)) {
+        return -1;
+    }
+
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
+
+    /* Rotated images are searched in an upright copy, so that kernels
+     * always read adjacent pixels of a row. */
+    JST_COLOR *orientedPixels = NULL;
+    JSTFindColorContext ctx;
+    if (pixelImage->orientation == 0) {
+        ctx.pixels = pixelImage->pixels;
+        ctx.stride = pixelImage->alignedWidth;
+    } else {
+        orientedPixels = new (std::nothrow) JST_COLOR[(size_t)width * height];
+        if (!orientedPixels) {
+            return -1;
+        }
+        JSTCopyOrientedPixelsOfPixelImage(pixelImage, orientedPixels);
+        ctx.pixels = orientedPixels;
+        ctx.stride = width;
+    }
+
+    /* Anchors whose points would leave the image are never scanned, so the
+     * candidates need no bounds checks. */
+    int minDX = 0, minDY = 0, maxDX = 0, maxDY = 0;
+    try {
+        ctx.points.reserve((size_t)count - 1);
+        for (int i = 1; i < count; ++i) {
+            int dx = points[i].x - points[0].x;
+            int dy = points[i].y - points[0].y;
+            minDX = std::min(minDX, dx);
+            minDY = std::min(minDY, dy);
+            maxDX = std::max(maxDX, dx);
+            maxDY = std::max(maxDY, dy);
+            ctx.points.push_back(JSTFindColorPoint{
+                (ptrdiff_t)dy * ctx.stride + dx,
+                points[i].color.theColor,
+                JSTFindColorPackTolerance(&points[i]),
+            });
+        }
+    } catch (const std::bad_alloc &) {
+        delete[] orientedPixels;
+        return -1;
+    }
+    ctx.x1 = std::max(x1, -minDX);
+    ctx.y1 = std::max(y1, -minDY);
+    ctx.x2 = std::max(std::min(x2, width - maxDX), ctx.x1);
+    ctx.y2 = std::max(std::min(y2, height - maxDY), ctx.y1);
+    ctx.anchorColor = points[0].color.theColor;
+    ctx.anchorTolerance = JSTFindColorPackTolerance(&points[0]);
+    ctx.matches = matches;
+    ctx.maxMatches = matches ? std::max(maxMatches, 0LL) : 0;
+
+    long long matchCount;
+    switch (kernel) {
+#if JST_FIND_COLOR_HAS_SSE2
+    case JST_FIND_COLOR_KERNEL_SSE2:
+        matchCount = JSTFindColorRows<JSTFindColorSSE2>(ctx, statistics);
+        break;
+#endif
+#if JST_FIND_COLOR_HAS_AVX2
+    case JST_FIND_COLOR_KERNEL_AVX2:
+        matchCount = JSTFindColorRowsAVX2(ctx, statistics);
+        break;
+#endif
+#if JST_FIND_COLOR_HAS_NEON
+    case JST_FIND_COLOR_KERNEL_NEON:
+        matchCount = JSTFindColorRows<JSTFindColorNEON>(ctx, statistics);
+        break;
+#endif
+    default:
+        matchCount = JSTFindColorRows<JSTFindColorScalar>(ctx, statistics);
+        break;
+    }
+
+    delete[] orientedPixels;
+    return matchCount;
+}
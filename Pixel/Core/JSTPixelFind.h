@@ -0,0 +1,61 @@
+#ifndef JSTPixelFind_h
+#define JSTPixelFind_h
+
+#include "JSTPixelCore.h"
+
+/* Multi-point color search, as done by find_color on the device: the first
+ * point is the anchor, and every pixel matching it is a candidate whose
+ * other points, at the same offsets from the anchor as given, must match
+ * too. Only the offsets between points matter, not where they were picked.
+ *
+ * A pixel matches a point if each of its red, green and blue channels is
+ * within the tolerance of the point: its color_offset channel plus
+ * (100 - similarity) percent of 255, similarity being clamped to [0, 100].
+ * Alpha is ignored.
+ *
+ * Kernels compare several pixels with the anchor at a time. Candidates are
+ * then checked point by point and rejected on the first one which does not
+ * match, so the search costs little more than the anchor scan unless the
+ * anchor color is common. */
+
+typedef enum JST_FIND_COLOR_KERNEL {
+    JST_FIND_COLOR_KERNEL_AUTOMATIC = 0,
+    JST_FIND_COLOR_KERNEL_SCALAR,
+    JST_FIND_COLOR_KERNEL_SSE2,
+    JST_FIND_COLOR_KERNEL_AVX2,
+    JST_FIND_COLOR_KERNEL_NEON,
+} JST_FIND_COLOR_KERNEL;
+
+/* Position of the anchor of a match, as seen by the user. */
+typedef struct JST_FIND_COLOR_MATCH {
+    int x;
+    int y;
+} JST_FIND_COLOR_MATCH;
+
+/* What a search cost, to tell how a script would perform on the device. */
+typedef struct JST_FIND_COLOR_STATISTICS {
+    long long scannedCount;      /* pixels compared with the anchor */
+    long long candidateCount;    /* pixels matching the anchor */
+    long long comparisonCount;   /* other points compared, those which rejected a candidate included */
+    long long matchCount;
+} JST_FIND_COLOR_STATISTICS;
+
+/* Whether the kernel can run on this machine. Automatic and scalar kernels
+ * are always supported. */
+JST_EXTERN JST_BOOL JSTFindColorKernelIsSupported(JST_FIND_COLOR_KERNEL kernel);
+
+/* Name of the kernel the automatic selection resolves to. */
+JST_EXTERN const char *JSTFindColorKernelGetName(JST_FIND_COLOR_KERNEL kernel);
+
+/* Whether a color matches a point, see above. */
+JST_EXTERN JST_BOOL JSTFindColorMatchesPoint(JST_COLOR color, const JST_POS *point);
+
+/* Searches the oriented image for anchors within [x1, x2) x [y1, y2),
+ * clamped to the image. The other points only have to be within the image.
+ * Writes the first maxMatches matches into matches, in row order, and
+ * fills statistics unless it is NULL.
+ * Returns the number of matches, which may exceed maxMatches, or -1 if
+ * there is no point, the kernel is not supported or memory ran out. */
+JST_EXTERN long long JSTFindColorInPixelImage(const JST_IMAGE *pixelImage, const JST_POS *points, int count, int x1, int y1, int x2, int y2, JST_FIND_COLOR_MATCH *matches, long long maxMatches, JST_FIND_COLOR_STATISTICS *statistics, JST_FIND_COLOR_KERNEL kernel);
+
+#endif /* JSTPixelFind_h */
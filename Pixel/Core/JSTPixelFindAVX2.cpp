@@ -0,0 +1,42 @@
+#include "JSTPixelFind.h"
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+
+#include <immintrin.h>
+
+/* Everything below, including the driver template from the private header,
+ * is compiled for AVX2. It is only called after a runtime CPU check. */
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "JSTPixelFind+Private.h"
+
+struct JSTFindColorAVX2 {
+    static const int N = 8;
+
+    static JST_FIND_COLOR_INLINE uint32_t anchorMask(const JST_COLOR *pixels, uint32_t color, uint32_t tolerance) {
+        __m256i p = _mm256_loadu_si256((const __m256i *)pixels);
+        __m256i c = _mm256_set1_epi32((int)color);
+        __m256i difference = _mm256_or_si256(_mm256_subs_epu8(p, c), _mm256_subs_epu8(c, p));
+        __m256i excess = _mm256_subs_epu8(difference, _mm256_set1_epi32((int)tolerance));
+        __m256i matches = _mm256_cmpeq_epi32(excess, _mm256_setzero_si256());
+        return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(matches));
+    }
+};
+
+long long JSTFindColorRowsAVX2(const JSTFindColorContext &ctx, JST_FIND_COLOR_STATISTICS *statistics)
+{
+    return JSTFindColorRows<JSTFindColorAVX2>(ctx, statistics);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif /* __SSE2__ */
@@ -0,0 +1,131 @@
+#ifndef JSTPixelFindImage_Private_h
+#define JSTPixelFindImage_Private_h
+
+#include "JSTPixelFindImage.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__)
+#define JST_FIND_IMAGE_HAS_SSE2 1
+#if defined(__GNUC__) || defined(__clang__)
+#define JST_FIND_IMAGE_HAS_AVX2 1
+#endif
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define JST_FIND_IMAGE_HAS_NEON 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define JST_FIND_IMAGE_INLINE inline __attribute__((always_inline))
+#else
+#define JST_FIND_IMAGE_INLINE inline
+#endif
+
+
+/* Pixels of every level are stored as four int16_t samples, red, green and
+ * blue sums then a zero in place of alpha, so that rows of any level are
+ * compared by the same kernel. Sums of 4x4 blocks stay below 4096, their
+ * differences fit an int16_t and the squares of two of them an int32_t
+ * lane many times over. */
+#define JST_FIND_IMAGE_SAMPLES 4
+
+/* The template summed over the blocks it fully covers when its left edge
+ * is x % scale pixels past a block edge, and likewise for y. */
+struct JSTFindImagePhase {
+    int x;       /* template pixels before the first block */
+    int y;
+    int width;   /* in blocks */
+    int height;
+    std::vector<int16_t> samples;
+};
+
+struct JSTFindImageLevel {
+    int shift;   /* blocks of 1 << shift pixels */
+    int width;   /* of the region, in blocks */
+    int height;
+    std::vector<int16_t> samples;
+    std::vector<JSTFindImagePhase> phases;  /* (y % scale) * scale + x % scale */
+    long long bound;                        /* largest SSD of a passing position */
+};
+
+struct JSTFindImageContext {
+    int positionWidth;   /* positions of the template within the region */
+    int positionHeight;
+    std::vector<JSTFindImageLevel> levels;  /* the full resolution first */
+};
+
+/* A matching position, relative to the region. */
+struct JSTFindImageCandidate {
+    int x;
+    int y;
+    long long difference;
+};
+
+
+/* MARK: - Driver */
+
+/* A kernel provides:
+ *
+ *   static long long rowDifference(const int16_t *a, const int16_t *b, int count);
+ *       the SSD of count samples, a multiple of JST_FIND_IMAGE_SAMPLES
+ *
+ * Positions are compared from the coarsest level to the full resolution,
+ * row by row, and rejected as soon as their SSD exceeds the bound. */
+template <typename Kernel>
+static JST_FIND_IMAGE_INLINE bool JSTFindImageCompare(const JSTFindImageLevel &level, int x, int y, long long *difference)
+{
+    int mask = (1 << level.shift) - 1;
+    const JSTFindImagePhase &phase = level.phases[((size_t)(y & mask) << level.shift) + (x & mask)];
+    long long sum = 0;
+    if (phase.width > 0) {
+        int count = phase.width * JST_FIND_IMAGE_SAMPLES;
+        ptrdiff_t stride = (ptrdiff_t)level.width * JST_FIND_IMAGE_SAMPLES;
+        const int16_t *row = level.samples.data() + ((y + phase.y) >> level.shift) * stride + ((x + phase.x) >> level.shift) * JST_FIND_IMAGE_SAMPLES;
+        const int16_t *samples = phase.samples.data();
+        for (int k = 0; k < phase.height; ++k) {
+            sum += Kernel::rowDifference(row, samples, count);
+            if (sum > level.bound) {
+                return false;
+            }
+            row += stride;
+            samples += count;
+        }
+    }
+    *difference = sum;
+    return true;
+}
+
+/* Compares the positions of rows [y1, y2), appends the matches to
+ * candidates and adds the comparisons of each level to counts. */
+template <typename Kernel>
+static inline void JSTFindImageRows(const JSTFindImageContext &ctx, int y1, int y2, std::vector<JSTFindImageCandidate> &candidates, long long *counts)
+{
+    const int levelCount = (int)ctx.levels.size();
+    for (int y = y1; y < y2; ++y) {
+        for (int x = 0; x < ctx.positionWidth; ++x) {
+            long long difference = 0;
+            int level = levelCount - 1;
+            for (; level >= 0; --level) {
+                ++counts[level];
+                if (!JSTFindImageCompare<Kernel>(ctx.levels[level], x, y, &difference)) {
+                    break;
+                }
+            }
+            if (level < 0) {
+                candidates.push_back(JSTFindImageCandidate{ x, y, difference });
+            }
+        }
+    }
+}
+
+
+/* MARK: - Kernels */
+
+#if JST_FIND_IMAGE_HAS_AVX2
+void JSTFindImageRowsAVX2(const JSTFindImageContext &ctx, int y1, int y2, std::vector<JSTFindImageCandidate> &candidates, long long *counts);
+#endif
+
+#endif /* JSTPixelFindImage_Private_h */
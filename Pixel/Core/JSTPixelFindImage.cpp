@@ -0,0 +1,497 @@
+#include "JSTPixelFindImage+Private.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <new>
+#include <thread>
+
+#if JST_FIND_IMAGE_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if JST_FIND_IMAGE_HAS_NEON
+#include <arm_neon.h>
+#endif
+
+
+/* MARK: - Kernels */
+
+struct JSTFindImageScalar {
+    static JST_FIND_IMAGE_INLINE long long rowDifference(const int16_t *a, const int16_t *b, int count) {
+        long long sum = 0;
+        for (int i = 0; i < count; ++i) {
+            int difference = a[i] - b[i];
+            sum += difference * difference;
+        }
+        return sum;
+    }
+};
+
+#if JST_FIND_IMAGE_HAS_SSE2
+struct JSTFindImageSSE2 {
+    static JST_FIND_IMAGE_INLINE long long rowDifference(const int16_t *a, const int16_t *b, int count) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i sum64 = zero;
+        int i = 0;
+        while (i + 8 <= count) {
+            /* 32 vectors of squares fit the 32-bit lanes at any level */
+            int end = std::min(count - 7, i + 8 * 32);
+            __m128i sum32 = zero;
+            for (; i < end; i += 8) {
+                __m128i difference = _mm_sub_epi16(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)));
+                sum32 = _mm_add_epi32(sum32, _mm_madd_epi16(difference, difference));
+            }
+            sum64 = _mm_add_epi64(sum64, _mm_unpacklo_epi32(sum32, zero));
+            sum64 = _mm_add_epi64(sum64, _mm_unpackhi_epi32(sum32, zero));
+        }
+        long long lanes[2];
+        _mm_storeu_si128((__m128i *)lanes, sum64);
+        return lanes[0] + lanes[1] + JSTFindImageScalar::rowDifference(a + i, b + i, count - i);
+    }
+};
+#endif
+
+#if JST_FIND_IMAGE_HAS_NEON
+struct JSTFindImageNEON {
+    static JST_FIND_IMAGE_INLINE long long rowDifference(const int16_t *a, const int16_t *b, int count) {
+        uint64x2_t sum64 = vdupq_n_u64(0);
+        int i = 0;
+        while (i + 8 <= count) {
+            int end = std::min(count - 7, i + 8 * 32);
+            int32x4_t sum32 = vdupq_n_s32(0);
+            for (; i < end; i += 8) {
+                int16x8_t difference = vsubq_s16(vld1q_s16(a + i), vld1q_s16(b + i));
+                sum32 = vmlal_s16(sum32, vget_low_s16(difference), vget_low_s16(difference));
+                sum32 = vmlal_high_s16(sum32, difference, difference);
+            }
+            sum64 = vpadalq_u32(sum64, vreinterpretq_u32_s32(sum32));
+        }
+        return (long long)vaddvq_u64(sum64) + JSTFindImageScalar::rowDifference(a + i, b + i, count - i);
+    }
+};
+#endif
+
+
+/* MARK: - Dispatch */
+
+static JST_FIND_IMAGE_KERNEL JSTFindImageKernelResolve(JST_FIND_IMAGE_KERNEL kernel)
+{
+    if (kernel != JST_FIND_IMAGE_KERNEL_AUTOMATIC) {
+        return kernel;
+    }
+#if JST_FIND_IMAGE_HAS_NEON
+    return JST_FIND_IMAGE_KERNEL_NEON;
+#else
+    static const JST_FIND_IMAGE_KERNEL bestKernel = JSTFindImageKernelIsSupported(JST_FIND_IMAGE_KERNEL_AVX2)
+        ? JST_FIND_IMAGE_KERNEL_AVX2
+        : (JSTFindImageKernelIsSupported(JST_FIND_IMAGE_KERNEL_SSE2) ? JST_FIND_IMAGE_KERNEL_SSE2 : JST_FIND_IMAGE_KERNEL_SCALAR);
+    return bestKernel;
+#endif
+}
+
+JST_BOOL JSTFindImageKernelIsSupported(JST_FIND_IMAGE_KERNEL kernel)
+{
+    switch (kernel) {
+    case JST_FIND_IMAGE_KERNEL_AUTOMATIC:
+    case JST_FIND_IMAGE_KERNEL_SCALAR:
+        return true;
+    case JST_FIND_IMAGE_KERNEL_SSE2:
+#if JST_FIND_IMAGE_HAS_SSE2
+        return true;
+#else
+        return false;
+#endif
+    case JST_FIND_IMAGE_KERNEL_AVX2:
+#if JST_FIND_IMAGE_HAS_AVX2
+        return __builtin_cpu_supports("avx2") ? true : false;
+#else
+        return false;
+#endif
+    case JST_FIND_IMAGE_KERNEL_NEON:
+#if JST_FIND_IMAGE_HAS_NEON
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char *JSTFindImageKernelGetName(JST_FIND_IMAGE_KERNEL kernel)
+{
+    switch (JSTFindImageKernelResolve(kernel)) {
+    case JST_FIND_IMAGE_KERNEL_SCALAR:
+        return "scalar";
+    case JST_FIND_IMAGE_KERNEL_SSE2:
+        return "sse2";
+    case JST_FIND_IMAGE_KERNEL_AVX2:
+        return "avx2";
+    case JST_FIND_IMAGE_KERNEL_NEON:
+        return "neon";
+    default:
+        return "unknown";
+    }
+}
+
+static void JSTFindImagePerformRows(const JSTFindImageContext &ctx, JST_FIND_IMAGE_KERNEL kernel, int y1, int y2, std::vector<JSTFindImageCandidate> &candidates, long long *counts)
+{
+    switch (kernel) {
+#if JST_FIND_IMAGE_HAS_SSE2
+    case JST_FIND_IMAGE_KERNEL_SSE2:
+        JSTFindImageRows<JSTFindImageSSE2>(ctx, y1, y2, candidates, counts);
+        break;
+#endif
+#if JST_FIND_IMAGE_HAS_AVX2
+    case JST_FIND_IMAGE_KERNEL_AVX2:
+        JSTFindImageRowsAVX2(ctx, y1, y2, candidates, counts);
+        break;
+#endif
+#if JST_FIND_IMAGE_HAS_NEON
+    case JST_FIND_IMAGE_KERNEL_NEON:
+        JSTFindImageRows<JSTFindImageNEON>(ctx, y1, y2, candidates, counts);
+        break;
+#endif
+    default:
+        JSTFindImageRows<JSTFindImageScalar>(ctx, y1, y2, candidates, counts);
+        break;
+    }
+}
+
+
+/* MARK: - Pyramids */
+
+void JSTFindImageOptionsInit(JST_FIND_IMAGE_OPTIONS *options)
+{
+    options->similarity = 0.95;
+    options->levelCount = -1;
+    options->threadCount = 0;
+    options->tileRows = 0;
+    options->keepsOverlaps = false;
+}
+
+long long JSTFindImageGetMaximumDifference(int width, int height, double similarity)
+{
+    /* with some slack, so that 0.9 still allows a difference of 25.5 */
+    double difference = (1.0 - std::min(std::max(similarity, 0.0), 1.0)) * 255.0;
+    return (long long)std::floor(difference * difference * 3.0 * width * height + 1e-6);
+}
+
+/* Templates smaller than this many blocks a side are not worth a level. */
+static const int kFindImageMinimumLevelBlocks = 4;
+
+/* Upright pixels of [x, x + width) x [y, y + height) of the image. */
+static bool JSTFindImageCopySamples(const JST_IMAGE *pixelImage, int x, int y, int width, int height, std::vector<int16_t> &samples)
+{
+    const JST_COLOR *pixels = pixelImage->pixels;
+    ptrdiff_t stride = pixelImage->alignedWidth;
+    std::unique_ptr<JST_COLOR[]> orientedPixels;
+    if (pixelImage->orientation != 0) {
+        int orientedWidth, orientedHeight;
+        JSTGetOrientedSizeOfPixelImage(pixelImage, &orientedWidth, &orientedHeight);
+        orientedPixels.reset(new (std::nothrow) JST_COLOR[(size_t)orientedWidth * orientedHeight]);
+        if (!orientedPixels) {
+            return false;
+        }
+        JSTCopyOrientedPixelsOfPixelImage(pixelImage, orientedPixels.get());
+        pixels = orientedPixels.get();
+        stride = orientedWidth;
+    }
+
+    samples.resize((size_t)width * height * JST_FIND_IMAGE_SAMPLES);
+    int16_t *sample = samples.data();
+    for (int j = 0; j < height; ++j) {
+        const JST_COLOR *row = pixels + (y + j) * stride + x;
+        for (int i = 0; i < width; ++i) {
+            *sample++ = row[i].red;
+            *sample++ = row[i].green;
+            *sample++ = row[i].blue;
+            *sample++ = 0;
+        }
+    }
+    return true;
+}
+
+/* Sums the 2x2 blocks of the level below. */
+static void JSTFindImageReduceLevel(const JSTFindImageLevel &below, JSTFindImageLevel &level)
+{
+    level.shift = below.shift + 1;
+    level.width = below.width / 2;
+    level.height = below.height / 2;
+    level.samples.resize((size_t)level.width * level.height * JST_FIND_IMAGE_SAMPLES);
+    const size_t stride = (size_t)below.width * JST_FIND_IMAGE_SAMPLES;
+    int16_t *sample = level.samples.data();
+    for (int j = 0; j < level.height; ++j) {
+        const int16_t *row = below.samples.data() + 2 * j * stride;
+        for (int i = 0; i < level.width * JST_FIND_IMAGE_SAMPLES; ++i) {
+            int x = (i / JST_FIND_IMAGE_SAMPLES) * 2 * JST_FIND_IMAGE_SAMPLES + i % JST_FIND_IMAGE_SAMPLES;
+            *sample++ = (int16_t)(row[x] + row[x + JST_FIND_IMAGE_SAMPLES] + row[stride + x] + row[stride + x + JST_FIND_IMAGE_SAMPLES]);
+        }
+    }
+}
+
+/* Sums the template over the blocks of every phase of the level, from a
+ * summed-area table of its samples. */
+static void JSTFindImageMakePhases(const std::vector<long long> &table, int width, int height, JSTFindImageLevel &level)
+{
+    const int scale = 1 << level.shift;
+    const size_t stride = (size_t)(width + 1) * JST_FIND_IMAGE_SAMPLES;
+    auto area = [&](int x1, int y1, int x2, int y2, int channel) {
+        return table[y2 * stride + x2 * JST_FIND_IMAGE_SAMPLES + channel] - table[y1 * stride + x2 * JST_FIND_IMAGE_SAMPLES + channel]
+            - table[y2 * stride + x1 * JST_FIND_IMAGE_SAMPLES + channel] + table[y1 * stride + x1 * JST_FIND_IMAGE_SAMPLES + channel];
+    };
+
+    level.phases.resize((size_t)scale * scale);
+    for (int ry = 0; ry < scale; ++ry) {
+        for (int rx = 0; rx < scale; ++rx) {
+            JSTFindImagePhase &phase = level.phases[(size_t)ry * scale + rx];
+            phase.x = (scale - rx) & (scale - 1);
+            phase.y = (scale - ry) & (scale - 1);
+            phase.width = std::max(width - phase.x, 0) >> level.shift;
+            phase.height = std::max(height - phase.y, 0) >> level.shift;
+            if (phase.width == 0 || phase.height == 0) {
+                phase.width = phase.height = 0;
+                continue;
+            }
+            phase.samples.resize((size_t)phase.width * phase.height * JST_FIND_IMAGE_SAMPLES);
+            int16_t *sample = phase.samples.data();
+            for (int j = 0; j < phase.height; ++j) {
+                int y1 = phase.y + j * scale;
+                for (int i = 0; i < phase.width; ++i) {
+                    int x1 = phase.x + i * scale;
+                    for (int channel = 0; channel < JST_FIND_IMAGE_SAMPLES; ++channel) {
+                        *sample++ = (int16_t)area(x1, y1, x1 + scale, y1 + scale, channel);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static bool JSTFindImageContextInit(JSTFindImageContext &ctx, const JST_IMAGE *pixelImage, const JST_IMAGE *templateImage, int x1, int y1, int x2, int y2, int width, int height, const JST_FIND_IMAGE_OPTIONS &options)
+{
+    int levelCount = options.levelCount;
+    if (levelCount < 0) {
+        levelCount = 0;
+        while (levelCount < JST_FIND_IMAGE_MAX_LEVEL && std::min(width, height) >> (levelCount + 1) >= kFindImageMinimumLevelBlocks) {
+            ++levelCount;
+        }
+    }
+    levelCount = std::min(levelCount, JST_FIND_IMAGE_MAX_LEVEL);
+
+    std::vector<int16_t> templateSamples;
+    ctx.levels.resize((size_t)levelCount + 1);
+    JSTFindImageLevel &base = ctx.levels[0];
+    base.shift = 0;
+    base.width = x2 - x1;
+    base.height = y2 - y1;
+    if (!JSTFindImageCopySamples(pixelImage, x1, y1, base.width, base.height, base.samples)
+        || !JSTFindImageCopySamples(templateImage, 0, 0, width, height, templateSamples)) {
+        return false;
+    }
+
+    const size_t stride = (size_t)(width + 1) * JST_FIND_IMAGE_SAMPLES;
+    std::vector<long long> table(stride * (height + 1), 0);
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width * JST_FIND_IMAGE_SAMPLES; ++i) {
+            size_t index = (j + 1) * stride + JST_FIND_IMAGE_SAMPLES + i;
+            table[index] = templateSamples[(size_t)j * width * JST_FIND_IMAGE_SAMPLES + i]
+                + table[index - stride] + table[index - JST_FIND_IMAGE_SAMPLES] - table[index - stride - JST_FIND_IMAGE_SAMPLES];
+        }
+    }
+
+    long long maxDifference = JSTFindImageGetMaximumDifference(width, height, options.similarity);
+    for (int level = 0; level <= levelCount; ++level) {
+        JSTFindImageLevel &current = ctx.levels[level];
+        if (level > 0) {
+            JSTFindImageReduceLevel(ctx.levels[level - 1], current);
+        }
+        JSTFindImageMakePhases(table, width, height, current);
+        /* a block sum of n differences squared is at most n times their SSD */
+        current.bound = maxDifference << (2 * current.shift);
+    }
+    return true;
+}
+
+
+/* MARK: - Search */
+
+/* Rows of positions per tile; a position costs a whole template, so tiles
+ * are kept short for the threads to share them evenly. */
+static const int kFindImageTileRows = 8;
+
+/* Keeps the best match of every group of overlapping ones, best first.
+ * Two kept matches never start in the same cell of template size, so only
+ * the neighbouring cells are looked at. */
+static void JSTFindImageDropOverlaps(std::vector<JSTFindImageCandidate> &candidates, int width, int height, int positionWidth, int positionHeight)
+{
+    std::vector<size_t> order(candidates.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return candidates[a].difference < candidates[b].difference;
+    });
+
+    const int columns = positionWidth / width + 1, rows = positionHeight / height + 1;
+    std::vector<long long> cells((size_t)columns * rows, -1);
+    std::vector<bool> isKept(candidates.size(), false);
+    for (size_t index : order) {
+        const JSTFindImageCandidate &candidate = candidates[index];
+        int column = candidate.x / width, row = candidate.y / height;
+        bool overlaps = false;
+        for (int j = std::max(row - 1, 0); j <= std::min(row + 1, rows - 1) && !overlaps; ++j) {
+            for (int i = std::max(column - 1, 0); i <= std::min(column + 1, columns - 1); ++i) {
+                long long kept = cells[(size_t)j * columns + i];
+                if (kept >= 0 && std::abs(candidates[kept].x - candidate.x) < width && std::abs(candidates[kept].y - candidate.y) < height) {
+                    overlaps = true;
+                    break;
+                }
+            }
+        }
+        if (!overlaps) {
+            cells[(size_t)row * columns + column] = (long long)index;
+            isKept[index] = true;
+        }
+    }
+
+    size_t keptCount = 0;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (isKept[i]) {
+            candidates[keptCount++] = candidates[i];
+        }
+    }
+    candidates.resize(keptCount);
+}
+
+long long JSTFindImageInPixelImage(const JST_IMAGE *pixelImage, const JST_IMAGE *templateImage, int x1, int y1, int x2, int y2, const JST_FIND_IMAGE_OPTIONS *options, JST_FIND_IMAGE_MATCH *matches, long long maxMatches, JST_FIND_IMAGE_STATISTICS *statistics, JST_FIND_IMAGE_KERNEL kernel)
+{
+    JST_FIND_IMAGE_OPTIONS defaultOptions;
+    if (!options) {
+        JSTFindImageOptionsInit(&defaultOptions);
+        options = &defaultOptions;
+    }
+    kernel = JSTFindImageKernelResolve(kernel);
+    if (!JSTFindImageKernelIsSupported(kernel)) {
+        return -1;
+    }
+
+    int width, height, templateWidth, templateHeight;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
+    JSTGetOrientedSizeOfPixelImage(templateImage, &templateWidth, &templateHeight);
+    if (templateWidth <= 0 || templateHeight <= 0) {
+        return -1;
+    }
+    x1 = std::max(x1, 0);
+    y1 = std::max(y1, 0);
+    x2 = std::min(x2, width);
+    y2 = std::min(y2, height);
+
+    if (statistics) {
+        *statistics = JST_FIND_IMAGE_STATISTICS();
+    }
+    if (x2 - x1 < templateWidth || y2 - y1 < templateHeight) {
+        return 0;
+    }
+
+    JSTFindImageContext ctx;
+    ctx.positionWidth = x2 - x1 - templateWidth + 1;
+    ctx.positionHeight = y2 - y1 - templateHeight + 1;
+    const int tileRows = options->tileRows > 0 ? options->tileRows : kFindImageTileRows;
+    const int tileCount = (ctx.positionHeight + tileRows - 1) / tileRows;
+    std::vector<std::vector<JSTFindImageCandidate>> tiles;
+    try {
+        if (!JSTFindImageContextInit(ctx, pixelImage, templateImage, x1, y1, x2, y2, templateWidth, templateHeight, *options)) {
+            return -1;
+        }
+        tiles.resize(tileCount);
+    } catch (const std::bad_alloc &) {
+        return -1;
+    }
+
+    /* Threads take the next tile until none is left, and keep the matches
+     * of each tile apart so that they are merged in row order. */
+    std::atomic<int> nextTile(0);
+    std::atomic<bool> isOutOfMemory(false);
+    std::atomic<long long> counts[JST_FIND_IMAGE_MAX_LEVEL + 1];
+    for (std::atomic<long long> &count : counts) {
+        count.store(0);
+    }
+    auto perform = [&] {
+        long long localCounts[JST_FIND_IMAGE_MAX_LEVEL + 1] = {};
+        for (;;) {
+            int tile = nextTile.fetch_add(1, std::memory_order_relaxed);
+            if (tile >= tileCount || isOutOfMemory.load(std::memory_order_relaxed)) {
+                break;
+            }
+            int tileY1 = tile * tileRows;
+            int tileY2 = std::min(tileY1 + tileRows, ctx.positionHeight);
+            try {
+                JSTFindImagePerformRows(ctx, kernel, tileY1, tileY2, tiles[tile], localCounts);
+            } catch (const std::bad_alloc &) {
+                isOutOfMemory.store(true);
+                break;
+            }
+        }
+        for (int level = 0; level <= JST_FIND_IMAGE_MAX_LEVEL; ++level) {
+            counts[level].fetch_add(localCounts[level], std::memory_order_relaxed);
+        }
+    };
+
+    int threadCount = options->threadCount > 0 ? options->threadCount : (int)std::thread::hardware_concurrency();
+    threadCount = std::max(std::min(threadCount, tileCount), 1);
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; ++i) {
+        try {
+            threads.emplace_back(perform);
+        } catch (...) {
+            /* fewer workers take more tiles each */
+            break;
+        }
+    }
+    perform();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    if (isOutOfMemory.load()) {
+        return -1;
+    }
+
+    std::vector<JSTFindImageCandidate> candidates;
+    try {
+        size_t candidateCount = 0;
+        for (const auto &tile : tiles) {
+            candidateCount += tile.size();
+        }
+        candidates.reserve(candidateCount);
+        for (auto &tile : tiles) {
+            candidates.insert(candidates.end(), tile.begin(), tile.end());
+            std::vector<JSTFindImageCandidate>().swap(tile);
+        }
+        if (statistics) {
+            statistics->levelCount = (int)ctx.levels.size() - 1;
+            statistics->positionCount = (long long)ctx.positionWidth * ctx.positionHeight;
+            for (int level = 0; level <= JST_FIND_IMAGE_MAX_LEVEL; ++level) {
+                statistics->candidateCounts[level] = counts[level].load();
+            }
+            statistics->matchCount = (long long)candidates.size();
+        }
+        if (!options->keepsOverlaps) {
+            JSTFindImageDropOverlaps(candidates, templateWidth, templateHeight, ctx.positionWidth, ctx.positionHeight);
+        }
+    } catch (const std::bad_alloc &) {
+        return -1;
+    }
+
+    const double sampleCount = 3.0 * templateWidth * templateHeight;
+    long long matchCount = (long long)candidates.size();
+    if (matches) {
+        for (long long i = 0; i < std::min(matchCount, maxMatches); ++i) {
+            matches[i].x = candidates[i].x + x1;
+            matches[i].y = candidates[i].y + y1;
+            matches[i].similarity = 1.0 - std::sqrt(candidates[i].difference / sampleCount) / 255.0;
+        }
+    }
+    return matchCount;
+}
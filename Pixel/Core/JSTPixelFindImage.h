@@ -0,0 +1,86 @@
+#ifndef JSTPixelFindImage_h
+#define JSTPixelFindImage_h
+
+#include "JSTPixelCore.h"
+
+/* Sub-image search, as done by find_image on the device: every position of
+ * a template image within a region of an image is scored by the sum of
+ * squared differences (SSD) of their red, green and blue channels, alpha
+ * being ignored, and matches if its similarity reaches a threshold:
+ *
+ *     similarity = 1 - sqrt(SSD / (3 * width * height)) / 255
+ *
+ * that is one minus the root mean square difference of a channel.
+ *
+ * The search runs coarse to fine over image pyramids whose levels keep the
+ * sums of 2x2, then 4x4 blocks of pixels. For every position, the template
+ * is summed over the blocks of the image it fully covers, and since the
+ * square of a sum of n differences is at most n times the sum of their
+ * squares, the SSD of those sums bounds the SSD of the position from below.
+ * Positions are only compared at the next level if their bound passes the
+ * threshold, so pyramids never lose a match and results are exactly those
+ * of a brute force search.
+ *
+ * Kernels compute the SSD of a row several channels at a time, and rows of
+ * positions are split into tiles shared between threads. */
+
+typedef enum JST_FIND_IMAGE_KERNEL {
+    JST_FIND_IMAGE_KERNEL_AUTOMATIC = 0,
+    JST_FIND_IMAGE_KERNEL_SCALAR,
+    JST_FIND_IMAGE_KERNEL_SSE2,
+    JST_FIND_IMAGE_KERNEL_AVX2,
+    JST_FIND_IMAGE_KERNEL_NEON,
+} JST_FIND_IMAGE_KERNEL;
+
+/* Deepest pyramid level, blocks of 4x4 pixels. */
+#define JST_FIND_IMAGE_MAX_LEVEL 2
+
+typedef struct JST_FIND_IMAGE_OPTIONS {
+    double similarity;             /* threshold (0 to 1), 1 only matches identical pixels */
+    int levelCount;                /* coarse levels to prune with, up to JST_FIND_IMAGE_MAX_LEVEL; negative to pick them by template size */
+    int threadCount;               /* 0 for one per processor */
+    int tileRows;                  /* rows of positions per tile, 0 for automatic */
+    JST_BOOL keepsOverlaps;        /* keep every matching position instead of the best one of each overlapping group */
+} JST_FIND_IMAGE_OPTIONS;
+
+/* Position of the top left corner of a match, as seen by the user. */
+typedef struct JST_FIND_IMAGE_MATCH {
+    int x;
+    int y;
+    double similarity;
+} JST_FIND_IMAGE_MATCH;
+
+/* What a search cost, level by level. */
+typedef struct JST_FIND_IMAGE_STATISTICS {
+    int levelCount;                                             /* coarse levels used */
+    long long positionCount;                                    /* positions of the template within the region */
+    long long candidateCounts[JST_FIND_IMAGE_MAX_LEVEL + 1];    /* positions compared at each level, the full resolution first */
+    long long matchCount;                                       /* positions passing the threshold, overlaps included */
+} JST_FIND_IMAGE_STATISTICS;
+
+/* similarity 0.95, pyramid levels picked by template size, one thread per
+ * processor, overlapping matches reduced to the best one. */
+JST_EXTERN void JSTFindImageOptionsInit(JST_FIND_IMAGE_OPTIONS *options);
+
+/* Whether the kernel can run on this machine. Automatic and scalar kernels
+ * are always supported. */
+JST_EXTERN JST_BOOL JSTFindImageKernelIsSupported(JST_FIND_IMAGE_KERNEL kernel);
+
+/* Name of the kernel the automatic selection resolves to. */
+JST_EXTERN const char *JSTFindImageKernelGetName(JST_FIND_IMAGE_KERNEL kernel);
+
+/* Largest SSD of a width x height template which still reaches similarity. */
+JST_EXTERN long long JSTFindImageGetMaximumDifference(int width, int height, double similarity);
+
+/* Searches the oriented image for the oriented template lying entirely
+ * within [x1, x2) x [y1, y2), clamped to the image.
+ * Unless overlaps are kept, matches are taken from the most similar one,
+ * the first in row order among equals, and dropped if they overlap one
+ * which was taken before.
+ * Writes the first maxMatches matches into matches, in row order, and
+ * fills statistics unless it is NULL.
+ * Returns the number of matches, which may exceed maxMatches, or -1 if the
+ * template is empty, the kernel is not supported or memory ran out. */
+JST_EXTERN long long JSTFindImageInPixelImage(const JST_IMAGE *pixelImage, const JST_IMAGE *templateImage, int x1, int y1, int x2, int y2, const JST_FIND_IMAGE_OPTIONS *options, JST_FIND_IMAGE_MATCH *matches, long long maxMatches, JST_FIND_IMAGE_STATISTICS *statistics, JST_FIND_IMAGE_KERNEL kernel);
+
+#endif /* JSTPixelFindImage_h */
@@ -0,0 +1,57 @@
+#include "JSTPixelFindImage.h"
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+
+#include <algorithm>
+#include <immintrin.h>
+
+/* Everything below, including the driver template from the private header,
+ * is compiled for AVX2. It is only called after a runtime CPU check. */
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "JSTPixelFindImage+Private.h"
+
+struct JSTFindImageAVX2 {
+    static JST_FIND_IMAGE_INLINE long long rowDifference(const int16_t *a, const int16_t *b, int count) {
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i sum64 = zero;
+        int i = 0;
+        while (i + 16 <= count) {
+            /* 32 vectors of squares fit the 32-bit lanes at any level */
+            int end = std::min(count - 15, i + 16 * 32);
+            __m256i sum32 = zero;
+            for (; i < end; i += 16) {
+                __m256i difference = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+                sum32 = _mm256_add_epi32(sum32, _mm256_madd_epi16(difference, difference));
+            }
+            sum64 = _mm256_add_epi64(sum64, _mm256_unpacklo_epi32(sum32, zero));
+            sum64 = _mm256_add_epi64(sum64, _mm256_unpackhi_epi32(sum32, zero));
+        }
+        long long lanes[4];
+        _mm256_storeu_si256((__m256i *)lanes, sum64);
+        long long sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        for (; i < count; ++i) {
+            int difference = a[i] - b[i];
+            sum += difference * difference;
+        }
+        return sum;
+    }
+};
+
+void JSTFindImageRowsAVX2(const JSTFindImageContext &ctx, int y1, int y2, std::vector<JSTFindImageCandidate> &candidates, long long *counts)
+{
+    JSTFindImageRows<JSTFindImageAVX2>(ctx, y1, y2, candidates, counts);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif /* __SSE2__ */
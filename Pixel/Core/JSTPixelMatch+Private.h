@@ -0,0 +1,384 @@
+#ifndef JSTPixelMatch_Private_h
+#define JSTPixelMatch_Private_h
+
+#include "JSTPixelMatch.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/* The double precision path must round exactly like the reference of the
+ * tests, which never fuses a multiply and an add. GCC ignores this pragma, the CMake
+ * project passes -ffp-contract=off instead. */
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+#if defined(__SSE2__)
+#define JST_PIXEL_MATCH_HAS_SSE2 1
+#if defined(__GNUC__) || defined(__clang__)
+#define JST_PIXEL_MATCH_HAS_AVX2 1
+#endif
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define JST_PIXEL_MATCH_HAS_NEON 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define JST_PIXEL_MATCH_INLINE inline __attribute__((always_inline))
+#else
+#define JST_PIXEL_MATCH_INLINE inline
+#endif
+
+
+struct JSTPixelMatchContext {
+    const JST_COLOR *pixels1;
+    const JST_COLOR *pixels2;
+    JST_COLOR *output;  /* NULL if only counting */
+    ptrdiff_t stride1;
+    ptrdiff_t stride2;
+    ptrdiff_t outputStride;
+    int width;
+    int height;
+
+    /* maximum acceptable square distance between two colors */
+    double maxDelta;
+
+    /* single precision deltas above this one are evaluated again in double
+     * precision, the margin is far above the rounding error of the kernels */
+    float candidateDelta;
+
+    double alpha;
+    bool includeAA;
+    bool diffMask;
+    uint32_t aaColor;
+    uint32_t diffColor;
+};
+
+
+/* MARK: - Reference */
+
+/* Coefficients of the YIQ metric, shared by every kernel. */
+#define JST_PIXEL_MATCH_Y_R 0.29889531
+#define JST_PIXEL_MATCH_Y_G 0.58662247
+#define JST_PIXEL_MATCH_Y_B 0.11448223
+#define JST_PIXEL_MATCH_I_R 0.59597799
+#define JST_PIXEL_MATCH_I_G 0.27417610
+#define JST_PIXEL_MATCH_I_B 0.32180189
+#define JST_PIXEL_MATCH_Q_R 0.21147017
+#define JST_PIXEL_MATCH_Q_G 0.52261711
+#define JST_PIXEL_MATCH_Q_B 0.31114694
+#define JST_PIXEL_MATCH_DELTA_Y 0.5053
+#define JST_PIXEL_MATCH_DELTA_I 0.299
+#define JST_PIXEL_MATCH_DELTA_Q 0.1957
+
+static JST_PIXEL_MATCH_INLINE double JSTPixelMatchRGB2Y(double r, double g, double b)
+{
+    return (r * JST_PIXEL_MATCH_Y_R) + (g * JST_PIXEL_MATCH_Y_G) + (b * JST_PIXEL_MATCH_Y_B);
+}
+
+static JST_PIXEL_MATCH_INLINE double JSTPixelMatchRGB2I(double r, double g, double b)
+{
+    return (r * JST_PIXEL_MATCH_I_R) - (g * JST_PIXEL_MATCH_I_G) - (b * JST_PIXEL_MATCH_I_B);
+}
+
+static JST_PIXEL_MATCH_INLINE double JSTPixelMatchRGB2Q(double r, double g, double b)
+{
+    return (r * JST_PIXEL_MATCH_Q_R) - (g * JST_PIXEL_MATCH_Q_G) + (b * JST_PIXEL_MATCH_Q_B);
+}
+
+/* blend semi-transparent color with white */
+static JST_PIXEL_MATCH_INLINE double JSTPixelMatchBlend(double component, double alpha)
+{
+    return 255.0 + (component - 255.0) * alpha;
+}
+
+static JST_PIXEL_MATCH_INLINE uint32_t JSTPixelMatchPackColor(uint8_t r, uint8_t g, uint8_t b)
+{
+    /* same layout as drawPixel in the reference of the tests */
+    return 0xff000000u | (uint32_t)b << 16 | (uint32_t)g << 8 | (uint32_t)r;
+}
+
+static JST_PIXEL_MATCH_INLINE uint32_t JSTPixelMatchGrayColor(JST_COLOR color, double alpha)
+{
+    double y = JSTPixelMatchRGB2Y(color.red, color.green, color.blue);
+    uint8_t value = (uint8_t)JSTPixelMatchBlend(y, alpha * (double)color.alpha / 255.0);  /* truncated, like UInt8(_:) */
+    return JSTPixelMatchPackColor(value, value, value);
+}
+
+/* calculate color difference according to the paper "Measuring perceived color difference
+ * using YIQ NTSC transmission color space in mobile applications" by Y. Kotsarenko and F. Ramos */
+static inline double JSTPixelMatchColorDelta(JST_COLOR color1, JST_COLOR color2, bool yOnly)
+{
+    if (color1.theColor == color2.theColor) {
+        return 0;
+    }
+
+    double a1 = color1.alpha, r1 = color1.red, g1 = color1.green, b1 = color1.blue;
+    double a2 = color2.alpha, r2 = color2.red, g2 = color2.green, b2 = color2.blue;
+
+    if (a1 < 255.0) {
+        a1 /= 255.0;
+        r1 = JSTPixelMatchBlend(r1, a1);
+        g1 = JSTPixelMatchBlend(g1, a1);
+        b1 = JSTPixelMatchBlend(b1, a1);
+    }
+
+    if (a2 < 255.0) {
+        a2 /= 255.0;
+        r2 = JSTPixelMatchBlend(r2, a2);
+        g2 = JSTPixelMatchBlend(g2, a2);
+        b2 = JSTPixelMatchBlend(b2, a2);
+    }
+
+    double y = JSTPixelMatchRGB2Y(r1, g1, b1) - JSTPixelMatchRGB2Y(r2, g2, b2);
+    if (yOnly) {
+        return y;
+    }
+    double i = JSTPixelMatchRGB2I(r1, g1, b1) - JSTPixelMatchRGB2I(r2, g2, b2);
+    double q = JSTPixelMatchRGB2Q(r1, g1, b1) - JSTPixelMatchRGB2Q(r2, g2, b2);
+
+    return JST_PIXEL_MATCH_DELTA_Y * y * y + JST_PIXEL_MATCH_DELTA_I * i * i + JST_PIXEL_MATCH_DELTA_Q * q * q;
+}
+
+static inline bool JSTPixelMatchHasManySiblings(const JST_COLOR *img, ptrdiff_t stride, int x1, int y1, int width, int height)
+{
+    int x0 = std::max(x1 - 1, 0), y0 = std::max(y1 - 1, 0);
+    int x2 = std::min(x1 + 1, width - 1), y2 = std::min(y1 + 1, height - 1);
+    uint32_t center = img[y1 * stride + x1].theColor;
+    int zeroes = x1 == x0 || x1 == x2 || y1 == y0 || y1 == y2 ? 1 : 0;
+
+    /* go through 8 adjacent pixels */
+    for (int x = x0; x <= x2; ++x) {
+        for (int y = y0; y <= y2; ++y) {
+            if (x == x1 && y == y1) {
+                continue;
+            }
+            if (center == img[y * stride + x].theColor) {
+                zeroes += 1;
+            }
+            if (zeroes > 2) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* check if a pixel is likely a part of anti-aliasing;
+ * based on "Anti-aliased Pixel and Intensity Slope Detector" paper by V. Vysniauskas, 2009 */
+static inline bool JSTPixelMatchAntialiased(const JST_COLOR *img, ptrdiff_t stride, const JST_COLOR *img2, ptrdiff_t stride2, int x1, int y1, int width, int height)
+{
+    int x0 = std::max(x1 - 1, 0), y0 = std::max(y1 - 1, 0);
+    int x2 = std::min(x1 + 1, width - 1), y2 = std::min(y1 + 1, height - 1);
+    JST_COLOR center = img[y1 * stride + x1];
+    int zeroes = x1 == x0 || x1 == x2 || y1 == y0 || y1 == y2 ? 1 : 0;
+
+    double min = 0, max = 0;
+    int minX = 0, minY = 0, maxX = 0, maxY = 0;
+
+    /* go through 8 adjacent pixels */
+    for (int x = x0; x <= x2; ++x) {
+        for (int y = y0; y <= y2; ++y) {
+            if (x == x1 && y == y1) {
+                continue;
+            }
+
+            /* brightness delta between the center pixel and adjacent one */
+            double delta = JSTPixelMatchColorDelta(center, img[y * stride + x], true);
+
+            /* count the number of equal, darker and brighter adjacent pixels */
+            if (delta == 0) {
+                zeroes += 1;
+                /* if found more than 2 equal siblings, it's definitely not anti-aliasing */
+                if (zeroes > 2) {
+                    return false;
+                }
+            } else if (delta < min) {
+                /* remember the darkest pixel */
+                min = delta;
+                minX = x;
+                minY = y;
+            } else if (delta > max) {
+                /* remember the brightest pixel */
+                max = delta;
+                maxX = x;
+                maxY = y;
+            }
+        }
+    }
+
+    /* if there are no both darker and brighter pixels among siblings, it's not anti-aliasing */
+    if (min == 0 || max == 0) {
+        return false;
+    }
+
+    /* if either the darkest or the brightest pixel has 3+ equal siblings in both images
+     * (definitely not anti-aliased), this pixel is anti-aliased */
+    return (JSTPixelMatchHasManySiblings(img, stride, minX, minY, width, height) && JSTPixelMatchHasManySiblings(img2, stride2, minX, minY, width, height)) ||
+        (JSTPixelMatchHasManySiblings(img, stride, maxX, maxY, width, height) && JSTPixelMatchHasManySiblings(img2, stride2, maxX, maxY, width, height));
+}
+
+/* Classifies and draws one pixel exactly like the reference of the tests.
+ * Returns whether the pixel counts as different. */
+static inline bool JSTPixelMatchEvaluatePixel(const JSTPixelMatchContext &ctx, int x, int y)
+{
+    JST_COLOR color1 = ctx.pixels1[y * ctx.stride1 + x];
+    JST_COLOR color2 = ctx.pixels2[y * ctx.stride2 + x];
+    JST_COLOR *output = ctx.output ? ctx.output + y * ctx.outputStride + x : NULL;
+
+    /* squared YUV distance between colors at this pixel position */
+    double delta = JSTPixelMatchColorDelta(color1, color2, false);
+
+    /* the color difference is above the threshold */
+    if (delta > ctx.maxDelta) {
+        /* check it's a real rendering difference or just anti-aliasing */
+        if (!ctx.includeAA &&
+            (JSTPixelMatchAntialiased(ctx.pixels1, ctx.stride1, ctx.pixels2, ctx.stride2, x, y, ctx.width, ctx.height) ||
+             JSTPixelMatchAntialiased(ctx.pixels2, ctx.stride2, ctx.pixels1, ctx.stride1, x, y, ctx.width, ctx.height)))
+        {
+            /* one of the pixels is anti-aliasing; draw as yellow and do not count as difference,
+             * note that we do not include such pixels in a mask */
+            if (output && !ctx.diffMask) {
+                output->theColor = ctx.aaColor;
+            }
+            return false;
+        }
+
+        /* found substantial difference not caused by anti-aliasing; draw it as red */
+        if (output) {
+            output->theColor = ctx.diffColor;
+        }
+        return true;
+    }
+
+    /* pixels are similar; draw background as grayscale image blended with white */
+    if (output && !ctx.diffMask) {
+        output->theColor = JSTPixelMatchGrayColor(color1, ctx.alpha);
+    }
+    return false;
+}
+
+
+/* MARK: - Driver */
+
+/* A kernel provides, for N adjacent pixels:
+ *
+ *   static uint32_t candidates(const JST_COLOR *a, const JST_COLOR *b, float candidateDelta);
+ *       bit i set if pixel i differs and its single precision delta is
+ *       above candidateDelta
+ *   static void drawGray(const JST_COLOR *a, JST_COLOR *output, double alpha);
+ *       JSTPixelMatchGrayColor of every pixel, bit exact
+ *
+ * Candidates are then evaluated one by one with the reference path.
+ *
+ * If diffFlags is not NULL, the byte of every different pixel is set to 1
+ * in it, row y at diffFlags + (y - y1) * width. Other bytes are left as they
+ * are, so the caller clears them. */
+template <typename Kernel>
+static inline long long JSTPixelMatchRows(const JSTPixelMatchContext &ctx, int y1, int y2, uint8_t *diffFlags)
+{
+    const int N = Kernel::N;
+    const bool drawsGray = ctx.output && !ctx.diffMask;
+    long long diff = 0;
+    for (int y = y1; y < y2; ++y) {
+        const JST_COLOR *row1 = ctx.pixels1 + y * ctx.stride1;
+        const JST_COLOR *row2 = ctx.pixels2 + y * ctx.stride2;
+        uint8_t *flagsRow = diffFlags ? diffFlags + (ptrdiff_t)(y - y1) * ctx.width : NULL;
+
+        int x = 0;
+        for (; x + N <= ctx.width; x += N) {
+            uint32_t mask = Kernel::candidates(row1 + x, row2 + x, ctx.candidateDelta);
+            if (drawsGray) {
+                Kernel::drawGray(row1 + x, ctx.output + y * ctx.outputStride + x, ctx.alpha);
+            }
+            while (mask) {
+                int lane = __builtin_ctz(mask);
+                mask &= mask - 1;
+                if (JSTPixelMatchEvaluatePixel(ctx, x + lane, y)) {
+                    ++diff;
+                    if (flagsRow) {
+                        flagsRow[x + lane] = 1;
+                    }
+                }
+            }
+        }
+        for (; x < ctx.width; ++x) {
+            if (JSTPixelMatchEvaluatePixel(ctx, x, y)) {
+                ++diff;
+                if (flagsRow) {
+                    flagsRow[x] = 1;
+                }
+            }
+        }
+    }
+    return diff;
+}
+
+
+
+/* MARK: - Regions */
+
+/* Streaming connected component labelling over the tiles of a job.
+ *
+ * Each tile is labelled on its own from the runs of different pixels in its
+ * rows, with a local union-find. Its components are then appended to a
+ * shared union-find, and the runs of its first and last rows are kept so
+ * that they can be joined with the neighbouring tiles as soon as those are
+ * done too, in whatever order tiles finish. */
+class JSTPixelMatchRegionCollector {
+public:
+    explicit JSTPixelMatchRegionCollector(int tileCount);
+
+    /* Rows [y1, y2) of a finished tile, flags as written by the kernels. */
+    void addTile(int tile, int y1, int y2, int width, const uint8_t *diffFlags);
+
+    /* Gives up on regions, when a worker could not allocate its flags. */
+    void fail();
+
+    /* Resolves the shared union-find, once every tile has been added.
+     * Returns NULL if memory ran out while labelling. */
+    const std::vector<JST_PIXEL_MATCH_REGION> *regions();
+
+private:
+    struct Run {
+        int x1;
+        int x2;  /* inclusive */
+        int label;
+    };
+
+    struct Component {
+        int minX, minY, maxX, maxY;
+        long long pixelCount;
+        long long sumX, sumY;
+    };
+
+    struct TileEdges {
+        bool isDone;
+        int firstRow;
+        int lastRow;
+        std::vector<Run> firstRuns;
+        std::vector<Run> lastRuns;
+    };
+
+    static int find(std::vector<int> &parents, int label);
+    static void unite(std::vector<int> &parents, int label1, int label2);
+    static void uniteAdjacentRuns(std::vector<int> &parents, const std::vector<Run> &upper, const std::vector<Run> &lower);
+
+    std::mutex mutex;
+    std::vector<int> parents;
+    std::vector<Component> components;
+    std::vector<TileEdges> tiles;
+    std::vector<JST_PIXEL_MATCH_REGION> resolvedRegions;
+    bool isResolved;
+    bool hasFailed;
+};
+
+#if JST_PIXEL_MATCH_HAS_AVX2
+long long JSTPixelMatchRowsAVX2(const JSTPixelMatchContext &ctx, int y1, int y2, uint8_t *diffFlags);
+#endif
+
+#endif /* JSTPixelMatch_Private_h */
@@ -0,0 +1,555 @@
+#include "JSTPixelMatch+Private.h"
+#include "JSTPixelBlit.h"
+#include "JSTPixelStorage.h"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#if JST_PIXEL_MATCH_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if JST_PIXEL_MATCH_HAS_NEON
+#include <arm_neon.h>
+#endif
+
+
+/* MARK: - Kernels */
+
+#if JST_PIXEL_MATCH_HAS_SSE2
+struct JSTPixelMatchKernelSSE2 {
+    static const int N = 4;
+
+    static JST_PIXEL_MATCH_INLINE void unpack(__m128i pixels, __m128 &r, __m128 &g, __m128 &b) {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        __m128 a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(pixels, 24)), _mm_set1_ps(1.0f / 255.0f));
+
+        /* blending an opaque pixel with white leaves it as is */
+        const __m128 white = _mm_set1_ps(255.0f);
+        b = _mm_add_ps(white, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(pixels, mask)), white), a));
+        g = _mm_add_ps(white, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), mask)), white), a));
+        r = _mm_add_ps(white, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), mask)), white), a));
+    }
+
+    static JST_PIXEL_MATCH_INLINE __m128 dot(__m128 r, __m128 g, __m128 b, float cr, float cg, float cb) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(cr)), _mm_mul_ps(g, _mm_set1_ps(cg))), _mm_mul_ps(b, _mm_set1_ps(cb)));
+    }
+
+    static JST_PIXEL_MATCH_INLINE uint32_t candidates(const JST_COLOR *a, const JST_COLOR *b, float candidateDelta) {
+        __m128i p1 = _mm_loadu_si128((const __m128i *)a);
+        __m128i p2 = _mm_loadu_si128((const __m128i *)b);
+
+        __m128 r1, g1, b1, r2, g2, b2;
+        unpack(p1, r1, g1, b1);
+        unpack(p2, r2, g2, b2);
+
+        /* the metric is linear, so the channel differences are converted directly */
+        __m128 dr = _mm_sub_ps(r1, r2), dg = _mm_sub_ps(g1, g2), db = _mm_sub_ps(b1, b2);
+        __m128 y = dot(dr, dg, db, (float)JST_PIXEL_MATCH_Y_R, (float)JST_PIXEL_MATCH_Y_G, (float)JST_PIXEL_MATCH_Y_B);
+        __m128 i = dot(dr, dg, db, (float)JST_PIXEL_MATCH_I_R, -(float)JST_PIXEL_MATCH_I_G, -(float)JST_PIXEL_MATCH_I_B);
+        __m128 q = dot(dr, dg, db, (float)JST_PIXEL_MATCH_Q_R, -(float)JST_PIXEL_MATCH_Q_G, (float)JST_PIXEL_MATCH_Q_B);
+        __m128 delta = dot(_mm_mul_ps(y, y), _mm_mul_ps(i, i), _mm_mul_ps(q, q), (float)JST_PIXEL_MATCH_DELTA_Y, (float)JST_PIXEL_MATCH_DELTA_I, (float)JST_PIXEL_MATCH_DELTA_Q);
+
+        __m128 above = _mm_cmpgt_ps(delta, _mm_set1_ps(candidateDelta));
+        __m128 equal = _mm_castsi128_ps(_mm_cmpeq_epi32(p1, p2));
+        return (uint32_t)_mm_movemask_ps(_mm_andnot_ps(equal, above));
+    }
+
+    static JST_PIXEL_MATCH_INLINE __m128i gray2(__m128i r, __m128i g, __m128i b, __m128i a, __m128d alpha) {
+        const __m128d white = _mm_set1_pd(255.0);
+        __m128d y = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(r), _mm_set1_pd(JST_PIXEL_MATCH_Y_R)),
+                                          _mm_mul_pd(_mm_cvtepi32_pd(g), _mm_set1_pd(JST_PIXEL_MATCH_Y_G))),
+                               _mm_mul_pd(_mm_cvtepi32_pd(b), _mm_set1_pd(JST_PIXEL_MATCH_Y_B)));
+        __m128d opacity = _mm_div_pd(_mm_mul_pd(alpha, _mm_cvtepi32_pd(a)), white);
+        return _mm_cvttpd_epi32(_mm_add_pd(white, _mm_mul_pd(_mm_sub_pd(y, white), opacity)));
+    }
+
+    static JST_PIXEL_MATCH_INLINE void drawGray(const JST_COLOR *a, JST_COLOR *output, double alpha) {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        __m128i pixels = _mm_loadu_si128((const __m128i *)a);
+        __m128i b = _mm_and_si128(pixels, mask);
+        __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+        __m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask);
+        __m128i o = _mm_srli_epi32(pixels, 24);
+
+        __m128d alphas = _mm_set1_pd(alpha);
+        __m128i lo = gray2(r, g, b, o, alphas);
+        __m128i hi = gray2(_mm_srli_si128(r, 8), _mm_srli_si128(g, 8), _mm_srli_si128(b, 8), _mm_srli_si128(o, 8), alphas);
+        __m128i value = _mm_unpacklo_epi64(lo, hi);
+
+        __m128i gray = _mm_or_si128(_mm_or_si128(value, _mm_slli_epi32(value, 8)),
+                                    _mm_or_si128(_mm_slli_epi32(value, 16), _mm_set1_epi32((int)0xff000000)));
+        _mm_storeu_si128((__m128i *)output, gray);
+    }
+};
+#endif
+
+#if JST_PIXEL_MATCH_HAS_NEON
+struct JSTPixelMatchKernelNEON {
+    static const int N = 4;
+
+    static JST_PIXEL_MATCH_INLINE void unpack(uint32x4_t pixels, float32x4_t &r, float32x4_t &g, float32x4_t &b) {
+        const uint32x4_t mask = vdupq_n_u32(0xff);
+        float32x4_t a = vmulq_n_f32(vcvtq_f32_u32(vshrq_n_u32(pixels, 24)), 1.0f / 255.0f);
+
+        /* blending an opaque pixel with white leaves it as is */
+        const float32x4_t white = vdupq_n_f32(255.0f);
+        b = vaddq_f32(white, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vandq_u32(pixels, mask)), white), a));
+        g = vaddq_f32(white, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(pixels, 8), mask)), white), a));
+        r = vaddq_f32(white, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(pixels, 16), mask)), white), a));
+    }
+
+    static JST_PIXEL_MATCH_INLINE float32x4_t dot(float32x4_t r, float32x4_t g, float32x4_t b, float cr, float cg, float cb) {
+        return vaddq_f32(vaddq_f32(vmulq_n_f32(r, cr), vmulq_n_f32(g, cg)), vmulq_n_f32(b, cb));
+    }
+
+    static JST_PIXEL_MATCH_INLINE uint32_t candidates(const JST_COLOR *a, const JST_COLOR *b, float candidateDelta) {
+        uint32x4_t p1 = vld1q_u32((const uint32_t *)a);
+        uint32x4_t p2 = vld1q_u32((const uint32_t *)b);
+
+        float32x4_t r1, g1, b1, r2, g2, b2;
+        unpack(p1, r1, g1, b1);
+        unpack(p2, r2, g2, b2);
+
+        /* the metric is linear, so the channel differences are converted directly */
+        float32x4_t dr = vsubq_f32(r1, r2), dg = vsubq_f32(g1, g2), db = vsubq_f32(b1, b2);
+        float32x4_t y = dot(dr, dg, db, (float)JST_PIXEL_MATCH_Y_R, (float)JST_PIXEL_MATCH_Y_G, (float)JST_PIXEL_MATCH_Y_B);
+        float32x4_t i = dot(dr, dg, db, (float)JST_PIXEL_MATCH_I_R, -(float)JST_PIXEL_MATCH_I_G, -(float)JST_PIXEL_MATCH_I_B);
+        float32x4_t q = dot(dr, dg, db, (float)JST_PIXEL_MATCH_Q_R, -(float)JST_PIXEL_MATCH_Q_G, (float)JST_PIXEL_MATCH_Q_B);
+        float32x4_t delta = dot(vmulq_f32(y, y), vmulq_f32(i, i), vmulq_f32(q, q), (float)JST_PIXEL_MATCH_DELTA_Y, (float)JST_PIXEL_MATCH_DELTA_I, (float)JST_PIXEL_MATCH_DELTA_Q);
+
+        uint32x4_t above = vcgtq_f32(delta, vdupq_n_f32(candidateDelta));
+        uint32x4_t lanes = vbicq_u32(above, vceqq_u32(p1, p2));
+        static const uint32_t bits[4] = { 1, 2, 4, 8 };
+        return vaddvq_u32(vandq_u32(lanes, vld1q_u32(bits)));
+    }
+
+    static JST_PIXEL_MATCH_INLINE uint32x2_t gray2(uint32x2_t r, uint32x2_t g, uint32x2_t b, uint32x2_t a, float64x2_t alpha) {
+        const float64x2_t white = vdupq_n_f64(255.0);
+        float64x2_t y = vaddq_f64(vaddq_f64(vmulq_n_f64(vcvtq_f64_u64(vmovl_u32(r)), JST_PIXEL_MATCH_Y_R),
+                                            vmulq_n_f64(vcvtq_f64_u64(vmovl_u32(g)), JST_PIXEL_MATCH_Y_G)),
+                                  vmulq_n_f64(vcvtq_f64_u64(vmovl_u32(b)), JST_PIXEL_MATCH_Y_B));
+        float64x2_t opacity = vdivq_f64(vmulq_f64(alpha, vcvtq_f64_u64(vmovl_u32(a))), white);
+        return vmovn_u64(vcvtq_u64_f64(vaddq_f64(white, vmulq_f64(vsubq_f64(y, white), opacity))));
+    }
+
+    static JST_PIXEL_MATCH_INLINE void drawGray(const JST_COLOR *a, JST_COLOR *output, double alpha) {
+        const uint32x4_t mask = vdupq_n_u32(0xff);
+        uint32x4_t pixels = vld1q_u32((const uint32_t *)a);
+        uint32x4_t b = vandq_u32(pixels, mask);
+        uint32x4_t g = vandq_u32(vshrq_n_u32(pixels, 8), mask);
+        uint32x4_t r = vandq_u32(vshrq_n_u32(pixels, 16), mask);
+        uint32x4_t o = vshrq_n_u32(pixels, 24);
+
+        float64x2_t alphas = vdupq_n_f64(alpha);
+        uint32x4_t value = vcombine_u32(gray2(vget_low_u32(r), vget_low_u32(g), vget_low_u32(b), vget_low_u32(o), alphas),
+                                        gray2(vget_high_u32(r), vget_high_u32(g), vget_high_u32(b), vget_high_u32(o), alphas));
+        vst1q_u32((uint32_t *)output, vorrq_u32(vmulq_n_u32(value, 0x010101), vdupq_n_u32(0xff000000)));
+    }
+};
+#endif
+
+static long long JSTPixelMatchRowsScalar(const JSTPixelMatchContext &ctx, int y1, int y2, uint8_t *diffFlags)
+{
+    long long diff = 0;
+    for (int y = y1; y < y2; ++y) {
+        uint8_t *flagsRow = diffFlags ? diffFlags + (ptrdiff_t)(y - y1) * ctx.width : NULL;
+        for (int x = 0; x < ctx.width; ++x) {
+            if (JSTPixelMatchEvaluatePixel(ctx, x, y)) {
+                ++diff;
+                if (flagsRow) {
+                    flagsRow[x] = 1;
+                }
+            }
+        }
+    }
+    return diff;
+}
+
+#if JST_PIXEL_MATCH_HAS_SSE2
+static long long JSTPixelMatchRowsSSE2(const JSTPixelMatchContext &ctx, int y1, int y2, uint8_t *diffFlags)
+{
+    return JSTPixelMatchRows<JSTPixelMatchKernelSSE2>(ctx, y1, y2, diffFlags);
+}
+#endif
+
+#if JST_PIXEL_MATCH_HAS_NEON
+static long long JSTPixelMatchRowsNEON(const JSTPixelMatchContext &ctx, int y1, int y2, uint8_t *diffFlags)
+{
+    return JSTPixelMatchRows<JSTPixelMatchKernelNEON>(ctx, y1, y2, diffFlags);
+}
+#endif
+
+
+/* MARK: - Dispatch */
+
+static JST_PIXEL_MATCH_KERNEL JSTPixelMatchKernelResolve(JST_PIXEL_MATCH_KERNEL kernel)
+{
+    if (kernel != JST_PIXEL_MATCH_KERNEL_AUTOMATIC) {
+        return kernel;
+    }
+#if JST_PIXEL_MATCH_HAS_NEON
+    return JST_PIXEL_MATCH_KERNEL_NEON;
+#else
+    static const JST_PIXEL_MATCH_KERNEL bestKernel = JSTPixelMatchKernelIsSupported(JST_PIXEL_MATCH_KERNEL_AVX2)
+        ? JST_PIXEL_MATCH_KERNEL_AVX2
+        : (JSTPixelMatchKernelIsSupported(JST_PIXEL_MATCH_KERNEL_SSE2) ? JST_PIXEL_MATCH_KERNEL_SSE2 : JST_PIXEL_MATCH_KERNEL_SCALAR);
+    return bestKernel;
+#endif
+}
+
+void JSTPixelMatchOptionsInit(JST_PIXEL_MATCH_OPTIONS *options)
+{
+    options->threshold = 0.1;
+    options->includeAA = false;
+    options->alpha = 0.5;
+    options->aaColor[0] = 255;
+    options->aaColor[1] = 255;
+    options->aaColor[2] = 0;
+    options->diffColor[0] = 255;
+    options->diffColor[1] = 0;
+    options->diffColor[2] = 0;
+    options->diffMask = false;
+    options->diffBudget = -1;
+}
+
+JST_BOOL JSTPixelMatchKernelIsSupported(JST_PIXEL_MATCH_KERNEL kernel)
+{
+    switch (kernel) {
+    case JST_PIXEL_MATCH_KERNEL_AUTOMATIC:
+    case JST_PIXEL_MATCH_KERNEL_SCALAR:
+        return true;
+    case JST_PIXEL_MATCH_KERNEL_SSE2:
+#if JST_PIXEL_MATCH_HAS_SSE2
+        return true;
+#else
+        return false;
+#endif
+    case JST_PIXEL_MATCH_KERNEL_AVX2:
+#if JST_PIXEL_MATCH_HAS_AVX2
+        return __builtin_cpu_supports("avx2") ? true : false;
+#else
+        return false;
+#endif
+    case JST_PIXEL_MATCH_KERNEL_NEON:
+#if JST_PIXEL_MATCH_HAS_NEON
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char *JSTPixelMatchKernelGetName(JST_PIXEL_MATCH_KERNEL kernel)
+{
+    switch (JSTPixelMatchKernelResolve(kernel)) {
+    case JST_PIXEL_MATCH_KERNEL_SCALAR:
+        return "scalar";
+    case JST_PIXEL_MATCH_KERNEL_SSE2:
+        return "sse2";
+    case JST_PIXEL_MATCH_KERNEL_AVX2:
+        return "avx2";
+    case JST_PIXEL_MATCH_KERNEL_NEON:
+        return "neon";
+    default:
+        return "unknown";
+    }
+}
+
+static bool JSTPixelMatchContextInit(JSTPixelMatchContext &ctx, const JST_IMAGE *pixelImage1, const JST_IMAGE *pixelImage2, JST_IMAGE *outputImage, const JST_PIXEL_MATCH_OPTIONS *options)
+{
+    if (pixelImage1->width != pixelImage2->width || pixelImage1->height != pixelImage2->height) {
+        return false;
+    }
+    if (outputImage) {
+        if (pixelImage1->width != outputImage->width || pixelImage1->height != outputImage->height) {
+            return false;
+        }
+        if (!JSTPixelImageMakeUnique(outputImage)) {
+            return false;
+        }
+    }
+
+    JST_PIXEL_MATCH_OPTIONS defaultOptions;
+    if (!options) {
+        JSTPixelMatchOptionsInit(&defaultOptions);
+        options = &defaultOptions;
+    }
+
+    ctx.pixels1 = pixelImage1->pixels;
+    ctx.pixels2 = pixelImage2->pixels;
+    ctx.output = outputImage ? outputImage->pixels : NULL;
+    ctx.stride1 = pixelImage1->alignedWidth;
+    ctx.stride2 = pixelImage2->alignedWidth;
+    ctx.outputStride = outputImage ? outputImage->alignedWidth : 0;
+    ctx.width = pixelImage1->width;
+    ctx.height = pixelImage1->height;
+
+    /* maximum acceptable square distance between two colors;
+     * 35215 is the maximum possible value for the YIQ difference metric */
+    ctx.maxDelta = 35215 * options->threshold * options->threshold;
+    ctx.candidateDelta = (float)(ctx.maxDelta * (1.0 - 1e-4) - 1.0);
+
+    /* out of range opacities would not fit the gray channel */
+    ctx.alpha = std::min(std::max(options->alpha, 0.0), 1.0);
+    ctx.includeAA = options->includeAA;
+    ctx.diffMask = options->diffMask;
+    ctx.aaColor = JSTPixelMatchPackColor(options->aaColor[0], options->aaColor[1], options->aaColor[2]);
+    ctx.diffColor = JSTPixelMatchPackColor(options->diffColor[0], options->diffColor[1], options->diffColor[2]);
+    return true;
+}
+
+static long long JSTPixelMatchContextPerform(const JSTPixelMatchContext &ctx, JST_PIXEL_MATCH_KERNEL kernel, int y1, int y2, uint8_t *diffFlags = NULL)
+{
+    switch (kernel) {
+#if JST_PIXEL_MATCH_HAS_SSE2
+    case JST_PIXEL_MATCH_KERNEL_SSE2:
+        return JSTPixelMatchRowsSSE2(ctx, y1, y2, diffFlags);
+#endif
+#if JST_PIXEL_MATCH_HAS_AVX2
+    case JST_PIXEL_MATCH_KERNEL_AVX2:
+        return JSTPixelMatchRowsAVX2(ctx, y1, y2, diffFlags);
+#endif
+#if JST_PIXEL_MATCH_HAS_NEON
+    case JST_PIXEL_MATCH_KERNEL_NEON:
+        return JSTPixelMatchRowsNEON(ctx, y1, y2, diffFlags);
+#endif
+    default:
+        return JSTPixelMatchRowsScalar(ctx, y1, y2, diffFlags);
+    }
+}
+
+long long JSTPixelMatchPixelImages(const JST_IMAGE *pixelImage1, const JST_IMAGE *pixelImage2, JST_IMAGE *outputImage, int y1, int y2, const JST_PIXEL_MATCH_OPTIONS *options, JST_PIXEL_MATCH_KERNEL kernel)
+{
+    kernel = JSTPixelMatchKernelResolve(kernel);
+    if (!JSTPixelMatchKernelIsSupported(kernel)) {
+        return -1;
+    }
+
+    JSTPixelMatchContext ctx;
+    if (!JSTPixelMatchContextInit(ctx, pixelImage1, pixelImage2, outputImage, options)) {
+        return -1;
+    }
+
+    y1 = std::max(y1, 0);
+    y2 = std::min(y2, ctx.height);
+    if (y1 >= y2 || ctx.width == 0) {
+        return 0;
+    }
+    return JSTPixelMatchContextPerform(ctx, kernel, y1, y2);
+}
+
+
+/* MARK: - Jobs */
+
+/* Tiles of about this many pixels are large enough to amortise taking them
+ * and small enough to balance a few hundred of them between workers. */
+static const int kPixelMatchTilePixels = 1 << 15;
+
+struct JST_PIXEL_MATCH_JOB {
+    JSTPixelMatchContext ctx;
+    JST_PIXEL_MATCH_KERNEL kernel;
+    int tileRows;
+    int tileCount;
+    long long diffBudget;
+    std::atomic<int> nextTile;
+    std::atomic<long long> diffCount;
+    std::atomic<bool> budgetExceeded;
+    std::unique_ptr<JSTPixelMatchRegionCollector> regions;
+    JST_IMAGE *uprightImages[2] = { NULL, NULL };  /* copies of rotated images */
+};
+
+/* Rotated images are compared in an upright copy, so that the output and
+ * the regions are in the coordinates of the oriented image. */
+static const JST_IMAGE *JSTPixelMatchUprightImage(const JST_IMAGE *pixelImage, JST_IMAGE **uprightImage)
+{
+    *uprightImage = NULL;
+    if (pixelImage->orientation == 0) {
+        return pixelImage;
+    }
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
+    *uprightImage = JSTCreatePixelImage(width, height);
+    if (!*uprightImage) {
+        return NULL;
+    }
+    JSTBlitOrientedPixelsOfPixelImage(pixelImage, (*uprightImage)->pixels, (*uprightImage)->alignedWidth, JST_BLIT_KERNEL_AUTOMATIC);
+    return *uprightImage;
+}
+
+JST_PIXEL_MATCH_JOB *JSTPixelMatchJobCreate(const JST_IMAGE *pixelImage1, const JST_IMAGE *pixelImage2, JST_IMAGE *outputImage, const JST_PIXEL_MATCH_OPTIONS *options, JST_PIXEL_MATCH_KERNEL kernel, int tileRows)
+{
+    kernel = JSTPixelMatchKernelResolve(kernel);
+    if (!JSTPixelMatchKernelIsSupported(kernel)) {
+        return NULL;
+    }
+
+    JST_PIXEL_MATCH_JOB *job = new (std::nothrow) JST_PIXEL_MATCH_JOB;
+    if (!job) {
+        return NULL;
+    }
+    pixelImage1 = JSTPixelMatchUprightImage(pixelImage1, &job->uprightImages[0]);
+    pixelImage2 = pixelImage1 ? JSTPixelMatchUprightImage(pixelImage2, &job->uprightImages[1]) : NULL;
+    if (!pixelImage1 || !pixelImage2 || (outputImage && outputImage->orientation != 0) ||
+        !JSTPixelMatchContextInit(job->ctx, pixelImage1, pixelImage2, outputImage, options))
+    {
+        JSTPixelMatchJobFree(job);
+        return NULL;
+    }
+
+    if (tileRows <= 0) {
+        tileRows = std::max(kPixelMatchTilePixels / std::max(job->ctx.width, 1), 1);
+    }
+    job->kernel = kernel;
+    job->tileRows = tileRows;
+    job->tileCount = job->ctx.width > 0 ? (int)(((long long)job->ctx.height + tileRows - 1) / tileRows) : 0;
+    job->diffBudget = options ? options->diffBudget : -1;
+    job->nextTile.store(0);
+    job->diffCount.store(0);
+    job->budgetExceeded.store(false);
+    return job;
+}
+
+void JSTPixelMatchJobFree(JST_PIXEL_MATCH_JOB *job)
+{
+    JSTFreePixelImage(job->uprightImages[0]);
+    JSTFreePixelImage(job->uprightImages[1]);
+    delete job;
+}
+
+int JSTPixelMatchJobGetTileCount(const JST_PIXEL_MATCH_JOB *job)
+{
+    return job->tileCount;
+}
+
+/* Counts of a row are published as soon as it is done, so that every worker
+ * notices an exceeded budget before its next row. Rows up to *yDone were
+ * compared. */
+static bool JSTPixelMatchJobPerformRowsWithinBudget(JST_PIXEL_MATCH_JOB *job, int y1, int y2, uint8_t *diffFlags, int *yDone)
+{
+    for (int y = y1; y < y2; ++y) {
+        *yDone = y;
+        if (job->budgetExceeded.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        uint8_t *rowFlags = diffFlags ? diffFlags + (size_t)(y - y1) * job->ctx.width : NULL;
+        long long rowDiff = JSTPixelMatchContextPerform(job->ctx, job->kernel, y, y + 1, rowFlags);
+        if (rowDiff && job->diffCount.fetch_add(rowDiff, std::memory_order_relaxed) + rowDiff > job->diffBudget) {
+            *yDone = y + 1;
+            job->budgetExceeded.store(true, std::memory_order_relaxed);
+            return false;
+        }
+    }
+    *yDone = y2;
+    return true;
+}
+
+void JSTPixelMatchJobPerform(JST_PIXEL_MATCH_JOB *job)
+{
+    /* flags of the current tile, only while collecting regions */
+    std::unique_ptr<uint8_t[]> diffFlags;
+    size_t diffFlagsSize = (size_t)job->tileRows * job->ctx.width;
+    if (job->regions) {
+        diffFlags.reset(new (std::nothrow) uint8_t[diffFlagsSize]);
+        if (!diffFlags) {
+            /* still counts, but regions would miss this worker's tiles */
+            job->regions->fail();
+        }
+    }
+
+    for (;;) {
+        if (job->budgetExceeded.load(std::memory_order_relaxed)) {
+            break;
+        }
+        int tile = job->nextTile.fetch_add(1, std::memory_order_relaxed);
+        if (tile >= job->tileCount) {
+            break;
+        }
+        int y1 = tile * job->tileRows;
+        int y2 = (int)std::min((long long)y1 + job->tileRows, (long long)job->ctx.height);
+        if (diffFlags) {
+            memset(diffFlags.get(), 0, diffFlagsSize);
+        }
+        if (job->diffBudget >= 0) {
+            int yDone = y1;
+            bool isWithinBudget = JSTPixelMatchJobPerformRowsWithinBudget(job, y1, y2, diffFlags.get(), &yDone);
+            if (diffFlags) {
+                job->regions->addTile(tile, y1, yDone, job->ctx.width, diffFlags.get());
+            }
+            if (!isWithinBudget) {
+                break;
+            }
+        } else {
+            job->diffCount.fetch_add(JSTPixelMatchContextPerform(job->ctx, job->kernel, y1, y2, diffFlags.get()), std::memory_order_relaxed);
+            if (diffFlags) {
+                job->regions->addTile(tile, y1, y2, job->ctx.width, diffFlags.get());
+            }
+        }
+    }
+}
+
+void JSTPixelMatchJobPerformConcurrently(JST_PIXEL_MATCH_JOB *job, int threadCount)
+{
+    threadCount = std::min(threadCount, job->tileCount);
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; ++i) {
+        try {
+            threads.emplace_back(JSTPixelMatchJobPerform, job);
+        } catch (...) {
+            /* fewer workers take more tiles each */
+            break;
+        }
+    }
+    JSTPixelMatchJobPerform(job);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+long long JSTPixelMatchJobGetDiffCount(const JST_PIXEL_MATCH_JOB *job)
+{
+    return job->diffCount.load();
+}
+
+JST_BOOL JSTPixelMatchJobIsBudgetExceeded(const JST_PIXEL_MATCH_JOB *job)
+{
+    return job->budgetExceeded.load() ? true : false;
+}
+
+JST_BOOL JSTPixelMatchJobSetCollectsRegions(JST_PIXEL_MATCH_JOB *job, JST_BOOL collectsRegions)
+{
+    if (job->nextTile.load() > 0) {
+        return false;
+    }
+    if (!collectsRegions) {
+        job->regions.reset();
+        return true;
+    }
+    if (!job->regions) {
+        try {
+            job->regions.reset(new JSTPixelMatchRegionCollector(job->tileCount));
+        } catch (const std::bad_alloc &) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const JST_PIXEL_MATCH_REGION *JSTPixelMatchJobGetRegions(JST_PIXEL_MATCH_JOB *job, int *regionCount)
+{
+    *regionCount = 0;
+    if (!job->regions) {
+        return NULL;
+    }
+    const std::vector<JST_PIXEL_MATCH_REGION> *regions = job->regions->regions();
+    if (!regions) {
+        return NULL;
+    }
+    *regionCount = (int)regions->size();
+    return regions->data();
+}
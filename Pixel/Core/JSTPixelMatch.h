@@ -0,0 +1,116 @@
+#ifndef JSTPixelMatch_h
+#define JSTPixelMatch_h
+
+#include "JSTPixelCore.h"
+
+/* YIQ color difference with anti-aliasing detection, after
+ * https://github.com/mapbox/pixelmatch, which PixelMatch.swift used to
+ * implement in Swift.
+ *
+ * Kernels evaluate the YIQ delta of several pixels at a time in single
+ * precision. Pixels whose delta lands close to the threshold, and every
+ * pixel above it, are evaluated again in double precision exactly as the
+ * Swift implementation did, so all kernels classify and draw pixels
+ * identically to it, see the reference in Tests/JSTPixelMatchTests.cpp. */
+
+typedef enum JST_PIXEL_MATCH_KERNEL {
+    JST_PIXEL_MATCH_KERNEL_AUTOMATIC = 0,
+    JST_PIXEL_MATCH_KERNEL_SCALAR,
+    JST_PIXEL_MATCH_KERNEL_SSE2,
+    JST_PIXEL_MATCH_KERNEL_AVX2,
+    JST_PIXEL_MATCH_KERNEL_NEON,
+} JST_PIXEL_MATCH_KERNEL;
+
+/* Same fields and defaults as MatchOptions in PixelMatch.swift. */
+typedef struct JST_PIXEL_MATCH_OPTIONS {
+    double threshold;        /* matching threshold (0 to 1); smaller is more sensitive */
+    JST_BOOL includeAA;      /* whether to skip anti-aliasing detection */
+    double alpha;            /* opacity of original image in diff ouput */
+    uint8_t aaColor[3];      /* RGB color of anti-aliased pixels in diff output */
+    uint8_t diffColor[3];    /* RGB color of different pixels in diff output */
+    JST_BOOL diffMask;       /* draw the diff over a transparent background (a mask) */
+    long long diffBudget;    /* jobs stop once more pixels than this differ; negative for no limit */
+} JST_PIXEL_MATCH_OPTIONS;
+
+JST_EXTERN void JSTPixelMatchOptionsInit(JST_PIXEL_MATCH_OPTIONS *options);
+
+/* Whether the kernel can run on this machine. Automatic and scalar kernels
+ * are always supported. */
+JST_EXTERN JST_BOOL JSTPixelMatchKernelIsSupported(JST_PIXEL_MATCH_KERNEL kernel);
+
+/* Name of the kernel the automatic selection resolves to. */
+JST_EXTERN const char *JSTPixelMatchKernelGetName(JST_PIXEL_MATCH_KERNEL kernel);
+
+/* Compares rows [y1, y2) of two unrotated images of the same size and
+ * draws the diff into the same rows of outputImage, which must be of that
+ * size too. Pixels which are not drawn (in mask mode) are left untouched.
+ * A NULL outputImage only counts the different pixels.
+ * Neighbours used by the anti-aliasing detection may come from any row of
+ * the images.
+ * Returns the number of different pixels, or -1 if the sizes do not match
+ * or the kernel is not supported. */
+JST_EXTERN long long JSTPixelMatchPixelImages(const JST_IMAGE *pixelImage1, const JST_IMAGE *pixelImage2, JST_IMAGE *outputImage, int y1, int y2, const JST_PIXEL_MATCH_OPTIONS *options, JST_PIXEL_MATCH_KERNEL kernel);
+
+
+/* MARK: - Jobs */
+
+/* A connected region of different pixels, neighbours included diagonally. */
+typedef struct JST_PIXEL_MATCH_REGION {
+    int x;                   /* bounding box */
+    int y;
+    int width;
+    int height;
+    long long pixelCount;    /* number of different pixels in the region */
+    double centroidX;        /* mean coordinates of those pixels */
+    double centroidY;
+} JST_PIXEL_MATCH_REGION;
+
+/* A comparison of two whole images split into tiles of consecutive rows.
+ * Any number of workers may call JSTPixelMatchJobPerform concurrently, each
+ * one takes the next tile until none is left, so the images may have any
+ * height and faster workers simply process more tiles. Tiles read both
+ * images in place, neighbours of the anti-aliasing detection included, and
+ * write the same rows of a single output image. */
+typedef struct JST_PIXEL_MATCH_JOB JST_PIXEL_MATCH_JOB;
+
+/* The images and options must outlive the job. Rotated images are
+ * compared as oriented, through an upright copy made here, and the output
+ * and the regions are in oriented coordinates: outputImage must be of the
+ * oriented size, with no orientation of its own. A NULL outputImage only
+ * counts the different pixels. A tileRows of 0 picks a tile size suited to
+ * the image width.
+ * Returns NULL if the oriented sizes do not match or the kernel is not
+ * supported. */
+JST_EXTERN JST_PIXEL_MATCH_JOB *JSTPixelMatchJobCreate(const JST_IMAGE *pixelImage1, const JST_IMAGE *pixelImage2, JST_IMAGE *outputImage, const JST_PIXEL_MATCH_OPTIONS *options, JST_PIXEL_MATCH_KERNEL kernel, int tileRows);
+JST_EXTERN void JSTPixelMatchJobFree(JST_PIXEL_MATCH_JOB *job);
+
+/* Number of tiles, an upper bound for useful workers. */
+JST_EXTERN int JSTPixelMatchJobGetTileCount(const JST_PIXEL_MATCH_JOB *job);
+
+/* Processes tiles until every tile has been taken, safe to call from many
+ * threads at once. */
+JST_EXTERN void JSTPixelMatchJobPerform(JST_PIXEL_MATCH_JOB *job);
+
+/* Runs the job on threadCount threads, the calling one included, and
+ * returns once every tile is done. */
+JST_EXTERN void JSTPixelMatchJobPerformConcurrently(JST_PIXEL_MATCH_JOB *job, int threadCount);
+
+/* Number of different pixels found so far. Once the diff budget of the
+ * options is exceeded, workers stop and this is only a lower bound. */
+JST_EXTERN long long JSTPixelMatchJobGetDiffCount(const JST_PIXEL_MATCH_JOB *job);
+
+/* Whether more pixels than the diff budget differ, in which case some tiles
+ * were left out. */
+JST_EXTERN JST_BOOL JSTPixelMatchJobIsBudgetExceeded(const JST_PIXEL_MATCH_JOB *job);
+
+/* Makes the job find connected regions of different pixels. Regions are
+ * merged in a streaming union-find as tiles finish, from run-lengths of
+ * the rows, so no mask of the whole image is ever kept.
+ * Must be called before the job is performed, returns false otherwise. */
+JST_EXTERN JST_BOOL JSTPixelMatchJobSetCollectsRegions(JST_PIXEL_MATCH_JOB *job, JST_BOOL collectsRegions);
+
+/* Regions found by a job which collects them, ordered by position. Only
+ * valid once every worker has returned; the array belongs to the job. */
+JST_EXTERN const JST_PIXEL_MATCH_REGION *JSTPixelMatchJobGetRegions(JST_PIXEL_MATCH_JOB *job, int *regionCount);
+
+#endif /* JSTPixelMatch_h */
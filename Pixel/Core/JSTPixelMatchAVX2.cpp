@@ -0,0 +1,99 @@
+#include "JSTPixelMatch.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+
+#include <immintrin.h>
+
+/* Everything below, including the driver templates from the private header,
+ * is compiled for AVX2 without FMA, so that no product is ever fused. It is
+ * only called after a runtime CPU check. */
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "JSTPixelMatch+Private.h"
+
+struct JSTPixelMatchKernelAVX2 {
+    static const int N = 8;
+
+    static JST_PIXEL_MATCH_INLINE void unpack(__m256i pixels, __m256 &r, __m256 &g, __m256 &b) {
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        __m256 a = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 24)), _mm256_set1_ps(1.0f / 255.0f));
+
+        /* blending an opaque pixel with white leaves it as is */
+        const __m256 white = _mm256_set1_ps(255.0f);
+        b = _mm256_add_ps(white, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_and_si256(pixels, mask)), white), a));
+        g = _mm256_add_ps(white, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask)), white), a));
+        r = _mm256_add_ps(white, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask)), white), a));
+    }
+
+    static JST_PIXEL_MATCH_INLINE __m256 dot(__m256 r, __m256 g, __m256 b, float cr, float cg, float cb) {
+        return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(cr)), _mm256_mul_ps(g, _mm256_set1_ps(cg))), _mm256_mul_ps(b, _mm256_set1_ps(cb)));
+    }
+
+    static JST_PIXEL_MATCH_INLINE uint32_t candidates(const JST_COLOR *a, const JST_COLOR *b, float candidateDelta) {
+        __m256i p1 = _mm256_loadu_si256((const __m256i *)a);
+        __m256i p2 = _mm256_loadu_si256((const __m256i *)b);
+
+        __m256 r1, g1, b1, r2, g2, b2;
+        unpack(p1, r1, g1, b1);
+        unpack(p2, r2, g2, b2);
+
+        /* the metric is linear, so the channel differences are converted directly */
+        __m256 dr = _mm256_sub_ps(r1, r2), dg = _mm256_sub_ps(g1, g2), db = _mm256_sub_ps(b1, b2);
+        __m256 y = dot(dr, dg, db, (float)JST_PIXEL_MATCH_Y_R, (float)JST_PIXEL_MATCH_Y_G, (float)JST_PIXEL_MATCH_Y_B);
+        __m256 i = dot(dr, dg, db, (float)JST_PIXEL_MATCH_I_R, -(float)JST_PIXEL_MATCH_I_G, -(float)JST_PIXEL_MATCH_I_B);
+        __m256 q = dot(dr, dg, db, (float)JST_PIXEL_MATCH_Q_R, -(float)JST_PIXEL_MATCH_Q_G, (float)JST_PIXEL_MATCH_Q_B);
+        __m256 delta = dot(_mm256_mul_ps(y, y), _mm256_mul_ps(i, i), _mm256_mul_ps(q, q), (float)JST_PIXEL_MATCH_DELTA_Y, (float)JST_PIXEL_MATCH_DELTA_I, (float)JST_PIXEL_MATCH_DELTA_Q);
+
+        __m256 above = _mm256_cmp_ps(delta, _mm256_set1_ps(candidateDelta), _CMP_GT_OQ);
+        __m256 equal = _mm256_castsi256_ps(_mm256_cmpeq_epi32(p1, p2));
+        return (uint32_t)_mm256_movemask_ps(_mm256_andnot_ps(equal, above));
+    }
+
+    static JST_PIXEL_MATCH_INLINE __m128i gray4(__m128i r, __m128i g, __m128i b, __m128i a, __m256d alpha) {
+        const __m256d white = _mm256_set1_pd(255.0);
+        __m256d y = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(r), _mm256_set1_pd(JST_PIXEL_MATCH_Y_R)),
+                                                _mm256_mul_pd(_mm256_cvtepi32_pd(g), _mm256_set1_pd(JST_PIXEL_MATCH_Y_G))),
+                                  _mm256_mul_pd(_mm256_cvtepi32_pd(b), _mm256_set1_pd(JST_PIXEL_MATCH_Y_B)));
+        __m256d opacity = _mm256_div_pd(_mm256_mul_pd(alpha, _mm256_cvtepi32_pd(a)), white);
+        return _mm256_cvttpd_epi32(_mm256_add_pd(white, _mm256_mul_pd(_mm256_sub_pd(y, white), opacity)));
+    }
+
+    static JST_PIXEL_MATCH_INLINE void drawGray(const JST_COLOR *a, JST_COLOR *output, double alpha) {
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        __m256i pixels = _mm256_loadu_si256((const __m256i *)a);
+        __m256i b = _mm256_and_si256(pixels, mask);
+        __m256i g = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask);
+        __m256i r = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask);
+        __m256i o = _mm256_srli_epi32(pixels, 24);
+
+        __m256d alphas = _mm256_set1_pd(alpha);
+        __m128i lo = gray4(_mm256_castsi256_si128(r), _mm256_castsi256_si128(g), _mm256_castsi256_si128(b), _mm256_castsi256_si128(o), alphas);
+        __m128i hi = gray4(_mm256_extracti128_si256(r, 1), _mm256_extracti128_si256(g, 1), _mm256_extracti128_si256(b, 1), _mm256_extracti128_si256(o, 1), alphas);
+        __m256i value = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+        __m256i gray = _mm256_or_si256(_mm256_or_si256(value, _mm256_slli_epi32(value, 8)),
+                                       _mm256_or_si256(_mm256_slli_epi32(value, 16), _mm256_set1_epi32((int)0xff000000)));
+        _mm256_storeu_si256((__m256i *)output, gray);
+    }
+};
+
+long long JSTPixelMatchRowsAVX2(const JSTPixelMatchContext &ctx, int y1, int y2, uint8_t *diffFlags)
+{
+    return JSTPixelMatchRows<JSTPixelMatchKernelAVX2>(ctx, y1, y2, diffFlags);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif /* __SSE2__ */
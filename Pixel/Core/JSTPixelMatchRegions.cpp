@@ -0,0 +1,227 @@
+#include "JSTPixelMatch+Private.h"
+
+#include <new>
+
+
+/* MARK: - Union-Find */
+
+int JSTPixelMatchRegionCollector::find(std::vector<int> &parents, int label)
+{
+    while (parents[label] != label) {
+        parents[label] = parents[parents[label]];
+        label = parents[label];
+    }
+    return label;
+}
+
+void JSTPixelMatchRegionCollector::unite(std::vector<int> &parents, int label1, int label2)
+{
+    label1 = find(parents, label1);
+    label2 = find(parents, label2);
+    if (label1 < label2) {
+        parents[label2] = label1;
+    } else if (label2 < label1) {
+        parents[label1] = label2;
+    }
+}
+
+/* Runs of two consecutive rows touch when they overlap or meet diagonally.
+ * Both rows are ordered, so one pass advancing whichever run ends first
+ * visits every touching pair. */
+void JSTPixelMatchRegionCollector::uniteAdjacentRuns(std::vector<int> &parents, const std::vector<Run> &upper, const std::vector<Run> &lower)
+{
+    size_t i = 0, j = 0;
+    while (i < upper.size() && j < lower.size()) {
+        const Run &a = upper[i];
+        const Run &b = lower[j];
+        if (a.x1 <= b.x2 + 1 && b.x1 <= a.x2 + 1) {
+            unite(parents, a.label, b.label);
+        }
+        if (a.x2 < b.x2) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+}
+
+
+/* MARK: - Collector */
+
+JSTPixelMatchRegionCollector::JSTPixelMatchRegionCollector(int tileCount)
+    : tiles((size_t)tileCount), isResolved(false), hasFailed(false)
+{
+    for (TileEdges &edges : tiles) {
+        edges.isDone = false;
+        edges.firstRow = 0;
+        edges.lastRow = -1;
+    }
+}
+
+void JSTPixelMatchRegionCollector::addTile(int tile, int y1, int y2, int width, const uint8_t *diffFlags)
+{
+    if (y1 >= y2) {
+        return;
+    }
+
+    try {
+        /* label the tile on its own, outside of the lock */
+        std::vector<std::vector<Run>> rowRuns((size_t)(y2 - y1));
+        std::vector<int> localParents;
+        for (int y = y1; y < y2; ++y) {
+            const uint8_t *flags = diffFlags + (size_t)(y - y1) * width;
+            std::vector<Run> &runs = rowRuns[y - y1];
+            for (int x = 0; x < width; ++x) {
+                if (!flags[x]) {
+                    continue;
+                }
+                Run run;
+                run.x1 = x;
+                while (x + 1 < width && flags[x + 1]) {
+                    ++x;
+                }
+                run.x2 = x;
+                run.label = (int)localParents.size();
+                localParents.push_back(run.label);
+                runs.push_back(run);
+            }
+            if (y > y1) {
+                uniteAdjacentRuns(localParents, rowRuns[y - y1 - 1], runs);
+            }
+        }
+
+        /* one component per local root */
+        std::vector<int> localComponents(localParents.size(), -1);
+        std::vector<Component> tileComponents;
+        for (int y = y1; y < y2; ++y) {
+            for (Run &run : rowRuns[y - y1]) {
+                int root = find(localParents, run.label);
+                if (localComponents[root] < 0) {
+                    localComponents[root] = (int)tileComponents.size();
+                    Component component;
+                    component.minX = run.x1;
+                    component.minY = y;
+                    component.maxX = run.x2;
+                    component.maxY = y;
+                    component.pixelCount = 0;
+                    component.sumX = 0;
+                    component.sumY = 0;
+                    tileComponents.push_back(component);
+                }
+                run.label = localComponents[root];
+
+                Component &component = tileComponents[run.label];
+                long long length = run.x2 - run.x1 + 1;
+                component.minX = std::min(component.minX, run.x1);
+                component.maxX = std::max(component.maxX, run.x2);
+                component.maxY = y;
+                component.pixelCount += length;
+                component.sumX += length * (run.x1 + run.x2) / 2;
+                component.sumY += length * y;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        int base = (int)components.size();
+        components.insert(components.end(), tileComponents.begin(), tileComponents.end());
+        for (size_t i = 0; i < tileComponents.size(); ++i) {
+            parents.push_back(base + (int)i);
+        }
+
+        TileEdges &edges = tiles[tile];
+        edges.firstRuns = std::move(rowRuns.front());
+        edges.lastRuns = std::move(rowRuns.back());
+        if (y2 - y1 == 1) {
+            edges.lastRuns = edges.firstRuns;
+        }
+        for (Run &run : edges.firstRuns) {
+            run.label += base;
+        }
+        for (Run &run : edges.lastRuns) {
+            run.label += base;
+        }
+        edges.firstRow = y1;
+        edges.lastRow = y2 - 1;
+        edges.isDone = true;
+
+        /* a tile cut short by the diff budget does not reach the next one */
+        if (tile > 0 && tiles[tile - 1].isDone && tiles[tile - 1].lastRow + 1 == edges.firstRow) {
+            uniteAdjacentRuns(parents, tiles[tile - 1].lastRuns, edges.firstRuns);
+        }
+        if (tile + 1 < (int)tiles.size() && tiles[tile + 1].isDone && edges.lastRow + 1 == tiles[tile + 1].firstRow) {
+            uniteAdjacentRuns(parents, edges.lastRuns, tiles[tile + 1].firstRuns);
+        }
+    } catch (const std::bad_alloc &) {
+        std::lock_guard<std::mutex> lock(mutex);
+        hasFailed = true;
+    }
+}
+
+void JSTPixelMatchRegionCollector::fail()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    hasFailed = true;
+}
+
+const std::vector<JST_PIXEL_MATCH_REGION> *JSTPixelMatchRegionCollector::regions()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (hasFailed) {
+        return NULL;
+    }
+    if (isResolved) {
+        return &resolvedRegions;
+    }
+
+    try {
+        std::vector<int> regionIndexes(components.size(), -1);
+        std::vector<Component> merged;
+        for (size_t label = 0; label < components.size(); ++label) {
+            int root = find(parents, (int)label);
+            const Component &component = components[label];
+            if (regionIndexes[root] < 0) {
+                regionIndexes[root] = (int)merged.size();
+                merged.push_back(component);
+                continue;
+            }
+            Component &region = merged[regionIndexes[root]];
+            region.minX = std::min(region.minX, component.minX);
+            region.minY = std::min(region.minY, component.minY);
+            region.maxX = std::max(region.maxX, component.maxX);
+            region.maxY = std::max(region.maxY, component.maxY);
+            region.pixelCount += component.pixelCount;
+            region.sumX += component.sumX;
+            region.sumY += component.sumY;
+        }
+
+        resolvedRegions.clear();
+        resolvedRegions.reserve(merged.size());
+        for (const Component &component : merged) {
+            JST_PIXEL_MATCH_REGION region;
+            region.x = component.minX;
+            region.y = component.minY;
+            region.width = component.maxX - component.minX + 1;
+            region.height = component.maxY - component.minY + 1;
+            region.pixelCount = component.pixelCount;
+            region.centroidX = (double)component.sumX / (double)component.pixelCount;
+            region.centroidY = (double)component.sumY / (double)component.pixelCount;
+            resolvedRegions.push_back(region);
+        }
+    } catch (const std::bad_alloc &) {
+        hasFailed = true;
+        return NULL;
+    }
+
+    /* tiles finish in any order, the result should not */
+    std::sort(resolvedRegions.begin(), resolvedRegions.end(), [](const JST_PIXEL_MATCH_REGION &a, const JST_PIXEL_MATCH_REGION &b) {
+        if (a.y != b.y) return a.y < b.y;
+        if (a.x != b.x) return a.x < b.x;
+        if (a.height != b.height) return a.height < b.height;
+        if (a.width != b.width) return a.width < b.width;
+        if (a.pixelCount != b.pixelCount) return a.pixelCount < b.pixelCount;
+        if (a.centroidY != b.centroidY) return a.centroidY < b.centroidY;
+        return a.centroidX < b.centroidX;
+    });
+    isResolved = true;
+    return &resolvedRegions;
+}
@@ -0,0 +1,234 @@
+#include "JSTPixelRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+
+/* MARK: - Lifecycle */
+
+namespace {
+
+struct PixelRingSlot {
+    JST_IMAGE *image;    /* owner of the slot pixels, shared with readers */
+    uint64_t sequence;   /* 0 if empty or being written */
+    uint64_t timestamp;
+    bool isWriting;
+};
+
+}
+
+struct JST_PIXEL_RING {
+    int width;
+    int height;
+
+    std::mutex mutex;  /* guards the slots, never held while pixels are copied */
+    std::vector<PixelRingSlot> slots;
+    uint64_t lastSequence;
+    uint64_t pushedCount;
+    uint64_t droppedCount;
+};
+
+JST_PIXEL_RING *JSTPixelRingCreate(int capacity, int width, int height)
+{
+    if (capacity <= 0 || width <= 0 || height <= 0) {
+        return NULL;
+    }
+    JST_PIXEL_RING *ring = new (std::nothrow) JST_PIXEL_RING;
+    if (!ring) {
+        return NULL;
+    }
+    ring->width = width;
+    ring->height = height;
+    ring->lastSequence = 0;
+    ring->pushedCount = 0;
+    ring->droppedCount = 0;
+    try {
+        ring->slots.reserve((size_t)capacity);
+    } catch (const std::bad_alloc &) {
+        delete ring;
+        return NULL;
+    }
+    for (int i = 0; i < capacity; ++i) {
+        /* storage is attached up front, so that sharing never mutates a slot */
+        JST_IMAGE *image = JSTCreatePixelImage(width, height);
+        if (!image) {
+            JSTPixelRingFree(ring);
+            return NULL;
+        }
+        ring->slots.push_back({ image, 0, 0, false });
+    }
+    return ring;
+}
+
+void JSTPixelRingFree(JST_PIXEL_RING *ring)
+{
+    if (!ring) {
+        return;
+    }
+    for (PixelRingSlot &slot : ring->slots) {
+        JSTFreePixelImage(slot.image);
+    }
+    delete ring;
+}
+
+int JSTPixelRingGetCapacity(const JST_PIXEL_RING *ring)
+{
+    return (int)ring->slots.size();
+}
+
+void JSTPixelRingGetSize(const JST_PIXEL_RING *ring, int *width, int *height)
+{
+    *width = ring->width;
+    *height = ring->height;
+}
+
+
+/* MARK: - Writing */
+
+/* An empty slot, otherwise the oldest frame nobody is reading. */
+static PixelRingSlot *JSTPixelRingReserveSlot(JST_PIXEL_RING *ring)
+{
+    PixelRingSlot *reservedSlot = NULL;
+    for (PixelRingSlot &slot : ring->slots) {
+        if (slot.isWriting || JSTPixelImageIsShared(slot.image)) {
+            continue;
+        }
+        if (slot.sequence == 0) {
+            reservedSlot = &slot;
+            break;
+        }
+        if (!reservedSlot || slot.sequence < reservedSlot->sequence) {
+            reservedSlot = &slot;
+        }
+    }
+    return reservedSlot;
+}
+
+JST_PIXEL_RING_STATUS JSTPixelRingPush(JST_PIXEL_RING *ring, const void *pixels, int width, int height, size_t bytesPerRow, JST_ORIENTATION orientation, uint64_t timestamp)
+{
+    size_t rowLength = (size_t)ring->width * sizeof(JST_COLOR);
+    if (width != ring->width || height != ring->height || bytesPerRow < rowLength) {
+        return JST_PIXEL_RING_STATUS_SIZE_MISMATCH;
+    }
+
+    PixelRingSlot *slot;
+    {
+        std::lock_guard<std::mutex> lock(ring->mutex);
+        slot = JSTPixelRingReserveSlot(ring);
+        if (!slot) {
+            ring->droppedCount += 1;
+            return JST_PIXEL_RING_STATUS_DROPPED;
+        }
+        slot->isWriting = true;
+        slot->sequence = 0;
+    }
+
+    /* the reserved slot is invisible to readers and other writers */
+    JST_IMAGE *image = slot->image;
+    const uint8_t *row = (const uint8_t *)pixels;
+    if (bytesPerRow == rowLength) {
+        memcpy(image->pixels, row, rowLength * (size_t)height);
+    } else {
+        for (int y = 0; y < height; ++y, row += bytesPerRow) {
+            memcpy(image->pixels + (size_t)image->alignedWidth * (size_t)y, row, rowLength);
+        }
+    }
+    image->orientation = orientation;
+
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    slot->isWriting = false;
+    slot->sequence = ++ring->lastSequence;
+    slot->timestamp = timestamp;
+    ring->pushedCount += 1;
+    return JST_PIXEL_RING_STATUS_PUSHED;
+}
+
+
+/* MARK: - Reading */
+
+static bool JSTPixelRingCompareSlots(const PixelRingSlot *a, const PixelRingSlot *b)
+{
+    return a->sequence < b->sequence;
+}
+
+/* Frames in the ring, oldest first. Must be called with the lock held. */
+static std::vector<const PixelRingSlot *> JSTPixelRingSortedSlots(const JST_PIXEL_RING *ring)
+{
+    std::vector<const PixelRingSlot *> slots;
+    slots.reserve(ring->slots.size());
+    for (const PixelRingSlot &slot : ring->slots) {
+        if (slot.sequence != 0) {
+            slots.push_back(&slot);
+        }
+    }
+    std::sort(slots.begin(), slots.end(), JSTPixelRingCompareSlots);
+    return slots;
+}
+
+int JSTPixelRingGetFrames(JST_PIXEL_RING *ring, JST_PIXEL_RING_FRAME_INFO *infos, int maximumCount)
+{
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    std::vector<const PixelRingSlot *> slots = JSTPixelRingSortedSlots(ring);
+    int count = (int)slots.size();
+    for (int i = 0; i < std::min(count, maximumCount); ++i) {
+        infos[i].sequence = slots[(size_t)i]->sequence;
+        infos[i].timestamp = slots[(size_t)i]->timestamp;
+    }
+    return count;
+}
+
+JST_IMAGE *JSTPixelRingCopyFrame(JST_PIXEL_RING *ring, uint64_t sequence, JST_PIXEL_RING_FRAME_INFO *info)
+{
+    if (sequence == 0) {
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    for (PixelRingSlot &slot : ring->slots) {
+        if (slot.sequence != sequence) {
+            continue;
+        }
+        JST_IMAGE *image = JSTCreatePixelImageSharingPixelImage(slot.image);
+        if (image && info) {
+            info->sequence = slot.sequence;
+            info->timestamp = slot.timestamp;
+        }
+        return image;
+    }
+    return NULL;
+}
+
+JST_BOOL JSTPixelRingFindFrame(JST_PIXEL_RING *ring, uint64_t timestamp, uint64_t *sequence)
+{
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    std::vector<const PixelRingSlot *> slots = JSTPixelRingSortedSlots(ring);
+    if (slots.empty()) {
+        return false;
+    }
+    const PixelRingSlot *foundSlot = slots.front();
+    for (const PixelRingSlot *slot : slots) {
+        if (slot->timestamp <= timestamp) {
+            foundSlot = slot;
+        }
+    }
+    *sequence = foundSlot->sequence;
+    return true;
+}
+
+void JSTPixelRingGetStatistics(JST_PIXEL_RING *ring, JST_PIXEL_RING_STATISTICS *statistics)
+{
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    *statistics = JST_PIXEL_RING_STATISTICS();
+    statistics->pushedCount = ring->pushedCount;
+    statistics->droppedCount = ring->droppedCount;
+    for (const PixelRingSlot &slot : ring->slots) {
+        if (slot.sequence != 0) {
+            statistics->frameCount += 1;
+            if (JSTPixelImageIsShared(slot.image)) {
+                statistics->sharedCount += 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef JSTPixelRing_h
+#define JSTPixelRing_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "JSTPixelStorage.h"
+
+/* Bounded ring of frames for continuous capture.
+ *
+ * Every slot is allocated when the ring is created, pushing a frame copies
+ * its pixels into the slot of the oldest frame and never allocates. Frames
+ * handed out to readers share the pixels of their slot, a slot is skipped
+ * by the writer as long as one of them is alive. If no slot can be written
+ * the frame is dropped rather than queued, so a slow reader costs frames,
+ * not memory. Push, copy and free may happen on any thread. */
+
+typedef struct JST_PIXEL_RING JST_PIXEL_RING;
+
+typedef enum JST_PIXEL_RING_STATUS {
+    JST_PIXEL_RING_STATUS_PUSHED = 0,
+    JST_PIXEL_RING_STATUS_DROPPED,        /* every slot is being read or written */
+    JST_PIXEL_RING_STATUS_SIZE_MISMATCH,  /* the frame does not fit the slots, create another ring */
+} JST_PIXEL_RING_STATUS;
+
+typedef struct JST_PIXEL_RING_FRAME_INFO {
+    uint64_t sequence;   /* 1 for the first frame pushed, then increasing */
+    uint64_t timestamp;  /* as given to JSTPixelRingPush */
+} JST_PIXEL_RING_FRAME_INFO;
+
+typedef struct JST_PIXEL_RING_STATISTICS {
+    uint64_t pushedCount;
+    uint64_t droppedCount;
+    int frameCount;      /* frames in the ring */
+    int sharedCount;     /* frames still held by readers */
+} JST_PIXEL_RING_STATISTICS;
+
+/* Allocates capacity packed width x height slots.
+ * Returns NULL if an argument is invalid or an allocation fails. */
+JST_EXTERN JST_PIXEL_RING *JSTPixelRingCreate(int capacity, int width, int height);
+
+/* Frames copied out of the ring stay valid after the ring is freed. */
+JST_EXTERN void JSTPixelRingFree(JST_PIXEL_RING *ring);
+
+JST_EXTERN int JSTPixelRingGetCapacity(const JST_PIXEL_RING *ring);
+JST_EXTERN void JSTPixelRingGetSize(const JST_PIXEL_RING *ring, int *width, int *height);
+
+/* Copies height rows of width colors, bytesPerRow apart, into a free slot
+ * and tags it with the next sequence number and the timestamp, in any
+ * monotonic unit. The pixels must be laid out as JST_COLOR. */
+JST_EXTERN JST_PIXEL_RING_STATUS JSTPixelRingPush(JST_PIXEL_RING *ring, const void *pixels, int width, int height, size_t bytesPerRow, JST_ORIENTATION orientation, uint64_t timestamp);
+
+/* Writes the frames in the ring, oldest first, into infos, up to
+ * maximumCount of them. Returns the number of frames in the ring. */
+JST_EXTERN int JSTPixelRingGetFrames(JST_PIXEL_RING *ring, JST_PIXEL_RING_FRAME_INFO *infos, int maximumCount);
+
+/* Returns an image which shares the pixels of the frame, until it is freed
+ * with JSTFreePixelImage the slot is not written again. Writing into the
+ * image copies its pixels first.
+ * Returns NULL if the frame has been overwritten or never existed. */
+JST_EXTERN JST_IMAGE *JSTPixelRingCopyFrame(JST_PIXEL_RING *ring, uint64_t sequence, JST_PIXEL_RING_FRAME_INFO *info);
+
+/* Sequence of the latest frame taken at or before timestamp, of the oldest
+ * frame if all of them are later. Returns false if the ring is empty. */
+JST_EXTERN JST_BOOL JSTPixelRingFindFrame(JST_PIXEL_RING *ring, uint64_t timestamp, uint64_t *sequence);
+
+JST_EXTERN void JSTPixelRingGetStatistics(JST_PIXEL_RING *ring, JST_PIXEL_RING_STATISTICS *statistics);
+
+#endif /* JSTPixelRing_h */
@@ -0,0 +1,10 @@
+#ifndef JSTPixelStorage_Private_h
+#define JSTPixelStorage_Private_h
+
+#include "JSTPixelStorage.h"
+
+/* Accounts pixels which had to be copied eagerly, so that the statistics
+ * cover every copy made by the core and not only deferred ones. */
+void JSTPixelStorageRecordCopiedBytes(size_t length);
+
+#endif /* JSTPixelStorage_Private_h */
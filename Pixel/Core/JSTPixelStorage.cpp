@@ -0,0 +1,266 @@
+#include "JSTPixelStorage+Private.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+
+struct JST_PIXEL_STORAGE {
+    std::atomic<size_t> referenceCount;
+    void *bytes;
+    size_t length;
+    JST_PIXEL_STORAGE_DEALLOCATOR deallocator;
+    void *context;
+    JST_BOOL writable;
+};
+
+
+static std::atomic<uint64_t> sharedBytes(0);
+static std::atomic<uint64_t> copiedBytes(0);
+static std::atomic<uint64_t> materializedBytes(0);
+
+
+/* MARK: - Storage */
+
+JST_PIXEL_STORAGE *JSTPixelStorageCreate(void *bytes, size_t length, JST_PIXEL_STORAGE_DEALLOCATOR deallocator, void *context)
+{
+    if (!bytes) {
+        return NULL;
+    }
+
+    JST_PIXEL_STORAGE *storage = new (std::nothrow) JST_PIXEL_STORAGE;
+    if (!storage) {
+        return NULL;
+    }
+    storage->referenceCount.store(1, std::memory_order_relaxed);
+    storage->bytes = bytes;
+    storage->length = length;
+    storage->deallocator = deallocator;
+    storage->context = context;
+    storage->writable = true;
+    return storage;
+}
+
+JST_PIXEL_STORAGE *JSTPixelStorageCreateReadOnly(void *bytes, size_t length, JST_PIXEL_STORAGE_DEALLOCATOR deallocator, void *context)
+{
+    JST_PIXEL_STORAGE *storage = JSTPixelStorageCreate(bytes, length, deallocator, context);
+    if (storage) {
+        storage->writable = false;
+    }
+    return storage;
+}
+
+JST_PIXEL_STORAGE *JSTPixelStorageRetain(JST_PIXEL_STORAGE *storage)
+{
+    if (storage) {
+        storage->referenceCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    return storage;
+}
+
+void JSTPixelStorageRelease(JST_PIXEL_STORAGE *storage)
+{
+    if (!storage) {
+        return;
+    }
+    if (storage->referenceCount.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    if (storage->deallocator) {
+        storage->deallocator(storage->bytes, storage->length, storage->context);
+    } else {
+        free(storage->bytes);
+    }
+    delete storage;
+}
+
+JST_BOOL JSTPixelStorageIsUnique(const JST_PIXEL_STORAGE *storage)
+{
+    return storage->referenceCount.load(std::memory_order_acquire) == 1;
+}
+
+JST_BOOL JSTPixelStorageIsWritable(const JST_PIXEL_STORAGE *storage)
+{
+    return storage->writable;
+}
+
+void *JSTPixelStorageGetBytes(const JST_PIXEL_STORAGE *storage)
+{
+    return storage->bytes;
+}
+
+size_t JSTPixelStorageGetLength(const JST_PIXEL_STORAGE *storage)
+{
+    return storage->length;
+}
+
+
+/* MARK: - Statistics */
+
+static size_t JSTPixelImageGetBytesCount(const JST_IMAGE *pixelImage)
+{
+    return (size_t)pixelImage->width * (size_t)pixelImage->height * sizeof(JST_COLOR);
+}
+
+void JSTPixelStorageRecordCopiedBytes(size_t length)
+{
+    copiedBytes.fetch_add(length, std::memory_order_relaxed);
+}
+
+void JSTPixelStorageGetStatistics(JST_PIXEL_STORAGE_STATISTICS *statistics)
+{
+    uint64_t shared = sharedBytes.load(std::memory_order_relaxed);
+    uint64_t materialized = materializedBytes.load(std::memory_order_relaxed);
+    statistics->sharedBytes = shared;
+    statistics->copiedBytes = copiedBytes.load(std::memory_order_relaxed);
+    statistics->avoidedBytes = shared > materialized ? shared - materialized : 0;
+}
+
+void JSTPixelStorageResetStatistics(void)
+{
+    sharedBytes.store(0, std::memory_order_relaxed);
+    copiedBytes.store(0, std::memory_order_relaxed);
+    materializedBytes.store(0, std::memory_order_relaxed);
+}
+
+
+/* MARK: - Views */
+
+static JST_PIXEL_STORAGE *JSTPixelImageAdoptStorage(JST_IMAGE *pixelImage)
+{
+    if (pixelImage->storage) {
+        return pixelImage->storage;
+    }
+    if (pixelImage->isDestroyed) {
+        return NULL;
+    }
+
+    size_t length = (size_t)pixelImage->alignedWidth * (size_t)pixelImage->height * sizeof(JST_COLOR);
+    pixelImage->storage = JSTPixelStorageCreate(pixelImage->pixels, length, NULL, NULL);
+    return pixelImage->storage;
+}
+
+JST_IMAGE *JSTCreatePixelImageViewWithPixelImageInRect(JST_IMAGE *pixelImage, JST_ORIENTATION orientation, int x1, int y1, int x2, int y2)
+{
+    JST_PIXEL_STORAGE *storage = JSTPixelImageAdoptStorage(pixelImage);
+    if (!storage) {
+        return JSTCreatePixelImageWithPixelImageInRect(pixelImage, orientation, x1, y1, x2, y2);
+    }
+
+    x1 = std::max(x1, 0);
+    y1 = std::max(y1, 0);
+    x2 = std::min(x2, pixelImage->width);
+    y2 = std::min(y2, pixelImage->height);
+
+    int newWidth = std::max(x2 - x1, 0);
+    int newHeight = std::max(y2 - y1, 0);
+    JST_COLOR *origin = pixelImage->pixels;
+    if (newWidth > 0 && newHeight > 0) {
+        origin += (size_t)y1 * pixelImage->alignedWidth + x1;
+    }
+
+    JST_IMAGE *newPixelImage = JSTCreatePixelImageWithPixels(origin, newWidth, pixelImage->alignedWidth, newHeight, false);
+    if (!newPixelImage) {
+        return NULL;
+    }
+    newPixelImage->storage = JSTPixelStorageRetain(storage);
+    GET_ROTATE_ROTATE3(pixelImage->orientation, orientation, newPixelImage->orientation);
+    sharedBytes.fetch_add(JSTPixelImageGetBytesCount(newPixelImage), std::memory_order_relaxed);
+    return newPixelImage;
+}
+
+JST_IMAGE *JSTCreatePixelImageViewByCroppingPixelImage(JST_IMAGE *pixelImage, int x, int y, int width, int height)
+{
+    int x1 = x;
+    int y1 = y;
+    int x2 = x + width;
+    int y2 = y + height;
+    SHIFT_RECT_BY_ORIEN(x1, y1, x2, y2, pixelImage->width, pixelImage->height, pixelImage->orientation);
+    return JSTCreatePixelImageViewWithPixelImageInRect(pixelImage, 0, x1, y1, x2, y2);
+}
+
+JST_IMAGE *JSTCreatePixelImageSharingPixelImage(JST_IMAGE *pixelImage)
+{
+    JST_PIXEL_STORAGE *storage = JSTPixelImageAdoptStorage(pixelImage);
+    if (!storage) {
+        return JSTCopyPixelImage(pixelImage);
+    }
+
+    JST_IMAGE *newPixelImage = JSTCreatePixelImageWithPixels(pixelImage->pixels, pixelImage->width, pixelImage->alignedWidth, pixelImage->height, false);
+    if (!newPixelImage) {
+        return NULL;
+    }
+    newPixelImage->storage = JSTPixelStorageRetain(storage);
+    newPixelImage->orientation = pixelImage->orientation;
+    sharedBytes.fetch_add(JSTPixelImageGetBytesCount(newPixelImage), std::memory_order_relaxed);
+    return newPixelImage;
+}
+
+
+/* MARK: - Materialization */
+
+JST_BOOL JSTPixelImageIsPacked(const JST_IMAGE *pixelImage)
+{
+    return pixelImage->alignedWidth == pixelImage->width || pixelImage->height <= 1;
+}
+
+JST_BOOL JSTPixelImageIsShared(const JST_IMAGE *pixelImage)
+{
+    return pixelImage->storage && !JSTPixelStorageIsUnique(pixelImage->storage);
+}
+
+static JST_BOOL JSTPixelImageMaterialize(JST_IMAGE *pixelImage)
+{
+    int width = pixelImage->width;
+    int height = pixelImage->height;
+    size_t pixelsCount = std::max((size_t)width * (size_t)height, (size_t)1);
+    JST_COLOR *pixels = (JST_COLOR *)malloc(pixelsCount * sizeof(JST_COLOR));
+    if (!pixels) {
+        return false;
+    }
+
+    const JST_COLOR *srcRow = pixelImage->pixels;
+    JST_COLOR *dstRow = pixels;
+    for (int y = 0; y < height && width > 0; ++y) {
+        memcpy(dstRow, srcRow, (size_t)width * sizeof(JST_COLOR));
+        srcRow += pixelImage->alignedWidth;
+        dstRow += width;
+    }
+
+    size_t bytesCount = JSTPixelImageGetBytesCount(pixelImage);
+    copiedBytes.fetch_add(bytesCount, std::memory_order_relaxed);
+    if (pixelImage->storage) {
+        if (!JSTPixelStorageIsUnique(pixelImage->storage)) {
+            materializedBytes.fetch_add(bytesCount, std::memory_order_relaxed);
+        }
+        JSTPixelStorageRelease(pixelImage->storage);
+        pixelImage->storage = NULL;
+    } else if (!pixelImage->isDestroyed) {
+        free(pixelImage->pixels);
+    }
+    pixelImage->pixels = pixels;
+    pixelImage->alignedWidth = width;
+    pixelImage->isDestroyed = false;
+    return true;
+}
+
+JST_BOOL JSTPixelImageMakeUnique(JST_IMAGE *pixelImage)
+{
+    if (!pixelImage->storage) {
+        return true;
+    }
+    if (JSTPixelStorageIsUnique(pixelImage->storage) && JSTPixelStorageIsWritable(pixelImage->storage)) {
+        return true;
+    }
+    return JSTPixelImageMaterialize(pixelImage);
+}
+
+JST_BOOL JSTPixelImageMakePacked(JST_IMAGE *pixelImage)
+{
+    if (JSTPixelImageIsPacked(pixelImage)) {
+        return true;
+    }
+    return JSTPixelImageMaterialize(pixelImage);
+}
@@ -0,0 +1,80 @@
+#ifndef JSTPixelStorage_h
+#define JSTPixelStorage_h
+
+#include <stddef.h>
+#include "JSTPixelCore.h"
+
+/* Reference counted owner of a pixel buffer. Images which share a storage
+ * (views, copies) point into the same bytes, the buffer is released with
+ * the last reference. Retain and release are thread safe. */
+
+typedef void (*JST_PIXEL_STORAGE_DEALLOCATOR)(void *bytes, size_t length, void *context);
+
+/* Takes ownership of bytes with a reference count of one. The deallocator
+ * is called with the last release, or free() if deallocator is NULL.
+ * Returns NULL if bytes is NULL or the allocation fails, bytes are not
+ * released in that case. */
+JST_EXTERN JST_PIXEL_STORAGE *JSTPixelStorageCreate(void *bytes, size_t length, JST_PIXEL_STORAGE_DEALLOCATOR deallocator, void *context);
+
+/* Same as JSTPixelStorageCreate, for bytes which must never be written,
+ * such as a read-only file mapping. Images on such a storage copy their
+ * pixels before the first write even if they are its only owner. */
+JST_EXTERN JST_PIXEL_STORAGE *JSTPixelStorageCreateReadOnly(void *bytes, size_t length, JST_PIXEL_STORAGE_DEALLOCATOR deallocator, void *context);
+
+JST_EXTERN JST_PIXEL_STORAGE *JSTPixelStorageRetain(JST_PIXEL_STORAGE *storage);
+JST_EXTERN void JSTPixelStorageRelease(JST_PIXEL_STORAGE *storage);
+
+/* Whether the caller holds the only reference, a unique storage may be
+ * written in place. */
+JST_EXTERN JST_BOOL JSTPixelStorageIsUnique(const JST_PIXEL_STORAGE *storage);
+JST_EXTERN JST_BOOL JSTPixelStorageIsWritable(const JST_PIXEL_STORAGE *storage);
+
+JST_EXTERN void *JSTPixelStorageGetBytes(const JST_PIXEL_STORAGE *storage);
+JST_EXTERN size_t JSTPixelStorageGetLength(const JST_PIXEL_STORAGE *storage);
+
+/* MARK: - Statistics */
+
+typedef struct JST_PIXEL_STORAGE_STATISTICS {
+    uint64_t sharedBytes;    /* pixels handed out as views or copies without copying */
+    uint64_t copiedBytes;    /* pixels actually copied, eagerly or on first write */
+    uint64_t avoidedBytes;   /* shared pixels which have not been copied since */
+} JST_PIXEL_STORAGE_STATISTICS;
+
+/* Process wide counters, updated atomically. */
+JST_EXTERN void JSTPixelStorageGetStatistics(JST_PIXEL_STORAGE_STATISTICS *statistics);
+JST_EXTERN void JSTPixelStorageResetStatistics(void);
+
+/* MARK: - Views */
+
+/* Creates a view of [x1, x2) x [y1, y2) of the unrotated buffer, which
+ * shares the pixels of the image: its pixels point at the origin of the
+ * rect and its alignedWidth is the stride of the parent. A privately owned
+ * buffer is adopted into a storage on first use, borrowed buffers cannot
+ * outlive their owner and are copied instead. */
+JST_EXTERN JST_IMAGE *JSTCreatePixelImageViewWithPixelImageInRect(JST_IMAGE *pixelImage, JST_ORIENTATION orientation, int x1, int y1, int x2, int y2);
+
+/* Zero-copy counterpart of JSTCreatePixelImageByCroppingPixelImage. */
+JST_EXTERN JST_IMAGE *JSTCreatePixelImageViewByCroppingPixelImage(JST_IMAGE *pixelImage, int x, int y, int width, int height);
+
+/* Copy-on-write counterpart of JSTCopyPixelImage: the new image shares the
+ * pixels, alignment and orientation of the original one, and whichever of
+ * both is written first gets its own copy. Borrowed buffers are copied. */
+JST_EXTERN JST_IMAGE *JSTCreatePixelImageSharingPixelImage(JST_IMAGE *pixelImage);
+
+/* Whether rows of the image are adjacent in memory. */
+JST_EXTERN JST_BOOL JSTPixelImageIsPacked(const JST_IMAGE *pixelImage);
+
+/* Whether the pixels are shared with another image. */
+JST_EXTERN JST_BOOL JSTPixelImageIsShared(const JST_IMAGE *pixelImage);
+
+/* Copies shared or read-only pixels into a private packed buffer, so that
+ * the image may be written without affecting others. Does nothing if the
+ * pixels are private already. Returns false if the allocation fails. */
+JST_EXTERN JST_BOOL JSTPixelImageMakeUnique(JST_IMAGE *pixelImage);
+
+/* Copies the pixels into a private packed buffer if its rows are padded,
+ * for consumers which expect width * height contiguous colors.
+ * Returns false if the allocation fails. */
+JST_EXTERN JST_BOOL JSTPixelImageMakePacked(JST_IMAGE *pixelImage);
+
+#endif /* JSTPixelStorage_h */
@@ -0,0 +1,445 @@
+#include "JSTPixelTransport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <random>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* MARK: - Layout */
+
+/* The counters are shared by two processes, which only works if no lock
+ * hides behind them. */
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared counters must be lock free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared counters must be lock free");
+
+namespace {
+
+/* One per slot, right after the header. The writer owns every field but
+ * leaseCount, which is only ever incremented and decremented by readers. */
+struct alignas(64) PixelTransportSlotControl {
+    std::atomic<uint64_t> sequence;    /* 0 if empty or being written */
+    std::atomic<uint32_t> leaseCount;  /* images wrapping the slot */
+    uint32_t reserved;
+    uint64_t timestamp;
+    int32_t width;
+    int32_t height;
+};
+
+/* Readers of other builds find the controls by this layout. */
+static_assert(sizeof(PixelTransportSlotControl) == 64, "slot controls are part of the shared layout");
+
+}
+
+struct JST_PIXEL_TRANSPORT {
+    std::atomic<size_t> referenceCount;  /* the handle and every image created from it */
+    int fileDescriptor;
+    uint8_t *mapping;
+    size_t length;
+    JST_PIXEL_TRANSPORT_HEADER *header;
+    PixelTransportSlotControl *controls;
+
+    /* writer state */
+    std::mutex mutex;
+    int reservedSlot;
+    int reservedWidth;
+    int reservedHeight;
+    uint64_t lastSequence;
+    uint64_t writtenCount;
+    uint64_t droppedCount;
+};
+
+static size_t JSTPixelTransportAlign(size_t length)
+{
+    return (length + JST_PIXEL_TRANSPORT_ALIGNMENT - 1) / JST_PIXEL_TRANSPORT_ALIGNMENT * JST_PIXEL_TRANSPORT_ALIGNMENT;
+}
+
+static size_t JSTPixelTransportGetControlsOffset(void)
+{
+    return (sizeof(JST_PIXEL_TRANSPORT_HEADER) + alignof(PixelTransportSlotControl) - 1) / alignof(PixelTransportSlotControl) * alignof(PixelTransportSlotControl);
+}
+
+static uint8_t *JSTPixelTransportGetSlotPixels(const JST_PIXEL_TRANSPORT *transport, int slot)
+{
+    return transport->mapping + transport->header->slotsOffset + (size_t)slot * transport->header->slotLength;
+}
+
+
+/* MARK: - Lifecycle */
+
+static JST_PIXEL_TRANSPORT *JSTPixelTransportCreateWithMapping(int fileDescriptor, uint8_t *mapping, size_t length)
+{
+    JST_PIXEL_TRANSPORT *transport = new (std::nothrow) JST_PIXEL_TRANSPORT;
+    if (!transport) {
+        return NULL;
+    }
+    transport->referenceCount = 1;
+    transport->fileDescriptor = fileDescriptor;
+    transport->mapping = mapping;
+    transport->length = length;
+    transport->header = (JST_PIXEL_TRANSPORT_HEADER *)mapping;
+    transport->controls = (PixelTransportSlotControl *)(mapping + JSTPixelTransportGetControlsOffset());
+    transport->reservedSlot = -1;
+    transport->reservedWidth = 0;
+    transport->reservedHeight = 0;
+    transport->lastSequence = 0;
+    transport->writtenCount = 0;
+    transport->droppedCount = 0;
+    return transport;
+}
+
+static void JSTPixelTransportRetain(JST_PIXEL_TRANSPORT *transport)
+{
+    transport->referenceCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void JSTPixelTransportRelease(JST_PIXEL_TRANSPORT *transport)
+{
+    if (transport->referenceCount.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    munmap(transport->mapping, transport->length);
+    close(transport->fileDescriptor);
+    delete transport;
+}
+
+/* A short name, some systems allow no more than 31 characters. */
+static int JSTPixelTransportOpenAnonymousObject(void)
+{
+    static std::atomic<uint32_t> counter(0);
+    std::random_device device;
+    for (int attempt = 0; attempt < 16; ++attempt) {
+        char name[32];
+        snprintf(name, sizeof(name), "/jst.%d.%u.%08x", (int)getpid() % 100000, counter.fetch_add(1) % 10000, (unsigned)device());
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+        if (fd >= 0) {
+            shm_unlink(name);
+            return fd;
+        }
+        if (errno != EEXIST) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+JST_PIXEL_TRANSPORT *JSTPixelTransportCreate(int slotCount, size_t slotLength)
+{
+    if (slotCount <= 0 || slotLength == 0) {
+        return NULL;
+    }
+    slotLength = JSTPixelTransportAlign(slotLength);
+    size_t slotsOffset = JSTPixelTransportAlign(JSTPixelTransportGetControlsOffset() + sizeof(PixelTransportSlotControl) * (size_t)slotCount);
+    if (slotLength > (SIZE_MAX - slotsOffset) / (size_t)slotCount) {
+        return NULL;
+    }
+    size_t length = slotsOffset + slotLength * (size_t)slotCount;
+
+    int fd = JSTPixelTransportOpenAnonymousObject();
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)length) != 0) {
+        close(fd);
+        return NULL;
+    }
+    void *mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    JST_PIXEL_TRANSPORT *transport = JSTPixelTransportCreateWithMapping(fd, (uint8_t *)mapping, length);
+    if (!transport) {
+        munmap(mapping, length);
+        close(fd);
+        return NULL;
+    }
+
+    /* the object is zero filled, controls are constructed before the header tells readers they exist */
+    for (int i = 0; i < slotCount; ++i) {
+        new (&transport->controls[i]) PixelTransportSlotControl();
+    }
+    std::random_device device;
+    JST_PIXEL_TRANSPORT_HEADER *header = transport->header;
+    header->identifier = (uint64_t)device() << 32 ^ (uint64_t)device() ^ (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+    header->version = JST_PIXEL_TRANSPORT_VERSION;
+    header->byteOrder = JST_PIXEL_TRANSPORT_BYTE_ORDER;
+    header->slotCount = (uint32_t)slotCount;
+    header->slotLength = slotLength;
+    header->slotsOffset = slotsOffset;
+    header->length = length;
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, JST_PIXEL_TRANSPORT_MAGIC, sizeof(JST_PIXEL_TRANSPORT_MAGIC));
+    return transport;
+}
+
+static bool JSTPixelTransportValidateHeader(const JST_PIXEL_TRANSPORT_HEADER *header, size_t length)
+{
+    if (memcmp(header->magic, JST_PIXEL_TRANSPORT_MAGIC, sizeof(JST_PIXEL_TRANSPORT_MAGIC)) != 0 ||
+        header->version != JST_PIXEL_TRANSPORT_VERSION ||
+        header->byteOrder != JST_PIXEL_TRANSPORT_BYTE_ORDER ||
+        header->length != length)
+    {
+        return false;
+    }
+    if (header->slotCount == 0 ||
+        header->slotLength == 0 ||
+        header->slotLength % JST_PIXEL_TRANSPORT_ALIGNMENT != 0 ||
+        header->slotsOffset % JST_PIXEL_TRANSPORT_ALIGNMENT != 0 ||
+        header->slotsOffset < JSTPixelTransportGetControlsOffset() + sizeof(PixelTransportSlotControl) * header->slotCount ||
+        header->slotsOffset > length ||
+        header->slotLength > (length - header->slotsOffset) / header->slotCount)
+    {
+        return false;
+    }
+    return true;
+}
+
+JST_PIXEL_TRANSPORT *JSTPixelTransportOpen(int fileDescriptor)
+{
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size < (off_t)JST_PIXEL_TRANSPORT_ALIGNMENT) {
+        return NULL;
+    }
+    int fd = dup(fileDescriptor);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    size_t length = (size_t)fileStat.st_size;
+    void *mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!JSTPixelTransportValidateHeader((const JST_PIXEL_TRANSPORT_HEADER *)mapping, length)) {
+        munmap(mapping, length);
+        close(fd);
+        return NULL;
+    }
+
+    JST_PIXEL_TRANSPORT *transport = JSTPixelTransportCreateWithMapping(fd, (uint8_t *)mapping, length);
+    if (!transport) {
+        munmap(mapping, length);
+        close(fd);
+        return NULL;
+    }
+    return transport;
+}
+
+void JSTPixelTransportFree(JST_PIXEL_TRANSPORT *transport)
+{
+    if (!transport) {
+        return;
+    }
+    JSTPixelTransportCancelFrame(transport);
+    JSTPixelTransportRelease(transport);
+}
+
+int JSTPixelTransportGetFileDescriptor(const JST_PIXEL_TRANSPORT *transport)
+{
+    return transport->fileDescriptor;
+}
+
+uint64_t JSTPixelTransportGetIdentifier(const JST_PIXEL_TRANSPORT *transport)
+{
+    return transport->header->identifier;
+}
+
+int JSTPixelTransportGetSlotCount(const JST_PIXEL_TRANSPORT *transport)
+{
+    return (int)transport->header->slotCount;
+}
+
+size_t JSTPixelTransportGetSlotLength(const JST_PIXEL_TRANSPORT *transport)
+{
+    return (size_t)transport->header->slotLength;
+}
+
+void JSTPixelTransportGetStatistics(JST_PIXEL_TRANSPORT *transport, JST_PIXEL_TRANSPORT_STATISTICS *statistics)
+{
+    std::lock_guard<std::mutex> lock(transport->mutex);
+    *statistics = JST_PIXEL_TRANSPORT_STATISTICS();
+    statistics->writtenCount = transport->writtenCount;
+    statistics->droppedCount = transport->droppedCount;
+    for (uint32_t i = 0; i < transport->header->slotCount; ++i) {
+        if (transport->controls[i].leaseCount.load() > 0) {
+            statistics->leasedCount += 1;
+        }
+    }
+}
+
+
+/* MARK: - Writer */
+
+/* Readers take a lease and then check the sequence, the writer clears the
+ * sequence and then checks the leases. With sequentially consistent order
+ * on both sides at least one of them sees the other and backs off. */
+static bool JSTPixelTransportTryReserveSlot(PixelTransportSlotControl *control)
+{
+    if (control->leaseCount.load() != 0) {
+        return false;
+    }
+    uint64_t sequence = control->sequence.exchange(0);
+    if (control->leaseCount.load() != 0) {
+        /* a reader which saw the cleared sequence fails, as if it were late */
+        control->sequence.store(sequence);
+        return false;
+    }
+    return true;
+}
+
+JST_COLOR *JSTPixelTransportBeginFrame(JST_PIXEL_TRANSPORT *transport, int width, int height, JST_PIXEL_TRANSPORT_STATUS *status)
+{
+    std::lock_guard<std::mutex> lock(transport->mutex);
+    if (width <= 0 || height <= 0 || transport->reservedSlot >= 0 ||
+        (uint64_t)width * (uint64_t)height * sizeof(JST_COLOR) > transport->header->slotLength)
+    {
+        *status = JST_PIXEL_TRANSPORT_STATUS_TOO_LARGE;
+        return NULL;
+    }
+
+    /* empty slots first, then the oldest frames */
+    std::vector<int> candidates((size_t)transport->header->slotCount);
+    for (int i = 0; i < (int)candidates.size(); ++i) {
+        candidates[(size_t)i] = i;
+    }
+    std::sort(candidates.begin(), candidates.end(), [transport](int a, int b) {
+        return transport->controls[a].sequence.load() < transport->controls[b].sequence.load();
+    });
+    for (int slot : candidates) {
+        PixelTransportSlotControl *control = &transport->controls[slot];
+        if (JSTPixelTransportTryReserveSlot(control)) {
+            transport->reservedSlot = slot;
+            transport->reservedWidth = width;
+            transport->reservedHeight = height;
+            *status = JST_PIXEL_TRANSPORT_STATUS_WRITTEN;
+            return (JST_COLOR *)JSTPixelTransportGetSlotPixels(transport, slot);
+        }
+    }
+    transport->droppedCount += 1;
+    *status = JST_PIXEL_TRANSPORT_STATUS_DROPPED;
+    return NULL;
+}
+
+void JSTPixelTransportCommitFrame(JST_PIXEL_TRANSPORT *transport, JST_ORIENTATION orientation, uint64_t timestamp, JST_PIXEL_TRANSPORT_FRAME *frame)
+{
+    std::lock_guard<std::mutex> lock(transport->mutex);
+    int slot = transport->reservedSlot;
+    if (slot < 0) {
+        return;
+    }
+    PixelTransportSlotControl *control = &transport->controls[slot];
+    control->timestamp = timestamp;
+    control->width = transport->reservedWidth;
+    control->height = transport->reservedHeight;
+    uint64_t sequence = ++transport->lastSequence;
+    control->sequence.store(sequence);
+    transport->reservedSlot = -1;
+    transport->writtenCount += 1;
+
+    frame->identifier = transport->header->identifier;
+    frame->sequence = sequence;
+    frame->timestamp = timestamp;
+    frame->slot = slot;
+    frame->width = control->width;
+    frame->height = control->height;
+    frame->orientation = orientation;
+}
+
+void JSTPixelTransportCancelFrame(JST_PIXEL_TRANSPORT *transport)
+{
+    std::lock_guard<std::mutex> lock(transport->mutex);
+    transport->reservedSlot = -1;
+}
+
+JST_PIXEL_TRANSPORT_STATUS JSTPixelTransportWriteFrame(JST_PIXEL_TRANSPORT *transport, const void *pixels, int width, int height, size_t bytesPerRow, JST_ORIENTATION orientation, uint64_t timestamp, JST_PIXEL_TRANSPORT_FRAME *frame)
+{
+    size_t rowLength = (size_t)std::max(width, 0) * sizeof(JST_COLOR);
+    if (bytesPerRow < rowLength) {
+        return JST_PIXEL_TRANSPORT_STATUS_TOO_LARGE;
+    }
+    JST_PIXEL_TRANSPORT_STATUS status;
+    JST_COLOR *slotPixels = JSTPixelTransportBeginFrame(transport, width, height, &status);
+    if (!slotPixels) {
+        return status;
+    }
+    const uint8_t *row = (const uint8_t *)pixels;
+    if (bytesPerRow == rowLength) {
+        memcpy(slotPixels, row, rowLength * (size_t)height);
+    } else {
+        for (int y = 0; y < height; ++y, row += bytesPerRow) {
+            memcpy(slotPixels + (size_t)width * (size_t)y, row, rowLength);
+        }
+    }
+    JSTPixelTransportCommitFrame(transport, orientation, timestamp, frame);
+    return JST_PIXEL_TRANSPORT_STATUS_WRITTEN;
+}
+
+
+/* MARK: - Reader */
+
+/* Storage deallocator of the images, bytes are the pixels of their slot. */
+static void JSTPixelTransportReleaseLease(void *bytes, size_t length, void *context)
+{
+    (void)length;
+    JST_PIXEL_TRANSPORT *transport = (JST_PIXEL_TRANSPORT *)context;
+    size_t slot = (size_t)((uint8_t *)bytes - JSTPixelTransportGetSlotPixels(transport, 0)) / transport->header->slotLength;
+    transport->controls[slot].leaseCount.fetch_sub(1);
+    JSTPixelTransportRelease(transport);
+}
+
+JST_IMAGE *JSTPixelTransportCreatePixelImage(JST_PIXEL_TRANSPORT *transport, const JST_PIXEL_TRANSPORT_FRAME *frame)
+{
+    const JST_PIXEL_TRANSPORT_HEADER *header = transport->header;
+    if (frame->identifier != header->identifier ||
+        frame->sequence == 0 ||
+        frame->slot < 0 || (uint32_t)frame->slot >= header->slotCount ||
+        frame->width <= 0 || frame->height <= 0 ||
+        (uint64_t)frame->width * (uint64_t)frame->height * sizeof(JST_COLOR) > header->slotLength ||
+        frame->orientation < 0 || frame->orientation > 3)
+    {
+        return NULL;
+    }
+
+    PixelTransportSlotControl *control = &transport->controls[frame->slot];
+    control->leaseCount.fetch_add(1);
+    if (control->sequence.load() != frame->sequence ||
+        control->width != frame->width ||
+        control->height != frame->height)
+    {
+        control->leaseCount.fetch_sub(1);
+        return NULL;
+    }
+
+    uint8_t *pixels = JSTPixelTransportGetSlotPixels(transport, frame->slot);
+    size_t pixelsLength = (size_t)frame->width * (size_t)frame->height * sizeof(JST_COLOR);
+    JSTPixelTransportRetain(transport);
+    JST_PIXEL_STORAGE *storage = JSTPixelStorageCreateReadOnly(pixels, pixelsLength, JSTPixelTransportReleaseLease, transport);
+    if (!storage) {
+        JSTPixelTransportReleaseLease(pixels, pixelsLength, transport);
+        return NULL;
+    }
+
+    JST_IMAGE *newPixelImage = JSTCreatePixelImageWithPixels((JST_COLOR *)pixels, frame->width, frame->width, frame->height, false);
+    if (!newPixelImage) {
+        JSTPixelStorageRelease(storage);
+        return NULL;
+    }
+    newPixelImage->storage = storage;
+    newPixelImage->orientation = (JST_ORIENTATION)frame->orientation;
+    return newPixelImage;
+}
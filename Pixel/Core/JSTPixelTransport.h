@@ -0,0 +1,116 @@
+#ifndef JSTPixelTransport_h
+#define JSTPixelTransport_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "JSTPixelStorage.h"
+
+/* Frames shared between processes through a memory mapping, so that only a
+ * small JST_PIXEL_TRANSPORT_FRAME goes through the control channel.
+ *
+ * The writer creates the transport and hands its file descriptor to the
+ * reader once, such as through an NSFileHandle over XPC. Then it writes
+ * frames into slots and sends their descriptors. The reader wraps a slot
+ * as a JST_IMAGE without copying it, the writer skips that slot until the
+ * image is freed. Leases are counted in the mapping itself, so the two
+ * processes never have to talk about them.
+ *
+ * A transport starts with a JST_PIXEL_TRANSPORT_HEADER in host byte order,
+ * followed by one control block per slot and by the slots, each of them at
+ * a page aligned offset. */
+
+#define JST_PIXEL_TRANSPORT_MAGIC "JSTPXTR"
+#define JST_PIXEL_TRANSPORT_VERSION 1
+#define JST_PIXEL_TRANSPORT_BYTE_ORDER 0x01020304u
+
+/* Same as JST_PIXEL_CACHE_ALIGNMENT, the largest page size we run on. */
+#define JST_PIXEL_TRANSPORT_ALIGNMENT 16384
+
+typedef struct JST_PIXEL_TRANSPORT JST_PIXEL_TRANSPORT;
+
+typedef struct JST_PIXEL_TRANSPORT_HEADER {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t identifier;   /* random, tells transports of the same writer apart */
+    uint32_t slotCount;
+    uint32_t reserved;
+    uint64_t slotLength;   /* bytes per slot, a multiple of the alignment */
+    uint64_t slotsOffset;
+    uint64_t length;       /* of the whole mapping */
+} JST_PIXEL_TRANSPORT_HEADER;
+
+/* Everything the reader needs to find a frame, a few dozen bytes. */
+typedef struct JST_PIXEL_TRANSPORT_FRAME {
+    uint64_t identifier;   /* of the transport */
+    uint64_t sequence;     /* 1 for the first frame written, then increasing */
+    uint64_t timestamp;    /* as given by the writer */
+    int32_t slot;
+    int32_t width;         /* pixels are packed, width * sizeof(JST_COLOR) bytes per row */
+    int32_t height;
+    int32_t orientation;
+} JST_PIXEL_TRANSPORT_FRAME;
+
+typedef enum JST_PIXEL_TRANSPORT_STATUS {
+    JST_PIXEL_TRANSPORT_STATUS_WRITTEN = 0,
+    JST_PIXEL_TRANSPORT_STATUS_DROPPED,    /* every slot is leased by the reader */
+    JST_PIXEL_TRANSPORT_STATUS_TOO_LARGE,  /* the frame does not fit a slot, create a larger transport */
+} JST_PIXEL_TRANSPORT_STATUS;
+
+typedef struct JST_PIXEL_TRANSPORT_STATISTICS {
+    uint64_t writtenCount;  /* by this handle */
+    uint64_t droppedCount;  /* by this handle */
+    int leasedCount;        /* slots held by images, of any process */
+} JST_PIXEL_TRANSPORT_STATISTICS;
+
+/* MARK: - Writer */
+
+/* Creates an anonymous shared memory object of slotCount slots of at least
+ * slotLength bytes each, the name is unlinked right away so that it goes
+ * away with the last process which maps it.
+ * Returns NULL if an argument is invalid or the system refuses. */
+JST_EXTERN JST_PIXEL_TRANSPORT *JSTPixelTransportCreate(int slotCount, size_t slotLength);
+
+/* Reserves a slot for a packed width x height frame and returns its pixels,
+ * to be filled in place and then committed or cancelled. Only one frame of
+ * a handle may be in progress at a time. Returns NULL with the reason in
+ * status if no slot can take the frame. */
+JST_EXTERN JST_COLOR *JSTPixelTransportBeginFrame(JST_PIXEL_TRANSPORT *transport, int width, int height, JST_PIXEL_TRANSPORT_STATUS *status);
+
+/* Publishes the reserved slot and fills the descriptor to send. */
+JST_EXTERN void JSTPixelTransportCommitFrame(JST_PIXEL_TRANSPORT *transport, JST_ORIENTATION orientation, uint64_t timestamp, JST_PIXEL_TRANSPORT_FRAME *frame);
+
+/* Gives the reserved slot back, it is empty afterwards. */
+JST_EXTERN void JSTPixelTransportCancelFrame(JST_PIXEL_TRANSPORT *transport);
+
+/* Begins a frame, copies height rows of width colors, bytesPerRow apart,
+ * into it and commits it. */
+JST_EXTERN JST_PIXEL_TRANSPORT_STATUS JSTPixelTransportWriteFrame(JST_PIXEL_TRANSPORT *transport, const void *pixels, int width, int height, size_t bytesPerRow, JST_ORIENTATION orientation, uint64_t timestamp, JST_PIXEL_TRANSPORT_FRAME *frame);
+
+/* MARK: - Reader */
+
+/* Maps the transport behind a descriptor received from the writer. The
+ * descriptor is duplicated, the caller still owns it.
+ * Returns NULL if it is not a transport or of another version. */
+JST_EXTERN JST_PIXEL_TRANSPORT *JSTPixelTransportOpen(int fileDescriptor);
+
+/* Returns an image whose pixels are the slot of the frame, until it is
+ * freed with JSTFreePixelImage the writer does not touch the slot again.
+ * Writing into the image copies its pixels first.
+ * Returns NULL if the frame has been overwritten, does not belong to
+ * this transport or does not fit its slot. */
+JST_EXTERN JST_IMAGE *JSTPixelTransportCreatePixelImage(JST_PIXEL_TRANSPORT *transport, const JST_PIXEL_TRANSPORT_FRAME *frame);
+
+/* MARK: - Both */
+
+/* Images created from the transport stay valid after it is freed. */
+JST_EXTERN void JSTPixelTransportFree(JST_PIXEL_TRANSPORT *transport);
+
+/* Owned by the transport, valid until it is freed. */
+JST_EXTERN int JSTPixelTransportGetFileDescriptor(const JST_PIXEL_TRANSPORT *transport);
+JST_EXTERN uint64_t JSTPixelTransportGetIdentifier(const JST_PIXEL_TRANSPORT *transport);
+JST_EXTERN int JSTPixelTransportGetSlotCount(const JST_PIXEL_TRANSPORT *transport);
+JST_EXTERN size_t JSTPixelTransportGetSlotLength(const JST_PIXEL_TRANSPORT *transport);
+JST_EXTERN void JSTPixelTransportGetStatistics(JST_PIXEL_TRANSPORT *transport, JST_PIXEL_TRANSPORT_STATISTICS *statistics);
+
+#endif /* JSTPixelTransport_h */
@@ -0,0 +1,103 @@
+#include "JSTTest.h"
+#include "JSTPixelBlit.h"
+
+#include <vector>
+
+
+static const JST_BLIT_KERNEL kAllKernels[] = {
+    JST_BLIT_KERNEL_AUTOMATIC,
+    JST_BLIT_KERNEL_SCALAR,
+    JST_BLIT_KERNEL_SSE2,
+    JST_BLIT_KERNEL_AVX2,
+    JST_BLIT_KERNEL_NEON,
+};
+
+static JST_IMAGE *JSTCreateNoisePixelImage(int width, int height, int alignedWidth, uint32_t seed) {
+    JST_COLOR *pixels = (JST_COLOR *)calloc((size_t)alignedWidth * height + 1, sizeof(JST_COLOR));
+    uint32_t state = seed;
+    for (size_t i = 0; i < (size_t)alignedWidth * height; ++i) {
+        state = state * 1664525u + 1013904223u;
+        pixels[i].theColor = state;
+    }
+    return JSTCreatePixelImageWithPixels(pixels, width, alignedWidth, height, true);
+}
+
+/* Compares a blit against the per-pixel safe getter, which is the reference
+ * implementation of the orientation semantics. */
+static void JSTExpectBlitMatchesReference(JST_IMAGE *image, JST_BLIT_KERNEL kernel, int padding) {
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(image, &width, &height);
+    const int stride = width + padding;
+    const uint32_t poison = 0xA5A5A5A5u;
+    std::vector<JST_COLOR> buffer((size_t)stride * height + 1);
+    for (JST_COLOR &color : buffer) {
+        color.theColor = poison;
+    }
+    JST_EXPECT(JSTBlitOrientedPixelsOfPixelImage(image, buffer.data(), stride, kernel));
+
+    int mismatches = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < stride; ++x) {
+            uint32_t expected = poison;
+            if (x < width) {
+                JST_COLOR color;
+                JSTGetColorInPixelImageSafe(image, x, y, &color);
+                expected = color.theColor;
+            } else if (image->orientation == 0 && stride == image->alignedWidth) {
+                /* Same stride is copied in one go, padding included */
+                continue;
+            }
+            if (buffer[(size_t)y * stride + x].theColor != expected) {
+                ++mismatches;
+            }
+        }
+    }
+    JST_EXPECT_EQ(buffer[(size_t)stride * height].theColor, poison);
+    if (mismatches) {
+        fprintf(stderr, "  kernel %s, %dx%d (aligned %d), orientation %d, padding %d: %d mismatches\n",
+                JSTBlitKernelGetName(kernel), image->width, image->height, image->alignedWidth, image->orientation, padding, mismatches);
+    }
+    JST_EXPECT_EQ(mismatches, 0);
+}
+
+JST_TEST(testAutomaticKernelIsSupported) {
+    JST_EXPECT(JSTBlitKernelIsSupported(JST_BLIT_KERNEL_AUTOMATIC));
+    JST_EXPECT(JSTBlitKernelIsSupported(JST_BLIT_KERNEL_SCALAR));
+    printf("automatic kernel: %s\n", JSTBlitKernelGetName(JST_BLIT_KERNEL_AUTOMATIC));
+}
+
+JST_TEST(testAllKernelsMatchReference) {
+    const int sizes[][3] = {
+        { 1, 1, 1 }, { 1, 9, 1 }, { 9, 1, 12 }, { 3, 5, 3 }, { 4, 4, 4 }, { 8, 8, 8 },
+        { 13, 7, 16 }, { 64, 64, 64 }, { 65, 63, 72 }, { 130, 67, 130 }, { 129, 200, 136 },
+    };
+    for (JST_BLIT_KERNEL kernel : kAllKernels) {
+        if (!JSTBlitKernelIsSupported(kernel)) {
+            continue;
+        }
+        for (const auto &size : sizes) {
+            JST_IMAGE *image = JSTCreateNoisePixelImage(size[0], size[1], size[2], (uint32_t)(size[0] * 31 + size[1]));
+            for (JST_ORIENTATION orientation = 0; orientation < 4; ++orientation) {
+                image->orientation = orientation;
+                JSTExpectBlitMatchesReference(image, kernel, 0);
+                JSTExpectBlitMatchesReference(image, kernel, 5);
+            }
+            JSTFreePixelImage(image);
+        }
+    }
+}
+
+JST_TEST(testUnsupportedKernelAndShortStrideAreRejected) {
+    JST_IMAGE *image = JSTCreateNoisePixelImage(8, 4, 8, 7);
+    std::vector<JST_COLOR> buffer(64);
+    image->orientation = 1;
+    JST_EXPECT(!JSTBlitOrientedPixelsOfPixelImage(image, buffer.data(), 3, JST_BLIT_KERNEL_SCALAR));
+    for (JST_BLIT_KERNEL kernel : kAllKernels) {
+        if (!JSTBlitKernelIsSupported(kernel)) {
+            JST_EXPECT(!JSTBlitOrientedPixelsOfPixelImage(image, buffer.data(), 4, kernel));
+        }
+    }
+    JSTFreePixelImage(image);
+}
+
+JST_TEST_MAIN()
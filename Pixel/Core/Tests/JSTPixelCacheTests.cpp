@@ -0,0 +1,199 @@
+#include "JSTTest.h"
+#include "JSTPixelCache.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static std::string JSTTemporaryCachePath(const char *name) {
+    const char *directory = getenv("TMPDIR");
+    std::string path = directory && *directory ? directory : "/tmp";
+    path += "/JSTPixelCacheTests-";
+    path += std::to_string((long long)getpid());
+    path += "-";
+    path += name;
+    return path;
+}
+
+static JST_IMAGE *JSTCreateIndexedPixelImage(int width, int height, int alignedWidth) {
+    JST_COLOR *pixels = (JST_COLOR *)calloc((size_t)alignedWidth * height, sizeof(JST_COLOR));
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < alignedWidth; ++x) {
+            pixels[(size_t)y * alignedWidth + x].theColor = x < width ? (uint32_t)((y << 16) | x) : 0xDEADBEEFu;
+        }
+    }
+    return JSTCreatePixelImageWithPixels(pixels, width, alignedWidth, height, true);
+}
+
+static std::vector<uint8_t> JSTReadFile(const std::string &path) {
+    std::vector<uint8_t> bytes;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return bytes;
+    }
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return bytes;
+}
+
+static void JSTWriteFile(const std::string &path, const std::vector<uint8_t> &bytes) {
+    FILE *file = fopen(path.c_str(), "wb");
+    fwrite(bytes.data(), 1, bytes.size(), file);
+    fclose(file);
+}
+
+JST_TEST(testHashMatchesReferenceVectors) {
+    JST_EXPECT_EQ(JSTPixelCacheHashBytes("", 0), 0xEF46DB3751D8E999ULL);
+    JST_EXPECT_EQ(JSTPixelCacheHashBytes("a", 1), 0xD24EC4F1A98C6E5BULL);
+    JST_EXPECT_EQ(JSTPixelCacheHashBytes("abc", 3), 0x44BC2CF5AD770999ULL);
+
+    std::vector<uint8_t> bytes(1027);
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        bytes[i] = (uint8_t)(i * 31 + 7);
+    }
+    uint64_t hash = JSTPixelCacheHashBytes(bytes.data(), bytes.size());
+    bytes[1000] ^= 1;
+    JST_EXPECT(hash != JSTPixelCacheHashBytes(bytes.data(), bytes.size()));
+}
+
+JST_TEST(testRoundTripPacksAndMapsPixels) {
+    std::string path = JSTTemporaryCachePath("round-trip");
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(37, 21, 40);
+    image->orientation = 2;
+    const char profile[] = "fake icc profile";
+    JST_ASSERT(JSTPixelCacheWriteFile(path.c_str(), image, 42, profile, sizeof(profile)));
+
+    struct stat fileStat;
+    JST_ASSERT(stat(path.c_str(), &fileStat) == 0);
+    JST_EXPECT_EQ((long long)fileStat.st_size, (long long)(JST_PIXEL_CACHE_ALIGNMENT + 37 * 21 * 4));
+
+    const void *colorSpaceData = NULL;
+    size_t colorSpaceLength = 0;
+    JST_IMAGE *mapped = JSTPixelCacheCreatePixelImageWithFile(path.c_str(), 42, &colorSpaceData, &colorSpaceLength);
+    JST_ASSERT(mapped != NULL);
+    JST_EXPECT_EQ(mapped->width, 37);
+    JST_EXPECT_EQ(mapped->alignedWidth, 37);
+    JST_EXPECT_EQ(mapped->height, 21);
+    JST_EXPECT_EQ(mapped->orientation, 2);
+    JST_EXPECT(((uintptr_t)mapped->pixels % 4096) == 0);
+    JST_EXPECT(mapped->storage != NULL && !JSTPixelStorageIsWritable(mapped->storage));
+    JST_EXPECT_EQ(colorSpaceLength, sizeof(profile));
+    JST_EXPECT(colorSpaceData && memcmp(colorSpaceData, profile, sizeof(profile)) == 0);
+
+    for (int y = 0; y < 21; ++y) {
+        for (int x = 0; x < 37; ++x) {
+            JST_EXPECT_EQ(mapped->pixels[y * 37 + x].theColor, (uint32_t)((y << 16) | x));
+        }
+    }
+
+    JSTFreePixelImage(mapped);
+    JSTFreePixelImage(image);
+    unlink(path.c_str());
+}
+
+JST_TEST(testWriteCopiesMappedPixels) {
+    std::string path = JSTTemporaryCachePath("copy-on-write");
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(8, 8, 8);
+    JST_ASSERT(JSTPixelCacheWriteFile(path.c_str(), image, 7, NULL, 0));
+    std::vector<uint8_t> before = JSTReadFile(path);
+
+    JST_IMAGE *mapped = JSTPixelCacheCreatePixelImageWithFile(path.c_str(), 7, NULL, NULL);
+    JST_ASSERT(mapped != NULL);
+    JST_COLOR color;
+    color.theColor = 0xFFFFFFFFu;
+    JSTSetColorInPixelImageSafe(mapped, 3, 3, &color);
+    JST_EXPECT(mapped->storage == NULL);
+    JSTGetColorInPixelImageSafe(mapped, 3, 3, &color);
+    JST_EXPECT_EQ(color.theColor, 0xFFFFFFFFu);
+    JSTGetColorInPixelImageSafe(mapped, 4, 3, &color);
+    JST_EXPECT_EQ(color.theColor, (uint32_t)((3 << 16) | 4));
+    JST_EXPECT(JSTReadFile(path) == before);
+
+    JSTFreePixelImage(mapped);
+    JSTFreePixelImage(image);
+    unlink(path.c_str());
+}
+
+JST_TEST(testRejectsMismatchedFiles) {
+    std::string path = JSTTemporaryCachePath("reject");
+    JST_EXPECT(JSTPixelCacheCreatePixelImageWithFile(path.c_str(), 1, NULL, NULL) == NULL);
+
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(16, 16, 16);
+    JST_ASSERT(JSTPixelCacheWriteFile(path.c_str(), image, 1, NULL, 0));
+    JST_EXPECT(JSTPixelCacheCreatePixelImageWithFile(path.c_str(), 2, NULL, NULL) == NULL);
+
+    std::vector<uint8_t> bytes = JSTReadFile(path);
+    JST_PIXEL_CACHE_HEADER header;
+    memcpy(&header, bytes.data(), sizeof(header));
+
+    std::vector<uint8_t> truncated(bytes.begin(), bytes.end() - 4);
+    JSTWriteFile(path, truncated);
+    JST_EXPECT(JSTPixelCacheCreatePixelImageWithFile(path.c_str(), 1, NULL, NULL) == NULL);
+
+    std::vector<uint8_t> outdated = bytes;
+    header.version = JST_PIXEL_CACHE_VERSION + 1;
+    memcpy(outdated.data(), &header, sizeof(header));
+    JSTWriteFile(path, outdated);
+    JST_EXPECT(JSTPixelCacheCreatePixelImageWithFile(path.c_str(), 1, NULL, NULL) == NULL);
+
+    std::vector<uint8_t> oversized = bytes;
+    header.version = JST_PIXEL_CACHE_VERSION;
+    header.width = 1 << 20;
+    memcpy(oversized.data(), &header, sizeof(header));
+    JSTWriteFile(path, oversized);
+    JST_EXPECT(JSTPixelCacheCreatePixelImageWithFile(path.c_str(), 1, NULL, NULL) == NULL);
+
+    JSTWriteFile(path, bytes);
+    JST_IMAGE *mapped = JSTPixelCacheCreatePixelImageWithFile(path.c_str(), 1, NULL, NULL);
+    JST_EXPECT(mapped != NULL);
+    JSTFreePixelImage(mapped);
+
+    JSTFreePixelImage(image);
+    unlink(path.c_str());
+}
+
+JST_TEST(testMappedImageOutlivesSharingImages) {
+    std::string path = JSTTemporaryCachePath("sharing");
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(12, 9, 12);
+    JST_ASSERT(JSTPixelCacheWriteFile(path.c_str(), image, 3, NULL, 0));
+    JSTFreePixelImage(image);
+
+    JST_IMAGE *mapped = JSTPixelCacheCreatePixelImageWithFile(path.c_str(), 3, NULL, NULL);
+    JST_ASSERT(mapped != NULL);
+    JST_IMAGE *view = JSTCreatePixelImageViewWithPixelImageInRect(mapped, 0, 2, 2, 6, 6);
+    JST_IMAGE *copy = JSTCreatePixelImageSharingPixelImage(mapped);
+    JST_ASSERT(view != NULL && copy != NULL);
+    unlink(path.c_str());
+    JSTFreePixelImage(mapped);
+
+    JST_COLOR color;
+    JSTGetColorInPixelImageSafe(view, 1, 1, &color);
+    JST_EXPECT_EQ(color.theColor, (uint32_t)((3 << 16) | 3));
+    JSTGetColorInPixelImageSafe(copy, 11, 8, &color);
+    JST_EXPECT_EQ(color.theColor, (uint32_t)((8 << 16) | 11));
+    JSTFreePixelImage(view);
+    JSTFreePixelImage(copy);
+}
+
+JST_TEST(testEmptyImage) {
+    std::string path = JSTTemporaryCachePath("empty");
+    JST_IMAGE *image = JSTCreatePixelImage(0, 5);
+    JST_ASSERT(JSTPixelCacheWriteFile(path.c_str(), image, 9, NULL, 0));
+    JST_IMAGE *mapped = JSTPixelCacheCreatePixelImageWithFile(path.c_str(), 9, NULL, NULL);
+    JST_ASSERT(mapped != NULL);
+    JST_EXPECT_EQ(mapped->width, 0);
+    JST_EXPECT_EQ(mapped->height, 5);
+    JSTFreePixelImage(mapped);
+    JSTFreePixelImage(image);
+    unlink(path.c_str());
+}
+
+JST_TEST_MAIN()
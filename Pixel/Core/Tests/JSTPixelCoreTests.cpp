@@ -0,0 +1,272 @@
+#include "JSTTest.h"
+#include "JSTPixelCore.h"
+
+#include <cstring>
+#include <vector>
+
+
+static JST_IMAGE *JSTCreateIndexedPixelImage(int width, int height, int alignedWidth) {
+    JST_COLOR *pixels = (JST_COLOR *)calloc((size_t)alignedWidth * height, sizeof(JST_COLOR));
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < alignedWidth; ++x) {
+            /* Padding columns are poisoned to catch stride mistakes */
+            pixels[(size_t)y * alignedWidth + x].theColor = x < width ? (uint32_t)((y << 16) | x) : 0xDEADBEEFu;
+        }
+    }
+    return JSTCreatePixelImageWithPixels(pixels, width, alignedWidth, height, true);
+}
+
+static uint32_t JSTIndexedColorAt(int x, int y) {
+    return (uint32_t)((y << 16) | x);
+}
+
+JST_TEST(testCreateIsZeroedAndPacked) {
+    JST_IMAGE *image = JSTCreatePixelImage(7, 5);
+    JST_ASSERT(image != NULL);
+    JST_EXPECT_EQ(image->width, 7);
+    JST_EXPECT_EQ(image->alignedWidth, 7);
+    JST_EXPECT_EQ(image->height, 5);
+    JST_EXPECT_EQ(image->orientation, 0);
+    for (int i = 0; i < 35; ++i) {
+        JST_EXPECT_EQ(image->pixels[i].theColor, 0u);
+    }
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testCreateRejectsInvalidSizes) {
+    JST_EXPECT(JSTCreatePixelImage(-1, 5) == NULL);
+    JST_EXPECT(JSTCreatePixelImage(5, -1) == NULL);
+    JST_COLOR color;
+    JST_EXPECT(JSTCreatePixelImageWithPixels(&color, 2, 1, 1, false) == NULL);
+    JST_EXPECT(JSTCreatePixelImageWithPixels(NULL, 1, 1, 1, false) == NULL);
+
+    JST_IMAGE *empty = JSTCreatePixelImage(0, 0);
+    JST_ASSERT(empty != NULL);
+    JSTFreePixelImage(empty);
+}
+
+JST_TEST(testBorrowedPixelsAreNotFreed) {
+    std::vector<JST_COLOR> pixels(16);
+    JST_IMAGE *image = JSTCreatePixelImageWithPixels(pixels.data(), 4, 4, 4, false);
+    JST_ASSERT(image != NULL);
+    JST_EXPECT(image->isDestroyed);
+    JSTFreePixelImage(image); /* must not free the vector storage */
+    pixels[0].theColor = 1;
+    JST_EXPECT_EQ(pixels[0].theColor, 1u);
+}
+
+JST_TEST(testGetAndSetWithOrientationUp) {
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(5, 3, 8);
+    JST_COLOR color;
+    JSTGetColorInPixelImageSafe(image, 4, 2, &color);
+    JST_EXPECT_EQ(color.theColor, JSTIndexedColorAt(4, 2));
+
+    color.theColor = 0xFF112233u;
+    JSTSetColorInPixelImageSafe(image, 1, 1, &color);
+    JST_EXPECT_EQ(image->pixels[1 * 8 + 1].theColor, 0xFF112233u);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testGetAndSetOutOfBounds) {
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(5, 3, 8);
+    JST_COLOR color;
+    const int points[][2] = { { 50, 0 }, { 0, 30 }, { -1, 0 }, { 0, -1 }, { 60, 10 }, { -100, -100 } };
+    for (JST_ORIENTATION orientation = 0; orientation < 4; ++orientation) {
+        image->orientation = orientation;
+        for (const auto &point : points) {
+            color.theColor = 0x12345678u;
+            JSTGetColorInPixelImageSafe(image, point[0], point[1], &color);
+            JST_EXPECT_EQ(color.theColor, 0u);
+        }
+    }
+
+    image->orientation = 0;
+    color.theColor = 0xFFFFFFFFu;
+    JSTSetColorInPixelImageSafe(image, 5, 0, &color);
+    JSTSetColorInPixelImageSafe(image, -1, 0, &color);
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 5; ++x) {
+            JST_EXPECT_EQ(image->pixels[y * 8 + x].theColor, JSTIndexedColorAt(x, y));
+        }
+        /* Padding is untouched */
+        JST_EXPECT_EQ(image->pixels[y * 8 + 5].theColor, 0xDEADBEEFu);
+    }
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testOrientationMacrosRoundTrip) {
+    const int width = 6, height = 4;
+    for (JST_ORIENTATION orientation = 0; orientation < 4; ++orientation) {
+        int orientedWidth = (orientation == 1 || orientation == 2) ? height : width;
+        int orientedHeight = (orientation == 1 || orientation == 2) ? width : height;
+        for (int y = 0; y < orientedHeight; ++y) {
+            for (int x = 0; x < orientedWidth; ++x) {
+                int sx = x, sy = y;
+                SHIFT_XY_BY_ORIEN(sx, sy, width, height, orientation);
+                JST_EXPECT(sx >= 0 && sx < width && sy >= 0 && sy < height);
+                UNSHIFT_XY_BY_ORIEN(sx, sy, width, height, orientation);
+                JST_EXPECT_EQ(sx, x);
+                JST_EXPECT_EQ(sy, y);
+            }
+        }
+    }
+}
+
+JST_TEST(testOrientedSize) {
+    JST_IMAGE *image = JSTCreatePixelImage(5, 3);
+    int width, height;
+    for (JST_ORIENTATION orientation = 0; orientation < 4; ++orientation) {
+        image->orientation = orientation;
+        JSTGetOrientedSizeOfPixelImage(image, &width, &height);
+        bool swapped = orientation == 1 || orientation == 2;
+        JST_EXPECT_EQ(width, swapped ? 3 : 5);
+        JST_EXPECT_EQ(height, swapped ? 5 : 3);
+    }
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testCopyOrientedPixelsMatchesSafeGetter) {
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(5, 3, 8);
+    for (JST_ORIENTATION orientation = 0; orientation < 4; ++orientation) {
+        image->orientation = orientation;
+        int width, height;
+        JSTGetOrientedSizeOfPixelImage(image, &width, &height);
+        std::vector<JST_COLOR> buffer((size_t)width * height);
+        JSTCopyOrientedPixelsOfPixelImage(image, buffer.data());
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                JST_COLOR color;
+                JSTGetColorInPixelImageSafe(image, x, y, &color);
+                JST_EXPECT_EQ(buffer[(size_t)y * width + x].theColor, color.theColor);
+            }
+        }
+    }
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testGetColorsMatchesSafeGetter) {
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(5, 3, 8);
+    for (JST_ORIENTATION orientation = 0; orientation < 4; ++orientation) {
+        image->orientation = orientation;
+        int width, height;
+        JSTGetOrientedSizeOfPixelImage(image, &width, &height);
+
+        std::vector<JST_POS> points;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                JST_POS point = {};
+                point.x = x;
+                point.y = y;
+                points.push_back(point);
+            }
+        }
+        JST_EXPECT_EQ(JSTGetColorsInPixelImage(image, points.data(), (int)points.size()), -1);
+        for (const JST_POS &point : points) {
+            JST_COLOR color;
+            JSTGetColorInPixelImageSafe(image, point.x, point.y, &color);
+            JST_EXPECT_EQ(point.color.theColor, color.theColor);
+        }
+    }
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testGetColorsReportsFirstPointOutside) {
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(5, 3, 8);
+    JST_POS points[4] = {};
+    points[0].x = 1; points[0].y = 1;
+    points[1].x = 5; points[1].y = 0;
+    points[2].x = 4; points[2].y = 2;
+    points[3].x = 0; points[3].y = -1;
+    points[1].color.theColor = 0x12345678u;
+    JST_EXPECT_EQ(JSTGetColorsInPixelImage(image, points, 4), 1);
+    JST_EXPECT_EQ(points[0].color.theColor, JSTIndexedColorAt(1, 1));
+    JST_EXPECT_EQ(points[1].color.theColor, 0u);
+    JST_EXPECT_EQ(points[2].color.theColor, JSTIndexedColorAt(4, 2));
+    JST_EXPECT_EQ(points[3].color.theColor, 0u);
+    JST_EXPECT_EQ(JSTGetColorsInPixelImage(image, points, 0), -1);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testGetRowMatchesSafeGetter) {
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(5, 3, 8);
+    for (JST_ORIENTATION orientation = 0; orientation < 4; ++orientation) {
+        image->orientation = orientation;
+        int width, height;
+        JSTGetOrientedSizeOfPixelImage(image, &width, &height);
+
+        std::vector<JST_COLOR> row(width);
+        for (int y = 0; y < height; ++y) {
+            JST_ASSERT(JSTGetRowInPixelImage(image, y, row.data()));
+            for (int x = 0; x < width; ++x) {
+                JST_COLOR color;
+                JSTGetColorInPixelImageSafe(image, x, y, &color);
+                JST_EXPECT_EQ(row[x].theColor, color.theColor);
+            }
+        }
+        JST_EXPECT(!JSTGetRowInPixelImage(image, -1, row.data()));
+        JST_EXPECT(!JSTGetRowInPixelImage(image, height, row.data()));
+    }
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testCreateInRectCopiesRowsAndRotates) {
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(10, 6, 16);
+    image->orientation = 1;
+    JST_IMAGE *cropped = JSTCreatePixelImageWithPixelImageInRect(image, 2, 3, 1, 8, 5);
+    JST_ASSERT(cropped != NULL);
+    JST_EXPECT_EQ(cropped->width, 5);
+    JST_EXPECT_EQ(cropped->alignedWidth, 5);
+    JST_EXPECT_EQ(cropped->height, 4);
+    JST_EXPECT_EQ(cropped->orientation, 0); /* GET_ROTATE_ROTATE(1, 2) */
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 5; ++x) {
+            JST_EXPECT_EQ(cropped->pixels[y * 5 + x].theColor, JSTIndexedColorAt(x + 3, y + 1));
+        }
+    }
+    JSTFreePixelImage(cropped);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testCropIsClamped) {
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(10, 6, 10);
+    JST_IMAGE *cropped = JSTCreatePixelImageByCroppingPixelImage(image, -2, 4, 5, 10);
+    JST_ASSERT(cropped != NULL);
+    JST_EXPECT_EQ(cropped->width, 3);
+    JST_EXPECT_EQ(cropped->height, 2);
+    JST_EXPECT_EQ(cropped->pixels[0].theColor, JSTIndexedColorAt(0, 4));
+    JSTFreePixelImage(cropped);
+
+    JST_IMAGE *outside = JSTCreatePixelImageByCroppingPixelImage(image, 20, 20, 5, 5);
+    JST_ASSERT(outside != NULL);
+    JST_EXPECT_EQ(outside->width, 0);
+    JST_EXPECT_EQ(outside->height, 0);
+    JSTFreePixelImage(outside);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testCropKeepsOrientation) {
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(10, 6, 10);
+    image->orientation = 3;
+    JST_IMAGE *cropped = JSTCreatePixelImageByCroppingPixelImage(image, 0, 0, 4, 2);
+    JST_ASSERT(cropped != NULL);
+    JST_EXPECT_EQ(cropped->orientation, 3);
+    JSTFreePixelImage(cropped);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testCopyKeepsAlignmentAndOwnsPixels) {
+    JST_IMAGE *image = JSTCreateIndexedPixelImage(5, 3, 8);
+    image->orientation = 2;
+    JST_IMAGE *copied = JSTCopyPixelImage(image);
+    JST_ASSERT(copied != NULL);
+    JST_EXPECT(copied->pixels != image->pixels);
+    JST_EXPECT_EQ(copied->alignedWidth, 8);
+    JST_EXPECT_EQ(copied->orientation, 2);
+    JST_EXPECT(!copied->isDestroyed);
+    JST_EXPECT(memcmp(copied->pixels, image->pixels, 8 * 3 * sizeof(JST_COLOR)) == 0);
+    JSTFreePixelImage(image);
+    JST_EXPECT_EQ(copied->pixels[8 + 1].theColor, JSTIndexedColorAt(1, 1));
+    JSTFreePixelImage(copied);
+}
+
+JST_TEST_MAIN()
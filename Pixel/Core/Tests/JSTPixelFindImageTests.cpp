@@ -0,0 +1,270 @@
+#include "JSTTest.h"
+#include "JSTPixelFindImage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+
+static const JST_FIND_IMAGE_KERNEL kAllKernels[] = {
+    JST_FIND_IMAGE_KERNEL_AUTOMATIC,
+    JST_FIND_IMAGE_KERNEL_SCALAR,
+    JST_FIND_IMAGE_KERNEL_SSE2,
+    JST_FIND_IMAGE_KERNEL_AVX2,
+    JST_FIND_IMAGE_KERNEL_NEON,
+};
+
+
+/* MARK: - Reference */
+
+/* Brute force over every position of the region, without pyramids. */
+namespace Reference {
+
+struct Match {
+    int x;
+    int y;
+    long long difference;
+};
+
+static long long difference(const JST_IMAGE *image, const JST_IMAGE *templateImage, int x, int y) {
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(templateImage, &width, &height);
+    long long sum = 0;
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            JST_COLOR a, b;
+            JSTGetColorInPixelImageSafe(image, x + i, y + j, &a);
+            JSTGetColorInPixelImageSafe(templateImage, i, j, &b);
+            int differences[3] = { a.red - b.red, a.green - b.green, a.blue - b.blue };
+            for (int d : differences) {
+                sum += d * d;
+            }
+        }
+    }
+    return sum;
+}
+
+/* Every position of the region with its difference. */
+static std::vector<Match> positions(const JST_IMAGE *image, const JST_IMAGE *templateImage, int x1, int y1, int x2, int y2) {
+    int width, height, templateWidth, templateHeight;
+    JSTGetOrientedSizeOfPixelImage(image, &width, &height);
+    JSTGetOrientedSizeOfPixelImage(templateImage, &templateWidth, &templateHeight);
+    x1 = std::max(x1, 0);
+    y1 = std::max(y1, 0);
+    x2 = std::min(x2, width);
+    y2 = std::min(y2, height);
+    std::vector<Match> result;
+    for (int y = y1; y + templateHeight <= y2; ++y) {
+        for (int x = x1; x + templateWidth <= x2; ++x) {
+            result.push_back(Match{ x, y, difference(image, templateImage, x, y) });
+        }
+    }
+    return result;
+}
+
+static std::vector<Match> find(const std::vector<Match> &positions, int templateWidth, int templateHeight, double similarity, bool keepsOverlaps) {
+    long long maxDifference = JSTFindImageGetMaximumDifference(templateWidth, templateHeight, similarity);
+    std::vector<Match> result;
+    for (const Match &position : positions) {
+        if (position.difference <= maxDifference) {
+            result.push_back(position);
+        }
+    }
+    if (keepsOverlaps) {
+        return result;
+    }
+
+    /* the most similar first, then in row order, dropping overlaps */
+    std::vector<Match> order = result;
+    std::stable_sort(order.begin(), order.end(), [](const Match &a, const Match &b) {
+        return a.difference < b.difference;
+    });
+    std::vector<Match> kept;
+    for (const Match &match : order) {
+        bool overlaps = false;
+        for (const Match &other : kept) {
+            if (abs(other.x - match.x) < templateWidth && abs(other.y - match.y) < templateHeight) {
+                overlaps = true;
+                break;
+            }
+        }
+        if (!overlaps) {
+            kept.push_back(match);
+        }
+    }
+    std::sort(kept.begin(), kept.end(), [](const Match &a, const Match &b) {
+        return a.y != b.y ? a.y < b.y : a.x < b.x;
+    });
+    return kept;
+}
+
+}
+
+
+/* MARK: - Helpers */
+
+/* A pattern repeating every 23 x 19 pixels under some noise, so that a
+ * crop matches at several places with different similarities. */
+static JST_IMAGE *JSTCreateRepeatingScene(int width, int height, int alignedWidth, uint32_t seed) {
+    JST_COLOR *pixels = (JST_COLOR *)calloc((size_t)alignedWidth * height, sizeof(JST_COLOR));
+    JST_IMAGE *image = JSTCreatePixelImageWithPixels(pixels, width, alignedWidth, height, true);
+    uint32_t state = seed;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < alignedWidth; ++x) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            int px = x % 23, py = y % 19;
+            JST_COLOR &color = pixels[(size_t)y * alignedWidth + x];
+            color.red = (uint8_t)std::min(px * 11 + (int)(state % 9), 255);
+            color.green = (uint8_t)std::min(py * 13 + (int)((state >> 8) % 9), 255);
+            color.blue = (uint8_t)((px * py * 7 + (int)((state >> 16) % 9)) & 0xFF);
+            color.alpha = (uint8_t)(state >> 24);  /* ignored */
+        }
+    }
+    return image;
+}
+
+static void JSTExpectSameMatches(const std::vector<Reference::Match> &expected, const std::vector<JST_FIND_IMAGE_MATCH> &actual, long long count, int templateWidth, int templateHeight) {
+    JST_EXPECT_EQ(count, (long long)expected.size());
+    JST_ASSERT(actual.size() >= expected.size());
+    double sampleCount = 3.0 * templateWidth * templateHeight;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        JST_EXPECT_EQ(actual[i].x, expected[i].x);
+        JST_EXPECT_EQ(actual[i].y, expected[i].y);
+        double similarity = 1.0 - sqrt(expected[i].difference / sampleCount) / 255.0;
+        JST_EXPECT(fabs(actual[i].similarity - similarity) < 1e-12);
+    }
+}
+
+
+/* MARK: - Tests */
+
+JST_TEST(testAutomaticKernelIsSupported) {
+    JST_EXPECT(JSTFindImageKernelIsSupported(JST_FIND_IMAGE_KERNEL_AUTOMATIC));
+    JST_EXPECT(JSTFindImageKernelIsSupported(JST_FIND_IMAGE_KERNEL_SCALAR));
+    printf("automatic kernel: %s\n", JSTFindImageKernelGetName(JST_FIND_IMAGE_KERNEL_AUTOMATIC));
+}
+
+JST_TEST(testMaximumDifferenceFollowsSimilarity) {
+    JST_EXPECT_EQ(JSTFindImageGetMaximumDifference(10, 4, 1.0), 0);
+    JST_EXPECT_EQ(JSTFindImageGetMaximumDifference(10, 4, 0.0), 255LL * 255 * 3 * 40);
+    JST_EXPECT_EQ(JSTFindImageGetMaximumDifference(10, 4, -3.0), 255LL * 255 * 3 * 40);
+    /* 90% allows a difference of 25.5 on every channel */
+    JST_EXPECT_EQ(JSTFindImageGetMaximumDifference(2, 2, 0.9), 7803);
+}
+
+JST_TEST(testKernelsMatchReference) {
+    const int sizes[][3] = { { 70, 50, 70 }, { 61, 45, 64 } };
+    for (const auto &size : sizes) {
+        JST_IMAGE *image = JSTCreateRepeatingScene(size[0], size[1], size[2], 0x2545F491u + size[0]);
+        for (JST_ORIENTATION orientation = 0; orientation < 4; ++orientation) {
+            image->orientation = orientation;
+            int width, height;
+            JSTGetOrientedSizeOfPixelImage(image, &width, &height);
+            /* odd sizes, so that every level has partial blocks */
+            const int crops[][4] = { { 5, 3, 18, 17 }, { 20, 7, 9, 11 }, { 1, 1, 3, 2 } };
+            for (const auto &crop : crops) {
+                JST_IMAGE *templateImage = JSTCreatePixelImageByCroppingPixelImage(image, crop[0], crop[1], crop[2], crop[3]);
+                const int regions[][4] = { { 0, 0, width, height }, { 3, 2, 40, 37 }, { -5, -5, 1000, 1000 } };
+                const double similarities[] = { 1.0, 0.97, 0.9 };
+                for (const auto &region : regions) {
+                    std::vector<Reference::Match> positions = Reference::positions(image, templateImage, region[0], region[1], region[2], region[3]);
+                    for (double similarity : similarities) {
+                        for (bool keepsOverlaps : { true, false }) {
+                            std::vector<Reference::Match> expected = Reference::find(positions, crop[2], crop[3], similarity, keepsOverlaps);
+                            for (JST_FIND_IMAGE_KERNEL kernel : kAllKernels) {
+                                if (!JSTFindImageKernelIsSupported(kernel)) {
+                                    continue;
+                                }
+                                for (int levelCount : { -1, 0, 1, 2 }) {
+                                    JST_FIND_IMAGE_OPTIONS options;
+                                    JSTFindImageOptionsInit(&options);
+                                    options.similarity = similarity;
+                                    options.levelCount = levelCount;
+                                    options.threadCount = 3;
+                                    options.tileRows = 2;
+                                    options.keepsOverlaps = keepsOverlaps;
+                                    std::vector<JST_FIND_IMAGE_MATCH> actual(expected.size() + 1);
+                                    JST_FIND_IMAGE_STATISTICS statistics;
+                                    long long count = JSTFindImageInPixelImage(image, templateImage, region[0], region[1], region[2], region[3], &options, actual.data(), (long long)actual.size(), &statistics, kernel);
+                                    JSTExpectSameMatches(expected, actual, count, crop[2], crop[3]);
+                                    if (keepsOverlaps) {
+                                        JST_EXPECT_EQ(statistics.matchCount, count);
+                                    }
+                                    JST_EXPECT(statistics.candidateCounts[statistics.levelCount] == statistics.positionCount);
+                                    for (int level = 0; level < statistics.levelCount; ++level) {
+                                        JST_EXPECT(statistics.candidateCounts[level] <= statistics.candidateCounts[level + 1]);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+                JSTFreePixelImage(templateImage);
+            }
+        }
+        JSTFreePixelImage(image);
+    }
+}
+
+JST_TEST(testPyramidsPruneRepeatingScenes) {
+    JST_IMAGE *image = JSTCreateRepeatingScene(300, 200, 300, 7);
+    JST_IMAGE *templateImage = JSTCreatePixelImageByCroppingPixelImage(image, 40, 30, 32, 24);
+    JST_FIND_IMAGE_OPTIONS options;
+    JSTFindImageOptionsInit(&options);
+    JST_FIND_IMAGE_STATISTICS statistics;
+    long long count = JSTFindImageInPixelImage(image, templateImage, 0, 0, 300, 200, &options, NULL, 0, &statistics, JST_FIND_IMAGE_KERNEL_AUTOMATIC);
+    JST_EXPECT(count > 1);  /* the pattern repeats */
+    JST_EXPECT_EQ(statistics.levelCount, 2);
+    /* most positions never reach the full resolution */
+    JST_EXPECT(statistics.candidateCounts[0] * 10 < statistics.positionCount);
+    printf("positions: %lld, compared: %lld / %lld / %lld, matches: %lld\n", statistics.positionCount,
+           statistics.candidateCounts[2], statistics.candidateCounts[1], statistics.candidateCounts[0], count);
+    JSTFreePixelImage(templateImage);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testOnlyFirstMatchesAreWritten) {
+    JST_IMAGE *image = JSTCreatePixelImage(10, 4);
+    JST_IMAGE *templateImage = JSTCreatePixelImage(2, 2);
+    JST_FIND_IMAGE_OPTIONS options;
+    JSTFindImageOptionsInit(&options);
+    options.keepsOverlaps = true;
+    JST_FIND_IMAGE_MATCH matches[4] = {};
+    JST_EXPECT_EQ(JSTFindImageInPixelImage(image, templateImage, 0, 0, 10, 4, &options, matches, 3, NULL, JST_FIND_IMAGE_KERNEL_AUTOMATIC), 9 * 3);
+    JST_EXPECT_EQ(matches[2].x, 2);
+    JST_EXPECT_EQ(matches[2].y, 0);
+    JST_EXPECT(matches[2].similarity == 1.0);
+    JST_EXPECT_EQ(matches[3].x, 0);  /* untouched */
+
+    /* a uniform image is covered by non-overlapping copies */
+    options.keepsOverlaps = false;
+    JST_EXPECT_EQ(JSTFindImageInPixelImage(image, templateImage, 0, 0, 10, 4, &options, matches, 4, NULL, JST_FIND_IMAGE_KERNEL_AUTOMATIC), 5 * 2);
+    JST_EXPECT_EQ(matches[1].x, 2);
+    JST_EXPECT_EQ(matches[1].y, 0);
+    JSTFreePixelImage(templateImage);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testEmptyAndOversizedTemplates) {
+    JST_IMAGE *image = JSTCreatePixelImage(8, 8);
+    JST_IMAGE *emptyImage = JSTCreatePixelImage(0, 3);
+    JST_IMAGE *largeImage = JSTCreatePixelImage(5, 5);
+    JST_FIND_IMAGE_STATISTICS statistics;
+    JST_EXPECT_EQ(JSTFindImageInPixelImage(image, emptyImage, 0, 0, 8, 8, NULL, NULL, 0, NULL, JST_FIND_IMAGE_KERNEL_AUTOMATIC), -1);
+    JST_EXPECT_EQ(JSTFindImageInPixelImage(image, largeImage, 4, 0, 8, 8, NULL, NULL, 0, &statistics, JST_FIND_IMAGE_KERNEL_AUTOMATIC), 0);
+    JST_EXPECT_EQ(statistics.positionCount, 0);
+    JST_EXPECT_EQ(JSTFindImageInPixelImage(image, largeImage, 3, 3, 8, 8, NULL, NULL, 0, &statistics, JST_FIND_IMAGE_KERNEL_AUTOMATIC), 1);
+    for (JST_FIND_IMAGE_KERNEL kernel : kAllKernels) {
+        if (!JSTFindImageKernelIsSupported(kernel)) {
+            JST_EXPECT_EQ(JSTFindImageInPixelImage(image, largeImage, 0, 0, 8, 8, NULL, NULL, 0, NULL, kernel), -1);
+        }
+    }
+    JSTFreePixelImage(largeImage);
+    JSTFreePixelImage(emptyImage);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST_MAIN()
@@ -0,0 +1,224 @@
+#include "JSTTest.h"
+#include "JSTPixelFind.h"
+
+#include <cstdlib>
+#include <vector>
+
+
+static const JST_FIND_COLOR_KERNEL kAllKernels[] = {
+    JST_FIND_COLOR_KERNEL_AUTOMATIC,
+    JST_FIND_COLOR_KERNEL_SCALAR,
+    JST_FIND_COLOR_KERNEL_SSE2,
+    JST_FIND_COLOR_KERNEL_AVX2,
+    JST_FIND_COLOR_KERNEL_NEON,
+};
+
+
+/* MARK: - Reference */
+
+/* Brute force over every anchor position of the region, with the
+ * tolerance spelled out per channel. */
+namespace Reference {
+
+static bool matches(JST_COLOR color, const JST_POS &point) {
+    int similarity = point.similarity < 0 ? 0 : (point.similarity > 100 ? 100 : point.similarity);
+    int slack = (100 - similarity) * 255 / 100;
+    int differences[3] = {
+        abs((int)color.red - (int)point.color.red),
+        abs((int)color.green - (int)point.color.green),
+        abs((int)color.blue - (int)point.color.blue),
+    };
+    int offsets[3] = { point.color_offset.red, point.color_offset.green, point.color_offset.blue };
+    for (int i = 0; i < 3; ++i) {
+        if (differences[i] > offsets[i] + slack) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<JST_FIND_COLOR_MATCH> find(const JST_IMAGE *image, const std::vector<JST_POS> &points, int x1, int y1, int x2, int y2) {
+    int width, height;
+    JSTGetOrientedSizeOfPixelImage(image, &width, &height);
+    std::vector<JST_FIND_COLOR_MATCH> result;
+    for (int y = y1 < 0 ? 0 : y1; y < y2 && y < height; ++y) {
+        for (int x = x1 < 0 ? 0 : x1; x < x2 && x < width; ++x) {
+            bool isMatch = true;
+            for (const JST_POS &point : points) {
+                int px = x + point.x - points[0].x;
+                int py = y + point.y - points[0].y;
+                JST_COLOR color;
+                if (px < 0 || py < 0 || px >= width || py >= height) {
+                    isMatch = false;
+                    break;
+                }
+                JSTGetColorInPixelImageSafe(image, px, py, &color);
+                if (!matches(color, point)) {
+                    isMatch = false;
+                    break;
+                }
+            }
+            if (isMatch) {
+                result.push_back(JST_FIND_COLOR_MATCH{x, y});
+            }
+        }
+    }
+    return result;
+}
+
+}
+
+
+/* MARK: - Helpers */
+
+/* Few distinct colors, so that anchors match often and every kernel lane
+ * sees candidates. */
+static JST_IMAGE *JSTCreateFindScene(int width, int height, int alignedWidth, uint32_t seed) {
+    JST_COLOR *pixels = (JST_COLOR *)calloc((size_t)alignedWidth * height, sizeof(JST_COLOR));
+    JST_IMAGE *image = JSTCreatePixelImageWithPixels(pixels, width, alignedWidth, height, true);
+    static const uint32_t palette[] = { 0xff102030u, 0xff112233u, 0xff405060u, 0xff808080u, 0xfff0e0d0u };
+    uint32_t state = seed;
+    for (int i = 0; i < alignedWidth * height; ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        pixels[i].theColor = palette[state % 5];
+    }
+    return image;
+}
+
+static JST_POS JSTMakePoint(int x, int y, uint32_t color, int similarity, uint32_t offset = 0) {
+    JST_POS point = {};
+    point.x = x;
+    point.y = y;
+    point.color.theColor = color;
+    point.similarity = (int8_t)similarity;
+    point.color_offset.theColor = offset;
+    return point;
+}
+
+static void JSTExpectSameMatches(const std::vector<JST_FIND_COLOR_MATCH> &expected, const std::vector<JST_FIND_COLOR_MATCH> &actual, long long count) {
+    JST_EXPECT_EQ(count, (long long)expected.size());
+    JST_ASSERT(actual.size() >= expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        JST_EXPECT_EQ(actual[i].x, expected[i].x);
+        JST_EXPECT_EQ(actual[i].y, expected[i].y);
+    }
+}
+
+
+/* MARK: - Tests */
+
+JST_TEST(testAutomaticKernelIsSupported) {
+    JST_EXPECT(JSTFindColorKernelIsSupported(JST_FIND_COLOR_KERNEL_AUTOMATIC));
+    JST_EXPECT(JSTFindColorKernelIsSupported(JST_FIND_COLOR_KERNEL_SCALAR));
+    printf("automatic kernel: %s\n", JSTFindColorKernelGetName(JST_FIND_COLOR_KERNEL_AUTOMATIC));
+}
+
+JST_TEST(testToleranceFollowsSimilarityAndOffset) {
+    JST_COLOR color;
+    color.theColor = 0xff10203au;
+
+    JST_POS exact = JSTMakePoint(0, 0, 0x0010203au, 100);
+    JST_EXPECT(JSTFindColorMatchesPoint(color, &exact));  /* alpha is ignored */
+    exact.color.blue += 1;
+    JST_EXPECT(!JSTFindColorMatchesPoint(color, &exact));
+
+    /* 90% leaves 25 of slack on every channel */
+    JST_POS similar = JSTMakePoint(0, 0, 0xff10203au + 25, 90);
+    JST_EXPECT(JSTFindColorMatchesPoint(color, &similar));
+    similar.color.theColor += 1;
+    JST_EXPECT(!JSTFindColorMatchesPoint(color, &similar));
+
+    /* offsets are per channel */
+    JST_POS offset = JSTMakePoint(0, 0, 0xff15203au, 100, 0x00050000u);
+    JST_EXPECT(JSTFindColorMatchesPoint(color, &offset));
+    offset.color.green += 1;
+    JST_EXPECT(!JSTFindColorMatchesPoint(color, &offset));
+
+    /* out of range similarities are clamped */
+    JST_POS any = JSTMakePoint(0, 0, 0xffffffffu, -20);
+    JST_EXPECT(JSTFindColorMatchesPoint(color, &any));
+}
+
+JST_TEST(testKernelsMatchReference) {
+    const int sizes[][3] = { { 37, 23, 37 }, { 64, 17, 72 }, { 5, 9, 5 } };
+    for (const auto &size : sizes) {
+        JST_IMAGE *image = JSTCreateFindScene(size[0], size[1], size[2], 0x2545F491u + size[0]);
+        std::vector<std::vector<JST_POS>> searches = {
+            { JSTMakePoint(10, 10, 0xff102030u, 100) },
+            { JSTMakePoint(10, 10, 0xff102030u, 100), JSTMakePoint(11, 10, 0xff808080u, 100) },
+            { JSTMakePoint(4, 4, 0xff102030u, 95), JSTMakePoint(2, 5, 0xff405060u, 100), JSTMakePoint(6, 1, 0xfff0e0d0u, 90) },
+            { JSTMakePoint(0, 0, 0xff112233u, 100, 0x00020202u), JSTMakePoint(0, 2, 0xff808080u, 80), JSTMakePoint(-3, 0, 0xff808080u, 100) },
+        };
+        const int regions[][4] = { { 0, 0, size[0], size[1] }, { 3, 2, 20, 11 }, { -5, -5, 1000, 1000 }, { 8, 8, 8, 20 } };
+        for (JST_ORIENTATION orientation = 0; orientation < 4; ++orientation) {
+            image->orientation = orientation;
+            for (const auto &points : searches) {
+                for (const auto &region : regions) {
+                    std::vector<JST_FIND_COLOR_MATCH> expected = Reference::find(image, points, region[0], region[1], region[2], region[3]);
+                    for (JST_FIND_COLOR_KERNEL kernel : kAllKernels) {
+                        if (!JSTFindColorKernelIsSupported(kernel)) {
+                            continue;
+                        }
+                        std::vector<JST_FIND_COLOR_MATCH> actual(expected.size() + 1);
+                        JST_FIND_COLOR_STATISTICS statistics;
+                        long long count = JSTFindColorInPixelImage(image, points.data(), (int)points.size(), region[0], region[1], region[2], region[3], actual.data(), (long long)actual.size(), &statistics, kernel);
+                        JSTExpectSameMatches(expected, actual, count);
+                        JST_EXPECT_EQ(statistics.matchCount, count);
+                        JST_EXPECT(statistics.candidateCount >= count);
+                        JST_EXPECT(statistics.candidateCount <= statistics.scannedCount);
+                    }
+                }
+            }
+        }
+        JSTFreePixelImage(image);
+    }
+}
+
+JST_TEST(testOnlyFirstMatchesAreWritten) {
+    JST_IMAGE *image = JSTCreatePixelImage(10, 4);
+    for (int i = 0; i < 40; ++i) {
+        image->pixels[i].theColor = 0xff336699u;
+    }
+    JST_POS point = JSTMakePoint(0, 0, 0xff336699u, 100);
+    JST_FIND_COLOR_MATCH matches[4] = {};
+    JST_EXPECT_EQ(JSTFindColorInPixelImage(image, &point, 1, 0, 0, 10, 4, matches, 3, NULL, JST_FIND_COLOR_KERNEL_AUTOMATIC), 40);
+    JST_EXPECT_EQ(matches[2].x, 2);
+    JST_EXPECT_EQ(matches[2].y, 0);
+    JST_EXPECT_EQ(matches[3].x, 0);  /* untouched */
+    JST_EXPECT_EQ(JSTFindColorInPixelImage(image, &point, 1, 0, 0, 10, 4, NULL, 0, NULL, JST_FIND_COLOR_KERNEL_AUTOMATIC), 40);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testPointsOutsideRejectAnchors) {
+    JST_IMAGE *image = JSTCreatePixelImage(8, 8);
+    for (int i = 0; i < 64; ++i) {
+        image->pixels[i].theColor = 0xff000000u;
+    }
+    /* every pixel matches, but the second point must stay in the image */
+    JST_POS points[2] = { JSTMakePoint(5, 5, 0xff000000u, 100), JSTMakePoint(8, 3, 0xff000000u, 100) };
+    JST_FIND_COLOR_STATISTICS statistics;
+    JST_EXPECT_EQ(JSTFindColorInPixelImage(image, points, 2, 0, 0, 8, 8, NULL, 0, &statistics, JST_FIND_COLOR_KERNEL_AUTOMATIC), 5 * 6);
+    JST_EXPECT_EQ(statistics.scannedCount, 5 * 6);
+
+    /* larger than the image */
+    points[1] = JSTMakePoint(5, 14, 0xff000000u, 100);
+    JST_EXPECT_EQ(JSTFindColorInPixelImage(image, points, 2, 0, 0, 8, 8, NULL, 0, &statistics, JST_FIND_COLOR_KERNEL_AUTOMATIC), 0);
+    JST_EXPECT_EQ(statistics.scannedCount, 0);
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(testEmptySearchesAndUnsupportedKernelsAreRejected) {
+    JST_IMAGE *image = JSTCreatePixelImage(4, 4);
+    JST_POS point = JSTMakePoint(0, 0, 0, 100);
+    JST_EXPECT_EQ(JSTFindColorInPixelImage(image, &point, 0, 0, 0, 4, 4, NULL, 0, NULL, JST_FIND_COLOR_KERNEL_AUTOMATIC), -1);
+    for (JST_FIND_COLOR_KERNEL kernel : kAllKernels) {
+        if (!JSTFindColorKernelIsSupported(kernel)) {
+            JST_EXPECT_EQ(JSTFindColorInPixelImage(image, &point, 1, 0, 0, 4, 4, NULL, 0, NULL, kernel), -1);
+        }
+    }
+    JSTFreePixelImage(image);
+}
+
+JST_TEST_MAIN()
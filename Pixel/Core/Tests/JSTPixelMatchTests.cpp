@@ -0,0 +1,912 @@
+#include "JSTTest.h"
+#include "JSTPixelMatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <vector>
+
+
+static const JST_PIXEL_MATCH_KERNEL kAllKernels[] = {
+    JST_PIXEL_MATCH_KERNEL_AUTOMATIC,
+    JST_PIXEL_MATCH_KERNEL_SCALAR,
+    JST_PIXEL_MATCH_KERNEL_SSE2,
+    JST_PIXEL_MATCH_KERNEL_AVX2,
+    JST_PIXEL_MATCH_KERNEL_NEON,
+};
+
+
+/* MARK: - Reference */
+
+/* Line by line transliteration of the Swift PixelMatch the app used to ship,
+ * kept independent of the library so that it stays the golden
+ * implementation. CGFloat is a double on every platform the app runs on. */
+namespace Reference {
+
+static double blend(double component, double alpha) { return 255.0 + (component - 255.0) * alpha; }
+static double rgb2y(double r, double g, double b) { return (r * 0.29889531) + (g * 0.58662247) + (b * 0.11448223); }
+static double rgb2i(double r, double g, double b) { return (r * 0.59597799) - (g * 0.27417610) - (b * 0.32180189); }
+static double rgb2q(double r, double g, double b) { return (r * 0.21147017) - (g * 0.52261711) + (b * 0.31114694); }
+
+static double colorDelta(JST_COLOR color1, JST_COLOR color2, bool yOnly = false) {
+    if (color1.theColor == color2.theColor) { return 0; }
+
+    double a1 = color1.alpha, r1 = color1.red, g1 = color1.green, b1 = color1.blue;
+    double a2 = color2.alpha, r2 = color2.red, g2 = color2.green, b2 = color2.blue;
+
+    if (a1 < 255.0) {
+        a1 /= 255.0;
+        r1 = blend(r1, a1);
+        g1 = blend(g1, a1);
+        b1 = blend(b1, a1);
+    }
+
+    if (a2 < 255.0) {
+        a2 /= 255.0;
+        r2 = blend(r2, a2);
+        g2 = blend(g2, a2);
+        b2 = blend(b2, a2);
+    }
+
+    double y = rgb2y(r1, g1, b1) - rgb2y(r2, g2, b2);
+    if (yOnly) { return y; }
+    double i = rgb2i(r1, g1, b1) - rgb2i(r2, g2, b2);
+    double q = rgb2q(r1, g1, b1) - rgb2q(r2, g2, b2);
+
+    return 0.5053 * y * y + 0.299 * i * i + 0.1957 * q * q;
+}
+
+static bool hasManySiblings(const std::vector<JST_COLOR> &img, int x1, int y1, int width, int height) {
+    int x0 = std::max(x1 - 1, 0), y0 = std::max(y1 - 1, 0);
+    int x2 = std::min(x1 + 1, width - 1), y2 = std::min(y1 + 1, height - 1);
+    int pos = y1 * width + x1;
+    int zeroes = x1 == x0 || x1 == x2 || y1 == y0 || y1 == y2 ? 1 : 0;
+
+    for (int x = x0; x <= x2; ++x) {
+        for (int y = y0; y <= y2; ++y) {
+            if (x == x1 && y == y1) { continue; }
+
+            int pos2 = y * width + x;
+            if (img[pos].theColor == img[pos2].theColor) { zeroes += 1; }
+            if (zeroes > 2) { return true; }
+        }
+    }
+
+    return false;
+}
+
+static bool antialiased(const std::vector<JST_COLOR> &img, int x1, int y1, int width, int height, const std::vector<JST_COLOR> &img2) {
+    int x0 = std::max(x1 - 1, 0), y0 = std::max(y1 - 1, 0);
+    int x2 = std::min(x1 + 1, width - 1), y2 = std::min(y1 + 1, height - 1);
+    int pos = y1 * width + x1;
+    int zeroes = x1 == x0 || x1 == x2 || y1 == y0 || y1 == y2 ? 1 : 0;
+
+    double min = 0, max = 0;
+    int minX = -1, minY = -1, maxX = -1, maxY = -1;
+
+    for (int x = x0; x <= x2; ++x) {
+        for (int y = y0; y <= y2; ++y) {
+            if (x == x1 && y == y1) { continue; }
+
+            double delta = colorDelta(img[pos], img[y * width + x], true);
+
+            if (delta == 0) {
+                zeroes += 1;
+                if (zeroes > 2) { return false; }
+            } else if (delta < min) {
+                min = delta;
+                minX = x;
+                minY = y;
+            } else if (delta > max) {
+                max = delta;
+                maxX = x;
+                maxY = y;
+            }
+        }
+    }
+
+    if (min == 0 || max == 0) { return false; }
+
+    return (hasManySiblings(img, minX, minY, width, height) && hasManySiblings(img2, minX, minY, width, height)) ||
+        (hasManySiblings(img, maxX, maxY, width, height) && hasManySiblings(img2, maxX, maxY, width, height));
+}
+
+static void drawPixel(std::vector<JST_COLOR> &output, int pos, uint8_t r, uint8_t g, uint8_t b) {
+    output[pos].theColor = 0xff000000u | (uint32_t)b << 16 | (uint32_t)g << 8 | (uint32_t)r;
+}
+
+static void drawGrayPixel(JST_COLOR color, int pos, double alpha, std::vector<JST_COLOR> &output) {
+    uint8_t val = (uint8_t)blend(rgb2y(color.red, color.green, color.blue), alpha * (double)color.alpha / 255.0);
+    drawPixel(output, pos, val, val, val);
+}
+
+static long long pixelMatch(const std::vector<JST_COLOR> &a32, const std::vector<JST_COLOR> &b32, std::vector<JST_COLOR> &output, int width, int height, const JST_PIXEL_MATCH_OPTIONS &options) {
+    int len = width * height;
+    bool identical = true;
+    for (int i = 0; i < len; ++i) {
+        if (a32[i].theColor != b32[i].theColor) { identical = false; break; }
+    }
+    if (identical) {
+        if (!options.diffMask) {
+            for (int i = 0; i < len; ++i) { drawGrayPixel(a32[i], i, options.alpha, output); }
+        }
+        return 0;
+    }
+
+    double maxDelta = 35215 * options.threshold * options.threshold;
+
+    long long diff = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int pos = y * width + x;
+
+            double delta = colorDelta(a32[pos], b32[pos]);
+
+            if (delta > maxDelta) {
+                if (!options.includeAA && (antialiased(a32, x, y, width, height, b32) ||
+                    antialiased(b32, x, y, width, height, a32))) {
+                    if (!options.diffMask) { drawPixel(output, pos, options.aaColor[0], options.aaColor[1], options.aaColor[2]); }
+                } else {
+                    drawPixel(output, pos, options.diffColor[0], options.diffColor[1], options.diffColor[2]);
+                    diff += 1;
+                }
+            } else {
+                if (!options.diffMask) { drawGrayPixel(a32[pos], pos, options.alpha, output); }
+            }
+        }
+    }
+
+    return diff;
+}
+
+}  // namespace Reference
+
+
+/* MARK: - Scenes */
+
+struct JSTPixelMatchScene {
+    const char *name;
+    int width;
+    int height;
+    std::vector<JST_COLOR> pixels1;
+    std::vector<JST_COLOR> pixels2;
+};
+
+static uint32_t JSTNextRandom(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static JST_COLOR JSTMakeColor(int r, int g, int b, int a) {
+    JST_COLOR color;
+    color.red = (uint8_t)std::min(std::max(r, 0), 255);
+    color.green = (uint8_t)std::min(std::max(g, 0), 255);
+    color.blue = (uint8_t)std::min(std::max(b, 0), 255);
+    color.alpha = (uint8_t)std::min(std::max(a, 0), 255);
+    return color;
+}
+
+static JSTPixelMatchScene JSTMakeScene(const char *name, int width, int height) {
+    JSTPixelMatchScene scene;
+    scene.name = name;
+    scene.width = width;
+    scene.height = height;
+    scene.pixels1.resize((size_t)width * height);
+    scene.pixels2.resize((size_t)width * height);
+    return scene;
+}
+
+/* Opaque noise, with a few pixels nudged by small amounts in the second image. */
+static JSTPixelMatchScene JSTMakeNoiseScene(int width, int height, uint32_t seed) {
+    JSTPixelMatchScene scene = JSTMakeScene("noise", width, height);
+    uint32_t state = seed;
+    for (size_t i = 0; i < scene.pixels1.size(); ++i) {
+        scene.pixels1[i].theColor = JSTNextRandom(state) | 0xff000000u;
+        scene.pixels2[i] = scene.pixels1[i];
+        uint32_t roll = JSTNextRandom(state);
+        if (roll % 5 == 0) {
+            JST_COLOR c = scene.pixels1[i];
+            int d = (int)(roll >> 8) % 41 - 20;
+            scene.pixels2[i] = JSTMakeColor(c.red + d, c.green - d / 2, c.blue + (int)(roll >> 16) % 7 - 3, 255);
+        } else if (roll % 97 == 1) {
+            scene.pixels2[i].theColor = JSTNextRandom(state) | 0xff000000u;
+        }
+    }
+    return scene;
+}
+
+/* Smooth gradients shifted by a fraction, so deltas cover the whole range
+ * around the default thresholds. */
+static JSTPixelMatchScene JSTMakeGradientScene(int width, int height) {
+    JSTPixelMatchScene scene = JSTMakeScene("gradient", width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            size_t pos = (size_t)y * width + x;
+            scene.pixels1[pos] = JSTMakeColor(x * 255 / std::max(width - 1, 1), y * 255 / std::max(height - 1, 1), (x + y) * 3 % 256, 255);
+            scene.pixels2[pos] = JSTMakeColor(x * 255 / std::max(width - 1, 1) + (y % 9) * 3, y * 255 / std::max(height - 1, 1) - (x % 7) * 4, (x + y) * 3 % 256, 255);
+        }
+    }
+    return scene;
+}
+
+/* Anti-aliased shapes on flat backgrounds: a diagonal line drawn with a
+ * one pixel soft edge, and the same line moved by half a pixel, plus a
+ * rectangle that only exists in the second image. */
+static JSTPixelMatchScene JSTMakeAntialiasedScene(int width, int height) {
+    JSTPixelMatchScene scene = JSTMakeScene("antialiased", width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            size_t pos = (size_t)y * width + x;
+            double d1 = std::fabs((double)x - (double)y * 0.7 - 3.0);
+            double d2 = std::fabs((double)x - (double)y * 0.7 - 3.5);
+            int v1 = d1 < 1.0 ? (int)(255.0 * d1) : 255;
+            int v2 = d2 < 1.0 ? (int)(255.0 * d2) : 255;
+            scene.pixels1[pos] = JSTMakeColor(v1, v1, 255, 255);
+            scene.pixels2[pos] = JSTMakeColor(v2, v2, 255, 255);
+            if (x > width / 2 && x < width / 2 + 6 && y > height / 3 && y < height / 3 + 5) {
+                scene.pixels2[pos] = JSTMakeColor(20, 200, 40, 255);
+            }
+        }
+    }
+    return scene;
+}
+
+/* Semi-transparent pixels, including fully transparent ones which all
+ * blend to white regardless of their color. */
+static JSTPixelMatchScene JSTMakeAlphaScene(int width, int height, uint32_t seed) {
+    JSTPixelMatchScene scene = JSTMakeScene("alpha", width, height);
+    uint32_t state = seed;
+    for (size_t i = 0; i < scene.pixels1.size(); ++i) {
+        uint32_t c = JSTNextRandom(state);
+        uint32_t roll = JSTNextRandom(state);
+        static const int alphas[] = { 0, 1, 64, 127, 128, 200, 254, 255 };
+        int a1 = alphas[roll % 8];
+        int a2 = roll % 3 == 0 ? alphas[(roll >> 4) % 8] : a1;
+        scene.pixels1[i] = JSTMakeColor((int)(c & 0xff), (int)(c >> 8 & 0xff), (int)(c >> 16 & 0xff), a1);
+        scene.pixels2[i] = JSTMakeColor((int)(c & 0xff) + (int)(roll >> 8) % 11 - 5, (int)(c >> 8 & 0xff), (int)(c >> 16 & 0xff) - (int)(roll >> 12) % 9, a2);
+    }
+    return scene;
+}
+
+static JSTPixelMatchScene JSTMakeIdenticalScene(int width, int height, uint32_t seed) {
+    JSTPixelMatchScene scene = JSTMakeScene("identical", width, height);
+    uint32_t state = seed;
+    for (size_t i = 0; i < scene.pixels1.size(); ++i) {
+        scene.pixels1[i].theColor = JSTNextRandom(state);
+    }
+    scene.pixels2 = scene.pixels1;
+    return scene;
+}
+
+/* Pairs whose exact delta lies within a hair of the threshold, the only
+ * place where single precision could disagree with the Swift code. */
+static JSTPixelMatchScene JSTMakeNearThresholdScene(int width, int height, double threshold, uint32_t seed, int *nearCount) {
+    JSTPixelMatchScene scene = JSTMakeScene("near threshold", width, height);
+    double maxDelta = 35215 * threshold * threshold;
+    uint32_t state = seed;
+    *nearCount = 0;
+    for (size_t i = 0; i < scene.pixels1.size(); ++i) {
+        JST_COLOR c1;
+        c1.theColor = JSTNextRandom(state);
+        if (i % 2 == 0) {
+            c1.alpha = 255;
+        }
+
+        /* walk one channel until the delta crosses the threshold, then keep
+         * whichever side is closer to it */
+        JST_COLOR best = c1;
+        double bestDistance = 1e30;
+        uint32_t roll = JSTNextRandom(state);
+        int dr = (int)(roll % 3) - 1, dg = (int)(roll >> 2 & 3) - 1, db = (int)(roll >> 4 & 3) - 1;
+        if (dr == 0 && dg == 0 && db == 0) {
+            dr = 1;
+        }
+        for (int k = 1; k < 256; ++k) {
+            JST_COLOR c2 = JSTMakeColor(c1.red + dr * k, c1.green + dg * k, c1.blue + db * k, c1.alpha);
+            double distance = std::fabs(Reference::colorDelta(c1, c2) - maxDelta);
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = c2;
+            }
+        }
+        if (bestDistance < 1.0) {
+            ++*nearCount;
+        }
+        scene.pixels1[i] = c1;
+        scene.pixels2[i] = best;
+    }
+    return scene;
+}
+
+/* Flat content with changed shapes that only connect through tile
+ * boundaries or corners: a U whose arms meet far below their tops,
+ * staircases joined diagonally, a spiral and isolated dots. */
+static JSTPixelMatchScene JSTMakeShapesScene(int width, int height) {
+    JSTPixelMatchScene scene = JSTMakeScene("shapes", width, height);
+    for (size_t i = 0; i < scene.pixels1.size(); ++i) {
+        scene.pixels1[i] = JSTMakeColor(240, 240, 240, 255);
+        scene.pixels2[i] = scene.pixels1[i];
+    }
+    auto mark = [&](int x, int y) {
+        if (x >= 0 && x < width && y >= 0 && y < height) {
+            scene.pixels2[(size_t)y * width + x] = JSTMakeColor(10, 10, 200, 255);
+        }
+    };
+    for (int y = 2; y < height - 4; ++y) {
+        mark(2, y);
+        mark(8, y);
+    }
+    for (int x = 2; x <= 8; ++x) {
+        mark(x, height - 4);
+    }
+    for (int i = 0; i < height / 2; ++i) {
+        mark(12 + i, 3 + i);
+        mark(width - 4 - i, 1 + i);
+    }
+    int left = 20, top = height / 2, right = width - 2, bottom = height - 2;
+    while (left < right && top < bottom) {
+        for (int x = left; x <= right; ++x) mark(x, top);
+        for (int y = top; y <= bottom; ++y) mark(right, y);
+        for (int x = right; x >= left; --x) mark(x, bottom);
+        for (int y = bottom; y >= top + 2; --y) mark(left, y);
+        left += 2; top += 2; right -= 2; bottom -= 2;
+    }
+    for (int y = 1; y < height; y += 9) {
+        mark(width / 3, y);
+    }
+    return scene;
+}
+
+
+/* MARK: - Helpers */
+
+static JST_IMAGE *JSTCreatePaddedPixelImage(const std::vector<JST_COLOR> &pixels, int width, int height, int padding, uint32_t fill) {
+    int alignedWidth = width + padding;
+    JST_COLOR *buffer = (JST_COLOR *)malloc(std::max((size_t)alignedWidth * height, (size_t)1) * sizeof(JST_COLOR));
+    for (size_t i = 0; i < (size_t)alignedWidth * height; ++i) {
+        buffer[i].theColor = fill;
+    }
+    for (int y = 0; y < height && !pixels.empty(); ++y) {
+        std::copy(pixels.begin() + (size_t)y * width, pixels.begin() + (size_t)(y + 1) * width, buffer + (size_t)y * alignedWidth);
+    }
+    return JSTCreatePixelImageWithPixels(buffer, width, alignedWidth, height, true);
+}
+
+/* Stores pixels rotated so that the image, viewed in the given orientation,
+ * shows them upright. The layout is found by copying out an image of indices. */
+static JST_IMAGE *JSTCreateRotatedPixelImage(const std::vector<JST_COLOR> &pixels, int width, int height, uint8_t orientation, int padding) {
+    bool swapsAxes = orientation == 1 || orientation == 2;
+    int storedWidth = swapsAxes ? height : width;
+    int storedHeight = swapsAxes ? width : height;
+    std::vector<JST_COLOR> indices((size_t)storedWidth * storedHeight);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        indices[i].theColor = (uint32_t)i;
+    }
+    JST_IMAGE *indexImage = JSTCreatePaddedPixelImage(indices, storedWidth, storedHeight, 0, 0);
+    indexImage->orientation = orientation;
+    std::vector<JST_COLOR> layout(indices.size());
+    JSTCopyOrientedPixelsOfPixelImage(indexImage, layout.data());
+    JSTFreePixelImage(indexImage);
+
+    std::vector<JST_COLOR> stored(indices.size());
+    for (size_t i = 0; i < layout.size(); ++i) {
+        stored[layout[i].theColor] = pixels[i];
+    }
+    JST_IMAGE *pixelImage = JSTCreatePaddedPixelImage(stored, storedWidth, storedHeight, padding, 0);
+    pixelImage->orientation = orientation;
+    return pixelImage;
+}
+
+static const uint32_t kPoison = 0x5A5A5A5Au;
+
+/* Runs a kernel on padded copies of the scene, in one or several row
+ * bands, and checks every output pixel and the count against the golden
+ * implementation. */
+static void JSTExpectMatchesReference(const JSTPixelMatchScene &scene, const JST_PIXEL_MATCH_OPTIONS &options, JST_PIXEL_MATCH_KERNEL kernel, int padding, int bands) {
+    std::vector<JST_COLOR> expected((size_t)scene.width * scene.height);
+    for (JST_COLOR &color : expected) {
+        color.theColor = kPoison;
+    }
+    long long expectedDiff = Reference::pixelMatch(scene.pixels1, scene.pixels2, expected, scene.width, scene.height, options);
+
+    JST_IMAGE *image1 = JSTCreatePaddedPixelImage(scene.pixels1, scene.width, scene.height, padding, 0x11111111u);
+    JST_IMAGE *image2 = JSTCreatePaddedPixelImage(scene.pixels2, scene.width, scene.height, padding, 0x22222222u);
+    JST_IMAGE *output = JSTCreatePaddedPixelImage(std::vector<JST_COLOR>(), scene.width, scene.height, padding, kPoison);
+
+    long long diff = 0;
+    for (int band = 0; band < bands; ++band) {
+        int y1 = scene.height * band / bands;
+        int y2 = scene.height * (band + 1) / bands;
+        diff += JSTPixelMatchPixelImages(image1, image2, output, y1, y2, &options, kernel);
+    }
+
+    int mismatches = 0;
+    for (int y = 0; y < scene.height; ++y) {
+        for (int x = 0; x < output->alignedWidth; ++x) {
+            uint32_t actual = output->pixels[(size_t)y * output->alignedWidth + x].theColor;
+            uint32_t wanted = x < scene.width ? expected[(size_t)y * scene.width + x].theColor : kPoison;
+            if (actual != wanted) {
+                ++mismatches;
+            }
+        }
+    }
+    if (mismatches || diff != expectedDiff) {
+        fprintf(stderr, "  kernel %s, scene %s %dx%d, padding %d, bands %d, threshold %g, includeAA %d, diffMask %d, alpha %g: %d mismatches, %lld vs %lld different\n",
+                JSTPixelMatchKernelGetName(kernel), scene.name, scene.width, scene.height, padding, bands,
+                options.threshold, options.includeAA, options.diffMask, options.alpha, mismatches, diff, expectedDiff);
+    }
+    JST_EXPECT_EQ(mismatches, 0);
+    JST_EXPECT_EQ(diff, expectedDiff);
+
+    JSTFreePixelImage(image1);
+    JSTFreePixelImage(image2);
+    JSTFreePixelImage(output);
+}
+
+/* Regions of the golden diff mask, by flood fill. */
+static std::vector<JST_PIXEL_MATCH_REGION> JSTFindReferenceRegions(const JSTPixelMatchScene &scene, const JST_PIXEL_MATCH_OPTIONS &options) {
+    JST_PIXEL_MATCH_OPTIONS maskOptions = options;
+    maskOptions.diffMask = true;
+    std::vector<JST_COLOR> mask((size_t)scene.width * scene.height);
+    for (JST_COLOR &color : mask) {
+        color.theColor = kPoison;
+    }
+    Reference::pixelMatch(scene.pixels1, scene.pixels2, mask, scene.width, scene.height, maskOptions);
+
+    std::vector<JST_PIXEL_MATCH_REGION> regions;
+    std::vector<bool> isVisited(mask.size(), false);
+    for (size_t start = 0; start < mask.size(); ++start) {
+        if (mask[start].theColor == kPoison || isVisited[start]) {
+            continue;
+        }
+        int minX = scene.width, minY = scene.height, maxX = -1, maxY = -1;
+        long long count = 0, sumX = 0, sumY = 0;
+        std::deque<size_t> queue(1, start);
+        isVisited[start] = true;
+        while (!queue.empty()) {
+            size_t pos = queue.front();
+            queue.pop_front();
+            int x = (int)(pos % scene.width), y = (int)(pos / scene.width);
+            minX = std::min(minX, x); maxX = std::max(maxX, x);
+            minY = std::min(minY, y); maxY = std::max(maxY, y);
+            count += 1; sumX += x; sumY += y;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int nx = x + dx, ny = y + dy;
+                    if (nx < 0 || nx >= scene.width || ny < 0 || ny >= scene.height) {
+                        continue;
+                    }
+                    size_t next = (size_t)ny * scene.width + nx;
+                    if (mask[next].theColor != kPoison && !isVisited[next]) {
+                        isVisited[next] = true;
+                        queue.push_back(next);
+                    }
+                }
+            }
+        }
+        JST_PIXEL_MATCH_REGION region;
+        region.x = minX;
+        region.y = minY;
+        region.width = maxX - minX + 1;
+        region.height = maxY - minY + 1;
+        region.pixelCount = count;
+        region.centroidX = (double)sumX / (double)count;
+        region.centroidY = (double)sumY / (double)count;
+        regions.push_back(region);
+    }
+    std::sort(regions.begin(), regions.end(), [](const JST_PIXEL_MATCH_REGION &a, const JST_PIXEL_MATCH_REGION &b) {
+        if (a.y != b.y) return a.y < b.y;
+        if (a.x != b.x) return a.x < b.x;
+        if (a.height != b.height) return a.height < b.height;
+        if (a.width != b.width) return a.width < b.width;
+        if (a.pixelCount != b.pixelCount) return a.pixelCount < b.pixelCount;
+        if (a.centroidY != b.centroidY) return a.centroidY < b.centroidY;
+        return a.centroidX < b.centroidX;
+    });
+    return regions;
+}
+
+static void JSTExpectAllKernelsMatchReference(const JSTPixelMatchScene &scene, const JST_PIXEL_MATCH_OPTIONS &options) {
+    for (JST_PIXEL_MATCH_KERNEL kernel : kAllKernels) {
+        if (!JSTPixelMatchKernelIsSupported(kernel)) {
+            continue;
+        }
+        JSTExpectMatchesReference(scene, options, kernel, 0, 1);
+        JSTExpectMatchesReference(scene, options, kernel, 3, 1);
+        JSTExpectMatchesReference(scene, options, kernel, 0, 3);
+    }
+}
+
+
+/* MARK: - Tests */
+
+JST_TEST(testAutomaticKernelIsSupported) {
+    JST_EXPECT(JSTPixelMatchKernelIsSupported(JST_PIXEL_MATCH_KERNEL_AUTOMATIC));
+    JST_EXPECT(JSTPixelMatchKernelIsSupported(JST_PIXEL_MATCH_KERNEL_SCALAR));
+    printf("automatic kernel: %s\n", JSTPixelMatchKernelGetName(JST_PIXEL_MATCH_KERNEL_AUTOMATIC));
+}
+
+JST_TEST(testDefaultOptionsMatchSwift) {
+    JST_PIXEL_MATCH_OPTIONS options;
+    JSTPixelMatchOptionsInit(&options);
+    JST_EXPECT(options.threshold == 0.1);
+    JST_EXPECT(!options.includeAA);
+    JST_EXPECT(options.alpha == 0.5);
+    JST_EXPECT(options.aaColor[0] == 255 && options.aaColor[1] == 255 && options.aaColor[2] == 0);
+    JST_EXPECT(options.diffColor[0] == 255 && options.diffColor[1] == 0 && options.diffColor[2] == 0);
+    JST_EXPECT(!options.diffMask);
+    JST_EXPECT(options.diffBudget < 0);
+}
+
+JST_TEST(testSingleChangedPixel) {
+    /* white 5x5, the center turns black in the second image */
+    JSTPixelMatchScene scene = JSTMakeScene("single", 5, 5);
+    for (size_t i = 0; i < scene.pixels1.size(); ++i) {
+        scene.pixels1[i].theColor = 0xffffffffu;
+        scene.pixels2[i].theColor = 0xffffffffu;
+    }
+    scene.pixels2[12].theColor = 0xff000000u;
+
+    JST_PIXEL_MATCH_OPTIONS options;
+    JSTPixelMatchOptionsInit(&options);
+    JST_IMAGE *image1 = JSTCreatePaddedPixelImage(scene.pixels1, 5, 5, 0, 0);
+    JST_IMAGE *image2 = JSTCreatePaddedPixelImage(scene.pixels2, 5, 5, 0, 0);
+    JST_IMAGE *output = JSTCreatePaddedPixelImage(std::vector<JST_COLOR>(), 5, 5, 0, kPoison);
+    for (JST_PIXEL_MATCH_KERNEL kernel : kAllKernels) {
+        if (!JSTPixelMatchKernelIsSupported(kernel)) {
+            continue;
+        }
+        JST_EXPECT_EQ(JSTPixelMatchPixelImages(image1, image2, output, 0, 5, &options, kernel), 1);
+        JST_EXPECT_EQ(output->pixels[12].theColor, 0xff0000ffu);
+        /* white blended halfway with white stays white */
+        JST_EXPECT_EQ(output->pixels[0].theColor, 0xffffffffu);
+    }
+    JSTFreePixelImage(image1);
+    JSTFreePixelImage(image2);
+    JSTFreePixelImage(output);
+}
+
+JST_TEST(testScenesMatchReference) {
+    const int sizes[][2] = { { 1, 1 }, { 3, 2 }, { 7, 5 }, { 8, 8 }, { 17, 9 }, { 64, 33 }, { 131, 47 } };
+    const double thresholds[] = { 0.0, 0.05, 0.1, 0.5, 1.0 };
+    for (const auto &size : sizes) {
+        std::vector<JSTPixelMatchScene> scenes;
+        scenes.push_back(JSTMakeNoiseScene(size[0], size[1], (uint32_t)(size[0] * 131 + size[1])));
+        scenes.push_back(JSTMakeGradientScene(size[0], size[1]));
+        scenes.push_back(JSTMakeAntialiasedScene(size[0], size[1]));
+        scenes.push_back(JSTMakeAlphaScene(size[0], size[1], (uint32_t)(size[0] * 7 + size[1] * 3 + 1)));
+        scenes.push_back(JSTMakeIdenticalScene(size[0], size[1], (uint32_t)(size[1] + 5)));
+        for (const JSTPixelMatchScene &scene : scenes) {
+            for (double threshold : thresholds) {
+                JST_PIXEL_MATCH_OPTIONS options;
+                JSTPixelMatchOptionsInit(&options);
+                options.threshold = threshold;
+                JSTExpectAllKernelsMatchReference(scene, options);
+
+                options.includeAA = true;
+                options.alpha = 0.1;
+                JSTExpectAllKernelsMatchReference(scene, options);
+
+                options.includeAA = false;
+                options.diffMask = true;
+                options.alpha = 1.0;
+                options.aaColor[2] = 128;
+                options.diffColor[1] = 64;
+                JSTExpectAllKernelsMatchReference(scene, options);
+            }
+        }
+    }
+}
+
+JST_TEST(testNearThresholdDeltasMatchReference) {
+    const double thresholds[] = { 0.01, 0.05, 0.1, 0.2, 0.3 };
+    for (double threshold : thresholds) {
+        int nearCount = 0;
+        JSTPixelMatchScene scene = JSTMakeNearThresholdScene(97, 61, threshold, (uint32_t)(threshold * 1000) + 1, &nearCount);
+        JST_EXPECT(nearCount > 100);
+
+        JST_PIXEL_MATCH_OPTIONS options;
+        JSTPixelMatchOptionsInit(&options);
+        options.threshold = threshold;
+        JSTExpectAllKernelsMatchReference(scene, options);
+        options.includeAA = true;
+        JSTExpectAllKernelsMatchReference(scene, options);
+    }
+}
+
+JST_TEST(testJobsCoverEveryRowOfAnyHeight) {
+    /* prime heights used to lose their trailing rows */
+    const int sizes[][2] = { { 1, 1 }, { 5, 97 }, { 33, 61 }, { 131, 127 }, { 64, 256 } };
+    const int tileRows[] = { 0, 1, 7, 64, 1000 };
+    const int threadCounts[] = { 1, 2, 5, 32 };
+    for (const auto &size : sizes) {
+        JSTPixelMatchScene scene = JSTMakeNoiseScene(size[0], size[1], (uint32_t)(size[0] + size[1] * 17));
+        JST_PIXEL_MATCH_OPTIONS options;
+        JSTPixelMatchOptionsInit(&options);
+
+        std::vector<JST_COLOR> expected((size_t)scene.width * scene.height);
+        for (JST_COLOR &color : expected) {
+            color.theColor = kPoison;
+        }
+        long long expectedDiff = Reference::pixelMatch(scene.pixels1, scene.pixels2, expected, scene.width, scene.height, options);
+
+        JST_IMAGE *image1 = JSTCreatePaddedPixelImage(scene.pixels1, scene.width, scene.height, 2, 0);
+        JST_IMAGE *image2 = JSTCreatePaddedPixelImage(scene.pixels2, scene.width, scene.height, 0, 0);
+        for (int rows : tileRows) {
+            for (int threadCount : threadCounts) {
+                JST_IMAGE *output = JSTCreatePaddedPixelImage(std::vector<JST_COLOR>(), scene.width, scene.height, 0, kPoison);
+                JST_PIXEL_MATCH_JOB *job = JSTPixelMatchJobCreate(image1, image2, output, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, rows);
+                JST_ASSERT(job);
+                JST_EXPECT(JSTPixelMatchJobGetTileCount(job) >= 1);
+                JSTPixelMatchJobPerformConcurrently(job, threadCount);
+                JST_EXPECT_EQ(JSTPixelMatchJobGetDiffCount(job), expectedDiff);
+
+                int mismatches = 0;
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    mismatches += output->pixels[i].theColor != expected[i].theColor;
+                }
+                JST_EXPECT_EQ(mismatches, 0);
+
+                /* performing a finished job does nothing */
+                JSTPixelMatchJobPerform(job);
+                JST_EXPECT_EQ(JSTPixelMatchJobGetDiffCount(job), expectedDiff);
+                JSTPixelMatchJobFree(job);
+                JSTFreePixelImage(output);
+            }
+        }
+        JSTFreePixelImage(image1);
+        JSTFreePixelImage(image2);
+    }
+}
+
+JST_TEST(testCountOnlyMatchesDrawnCount) {
+    JSTPixelMatchScene scene = JSTMakeAntialiasedScene(131, 47);
+    JST_IMAGE *image1 = JSTCreatePaddedPixelImage(scene.pixels1, scene.width, scene.height, 0, 0);
+    JST_IMAGE *image2 = JSTCreatePaddedPixelImage(scene.pixels2, scene.width, scene.height, 0, 0);
+    JST_IMAGE *output = JSTCreatePixelImage(scene.width, scene.height);
+    const double thresholds[] = { 0.0, 0.1 };
+    for (double threshold : thresholds) {
+        JST_PIXEL_MATCH_OPTIONS options;
+        JSTPixelMatchOptionsInit(&options);
+        options.threshold = threshold;
+        for (JST_PIXEL_MATCH_KERNEL kernel : kAllKernels) {
+            if (!JSTPixelMatchKernelIsSupported(kernel)) {
+                continue;
+            }
+            long long drawn = JSTPixelMatchPixelImages(image1, image2, output, 0, scene.height, &options, kernel);
+            JST_EXPECT(drawn > 0);
+            JST_EXPECT_EQ(JSTPixelMatchPixelImages(image1, image2, NULL, 0, scene.height, &options, kernel), drawn);
+
+            JST_PIXEL_MATCH_JOB *job = JSTPixelMatchJobCreate(image1, image2, NULL, &options, kernel, 5);
+            JST_ASSERT(job);
+            JSTPixelMatchJobPerformConcurrently(job, 3);
+            JST_EXPECT_EQ(JSTPixelMatchJobGetDiffCount(job), drawn);
+            JST_EXPECT(!JSTPixelMatchJobIsBudgetExceeded(job));
+            JSTPixelMatchJobFree(job);
+        }
+    }
+    JSTFreePixelImage(image1);
+    JSTFreePixelImage(image2);
+    JSTFreePixelImage(output);
+}
+
+JST_TEST(testJobsStopOnceBudgetIsExceeded) {
+    JSTPixelMatchScene scene = JSTMakeNoiseScene(64, 200, 99);
+    JST_IMAGE *image1 = JSTCreatePaddedPixelImage(scene.pixels1, scene.width, scene.height, 0, 0);
+    JST_IMAGE *image2 = JSTCreatePaddedPixelImage(scene.pixels2, scene.width, scene.height, 0, 0);
+    JST_PIXEL_MATCH_OPTIONS options;
+    JSTPixelMatchOptionsInit(&options);
+    options.threshold = 0.0;
+    options.includeAA = true;
+    long long total = JSTPixelMatchPixelImages(image1, image2, NULL, 0, scene.height, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC);
+    JST_EXPECT(total > 100);
+
+    const int threadCounts[] = { 1, 4 };
+    for (int threadCount : threadCounts) {
+        /* well below the total: stops early with a partial count above the budget */
+        options.diffBudget = 10;
+        JST_PIXEL_MATCH_JOB *job = JSTPixelMatchJobCreate(image1, image2, NULL, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, 8);
+        JSTPixelMatchJobPerformConcurrently(job, threadCount);
+        JST_EXPECT(JSTPixelMatchJobIsBudgetExceeded(job));
+        JST_EXPECT(JSTPixelMatchJobGetDiffCount(job) > 10);
+        JST_EXPECT(JSTPixelMatchJobGetDiffCount(job) < total);
+        JSTPixelMatchJobFree(job);
+
+        /* exactly the total is still within budget */
+        options.diffBudget = total;
+        job = JSTPixelMatchJobCreate(image1, image2, NULL, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, 8);
+        JSTPixelMatchJobPerformConcurrently(job, threadCount);
+        JST_EXPECT(!JSTPixelMatchJobIsBudgetExceeded(job));
+        JST_EXPECT_EQ(JSTPixelMatchJobGetDiffCount(job), total);
+        JSTPixelMatchJobFree(job);
+
+        options.diffBudget = total - 1;
+        job = JSTPixelMatchJobCreate(image1, image2, NULL, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, 8);
+        JSTPixelMatchJobPerformConcurrently(job, threadCount);
+        JST_EXPECT(JSTPixelMatchJobIsBudgetExceeded(job));
+        JSTPixelMatchJobFree(job);
+    }
+
+    /* a zero budget passes identical images */
+    options.diffBudget = 0;
+    JST_PIXEL_MATCH_JOB *job = JSTPixelMatchJobCreate(image1, image1, NULL, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, 0);
+    JSTPixelMatchJobPerform(job);
+    JST_EXPECT(!JSTPixelMatchJobIsBudgetExceeded(job));
+    JST_EXPECT_EQ(JSTPixelMatchJobGetDiffCount(job), 0);
+    JSTPixelMatchJobFree(job);
+
+    JSTFreePixelImage(image1);
+    JSTFreePixelImage(image2);
+}
+
+JST_TEST(testRegionsMatchFloodFill) {
+    JSTPixelMatchScene scenes[] = {
+        JSTMakeShapesScene(61, 53),
+        JSTMakeAntialiasedScene(97, 71),
+        JSTMakeNoiseScene(45, 38, 7),
+    };
+    const int tileRows[] = { 0, 1, 3, 7, 64 };
+    const int threadCounts[] = { 1, 3, 8 };
+    for (const JSTPixelMatchScene &scene : scenes) {
+        JST_PIXEL_MATCH_OPTIONS options;
+        JSTPixelMatchOptionsInit(&options);
+        std::vector<JST_PIXEL_MATCH_REGION> expected = JSTFindReferenceRegions(scene, options);
+        JST_EXPECT(!expected.empty());
+
+        JST_IMAGE *image1 = JSTCreatePaddedPixelImage(scene.pixels1, scene.width, scene.height, 3, 0);
+        JST_IMAGE *image2 = JSTCreatePaddedPixelImage(scene.pixels2, scene.width, scene.height, 0, 0);
+        for (int rows : tileRows) {
+            for (int threadCount : threadCounts) {
+                JST_PIXEL_MATCH_JOB *job = JSTPixelMatchJobCreate(image1, image2, NULL, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, rows);
+                JST_ASSERT(job);
+                JST_EXPECT(JSTPixelMatchJobSetCollectsRegions(job, true));
+                JSTPixelMatchJobPerformConcurrently(job, threadCount);
+
+                int regionCount = 0;
+                const JST_PIXEL_MATCH_REGION *regions = JSTPixelMatchJobGetRegions(job, &regionCount);
+                JST_EXPECT_EQ(regionCount, (int)expected.size());
+                int mismatches = 0;
+                for (int i = 0; regions && i < std::min(regionCount, (int)expected.size()); ++i) {
+                    const JST_PIXEL_MATCH_REGION &a = regions[i];
+                    const JST_PIXEL_MATCH_REGION &b = expected[i];
+                    mismatches += a.x != b.x || a.y != b.y || a.width != b.width || a.height != b.height ||
+                        a.pixelCount != b.pixelCount || a.centroidX != b.centroidX || a.centroidY != b.centroidY;
+                }
+                JST_EXPECT_EQ(mismatches, 0);
+
+                /* regions are resolved once */
+                JST_EXPECT(JSTPixelMatchJobGetRegions(job, &regionCount) == regions);
+                JSTPixelMatchJobFree(job);
+            }
+        }
+        JSTFreePixelImage(image1);
+        JSTFreePixelImage(image2);
+    }
+}
+
+JST_TEST(testRegionsFollowTheDiffBudget) {
+    JSTPixelMatchScene scene = JSTMakeShapesScene(40, 90);
+    JST_IMAGE *image1 = JSTCreatePaddedPixelImage(scene.pixels1, scene.width, scene.height, 0, 0);
+    JST_IMAGE *image2 = JSTCreatePaddedPixelImage(scene.pixels2, scene.width, scene.height, 0, 0);
+    JST_PIXEL_MATCH_OPTIONS options;
+    JSTPixelMatchOptionsInit(&options);
+    options.diffBudget = 50;
+
+    const int threadCounts[] = { 1, 4 };
+    for (int threadCount : threadCounts) {
+        JST_PIXEL_MATCH_JOB *job = JSTPixelMatchJobCreate(image1, image2, NULL, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, 6);
+        JST_ASSERT(job);
+        JST_EXPECT(JSTPixelMatchJobSetCollectsRegions(job, true));
+        JSTPixelMatchJobPerformConcurrently(job, threadCount);
+        JST_EXPECT(JSTPixelMatchJobIsBudgetExceeded(job));
+
+        /* regions cover exactly the rows that were counted */
+        int regionCount = 0;
+        const JST_PIXEL_MATCH_REGION *regions = JSTPixelMatchJobGetRegions(job, &regionCount);
+        JST_EXPECT(regions != NULL);
+        long long pixelCount = 0;
+        for (int i = 0; i < regionCount; ++i) {
+            pixelCount += regions[i].pixelCount;
+        }
+        JST_EXPECT_EQ(pixelCount, JSTPixelMatchJobGetDiffCount(job));
+
+        /* too late to collect, or to stop collecting */
+        JST_EXPECT(!JSTPixelMatchJobSetCollectsRegions(job, false));
+        JSTPixelMatchJobFree(job);
+    }
+
+    /* jobs which do not collect regions have none */
+    JST_PIXEL_MATCH_JOB *job = JSTPixelMatchJobCreate(image1, image2, NULL, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, 0);
+    JSTPixelMatchJobPerform(job);
+    int regionCount = -1;
+    JST_EXPECT(JSTPixelMatchJobGetRegions(job, &regionCount) == NULL);
+    JST_EXPECT_EQ(regionCount, 0);
+    JSTPixelMatchJobFree(job);
+
+    JSTFreePixelImage(image1);
+    JSTFreePixelImage(image2);
+}
+
+JST_TEST(testMismatchedSizesAndUnsupportedKernelsAreRejected) {
+    JST_IMAGE *image1 = JSTCreatePixelImage(8, 4);
+    JST_IMAGE *image2 = JSTCreatePixelImage(8, 5);
+    JST_IMAGE *output = JSTCreatePixelImage(8, 4);
+    JST_EXPECT_EQ(JSTPixelMatchPixelImages(image1, image2, output, 0, 4, NULL, JST_PIXEL_MATCH_KERNEL_SCALAR), -1);
+    JST_EXPECT_EQ(JSTPixelMatchPixelImages(image1, output, image2, 0, 4, NULL, JST_PIXEL_MATCH_KERNEL_SCALAR), -1);
+    JST_EXPECT_EQ(JSTPixelMatchPixelImages(image1, image1, output, 0, 4, NULL, JST_PIXEL_MATCH_KERNEL_SCALAR), 0);
+    JST_EXPECT(!JSTPixelMatchJobCreate(image1, image2, output, NULL, JST_PIXEL_MATCH_KERNEL_SCALAR, 0));
+    for (JST_PIXEL_MATCH_KERNEL kernel : kAllKernels) {
+        if (!JSTPixelMatchKernelIsSupported(kernel)) {
+            JST_EXPECT_EQ(JSTPixelMatchPixelImages(image1, image1, output, 0, 4, NULL, kernel), -1);
+        }
+    }
+    JSTFreePixelImage(image1);
+    JSTFreePixelImage(image2);
+    JSTFreePixelImage(output);
+}
+
+JST_TEST(testRotatedImagesAreComparedAsOriented) {
+    JSTPixelMatchScene scene = JSTMakeShapesScene(61, 37);
+    JST_PIXEL_MATCH_OPTIONS options;
+    JSTPixelMatchOptionsInit(&options);
+    std::vector<JST_COLOR> expected((size_t)scene.width * scene.height);
+    long long expectedDiff = Reference::pixelMatch(scene.pixels1, scene.pixels2, expected, scene.width, scene.height, options);
+    std::vector<JST_PIXEL_MATCH_REGION> expectedRegions = JSTFindReferenceRegions(scene, options);
+    JST_EXPECT(!expectedRegions.empty());
+
+    JST_IMAGE *upright2 = JSTCreatePaddedPixelImage(scene.pixels2, scene.width, scene.height, 0, 0);
+    for (uint8_t orientation = 1; orientation < 4; ++orientation) {
+        JST_IMAGE *image1 = JSTCreateRotatedPixelImage(scene.pixels1, scene.width, scene.height, orientation, 3);
+        JST_IMAGE *image2 = JSTCreateRotatedPixelImage(scene.pixels2, scene.width, scene.height, orientation, 0);
+        JST_IMAGE *output = JSTCreatePaddedPixelImage(std::vector<JST_COLOR>(), scene.width, scene.height, 2, kPoison);
+
+        /* a rotated image against an upright one, and two rotated images */
+        JST_IMAGE *pairs[][2] = { { image1, upright2 }, { image1, image2 } };
+        for (auto &pair : pairs) {
+            JST_PIXEL_MATCH_JOB *job = JSTPixelMatchJobCreate(pair[0], pair[1], output, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, 5);
+            JST_ASSERT(job);
+            JST_EXPECT(JSTPixelMatchJobSetCollectsRegions(job, true));
+            JSTPixelMatchJobPerformConcurrently(job, 3);
+            JST_EXPECT_EQ(JSTPixelMatchJobGetDiffCount(job), expectedDiff);
+
+            int mismatches = 0;
+            for (int y = 0; y < scene.height; ++y) {
+                for (int x = 0; x < scene.width; ++x) {
+                    mismatches += output->pixels[(size_t)y * output->alignedWidth + x].theColor != expected[(size_t)y * scene.width + x].theColor;
+                }
+            }
+            JST_EXPECT_EQ(mismatches, 0);
+
+            int regionCount = 0;
+            const JST_PIXEL_MATCH_REGION *regions = JSTPixelMatchJobGetRegions(job, &regionCount);
+            JST_EXPECT_EQ(regionCount, (int)expectedRegions.size());
+            mismatches = 0;
+            for (int i = 0; regions && i < std::min(regionCount, (int)expectedRegions.size()); ++i) {
+                const JST_PIXEL_MATCH_REGION &a = regions[i];
+                const JST_PIXEL_MATCH_REGION &b = expectedRegions[i];
+                mismatches += a.x != b.x || a.y != b.y || a.width != b.width || a.height != b.height ||
+                    a.pixelCount != b.pixelCount || a.centroidX != b.centroidX || a.centroidY != b.centroidY;
+            }
+            JST_EXPECT_EQ(mismatches, 0);
+            JSTPixelMatchJobFree(job);
+        }
+
+        /* the output has the oriented size and no orientation of its own */
+        if (orientation != 3) {
+            JST_IMAGE *storedOutput = JSTCreatePixelImage(scene.height, scene.width);
+            JST_EXPECT(!JSTPixelMatchJobCreate(image1, image2, storedOutput, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, 0));
+            JSTFreePixelImage(storedOutput);
+        }
+        output->orientation = orientation;
+        JST_EXPECT(!JSTPixelMatchJobCreate(image1, image2, output, &options, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, 0));
+
+        JSTFreePixelImage(image1);
+        JSTFreePixelImage(image2);
+        JSTFreePixelImage(output);
+    }
+    JSTFreePixelImage(upright2);
+}
+
+JST_TEST_MAIN()
@@ -0,0 +1,286 @@
+#include "JSTTest.h"
+#include "JSTPixelRing.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+/* Frames of one color, so that a torn frame shows. */
+static std::vector<JST_COLOR> JSTMakeUniformFrame(int width, int height, uint32_t color) {
+    std::vector<JST_COLOR> pixels((size_t)width * height);
+    for (JST_COLOR &pixel : pixels) {
+        pixel.theColor = color;
+    }
+    return pixels;
+}
+
+static bool JSTIsUniformImage(const JST_IMAGE *image, uint32_t color) {
+    for (int y = 0; y < image->height; ++y) {
+        for (int x = 0; x < image->width; ++x) {
+            if (image->pixels[(size_t)y * image->alignedWidth + x].theColor != color) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static JST_PIXEL_RING_STATUS JSTPushUniformFrame(JST_PIXEL_RING *ring, uint32_t color, uint64_t timestamp) {
+    int width, height;
+    JSTPixelRingGetSize(ring, &width, &height);
+    std::vector<JST_COLOR> pixels = JSTMakeUniformFrame(width, height, color);
+    return JSTPixelRingPush(ring, pixels.data(), width, height, (size_t)width * sizeof(JST_COLOR), 0, timestamp);
+}
+
+static std::vector<uint64_t> JSTGetSequences(JST_PIXEL_RING *ring) {
+    std::vector<JST_PIXEL_RING_FRAME_INFO> infos((size_t)JSTPixelRingGetCapacity(ring));
+    int count = JSTPixelRingGetFrames(ring, infos.data(), (int)infos.size());
+    std::vector<uint64_t> sequences;
+    for (int i = 0; i < count; ++i) {
+        sequences.push_back(infos[(size_t)i].sequence);
+    }
+    return sequences;
+}
+
+
+JST_TEST(RejectsInvalidRings) {
+    JST_EXPECT(JSTPixelRingCreate(0, 4, 4) == NULL);
+    JST_EXPECT(JSTPixelRingCreate(2, 0, 4) == NULL);
+    JST_EXPECT(JSTPixelRingCreate(2, 4, -1) == NULL);
+    JSTPixelRingFree(NULL);
+
+    JST_PIXEL_RING *ring = JSTPixelRingCreate(3, 5, 4);
+    JST_ASSERT(ring);
+    JST_EXPECT_EQ(JSTPixelRingGetCapacity(ring), 3);
+    JST_EXPECT(JSTPixelRingCopyFrame(ring, 1, NULL) == NULL);
+    uint64_t sequence;
+    JST_EXPECT(!JSTPixelRingFindFrame(ring, 100, &sequence));
+    JSTPixelRingFree(ring);
+}
+
+JST_TEST(PushesAndCopiesFrames) {
+    JST_PIXEL_RING *ring = JSTPixelRingCreate(4, 5, 3);
+    JST_ASSERT(ring);
+
+    /* padded source rows, as CoreGraphics hands them out */
+    std::vector<JST_COLOR> pixels((size_t)8 * 3);
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            pixels[(size_t)y * 8 + x].theColor = x < 5 ? (uint32_t)((y << 16) | x) : 0xDEADBEEFu;
+        }
+    }
+    JST_EXPECT_EQ(JSTPixelRingPush(ring, pixels.data(), 5, 3, 8 * sizeof(JST_COLOR), 2, 1000), JST_PIXEL_RING_STATUS_PUSHED);
+    JST_EXPECT_EQ(JSTPushUniformFrame(ring, 0xFF0000FFu, 2000), JST_PIXEL_RING_STATUS_PUSHED);
+
+    std::vector<uint64_t> sequences = JSTGetSequences(ring);
+    JST_ASSERT(sequences.size() == 2);
+    JST_EXPECT_EQ(sequences[0], 1u);
+    JST_EXPECT_EQ(sequences[1], 2u);
+
+    JST_PIXEL_RING_FRAME_INFO info;
+    JST_IMAGE *image = JSTPixelRingCopyFrame(ring, 1, &info);
+    JST_ASSERT(image);
+    JST_EXPECT_EQ(info.sequence, 1u);
+    JST_EXPECT_EQ(info.timestamp, 1000u);
+    JST_EXPECT_EQ(image->width, 5);
+    JST_EXPECT_EQ(image->height, 3);
+    JST_EXPECT_EQ(image->orientation, 2);
+    int mismatches = 0;
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 5; ++x) {
+            if (image->pixels[(size_t)y * image->alignedWidth + x].theColor != (uint32_t)((y << 16) | x)) {
+                ++mismatches;
+            }
+        }
+    }
+    JST_EXPECT_EQ(mismatches, 0);
+    JSTFreePixelImage(image);
+
+    /* frames of another size need another ring */
+    std::vector<JST_COLOR> small = JSTMakeUniformFrame(4, 3, 0);
+    JST_EXPECT_EQ(JSTPixelRingPush(ring, small.data(), 4, 3, 4 * sizeof(JST_COLOR), 0, 3000), JST_PIXEL_RING_STATUS_SIZE_MISMATCH);
+    JST_EXPECT_EQ(JSTPixelRingPush(ring, small.data(), 5, 3, 4 * sizeof(JST_COLOR), 0, 3000), JST_PIXEL_RING_STATUS_SIZE_MISMATCH);
+    JSTPixelRingFree(ring);
+}
+
+JST_TEST(OverwritesOldestFrames) {
+    JST_PIXEL_RING *ring = JSTPixelRingCreate(3, 4, 4);
+    JST_ASSERT(ring);
+    for (uint32_t i = 1; i <= 5; ++i) {
+        JST_EXPECT_EQ(JSTPushUniformFrame(ring, i, i * 10), JST_PIXEL_RING_STATUS_PUSHED);
+    }
+    std::vector<uint64_t> sequences = JSTGetSequences(ring);
+    JST_ASSERT(sequences.size() == 3);
+    JST_EXPECT_EQ(sequences[0], 3u);
+    JST_EXPECT_EQ(sequences[2], 5u);
+    JST_EXPECT(JSTPixelRingCopyFrame(ring, 2, NULL) == NULL);
+
+    JST_IMAGE *image = JSTPixelRingCopyFrame(ring, 4, NULL);
+    JST_ASSERT(image);
+    JST_EXPECT(JSTIsUniformImage(image, 4));
+    JSTFreePixelImage(image);
+
+    JST_PIXEL_RING_STATISTICS statistics;
+    JSTPixelRingGetStatistics(ring, &statistics);
+    JST_EXPECT_EQ(statistics.pushedCount, 5u);
+    JST_EXPECT_EQ(statistics.droppedCount, 0u);
+    JST_EXPECT_EQ(statistics.frameCount, 3);
+    JSTPixelRingFree(ring);
+}
+
+JST_TEST(KeepsFramesWhileTheyAreRead) {
+    JST_PIXEL_RING *ring = JSTPixelRingCreate(3, 4, 4);
+    JST_ASSERT(ring);
+    for (uint32_t i = 1; i <= 3; ++i) {
+        JSTPushUniformFrame(ring, i, i * 10);
+    }
+
+    /* the oldest frame is being scrubbed, the next ones take its turn */
+    JST_IMAGE *held = JSTPixelRingCopyFrame(ring, 1, NULL);
+    JST_ASSERT(held);
+    JSTPushUniformFrame(ring, 4, 40);
+    JSTPushUniformFrame(ring, 5, 50);
+    std::vector<uint64_t> sequences = JSTGetSequences(ring);
+    JST_ASSERT(sequences.size() == 3);
+    JST_EXPECT_EQ(sequences[0], 1u);
+    JST_EXPECT_EQ(sequences[1], 4u);
+    JST_EXPECT_EQ(sequences[2], 5u);
+    JST_EXPECT(JSTIsUniformImage(held, 1));
+
+    JST_PIXEL_RING_STATISTICS statistics;
+    JSTPixelRingGetStatistics(ring, &statistics);
+    JST_EXPECT_EQ(statistics.sharedCount, 1);
+
+    /* released, it is the oldest again */
+    JSTFreePixelImage(held);
+    JSTPushUniformFrame(ring, 6, 60);
+    sequences = JSTGetSequences(ring);
+    JST_EXPECT_EQ(sequences[0], 4u);
+    JSTPixelRingFree(ring);
+}
+
+JST_TEST(DropsFramesUnderBackpressure) {
+    JST_PIXEL_RING *ring = JSTPixelRingCreate(2, 4, 4);
+    JST_ASSERT(ring);
+    JSTPushUniformFrame(ring, 1, 10);
+    JSTPushUniformFrame(ring, 2, 20);
+    JST_IMAGE *first = JSTPixelRingCopyFrame(ring, 1, NULL);
+    JST_IMAGE *second = JSTPixelRingCopyFrame(ring, 2, NULL);
+    JST_ASSERT(first && second);
+
+    JST_EXPECT_EQ(JSTPushUniformFrame(ring, 3, 30), JST_PIXEL_RING_STATUS_DROPPED);
+    JST_EXPECT_EQ(JSTPushUniformFrame(ring, 4, 40), JST_PIXEL_RING_STATUS_DROPPED);
+    JST_PIXEL_RING_STATISTICS statistics;
+    JSTPixelRingGetStatistics(ring, &statistics);
+    JST_EXPECT_EQ(statistics.droppedCount, 2u);
+    JST_EXPECT_EQ(statistics.sharedCount, 2);
+
+    JSTFreePixelImage(second);
+    JST_EXPECT_EQ(JSTPushUniformFrame(ring, 5, 50), JST_PIXEL_RING_STATUS_PUSHED);
+    JST_EXPECT(JSTIsUniformImage(first, 1));
+    JSTFreePixelImage(first);
+    JSTPixelRingFree(ring);
+}
+
+JST_TEST(CopiesFramesBeforeWrites) {
+    JST_PIXEL_RING *ring = JSTPixelRingCreate(2, 4, 4);
+    JST_ASSERT(ring);
+    JSTPushUniformFrame(ring, 7, 10);
+    JST_IMAGE *image = JSTPixelRingCopyFrame(ring, 1, NULL);
+    JST_ASSERT(image);
+    JST_COLOR color;
+    color.theColor = 9;
+    JSTSetColorInPixelImageSafe(image, 0, 0, &color);
+    JSTFreePixelImage(image);
+
+    image = JSTPixelRingCopyFrame(ring, 1, NULL);
+    JST_ASSERT(image);
+    JST_EXPECT(JSTIsUniformImage(image, 7));
+    JSTFreePixelImage(image);
+    JSTPixelRingFree(ring);
+}
+
+JST_TEST(OutlivesTheRing) {
+    JST_PIXEL_RING *ring = JSTPixelRingCreate(2, 4, 4);
+    JST_ASSERT(ring);
+    JSTPushUniformFrame(ring, 3, 10);
+    JST_IMAGE *image = JSTPixelRingCopyFrame(ring, 1, NULL);
+    JSTPixelRingFree(ring);
+    JST_ASSERT(image);
+    JST_EXPECT(JSTIsUniformImage(image, 3));
+    JSTFreePixelImage(image);
+}
+
+JST_TEST(FindsFramesByTimestamp) {
+    JST_PIXEL_RING *ring = JSTPixelRingCreate(4, 2, 2);
+    JST_ASSERT(ring);
+    for (uint32_t i = 1; i <= 6; ++i) {
+        JSTPushUniformFrame(ring, i, i * 100);
+    }
+    uint64_t sequence = 0;
+    JST_ASSERT(JSTPixelRingFindFrame(ring, 450, &sequence));
+    JST_EXPECT_EQ(sequence, 4u);
+    JST_ASSERT(JSTPixelRingFindFrame(ring, 500, &sequence));
+    JST_EXPECT_EQ(sequence, 5u);
+    JST_ASSERT(JSTPixelRingFindFrame(ring, 10000, &sequence));
+    JST_EXPECT_EQ(sequence, 6u);
+
+    /* frames older than the ring fall back to the oldest one */
+    JST_ASSERT(JSTPixelRingFindFrame(ring, 50, &sequence));
+    JST_EXPECT_EQ(sequence, 3u);
+    JSTPixelRingFree(ring);
+}
+
+JST_TEST(NeverHandsOutTornFrames) {
+    JST_PIXEL_RING *ring = JSTPixelRingCreate(4, 64, 48);
+    JST_ASSERT(ring);
+    std::atomic<bool> isDone(false);
+    std::atomic<int> tornCount(0);
+    std::atomic<int> readCount(0);
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back([&] {
+            JST_PIXEL_RING_FRAME_INFO infos[4];
+            while (!isDone.load()) {
+                int count = JSTPixelRingGetFrames(ring, infos, 4);
+                if (count == 0) {
+                    continue;
+                }
+                JST_PIXEL_RING_FRAME_INFO info;
+                JST_IMAGE *image = JSTPixelRingCopyFrame(ring, infos[std::min(count, 4) - 1].sequence, &info);
+                if (!image) {
+                    continue;  /* overwritten in between */
+                }
+                if (!JSTIsUniformImage(image, (uint32_t)info.timestamp)) {
+                    tornCount.fetch_add(1);
+                }
+                readCount.fetch_add(1);
+                JSTFreePixelImage(image);
+            }
+        });
+    }
+
+    int pushedCount = 0, droppedCount = 0;
+    for (uint32_t i = 1; i <= 2000; ++i) {
+        JST_PIXEL_RING_STATUS status = JSTPushUniformFrame(ring, i, i);
+        pushedCount += status == JST_PIXEL_RING_STATUS_PUSHED;
+        droppedCount += status == JST_PIXEL_RING_STATUS_DROPPED;
+    }
+    isDone.store(true);
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+
+    JST_EXPECT_EQ(tornCount.load(), 0);
+    JST_EXPECT_EQ(pushedCount + droppedCount, 2000);
+    JST_PIXEL_RING_STATISTICS statistics;
+    JSTPixelRingGetStatistics(ring, &statistics);
+    JST_EXPECT_EQ(statistics.pushedCount, (uint64_t)pushedCount);
+    JST_EXPECT_EQ(statistics.droppedCount, (uint64_t)droppedCount);
+    JST_EXPECT_EQ(statistics.sharedCount, 0);
+    JSTPixelRingFree(ring);
+}
+
+JST_TEST_MAIN()
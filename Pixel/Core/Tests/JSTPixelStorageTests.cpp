@@ -0,0 +1,285 @@
+#include "JSTTest.h"
+#include "JSTPixelStorage.h"
+
+#include <cstring>
+#include <vector>
+
+
+static JST_IMAGE *JSTCreateIndexedPixelImage(int width, int height, int alignedWidth) {
+    JST_COLOR *pixels = (JST_COLOR *)calloc((size_t)alignedWidth * height, sizeof(JST_COLOR));
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < alignedWidth; ++x) {
+            pixels[(size_t)y * alignedWidth + x].theColor = x < width ? (uint32_t)((y << 16) | x) : 0xDEADBEEFu;
+        }
+    }
+    return JSTCreatePixelImageWithPixels(pixels, width, alignedWidth, height, true);
+}
+
+static uint32_t JSTIndexedColorAt(int x, int y) {
+    return (uint32_t)((y << 16) | x);
+}
+
+static int deallocatorCalls = 0;
+
+static void JSTCountingDeallocator(void *bytes, size_t length, void *context) {
+    (void)length;
+    JST_EXPECT(context == &deallocatorCalls);
+    free(bytes);
+    ++deallocatorCalls;
+}
+
+JST_TEST(testStorageIsReleasedWithLastReference) {
+    deallocatorCalls = 0;
+    JST_PIXEL_STORAGE *storage = JSTPixelStorageCreate(malloc(64), 64, JSTCountingDeallocator, &deallocatorCalls);
+    JST_ASSERT(storage != NULL);
+    JST_EXPECT(JSTPixelStorageIsUnique(storage));
+    JST_EXPECT_EQ(JSTPixelStorageGetLength(storage), (size_t)64);
+
+    JSTPixelStorageRetain(storage);
+    JST_EXPECT(!JSTPixelStorageIsUnique(storage));
+    JSTPixelStorageRelease(storage);
+    JST_EXPECT(JSTPixelStorageIsUnique(storage));
+    JST_EXPECT_EQ(deallocatorCalls, 0);
+    JSTPixelStorageRelease(storage);
+    JST_EXPECT_EQ(deallocatorCalls, 1);
+
+    JST_EXPECT(JSTPixelStorageCreate(NULL, 0, NULL, NULL) == NULL);
+}
+
+JST_TEST(testViewSharesParentPixels) {
+    JST_IMAGE *parent = JSTCreateIndexedPixelImage(10, 8, 12);
+    JST_IMAGE *view = JSTCreatePixelImageViewWithPixelImageInRect(parent, 0, 2, 3, 7, 6);
+    JST_ASSERT(view != NULL);
+    JST_EXPECT(parent->storage != NULL);
+    JST_EXPECT(view->storage == parent->storage);
+    JST_EXPECT_EQ(view->width, 5);
+    JST_EXPECT_EQ(view->height, 3);
+    JST_EXPECT_EQ(view->alignedWidth, 12);
+    JST_EXPECT(view->pixels == parent->pixels + 3 * 12 + 2);
+    JST_EXPECT(!JSTPixelImageIsPacked(view));
+    JST_EXPECT(JSTPixelImageIsShared(view));
+
+    JST_COLOR color;
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 5; ++x) {
+            JSTGetColorInPixelImageSafe(view, x, y, &color);
+            JST_EXPECT_EQ(color.theColor, JSTIndexedColorAt(x + 2, y + 3));
+        }
+    }
+    JSTFreePixelImage(view);
+    JSTFreePixelImage(parent);
+}
+
+JST_TEST(testViewOutlivesParent) {
+    JST_IMAGE *parent = JSTCreateIndexedPixelImage(6, 6, 6);
+    JST_IMAGE *view = JSTCreatePixelImageViewWithPixelImageInRect(parent, 0, 1, 1, 4, 4);
+    JST_ASSERT(view != NULL);
+    JSTFreePixelImage(parent);
+    JST_EXPECT(!JSTPixelImageIsShared(view));
+
+    JST_COLOR color;
+    JSTGetColorInPixelImageSafe(view, 2, 2, &color);
+    JST_EXPECT_EQ(color.theColor, JSTIndexedColorAt(3, 3));
+    JSTFreePixelImage(view);
+}
+
+JST_TEST(testViewOfViewAndOrientation) {
+    JST_IMAGE *parent = JSTCreateIndexedPixelImage(9, 7, 9);
+    parent->orientation = 1;
+    JST_IMAGE *view = JSTCreatePixelImageViewByCroppingPixelImage(parent, 1, 2, 4, 5);
+    JST_IMAGE *copy = JSTCreatePixelImageByCroppingPixelImage(parent, 1, 2, 4, 5);
+    JST_ASSERT(view != NULL && copy != NULL);
+    JST_EXPECT_EQ(view->orientation, copy->orientation);
+    JST_EXPECT_EQ(view->width, copy->width);
+    JST_EXPECT_EQ(view->height, copy->height);
+
+    JST_IMAGE *nestedView = JSTCreatePixelImageViewByCroppingPixelImage(view, 1, 1, 2, 3);
+    JST_IMAGE *nestedCopy = JSTCreatePixelImageByCroppingPixelImage(copy, 1, 1, 2, 3);
+    JST_ASSERT(nestedView != NULL && nestedCopy != NULL);
+    JST_EXPECT(nestedView->storage == parent->storage);
+
+    JST_COLOR viewColor, copyColor;
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 2; ++x) {
+            JSTGetColorInPixelImageSafe(nestedView, x, y, &viewColor);
+            JSTGetColorInPixelImageSafe(nestedCopy, x, y, &copyColor);
+            JST_EXPECT_EQ(viewColor.theColor, copyColor.theColor);
+        }
+    }
+    JSTFreePixelImage(nestedCopy);
+    JSTFreePixelImage(nestedView);
+    JSTFreePixelImage(copy);
+    JSTFreePixelImage(view);
+    JSTFreePixelImage(parent);
+}
+
+JST_TEST(testWriteMaterializesView) {
+    JST_IMAGE *parent = JSTCreateIndexedPixelImage(8, 8, 10);
+    JST_IMAGE *view = JSTCreatePixelImageViewWithPixelImageInRect(parent, 0, 2, 2, 6, 6);
+    JST_ASSERT(view != NULL);
+
+    JST_COLOR color;
+    color.theColor = 0xFF00FF00u;
+    JSTSetColorInPixelImageSafe(view, 1, 1, &color);
+    JST_EXPECT(view->storage == NULL);
+    JST_EXPECT(JSTPixelImageIsPacked(view));
+    JST_EXPECT(JSTPixelStorageIsUnique(parent->storage));
+
+    JSTGetColorInPixelImageSafe(view, 1, 1, &color);
+    JST_EXPECT_EQ(color.theColor, 0xFF00FF00u);
+    JSTGetColorInPixelImageSafe(view, 0, 0, &color);
+    JST_EXPECT_EQ(color.theColor, JSTIndexedColorAt(2, 2));
+    JSTGetColorInPixelImageSafe(parent, 3, 3, &color);
+    JST_EXPECT_EQ(color.theColor, JSTIndexedColorAt(3, 3));
+
+    /* The parent is the only owner again and is written in place */
+    JST_COLOR *parentPixels = parent->pixels;
+    color.theColor = 0xFF0000FFu;
+    JSTSetColorInPixelImageSafe(parent, 0, 0, &color);
+    JST_EXPECT(parent->pixels == parentPixels);
+    JST_EXPECT_EQ(parent->pixels[0].theColor, 0xFF0000FFu);
+
+    JSTFreePixelImage(view);
+    JSTFreePixelImage(parent);
+}
+
+JST_TEST(testMakePackedMaterializesPaddedView) {
+    JST_IMAGE *parent = JSTCreateIndexedPixelImage(8, 6, 8);
+    JST_IMAGE *rows = JSTCreatePixelImageViewWithPixelImageInRect(parent, 0, 0, 2, 8, 5);
+    JST_IMAGE *columns = JSTCreatePixelImageViewWithPixelImageInRect(parent, 0, 3, 1, 7, 5);
+    JST_ASSERT(rows != NULL && columns != NULL);
+
+    /* Full width views are contiguous and stay shared */
+    JST_COLOR *rowsPixels = rows->pixels;
+    JST_EXPECT(JSTPixelImageMakePacked(rows));
+    JST_EXPECT(rows->pixels == rowsPixels);
+
+    JST_EXPECT(JSTPixelImageMakePacked(columns));
+    JST_EXPECT_EQ(columns->alignedWidth, 4);
+    JST_EXPECT(columns->storage == NULL);
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            JST_EXPECT_EQ(columns->pixels[y * 4 + x].theColor, JSTIndexedColorAt(x + 3, y + 1));
+        }
+    }
+    JSTFreePixelImage(columns);
+    JSTFreePixelImage(rows);
+    JSTFreePixelImage(parent);
+}
+
+JST_TEST(testCopyOfPaddedViewIsPacked) {
+    JST_IMAGE *parent = JSTCreateIndexedPixelImage(8, 6, 8);
+    JST_IMAGE *view = JSTCreatePixelImageViewWithPixelImageInRect(parent, 2, 5, 3, 8, 6);
+    JST_ASSERT(view != NULL);
+    JST_IMAGE *copy = JSTCopyPixelImage(view);
+    JST_ASSERT(copy != NULL);
+    JST_EXPECT(!JSTPixelImageIsShared(copy));
+    JST_EXPECT_EQ(copy->alignedWidth, 3);
+    JST_EXPECT_EQ(copy->orientation, 2);
+    JST_EXPECT_EQ(copy->pixels[2 * 3 + 2].theColor, JSTIndexedColorAt(7, 5));
+    JSTFreePixelImage(copy);
+    JSTFreePixelImage(view);
+    JSTFreePixelImage(parent);
+}
+
+JST_TEST(testBorrowedPixelsAreCopiedIntoView) {
+    std::vector<JST_COLOR> pixels(16);
+    for (int i = 0; i < 16; ++i) {
+        pixels[i].theColor = (uint32_t)i;
+    }
+    JST_IMAGE *parent = JSTCreatePixelImageWithPixels(pixels.data(), 4, 4, 4, false);
+    JST_IMAGE *view = JSTCreatePixelImageViewWithPixelImageInRect(parent, 0, 1, 1, 3, 3);
+    JST_ASSERT(view != NULL);
+    JST_EXPECT(parent->storage == NULL);
+    JST_EXPECT(!JSTPixelImageIsShared(view));
+    JST_EXPECT(view->pixels < pixels.data() || view->pixels >= pixels.data() + 16);
+    JST_EXPECT_EQ(view->pixels[0].theColor, 5u);
+    JSTFreePixelImage(view);
+    JSTFreePixelImage(parent);
+}
+
+JST_TEST(testEmptyView) {
+    JST_IMAGE *parent = JSTCreateIndexedPixelImage(4, 4, 4);
+    JST_IMAGE *view = JSTCreatePixelImageViewWithPixelImageInRect(parent, 0, 10, 10, 20, 20);
+    JST_ASSERT(view != NULL);
+    JST_EXPECT_EQ(view->width, 0);
+    JST_EXPECT_EQ(view->height, 0);
+    JST_EXPECT(JSTPixelImageMakePacked(view));
+    JSTFreePixelImage(view);
+    JSTFreePixelImage(parent);
+}
+
+JST_TEST(testSharedCopyIsCopiedOnWrite) {
+    JST_IMAGE *original = JSTCreateIndexedPixelImage(6, 4, 8);
+    original->orientation = 3;
+    JST_IMAGE *copy = JSTCreatePixelImageSharingPixelImage(original);
+    JST_ASSERT(copy != NULL);
+    JST_EXPECT(copy->pixels == original->pixels);
+    JST_EXPECT_EQ(copy->alignedWidth, 8);
+    JST_EXPECT_EQ(copy->orientation, 3);
+
+    JST_COLOR color;
+    color.theColor = 0xFFABCDEFu;
+    JSTSetColorInPixelImageSafe(copy, 0, 0, &color);
+    JST_EXPECT(copy->pixels != original->pixels);
+    JSTGetColorInPixelImageSafe(copy, 0, 0, &color);
+    JST_EXPECT_EQ(color.theColor, 0xFFABCDEFu);
+    JSTGetColorInPixelImageSafe(original, 0, 0, &color);
+    JST_EXPECT_EQ(color.theColor, JSTIndexedColorAt(5, 3));
+    JSTGetColorInPixelImageSafe(copy, 1, 1, &color);
+    JST_EXPECT_EQ(color.theColor, JSTIndexedColorAt(4, 2));
+    JSTFreePixelImage(copy);
+    JSTFreePixelImage(original);
+}
+
+JST_TEST(testSharedOriginalIsCopiedOnWrite) {
+    JST_IMAGE *original = JSTCreatePixelImage(4, 4);
+    JST_IMAGE *copy = JSTCreatePixelImageSharingPixelImage(original);
+    JST_ASSERT(copy != NULL);
+
+    JST_COLOR color;
+    color.theColor = 0xFF123456u;
+    JSTSetColorInPixelImageSafe(original, 2, 2, &color);
+    JSTGetColorInPixelImageSafe(copy, 2, 2, &color);
+    JST_EXPECT_EQ(color.theColor, 0u);
+    JST_EXPECT(!JSTPixelImageIsShared(copy));
+
+    /* The copy is the last owner of the storage and is written in place */
+    JST_COLOR *copyPixels = copy->pixels;
+    JSTSetColorInPixelImageSafe(copy, 2, 2, &color);
+    JST_EXPECT(copy->pixels == copyPixels);
+    JSTFreePixelImage(original);
+    JSTFreePixelImage(copy);
+}
+
+JST_TEST(testStatisticsCountCopiedAndAvoidedBytes) {
+    JST_IMAGE *original = JSTCreatePixelImage(10, 10);
+    JSTPixelStorageResetStatistics();
+
+    JST_IMAGE *first = JSTCreatePixelImageSharingPixelImage(original);
+    JST_IMAGE *second = JSTCreatePixelImageSharingPixelImage(original);
+    JST_IMAGE *view = JSTCreatePixelImageViewWithPixelImageInRect(original, 0, 0, 0, 5, 5);
+    JST_IMAGE *copy = JSTCopyPixelImage(original);
+
+    JST_PIXEL_STORAGE_STATISTICS statistics;
+    JSTPixelStorageGetStatistics(&statistics);
+    JST_EXPECT_EQ(statistics.sharedBytes, (uint64_t)(400 + 400 + 100));
+    JST_EXPECT_EQ(statistics.copiedBytes, (uint64_t)400);
+    JST_EXPECT_EQ(statistics.avoidedBytes, (uint64_t)900);
+
+    JST_COLOR color;
+    color.theColor = 1;
+    JSTSetColorInPixelImageSafe(first, 0, 0, &color);
+    JSTSetColorInPixelImageSafe(first, 1, 0, &color);
+    JSTPixelStorageGetStatistics(&statistics);
+    JST_EXPECT_EQ(statistics.copiedBytes, (uint64_t)800);
+    JST_EXPECT_EQ(statistics.avoidedBytes, (uint64_t)500);
+
+    JSTFreePixelImage(copy);
+    JSTFreePixelImage(view);
+    JSTFreePixelImage(second);
+    JSTFreePixelImage(first);
+    JSTFreePixelImage(original);
+}
+
+JST_TEST_MAIN()
@@ -0,0 +1,449 @@
+#include "JSTTest.h"
+#include "JSTPixelTransport.h"
+
+#include <cstring>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+/* MARK: - Helpers */
+
+static const int kFrameWidth = 61;
+static const int kFrameHeight = 37;
+
+static std::vector<JST_COLOR> JSTMakeFrame(int width, int height, uint32_t value) {
+    std::vector<JST_COLOR> pixels((size_t)width * height);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        pixels[i].theColor = value ^ (uint32_t)i;
+    }
+    return pixels;
+}
+
+static bool JSTFrameMatches(const JST_IMAGE *image, uint32_t value) {
+    for (int y = 0; y < image->height; ++y) {
+        for (int x = 0; x < image->width; ++x) {
+            size_t i = (size_t)y * image->width + x;
+            if (image->pixels[(size_t)y * image->alignedWidth + x].theColor != (value ^ (uint32_t)i)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static JST_PIXEL_TRANSPORT_STATUS JSTWriteFrame(JST_PIXEL_TRANSPORT *transport, uint32_t value, JST_PIXEL_TRANSPORT_FRAME *frame) {
+    std::vector<JST_COLOR> pixels = JSTMakeFrame(kFrameWidth, kFrameHeight, value);
+    return JSTPixelTransportWriteFrame(transport, pixels.data(), kFrameWidth, kFrameHeight, kFrameWidth * sizeof(JST_COLOR), 0, value, frame);
+}
+
+static size_t JSTFrameLength(void) {
+    return (size_t)kFrameWidth * kFrameHeight * sizeof(JST_COLOR);
+}
+
+/* The control channel, XPC passes the descriptor as an NSFileHandle. */
+static bool JSTSendFileDescriptor(int socket, int fd) {
+    char byte = 0;
+    struct iovec vector = { &byte, 1 };
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &fd, sizeof(int));
+    return sendmsg(socket, &message, 0) == 1;
+}
+
+static int JSTReceiveFileDescriptor(int socket) {
+    char byte = 0;
+    struct iovec vector = { &byte, 1 };
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (recvmsg(socket, &message, 0) != 1) {
+        return -1;
+    }
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_type != SCM_RIGHTS) {
+        return -1;
+    }
+    int fd;
+    memcpy(&fd, CMSG_DATA(header), sizeof(int));
+    return fd;
+}
+
+static bool JSTSendAll(int socket, const void *bytes, size_t length) {
+    return write(socket, bytes, length) == (ssize_t)length;
+}
+
+static bool JSTReceiveAll(int socket, void *bytes, size_t length) {
+    size_t offset = 0;
+    while (offset < length) {
+        ssize_t count = read(socket, (uint8_t *)bytes + offset, length - offset);
+        if (count <= 0) {
+            return false;
+        }
+        offset += (size_t)count;
+    }
+    return true;
+}
+
+
+/* MARK: - Tests */
+
+JST_TEST(testCreateRejectsInvalidArguments) {
+    JST_EXPECT(JSTPixelTransportCreate(0, 1024) == NULL);
+    JST_EXPECT(JSTPixelTransportCreate(2, 0) == NULL);
+
+    JST_PIXEL_TRANSPORT *transport = JSTPixelTransportCreate(3, 1000);
+    JST_ASSERT(transport);
+    JST_EXPECT_EQ(JSTPixelTransportGetSlotCount(transport), 3);
+    JST_EXPECT_EQ(JSTPixelTransportGetSlotLength(transport) % JST_PIXEL_TRANSPORT_ALIGNMENT, 0u);
+    JST_EXPECT(JSTPixelTransportGetSlotLength(transport) >= 1000u);
+    JSTPixelTransportFree(transport);
+}
+
+JST_TEST(testReaderWrapsSlotWithoutCopying) {
+    JST_PIXEL_TRANSPORT *writer = JSTPixelTransportCreate(2, JSTFrameLength());
+    JST_ASSERT(writer);
+    JST_PIXEL_TRANSPORT *reader = JSTPixelTransportOpen(JSTPixelTransportGetFileDescriptor(writer));
+    JST_ASSERT(reader);
+    JST_EXPECT_EQ(JSTPixelTransportGetIdentifier(reader), JSTPixelTransportGetIdentifier(writer));
+
+    JST_PIXEL_TRANSPORT_FRAME frame;
+    JST_ASSERT(JSTWriteFrame(writer, 0x1234, &frame) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+    JST_EXPECT_EQ(frame.sequence, 1u);
+    JST_EXPECT_EQ(frame.timestamp, 0x1234u);
+
+    JST_PIXEL_STORAGE_STATISTICS before;
+    JSTPixelStorageGetStatistics(&before);
+    JST_IMAGE *image = JSTPixelTransportCreatePixelImage(reader, &frame);
+    JST_ASSERT(image);
+    JST_PIXEL_STORAGE_STATISTICS after;
+    JSTPixelStorageGetStatistics(&after);
+    JST_EXPECT_EQ(after.copiedBytes, before.copiedBytes);
+    JST_EXPECT_EQ(image->width, kFrameWidth);
+    JST_EXPECT_EQ(image->alignedWidth, kFrameWidth);
+    JST_EXPECT_EQ(image->height, kFrameHeight);
+    JST_EXPECT(JSTFrameMatches(image, 0x1234));
+
+    JST_PIXEL_TRANSPORT_STATISTICS statistics;
+    JSTPixelTransportGetStatistics(writer, &statistics);
+    JST_EXPECT_EQ(statistics.writtenCount, 1u);
+    JST_EXPECT_EQ(statistics.leasedCount, 1);
+
+    JSTFreePixelImage(image);
+    JSTPixelTransportGetStatistics(writer, &statistics);
+    JST_EXPECT_EQ(statistics.leasedCount, 0);
+
+    JSTPixelTransportFree(reader);
+    JSTPixelTransportFree(writer);
+}
+
+JST_TEST(testWritingImageCopiesSlot) {
+    JST_PIXEL_TRANSPORT *transport = JSTPixelTransportCreate(1, JSTFrameLength());
+    JST_ASSERT(transport);
+    JST_PIXEL_TRANSPORT_FRAME frame;
+    JST_ASSERT(JSTWriteFrame(transport, 7, &frame) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+
+    JST_IMAGE *image = JSTPixelTransportCreatePixelImage(transport, &frame);
+    JST_IMAGE *other = JSTPixelTransportCreatePixelImage(transport, &frame);
+    JST_ASSERT(image && other);
+    JST_COLOR color;
+    color.theColor = 0xFF00FF00u;
+    JSTSetColorInPixelImageSafe(image, 3, 4, &color);
+    JST_EXPECT(image->pixels != other->pixels);
+    JST_EXPECT(JSTFrameMatches(other, 7));
+
+    /* the copy gave up its lease */
+    JST_PIXEL_TRANSPORT_STATISTICS statistics;
+    JSTPixelTransportGetStatistics(transport, &statistics);
+    JST_EXPECT_EQ(statistics.leasedCount, 1);
+    JSTFreePixelImage(other);
+    JST_EXPECT(JSTWriteFrame(transport, 8, &frame) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+
+    JSTFreePixelImage(image);
+    JSTPixelTransportFree(transport);
+}
+
+JST_TEST(testLeasedSlotsAreNotOverwritten) {
+    JST_PIXEL_TRANSPORT *transport = JSTPixelTransportCreate(2, JSTFrameLength());
+    JST_ASSERT(transport);
+    JST_PIXEL_TRANSPORT_FRAME first, second, frame;
+    JST_ASSERT(JSTWriteFrame(transport, 1, &first) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+    JST_IMAGE *image = JSTPixelTransportCreatePixelImage(transport, &first);
+    JST_ASSERT(image);
+
+    for (uint32_t value = 2; value < 6; ++value) {
+        JST_EXPECT(JSTWriteFrame(transport, value, &frame) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+        JST_EXPECT(frame.slot != first.slot);
+    }
+    JST_EXPECT(JSTFrameMatches(image, 1));
+
+    /* with both slots leased, frames are dropped */
+    JST_IMAGE *latest = JSTPixelTransportCreatePixelImage(transport, &frame);
+    JST_ASSERT(latest);
+    JST_EXPECT(JSTWriteFrame(transport, 6, &second) == JST_PIXEL_TRANSPORT_STATUS_DROPPED);
+    JST_PIXEL_TRANSPORT_STATISTICS statistics;
+    JSTPixelTransportGetStatistics(transport, &statistics);
+    JST_EXPECT_EQ(statistics.droppedCount, 1u);
+    JST_EXPECT_EQ(statistics.leasedCount, 2);
+
+    JSTFreePixelImage(image);
+    JST_EXPECT(JSTWriteFrame(transport, 7, &second) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+    JST_EXPECT_EQ(second.slot, first.slot);
+    JST_EXPECT(JSTFrameMatches(latest, 5));
+
+    JSTFreePixelImage(latest);
+    JSTPixelTransportFree(transport);
+}
+
+JST_TEST(testRejectsOverwrittenAndForeignFrames) {
+    JST_PIXEL_TRANSPORT *transport = JSTPixelTransportCreate(2, JSTFrameLength());
+    JST_PIXEL_TRANSPORT *other = JSTPixelTransportCreate(2, JSTFrameLength());
+    JST_ASSERT(transport && other);
+    JST_EXPECT(JSTPixelTransportGetIdentifier(transport) != JSTPixelTransportGetIdentifier(other));
+
+    JST_PIXEL_TRANSPORT_FRAME old, frame;
+    JST_ASSERT(JSTWriteFrame(transport, 1, &old) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+    JST_ASSERT(JSTWriteFrame(transport, 2, &frame) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+    JST_ASSERT(JSTWriteFrame(transport, 3, &frame) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+    JST_EXPECT(JSTPixelTransportCreatePixelImage(transport, &old) == NULL);
+    JST_EXPECT(JSTPixelTransportCreatePixelImage(other, &frame) == NULL);
+
+    JST_PIXEL_TRANSPORT_FRAME forged = frame;
+    forged.slot = 2;
+    JST_EXPECT(JSTPixelTransportCreatePixelImage(transport, &forged) == NULL);
+    forged = frame;
+    forged.height += 1;
+    JST_EXPECT(JSTPixelTransportCreatePixelImage(transport, &forged) == NULL);
+    forged = frame;
+    forged.orientation = 4;
+    JST_EXPECT(JSTPixelTransportCreatePixelImage(transport, &forged) == NULL);
+
+    JST_PIXEL_TRANSPORT_STATISTICS statistics;
+    JSTPixelTransportGetStatistics(transport, &statistics);
+    JST_EXPECT_EQ(statistics.leasedCount, 0);
+
+    JSTPixelTransportFree(other);
+    JSTPixelTransportFree(transport);
+}
+
+JST_TEST(testFramesInProgressAreInvisible) {
+    JST_PIXEL_TRANSPORT *transport = JSTPixelTransportCreate(1, JSTFrameLength());
+    JST_ASSERT(transport);
+    JST_PIXEL_TRANSPORT_FRAME frame;
+    JST_ASSERT(JSTWriteFrame(transport, 1, &frame) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+
+    JST_PIXEL_TRANSPORT_STATUS status;
+    JST_COLOR *pixels = JSTPixelTransportBeginFrame(transport, kFrameWidth, kFrameHeight, &status);
+    JST_ASSERT(pixels);
+    JST_EXPECT(JSTPixelTransportCreatePixelImage(transport, &frame) == NULL);
+
+    /* one frame at a time */
+    JST_EXPECT(JSTPixelTransportBeginFrame(transport, kFrameWidth, kFrameHeight, &status) == NULL);
+    JSTPixelTransportCancelFrame(transport);
+
+    pixels = JSTPixelTransportBeginFrame(transport, 2, 2, &status);
+    JST_ASSERT(pixels);
+    for (int i = 0; i < 4; ++i) {
+        pixels[i].theColor = 0xFF000000u | (uint32_t)i;
+    }
+    JSTPixelTransportCommitFrame(transport, 1, 42, &frame);
+    JST_EXPECT_EQ(frame.sequence, 2u);
+    JST_IMAGE *image = JSTPixelTransportCreatePixelImage(transport, &frame);
+    JST_ASSERT(image);
+    JST_EXPECT_EQ(image->orientation, 1);
+    JST_EXPECT_EQ(image->pixels[3].theColor, 0xFF000003u);
+    JSTFreePixelImage(image);
+    JSTPixelTransportFree(transport);
+}
+
+JST_TEST(testRejectsTooLargeFrames) {
+    JST_PIXEL_TRANSPORT *transport = JSTPixelTransportCreate(2, JST_PIXEL_TRANSPORT_ALIGNMENT);
+    JST_ASSERT(transport);
+    std::vector<JST_COLOR> pixels = JSTMakeFrame(64, 65, 0);
+    JST_PIXEL_TRANSPORT_FRAME frame;
+    JST_EXPECT(JSTPixelTransportWriteFrame(transport, pixels.data(), 64, 64, 64 * sizeof(JST_COLOR), 0, 0, &frame) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+    JST_EXPECT(JSTPixelTransportWriteFrame(transport, pixels.data(), 64, 65, 64 * sizeof(JST_COLOR), 0, 0, &frame) == JST_PIXEL_TRANSPORT_STATUS_TOO_LARGE);
+    JST_EXPECT(JSTPixelTransportWriteFrame(transport, pixels.data(), 64, 8, 63 * sizeof(JST_COLOR), 0, 0, &frame) == JST_PIXEL_TRANSPORT_STATUS_TOO_LARGE);
+    JSTPixelTransportFree(transport);
+}
+
+/* A writer which describes a frame larger than its slot, be it broken or
+ * hostile, must not make the reader wrap the pixels of the next slot. */
+JST_TEST(testRejectsFramesLargerThanTheirSlot) {
+    JST_PIXEL_TRANSPORT *writer = JSTPixelTransportCreate(2, JST_PIXEL_TRANSPORT_ALIGNMENT);
+    JST_ASSERT(writer);
+    JST_PIXEL_TRANSPORT *reader = JSTPixelTransportOpen(JSTPixelTransportGetFileDescriptor(writer));
+    JST_ASSERT(reader);
+    std::vector<JST_COLOR> pixels = JSTMakeFrame(64, 64, 7);
+    JST_PIXEL_TRANSPORT_FRAME frame;
+    JST_ASSERT(JSTPixelTransportWriteFrame(writer, pixels.data(), 64, 64, 64 * sizeof(JST_COLOR), 0, 0, &frame) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+
+    /* the slot controls follow the header, 64 bytes each, with the width
+     * and the height of the frame at 24 and 28 */
+    const JST_PIXEL_TRANSPORT_HEADER *header = (const JST_PIXEL_TRANSPORT_HEADER *)mmap(NULL, (size_t)JST_PIXEL_TRANSPORT_ALIGNMENT, PROT_READ | PROT_WRITE, MAP_SHARED, JSTPixelTransportGetFileDescriptor(writer), 0);
+    JST_ASSERT(header != MAP_FAILED);
+    uint8_t *control = (uint8_t *)header + 64 * (size_t)(frame.slot + 1);
+    int32_t height = frame.height * 2;
+    memcpy(control + 28, &height, sizeof(height));
+
+    JST_PIXEL_TRANSPORT_FRAME forged = frame;
+    forged.height = height;
+    JST_EXPECT(JSTPixelTransportCreatePixelImage(reader, &forged) == NULL);
+    JST_PIXEL_TRANSPORT_STATISTICS statistics;
+    JSTPixelTransportGetStatistics(reader, &statistics);
+    JST_EXPECT_EQ(statistics.leasedCount, 0);
+
+    /* the frame as written is still fine */
+    memcpy(control + 28, &frame.height, sizeof(frame.height));
+    JST_IMAGE *image = JSTPixelTransportCreatePixelImage(reader, &frame);
+    JST_EXPECT(image != NULL);
+    JSTFreePixelImage(image);
+
+    munmap((void *)header, (size_t)JST_PIXEL_TRANSPORT_ALIGNMENT);
+    JSTPixelTransportFree(reader);
+    JSTPixelTransportFree(writer);
+}
+
+JST_TEST(testOpenRejectsOtherFiles) {
+    int fds[2];
+    JST_ASSERT(pipe(fds) == 0);
+    JST_EXPECT(JSTPixelTransportOpen(fds[0]) == NULL);
+    close(fds[0]);
+    close(fds[1]);
+
+    char path[] = "/tmp/JSTPixelTransportTests-XXXXXX";
+    int fd = mkstemp(path);
+    JST_ASSERT(fd >= 0);
+    unlink(path);
+    std::vector<uint8_t> junk(2 * JST_PIXEL_TRANSPORT_ALIGNMENT, 0xA5);
+    JST_EXPECT(write(fd, junk.data(), junk.size()) == (ssize_t)junk.size());
+    JST_EXPECT(JSTPixelTransportOpen(fd) == NULL);
+    close(fd);
+}
+
+JST_TEST(testImagesOutliveTransport) {
+    JST_PIXEL_TRANSPORT *writer = JSTPixelTransportCreate(2, JSTFrameLength());
+    JST_ASSERT(writer);
+    JST_PIXEL_TRANSPORT *reader = JSTPixelTransportOpen(JSTPixelTransportGetFileDescriptor(writer));
+    JST_ASSERT(reader);
+    JST_PIXEL_TRANSPORT_FRAME frame;
+    JST_ASSERT(JSTWriteFrame(writer, 99, &frame) == JST_PIXEL_TRANSPORT_STATUS_WRITTEN);
+    JST_IMAGE *image = JSTPixelTransportCreatePixelImage(reader, &frame);
+    JST_ASSERT(image);
+    JSTPixelTransportFree(reader);
+    JSTPixelTransportFree(writer);
+    JST_EXPECT(JSTFrameMatches(image, 99));
+    JSTFreePixelImage(image);
+}
+
+/* A forked writer streams frames to this process, which plays the app: the
+ * descriptor of the transport goes through the socket once, then only
+ * frame descriptors. Leased frames must stay intact however many frames
+ * the writer pushes meanwhile. */
+JST_TEST(testStreamsFramesBetweenProcesses) {
+    static const uint32_t kFrameCount = 200;
+    int sockets[2];
+    JST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+
+    pid_t pid = fork();
+    JST_ASSERT(pid >= 0);
+    if (pid == 0) {
+        close(sockets[0]);
+        int socket = sockets[1];
+        JST_PIXEL_TRANSPORT *transport = JSTPixelTransportCreate(3, JSTFrameLength());
+        if (!transport || !JSTSendFileDescriptor(socket, JSTPixelTransportGetFileDescriptor(transport))) {
+            _exit(2);
+        }
+        uint32_t value = 0;
+        while (value < kFrameCount) {
+            JST_PIXEL_TRANSPORT_FRAME frame;
+            JST_PIXEL_TRANSPORT_STATUS status = JSTWriteFrame(transport, value, &frame);
+            if (status == JST_PIXEL_TRANSPORT_STATUS_TOO_LARGE) {
+                _exit(3);
+            }
+            if (status == JST_PIXEL_TRANSPORT_STATUS_DROPPED) {
+                usleep(100);
+                continue;
+            }
+            if (!JSTSendAll(socket, &frame, sizeof(frame))) {
+                _exit(4);
+            }
+            value += 1;
+        }
+        char done;
+        JSTReceiveAll(socket, &done, 1);  /* the reader has checked every lease */
+        JSTPixelTransportFree(transport);
+        _exit(0);
+    }
+
+    close(sockets[1]);
+    int socket = sockets[0];
+    int fd = JSTReceiveFileDescriptor(socket);
+    JST_ASSERT(fd >= 0);
+    JST_PIXEL_TRANSPORT *transport = JSTPixelTransportOpen(fd);
+    close(fd);
+    JST_ASSERT(transport);
+
+    int receivedCount = 0, leasedCount = 0, tornCount = 0;
+    JST_IMAGE *held = NULL;
+    uint32_t heldValue = 0;
+    JST_PIXEL_TRANSPORT_FRAME frame;
+    while (JSTReceiveAll(socket, &frame, sizeof(frame))) {
+        receivedCount += 1;
+        uint32_t value = (uint32_t)frame.timestamp;
+        JST_IMAGE *image = JSTPixelTransportCreatePixelImage(transport, &frame);
+        if (image) {
+            leasedCount += 1;
+            tornCount += JSTFrameMatches(image, value) ? 0 : 1;
+        }
+        /* keep one frame for a while, the writer goes on with the other slots */
+        if (held && value % 16 == 0) {
+            tornCount += JSTFrameMatches(held, heldValue) ? 0 : 1;
+            JSTFreePixelImage(held);
+            held = NULL;
+        }
+        if (!held && image) {
+            held = image;
+            heldValue = value;
+        } else if (image) {
+            JSTFreePixelImage(image);
+        }
+        if (frame.timestamp + 1 == kFrameCount) {
+            break;
+        }
+    }
+    if (held) {
+        tornCount += JSTFrameMatches(held, heldValue) ? 0 : 1;
+        JSTFreePixelImage(held);
+    }
+    char done = 1;
+    JST_EXPECT(JSTSendAll(socket, &done, 1));
+
+    int status = 0;
+    JST_EXPECT(waitpid(pid, &status, 0) == pid);
+    JST_EXPECT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    JST_EXPECT_EQ(receivedCount, (int)kFrameCount);
+    JST_EXPECT(leasedCount > 0);
+    JST_EXPECT_EQ(tornCount, 0);
+    close(socket);
+    JSTPixelTransportFree(transport);
+}
+
+JST_TEST_MAIN()
@@ -0,0 +1,95 @@
+#ifndef JSTTest_h
+#define JSTTest_h
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+/* Minimal test harness, so that the core has no third-party dependency.
+ * Each test executable defines its cases with JST_TEST and ends with
+ * JST_TEST_MAIN(). */
+
+struct JSTTestCase {
+    const char *name;
+    std::function<void()> body;
+};
+
+inline std::vector<JSTTestCase> &JSTTestCases() {
+    static std::vector<JSTTestCase> cases;
+    return cases;
+}
+
+inline int &JSTTestFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+struct JSTTestRegistrar {
+    JSTTestRegistrar(const char *name, std::function<void()> body) {
+        JSTTestCases().push_back({ name, std::move(body) });
+    }
+};
+
+/* Compares integers of different signedness by value, like C++20's
+ * std::cmp_equal, and anything else with ==. */
+template <typename A, typename B>
+inline bool JSTTestEqual(const A &a, const B &b) {
+    if constexpr (std::is_integral<A>::value && std::is_integral<B>::value &&
+                  std::is_signed<A>::value != std::is_signed<B>::value) {
+        if constexpr (std::is_signed<A>::value) {
+            return a >= 0 && (typename std::make_unsigned<A>::type)a == b;
+        } else {
+            return b >= 0 && a == (typename std::make_unsigned<B>::type)b;
+        }
+    } else {
+        return a == b;
+    }
+}
+
+#define JST_TEST(NAME) \
+    static void NAME(); \
+    static JSTTestRegistrar NAME##_registrar(#NAME, NAME); \
+    static void NAME()
+
+#define JST_EXPECT(COND) \
+    do { \
+        if (!(COND)) { \
+            fprintf(stderr, "%s:%d: expectation failed: %s\n", __FILE__, __LINE__, #COND); \
+            ++JSTTestFailures(); \
+        } \
+    } while (0)
+
+#define JST_EXPECT_EQ(A, B) \
+    do { \
+        auto jst_a_ = (A); \
+        auto jst_b_ = (B); \
+        if (!JSTTestEqual(jst_a_, jst_b_)) { \
+            fprintf(stderr, "%s:%d: expectation failed: %s == %s (%lld vs %lld)\n", __FILE__, __LINE__, #A, #B, \
+                    (long long)jst_a_, (long long)jst_b_); \
+            ++JSTTestFailures(); \
+        } \
+    } while (0)
+
+#define JST_ASSERT(COND) \
+    do { \
+        if (!(COND)) { \
+            fprintf(stderr, "%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #COND); \
+            ++JSTTestFailures(); \
+            return; \
+        } \
+    } while (0)
+
+#define JST_TEST_MAIN() \
+    int main() { \
+        for (const JSTTestCase &testCase : JSTTestCases()) { \
+            int failuresBefore = JSTTestFailures(); \
+            testCase.body(); \
+            printf("[%s] %s\n", JSTTestFailures() == failuresBefore ? "  OK  " : " FAIL ", testCase.name); \
+        } \
+        printf("%zu tests, %d failures\n", JSTTestCases().size(), JSTTestFailures()); \
+        return JSTTestFailures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE; \
+    }
+
+#endif /* JSTTest_h */
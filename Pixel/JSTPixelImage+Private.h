@@ -7,14 +7,12 @@
 #endif
 
 #import "JSTPixelImage.h"
+#import "JSTPixelCore.h"
 //#import "IOSurfaceSPI.h"
 
 
 NS_ASSUME_NONNULL_BEGIN
 
-FOUNDATION_EXTERN void JSTGetColorInPixelImageSafe(JST_IMAGE *pixelImage, int x, int y, JST_COLOR *colorOfPoint);
-FOUNDATION_EXTERN void JSTSetColorInPixelImageSafe(JST_IMAGE *pixelImage, int x, int y, JST_COLOR *colorOfPoint);
-
 @interface JSTPixelImage (Private)
 - (JSTPixelImage *)initWithCompatibleScreenSurface:(IOSurfaceRef)surface colorSpace:(CGColorSpaceRef)colorSpace;
 @end
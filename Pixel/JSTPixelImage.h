@@ -11,6 +11,7 @@
 #endif
 
 #import "JST_IMAGE.h"
+#import "JSTPixelCache.h"
 
 
 NS_ASSUME_NONNULL_BEGIN
@@ -28,11 +29,27 @@ NS_ASSUME_NONNULL_BEGIN
 - (JSTPixelImage *)initWithInternalPointer:(JST_IMAGE *)pointer colorSpace:(CGColorSpaceRef)colorSpace;
 - (SystemImage *)toSystemImage;
 
+/// Maps a file written by writePixelCacheToPath:contentHash: read-only, returns nil if it is missing, outdated or of another content.
+- (nullable JSTPixelImage *)initWithPixelCacheAtPath:(NSString *)path contentHash:(uint64_t)contentHash;
+- (BOOL)writePixelCacheToPath:(NSString *)path contentHash:(uint64_t)contentHash;
+
+/// Wraps 8-bit BGRA pixels (alpha premultiplied first, host byte order) without copying them, data is retained until the pixels are freed. Returns nil if bytesPerRow does not fit the width.
+- (nullable JSTPixelImage *)initWithPixelData:(NSData *)data width:(NSUInteger)width height:(NSUInteger)height bytesPerRow:(NSUInteger)bytesPerRow orientation:(JST_ORIENTATION)orientation colorSpace:(CGColorSpaceRef)colorSpace;
+
+/// Unrotated images share their pixels with the returned image instead of copying them.
+- (CGImageRef)copyCGImage CF_RETURNS_RETAINED;
+
 @property (nonatomic, assign, readonly) JST_IMAGE *internalPointer;
+/// Same as internalPointer, but cropped views are copied first so that rows are adjacent (alignedWidth == width).
+@property (nonatomic, assign, readonly) JST_IMAGE *packedInternalPointer;
 @property (nonatomic, assign, readonly) CGColorSpaceRef colorSpace;
 @property (nonatomic, assign, readonly) CGSize size;
 @property (nonatomic, assign, readwrite) JST_ORIENTATION orientation;
 
+/// Bytes copied versus shared by crops and copies of all pixel images, copies share their pixels until the first setColor:.
+@property (class, nonatomic, assign, readonly) JST_PIXEL_STORAGE_STATISTICS storageStatistics;
+
+/// Returns a view sharing the pixels of the receiver, which are copied on its first write.
 - (JSTPixelImage *)crop:(CGRect)rect;
 
 - (JSTPixelColor *)getJSTColorOfPoint:(CGPoint)point;
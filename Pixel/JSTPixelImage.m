@@ -1,8 +1,8 @@
 #import "JSTPixelImage.h"
 #import "JSTPixelImage+Private.h"
 #import "JSTPixelColor.h"
-#import "JST_POS.h"
-#import "JST_COLOR.h"
+#import "JSTPixelCore.h"
+#import "JSTPixelCache.h"
 
 #import <stdlib.h>
 #import <CoreGraphics/CoreGraphics.h>
@@ -252,32 +252,25 @@ NS_INLINE CGAffineTransform SDCGContextTransformFromOrientation(CGImagePropertyO
 
 NS_INLINE JST_IMAGE *JSTCreatePixelImageWithCGImage(CGImageRef cgimg, CGColorSpaceRef *cgColorSpace)
 {
-    CGSize imgSize = CGSizeMake(CGImageGetWidth(cgimg), CGImageGetHeight(cgimg));
-    
-    JST_IMAGE *newPixelImage = (JST_IMAGE *)malloc(sizeof(JST_IMAGE));
-    bzero(newPixelImage, sizeof(JST_IMAGE));
-    newPixelImage->width = imgSize.width;
-    newPixelImage->alignedWidth = imgSize.width;
-    newPixelImage->height = imgSize.height;
+    size_t width = CGImageGetWidth(cgimg);
+    size_t height = CGImageGetHeight(cgimg);
     
     /* New pixel image is not aligned */
-    size_t pixelsSize = imgSize.width * imgSize.height * sizeof(JST_COLOR);
-    JST_COLOR *pixels = (JST_COLOR *)malloc(pixelsSize);
-    bzero(pixels, pixelsSize);
-    newPixelImage->pixels = pixels;
+    JST_IMAGE *newPixelImage = JSTCreatePixelImage((int)width, (int)height);
+    NSCAssert(newPixelImage != NULL, @"cannot allocate pixel image %ldx%ld", width, height);
     
     *cgColorSpace = (CGColorSpaceRef)CFRetain(CGImageGetColorSpace(cgimg));
     CGContextRef context = CGBitmapContextCreate(
-        pixels,
-        (size_t) imgSize.width,
-        (size_t) imgSize.height,
+        newPixelImage->pixels,
+        width,
+        height,
         sizeof(JST_COLOR_COMPONENT_TYPE) * BYTE_SIZE,
-        imgSize.width * sizeof(JST_COLOR),
+        width * sizeof(JST_COLOR),
         *cgColorSpace,
         kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst  /* kCGImageAlphaNoneSkipFirst */
     );
     
-    CGContextDrawImage(context, CGRectMake(0, 0, imgSize.width, imgSize.height), cgimg);
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), cgimg);
     CGContextRelease(context);
     return newPixelImage;
 }
@@ -296,214 +289,15 @@ NS_INLINE JST_IMAGE *JSTCreatePixelImageWithNSImage(NSImage *nsimg, CGColorSpace
 }
 #endif
 
-
-#define SHIFT_XY_BY_ORIEN_NOM1(X, Y, W, H, O) \
-    { \
-        switch (O) { \
-            int Z; \
-        case 0: \
-            break; \
-        case 1: \
-            (Z) = (X); \
-            (X) = (W) -(Y); \
-            (Y) = (Z); \
-            break; \
-        case 2: \
-            (Z) = (Y); \
-            (Y) = (H) -(X); \
-            (X) = (Z); \
-            break; \
-        case 3: \
-            (X) = (W) -(X); \
-            (Y) = (H) -(Y); \
-            break; \
-        } \
-    }
-
-#define SHIFT_XY_BY_ORIEN(X, Y, W, H, O) SHIFT_XY_BY_ORIEN_NOM1((X), (Y), ((W)-1), ((H)-1), (O))
-
-#define UNSHIFT_XY_BY_ORIEN_NOM1(X, Y, W, H, O) \
-    { \
-        switch (O) { \
-            int Z; \
-        case 0: \
-            break; \
-        case 1: \
-            (Z) = (Y); \
-            (Y) = (W) -(X); \
-            (X) = (Z); \
-            break; \
-        case 2: \
-            (Z) = (X); \
-            (X) = (H) -(Y); \
-            (Y) = (Z); \
-            break; \
-        case 3: \
-            (X) = (W) -(X); \
-            (Y) = (H) -(Y); \
-            break; \
-        } \
-    }
-
-#define UNSHIFT_XY_BY_ORIEN(X, Y, W, H, O) UNSHIFT_XY_BY_ORIEN_NOM1((X), (Y), ((W)-1), ((H)-1), (O))
-
-#define SHIFT_RECT_BY_ORIEN_NOM1(X1, Y1, X2, Y2, W, H, O) \
-    { \
-        int Z; \
-        SHIFT_XY_BY_ORIEN_NOM1((X1), (Y1), (W), (H), (O)); \
-        SHIFT_XY_BY_ORIEN_NOM1((X2), (Y2), (W), (H), (O)); \
-        if ((X1) > (X2)) { \
-            (Z) = (X1); \
-            (X1) = (X2); \
-            (X2) = (Z); \
-        } \
-        if ((Y1) > (Y2)) { \
-            (Z) = (Y1); \
-            (Y1) = (Y2); \
-            (Y2) = (Z); \
-        } \
-    }
-
-#define SHIFT_RECT_BY_ORIEN(X1, Y1, X2, Y2, W, H, O) SHIFT_RECT_BY_ORIEN_NOM1((X1), (Y1), (X2), (Y2), (W - 1), (H - 1), (O))
-
-#define UNSHIFT_RECT_BY_ORIEN_NOM1(X1, Y1, X2, Y2, W, H, O) \
-    { \
-        int Z; \
-        UNSHIFT_XY_BY_ORIEN_NOM1((X1), (Y1), (W), (H), (O)); \
-        UNSHIFT_XY_BY_ORIEN_NOM1((X2), (Y2), (W), (H), (O)); \
-        if ((X1) > (X2)) { \
-            (Z) = (X1); \
-            (X1) = (X2); \
-            (X2) = (Z); \
-        } \
-        if ((Y1) > (Y2)) { \
-            (Z) = (Y1); \
-            (Y1) = (Y2); \
-            (Y2) = (Z); \
-        } \
-    }
-
-#define UNSHIFT_RECT_BY_ORIEN(X1, Y1, X2, Y2, W, H, O) UNSHIFT_RECT_BY_ORIEN_NOM1((X1), (Y1), (X2), (Y2), (W - 1), (H - 1), (O))
-
-#define GET_ROTATE_ROTATE(OO, FO, OUTO) \
-    { \
-        switch (FO) { \
-        case 1: \
-            switch (OO) { \
-            case 0: \
-                (OUTO) = 1; \
-                break; \
-            case 1: \
-                (OUTO) = 3; \
-                break; \
-            case 2: \
-                (OUTO) = 0; \
-                break; \
-            case 3: \
-                (OUTO) = 2; \
-                break; \
-            } \
-            break; \
-        case 2: \
-            switch (OO) { \
-            case 0: \
-                (OUTO) = 2; \
-                break; \
-            case 1: \
-                (OUTO) = 0; \
-                break; \
-            case 2: \
-                (OUTO) = 3; \
-                break; \
-            case 3: \
-                (OUTO) = 1; \
-                break; \
-            } \
-            break; \
-        case 3: \
-            switch (OO) { \
-            case 0: \
-                (OUTO) = 3; \
-                break; \
-            case 1: \
-                (OUTO) = 2; \
-                break; \
-            case 2: \
-                (OUTO) = 1; \
-                break; \
-            case 3: \
-                (OUTO) = 0; \
-                break; \
-            } \
-            break; \
-        case 0: \
-            (OUTO) = OO; \
-        } \
-    }
-
-#define GET_ROTATE_ROTATE2(OO, FO) GET_ROTATE_ROTATE((OO), (FO), (OO))
-
-#define GET_ROTATE_ROTATE3 GET_ROTATE_ROTATE
-
-FOUNDATION_EXTERN_INLINE void JSTGetColorInPixelImageSafe(JST_IMAGE *pixelImage, int x, int y, JST_COLOR *colorOfPoint)
-{
-    SHIFT_XY_BY_ORIEN(x, y, pixelImage->width, pixelImage->height, pixelImage->orientation);
-    if (x >= pixelImage->width ||
-        y >= pixelImage->height)
-    {
-        colorOfPoint->theColor = 0;
-        return;
-    }
-    colorOfPoint->theColor = pixelImage->pixels[y * pixelImage->alignedWidth + x].theColor;
-}
-
-NS_INLINE void JSTGetColorInPixelImageUnsafe(JST_IMAGE *pixels_image, int x, int y, JST_COLOR *color_of_point)
-{
-    SHIFT_XY_BY_ORIEN(x, y, pixels_image->width, pixels_image->height, pixels_image->orientation);
-    color_of_point->theColor = pixels_image->pixels[y * pixels_image->alignedWidth + x].theColor;
-}
-
-FOUNDATION_EXTERN_INLINE void JSTSetColorInPixelImageSafe(JST_IMAGE *pixels_image, int x, int y, JST_COLOR *color_of_point)
-{
-    SHIFT_XY_BY_ORIEN(x, y, pixels_image->width, pixels_image->height, pixels_image->orientation);
-    if (x >= pixels_image->width ||
-        y >= pixels_image->height)
-    {
-        return;
-    }
-    pixels_image->pixels[y * pixels_image->alignedWidth + x].theColor = color_of_point->theColor;
-}
-
 NS_INLINE CGImageRef JSTCreateCGImageWithPixelImage(JST_IMAGE *pixelImage, CGColorSpaceRef cgColorSpace)
 {
     int width, height;
-    switch (pixelImage->orientation) {
-    case 1:
-    case 2:
-        height = pixelImage->width;
-        width = pixelImage->height;
-        break;
-    default:
-        width = pixelImage->width;
-        height = pixelImage->height;
-        break;
-    }
+    JSTGetOrientedSizeOfPixelImage(pixelImage, &width, &height);
     
     /* CGImage is not aligned */
-    size_t pixelsBufferLength = (size_t)(width * height * sizeof(JST_COLOR));
+    size_t pixelsBufferLength = (size_t)width * (size_t)height * sizeof(JST_COLOR);
     JST_COLOR *pixelsBuffer = (JST_COLOR *)malloc(pixelsBufferLength);
-    if (0 == pixelImage->orientation && pixelImage->width == pixelImage->alignedWidth) {
-        memcpy(pixelsBuffer, pixelImage->pixels, pixelsBufferLength);
-    } else {
-        uint64_t bigCountOffset = 0;
-        JST_COLOR colorOfPoint;
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                JSTGetColorInPixelImageUnsafe(pixelImage, x, y, &colorOfPoint);
-                pixelsBuffer[bigCountOffset++].theColor = colorOfPoint.theColor;
-            }
-        }
-    }
+    JSTCopyOrientedPixelsOfPixelImage(pixelImage, pixelsBuffer);
     
     CFDataRef imageData = CFDataCreateWithBytesNoCopy(kCFAllocatorMalloc, (const UInt8 *)pixelsBuffer, pixelsBufferLength, kCFAllocatorMalloc);
     CGDataProviderRef imageDataProvider = CGDataProviderCreateWithCFData(imageData);
@@ -523,41 +317,35 @@ NS_INLINE CGImageRef JSTCreateCGImageWithPixelImage(JST_IMAGE *pixelImage, CGCol
     return cgImage;
 }
 
-NS_INLINE JST_IMAGE *JSTCreatePixelImageWithPixelImageInRect(JST_IMAGE *pixelImage, JST_ORIENTATION orientation, int x1, int y1, int x2, int y2)
+static void JSTReleaseSharedPixelImageData(void *info, const void *data, size_t size)
 {
-    int oldAlignedWidth = pixelImage->alignedWidth;
-    int newWidth = x2 - x1;
-    int newHeight = y2 - y1;
-    
-    JST_IMAGE *newPixelImage = (JST_IMAGE *)malloc(sizeof(JST_IMAGE));
-    bzero(newPixelImage, sizeof(JST_IMAGE));
-    newPixelImage->width = newWidth;
-    newPixelImage->alignedWidth = newWidth;
-    newPixelImage->height = newHeight;
-    
-    /* New pixel image is not aligned */
-    size_t newPixelsSize = newWidth * newHeight * sizeof(JST_COLOR);
-    JST_COLOR *newPixels = (JST_COLOR *)malloc(newPixelsSize);
-    bzero(newPixels, newPixelsSize);
-    newPixelImage->pixels = newPixels;
-    
-    uint64_t bigCountOffset = 0;
-    for (int y = y1; y < y2; ++y) {
-        for (int x = x1; x < x2; ++x) {
-            newPixels[bigCountOffset++] = pixelImage->pixels[y * oldAlignedWidth + x];
-        }
-    }
-    
-    GET_ROTATE_ROTATE3(pixelImage->orientation, orientation, newPixelImage->orientation);
-    return newPixelImage;
+    JSTFreePixelImage((JST_IMAGE *)info);
 }
 
-NS_INLINE void JSTFreePixelImage(JST_IMAGE *pixelImage) {
-    if (!pixelImage->isDestroyed) {
-        free(pixelImage->pixels);
-        pixelImage->isDestroyed = true;
+NS_INLINE CGImageRef JSTCreateCGImageSharingPixelImage(JST_IMAGE *pixelImage, CGColorSpaceRef cgColorSpace)
+{
+    JST_IMAGE *sharedImage = JSTCreatePixelImageSharingPixelImage(pixelImage);
+    if (!sharedImage || sharedImage->width == 0 || sharedImage->height == 0) {
+        JSTFreePixelImage(sharedImage);
+        return JSTCreateCGImageWithPixelImage(pixelImage, cgColorSpace);
     }
-    free(pixelImage);
+    
+    /* CGImage rows keep the alignment of the pixel image */
+    size_t bytesPerRow = (size_t)sharedImage->alignedWidth * sizeof(JST_COLOR);
+    size_t pixelsBufferLength = bytesPerRow * (size_t)(sharedImage->height - 1) + (size_t)sharedImage->width * sizeof(JST_COLOR);
+    CGDataProviderRef imageDataProvider = CGDataProviderCreateWithData(sharedImage, sharedImage->pixels, pixelsBufferLength, JSTReleaseSharedPixelImageData);
+    
+    CGImageRef cgImage = CGImageCreate(
+                                   (size_t)sharedImage->width, (size_t)sharedImage->height,
+                                   sizeof(JST_COLOR_COMPONENT_TYPE) * BYTE_SIZE,
+                                   sizeof(JST_COLOR_COMPONENT_TYPE) * BYTE_SIZE * JST_COLOR_COMPONENTS_PER_ELEMENT,
+                                   bytesPerRow, cgColorSpace,
+                                   kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst,
+                                   imageDataProvider, NULL, YES, kCGRenderingIntentDefault
+                                   );
+    
+    CGDataProviderRelease(imageDataProvider);
+    return cgImage;
 }
 
 @implementation JSTPixelImage
@@ -575,9 +363,6 @@ NS_INLINE void JSTFreePixelImage(JST_IMAGE *pixelImage) {
     self = [super init];
     if (self) {
         
-        _pixelImage = (JST_IMAGE *)malloc(sizeof(JST_IMAGE));
-        bzero(_pixelImage, sizeof(JST_IMAGE));
-        
         size_t width = IOSurfaceGetWidth(surface);
         size_t height = IOSurfaceGetHeight(surface);
         
@@ -597,11 +382,7 @@ NS_INLINE void JSTFreePixelImage(JST_IMAGE *pixelImage) {
         size_t alignedWidth = bytesPerRow / sizeof(JST_COLOR);
         void *pixels = IOSurfaceGetBaseAddress(surface);
         
-        _pixelImage->width = (int)width;
-        _pixelImage->alignedWidth = (int)alignedWidth;
-        _pixelImage->height = (int)height;
-        _pixelImage->pixels = pixels;
-        _pixelImage->isDestroyed = true;
+        _pixelImage = JSTCreatePixelImageWithPixels(pixels, (int)width, (int)alignedWidth, (int)height, false);
         
         _colorSpace = CGColorSpaceRetain(colorSpace);
     }
@@ -632,6 +413,81 @@ NS_INLINE void JSTFreePixelImage(JST_IMAGE *pixelImage) {
     return self;
 }
 
+- (JSTPixelImage *)initWithPixelCacheAtPath:(NSString *)path contentHash:(uint64_t)contentHash {
+    const void *colorSpaceData = NULL;
+    size_t colorSpaceLength = 0;
+    JST_IMAGE *pixelImage = JSTPixelCacheCreatePixelImageWithFile(path.fileSystemRepresentation, contentHash, &colorSpaceData, &colorSpaceLength);
+    if (!pixelImage) {
+        return nil;
+    }
+    
+    CGColorSpaceRef colorSpace = NULL;
+    if (colorSpaceData) {
+        CFDataRef iccData = CFDataCreate(kCFAllocatorDefault, (const UInt8 *)colorSpaceData, (CFIndex)colorSpaceLength);
+        colorSpace = CGColorSpaceCreateWithICCData(iccData);
+        CFRelease(iccData);
+    }
+    if (!colorSpace) {
+        colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    }
+    
+    self = [self initWithInternalPointer:pixelImage colorSpace:colorSpace];
+    CGColorSpaceRelease(colorSpace);
+    return self;
+}
+
+static void JSTReleasePixelData(void *bytes, size_t length, void *context)
+{
+    CFRelease((CFDataRef)context);
+}
+
+- (JSTPixelImage *)initWithPixelData:(NSData *)data width:(NSUInteger)width height:(NSUInteger)height bytesPerRow:(NSUInteger)bytesPerRow orientation:(JST_ORIENTATION)orientation colorSpace:(CGColorSpaceRef)colorSpace {
+    if (width == 0 || height == 0 || width > INT_MAX || height > INT_MAX ||
+        bytesPerRow % sizeof(JST_COLOR) != 0 || bytesPerRow < width * sizeof(JST_COLOR) ||
+        data.length < bytesPerRow * (height - 1) + width * sizeof(JST_COLOR))
+    {
+        return nil;
+    }
+    
+    /* Pixel image from data keeps its row alignment, writes copy the pixels first */
+    CFDataRef retainedData = (CFDataRef)CFBridgingRetain(data);
+    JST_PIXEL_STORAGE *storage = JSTPixelStorageCreateReadOnly((void *)CFDataGetBytePtr(retainedData), (size_t)CFDataGetLength(retainedData), JSTReleasePixelData, (void *)retainedData);
+    if (!storage) {
+        CFRelease(retainedData);
+        return nil;
+    }
+    JST_IMAGE *pixelImage = JSTCreatePixelImageWithPixels((JST_COLOR *)CFDataGetBytePtr(retainedData), (int)width, (int)(bytesPerRow / sizeof(JST_COLOR)), (int)height, false);
+    if (!pixelImage) {
+        JSTPixelStorageRelease(storage);
+        return nil;
+    }
+    pixelImage->storage = storage;
+    pixelImage->orientation = orientation;
+    return [self initWithInternalPointer:pixelImage colorSpace:colorSpace];
+}
+
+- (BOOL)writePixelCacheToPath:(NSString *)path contentHash:(uint64_t)contentHash {
+    CFDataRef iccData = CGColorSpaceCopyICCData(_colorSpace);
+    BOOL written = JSTPixelCacheWriteFile(
+        path.fileSystemRepresentation,
+        _pixelImage,
+        contentHash,
+        iccData ? CFDataGetBytePtr(iccData) : NULL,
+        iccData ? (size_t)CFDataGetLength(iccData) : 0
+    );
+    if (iccData) {
+        CFRelease(iccData);
+    }
+    return written;
+}
+
+- (CGImageRef)copyCGImage {
+    if (_pixelImage->orientation == 0) {
+        return JSTCreateCGImageSharingPixelImage(_pixelImage, _colorSpace);
+    }
+    return JSTCreateCGImageWithPixelImage(_pixelImage, _colorSpace);
+}
+
 - (SystemImage *)toSystemImage {
     CGImageRef cgimg = JSTCreateCGImageWithPixelImage(_pixelImage, _colorSpace);
 #if TARGET_OS_IPHONE
@@ -675,29 +531,14 @@ NS_INLINE void JSTFreePixelImage(JST_IMAGE *pixelImage) {
 #endif
 
 - (JSTPixelImage *)crop:(CGRect)rect {
-    int x1 = (int) rect.origin.x;
-    int y1 = (int) rect.origin.y;
-    int x2 = (int) rect.origin.x + (int) rect.size.width;
-    int y2 = (int) rect.origin.y + (int) rect.size.height;
-    SHIFT_RECT_BY_ORIEN(x1, y1, x2, y2, _pixelImage->width, _pixelImage->height, _pixelImage->orientation);
-    y2 = (y2 > _pixelImage->height) ? _pixelImage->height : y2;
-    x2 = (x2 > _pixelImage->width) ? _pixelImage->width : x2;
-    return [[JSTPixelImage alloc] initWithInternalPointer:JSTCreatePixelImageWithPixelImageInRect(_pixelImage, 0, x1, y1, x2, y2) colorSpace:_colorSpace];
+    JST_IMAGE *croppedImage = JSTCreatePixelImageViewByCroppingPixelImage(_pixelImage, (int) rect.origin.x, (int) rect.origin.y, (int) rect.size.width, (int) rect.size.height);
+    NSAssert(croppedImage != NULL, @"cannot crop pixel image");
+    return [[JSTPixelImage alloc] initWithInternalPointer:croppedImage colorSpace:_colorSpace];
 }
 
 - (CGSize)size {
     int width = 0, height = 0;
-    switch (_pixelImage->orientation) {
-    case 1:
-    case 2:
-        height = _pixelImage->width;
-        width = _pixelImage->height;
-        break;
-    default:
-        width = _pixelImage->width;
-        height = _pixelImage->height;
-        break;
-    }
+    JSTGetOrientedSizeOfPixelImage(_pixelImage, &width, &height);
     return CGSizeMake(width, height);
 }
 
@@ -705,6 +546,18 @@ NS_INLINE void JSTFreePixelImage(JST_IMAGE *pixelImage) {
     return _pixelImage;
 }
 
+- (JST_IMAGE *)packedInternalPointer {
+    BOOL packed = JSTPixelImageMakePacked(_pixelImage);
+    NSAssert(packed, @"cannot pack pixel image");
+    return _pixelImage;
+}
+
++ (JST_PIXEL_STORAGE_STATISTICS)storageStatistics {
+    JST_PIXEL_STORAGE_STATISTICS statistics;
+    JSTPixelStorageGetStatistics(&statistics);
+    return statistics;
+}
+
 - (JSTPixelColor *)getJSTColorOfPoint:(CGPoint)point {
     JST_COLOR colorOfPoint;
     JSTGetColorInPixelImageSafe(_pixelImage, (int) point.x, (int) point.y, &colorOfPoint);
@@ -755,19 +608,8 @@ NS_INLINE void JSTFreePixelImage(JST_IMAGE *pixelImage) {
 }
 
 - (id)copyWithZone:(NSZone *)zone {
-    
-    JST_IMAGE *newImage = (JST_IMAGE *)malloc(sizeof(JST_IMAGE));
-    memcpy(newImage, _pixelImage, sizeof(JST_IMAGE));
-    
-    /* Copied pixel image has the same alignment with the original ones */
-    size_t pixelSize = newImage->alignedWidth * newImage->height * sizeof(JST_COLOR);
-    JST_COLOR *pixels = (JST_COLOR *)malloc(pixelSize);
-    
-    memcpy(pixels, newImage->pixels, pixelSize);
-    
-    newImage->pixels = pixels;
-    newImage->isDestroyed = NO;
-    
+    JST_IMAGE *newImage = JSTCreatePixelImageSharingPixelImage(_pixelImage);
+    NSAssert(newImage != NULL, @"cannot copy pixel image");
     return [[JSTPixelImage alloc] initWithInternalPointer:newImage colorSpace:_colorSpace];
 }
 
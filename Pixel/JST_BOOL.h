@@ -1,7 +1,7 @@
 #ifndef JST_BOOL_h
 #define JST_BOOL_h
 
-#import <stdint.h>
+#include <stdint.h>
 
 typedef uint8_t JST_BOOL;
 
@@ -1,7 +1,7 @@
 #ifndef JST_COLOR_h
 #define JST_COLOR_h
 
-#import <stdint.h>
+#include <stdint.h>
 
 typedef union JST_COLOR JST_COLOR;
 
@@ -1,12 +1,13 @@
 #ifndef JST_IMAGE_h
 #define JST_IMAGE_h
 
-#import <stdint.h>
-#import "JST_BOOL.h"
-#import "JST_COLOR.h"
-#import "JST_ORIENTATION.h"
+#include <stdint.h>
+#include "JST_BOOL.h"
+#include "JST_COLOR.h"
+#include "JST_ORIENTATION.h"
 
 typedef struct JST_IMAGE JST_IMAGE;
+typedef struct JST_PIXEL_STORAGE JST_PIXEL_STORAGE;
 
 struct JST_IMAGE {
     JST_ORIENTATION orientation;
@@ -15,6 +16,7 @@ struct JST_IMAGE {
     int height;
     JST_COLOR *pixels;
     JST_BOOL isDestroyed;
+    JST_PIXEL_STORAGE *storage;  // shared owner of pixels, or NULL
 };
 
 #endif /* JST_IMAGE_h */
@@ -1,7 +1,7 @@
 #ifndef JST_ORIENTATION_h
 #define JST_ORIENTATION_h
 
-#import <stdint.h>
+#include <stdint.h>
 
 typedef uint8_t JST_ORIENTATION;
 
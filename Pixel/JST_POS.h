@@ -1,8 +1,8 @@
 #ifndef JST_POS_h
 #define JST_POS_h
 
-#import <stdint.h>
-#import "JST_COLOR.h"
+#include <stdint.h>
+#include "JST_COLOR.h"
 
 typedef struct JST_POS JST_POS;
 
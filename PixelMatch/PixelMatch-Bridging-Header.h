@@ -15,5 +15,6 @@
 #import "JST_IMAGE.h"
 #import "JSTPixelColor.h"
 #import "JSTPixelImage.h"
+#import "JSTPixelMatch.h"
 
 #endif /* PixelMatch_Bridging_Header_h */
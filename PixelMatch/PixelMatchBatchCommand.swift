@@ -0,0 +1,543 @@
+//
+//  PixelMatchBatchCommand.swift
+//  PixelMatch
+//
+//  Created by Darwin on 10/16/26.
+//  Copyright © 2026 JST. All rights reserved.
+//
+
+import ArgumentParser
+import Foundation
+import ImageIO
+
+
+// MARK: - Batch
+
+extension PixelMatchCommand {
+
+    struct Batch: ParsableCommand {
+
+        static var configuration = CommandConfiguration(
+            abstract: "Compare many pairs of images, listed in a manifest or matched by name in two directories.",
+            discussion: """
+            Each line of a manifest is a baseline path, a candidate path and optionally an output path, separated by tabs. \
+            Relative paths are resolved against the directory of the manifest, empty lines and lines starting with # are ignored. \
+            Without an output path, the output of a pair goes to the output directory under the path of its candidate \
+            in the directory of the manifest, or under its line number and file name for candidates elsewhere.
+            """
+        )
+
+        @Argument(help: ArgumentHelp("manifest of pairs, or directory of baseline images", valueName: "manifest-or-baseline-directory"))
+        var pathOfBaseline: String
+
+        @Argument(help: ArgumentHelp("directory of candidate images, with the same relative paths as the baseline ones", valueName: "candidate-directory"))
+        var pathOfCandidate: String?
+
+        @OptionGroup
+        var matchArguments: MatchArguments
+
+        @Option(name: .customLong("output-dir"), help: ArgumentHelp("directory of the diff outputs, only pairs with differences get one", valueName: "path"))
+        var pathOfOutputDirectory: String?
+
+        @Flag(name: .customLong("count-only"), help: "only count different pixels, even for pairs with an output path in the manifest")
+        var countOnly: Bool = false
+
+        @Flag(help: "list the regions of different pixels of each pair in the summary")
+        var regions: Bool = false
+
+        @Option(name: .customLong("summary"), help: ArgumentHelp("path of the JSON summary, printed to the standard output if omitted", valueName: "path"))
+        var pathOfSummary: String?
+
+        @Option(name: [.customShort("j"), .long], help: "maximum count of pairs in flight")
+        var maximumWorkerCount: Int = ProcessInfo.processInfo.activeProcessorCount
+
+        func validate() throws {
+            if maximumWorkerCount < 1 {
+                throw ValidationError("--jobs must be at least 1.")
+            }
+        }
+
+        func run() throws {
+            do {
+                let baselineURL = URL(fileURLWithPath: pathOfBaseline).standardizedFileURL
+                let outputDirectoryURL = pathOfOutputDirectory.map({ URL(fileURLWithPath: $0, isDirectory: true).standardizedFileURL })
+
+                let pairs: [PixelMatchBatch.Pair]
+                if let pathOfCandidate = pathOfCandidate {
+                    let candidateURL = URL(fileURLWithPath: pathOfCandidate, isDirectory: true).standardizedFileURL
+                    pairs = try PixelMatchBatch.pairs(baselineDirectory: baselineURL, candidateDirectory: candidateURL, outputDirectory: outputDirectoryURL)
+                } else {
+                    pairs = try PixelMatchBatch.pairs(manifest: baselineURL, outputDirectory: outputDirectoryURL)
+                }
+                if let outputDirectoryURL = outputDirectoryURL, !countOnly {
+                    try FileManager.default.createDirectory(at: outputDirectoryURL, withIntermediateDirectories: true)
+                }
+
+                let opts = matchArguments.matchOptions(
+                    countOnly: countOnly,
+                    extractRegions: regions,
+                    maximumThreadCount: ProcessInfo.processInfo.activeProcessorCount
+                )
+                let batch = PixelMatchBatch(pairs: pairs, options: opts, maximumWorkerCount: maximumWorkerCount)
+                let summary = batch.perform()
+
+                let encoder = JSONEncoder()
+                encoder.outputFormatting = [.prettyPrinted, .sortedKeys]
+                let summaryData = try encoder.encode(summary)
+                if let pathOfSummary = pathOfSummary {
+                    try summaryData.write(to: URL(fileURLWithPath: pathOfSummary))
+                } else {
+                    FileHandle.standardOutput.write(summaryData)
+                    FileHandle.standardOutput.write("\n".data(using: .utf8)!)
+                }
+
+                if summary.failedCount > 0 || summary.exceededCount > 0 {
+                    throw ExitCode.failure
+                }
+            } catch let error as ExitCode {
+                throw error
+            } catch {
+                var outputStream = StandardErrorOutputStream()
+                print(error.localizedDescription, to: &outputStream)
+                throw error
+            }
+        }
+    }
+}
+
+
+// MARK: - Batch Pipeline
+
+/// Compares pairs on a bounded pool of workers.
+///
+/// Every worker takes the next pair, decodes both images straight into pixel
+/// buffers it keeps for the next pairs, compares them, and hands the diff
+/// output to the encoding queue so that it can decode the next pair while
+/// the previous PNG is written. Each worker alternates between two output
+/// buffers, so at most one encoding per worker is in flight.
+final class PixelMatchBatch {
+
+    struct Pair {
+        let name: String
+        let baselineURL: URL
+        let candidateURL: URL
+        let outputURL: URL?
+    }
+
+    enum Status: String, Encodable {
+        case identical
+        case different
+        case exceeded      // more pixels than --max-diff differ
+        case missing       // no candidate with the same relative path
+        case failed
+    }
+
+    struct Entry: Encodable {
+        let name: String
+        let baseline: String
+        let candidate: String
+        var status: Status
+        var diffCount: Int?
+        var totalCount: Int?
+        var output: String?
+        var error: String?
+        var regions: [PixelMatchService.Region]?
+        var elapsed: Double
+    }
+
+    struct Summary: Encodable {
+        let pairCount: Int
+        let identicalCount: Int
+        let differentCount: Int
+        let exceededCount: Int
+        let missingCount: Int
+        let failedCount: Int
+        let workerCount: Int
+        let allocatedBufferCount: Int  // pixel buffers allocated for all pairs
+        let elapsed: Double
+        let entries: [Entry]
+    }
+
+    enum Error: CustomNSError, LocalizedError {
+        case cannotReadManifest(url: URL)
+        case malformedManifestLine(url: URL, line: Int)
+        case cannotCreateImage(url: URL)
+
+        var errorCode: Int {
+            switch self {
+                case .cannotReadManifest(_):
+                    return 1201
+                case .malformedManifestLine(_, _):
+                    return 1202
+                case .cannotCreateImage(_):
+                    return 1203
+            }
+        }
+
+        var failureReason: String? {
+            switch self {
+            case let .cannotReadManifest(url):
+                return String(format: NSLocalizedString("Cannot read manifest: %@.", comment: "PixelMatchBatchError"), url.path)
+            case let .malformedManifestLine(url, line):
+                return String(format: NSLocalizedString("Malformed manifest line %d: %@.", comment: "PixelMatchBatchError"), line, url.path)
+            case let .cannotCreateImage(url):
+                return String(format: NSLocalizedString("Cannot create image: %@.", comment: "PixelMatchBatchError"), url.path)
+            }
+        }
+    }
+
+    private static let imageExtensions: Set<String> = ["png", "jpg", "jpeg", "tif", "tiff", "bmp", "gif", "heic"]
+
+    let pairs: [Pair]
+    let options: MatchOptions
+    let workerCount: Int
+
+    private let lock = NSLock()
+    private var nextPairIndex = 0
+    private var entries: [Entry?]
+    private var allocatedBufferCount = 0
+    private let encodingQueue = DispatchQueue(label: "com.jst.pixelmatch.batch.encoding", qos: .utility, attributes: .concurrent)
+
+    init(pairs: [Pair], options: MatchOptions, maximumWorkerCount: Int) {
+        self.pairs = pairs
+        self.options = options
+        self.workerCount = max(min(maximumWorkerCount, pairs.count), 1)
+        self.entries = Array(repeating: nil, count: pairs.count)
+    }
+
+
+    // MARK: - Pairs
+
+    static func pairs(manifest url: URL, outputDirectory: URL?) throws -> [Pair] {
+        guard let contents = try? String(contentsOf: url, encoding: .utf8) else {
+            throw Error.cannotReadManifest(url: url)
+        }
+        let baseURL = url.deletingLastPathComponent()
+        let baseDirectoryPath = baseURL.standardizedFileURL.path
+        let basePath = baseDirectoryPath.hasSuffix("/") ? baseDirectoryPath : baseDirectoryPath + "/"
+        var pairs = [Pair]()
+        var outputNames = Set<String>()
+        for (offset, line) in contents.components(separatedBy: .newlines).enumerated() {
+            let trimmedLine = line.trimmingCharacters(in: .whitespaces)
+            if trimmedLine.isEmpty || trimmedLine.hasPrefix("#") {
+                continue
+            }
+            let columns = trimmedLine.components(separatedBy: "\t").filter({ !$0.isEmpty })
+            guard columns.count == 2 || columns.count == 3 else {
+                throw Error.malformedManifestLine(url: url, line: offset + 1)
+            }
+            let candidateURL = URL(fileURLWithPath: columns[1], relativeTo: baseURL).standardizedFileURL
+            var outputURL: URL?
+            if columns.count == 3 {
+                outputURL = URL(fileURLWithPath: columns[2], relativeTo: baseURL).standardizedFileURL
+            } else if let outputDirectory = outputDirectory {
+                // named after the path of the candidate in the directory of the manifest, candidates elsewhere
+                // or listed more than once are told apart by their line, as their names may well be the same
+                var outputName: String?
+                if candidateURL.path.hasPrefix(basePath) {
+                    outputName = (String(candidateURL.path.dropFirst(basePath.count)) as NSString).deletingPathExtension
+                }
+                if outputName == nil || outputNames.contains(outputName!) {
+                    outputName = "line-\(offset + 1)-\(candidateURL.deletingPathExtension().lastPathComponent)"
+                }
+                outputNames.insert(outputName!)
+                outputURL = outputDirectory
+                    .appendingPathComponent(outputName!)
+                    .appendingPathExtension("png")
+            }
+            pairs.append(Pair(
+                name: columns[1],
+                baselineURL: URL(fileURLWithPath: columns[0], relativeTo: baseURL).standardizedFileURL,
+                candidateURL: candidateURL,
+                outputURL: outputURL
+            ))
+        }
+        return pairs
+    }
+
+    static func pairs(baselineDirectory: URL, candidateDirectory: URL, outputDirectory: URL?) throws -> [Pair] {
+        guard let enumerator = FileManager.default.enumerator(
+            at: baselineDirectory,
+            includingPropertiesForKeys: [.isRegularFileKey],
+            options: [.skipsHiddenFiles]
+        ) else {
+            throw CocoaError(.fileReadNoSuchFile, userInfo: [NSFilePathErrorKey: baselineDirectory.path])
+        }
+        let basePath = baselineDirectory.path.hasSuffix("/") ? baselineDirectory.path : baselineDirectory.path + "/"
+        var relativePaths = [String]()
+        for case let url as URL in enumerator {
+            guard imageExtensions.contains(url.pathExtension.lowercased()),
+                  (try? url.resourceValues(forKeys: [.isRegularFileKey]).isRegularFile) == true
+            else {
+                continue
+            }
+            let path = url.standardizedFileURL.path
+            guard path.hasPrefix(basePath) else { continue }
+            relativePaths.append(String(path.dropFirst(basePath.count)))
+        }
+        return relativePaths.sorted().map({ relativePath in
+            Pair(
+                name: relativePath,
+                baselineURL: baselineDirectory.appendingPathComponent(relativePath),
+                candidateURL: candidateDirectory.appendingPathComponent(relativePath),
+                outputURL: outputDirectory?
+                    .appendingPathComponent(relativePath)
+                    .deletingPathExtension()
+                    .appendingPathExtension("png")
+            )
+        })
+    }
+
+
+    // MARK: - Perform
+
+    func perform() -> Summary {
+        let startTime = CFAbsoluteTimeGetCurrent()
+        DispatchQueue.concurrentPerform(iterations: workerCount) { _ in
+            performWorker()
+        }
+
+        let finishedEntries = entries.compactMap({ $0 })
+        let count: (Status) -> Int = { status in finishedEntries.filter({ $0.status == status }).count }
+        return Summary(
+            pairCount: pairs.count,
+            identicalCount: count(.identical),
+            differentCount: count(.different),
+            exceededCount: count(.exceeded),
+            missingCount: count(.missing),
+            failedCount: count(.failed),
+            workerCount: workerCount,
+            allocatedBufferCount: allocatedBufferCount,
+            elapsed: CFAbsoluteTimeGetCurrent() - startTime,
+            entries: finishedEntries
+        )
+    }
+
+    private func takeNextPairIndex() -> Int? {
+        lock.lock()
+        defer { lock.unlock() }
+        guard nextPairIndex < pairs.count else { return nil }
+        nextPairIndex += 1
+        return nextPairIndex - 1
+    }
+
+    private func updateEntry(at index: Int, _ update: (inout Entry) -> Void) {
+        lock.lock()
+        defer { lock.unlock() }
+        if var entry = entries[index] {
+            update(&entry)
+            entries[index] = entry
+        }
+    }
+
+    private func performWorker() {
+        let baselineBuffer = PixelBuffer()
+        let candidateBuffer = PixelBuffer()
+        let outputBuffers = [PixelBuffer(), PixelBuffer()]
+        let pendingEncodings = [DispatchGroup(), DispatchGroup()]
+        var outputSlot = 0
+
+        // leftover cores go to the tiles of each pair
+        let threadCount = max(min(options.maximumThreadCount, ProcessInfo.processInfo.activeProcessorCount) / workerCount, 1)
+
+        while let index = takeNextPairIndex() {
+            let pair = pairs[index]
+            let startTime = CFAbsoluteTimeGetCurrent()
+            var entry = Entry(
+                name: pair.name,
+                baseline: pair.baselineURL.path,
+                candidate: pair.candidateURL.path,
+                status: .failed,
+                elapsed: 0
+            )
+
+            // the output buffer of this slot may still be encoded for the pair before last
+            pendingEncodings[outputSlot].wait()
+            let outputBuffer = options.countOnly || pair.outputURL == nil ? nil : outputBuffers[outputSlot]
+
+            var encodedImage: UnsafeMutablePointer<JST_IMAGE>?
+            do {
+                if !FileManager.default.fileExists(atPath: pair.candidateURL.path) {
+                    entry.status = .missing
+                } else {
+                    _ = try baselineBuffer.decode(contentsOf: pair.baselineURL)
+                    _ = try candidateBuffer.decode(contentsOf: pair.candidateURL)
+                    try compare(baselineBuffer, candidateBuffer, into: outputBuffer, entry: &entry, threadCount: threadCount)
+                    if entry.status == .different, let outputImage = outputBuffer?.image {
+                        encodedImage = outputImage
+                        entry.output = pair.outputURL?.path
+                    }
+                }
+            } catch {
+                entry.status = .failed
+                entry.error = error.localizedDescription
+            }
+            entry.elapsed = CFAbsoluteTimeGetCurrent() - startTime
+
+            lock.lock()
+            entries[index] = entry
+            lock.unlock()
+
+            if let outputImage = encodedImage, let outputURL = pair.outputURL {
+                let group = pendingEncodings[outputSlot]
+                group.enter()
+                encodingQueue.async { [weak self] in
+                    defer { group.leave() }
+                    do {
+                        try PixelMatchBatch.writePNG(of: outputImage, to: outputURL)
+                    } catch {
+                        self?.updateEntry(at: index) { entry in
+                            entry.status = .failed
+                            entry.output = nil
+                            entry.error = error.localizedDescription
+                        }
+                    }
+                }
+                outputSlot ^= 1
+            }
+        }
+
+        pendingEncodings.forEach({ $0.wait() })
+
+        lock.lock()
+        allocatedBufferCount += baselineBuffer.allocationCount + candidateBuffer.allocationCount + outputBuffers.reduce(0, { $0 + $1.allocationCount })
+        lock.unlock()
+    }
+
+    private func compare(_ baselineBuffer: PixelBuffer, _ candidateBuffer: PixelBuffer, into outputBuffer: PixelBuffer?, entry: inout Entry, threadCount: Int) throws {
+        guard let image1 = baselineBuffer.image, let image2 = candidateBuffer.image else {
+            throw Error.cannotCreateImage(url: URL(fileURLWithPath: entry.baseline))
+        }
+        guard image1.pointee.width == image2.pointee.width && image1.pointee.height == image2.pointee.height else {
+            throw PixelMatchService.Error.sizeDoesNotMatch(
+                size1: CGSize(width: Int(image1.pointee.width), height: Int(image1.pointee.height)),
+                size2: CGSize(width: Int(image2.pointee.width), height: Int(image2.pointee.height))
+            )
+        }
+
+        // cleared, as only the differing pixels are written in diff mask mode
+        let output = try outputBuffer?.prepare(width: Int(image1.pointee.width), height: Int(image1.pointee.height), clearing: true)
+        var matchOptions = options.pixelMatchOptions
+        guard let job = JSTPixelMatchJobCreate(image1, image2, output, &matchOptions, JST_PIXEL_MATCH_KERNEL_AUTOMATIC, 0) else {
+            throw Error.cannotCreateImage(url: URL(fileURLWithPath: entry.candidate))
+        }
+        defer { JSTPixelMatchJobFree(job) }
+        if options.extractRegions {
+            _ = JSTPixelMatchJobSetCollectsRegions(job, 1)
+        }
+
+        let jobThreadCount = max(min(threadCount, Int(JSTPixelMatchJobGetTileCount(job))), 1)
+        DispatchQueue.concurrentPerform(iterations: jobThreadCount) { _ in
+            JSTPixelMatchJobPerform(job)
+        }
+
+        let diffCount = Int(JSTPixelMatchJobGetDiffCount(job))
+        entry.diffCount = diffCount
+        entry.totalCount = Int(image1.pointee.width) * Int(image1.pointee.height)
+        if JSTPixelMatchJobIsBudgetExceeded(job) != 0 {
+            entry.status = .exceeded
+        } else {
+            entry.status = diffCount > 0 ? .different : .identical
+        }
+        if options.extractRegions {
+            var regionCount: Int32 = 0
+            if let regionsPointer = JSTPixelMatchJobGetRegions(job, &regionCount) {
+                entry.regions = UnsafeBufferPointer(start: regionsPointer, count: Int(regionCount)).map({ PixelMatchService.Region($0) })
+            }
+        }
+    }
+
+    /// Written in DeviceRGB, as PixelMatchService does.
+    private static func writePNG(of image: UnsafeMutablePointer<JST_IMAGE>, to url: URL) throws {
+        let width = Int(image.pointee.width), height = Int(image.pointee.height)
+        let bytesPerRow = Int(image.pointee.alignedWidth) * MemoryLayout<JST_COLOR>.size
+
+        // the buffer outlives the encoding, no copy needed
+        guard let provider = CGDataProvider(dataInfo: nil, data: image.pointee.pixels, size: bytesPerRow * height, releaseData: { _, _, _ in }),
+              let cgImage = CGImage(
+                width: width,
+                height: height,
+                bitsPerComponent: 8,
+                bitsPerPixel: 32,
+                bytesPerRow: bytesPerRow,
+                space: CGColorSpaceCreateDeviceRGB(),
+                bitmapInfo: CGBitmapInfo(rawValue: CGBitmapInfo.byteOrder32Little.rawValue | CGImageAlphaInfo.premultipliedFirst.rawValue),
+                provider: provider,
+                decode: nil,
+                shouldInterpolate: false,
+                intent: .defaultIntent
+              )
+        else {
+            throw Error.cannotCreateImage(url: url)
+        }
+
+        try FileManager.default.createDirectory(at: url.deletingLastPathComponent(), withIntermediateDirectories: true)
+        guard let destination = CGImageDestinationCreateWithURL(url as CFURL, "public.png" as CFString, 1, nil) else {
+            throw Error.cannotCreateImage(url: url)
+        }
+        CGImageDestinationAddImage(destination, cgImage, nil)
+        guard CGImageDestinationFinalize(destination) else {
+            throw Error.cannotCreateImage(url: url)
+        }
+    }
+}
+
+
+// MARK: - Pixel Buffer
+
+/// A pixel image owned by one worker, only reallocated when the size of
+/// the next pair differs.
+private final class PixelBuffer {
+
+    private(set) var image: UnsafeMutablePointer<JST_IMAGE>?
+    private(set) var allocationCount = 0
+
+    deinit {
+        JSTFreePixelImage(image)
+    }
+
+    func prepare(width: Int, height: Int, clearing: Bool = false) throws -> UnsafeMutablePointer<JST_IMAGE> {
+        if let image = image, Int(image.pointee.width) == width, Int(image.pointee.height) == height {
+            if clearing {
+                memset(image.pointee.pixels, 0, Int(image.pointee.alignedWidth) * height * MemoryLayout<JST_COLOR>.size)
+            }
+            return image
+        }
+        JSTFreePixelImage(image)
+        image = JSTCreatePixelImage(Int32(width), Int32(height))
+        guard let image = image else {
+            throw CocoaError(.fileReadTooLarge)
+        }
+        allocationCount += 1
+        return image
+    }
+
+    /// Draws the first image of the file into the buffer, in the same layout
+    /// as JSTPixelImage(cgImage:), and returns the color space to encode with.
+    func decode(contentsOf url: URL) throws -> CGColorSpace {
+        guard let source = CGImageSourceCreateWithURL(url as CFURL, [kCGImageSourceShouldCache: false] as CFDictionary),
+              let cgImage = CGImageSourceCreateImageAtIndex(source, 0, [kCGImageSourceShouldCache: false] as CFDictionary)
+        else {
+            throw PixelMatchService.Error.cannotLoadImage(url: url)
+        }
+
+        let image = try prepare(width: cgImage.width, height: cgImage.height)
+        let colorSpace = cgImage.colorSpace?.model == .rgb ? cgImage.colorSpace! : CGColorSpaceCreateDeviceRGB()
+        guard let context = CGContext(
+            data: image.pointee.pixels,
+            width: cgImage.width,
+            height: cgImage.height,
+            bitsPerComponent: 8,
+            bytesPerRow: Int(image.pointee.alignedWidth) * MemoryLayout<JST_COLOR>.size,
+            space: colorSpace,
+            bitmapInfo: CGBitmapInfo.byteOrder32Little.rawValue | CGImageAlphaInfo.premultipliedFirst.rawValue
+        ) else {
+            throw PixelMatchService.Error.cannotLoadImage(url: url)
+        }
+
+        // replaces what the previous pair left in the buffer instead of blending over it
+        context.setBlendMode(.copy)
+        context.draw(cgImage, in: CGRect(x: 0, y: 0, width: cgImage.width, height: cgImage.height))
+        return colorSpace
+    }
+}
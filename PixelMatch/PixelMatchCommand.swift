@@ -17,17 +17,16 @@ struct PixelMatchCommand: ParsableCommand {
     static var configuration = CommandConfiguration(
         commandName: "pixelmatch",
         abstract: "Compute difference between two images with the same dimension pixel by pixel.",
-        version: "2.10"
+        version: "2.10",
+        subcommands: [Compare.self, Batch.self],
+        defaultSubcommand: Compare.self
     )
+}
 
-    @Argument(help: ArgumentHelp("path of the first image to compute difference", valueName: "path-of-image-1"))
-    var pathOfImage1: String
 
-    @Argument(help: ArgumentHelp("path of the second image to compute difference", valueName: "path-of-image-2"))
-    var pathOfImage2: String
+// MARK: - Match Arguments
 
-    @Argument(help: ArgumentHelp("path of the output image", valueName: "output"))
-    var pathOfOutputImage: String
+struct MatchArguments: ParsableArguments {
 
     @Option(help: "matching threshold (0 to 1); smaller is more sensitive")
     var threshold: Double = 0.00
@@ -47,59 +46,149 @@ struct PixelMatchCommand: ParsableCommand {
     @Option(name: .customLong("diff-color"), help: ArgumentHelp("HEX color of different pixels in diff output", valueName: "diff-color"))
     var diffColorHex: String = "#ff0000"
 
-    @Option(name: [.customShort("j"), .long], help: "maximum concurrent jobs count")
-    var maximumThreadCount: Int = ProcessInfo.processInfo.activeProcessorCount
+    @Option(name: .customLong("max-diff"), help: ArgumentHelp("stop comparing and fail once more than this many pixels differ", valueName: "count"))
+    var diffBudget: Int?
 
     @Flag(name: .shortAndLong, help: "enable verbose logging")
     var verbose: Bool = false
 
-    func run() throws {
-        do {
-            let img1URL = URL(fileURLWithPath: pathOfImage1).standardizedFileURL
-            let img2URL = URL(fileURLWithPath: pathOfImage2).standardizedFileURL
-            let outputURL = URL(fileURLWithPath: pathOfOutputImage)
-
-            let antiAliasingColor = NSColor(hex: antiAliasingColorHex)
-            let diffColor = NSColor(hex: diffColorHex)
-            let opts = MatchOptions(
-                threshold: threshold,
-                includeAA: !skipAntiAliasing,
-                alpha: alpha,
-                aaColor: (
-                    UInt8(antiAliasingColor.redComponent * 255.0),
-                    UInt8(antiAliasingColor.greenComponent * 255.0),
-                    UInt8(antiAliasingColor.blueComponent * 255.0)
-                ),
-                diffColor: (
-                    UInt8(diffColor.redComponent * 255.0),
-                    UInt8(diffColor.greenComponent * 255.0),
-                    UInt8(diffColor.blueComponent * 255.0)
-                ),
-                diffMask: diffMask,
-                maximumThreadCount: maximumThreadCount,
-                verbose: verbose
-            )
-
-            let img1Data = try Data(contentsOf: img1URL)
-            guard let nsimg1 = NSImage(data: img1Data) else {
-                throw PixelMatchService.Error.cannotLoadImage(url: img1URL)
+    func validate() throws {
+        if let diffBudget = diffBudget, diffBudget < 0 {
+            throw ValidationError("--max-diff must not be negative.")
+        }
+    }
+
+    func matchOptions(countOnly: Bool, extractRegions: Bool, maximumThreadCount: Int) -> MatchOptions {
+        let antiAliasingColor = NSColor(hex: antiAliasingColorHex)
+        let diffColor = NSColor(hex: diffColorHex)
+        return MatchOptions(
+            threshold: threshold,
+            includeAA: !skipAntiAliasing,
+            alpha: alpha,
+            aaColor: (
+                UInt8(antiAliasingColor.redComponent * 255.0),
+                UInt8(antiAliasingColor.greenComponent * 255.0),
+                UInt8(antiAliasingColor.blueComponent * 255.0)
+            ),
+            diffColor: (
+                UInt8(diffColor.redComponent * 255.0),
+                UInt8(diffColor.greenComponent * 255.0),
+                UInt8(diffColor.blueComponent * 255.0)
+            ),
+            diffMask: diffMask,
+            countOnly: countOnly,
+            diffBudget: diffBudget,
+            extractRegions: extractRegions,
+            maximumThreadCount: maximumThreadCount,
+            verbose: verbose
+        )
+    }
+}
+
+
+// MARK: - Compare
+
+extension PixelMatchCommand {
+
+    struct Compare: ParsableCommand {
+
+        static var configuration = CommandConfiguration(
+            abstract: "Compare one pair of images."
+        )
+
+        @Argument(help: ArgumentHelp("path of the first image to compute difference", valueName: "path-of-image-1"))
+        var pathOfImage1: String
+
+        @Argument(help: ArgumentHelp("path of the second image to compute difference", valueName: "path-of-image-2"))
+        var pathOfImage2: String
+
+        @Argument(help: ArgumentHelp("path of the output image, not needed with --count-only", valueName: "output"))
+        var pathOfOutputImage: String?
+
+        @OptionGroup
+        var matchArguments: MatchArguments
+
+        @Flag(name: .customLong("count-only"), help: "print the number of different pixels without rendering a diff output")
+        var countOnly: Bool = false
+
+        @Option(name: .customLong("regions"), help: ArgumentHelp("path of a JSON file listing the regions of different pixels", valueName: "path"))
+        var pathOfRegions: String?
+
+        @Option(name: [.customShort("j"), .long], help: "maximum concurrent jobs count")
+        var maximumThreadCount: Int = ProcessInfo.processInfo.activeProcessorCount
+
+        func validate() throws {
+            if !countOnly && pathOfOutputImage == nil {
+                throw ValidationError("Missing expected argument '<output>', or pass --count-only.")
             }
-            let img1 = JSTPixelImage(systemImage: nsimg1)
+        }
 
-            let img2Data = try Data(contentsOf: img2URL)
-            guard let nsimg2 = NSImage(data: img2Data) else {
-                throw PixelMatchService.Error.cannotLoadImage(url: img2URL)
+        func run() throws {
+            do {
+                let img1URL = URL(fileURLWithPath: pathOfImage1).standardizedFileURL
+                let img2URL = URL(fileURLWithPath: pathOfImage2).standardizedFileURL
+
+                let opts = matchArguments.matchOptions(
+                    countOnly: countOnly,
+                    extractRegions: pathOfRegions != nil,
+                    maximumThreadCount: maximumThreadCount
+                )
+
+                let img1Data = try Data(contentsOf: img1URL)
+                guard let nsimg1 = NSImage(data: img1Data) else {
+                    throw PixelMatchService.Error.cannotLoadImage(url: img1URL)
+                }
+                let img1 = JSTPixelImage(systemImage: nsimg1)
+
+                let img2Data = try Data(contentsOf: img2URL)
+                guard let nsimg2 = NSImage(data: img2Data) else {
+                    throw PixelMatchService.Error.cannotLoadImage(url: img2URL)
+                }
+                let img2 = JSTPixelImage(systemImage: nsimg2)
+
+                let result = try PixelMatchCommand.service.performConcurrentPixelComparison(img1, img2, options: opts)
+                if let pathOfRegions = pathOfRegions {
+                    try writeRegions(of: result, to: URL(fileURLWithPath: pathOfRegions))
+                }
+                if result.isBudgetExceeded {
+                    print("more than \(matchArguments.diffBudget ?? 0)")
+                    throw ExitCode.failure
+                }
+                if countOnly {
+                    print(result.diffCount)
+                    return
+                }
+                guard result.diffCount > 0, let output = result.differenceImage else {
+                    throw PixelMatchService.Error.noDifferenceDetected
+                }
+                try output
+                    .pngRepresentation()
+                    .write(to: URL(fileURLWithPath: pathOfOutputImage!))
+            } catch let error as ExitCode {
+                throw error
+            } catch {
+                var outputStream = StandardErrorOutputStream()
+                print(error.localizedDescription, to: &outputStream)
+                throw error
             }
-            let img2 = JSTPixelImage(systemImage: nsimg2)
-
-            let output = try PixelMatchCommand.service.performConcurrentPixelMatch(img1, img2, options: opts)
-            try output
-                .pngRepresentation()
-                .write(to: outputURL)
-        } catch {
-            var outputStream = StandardErrorOutputStream()
-            print(error.localizedDescription, to: &outputStream)
-            throw error
+        }
+
+        private struct RegionsSummary: Encodable {
+            let diffCount: Int
+            let totalCount: Int
+            let isBudgetExceeded: Bool  // regions only cover the compared rows if true
+            let regions: [PixelMatchService.Region]
+        }
+
+        private func writeRegions(of result: PixelMatchService.Result, to url: URL) throws {
+            let encoder = JSONEncoder()
+            encoder.outputFormatting = [.prettyPrinted, .sortedKeys]
+            try encoder.encode(RegionsSummary(
+                diffCount: result.diffCount,
+                totalCount: result.totalCount,
+                isBudgetExceeded: result.isBudgetExceeded,
+                regions: result.regions
+            )).write(to: url)
         }
     }
 }